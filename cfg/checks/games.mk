@@ -1,5 +1,5 @@
 # Variables for game support
 GAMES_CFLAGS = -DGAMES
-GAMES_OBJ = game_base.o game_centipede.o game_chess.o game_life.o game_util.o game_snake.o
+GAMES_OBJ = chess_engine.o game_base.o game_centipede.o game_chess.o game_life.o game_net.o game_util.o game_snake.o life_board.o life_hash.o life_rle.o
 CFLAGS += $(GAMES_CFLAGS)
 OBJ += $(GAMES_OBJ)
@@ -92,9 +92,9 @@ char *api_get_status_message(void)
     return (char *) status;
 }
 
-void api_send(const char *msg)
+static void api_send_to_window(ToxWindow *window, const char *msg)
 {
-    if (msg == NULL || self_window->chatwin->cqueue == NULL) {
+    if (msg == NULL || window == NULL || window->chatwin->cqueue == NULL) {
         return;
     }
 
@@ -104,17 +104,30 @@ void api_send(const char *msg)
         return;
     }
 
+    snprintf((char *) window->chatwin->line, sizeof(window->chatwin->line), "%s", msg);
+    add_line_to_hist(window->chatwin);
+    const int id = line_info_add(window, user_toxic->c_config, true, name, NULL, OUT_MSG, 0, 0, "%s", msg);
+    cqueue_add(window->chatwin->cqueue, msg, strlen(msg), OUT_MSG, id);
+    free(name);
+}
+
+void api_send(const char *msg)
+{
     self_window = get_active_window(user_toxic->windows);
 
-    if (self_window == NULL) {
+    api_send_to_window(self_window, msg);
+}
+
+void api_send_friend(uint32_t friendnumber, const char *msg)
+{
+    ToxWindow *window = get_window_by_number_type(user_toxic->windows, friendnumber, WINDOW_TYPE_CHAT);
+
+    if (window == NULL) {
+        api_display("Plugin tried to message a friend without an open chat window.");
         return;
     }
 
-    snprintf((char *) self_window->chatwin->line, sizeof(self_window->chatwin->line), "%s", msg);
-    add_line_to_hist(self_window->chatwin);
-    const int id = line_info_add(self_window, user_toxic->c_config, true, name, NULL, OUT_MSG, 0, 0, "%s", msg);
-    cqueue_add(self_window->chatwin->cqueue, msg, strlen(msg), OUT_MSG, id);
-    free(name);
+    api_send_to_window(window, msg);
 }
 
 void api_execute(const char *input, int mode)
@@ -154,8 +167,6 @@ void cmd_run(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char (*arg
 
     const Client_Config *c_config = toxic->c_config;
 
-    FILE       *fp;
-
     cur_window  = window;
     self_window = self;
 
@@ -172,15 +183,49 @@ void cmd_run(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char (*arg
         return;
     }
 
-    fp = fopen(argv[1], "r");
-
-    if (fp == NULL) {
+    if (!file_exists(argv[1])) {
         line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "Path does not exist.");
         return;
     }
 
-    run_python(fp, argv[1]);
-    fclose(fp);
+    if (run_python(argv[1]) == -1) {
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "Plugin queue is full. Try again later.");
+    }
+}
+
+/* The most plugins listed by `/plugins` */
+#define MAX_LISTED_PLUGINS 64
+
+void cmd_plugins(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char (*argv)[MAX_STR_SIZE])
+{
+    UNUSED_VAR(window);
+    UNUSED_VAR(argc);
+    UNUSED_VAR(argv);
+
+    if (toxic == NULL || self == NULL) {
+        return;
+    }
+
+    const Client_Config *c_config = toxic->c_config;
+
+    Python_Plugin_Stats stats[MAX_LISTED_PLUGINS];
+    const size_t num_plugins = python_get_plugin_stats(stats, MAX_LISTED_PLUGINS);
+
+    if (num_plugins == 0) {
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "No plugins have been run.");
+        return;
+    }
+
+    for (size_t i = 0; i < num_plugins; ++i) {
+        const Python_Plugin_Stats *s = &stats[i];
+        const double avg_ms = s->calls > 0 ? (double) s->total_us / s->calls / 1000.0 : 0.0;
+
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 1, CYAN, "%s", s->path);
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0,
+                      " %llu calls, %llu errors, avg %.2f ms, max %.2f ms, %u pending, %llu dropped",
+                      (unsigned long long) s->calls, (unsigned long long) s->errors, avg_ms, s->max_us / 1000.0,
+                      s->pending, (unsigned long long) s->dropped);
+    }
 }
 
 void invoke_autoruns(ToxWindow *self, const char *autorun_path)
@@ -215,16 +260,11 @@ void invoke_autoruns(ToxWindow *self, const char *autorun_path)
 
         if (!strcmp(dir->d_name + path_len - 3, ".py")) {
             snprintf(abspath_buf, sizeof(abspath_buf), "%s%s", autorun_path, dir->d_name);
-            FILE *fp = fopen(abspath_buf, "r");
 
-            if (fp == NULL) {
-                snprintf(err_buf, sizeof(err_buf), "Invalid path: %s", abspath_buf);
+            if (run_python(abspath_buf) == -1) {
+                snprintf(err_buf, sizeof(err_buf), "Failed to queue autorun script: %s", abspath_buf);
                 api_display(err_buf);
-                continue;
             }
-
-            run_python(fp, abspath_buf);
-            fclose(fp);
         }
     }
 
@@ -32,6 +32,7 @@ char *api_get_nick(void);
 Tox_User_Status api_get_status(void);
 char *api_get_status_message(void);
 void api_send(const char *msg);
+void api_send_friend(uint32_t friendnumber, const char *msg);
 void api_execute(const char *input, int mode);
 int do_plugin_command(int num_args, char (*args)[MAX_STR_SIZE]);
 int num_registered_handlers(void);
@@ -39,5 +40,6 @@ int help_max_width(void);
 void draw_handler_help(WINDOW *win);
 void invoke_autoruns(ToxWindow *self, const char *autorun_path);
 void cmd_run(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char (*argv)[MAX_STR_SIZE]);
+void cmd_plugins(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char (*argv)[MAX_STR_SIZE]);
 
 #endif /* API_H */
@@ -658,10 +658,8 @@ DeviceError write_out(uint32_t device_idx, const int16_t *data, uint32_t sample_
 #ifdef AUDIO
 /* Adapted from qtox,
  * Copyright © 2014-2019 by The qTox Project Contributors
- *
- * return normalized volume of buffer in range 0.0-100.0
  */
-static float volume(int16_t *frame, uint32_t samples)
+float get_frame_volume(const int16_t *frame, uint32_t samples)
 {
     float sum_of_squares = 0;
 
@@ -722,7 +720,7 @@ static void *poll_input(void *arg)
                 pthread_mutex_lock(&Winthread.lock);
                 lock(input);
 
-                float frame_volume = volume(frame_buf, f_size);
+                float frame_volume = get_frame_volume(frame_buf, f_size);
 
                 audio_state->input_volume = frame_volume;
 
@@ -91,6 +91,9 @@ DeviceError write_out(uint32_t device_idx, const int16_t *data, uint32_t length,
 /* return current input volume as float in range 0.0-100.0 */
 float get_input_volume(void);
 
+/* return normalized volume of the first `samples` samples of `frame` in range 0.0-100.0 */
+float get_frame_volume(const int16_t *frame, uint32_t samples);
+
 void print_al_devices(ToxWindow *self, const Client_Config *c_config, DeviceType type);
 
 DeviceError selection_valid(DeviceType type, int32_t selection);
@@ -0,0 +1,331 @@
+/*  autosave.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "autosave.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tox/toxencryptsave.h>
+
+#include "misc_tools.h"
+#include "run_options.h"
+
+#define TEMP_PROFILE_EXT ".tmp"
+
+static struct Autosave {
+    pthread_t tid;
+    pthread_mutex_t lock;     /* guards everything below except `last`, `key` and `path` */
+    pthread_cond_t cond;
+    bool thread_running;
+    bool stop;
+    bool write_failed;
+
+    uint8_t *pending;         /* the newest snapshot that hasn't been written yet */
+    size_t pending_len;
+
+    /* Only touched by the writer thread, or by the caller before the writer is started */
+    uint8_t *last;            /* plaintext of the last snapshot written to disk */
+    size_t last_len;
+    Tox_Pass_Key *key;        /* NULL if the profile isn't encrypted */
+    char *path;
+} Autosave;
+
+static bool profile_is_encrypted(const Toxic *toxic)
+{
+    return toxic->client_data.is_encrypted && !toxic->run_opts->unencrypt_data;
+}
+
+/* Runs the password KDF once and caches the resulting key for all future saves.
+ *
+ * Return 0 on success.
+ * Return -1 on failure.
+ */
+static int autosave_load_key(const Toxic *toxic)
+{
+    if (Autosave.key != NULL || !profile_is_encrypted(toxic)) {
+        return 0;
+    }
+
+    Tox_Err_Key_Derivation err;
+    Autosave.key = tox_pass_key_derive((const uint8_t *) toxic->client_data.pass, toxic->client_data.pass_len, &err);
+
+    if (Autosave.key == NULL) {
+        fprintf(stderr, "tox_pass_key_derive() failed with error %d\n", err);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int autosave_load_path(const Toxic *toxic)
+{
+    if (Autosave.path != NULL) {
+        return 0;
+    }
+
+    const char *path = toxic->client_data.data_path;
+
+    if (path == NULL) {
+        return -1;
+    }
+
+    Autosave.path = strdup(path);
+
+    return Autosave.path != NULL ? 0 : -1;
+}
+
+/* Writes `length` bytes of `data` to the temporary profile file, flushes it to disk and
+ * moves it over the real profile.
+ *
+ * Return 0 on success.
+ * Return -1 on failure.
+ */
+static int autosave_write_file(const uint8_t *data, size_t length)
+{
+    const size_t temp_buf_size = strlen(Autosave.path) + strlen(TEMP_PROFILE_EXT) + 1;
+    char *temp_path = malloc(temp_buf_size);
+
+    if (temp_path == NULL) {
+        return -1;
+    }
+
+    snprintf(temp_path, temp_buf_size, "%s%s", Autosave.path, TEMP_PROFILE_EXT);
+
+    FILE *fp = fopen(temp_path, "wb");
+
+    if (fp == NULL) {
+        free(temp_path);
+        return -1;
+    }
+
+    if (fwrite(data, length, 1, fp) != 1 || fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+        fprintf(stderr, "Failed to write profile data.\n");
+        fclose(fp);
+        free(temp_path);
+        return -1;
+    }
+
+    if (fclose(fp) != 0) {
+        free(temp_path);
+        return -1;
+    }
+
+    if (rename(temp_path, Autosave.path) != 0) {
+        free(temp_path);
+        return -1;
+    }
+
+    free(temp_path);
+
+    return 0;
+}
+
+/* Encrypts `data` if necessary and writes it to disk, unless it's identical to the last
+ * snapshot that was written. Takes ownership of `data`.
+ *
+ * Return 0 on success.
+ * Return -1 on failure.
+ */
+static int autosave_write(uint8_t *data, size_t length)
+{
+    if (Autosave.last != NULL && Autosave.last_len == length && memcmp(Autosave.last, data, length) == 0) {
+        free(data);
+        return 0;
+    }
+
+    int ret;
+
+    if (Autosave.key != NULL) {
+        const size_t enc_len = length + TOX_PASS_ENCRYPTION_EXTRA_LENGTH;
+        uint8_t *enc_data = malloc(enc_len);
+
+        if (enc_data == NULL) {
+            free(data);
+            return -1;
+        }
+
+        Tox_Err_Encryption err;
+        tox_pass_key_encrypt(Autosave.key, data, length, enc_data, &err);
+
+        if (err != TOX_ERR_ENCRYPTION_OK) {
+            fprintf(stderr, "tox_pass_key_encrypt() failed with error %d\n", err);
+            free(enc_data);
+            free(data);
+            return -1;
+        }
+
+        ret = autosave_write_file(enc_data, enc_len);
+        free(enc_data);
+    } else {
+        ret = autosave_write_file(data, length);
+    }
+
+    if (ret != 0) {
+        free(data);
+        return -1;
+    }
+
+    free(Autosave.last);
+    Autosave.last = data;
+    Autosave.last_len = length;
+
+    return 0;
+}
+
+static void *autosave_thread(void *arg)
+{
+    UNUSED_VAR(arg);
+
+    pthread_mutex_lock(&Autosave.lock);
+
+    while (true) {
+        while (Autosave.pending == NULL && !Autosave.stop) {
+            pthread_cond_wait(&Autosave.cond, &Autosave.lock);
+        }
+
+        /* Pending snapshots are always written before we stop */
+        if (Autosave.pending == NULL) {
+            break;
+        }
+
+        uint8_t *data = Autosave.pending;
+        const size_t length = Autosave.pending_len;
+        Autosave.pending = NULL;
+        Autosave.pending_len = 0;
+
+        pthread_mutex_unlock(&Autosave.lock);
+
+        const int ret = autosave_write(data, length);
+
+        pthread_mutex_lock(&Autosave.lock);
+
+        if (ret != 0) {
+            Autosave.write_failed = true;
+        }
+    }
+
+    pthread_mutex_unlock(&Autosave.lock);
+
+    return NULL;
+}
+
+int autosave_init(const Toxic *toxic)
+{
+    if (Autosave.thread_running) {
+        return 0;
+    }
+
+    if (autosave_load_path(toxic) != 0 || autosave_load_key(toxic) != 0) {
+        return -1;
+    }
+
+    if (pthread_mutex_init(&Autosave.lock, NULL) != 0) {
+        return -1;
+    }
+
+    if (pthread_cond_init(&Autosave.cond, NULL) != 0) {
+        pthread_mutex_destroy(&Autosave.lock);
+        return -1;
+    }
+
+    if (pthread_create(&Autosave.tid, NULL, autosave_thread, NULL) != 0) {
+        pthread_cond_destroy(&Autosave.cond);
+        pthread_mutex_destroy(&Autosave.lock);
+        return -1;
+    }
+
+    Autosave.thread_running = true;
+
+    return 0;
+}
+
+int autosave_submit(const Toxic *toxic, uint8_t *data, size_t length)
+{
+    if (!Autosave.thread_running) {
+        if (autosave_load_path(toxic) != 0 || autosave_load_key(toxic) != 0) {
+            free(data);
+            return -1;
+        }
+
+        return autosave_write(data, length);
+    }
+
+    pthread_mutex_lock(&Autosave.lock);
+
+    free(Autosave.pending);
+    Autosave.pending = data;
+    Autosave.pending_len = length;
+
+    pthread_cond_signal(&Autosave.cond);
+    pthread_mutex_unlock(&Autosave.lock);
+
+    return 0;
+}
+
+bool autosave_write_failed(void)
+{
+    if (!Autosave.thread_running) {
+        return false;
+    }
+
+    pthread_mutex_lock(&Autosave.lock);
+
+    const bool failed = Autosave.write_failed;
+    Autosave.write_failed = false;
+
+    pthread_mutex_unlock(&Autosave.lock);
+
+    return failed;
+}
+
+void autosave_shutdown(void)
+{
+    if (Autosave.thread_running) {
+        pthread_mutex_lock(&Autosave.lock);
+        Autosave.stop = true;
+        pthread_cond_signal(&Autosave.cond);
+        pthread_mutex_unlock(&Autosave.lock);
+
+        pthread_join(Autosave.tid, NULL);
+
+        pthread_cond_destroy(&Autosave.cond);
+        pthread_mutex_destroy(&Autosave.lock);
+
+        Autosave.thread_running = false;
+        Autosave.stop = false;
+    }
+
+    if (Autosave.key != NULL) {
+        tox_pass_key_free(Autosave.key);
+        Autosave.key = NULL;
+    }
+
+    free(Autosave.last);
+    free(Autosave.path);
+    Autosave.last = NULL;
+    Autosave.last_len = 0;
+    Autosave.path = NULL;
+}
@@ -0,0 +1,68 @@
+/*  autosave.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "toxic.h"
+
+/*
+ * Derives the profile encryption key (if the profile is encrypted) and starts the background
+ * thread that writes the profile to disk. Until this is called, profile writes happen
+ * synchronously in the caller's thread.
+ *
+ * Must be called after the password has been entered and before any other threads are started.
+ *
+ * Return 0 on success.
+ * Return -1 on failure.
+ */
+int autosave_init(const Toxic *toxic);
+
+/*
+ * Hands a snapshot of the Tox savedata to the profile writer, which takes ownership of `data`.
+ * If the writer hasn't finished the previous snapshot yet, the older pending snapshot is
+ * replaced. Snapshots that are identical to the last one written are discarded.
+ *
+ * Return 0 on success. If the writer thread is running, this only means that the snapshot
+ * was queued.
+ * Return -1 on failure.
+ */
+int autosave_submit(const Toxic *toxic, uint8_t *data, size_t length);
+
+/*
+ * Returns true if a background write has failed since the last call.
+ *
+ * This function is thread safe.
+ */
+bool autosave_write_failed(void);
+
+/*
+ * Waits for any queued snapshot to be written, then stops the writer thread and frees the
+ * cached encryption key.
+ */
+void autosave_shutdown(void);
+
+#endif /* AUTOSAVE_H */
@@ -29,14 +29,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <time.h>
 
-#include <curl/curl.h>
 #include <tox/tox.h>
 
 #include "configdir.h"
-#include "curl_util.h"
 #include "line_info.h"
 #include "misc_tools.h"
+#include "nodes_fetch.h"
+#include "nodes_json.h"
 #include "prompt.h"
 #include "run_options.h"
 #include "settings.h"
@@ -62,32 +63,37 @@
 #define LAST_SCAN_JSON_KEY "\"last_scan\":"
 #define LAST_SCAN_JSON_KEY_LEN (sizeof(LAST_SCAN_JSON_KEY) - 1)
 
-#define IPV4_JSON_KEY "\"ipv4\":\""
-#define IPV4_JSON_KEY_LEN (sizeof(IPV4_JSON_KEY) - 1)
+/* Number of bytes of the nodes file that are read and parsed at a time */
+#define NODES_READ_CHUNK_SIZE 4096
 
-#define IPV6_JSON_KEY "\"ipv6\":\""
-#define IPV6_JSON_KEY_LEN (sizeof(IPV6_JSON_KEY) - 1)
+/* Appended to the nodes list path to get the path of the node health file */
+#define NODE_HEALTH_FILE_EXT ".health"
 
-#define PORT_JSON_KEY "\"port\":"
-#define PORT_JSON_KEY_LEN (sizeof(PORT_JSON_KEY) - 1)
+/* Health records are written here first and renamed over the real file */
+#define TEMP_HEALTH_FILE_EXT ".tmp"
 
-#define PK_JSON_KEY "\"public_key\":\""
-#define PK_JSON_KEY_LEN (sizeof(PK_JSON_KEY) - 1)
+/* Minimum number of seconds between saves of the node health records while we're offline */
+#define NODE_HEALTH_SAVE_INTERVAL 60
 
-#define LAST_PING_JSON_KEY "\"last_ping\":"
-#define LAST_PING_JSON_KEY_LEN (sizeof(LAST_PING_JSON_KEY) - 1)
+/* Maximum number of nodes we remember health records for */
+#define MAX_NODE_HEALTH_RECORDS 200
 
-/* Maximum allowable size of the nodes list */
-#define MAX_NODELIST_SIZE (MAX_RECV_CURL_DATA_SIZE)
+/* Number of seconds a node is skipped after its first failure. Doubles with each consecutive failure. */
+#define NODE_BACKOFF_BASE 30
+#define NODE_BACKOFF_MAX (60 * 60 * 6)
+
+/* Assumed time-to-online for nodes we have no record of. Nodes that have been
+ * faster than this before are preferred over unknown nodes. */
+#define UNKNOWN_NODE_CONNECT_MS (TRY_BOOTSTRAP_INTERVAL * 1000)
 
 static struct Thread_Data {
     pthread_t tid;
     pthread_attr_t attr;
     pthread_mutex_t lock;
+    bool lock_initialized;
     volatile bool active;
 } thread_data;
 
-#define MAX_NODES 50
 struct Node {
     char ip4[IP_MAX_SIZE + 1];
     bool have_ip4;
@@ -99,12 +105,55 @@ struct Node {
     uint16_t port;
 };
 
+struct Node_List {
+    struct Node *list;
+    size_t count;
+    size_t capacity;
+};
+
+/* Guarded by thread_data.lock */
 static struct DHT_Nodes {
-    struct Node list[MAX_NODES];
+    struct Node *list;
     size_t count;
     time_t last_updated;
 } Nodes;
 
+/* How well a node has worked for us in the past. Persisted across runs. */
+struct Node_Health {
+    char key[TOX_PUBLIC_KEY_SIZE];
+    uint32_t successes;
+    uint32_t failures;
+    uint32_t consecutive_failures;
+    uint32_t avg_connect_ms;    /* moving average of the time between bootstrapping and going online */
+    time_t backoff_until;       /* the node isn't used before this time */
+};
+
+/* Guarded by thread_data.lock */
+static struct Node_Health_Cache {
+    struct Node_Health list[MAX_NODE_HEALTH_RECORDS];
+    size_t count;
+    char path[PATH_MAX];
+    bool dirty;
+    time_t last_save;
+} Health;
+
+/* State of the current connection attempt. Only accessed by the Tox thread. */
+static struct Bootstrap_State {
+    char batch[NUM_BOOTSTRAP_NODES][TOX_PUBLIC_KEY_SIZE];   /* nodes used in the last bootstrap attempt */
+    size_t batch_size;
+    uint64_t start_ms;      /* when we first tried to connect */
+    uint64_t attempt_ms;    /* when the last bootstrap attempt was made */
+    bool connected;
+    bool reported;          /* true once time-to-online has been reported */
+} Bootstrap;
+
+static uint64_t bootstrap_time_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t) t.tv_sec) * 1000 + ((uint64_t) t.tv_nsec) / 1000000;
+}
+
 /* Return true if address appears to be a valid ipv4 address. */
 static bool is_ip4_address(const char *address)
 {
@@ -145,173 +194,189 @@ static bool node_is_offline(unsigned long long int last_ping)
     return last_ping + NODE_OFFLINE_TIMOUT <= last_ping;
 }
 
-/* Return true if nodeslist pointed to by fp needs to be updated.
- * This will be the case if the file is empty, has an invalid format,
- * or if the file is older than the given timeout.
+/* Validates the values of a nodes list entry and puts them in node.
+ *
+ * Return 0 on success.
+ * Return -3 if node appears to be offline.
+ * Return -4 if entry does not contain either a valid ipv4 or ipv6 address.
+ * Return -5 if port value is invalid.
+ * Return -6 if public key is invalid.
  */
-static bool nodeslist_needs_update(const char *nodes_path, int update_frequency)
+static int node_from_json(const Nodes_JSON_Node *json_node, struct Node *node)
 {
-    if (update_frequency <= 0) {
-        return false;
+    if (json_node->last_ping <= 0 || node_is_offline(json_node->last_ping)) {
+        return -3;
     }
 
-    FILE *fp = fopen(nodes_path, "r+");
+    const size_t ip4_len = strlen(json_node->ipv4);
+    const size_t ip6_len = strlen(json_node->ipv6);
 
-    if (fp == NULL) {
-        return false;
+    const bool have_ip4 = ip4_len >= IP_MIN_SIZE && ip4_len <= IP_MAX_SIZE && is_ip4_address(json_node->ipv4);
+    const bool have_ip6 = ip6_len >= IP_MIN_SIZE && ip6_len <= IP_MAX_SIZE && is_ip6_address(json_node->ipv6);
+
+    if (!have_ip6 && !have_ip4) {
+        return -4;
     }
 
-    /* last_scan value should be at beginning of file */
-    char line[LAST_SCAN_JSON_KEY_LEN + 32];
+    if (json_node->port <= 0 || json_node->port > MAX_PORT_RANGE) {
+        return -5;
+    }
 
-    if (fgets(line, sizeof(line), fp) == NULL) {
-        fclose(fp);
-        return true;
+    const size_t key_len = strlen(json_node->public_key);
+
+    if (key_len != TOX_PUBLIC_KEY_SIZE * 2) {
+        return -6;
     }
 
-    fclose(fp);
+    if (tox_pk_string_to_bytes(json_node->public_key, key_len, node->key, sizeof(node->key)) == -1) {
+        return -6;
+    }
 
-    const char *last_scan_val = strstr(line, LAST_SCAN_JSON_KEY);
+    node->have_ip4 = have_ip4;
+    node->have_ip6 = have_ip6;
 
-    if (last_scan_val == NULL) {
-        return true;
+    if (have_ip4) {
+        snprintf(node->ip4, sizeof(node->ip4), "%s", json_node->ipv4);
     }
 
-    long long int last_scan = strtoll(last_scan_val + LAST_SCAN_JSON_KEY_LEN, NULL, 10);
+    if (have_ip6) {
+        snprintf(node->ip6, sizeof(node->ip6), "%s", json_node->ipv6);
+    }
 
-    pthread_mutex_lock(&thread_data.lock);
-    Nodes.last_updated = last_scan;
-    pthread_mutex_unlock(&thread_data.lock);
+    node->port = (uint16_t) json_node->port;
 
-    pthread_mutex_lock(&Winthread.lock);
-    bool is_timeout = timed_out(last_scan, update_frequency * 24 * 60 * 60);
-    pthread_mutex_unlock(&Winthread.lock);
+    return 0;
+}
 
-    if (is_timeout) {
-        return true;
+/* Adds each valid entry of the nodes list to the Node_List pointed to by `user_data`. */
+static void on_json_node(const Nodes_JSON_Node *json_node, void *user_data)
+{
+    struct Node_List *nodes = (struct Node_List *) user_data;
+
+    if (nodes->count == nodes->capacity) {
+        const size_t new_capacity = nodes->capacity > 0 ? nodes->capacity * 2 : 64;
+        struct Node *new_list = realloc(nodes->list, new_capacity * sizeof(struct Node));
+
+        if (new_list == NULL) {
+            return;
+        }
+
+        nodes->list = new_list;
+        nodes->capacity = new_capacity;
     }
 
-    return false;
+    if (node_from_json(json_node, &nodes->list[nodes->count]) == 0) {
+        ++nodes->count;
+    }
 }
 
-/* Fetches the JSON encoded DHT nodeslist from NODES_LIST_URL.
+static bool json_node_is_valid(const Nodes_JSON_Node *json_node)
+{
+    struct Node node;
+    return node_from_json(json_node, &node) == 0;
+}
+
+/* Parses the nodes list in the file at `nodes_path` and puts all valid entries in `nodes`.
  *
  * Return 0 on success.
- * Return -1 on failure.
+ * Return -1 if the file can't be opened.
+ * Return -2 if the file isn't a well-formed nodes list.
  */
-static int curl_fetch_nodes_JSON(const Run_Options *run_opts, struct Recv_Curl_Data *recv_data)
+static int parse_nodeslist_file(const char *nodes_path, struct Node_List *nodes)
 {
-    CURL *c_handle = curl_easy_init();
+    FILE *fp = fopen(nodes_path, "r");
 
-    if (c_handle == NULL) {
+    if (fp == NULL) {
         return -1;
     }
 
-    int err = -1;
-
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, "charsets: utf-8");
+    Nodes_JSON_Parser parser;
+    nodes_json_init(&parser, on_json_node, nodes);
 
-    int ret = curl_easy_setopt(c_handle, CURLOPT_HTTPHEADER, headers);
+    char buf[NODES_READ_CHUNK_SIZE];
+    size_t length;
+    int ret = 0;
 
-    if (ret != CURLE_OK) {
-        fprintf(stderr, "Failed to set http headers (libcurl error %d)", ret);
-        goto on_exit;
+    while ((length = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        if (nodes_json_feed(&parser, buf, length) != 0) {
+            ret = -2;
+            break;
+        }
     }
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_URL, NODES_LIST_URL);
-
-    if (ret != CURLE_OK) {
-        fprintf(stderr, "Failed to set url (libcurl error %d)", ret);
-        goto on_exit;
+    if (ret == 0 && (ferror(fp) || nodes_json_finish(&parser) != 0)) {
+        ret = -2;
     }
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_WRITEFUNCTION, curl_cb_write_data);
-
-    if (ret != CURLE_OK) {
-        fprintf(stderr, "Failed to set write function callback (libcurl error %d)", ret);
-        goto on_exit;
-    }
+    fclose(fp);
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_WRITEDATA, recv_data);
+    return ret;
+}
 
-    if (ret != CURLE_OK) {
-        fprintf(stderr, "Failed to set write data (libcurl error %d)", ret);
-        goto on_exit;
+/* Return true if nodeslist pointed to by fp needs to be updated.
+ * This will be the case if the file is empty, has an invalid format,
+ * or if the file is older than the given timeout.
+ */
+static bool nodeslist_needs_update(const char *nodes_path, int update_frequency)
+{
+    if (update_frequency <= 0) {
+        return false;
     }
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+    FILE *fp = fopen(nodes_path, "r");
 
-    if (ret != CURLE_OK) {
-        fprintf(stderr, "Failed to set useragent (libcurl error %d)", ret);
-        goto on_exit;
+    if (fp == NULL) {
+        return true;
     }
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_HTTPGET, 1L);
+    /* last_scan value should be at beginning of file */
+    char line[LAST_SCAN_JSON_KEY_LEN + 32];
 
-    if (ret != CURLE_OK) {
-        fprintf(stderr, "Failed to set get request (libcurl error %d)", ret);
-        goto on_exit;
+    if (fgets(line, sizeof(line), fp) == NULL) {
+        fclose(fp);
+        return true;
     }
 
-    int proxy_ret = set_curl_proxy(c_handle, run_opts->proxy_address, run_opts->proxy_port, run_opts->proxy_type);
-
-    if (proxy_ret != 0) {
-        fprintf(stderr, "set_curl_proxy() failed with error %d\n", proxy_ret);
-        goto on_exit;
-    }
+    fclose(fp);
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
+    const char *last_scan_val = strstr(line, LAST_SCAN_JSON_KEY);
 
-    if (ret != CURLE_OK) {
-        fprintf(stderr, "TLSv1.2 could not be set (libcurl error %d)", ret);
-        goto on_exit;
+    if (last_scan_val == NULL) {
+        return true;
     }
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_SSL_CIPHER_LIST, TLS_CIPHER_SUITE_LIST);
-
-    if (ret != CURLE_OK) {
-        fprintf(stderr, "Failed to set TLS cipher list (libcurl error %d)", ret);
-        goto on_exit;
-    }
+    long long int last_scan = strtoll(last_scan_val + LAST_SCAN_JSON_KEY_LEN, NULL, 10);
 
-    ret = curl_easy_perform(c_handle);
+    pthread_mutex_lock(&thread_data.lock);
+    Nodes.last_updated = last_scan;
+    pthread_mutex_unlock(&thread_data.lock);
 
-    if (ret != CURLE_OK) {
-        /* If system doesn't support any of the specified ciphers suites, fall back to default */
-        if (ret == CURLE_SSL_CIPHER) {
-            ret = curl_easy_setopt(c_handle, CURLOPT_SSL_CIPHER_LIST, NULL);
+    /* The server may have told us that our copy is still current since it was scanned */
+    const time_t last_checked = last_scan > 0 ? nodes_fetch_last_checked(nodes_path) : 0;
 
-            if (ret != CURLE_OK) {
-                fprintf(stderr, "Failed to set SSL cipher list (libcurl error %d)\n", ret);
-                goto on_exit;
-            }
+    if (last_checked > last_scan) {
+        last_scan = last_checked;
+    }
 
-            ret = curl_easy_perform(c_handle);
-        }
+    pthread_mutex_lock(&Winthread.lock);
+    bool is_timeout = timed_out(last_scan, update_frequency * 24 * 60 * 60);
+    pthread_mutex_unlock(&Winthread.lock);
 
-        if (ret != CURLE_OK) {
-            fprintf(stderr, "HTTPS lookup error (libcurl error %d)\n", ret);
-            goto on_exit;
-        }
+    if (is_timeout) {
+        return true;
     }
 
-    err = 0;
-
-on_exit:
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(c_handle);
-    return err;
+    return false;
 }
 
-/* Attempts to update the DHT nodeslist.
+/* Attempts to update the DHT nodeslist. The request is conditional on the list we already
+ * have, and the current list is only replaced once the new one has been validated.
  *
  * Return 1 if list was updated successfully.
  * Return 0 if list does not need to be updated.
  * Return -1 if file cannot be opened.
  * Return -2 if http lookup failed.
- * Return -3 if http reponse was empty.
+ * Return -3 if http reponse was empty or did not contain any valid entries.
  * Return -4 if data could not be written to disk.
  * Return -5 if memory allocation fails.
  */
@@ -321,41 +386,15 @@ static int update_DHT_nodeslist(const Run_Options *run_opts, const char *nodes_p
         return 0;
     }
 
-    FILE *fp = fopen(nodes_path, "r+");
-
-    if (fp == NULL) {
-        return -1;
-    }
-
-    struct Recv_Curl_Data *recv_data = calloc(1, sizeof(struct Recv_Curl_Data));
-
-    if (recv_data == NULL) {
-        fclose(fp);
-        return -5;
-    }
-
-    if (curl_fetch_nodes_JSON(run_opts, recv_data) == -1) {
-        free(recv_data);
-        fclose(fp);
-        return -2;
-    }
-
-    if (recv_data->length == 0) {
-        free(recv_data);
-        fclose(fp);
-        return -3;
-    }
-
-    if (fwrite(recv_data->data, recv_data->length, 1, fp) != 1) {
-        free(recv_data);
-        fclose(fp);
-        return -4;
-    }
-
-    free(recv_data);
-    fclose(fp);
+    const Nodes_Fetch_Options opts = {
+        .url = NODES_LIST_URL,
+        .proxy_address = run_opts->proxy_address,
+        .proxy_port = run_opts->proxy_port,
+        .proxy_type = run_opts->proxy_type,
+        .node_valid_cb = json_node_is_valid,
+    };
 
-    return 1;
+    return nodes_fetch(&opts, nodes_path, NULL);
 }
 
 static void get_nodeslist_path(const Run_Options *run_opts, char *buf, size_t buf_size)
@@ -372,143 +411,194 @@ static void get_nodeslist_path(const Run_Options *run_opts, char *buf, size_t bu
     }
 }
 
-/* Return true if json encoded string s contains a valid IP address and puts address in ip_buf.
+/* Returns the health record for the node with public key `key`, or NULL if we don't have one.
  *
- * ip_type should be set to 1 for ipv4 address, or 0 for ipv6 addresses.
- * ip_buf must have room for at least IP_MAX_SIZE + 1 bytes.
+ * Must be called with thread_data.lock held.
  */
-static bool extract_val_ip(const char *s, char *ip_buf, unsigned short int ip_type)
+static struct Node_Health *node_health_get(const char *key)
 {
-    int ip_len = char_find(0, s, '"');
-
-    if (ip_len < IP_MIN_SIZE || ip_len > IP_MAX_SIZE) {
-        return false;
+    for (size_t i = 0; i < Health.count; ++i) {
+        if (memcmp(Health.list[i].key, key, TOX_PUBLIC_KEY_SIZE) == 0) {
+            return &Health.list[i];
+        }
     }
 
-    memcpy(ip_buf, s, ip_len);
-    ip_buf[ip_len] = 0;
-
-    return (ip_type == 1) ? is_ip4_address(ip_buf) : is_ip6_address(ip_buf);
+    return NULL;
 }
 
-/* Extracts the port from json encoded string s.
+/* Returns the health record for the node with public key `key`, creating it if necessary.
+ * If the cache is full the record of the node that has failed the most is recycled.
  *
- * Return port number on success.
- * Return 0 on failure.
+ * Must be called with thread_data.lock held.
  */
-static uint16_t extract_val_port(const char *s)
+static struct Node_Health *node_health_new(const char *key)
 {
-    long int port = strtol(s, NULL, 10);
-    return (port > 0 && port <= MAX_PORT_RANGE) ? port : 0;
+    struct Node_Health *health = node_health_get(key);
+
+    if (health != NULL) {
+        return health;
+    }
+
+    if (Health.count < MAX_NODE_HEALTH_RECORDS) {
+        health = &Health.list[Health.count++];
+    } else {
+        health = &Health.list[0];
+
+        for (size_t i = 1; i < Health.count; ++i) {
+            const int64_t score = (int64_t) Health.list[i].failures - Health.list[i].successes;
+
+            if (score > (int64_t) health->failures - health->successes) {
+                health = &Health.list[i];
+            }
+        }
+    }
+
+    *health = (struct Node_Health) {
+        0
+    };
+
+    memcpy(health->key, key, TOX_PUBLIC_KEY_SIZE);
+
+    return health;
 }
 
-/* Extracts the last pinged value from json encoded string s.
- *
- * Return timestamp on success.
- * Return -1 on failure.
- */
-static long long int extract_val_last_pinged(const char *s)
+/* Must be called with thread_data.lock held. */
+static void node_health_success(const char *key, uint64_t connect_ms)
 {
-    long long int last_pinged = strtoll(s, NULL, 10);
-    return (last_pinged <= 0) ? -1 : last_pinged;
+    struct Node_Health *health = node_health_new(key);
+
+    const uint32_t ms = connect_ms > UINT32_MAX ? UINT32_MAX : (uint32_t) connect_ms;
+
+    health->avg_connect_ms = health->successes == 0 ? ms : (uint32_t)(((uint64_t) health->avg_connect_ms * 3 + ms) / 4);
+    ++health->successes;
+    health->consecutive_failures = 0;
+    health->backoff_until = 0;
+
+    Health.dirty = true;
 }
 
-/* Extracts DHT public key from json encoded string s and puts key in key_buf.
- * key_buf must have room for at least TOX_PUBLIC_KEY_SIZE * 2 + 1 bytes.
- *
- * Return number of bytes copied to key_buf on success.
- * Return -1 on failure.
- */
-static int extract_val_pk(const char *s, char *key_buf, size_t buf_length)
+/* Must be called with thread_data.lock held. */
+static void node_health_failure(const char *key)
 {
-    if (buf_length < TOX_PUBLIC_KEY_SIZE * 2 + 1) {
-        return -1;
+    struct Node_Health *health = node_health_new(key);
+
+    ++health->failures;
+
+    if (health->consecutive_failures < 31) {
+        ++health->consecutive_failures;
     }
 
-    int key_len = char_find(0, s, '"');
+    uint64_t backoff = (uint64_t) NODE_BACKOFF_BASE << (health->consecutive_failures - 1);
 
-    if (key_len != TOX_PUBLIC_KEY_SIZE * 2) {
-        return -1;
+    if (backoff > NODE_BACKOFF_MAX) {
+        backoff = NODE_BACKOFF_MAX;
     }
 
-    memcpy(key_buf, s, key_len);
-    key_buf[key_len] = 0;
+    health->backoff_until = get_unix_time() + (time_t) backoff;
 
-    return key_len;
+    Health.dirty = true;
 }
 
-/* Extracts values from json formatted string, validats them, and puts them in node.
+/* Loads node health records from the file next to the nodes list at `nodes_path`.
  *
- * Return 0 on success.
- * Return -1 if line is empty.
- * Return -2 if line does not appear to be a valid nodes list entry.
- * Return -3 if node appears to be offline.
- * Return -4 if entry does not contain either a valid ipv4 or ipv6 address.
- * Return -5 if port value is invalid.
- * Return -6 if public key is invalid.
+ * Each line holds one record: the node's public key followed by its successes, failures,
+ * consecutive failures, average connect time in milliseconds and backoff expiry time.
+ *
+ * Must be called with thread_data.lock held.
  */
-static int extract_node(const char *line, struct Node *node)
+static void node_health_load(const char *nodes_path)
 {
-    if (!line) {
-        return -1;
-    }
+    snprintf(Health.path, sizeof(Health.path), "%s%s", nodes_path, NODE_HEALTH_FILE_EXT);
 
-    const char *ip4_start = strstr(line, IPV4_JSON_KEY);
-    const char *ip6_start = strstr(line, IPV6_JSON_KEY);
-    const char *port_start = strstr(line, PORT_JSON_KEY);
-    const char *key_start = strstr(line, PK_JSON_KEY);
-    const char *last_pinged_str = strstr(line, LAST_PING_JSON_KEY);
+    FILE *fp = fopen(Health.path, "r");
 
-    if (!ip4_start || !ip6_start || !port_start || !key_start || !last_pinged_str) {
-        return -2;
+    if (fp == NULL) {
+        return;
     }
 
-    long long int last_pinged = extract_val_last_pinged(last_pinged_str + LAST_PING_JSON_KEY_LEN);
+    Health.count = 0;
 
-    if (last_pinged <= 0 || node_is_offline(last_pinged)) {
-        return -3;
-    }
+    char line[256];
 
-    char ip4_string[IP_MAX_SIZE + 1];
-    bool have_ip4 = extract_val_ip(ip4_start + IPV4_JSON_KEY_LEN, ip4_string, 1);
+    while (Health.count < MAX_NODE_HEALTH_RECORDS && fgets(line, sizeof(line), fp) != NULL) {
+        char key_string[TOX_PUBLIC_KEY_SIZE * 2 + 1];
+        unsigned int successes;
+        unsigned int failures;
+        unsigned int consecutive_failures;
+        unsigned int avg_connect_ms;
+        long long int backoff_until;
 
-    char ip6_string[IP_MAX_SIZE + 1];
-    bool have_ip6 = extract_val_ip(ip6_start + IPV6_JSON_KEY_LEN, ip6_string, 0);
+        if (sscanf(line, "%64s %u %u %u %u %lld", key_string, &successes, &failures, &consecutive_failures,
+                   &avg_connect_ms, &backoff_until) != 6) {
+            continue;
+        }
 
-    if (!have_ip6 && !have_ip4) {
-        return -4;
-    }
+        struct Node_Health *health = &Health.list[Health.count];
 
-    uint16_t port = extract_val_port(port_start + PORT_JSON_KEY_LEN);
+        if (tox_pk_string_to_bytes(key_string, strlen(key_string), health->key, sizeof(health->key)) != 0) {
+            continue;
+        }
 
-    if (port == 0) {
-        return -5;
+        health->successes = successes;
+        health->failures = failures;
+        health->consecutive_failures = consecutive_failures > 31 ? 31 : consecutive_failures;
+        health->avg_connect_ms = avg_connect_ms;
+        health->backoff_until = (time_t) backoff_until;
+
+        ++Health.count;
     }
 
-    char key_string[TOX_PUBLIC_KEY_SIZE * 2 + 1];
-    int key_len = extract_val_pk(key_start + PK_JSON_KEY_LEN, key_string, sizeof(key_string));
+    fclose(fp);
+}
 
-    if (key_len == -1) {
-        return -6;
+/* Writes the node health records to disk if they've changed.
+ *
+ * Must be called with thread_data.lock held.
+ */
+static void node_health_save(void)
+{
+    if (!Health.dirty || string_is_empty(Health.path)) {
+        return;
     }
 
-    if (tox_pk_string_to_bytes(key_string, key_len, node->key, sizeof(node->key)) == -1) {
-        return -6;
+    char temp_path[PATH_MAX + sizeof(TEMP_HEALTH_FILE_EXT)];
+    snprintf(temp_path, sizeof(temp_path), "%s%s", Health.path, TEMP_HEALTH_FILE_EXT);
+
+    FILE *fp = fopen(temp_path, "w");
+
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open node health file '%s'\n", temp_path);
+        return;
     }
 
-    if (have_ip4) {
-        snprintf(node->ip4, sizeof(node->ip4), "%s", ip4_string);
-        node->have_ip4 = true;
+    for (size_t i = 0; i < Health.count; ++i) {
+        const struct Node_Health *health = &Health.list[i];
+        char key_string[TOX_PUBLIC_KEY_SIZE * 2 + 1];
+
+        if (tox_pk_bytes_to_str((const uint8_t *) health->key, sizeof(health->key), key_string, sizeof(key_string)) != 0) {
+            continue;
+        }
+
+        fprintf(fp, "%s %u %u %u %u %lld\n", key_string, health->successes, health->failures,
+                health->consecutive_failures, health->avg_connect_ms, (long long int) health->backoff_until);
     }
 
-    if (have_ip6) {
-        snprintf(node->ip6, sizeof(node->ip6), "%s", ip6_string);
-        node->have_ip6 = true;
+    const bool write_err = ferror(fp) != 0;
+
+    if (fclose(fp) != 0 || write_err) {
+        fprintf(stderr, "Failed to write node health file '%s'\n", temp_path);
+        remove(temp_path);
+        return;
     }
 
-    node->port = port;
+    if (rename(temp_path, Health.path) != 0) {
+        fprintf(stderr, "Failed to rename node health file '%s'\n", temp_path);
+        remove(temp_path);
+        return;
+    }
 
-    return 0;
+    Health.dirty = false;
+    Health.last_save = get_unix_time();
 }
 
 /* Loads the DHT nodeslist to memory from json encoded nodes file. */
@@ -524,18 +614,6 @@ static void *load_nodeslist_thread(void *data)
     char nodes_path[PATH_MAX];
     get_nodeslist_path(toxic->run_opts, nodes_path, sizeof(nodes_path));
 
-    FILE *fp = NULL;
-
-    if (!file_exists(nodes_path)) {
-        if ((fp = fopen(nodes_path, "w+")) == NULL) {
-            fprintf(stderr, "nodeslist load error: failed to create file '%s'\n", nodes_path);
-            goto on_exit;
-        }
-    } else if ((fp = fopen(nodes_path, "r+")) == NULL) {
-        fprintf(stderr, "nodeslist load error: failed to open file '%s'\n", nodes_path);
-        goto on_exit;
-    }
-
     const Client_Config *c_config = toxic->c_config;
 
     const int update_err = update_DHT_nodeslist(toxic->run_opts, nodes_path, c_config->nodeslist_update_freq);
@@ -544,50 +622,51 @@ static void *load_nodeslist_thread(void *data)
         fprintf(stderr, "update_DHT_nodeslist() failed with error %d\n", update_err);
     }
 
-    char line[MAX_NODELIST_SIZE + 1];
+    struct Node_List nodes = {0};
 
-    if (fgets(line, sizeof(line), fp) == NULL) {
-        fclose(fp);
-        fprintf(stderr, "nodeslist load error: file empty.\n");
+    const int parse_err = parse_nodeslist_file(nodes_path, &nodes);
+
+    if (parse_err == -1) {
+        fprintf(stderr, "nodeslist load error: failed to open file '%s'\n", nodes_path);
         goto on_exit;
     }
 
-    size_t idx = 0;
-    const char *line_start = line;
+    if (parse_err != 0) {
+        fprintf(stderr, "nodeslist load error: file is malformed.\n");
+    }
 
-    while ((line_start = strstr(line_start + 1, IPV4_JSON_KEY))) {
-        pthread_mutex_lock(&thread_data.lock);
-        idx = Nodes.count;
+    /* If nodeslist does not contain any valid entries we set the last_scan value
+     * to 0 so that it will fetch a new list the next time this function is called.
+     */
+    if (nodes.count == 0) {
+        free(nodes.list);
 
-        if (idx >= MAX_NODES) {
-            pthread_mutex_unlock(&thread_data.lock);
-            break;
-        }
+        FILE *fp = fopen(nodes_path, "w");
 
-        if (extract_node(line_start, &Nodes.list[idx]) == 0) {
-            ++Nodes.count;
+        if (fp != NULL) {
+            const char *s = "{\"last_scan\":0}";
+            fwrite(s, strlen(s), 1, fp);  // Not much we can do if it fails
+            fclose(fp);
         }
 
-        pthread_mutex_unlock(&thread_data.lock);
+        nodes_fetch_clear_cache(nodes_path);
+
+        fprintf(stderr, "nodeslist load error: List did not contain any valid entries.\n");
+        goto on_exit;
     }
 
+    /* The list may be reloaded periodically, in which case the new list replaces the old one */
     pthread_mutex_lock(&thread_data.lock);
-    const size_t num_nodes = Nodes.count;
-    pthread_mutex_unlock(&thread_data.lock);
 
-    /* If nodeslist does not contain any valid entries we set the last_scan value
-     * to 0 so that it will fetch a new list the next time this function is called.
-     */
-    if (num_nodes == 0) {
-        const char *s = "{\"last_scan\":0}";
-        rewind(fp);
-        fwrite(s, strlen(s), 1, fp);  // Not much we can do if it fails
-        fclose(fp);
-        fprintf(stderr, "nodeslist load error: List did not contain any valid entries.\n");
-        goto on_exit;
+    free(Nodes.list);
+    Nodes.list = nodes.list;
+    Nodes.count = nodes.count;
+
+    if (!Health.dirty) {
+        node_health_load(nodes_path);
     }
 
-    fclose(fp);
+    pthread_mutex_unlock(&thread_data.lock);
 
 on_exit:
     thread_data.active = false;
@@ -612,8 +691,12 @@ int load_DHT_nodeslist(Toxic *toxic)
         return -1;
     }
 
-    if (pthread_mutex_init(&thread_data.lock, NULL) != 0) {
-        return -2;
+    if (!thread_data.lock_initialized) {
+        if (pthread_mutex_init(&thread_data.lock, NULL) != 0) {
+            return -2;
+        }
+
+        thread_data.lock_initialized = true;
     }
 
     if (pthread_attr_init(&thread_data.attr) != 0) {
@@ -634,7 +717,35 @@ int load_DHT_nodeslist(Toxic *toxic)
     return 0;
 }
 
-/* Connects to NUM_BOOTSTRAP_NODES random DHT nodes listed in the DHTnodes file. */
+/* Returns the bootstrap ranking score of `node`. Lower is better.
+ * Returns -1 if the node is backing off after recent failures.
+ *
+ * Must be called with thread_data.lock held.
+ */
+static int64_t node_score(const struct Node *node, time_t now)
+{
+    const struct Node_Health *health = node_health_get(node->key);
+
+    /* a little jitter so that we don't always try the same unknown nodes in the same order */
+    const int64_t jitter = rand_range_not_secure(1000);
+
+    if (health == NULL) {
+        return UNKNOWN_NODE_CONNECT_MS + jitter;
+    }
+
+    if (health->backoff_until > now) {
+        return -1;
+    }
+
+    const int64_t connect_ms = health->successes > 0 ? health->avg_connect_ms : UNKNOWN_NODE_CONNECT_MS;
+
+    /* nodes that fail often are pushed down the list even when they're fast once they work */
+    return connect_ms * (1 + (int64_t) health->failures) / (1 + (int64_t) health->successes) + jitter;
+}
+
+/* Connects to the NUM_BOOTSTRAP_NODES best-ranked DHT nodes listed in the DHTnodes file. Nodes
+ * that are backing off after recent failures are only used if there's nothing else left.
+ */
 static void DHT_bootstrap(Tox *tox)
 {
     pthread_mutex_lock(&thread_data.lock);
@@ -647,8 +758,43 @@ static void DHT_bootstrap(Tox *tox)
 
     pthread_mutex_lock(&thread_data.lock);
 
-    for (size_t i = 0; i < NUM_BOOTSTRAP_NODES; ++i) {
-        const unsigned int idx = rand_range_not_secure(Nodes.count);
+    const time_t now = get_unix_time();
+
+    /* the NUM_BOOTSTRAP_NODES best nodes, best first */
+    size_t order[NUM_BOOTSTRAP_NODES];
+    int64_t scores[NUM_BOOTSTRAP_NODES];
+    size_t num_ranked = 0;
+
+    for (size_t i = 0; i < Nodes.count; ++i) {
+        const int64_t score = node_score(&Nodes.list[i], now);
+
+        if (score < 0) {
+            continue;
+        }
+
+        if (num_ranked == NUM_BOOTSTRAP_NODES && score >= scores[num_ranked - 1]) {
+            continue;
+        }
+
+        size_t j = num_ranked < NUM_BOOTSTRAP_NODES ? num_ranked++ : num_ranked - 1;
+
+        while (j > 0 && scores[j - 1] > score) {
+            scores[j] = scores[j - 1];
+            order[j] = order[j - 1];
+            --j;
+        }
+
+        scores[j] = score;
+        order[j] = i;
+    }
+
+    Bootstrap.batch_size = 0;
+
+    /* every node is backing off; fall back to picking at random */
+    const size_t num_picks = num_ranked > 0 ? num_ranked : NUM_BOOTSTRAP_NODES;
+
+    for (size_t i = 0; i < num_picks; ++i) {
+        const size_t idx = num_ranked > 0 ? order[i] : rand_range_not_secure(Nodes.count);
         struct Node *node = &Nodes.list[idx];
 
         const char *addr = node->have_ip4 ? node->ip4 : node->ip6;
@@ -669,9 +815,38 @@ static void DHT_bootstrap(Tox *tox)
         if (err != TOX_ERR_BOOTSTRAP_OK) {
             fprintf(stderr, "Failed to add TCP relay %s:%d\n", addr, node->port);
         }
+
+        memcpy(Bootstrap.batch[Bootstrap.batch_size++], node->key, TOX_PUBLIC_KEY_SIZE);
+    }
+
+    pthread_mutex_unlock(&thread_data.lock);
+}
+
+/* Credits the nodes from the last bootstrap attempt with getting us online and reports the
+ * time it took to come online the first time.
+ */
+static void on_bootstrap_connected(Toxic *toxic)
+{
+    const uint64_t now = bootstrap_time_ms();
+
+    pthread_mutex_lock(&thread_data.lock);
+
+    for (size_t i = 0; i < Bootstrap.batch_size; ++i) {
+        node_health_success(Bootstrap.batch[i], now - Bootstrap.attempt_ms);
     }
 
+    Bootstrap.batch_size = 0;
+    node_health_save();
+
     pthread_mutex_unlock(&thread_data.lock);
+
+    if (!Bootstrap.reported && Bootstrap.start_ms > 0) {
+        const uint64_t elapsed = now - Bootstrap.start_ms;
+        line_info_add(toxic->home_window, toxic->c_config, false, NULL, NULL, SYS_MSG, 0, 0,
+                      "Connected to the Tox network in %llu.%01llu seconds",
+                      (unsigned long long) elapsed / 1000, (unsigned long long)(elapsed % 1000) / 100);
+        Bootstrap.reported = true;
+    }
 }
 
 /* Manages connection to the Tox DHT network. */
@@ -684,8 +859,50 @@ void do_tox_connection(Toxic *toxic)
     static time_t last_bootstrap_time = 0;  // TODO: Put this in Toxic
     const bool connected = prompt_selfConnectionStatus(toxic) != TOX_CONNECTION_NONE;
 
-    if (!connected && timed_out(last_bootstrap_time, TRY_BOOTSTRAP_INTERVAL)) {
+    if (connected) {
+        if (!Bootstrap.connected) {
+            on_bootstrap_connected(toxic);
+            Bootstrap.connected = true;
+        }
+
+        return;
+    }
+
+    Bootstrap.connected = false;
+
+    if (timed_out(last_bootstrap_time, TRY_BOOTSTRAP_INTERVAL)) {
+        /* the previous attempt didn't get us online in time */
+        pthread_mutex_lock(&thread_data.lock);
+
+        for (size_t i = 0; i < Bootstrap.batch_size; ++i) {
+            node_health_failure(Bootstrap.batch[i]);
+        }
+
+        /* the failures matter most if we never get online, so don't wait for that to save them */
+        if (timed_out(Health.last_save, NODE_HEALTH_SAVE_INTERVAL)) {
+            node_health_save();
+        }
+
+        pthread_mutex_unlock(&thread_data.lock);
+
         DHT_bootstrap(toxic->tox);
         last_bootstrap_time = get_unix_time();
+
+        Bootstrap.attempt_ms = bootstrap_time_ms();
+
+        if (Bootstrap.start_ms == 0 && Bootstrap.batch_size > 0) {
+            Bootstrap.start_ms = Bootstrap.attempt_ms;
+        }
+    }
+}
+
+void save_DHT_node_health(void)
+{
+    if (!thread_data.lock_initialized) {
+        return;
     }
+
+    pthread_mutex_lock(&thread_data.lock);
+    node_health_save();
+    pthread_mutex_unlock(&thread_data.lock);
 }
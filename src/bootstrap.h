@@ -41,4 +41,7 @@ void do_tox_connection(Toxic *toxic);
  */
 int load_DHT_nodeslist(Toxic *toxic);
 
+/* Writes the health records of the DHT nodes to disk if they've changed since they were last saved. */
+void save_DHT_node_health(void);
+
 #endif /* BOOTSTRAP_H */
@@ -0,0 +1,80 @@
+/*
+ * Measures how many centipede game ticks per second can be simulated without a UI. The game is
+ * drawn into an ncurses screen attached to /dev/null, the clock is simulated one update interval
+ * per tick, and the blaster fires and changes direction at random.
+ *
+ * Usage: centipede_bench [ticks]
+ */
+
+extern "C" {
+#include "game_base.h"
+}
+#include "game_centipede.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+int main(int argc, char **argv)
+{
+    const long ticks = argc > 1 ? std::atol(argv[1]) : 1000000;
+
+    if (std::getenv("TERM") == nullptr) {
+        setenv("TERM", "xterm", 0);
+    }
+
+    FILE *null_out = std::fopen("/dev/null", "w");
+    FILE *null_in = std::fopen("/dev/null", "r");
+
+    if (null_out == nullptr || null_in == nullptr || newterm(nullptr, null_out, null_in) == nullptr) {
+        std::fprintf(stderr, "failed to create a screen\n");
+        return EXIT_FAILURE;
+    }
+
+    GameData *game = static_cast<GameData *>(std::calloc(1, sizeof(GameData)));
+
+    if (game == nullptr) {
+        return EXIT_FAILURE;
+    }
+
+    game->parent_max_x = 120;
+    game->parent_max_y = 60;
+    game->window = newwin(game->parent_max_y, game->parent_max_x, 0, 0);
+
+    if (game->window == nullptr || centipede_initialize(game) == -1) {
+        std::fprintf(stderr, "failed to initialize centipede\n");
+        return EXIT_FAILURE;
+    }
+
+    game_update_lives(game, 1000000);
+
+    const int keys[] = {' ', KEY_LEFT, KEY_RIGHT, KEY_UP, KEY_DOWN};
+    std::mt19937 rng(42);
+    TIME_MS now = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (long i = 0; i < ticks; ++i) {
+        now += game->update_interval;
+
+        if (rng() % 4 == 0) {
+            game->cb_game_key_press(game, keys[rng() % 5], game->cb_game_key_press_data);
+        }
+
+        centipede_tick(game, now);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::printf("%ld ticks in %.3f s: %.2f M ticks/s (level %zu, score %ld)\n", ticks, elapsed.count(),
+                ticks / elapsed.count() / 1e6, game->level, game->score);
+
+    game->cb_game_kill(game, game->cb_game_kill_data);
+    delwin(game->window);
+    std::free(game->messages);
+    std::free(game);
+    endwin();
+
+    return EXIT_SUCCESS;
+}
@@ -21,7 +21,7 @@
  */
 
 #ifndef _GNU_SOURCE
-#define _GNU_SOURCE    /* needed for strcasestr() and wcswidth() */
+#define _GNU_SOURCE    /* needed for strcasestr() */
 #endif
 
 #include "chat.h"
@@ -99,6 +99,7 @@ static const char *const chat_cmd_list[] = {
     "/quit",
     "/savefile",
     "/sendfile",
+    "/source",
     "/status",
 
 #ifdef AUDIO
@@ -167,6 +168,7 @@ void kill_chat_window(ToxWindow *self, Toxic *toxic)
         delwin(ctx->linewin);
         delwin(ctx->history);
 
+        free_line_history(ctx);
         free(ctx->log);
         free(ctx);
     }
@@ -1397,7 +1399,7 @@ static bool chat_onKey(ToxWindow *self, Toxic *toxic, wint_t key, bool ltr)
 
         if (diff != -1) {
             if (x + diff > x2 - 1) {
-                const int wlen = MAX(0, wcswidth(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
+                const int wlen = MAX(0, wcs_width(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
                 ctx->start = wlen < x2 ? 0 : wlen - x2 + 1;
             }
         } else {
@@ -1646,7 +1648,7 @@ static void chat_onDraw(ToxWindow *self, Toxic *toxic)
 
     UNUSED_VAR(x);
 
-    const int new_x = ctx->start ? x2 - 1 : MAX(0, wcswidth(ctx->line, ctx->pos));
+    const int new_x = ctx->start ? x2 - 1 : MAX(0, wcs_width(ctx->line, ctx->pos));
     wmove(self->window, y, new_x);
 
     draw_window_bar(self, toxic->windows);
@@ -0,0 +1,1274 @@
+/*  chess_engine.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "chess_engine.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FILE_A  UINT64_C(0x0101010101010101)
+#define FILE_H  (FILE_A << 7)
+#define RANK_1  UINT64_C(0xFF)
+#define RANK_8  (RANK_1 << 56)
+
+#define SQUARE_BB(sq) (UINT64_C(1) << (sq))
+
+#define ROOK_TABLE_SIZE   0x19000
+#define BISHOP_TABLE_SIZE 0x1480
+
+typedef struct Magic {
+    uint64_t mask;
+    uint64_t magic;
+    uint64_t *attacks;
+    unsigned int shift;
+} Magic;
+
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static uint64_t rook_table[ROOK_TABLE_SIZE];
+static uint64_t bishop_table[BISHOP_TABLE_SIZE];
+static Magic rook_magics[64];
+static Magic bishop_magics[64];
+
+static uint64_t knight_attacks[64];
+static uint64_t king_attacks[64];
+static uint64_t pawn_attacks[2][64];
+
+/* Castling rights that survive a move to or from each square */
+static uint8_t castling_mask[64];
+
+static uint64_t zobrist_pieces[2][6][64];
+static uint64_t zobrist_castling[16];
+static uint64_t zobrist_en_passant[8];
+static uint64_t zobrist_side;
+
+static inline int popcount(uint64_t b)
+{
+    return __builtin_popcountll(b);
+}
+
+static inline int lsb(uint64_t b)
+{
+    return __builtin_ctzll(b);
+}
+
+static inline int pop_lsb(uint64_t *b)
+{
+    const int sq = lsb(*b);
+    *b &= *b - 1;
+    return sq;
+}
+
+static inline int rank_of(int sq)
+{
+    return sq >> 3;
+}
+
+static inline int file_of(int sq)
+{
+    return sq & 7;
+}
+
+/* xorshift64* */
+static uint64_t prng_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * UINT64_C(2685821657736338717);
+}
+
+/* Returns the squares a slider on `sq` attacks along `deltas` (file, rank pairs) given `occupied`. */
+static uint64_t sliding_attacks(const int deltas[4][2], int sq, uint64_t occupied)
+{
+    uint64_t attacks = 0;
+
+    for (int d = 0; d < 4; ++d) {
+        int f = file_of(sq) + deltas[d][0];
+        int r = rank_of(sq) + deltas[d][1];
+
+        while (f >= 0 && f < 8 && r >= 0 && r < 8) {
+            const int s = r * 8 + f;
+            attacks |= SQUARE_BB(s);
+
+            if (occupied & SQUARE_BB(s)) {
+                break;
+            }
+
+            f += deltas[d][0];
+            r += deltas[d][1];
+        }
+    }
+
+    return attacks;
+}
+
+/*
+ * Finds a magic multiplier for every square that maps each subset of the square's
+ * relevant occupancy mask to a unique slot in `table` (or a slot holding the same attack
+ * set). The generator is seeded per rank so the search is quick and deterministic.
+ */
+static void init_magics(uint64_t *table, Magic *magics, const int deltas[4][2])
+{
+    static const uint64_t seeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+
+    uint64_t occupancy[4096];
+    uint64_t reference[4096];
+    int epoch[4096] = {0};
+    int attempt = 0;
+    size_t size = 0;
+
+    for (int sq = 0; sq < 64; ++sq) {
+        Magic *m = &magics[sq];
+
+        const uint64_t edges = ((RANK_1 | RANK_8) & ~(RANK_1 << (8 * rank_of(sq))))
+                               | ((FILE_A | FILE_H) & ~(FILE_A << file_of(sq)));
+
+        m->mask = sliding_attacks(deltas, sq, 0) & ~edges;
+        m->shift = 64 - popcount(m->mask);
+        m->attacks = sq == 0 ? table : magics[sq - 1].attacks + size;
+
+        /* Enumerate every subset of the mask */
+        size = 0;
+        uint64_t b = 0;
+
+        do {
+            occupancy[size] = b;
+            reference[size] = sliding_attacks(deltas, sq, b);
+            ++size;
+            b = (b - m->mask) & m->mask;
+        } while (b != 0);
+
+        uint64_t rng = seeds[rank_of(sq)];
+
+        for (size_t i = 0; i < size;) {
+            m->magic = 0;
+
+            while (popcount((m->magic * m->mask) >> 56) < 6) {
+                m->magic = prng_next(&rng) & prng_next(&rng) & prng_next(&rng);
+            }
+
+            ++attempt;
+
+            for (i = 0; i < size; ++i) {
+                const size_t idx = (size_t)((occupancy[i] * m->magic) >> m->shift);
+
+                if (epoch[idx] < attempt) {
+                    epoch[idx] = attempt;
+                    m->attacks[idx] = reference[i];
+                } else if (m->attacks[idx] != reference[i]) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static uint64_t step_attacks(int sq, const int steps[][2], size_t num_steps)
+{
+    uint64_t attacks = 0;
+
+    for (size_t i = 0; i < num_steps; ++i) {
+        const int f = file_of(sq) + steps[i][0];
+        const int r = rank_of(sq) + steps[i][1];
+
+        if (f >= 0 && f < 8 && r >= 0 && r < 8) {
+            attacks |= SQUARE_BB(r * 8 + f);
+        }
+    }
+
+    return attacks;
+}
+
+static void init_tables(void)
+{
+    static const int rook_deltas[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    static const int bishop_deltas[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    static const int knight_steps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    static const int king_steps[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+    static const int white_pawn_steps[2][2] = {{-1, 1}, {1, 1}};
+    static const int black_pawn_steps[2][2] = {{-1, -1}, {1, -1}};
+
+    init_magics(rook_table, rook_magics, rook_deltas);
+    init_magics(bishop_table, bishop_magics, bishop_deltas);
+
+    for (int sq = 0; sq < 64; ++sq) {
+        knight_attacks[sq] = step_attacks(sq, knight_steps, 8);
+        king_attacks[sq] = step_attacks(sq, king_steps, 8);
+        pawn_attacks[CHESS_WHITE][sq] = step_attacks(sq, white_pawn_steps, 2);
+        pawn_attacks[CHESS_BLACK][sq] = step_attacks(sq, black_pawn_steps, 2);
+        castling_mask[sq] = 0xF;
+    }
+
+    castling_mask[0] &= (uint8_t) ~CHESS_CASTLE_WHITE_QUEEN;
+    castling_mask[7] &= (uint8_t) ~CHESS_CASTLE_WHITE_KING;
+    castling_mask[4] &= (uint8_t) ~(CHESS_CASTLE_WHITE_KING | CHESS_CASTLE_WHITE_QUEEN);
+    castling_mask[56] &= (uint8_t) ~CHESS_CASTLE_BLACK_QUEEN;
+    castling_mask[63] &= (uint8_t) ~CHESS_CASTLE_BLACK_KING;
+    castling_mask[60] &= (uint8_t) ~(CHESS_CASTLE_BLACK_KING | CHESS_CASTLE_BLACK_QUEEN);
+
+    uint64_t rng = UINT64_C(1070372);
+
+    for (int c = 0; c < 2; ++c) {
+        for (int p = 0; p < 6; ++p) {
+            for (int sq = 0; sq < 64; ++sq) {
+                zobrist_pieces[c][p][sq] = prng_next(&rng);
+            }
+        }
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        zobrist_castling[i] = prng_next(&rng);
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        zobrist_en_passant[i] = prng_next(&rng);
+    }
+
+    zobrist_side = prng_next(&rng);
+}
+
+static inline uint64_t rook_attacks(int sq, uint64_t occupied)
+{
+    const Magic *m = &rook_magics[sq];
+    return m->attacks[((occupied & m->mask) * m->magic) >> m->shift];
+}
+
+static inline uint64_t bishop_attacks(int sq, uint64_t occupied)
+{
+    const Magic *m = &bishop_magics[sq];
+    return m->attacks[((occupied & m->mask) * m->magic) >> m->shift];
+}
+
+static inline uint64_t all_occupied(const Chess_Position *pos)
+{
+    return pos->occupied[CHESS_WHITE] | pos->occupied[CHESS_BLACK];
+}
+
+static void put_piece(Chess_Position *pos, Chess_Colour colour, Chess_Piece piece, int sq)
+{
+    pos->pieces[colour][piece] |= SQUARE_BB(sq);
+    pos->occupied[colour] |= SQUARE_BB(sq);
+    pos->board[sq] = (uint8_t)(piece | (colour << 3));
+    pos->hash ^= zobrist_pieces[colour][piece][sq];
+}
+
+static void remove_piece(Chess_Position *pos, Chess_Colour colour, Chess_Piece piece, int sq)
+{
+    pos->pieces[colour][piece] &= ~SQUARE_BB(sq);
+    pos->occupied[colour] &= ~SQUARE_BB(sq);
+    pos->board[sq] = CHESS_NO_PIECE;
+    pos->hash ^= zobrist_pieces[colour][piece][sq];
+}
+
+static void move_piece(Chess_Position *pos, Chess_Colour colour, Chess_Piece piece, int from, int to)
+{
+    remove_piece(pos, colour, piece, from);
+    put_piece(pos, colour, piece, to);
+}
+
+static void position_clear(Chess_Position *pos)
+{
+    pthread_once(&tables_once, init_tables);
+
+    memset(pos, 0, sizeof(Chess_Position));
+    memset(pos->board, CHESS_NO_PIECE, sizeof(pos->board));
+    pos->en_passant = -1;
+    pos->fullmove_number = 1;
+}
+
+void chess_position_init(Chess_Position *pos)
+{
+    const int ret = chess_position_from_fen(pos, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+    (void) ret;  // the starting position is always valid
+}
+
+static int piece_from_char(char c, Chess_Colour *colour)
+{
+    static const char pieces[] = "pnbrqk";
+
+    const char lower = c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+    const char *p = strchr(pieces, lower);
+
+    if (p == NULL || lower == '\0') {
+        return -1;
+    }
+
+    *colour = lower == c ? CHESS_BLACK : CHESS_WHITE;
+
+    return (int)(p - pieces);
+}
+
+int chess_position_from_fen(Chess_Position *pos, const char *fen)
+{
+    position_clear(pos);
+
+    int rank = 7;
+    int file = 0;
+
+    for (; *fen != ' ' && *fen != '\0'; ++fen) {
+        if (*fen == '/') {
+            if (file != 8 || rank == 0) {
+                return -1;
+            }
+
+            --rank;
+            file = 0;
+        } else if (*fen >= '1' && *fen <= '8') {
+            file += *fen - '0';
+        } else {
+            Chess_Colour colour;
+            const int piece = piece_from_char(*fen, &colour);
+
+            if (piece < 0 || file > 7) {
+                return -1;
+            }
+
+            put_piece(pos, colour, (Chess_Piece) piece, rank * 8 + file);
+            ++file;
+        }
+
+        if (file > 8) {
+            return -1;
+        }
+    }
+
+    if (rank != 0 || file != 8) {
+        return -1;
+    }
+
+    if (popcount(pos->pieces[CHESS_WHITE][CHESS_KING]) != 1 || popcount(pos->pieces[CHESS_BLACK][CHESS_KING]) != 1) {
+        return -1;
+    }
+
+    while (*fen == ' ') {
+        ++fen;
+    }
+
+    if (*fen == 'w' || *fen == 'b') {
+        pos->side_to_move = *fen == 'w' ? CHESS_WHITE : CHESS_BLACK;
+        ++fen;
+    } else {
+        return -1;
+    }
+
+    while (*fen == ' ') {
+        ++fen;
+    }
+
+    for (; *fen != ' ' && *fen != '\0'; ++fen) {
+        switch (*fen) {
+            case 'K':
+                pos->castling |= CHESS_CASTLE_WHITE_KING;
+                break;
+
+            case 'Q':
+                pos->castling |= CHESS_CASTLE_WHITE_QUEEN;
+                break;
+
+            case 'k':
+                pos->castling |= CHESS_CASTLE_BLACK_KING;
+                break;
+
+            case 'q':
+                pos->castling |= CHESS_CASTLE_BLACK_QUEEN;
+                break;
+
+            case '-':
+                break;
+
+            default:
+                return -1;
+        }
+    }
+
+    while (*fen == ' ') {
+        ++fen;
+    }
+
+    if (fen[0] >= 'a' && fen[0] <= 'h' && (fen[1] == '3' || fen[1] == '6')) {
+        pos->en_passant = (int8_t)((fen[1] - '1') * 8 + (fen[0] - 'a'));
+        fen += 2;
+    } else if (fen[0] == '-') {
+        ++fen;
+    } else if (fen[0] != '\0') {
+        return -1;
+    }
+
+    char *end;
+    const long halfmove = strtol(fen, &end, 10);
+
+    if (end != fen) {
+        const long fullmove = strtol(end, &end, 10);
+        pos->halfmove_clock = (uint16_t)(halfmove >= 0 && halfmove < 1000 ? halfmove : 0);
+        pos->fullmove_number = (uint16_t)(fullmove > 0 && fullmove < 10000 ? fullmove : 1);
+    }
+
+    if (pos->side_to_move == CHESS_BLACK) {
+        pos->hash ^= zobrist_side;
+    }
+
+    pos->hash ^= zobrist_castling[pos->castling];
+
+    if (pos->en_passant >= 0) {
+        pos->hash ^= zobrist_en_passant[file_of(pos->en_passant)];
+    }
+
+    return 0;
+}
+
+Chess_Piece chess_position_piece_at(const Chess_Position *pos, int square, Chess_Colour *colour)
+{
+    const uint8_t code = pos->board[square];
+
+    if (code == CHESS_NO_PIECE) {
+        return CHESS_NO_PIECE;
+    }
+
+    if (colour != NULL) {
+        *colour = (Chess_Colour)(code >> 3);
+    }
+
+    return (Chess_Piece)(code & 7);
+}
+
+bool chess_position_square_attacked(const Chess_Position *pos, int square, Chess_Colour by)
+{
+    const uint64_t occupied = all_occupied(pos);
+    const uint64_t *p = pos->pieces[by];
+
+    if (pawn_attacks[!by][square] & p[CHESS_PAWN]) {
+        return true;
+    }
+
+    if (knight_attacks[square] & p[CHESS_KNIGHT]) {
+        return true;
+    }
+
+    if (king_attacks[square] & p[CHESS_KING]) {
+        return true;
+    }
+
+    if (bishop_attacks(square, occupied) & (p[CHESS_BISHOP] | p[CHESS_QUEEN])) {
+        return true;
+    }
+
+    return (rook_attacks(square, occupied) & (p[CHESS_ROOK] | p[CHESS_QUEEN])) != 0;
+}
+
+static inline int king_square(const Chess_Position *pos, Chess_Colour colour)
+{
+    return lsb(pos->pieces[colour][CHESS_KING]);
+}
+
+bool chess_position_in_check(const Chess_Position *pos)
+{
+    const Chess_Colour us = pos->side_to_move;
+    return chess_position_square_attacked(pos, king_square(pos, us), (Chess_Colour) !us);
+}
+
+static inline void add_move(Chess_Move_List *list, int from, int to, int flags)
+{
+    list->moves[list->count] = (Chess_Move)(from | (to << 6) | (flags << 12));
+    ++list->count;
+}
+
+static void add_pawn_moves(Chess_Move_List *list, int from, int to, int flags, bool promotion)
+{
+    if (!promotion) {
+        add_move(list, from, to, flags);
+        return;
+    }
+
+    for (int p = 3; p >= 0; --p) {  // queen first
+        add_move(list, from, to, flags | CHESS_FLAG_PROMOTION | p);
+    }
+}
+
+/* Generates moves that follow each piece's movement rules, which may leave the king in check. */
+static void generate_pseudo_moves(const Chess_Position *pos, Chess_Move_List *list)
+{
+    const Chess_Colour us = pos->side_to_move;
+    const Chess_Colour them = (Chess_Colour) !us;
+    const uint64_t own = pos->occupied[us];
+    const uint64_t enemy = pos->occupied[them];
+    const uint64_t occupied = own | enemy;
+    const int forward = us == CHESS_WHITE ? 8 : -8;
+    const int start_rank = us == CHESS_WHITE ? 1 : 6;
+    const int last_rank = us == CHESS_WHITE ? 7 : 0;
+
+    list->count = 0;
+
+    uint64_t pawns = pos->pieces[us][CHESS_PAWN];
+
+    while (pawns != 0) {
+        const int from = pop_lsb(&pawns);
+        const int to = from + forward;
+        const bool promotion = rank_of(to) == last_rank;
+
+        if ((occupied & SQUARE_BB(to)) == 0) {
+            add_pawn_moves(list, from, to, CHESS_FLAG_QUIET, promotion);
+
+            if (rank_of(from) == start_rank && (occupied & SQUARE_BB(to + forward)) == 0) {
+                add_move(list, from, to + forward, CHESS_FLAG_DOUBLE_PUSH);
+            }
+        }
+
+        uint64_t captures = pawn_attacks[us][from] & enemy;
+
+        while (captures != 0) {
+            add_pawn_moves(list, from, pop_lsb(&captures), CHESS_FLAG_CAPTURE, promotion);
+        }
+
+        if (pos->en_passant >= 0 && (pawn_attacks[us][from] & SQUARE_BB(pos->en_passant))) {
+            add_move(list, from, pos->en_passant, CHESS_FLAG_EN_PASSANT);
+        }
+    }
+
+    for (int piece = CHESS_KNIGHT; piece <= CHESS_KING; ++piece) {
+        uint64_t pieces = pos->pieces[us][piece];
+
+        while (pieces != 0) {
+            const int from = pop_lsb(&pieces);
+            uint64_t targets;
+
+            switch (piece) {
+                case CHESS_KNIGHT:
+                    targets = knight_attacks[from];
+                    break;
+
+                case CHESS_BISHOP:
+                    targets = bishop_attacks(from, occupied);
+                    break;
+
+                case CHESS_ROOK:
+                    targets = rook_attacks(from, occupied);
+                    break;
+
+                case CHESS_QUEEN:
+                    targets = bishop_attacks(from, occupied) | rook_attacks(from, occupied);
+                    break;
+
+                default:
+                    targets = king_attacks[from];
+                    break;
+            }
+
+            targets &= ~own;
+
+            while (targets != 0) {
+                const int to = pop_lsb(&targets);
+                add_move(list, from, to, (enemy & SQUARE_BB(to)) ? CHESS_FLAG_CAPTURE : CHESS_FLAG_QUIET);
+            }
+        }
+    }
+
+    /* Castling: the squares between king and rook must be empty and the king mustn't
+     * start on or pass through an attacked square. Landing in check is caught later. */
+    const int king = us == CHESS_WHITE ? 4 : 60;
+    const uint8_t king_side = us == CHESS_WHITE ? CHESS_CASTLE_WHITE_KING : CHESS_CASTLE_BLACK_KING;
+    const uint8_t queen_side = us == CHESS_WHITE ? CHESS_CASTLE_WHITE_QUEEN : CHESS_CASTLE_BLACK_QUEEN;
+
+    if ((pos->castling & (king_side | queen_side)) == 0 || chess_position_square_attacked(pos, king, them)) {
+        return;
+    }
+
+    if ((pos->castling & king_side) && (occupied & (SQUARE_BB(king + 1) | SQUARE_BB(king + 2))) == 0
+            && !chess_position_square_attacked(pos, king + 1, them)) {
+        add_move(list, king, king + 2, CHESS_FLAG_KING_CASTLE);
+    }
+
+    if ((pos->castling & queen_side)
+            && (occupied & (SQUARE_BB(king - 1) | SQUARE_BB(king - 2) | SQUARE_BB(king - 3))) == 0
+            && !chess_position_square_attacked(pos, king - 1, them)) {
+        add_move(list, king, king - 2, CHESS_FLAG_QUEEN_CASTLE);
+    }
+}
+
+void chess_position_make_move(Chess_Position *pos, Chess_Move move)
+{
+    const int from = chess_move_from(move);
+    const int to = chess_move_to(move);
+    const int flags = chess_move_flags(move);
+    const Chess_Colour us = pos->side_to_move;
+    const Chess_Colour them = (Chess_Colour) !us;
+    const Chess_Piece piece = (Chess_Piece)(pos->board[from] & 7);
+
+    if (pos->en_passant >= 0) {
+        pos->hash ^= zobrist_en_passant[file_of(pos->en_passant)];
+    }
+
+    pos->hash ^= zobrist_castling[pos->castling];
+
+    ++pos->halfmove_clock;
+
+    if (piece == CHESS_PAWN || (flags & CHESS_FLAG_CAPTURE)) {
+        pos->halfmove_clock = 0;
+    }
+
+    if (flags == CHESS_FLAG_EN_PASSANT) {
+        remove_piece(pos, them, CHESS_PAWN, to ^ 8);
+    } else if (flags & CHESS_FLAG_CAPTURE) {
+        remove_piece(pos, them, (Chess_Piece)(pos->board[to] & 7), to);
+    }
+
+    move_piece(pos, us, piece, from, to);
+
+    const Chess_Piece promotion = chess_move_promotion(move);
+
+    if (promotion != CHESS_NO_PIECE) {
+        remove_piece(pos, us, CHESS_PAWN, to);
+        put_piece(pos, us, promotion, to);
+    }
+
+    if (flags == CHESS_FLAG_KING_CASTLE) {
+        move_piece(pos, us, CHESS_ROOK, to + 1, to - 1);
+    } else if (flags == CHESS_FLAG_QUEEN_CASTLE) {
+        move_piece(pos, us, CHESS_ROOK, to - 2, to + 1);
+    }
+
+    pos->en_passant = flags == CHESS_FLAG_DOUBLE_PUSH ? (int8_t)((from + to) / 2) : -1;
+    pos->castling &= castling_mask[from] & castling_mask[to];
+
+    pos->hash ^= zobrist_castling[pos->castling];
+
+    if (pos->en_passant >= 0) {
+        pos->hash ^= zobrist_en_passant[file_of(pos->en_passant)];
+    }
+
+    if (us == CHESS_BLACK) {
+        ++pos->fullmove_number;
+    }
+
+    pos->side_to_move = them;
+    pos->hash ^= zobrist_side;
+}
+
+/* Returns true if the side that just moved in `pos` didn't leave its king in check. */
+static inline bool last_move_was_legal(const Chess_Position *pos)
+{
+    const Chess_Colour mover = (Chess_Colour) !pos->side_to_move;
+    return !chess_position_square_attacked(pos, king_square(pos, mover), pos->side_to_move);
+}
+
+void chess_generate_legal_moves(const Chess_Position *pos, Chess_Move_List *list)
+{
+    Chess_Move_List pseudo;
+    generate_pseudo_moves(pos, &pseudo);
+
+    list->count = 0;
+
+    for (size_t i = 0; i < pseudo.count; ++i) {
+        Chess_Position child = *pos;
+        chess_position_make_move(&child, pseudo.moves[i]);
+
+        if (last_move_was_legal(&child)) {
+            list->moves[list->count] = pseudo.moves[i];
+            ++list->count;
+        }
+    }
+}
+
+int chess_position_find_move(const Chess_Position *pos, int from, int to, Chess_Piece promotion, Chess_Move *move)
+{
+    Chess_Move_List pseudo;
+    generate_pseudo_moves(pos, &pseudo);
+
+    for (size_t i = 0; i < pseudo.count; ++i) {
+        const Chess_Move m = pseudo.moves[i];
+
+        if (chess_move_from(m) != from || chess_move_to(m) != to) {
+            continue;
+        }
+
+        const Chess_Piece p = chess_move_promotion(m);
+
+        if (p != CHESS_NO_PIECE && p != promotion) {
+            continue;
+        }
+
+        Chess_Position child = *pos;
+        chess_position_make_move(&child, m);
+
+        if (!last_move_was_legal(&child)) {
+            return 0;
+        }
+
+        *move = m;
+        return 1;
+    }
+
+    return -1;
+}
+
+uint64_t chess_perft(const Chess_Position *pos, unsigned int depth)
+{
+    if (depth == 0) {
+        return 1;
+    }
+
+    Chess_Move_List list;
+    chess_generate_legal_moves(pos, &list);
+
+    if (depth == 1) {
+        return list.count;
+    }
+
+    uint64_t nodes = 0;
+
+    for (size_t i = 0; i < list.count; ++i) {
+        Chess_Position child = *pos;
+        chess_position_make_move(&child, list.moves[i]);
+        nodes += chess_perft(&child, depth - 1);
+    }
+
+    return nodes;
+}
+
+/* Piece values and piece-square tables from the white side's point of view, a8 first. */
+static const int piece_values[6] = {100, 320, 330, 500, 900, 0};
+
+static const int piece_square_tables[6][64] = {
+    {
+        0,  0,  0,  0,  0,  0,  0,  0,
+        50, 50, 50, 50, 50, 50, 50, 50,
+        10, 10, 20, 30, 30, 20, 10, 10,
+        5,  5, 10, 25, 25, 10,  5,  5,
+        0,  0,  0, 20, 20,  0,  0,  0,
+        5, -5, -10,  0,  0, -10, -5,  5,
+        5, 10, 10, -20, -20, 10, 10,  5,
+        0,  0,  0,  0,  0,  0,  0,  0,
+    },
+    {
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20,  0,  0,  0,  0, -20, -40,
+        -30,  0, 10, 15, 15, 10,  0, -30,
+        -30,  5, 15, 20, 20, 15,  5, -30,
+        -30,  0, 15, 20, 20, 15,  0, -30,
+        -30,  5, 10, 15, 15, 10,  5, -30,
+        -40, -20,  0,  5,  5,  0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50,
+    },
+    {
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10,  0,  0,  0,  0,  0,  0, -10,
+        -10,  0,  5, 10, 10,  5,  0, -10,
+        -10,  5,  5, 10, 10,  5,  5, -10,
+        -10,  0, 10, 10, 10, 10,  0, -10,
+        -10, 10, 10, 10, 10, 10, 10, -10,
+        -10,  5,  0,  0,  0,  0,  5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20,
+    },
+    {
+        0,  0,  0,  0,  0,  0,  0,  0,
+        5, 10, 10, 10, 10, 10, 10,  5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        0,  0,  0,  5,  5,  0,  0,  0,
+    },
+    {
+        -20, -10, -10, -5, -5, -10, -10, -20,
+        -10,  0,  0,  0,  0,  0,  0, -10,
+        -10,  0,  5,  5,  5,  5,  0, -10,
+        -5,  0,  5,  5,  5,  5,  0, -5,
+        0,  0,  5,  5,  5,  5,  0, -5,
+        -10,  5,  5,  5,  5,  5,  0, -10,
+        -10,  0,  5,  0,  0,  0,  0, -10,
+        -20, -10, -10, -5, -5, -10, -10, -20,
+    },
+    {
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+        20, 20,  0,  0,  0,  0, 20, 20,
+        20, 30, 10,  0,  0, 10, 30, 20,
+    },
+};
+
+int chess_evaluate(const Chess_Position *pos)
+{
+    int score = 0;
+
+    for (int piece = CHESS_PAWN; piece <= CHESS_KING; ++piece) {
+        uint64_t white = pos->pieces[CHESS_WHITE][piece];
+        uint64_t black = pos->pieces[CHESS_BLACK][piece];
+
+        while (white != 0) {
+            const int sq = pop_lsb(&white);
+            score += piece_values[piece] + piece_square_tables[piece][sq ^ 56];
+        }
+
+        while (black != 0) {
+            const int sq = pop_lsb(&black);
+            score -= piece_values[piece] + piece_square_tables[piece][sq];
+        }
+    }
+
+    return pos->side_to_move == CHESS_WHITE ? score : -score;
+}
+
+/*** Search ***/
+
+#define SEARCH_MAX_PLY       64
+#define SCORE_INFINITE       32000
+#define SCORE_MATE           30000
+#define TIME_CHECK_INTERVAL  2048
+
+typedef enum Bound {
+    BOUND_NONE = 0,
+    BOUND_EXACT,
+    BOUND_LOWER,
+    BOUND_UPPER,
+} Bound;
+
+typedef struct TT_Entry {
+    uint64_t   key;
+    Chess_Move move;
+    int16_t    score;
+    int8_t     depth;
+    uint8_t    bound;
+} TT_Entry;
+
+struct Chess_Search {
+    TT_Entry    *tt;
+    size_t      tt_mask;
+
+    atomic_bool stop;
+    atomic_bool quit;           /* like stop, but never cleared by chess_search_run() */
+    uint64_t    nodes;
+    uint64_t    deadline_ms;    /* 0 for none */
+
+    Chess_Move  killers[SEARCH_MAX_PLY][2];
+    uint64_t    path[SEARCH_MAX_PLY + 1];   /* position hashes along the current line */
+    Chess_Move  root_best;
+};
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+Chess_Search *chess_search_new(unsigned int tt_size_log2)
+{
+    if (tt_size_log2 > 30) {
+        return NULL;
+    }
+
+    pthread_once(&tables_once, init_tables);
+
+    Chess_Search *search = calloc(1, sizeof(Chess_Search));
+
+    if (search == NULL) {
+        return NULL;
+    }
+
+    const size_t entries = (size_t) 1 << tt_size_log2;
+    search->tt = calloc(entries, sizeof(TT_Entry));
+
+    if (search->tt == NULL) {
+        free(search);
+        return NULL;
+    }
+
+    search->tt_mask = entries - 1;
+    atomic_init(&search->stop, false);
+    atomic_init(&search->quit, false);
+
+    return search;
+}
+
+void chess_search_free(Chess_Search *search)
+{
+    if (search == NULL) {
+        return;
+    }
+
+    free(search->tt);
+    free(search);
+}
+
+void chess_search_clear(Chess_Search *search)
+{
+    memset(search->tt, 0, (search->tt_mask + 1) * sizeof(TT_Entry));
+}
+
+void chess_search_stop(Chess_Search *search)
+{
+    atomic_store(&search->stop, true);
+}
+
+void chess_search_quit(Chess_Search *search)
+{
+    atomic_store(&search->quit, true);
+    atomic_store(&search->stop, true);
+}
+
+/* Mate scores are stored relative to the node rather than the root so they stay valid
+ * when the position is reached at a different ply. */
+static int score_to_tt(int score, int ply)
+{
+    if (score > CHESS_SCORE_MATE_THRESHOLD) {
+        return score + ply;
+    }
+
+    if (score < -CHESS_SCORE_MATE_THRESHOLD) {
+        return score - ply;
+    }
+
+    return score;
+}
+
+static int score_from_tt(int score, int ply)
+{
+    if (score > CHESS_SCORE_MATE_THRESHOLD) {
+        return score - ply;
+    }
+
+    if (score < -CHESS_SCORE_MATE_THRESHOLD) {
+        return score + ply;
+    }
+
+    return score;
+}
+
+static void tt_store(Chess_Search *search, uint64_t key, int depth, int score, Bound bound, Chess_Move move, int ply)
+{
+    TT_Entry *entry = &search->tt[key & search->tt_mask];
+
+    /* Replace unless the slot holds a deeper result for the same position */
+    if (entry->key == key && entry->depth > depth && bound != BOUND_EXACT) {
+        return;
+    }
+
+    entry->key = key;
+    entry->move = move;
+    entry->score = (int16_t) score_to_tt(score, ply);
+    entry->depth = (int8_t) depth;
+    entry->bound = (uint8_t) bound;
+}
+
+static bool search_should_stop(Chess_Search *search)
+{
+    if ((search->nodes % TIME_CHECK_INTERVAL) == 0 && search->deadline_ms != 0
+            && monotonic_ms() >= search->deadline_ms) {
+        atomic_store(&search->stop, true);
+    }
+
+    if (atomic_load_explicit(&search->quit, memory_order_relaxed)) {
+        atomic_store(&search->stop, true);
+    }
+
+    return atomic_load_explicit(&search->stop, memory_order_relaxed);
+}
+
+/* Orders moves: the hash move, then captures by most valuable victim and least valuable
+ * attacker, then killer moves. */
+static void score_moves(const Chess_Search *search, const Chess_Position *pos, const Chess_Move_List *list,
+                        Chess_Move tt_move, int ply, int *scores)
+{
+    for (size_t i = 0; i < list->count; ++i) {
+        const Chess_Move m = list->moves[i];
+
+        if (m == tt_move) {
+            scores[i] = 1000000;
+        } else if (chess_move_is_capture(m)) {
+            const int victim = chess_move_flags(m) == CHESS_FLAG_EN_PASSANT ? CHESS_PAWN : pos->board[chess_move_to(m)] & 7;
+            const int attacker = pos->board[chess_move_from(m)] & 7;
+            scores[i] = 100000 + victim * 10 - attacker;
+        } else if (chess_move_promotion(m) != CHESS_NO_PIECE) {
+            scores[i] = 95000 + chess_move_promotion(m);
+        } else if (ply < SEARCH_MAX_PLY && m == search->killers[ply][0]) {
+            scores[i] = 90000;
+        } else if (ply < SEARCH_MAX_PLY && m == search->killers[ply][1]) {
+            scores[i] = 80000;
+        } else {
+            scores[i] = 0;
+        }
+    }
+}
+
+/* Swaps the best scored remaining move into position `i`. */
+static void pick_move(Chess_Move_List *list, int *scores, size_t i)
+{
+    size_t best = i;
+
+    for (size_t j = i + 1; j < list->count; ++j) {
+        if (scores[j] > scores[best]) {
+            best = j;
+        }
+    }
+
+    if (best != i) {
+        const Chess_Move m = list->moves[i];
+        const int s = scores[i];
+        list->moves[i] = list->moves[best];
+        scores[i] = scores[best];
+        list->moves[best] = m;
+        scores[best] = s;
+    }
+}
+
+static int quiesce(Chess_Search *search, const Chess_Position *pos, int alpha, int beta, int ply)
+{
+    ++search->nodes;
+
+    if (search_should_stop(search)) {
+        return 0;
+    }
+
+    const int stand_pat = chess_evaluate(pos);
+
+    if (ply >= SEARCH_MAX_PLY || stand_pat >= beta) {
+        return stand_pat;
+    }
+
+    if (stand_pat > alpha) {
+        alpha = stand_pat;
+    }
+
+    Chess_Move_List list;
+    generate_pseudo_moves(pos, &list);
+
+    int scores[CHESS_MAX_MOVES];
+    score_moves(search, pos, &list, CHESS_MOVE_NONE, SEARCH_MAX_PLY, scores);
+
+    for (size_t i = 0; i < list.count; ++i) {
+        pick_move(&list, scores, i);
+
+        const Chess_Move m = list.moves[i];
+
+        if (!chess_move_is_capture(m)) {
+            break;  // captures are sorted first
+        }
+
+        Chess_Position child = *pos;
+        chess_position_make_move(&child, m);
+
+        if (!last_move_was_legal(&child)) {
+            continue;
+        }
+
+        const int score = -quiesce(search, &child, -beta, -alpha, ply + 1);
+
+        if (atomic_load_explicit(&search->stop, memory_order_relaxed)) {
+            return 0;
+        }
+
+        if (score >= beta) {
+            return score;
+        }
+
+        if (score > alpha) {
+            alpha = score;
+        }
+    }
+
+    return alpha;
+}
+
+static int negamax(Chess_Search *search, const Chess_Position *pos, int depth, int alpha, int beta, int ply)
+{
+    ++search->nodes;
+
+    if (search_should_stop(search)) {
+        return 0;
+    }
+
+    search->path[ply] = pos->hash;
+
+    if (ply > 0) {
+        if (pos->halfmove_clock >= 100) {
+            return 0;
+        }
+
+        for (int i = ply - 2; i >= 0 && i >= ply - pos->halfmove_clock; i -= 2) {
+            if (search->path[i] == pos->hash) {
+                return 0;
+            }
+        }
+
+        if (ply >= SEARCH_MAX_PLY) {
+            return chess_evaluate(pos);
+        }
+    }
+
+    const bool in_check = chess_position_in_check(pos);
+
+    if (in_check) {
+        ++depth;
+    }
+
+    if (depth <= 0) {
+        return quiesce(search, pos, alpha, beta, ply);
+    }
+
+    const TT_Entry *entry = &search->tt[pos->hash & search->tt_mask];
+    Chess_Move tt_move = CHESS_MOVE_NONE;
+
+    if (entry->key == pos->hash) {
+        tt_move = entry->move;
+
+        if (ply > 0 && entry->depth >= depth) {
+            const int score = score_from_tt(entry->score, ply);
+
+            if (entry->bound == BOUND_EXACT
+                    || (entry->bound == BOUND_LOWER && score >= beta)
+                    || (entry->bound == BOUND_UPPER && score <= alpha)) {
+                return score;
+            }
+        }
+    }
+
+    Chess_Move_List list;
+    generate_pseudo_moves(pos, &list);
+
+    int scores[CHESS_MAX_MOVES];
+    score_moves(search, pos, &list, tt_move, ply, scores);
+
+    const int original_alpha = alpha;
+    int best_score = -SCORE_INFINITE;
+    Chess_Move best_move = CHESS_MOVE_NONE;
+    int legal = 0;
+
+    for (size_t i = 0; i < list.count; ++i) {
+        pick_move(&list, scores, i);
+
+        const Chess_Move m = list.moves[i];
+        Chess_Position child = *pos;
+        chess_position_make_move(&child, m);
+
+        if (!last_move_was_legal(&child)) {
+            continue;
+        }
+
+        ++legal;
+
+        const int score = -negamax(search, &child, depth - 1, -beta, -alpha, ply + 1);
+
+        if (atomic_load_explicit(&search->stop, memory_order_relaxed)) {
+            return 0;
+        }
+
+        if (score > best_score) {
+            best_score = score;
+            best_move = m;
+
+            if (ply == 0) {
+                search->root_best = m;
+            }
+        }
+
+        if (score > alpha) {
+            alpha = score;
+        }
+
+        if (alpha >= beta) {
+            if (!chess_move_is_capture(m) && m != search->killers[ply][0]) {
+                search->killers[ply][1] = search->killers[ply][0];
+                search->killers[ply][0] = m;
+            }
+
+            break;
+        }
+    }
+
+    if (legal == 0) {
+        return in_check ? -SCORE_MATE + ply : 0;
+    }
+
+    Bound bound = BOUND_EXACT;
+
+    if (best_score <= original_alpha) {
+        bound = BOUND_UPPER;
+    } else if (best_score >= beta) {
+        bound = BOUND_LOWER;
+    }
+
+    tt_store(search, pos->hash, depth, best_score, bound, best_move, ply);
+
+    return best_score;
+}
+
+int chess_search_run(Chess_Search *search, const Chess_Position *pos, const Chess_Search_Limits *limits,
+                     Chess_Search_Result *result)
+{
+    Chess_Move_List legal;
+    chess_generate_legal_moves(pos, &legal);
+
+    if (legal.count == 0) {
+        return -1;
+    }
+
+    const uint64_t start = monotonic_ms();
+    const unsigned int max_depth = limits->max_depth > 0 && limits->max_depth < SEARCH_MAX_PLY
+                                   ? limits->max_depth : SEARCH_MAX_PLY - 1;
+
+    atomic_store(&search->stop, false);
+    search->nodes = 0;
+    search->deadline_ms = limits->time_budget_ms > 0 ? start + limits->time_budget_ms : 0;
+    memset(search->killers, 0, sizeof(search->killers));
+
+    *result = (Chess_Search_Result) {
+        .best_move = legal.moves[0],
+    };
+
+    for (unsigned int depth = 1; depth <= max_depth; ++depth) {
+        search->root_best = CHESS_MOVE_NONE;
+
+        const int score = negamax(search, pos, (int) depth, -SCORE_INFINITE, SCORE_INFINITE, 0);
+
+        if (atomic_load(&search->stop)) {
+            break;
+        }
+
+        result->best_move = search->root_best;
+        result->score = score;
+        result->depth = depth;
+
+        if (score > CHESS_SCORE_MATE_THRESHOLD || score < -CHESS_SCORE_MATE_THRESHOLD) {
+            break;
+        }
+
+        /* The next iteration takes several times longer than this one; don't start it if
+         * it can't finish. */
+        if (search->deadline_ms != 0 && monotonic_ms() - start > limits->time_budget_ms / 2) {
+            break;
+        }
+    }
+
+    result->nodes = search->nodes;
+
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*  chess_engine.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef CHESS_ENGINE_H
+#define CHESS_ENGINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Bitboard chess rules and search.
+ *
+ * Squares are numbered 0 (a1) to 63 (h8), rank by rank. Each piece type of each colour
+ * is a 64-bit set of squares; sliding piece attacks are looked up in magic bitboard
+ * tables which are built the first time a position is initialised.
+ */
+
+#define CHESS_MAX_MOVES 256
+
+typedef enum Chess_Colour {
+    CHESS_WHITE = 0,
+    CHESS_BLACK = 1,
+} Chess_Colour;
+
+typedef enum Chess_Piece {
+    CHESS_PAWN = 0,
+    CHESS_KNIGHT,
+    CHESS_BISHOP,
+    CHESS_ROOK,
+    CHESS_QUEEN,
+    CHESS_KING,
+    CHESS_NO_PIECE,
+} Chess_Piece;
+
+/*
+ * A move packed as from (bits 0-5), to (bits 6-11) and flags (bits 12-15). The null move
+ * is 0.
+ */
+typedef uint16_t Chess_Move;
+
+#define CHESS_MOVE_NONE 0
+
+#define CHESS_FLAG_QUIET          0x0
+#define CHESS_FLAG_DOUBLE_PUSH    0x1
+#define CHESS_FLAG_KING_CASTLE    0x2
+#define CHESS_FLAG_QUEEN_CASTLE   0x3
+#define CHESS_FLAG_CAPTURE        0x4
+#define CHESS_FLAG_EN_PASSANT     0x5
+#define CHESS_FLAG_PROMOTION      0x8  /* the low two bits select knight, bishop, rook or queen */
+
+static inline int chess_move_from(Chess_Move move)
+{
+    return move & 0x3f;
+}
+
+static inline int chess_move_to(Chess_Move move)
+{
+    return (move >> 6) & 0x3f;
+}
+
+static inline int chess_move_flags(Chess_Move move)
+{
+    return move >> 12;
+}
+
+static inline bool chess_move_is_capture(Chess_Move move)
+{
+    return (chess_move_flags(move) & CHESS_FLAG_CAPTURE) != 0;
+}
+
+/* Returns the piece a pawn promotes to, or CHESS_NO_PIECE if `move` isn't a promotion. */
+static inline Chess_Piece chess_move_promotion(Chess_Move move)
+{
+    if ((chess_move_flags(move) & CHESS_FLAG_PROMOTION) == 0) {
+        return CHESS_NO_PIECE;
+    }
+
+    return (Chess_Piece)(CHESS_KNIGHT + (chess_move_flags(move) & 0x3));
+}
+
+#define CHESS_CASTLE_WHITE_KING  0x1
+#define CHESS_CASTLE_WHITE_QUEEN 0x2
+#define CHESS_CASTLE_BLACK_KING  0x4
+#define CHESS_CASTLE_BLACK_QUEEN 0x8
+
+typedef struct Chess_Position {
+    uint64_t pieces[2][6];      /* indexed by Chess_Colour and Chess_Piece */
+    uint64_t occupied[2];
+    uint8_t  board[64];         /* CHESS_NO_PIECE, or the Chess_Piece plus 8 for black pieces */
+
+    Chess_Colour side_to_move;
+    uint8_t  castling;          /* CHESS_CASTLE_* bits */
+    int8_t   en_passant;        /* the square a pawn can capture onto en passant, or -1 */
+    uint16_t halfmove_clock;
+    uint16_t fullmove_number;
+
+    uint64_t hash;              /* Zobrist hash of everything above */
+} Chess_Position;
+
+typedef struct Chess_Move_List {
+    Chess_Move moves[CHESS_MAX_MOVES];
+    size_t     count;
+} Chess_Move_List;
+
+/* Sets up the standard starting position. */
+void chess_position_init(Chess_Position *pos);
+
+/*
+ * Sets up the position described by the Forsyth-Edwards Notation string `fen`.
+ *
+ * Return 0 on success.
+ * Return -1 if `fen` is malformed.
+ */
+int chess_position_from_fen(Chess_Position *pos, const char *fen);
+
+/* Returns the piece on `square` and puts its colour in `colour`, or CHESS_NO_PIECE. */
+Chess_Piece chess_position_piece_at(const Chess_Position *pos, int square, Chess_Colour *colour);
+
+/* Returns true if the side to move is in check. */
+bool chess_position_in_check(const Chess_Position *pos);
+
+/* Returns true if any piece of `by` attacks `square`. */
+bool chess_position_square_attacked(const Chess_Position *pos, int square, Chess_Colour by);
+
+/* Puts every legal move for the side to move in `list`. */
+void chess_generate_legal_moves(const Chess_Position *pos, Chess_Move_List *list);
+
+/*
+ * Looks for a move from `from` to `to`. `promotion` picks the piece for pawn promotions
+ * and is ignored otherwise.
+ *
+ * Return 1 and put the move in `move` if it's legal.
+ * Return 0 if the move follows the piece's movement rules but leaves the king in check.
+ * Return -1 otherwise.
+ */
+int chess_position_find_move(const Chess_Position *pos, int from, int to, Chess_Piece promotion, Chess_Move *move);
+
+/* Plays `move`, which must be legal in `pos`. */
+void chess_position_make_move(Chess_Position *pos, Chess_Move move);
+
+/* Returns the number of leaf nodes of the legal move tree `depth` plies deep. */
+uint64_t chess_perft(const Chess_Position *pos, unsigned int depth);
+
+/* Returns a static evaluation of `pos` in centipawns from the side to move's point of view. */
+int chess_evaluate(const Chess_Position *pos);
+
+/*
+ * An alpha-beta searcher with its own transposition table. A searcher may be used by one
+ * thread at a time, except for `chess_search_stop()` and `chess_search_quit()` which may be
+ * called from any thread.
+ */
+typedef struct Chess_Search Chess_Search;
+
+typedef struct Chess_Search_Limits {
+    unsigned int max_depth;     /* 0 for no limit */
+    uint32_t     time_budget_ms;  /* 0 for no limit */
+} Chess_Search_Limits;
+
+typedef struct Chess_Search_Result {
+    Chess_Move   best_move;
+    int          score;         /* centipawns from the side to move's point of view */
+    unsigned int depth;         /* the deepest fully searched iteration */
+    uint64_t     nodes;
+} Chess_Search_Result;
+
+/* Scores beyond this mean a forced mate was found */
+#define CHESS_SCORE_MATE_THRESHOLD 29000
+
+/*
+ * Creates a searcher with a transposition table of 2^`tt_size_log2` entries.
+ *
+ * Returns NULL on failure.
+ */
+Chess_Search *chess_search_new(unsigned int tt_size_log2);
+
+void chess_search_free(Chess_Search *search);
+
+/* Forgets everything in the transposition table. */
+void chess_search_clear(Chess_Search *search);
+
+/*
+ * Searches `pos` by iterative deepening until the depth limit is reached, the time budget
+ * runs out or `chess_search_stop()` is called, and puts the best move found in `result`.
+ *
+ * Return 0 on success.
+ * Return -1 if the side to move has no legal moves.
+ */
+int chess_search_run(Chess_Search *search, const Chess_Position *pos, const Chess_Search_Limits *limits,
+                     Chess_Search_Result *result);
+
+/* Makes a running `chess_search_run()` return as soon as possible. */
+void chess_search_stop(Chess_Search *search);
+
+/*
+ * Like `chess_search_stop()`, but every later `chess_search_run()` on `search` returns at once
+ * as well, so the request can't be missed by a search that is just starting.
+ */
+void chess_search_quit(Chess_Search *search);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CHESS_ENGINE_H */
@@ -0,0 +1,216 @@
+#include "chess_engine.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+namespace {
+
+constexpr const char *kStartFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+constexpr const char *kKiwipeteFen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+
+int square(const char *name)
+{
+    return (name[0] - 'a') + (name[1] - '1') * 8;
+}
+
+struct PerftCase {
+    const char *fen;
+    std::vector<uint64_t> nodes;  // expected counts for depth 1, 2, ...
+};
+
+class ChessPerft : public ::testing::TestWithParam<PerftCase> {
+};
+
+TEST_P(ChessPerft, MatchesKnownNodeCounts)
+{
+    Chess_Position pos;
+    ASSERT_EQ(chess_position_from_fen(&pos, GetParam().fen), 0);
+
+    for (size_t i = 0; i < GetParam().nodes.size(); ++i) {
+        EXPECT_EQ(chess_perft(&pos, i + 1), GetParam().nodes[i]) << "depth " << i + 1;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Positions, ChessPerft, ::testing::Values(
+    PerftCase{kStartFen, {20, 400, 8902, 197281}},
+    PerftCase{kKiwipeteFen, {48, 2039, 97862}},
+    PerftCase{"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", {14, 191, 2812, 43238}},
+    PerftCase{"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", {6, 264, 9467}},
+    PerftCase{"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", {44, 1486, 62379}}));
+
+TEST(ChessPosition, RejectsMalformedFen)
+{
+    Chess_Position pos;
+
+    EXPECT_EQ(chess_position_from_fen(&pos, ""), -1);
+    EXPECT_EQ(chess_position_from_fen(&pos, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP w KQkq - 0 1"), -1);
+    EXPECT_EQ(chess_position_from_fen(&pos, "rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"), -1);
+    EXPECT_EQ(chess_position_from_fen(&pos, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1"), -1);
+    EXPECT_EQ(chess_position_from_fen(&pos, "8/8/8/8/8/8/8/8 w - - 0 1"), -1);
+}
+
+TEST(ChessPosition, HashMatchesAfterTransposition)
+{
+    Chess_Position a;
+    Chess_Position b;
+    chess_position_init(&a);
+    chess_position_init(&b);
+
+    const char *first[] = {"g1", "f3", "g8", "f6", "b1", "c3", "b8", "c6"};
+    const char *second[] = {"b1", "c3", "b8", "c6", "g1", "f3", "g8", "f6"};
+
+    for (int i = 0; i < 8; i += 2) {
+        Chess_Move move;
+        ASSERT_EQ(chess_position_find_move(&a, square(first[i]), square(first[i + 1]), CHESS_QUEEN, &move), 1);
+        chess_position_make_move(&a, move);
+        ASSERT_EQ(chess_position_find_move(&b, square(second[i]), square(second[i + 1]), CHESS_QUEEN, &move), 1);
+        chess_position_make_move(&b, move);
+    }
+
+    EXPECT_EQ(a.hash, b.hash);
+
+    Chess_Position fen;
+    ASSERT_EQ(chess_position_from_fen(&fen, "r1bqkb1r/pppppppp/2n2n2/8/8/2N2N2/PPPPPPPP/R1BQKB1R w KQkq - 4 5"), 0);
+    EXPECT_EQ(a.hash, fen.hash);
+}
+
+TEST(ChessPosition, FindMoveReportsMovesIntoCheck)
+{
+    Chess_Position pos;
+    ASSERT_EQ(chess_position_from_fen(&pos, "4k3/8/8/8/8/8/4r3/4K3 w - - 0 1"), 0);
+
+    Chess_Move move;
+    EXPECT_TRUE(chess_position_in_check(&pos));
+    EXPECT_EQ(chess_position_find_move(&pos, square("e1"), square("e2"), CHESS_QUEEN, &move), 1);
+    EXPECT_TRUE(chess_move_is_capture(move));
+    EXPECT_EQ(chess_position_find_move(&pos, square("e1"), square("f2"), CHESS_QUEEN, &move), 0);
+    EXPECT_EQ(chess_position_find_move(&pos, square("e1"), square("e3"), CHESS_QUEEN, &move), -1);
+}
+
+TEST(ChessPosition, PromotionPicksPiece)
+{
+    Chess_Position pos;
+    ASSERT_EQ(chess_position_from_fen(&pos, "7k/P7/8/8/8/8/8/K7 w - - 0 1"), 0);
+
+    Chess_Move move;
+    ASSERT_EQ(chess_position_find_move(&pos, square("a7"), square("a8"), CHESS_KNIGHT, &move), 1);
+    EXPECT_EQ(chess_move_promotion(move), CHESS_KNIGHT);
+
+    chess_position_make_move(&pos, move);
+
+    Chess_Colour colour;
+    EXPECT_EQ(chess_position_piece_at(&pos, square("a8"), &colour), CHESS_KNIGHT);
+    EXPECT_EQ(colour, CHESS_WHITE);
+}
+
+TEST(ChessSearch, FindsMateInOne)
+{
+    Chess_Position pos;
+    ASSERT_EQ(chess_position_from_fen(&pos, "6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1"), 0);
+
+    Chess_Search *search = chess_search_new(16);
+    ASSERT_NE(search, nullptr);
+
+    const Chess_Search_Limits limits = {4, 0};
+    Chess_Search_Result result;
+    ASSERT_EQ(chess_search_run(search, &pos, &limits, &result), 0);
+
+    EXPECT_EQ(chess_move_from(result.best_move), square("a1"));
+    EXPECT_EQ(chess_move_to(result.best_move), square("a8"));
+    EXPECT_GT(result.score, CHESS_SCORE_MATE_THRESHOLD);
+
+    chess_search_free(search);
+}
+
+TEST(ChessSearch, WinsHangingQueen)
+{
+    Chess_Position pos;
+    ASSERT_EQ(chess_position_from_fen(&pos, "4k3/8/8/3q4/8/8/3R4/4K3 w - - 0 1"), 0);
+
+    Chess_Search *search = chess_search_new(16);
+    ASSERT_NE(search, nullptr);
+
+    const Chess_Search_Limits limits = {3, 0};
+    Chess_Search_Result result;
+    ASSERT_EQ(chess_search_run(search, &pos, &limits, &result), 0);
+
+    EXPECT_EQ(chess_move_to(result.best_move), square("d5"));
+
+    chess_search_free(search);
+}
+
+TEST(ChessSearch, RespectsTimeBudget)
+{
+    Chess_Position pos;
+    ASSERT_EQ(chess_position_from_fen(&pos, kKiwipeteFen), 0);
+
+    Chess_Search *search = chess_search_new(16);
+    ASSERT_NE(search, nullptr);
+
+    const Chess_Search_Limits limits = {0, 200};
+    Chess_Search_Result result;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ASSERT_EQ(chess_search_run(search, &pos, &limits, &result), 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    const long elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    EXPECT_LT(elapsed_ms, 1000);
+    EXPECT_GE(result.depth, 1u);
+
+    Chess_Move_List legal;
+    chess_generate_legal_moves(&pos, &legal);
+    EXPECT_NE(std::find(legal.moves, legal.moves + legal.count, result.best_move), legal.moves + legal.count);
+
+    chess_search_free(search);
+}
+
+TEST(ChessSearch, QuitBeforeRunIsNotLost)
+{
+    Chess_Position pos;
+    ASSERT_EQ(chess_position_from_fen(&pos, kKiwipeteFen), 0);
+
+    Chess_Search *search = chess_search_new(16);
+    ASSERT_NE(search, nullptr);
+
+    chess_search_quit(search);
+
+    const Chess_Search_Limits limits = {0, 5000};
+    Chess_Search_Result result;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ASSERT_EQ(chess_search_run(search, &pos, &limits, &result), 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    const long elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    EXPECT_LT(elapsed_ms, 1000);
+
+    Chess_Move_List legal;
+    chess_generate_legal_moves(&pos, &legal);
+    EXPECT_NE(std::find(legal.moves, legal.moves + legal.count, result.best_move), legal.moves + legal.count);
+
+    chess_search_free(search);
+}
+
+TEST(ChessSearch, ReportsNoLegalMoves)
+{
+    Chess_Position pos;
+    ASSERT_EQ(chess_position_from_fen(&pos, "k7/8/1Q6/8/8/8/8/K7 b - - 0 1"), 0);  // stalemate
+
+    Chess_Search *search = chess_search_new(10);
+    ASSERT_NE(search, nullptr);
+
+    const Chess_Search_Limits limits = {3, 0};
+    Chess_Search_Result result;
+    EXPECT_EQ(chess_search_run(search, &pos, &limits, &result), -1);
+
+    chess_search_free(search);
+}
+
+}  // namespace
@@ -0,0 +1,41 @@
+/*
+ * Counts the leaf nodes of the legal move tree of a position and reports how many nodes
+ * per second the move generator produces.
+ *
+ * Usage: chess_perft [depth] [fen]
+ */
+
+#include "chess_engine.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char **argv)
+{
+    const int depth = argc > 1 ? std::atoi(argv[1]) : 5;
+    const char *fen = argc > 2 ? argv[2] : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    if (depth < 1) {
+        std::fprintf(stderr, "depth must be at least 1\n");
+        return EXIT_FAILURE;
+    }
+
+    Chess_Position pos;
+
+    if (chess_position_from_fen(&pos, fen) != 0) {
+        std::fprintf(stderr, "invalid FEN: %s\n", fen);
+        return EXIT_FAILURE;
+    }
+
+    for (int d = 1; d <= depth; ++d) {
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t nodes = chess_perft(&pos, (unsigned int) d);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::printf("depth %d: %llu nodes in %.3f s (%.2f Mnodes/s)\n", d, (unsigned long long) nodes,
+                    elapsed.count(), elapsed.count() > 0 ? nodes / elapsed.count() / 1e6 : 0.0);
+    }
+
+    return EXIT_SUCCESS;
+}
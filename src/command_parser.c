@@ -0,0 +1,112 @@
+/*  command_parser.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "command_parser.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+size_t command_tokenize(const char *input, size_t length, bool single_argument, Command_Token *tokens,
+                        size_t max_tokens)
+{
+    size_t num_tokens = 0;
+    size_t pos = 0;
+
+    while (num_tokens < max_tokens) {
+        const bool rest = single_argument && num_tokens == 1;
+        const char *space = rest ? NULL : memchr(input + pos, ' ', length - pos);
+        const size_t end = space != NULL ? (size_t)(space - input) : length;
+
+        tokens[num_tokens].start = input + pos;
+        tokens[num_tokens].length = end - pos;
+        ++num_tokens;
+
+        if (end >= length) {
+            break;
+        }
+
+        pos = end + 1;
+
+        if (single_argument && pos >= length) {
+            break;  // "/command " has no argument
+        }
+    }
+
+    return num_tokens;
+}
+
+size_t command_name_length(const char *input, size_t length)
+{
+    const char *space = memchr(input, ' ', length);
+    return space != NULL ? (size_t)(space - input) : length;
+}
+
+int command_token_compare(const Command_Token *token, const char *name)
+{
+    const int ret = strncmp(token->start, name, token->length);
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    /* `name` starts with the token; it sorts after unless they're the same length */
+    return name[token->length] == '\0' ? 0 : -1;
+}
+
+static int command_entry_compare(const void *a, const void *b)
+{
+    const char *const *name_a = (const char *const *)a;
+    const char *const *name_b = (const char *const *)b;
+
+    return strcmp(*name_a, *name_b);
+}
+
+void command_table_sort(void *table, size_t count, size_t entry_size)
+{
+    qsort(table, count, entry_size, command_entry_compare);
+}
+
+const void *command_table_find(const void *table, size_t count, size_t entry_size, const Command_Token *name)
+{
+    const char *entries = (const char *)table;
+    size_t low = 0;
+    size_t high = count;
+
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        const void *entry = entries + mid * entry_size;
+        const int cmp = command_token_compare(name, *(const char *const *)entry);
+
+        if (cmp == 0) {
+            return entry;
+        }
+
+        if (cmp < 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,82 @@
+/*  command_parser.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A piece of a command line. `start` points into the tokenized input, which isn't copied
+ * or modified, so a token is only valid for as long as the input is.
+ */
+typedef struct Command_Token {
+    const char *start;
+    size_t      length;
+} Command_Token;
+
+/*
+ * Splits the first `length` bytes of `input` at each space into at most `max_tokens`
+ * tokens, the first of which is the command name. Consecutive spaces produce empty
+ * tokens, and anything past the last token that fits is dropped.
+ *
+ * If `single_argument` is true everything after the first space is one token, even if it
+ * contains spaces.
+ *
+ * Returns the number of tokens, which is 0 only if `max_tokens` is 0.
+ */
+size_t command_tokenize(const char *input, size_t length, bool single_argument, Command_Token *tokens,
+                        size_t max_tokens);
+
+/* Returns the length of the command name at the start of `input`, i.e. up to the first space. */
+size_t command_name_length(const char *input, size_t length);
+
+/*
+ * Returns a negative number, zero or a positive number if `token` sorts before, equal to
+ * or after the null terminated string `name`.
+ */
+int command_token_compare(const Command_Token *token, const char *name);
+
+/*
+ * Command tables are arrays of `count` structs of `entry_size` bytes whose first member
+ * is the command's name as a `const char *`.
+ *
+ * Sorts `table` by name so it can be searched with `command_table_find()`.
+ */
+void command_table_sort(void *table, size_t count, size_t entry_size);
+
+/*
+ * Returns the entry of the sorted `table` whose name equals `name`, or NULL if there isn't
+ * one. Takes O(log `count`) comparisons.
+ */
+const void *command_table_find(const void *table, size_t count, size_t entry_size, const Command_Token *name);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* COMMAND_PARSER_H */
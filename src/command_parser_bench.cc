@@ -0,0 +1,123 @@
+/*
+ * Measures how many command lines per second can be tokenized and matched against a
+ * command table the size of toxic's, compared with tokenizing by repeatedly copying the
+ * rest of the line and matching with a linear scan.
+ *
+ * Usage: command_parser_bench [iterations]
+ */
+
+#include "command_parser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kMaxArgs = 4;
+constexpr size_t kMaxStrSize = 1373;
+
+struct Entry {
+    const char *name;
+    int id;
+};
+
+Entry table[] = {
+    {"/accept", 0}, {"/add", 1}, {"/avatar", 2}, {"/clear", 3}, {"/color", 4}, {"/connect", 5},
+    {"/decline", 6}, {"/exit", 7}, {"/conference", 8}, {"/group", 9}, {"/game", 10}, {"/help", 11},
+    {"/join", 12}, {"/log", 13}, {"/myid", 14}, {"/myqr", 15}, {"/nick", 16}, {"/note", 17},
+    {"/nospam", 18}, {"/q", 19}, {"/quit", 20}, {"/requests", 21}, {"/sched", 22}, {"/status", 23},
+    {"/lsdev", 24}, {"/sdev", 25}, {"/lsvdev", 26}, {"/svdev", 27}, {"/run", 28},
+};
+
+constexpr size_t kTableSize = sizeof(table) / sizeof(table[0]);
+
+const char *const lines[] = {
+    "/status online",
+    "/note back in five minutes",
+    "/connect 144.217.167.73 33445 7E5668E0EE09E19F320AD47902419331FFEE147BB3606769CFBE921A2A2FD34C",
+    "/log on",
+    "/sched",
+    "/nospam 4AF09B",
+    "/help",
+    "/run plugin.py arg",
+};
+
+constexpr size_t kNumLines = sizeof(lines) / sizeof(lines[0]);
+
+/* The tokenizer and dispatch that execute() used before */
+int legacy_parse(const char *input, char (*args)[kMaxStrSize])
+{
+    char *cmd = strdup(input);
+    int num_args = 0;
+
+    while (num_args < (int) kMaxArgs) {
+        const size_t i = std::strcspn(cmd, " ");
+        std::memcpy(args[num_args], cmd, i);
+        args[num_args++][i] = '\0';
+
+        if (cmd[i] == '\0') {
+            break;
+        }
+
+        char tmp[kMaxStrSize];
+        std::snprintf(tmp, sizeof(tmp), "%s", &cmd[i + 1]);
+        std::strcpy(cmd, tmp);
+    }
+
+    std::free(cmd);
+    return num_args;
+}
+
+int legacy_find(const char *name)
+{
+    for (size_t i = 0; i < kTableSize; ++i) {
+        if (std::strcmp(name, table[i].name) == 0) {
+            return table[i].id;
+        }
+    }
+
+    return -1;
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const long iterations = argc > 1 ? std::atol(argv[1]) : 2000000;
+
+    long checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (long i = 0; i < iterations; ++i) {
+        char args[kMaxArgs][kMaxStrSize];
+        const int num_args = legacy_parse(lines[i % kNumLines], args);
+        checksum += legacy_find(args[0]) + num_args;
+    }
+
+    const std::chrono::duration<double> legacy = std::chrono::steady_clock::now() - start;
+
+    command_table_sort(table, kTableSize, sizeof(Entry));
+
+    start = std::chrono::steady_clock::now();
+
+    for (long i = 0; i < iterations; ++i) {
+        const char *line = lines[i % kNumLines];
+        const size_t length = std::strlen(line);
+
+        Command_Token tokens[kMaxArgs];
+        const size_t num_tokens = command_tokenize(line, length, false, tokens, kMaxArgs);
+        const Entry *entry = static_cast<const Entry *>(command_table_find(table, kTableSize, sizeof(Entry), &tokens[0]));
+        checksum += (entry != nullptr ? entry->id : -1) + (long) num_tokens;
+    }
+
+    const std::chrono::duration<double> current = std::chrono::steady_clock::now() - start;
+
+    std::printf("%ld commands: copying tokenizer + linear scan %.2f M/s, token views + binary search %.2f M/s "
+                "(checksum %ld)\n", iterations, iterations / legacy.count() / 1e6, iterations / current.count() / 1e6,
+                checksum);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#include "command_parser.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> tokenize(const char *input, bool single_argument, size_t max_tokens = 4)
+{
+    std::vector<Command_Token> tokens(max_tokens);
+    const size_t count = command_tokenize(input, std::strlen(input), single_argument, tokens.data(), max_tokens);
+
+    std::vector<std::string> result;
+
+    for (size_t i = 0; i < count; ++i) {
+        result.emplace_back(tokens[i].start, tokens[i].length);
+    }
+
+    return result;
+}
+
+using Strings = std::vector<std::string>;
+
+TEST(CommandParser, SplitsAtSpaces)
+{
+    EXPECT_EQ(tokenize("/status", false), (Strings{"/status"}));
+    EXPECT_EQ(tokenize("/connect 1.2.3.4 33445 ABCD", false), (Strings{"/connect", "1.2.3.4", "33445", "ABCD"}));
+}
+
+TEST(CommandParser, ConsecutiveSpacesMakeEmptyTokens)
+{
+    EXPECT_EQ(tokenize("/log  on", false), (Strings{"/log", "", "on"}));
+    EXPECT_EQ(tokenize("/log ", false), (Strings{"/log", ""}));
+}
+
+TEST(CommandParser, DropsTokensPastTheLimit)
+{
+    EXPECT_EQ(tokenize("/a b c d e f", false), (Strings{"/a", "b", "c", "d"}));
+    EXPECT_EQ(tokenize("/a b c", false, 1), (Strings{"/a"}));
+    EXPECT_EQ(tokenize("/a b c", false, 0), (Strings{}));
+}
+
+TEST(CommandParser, SingleArgumentKeepsSpaces)
+{
+    EXPECT_EQ(tokenize("/note gone fishing  today", true), (Strings{"/note", "gone fishing  today"}));
+    EXPECT_EQ(tokenize("/note", true), (Strings{"/note"}));
+    EXPECT_EQ(tokenize("/note ", true), (Strings{"/note"}));
+}
+
+TEST(CommandParser, TokensPointIntoInput)
+{
+    const char *input = "/nick bob";
+    Command_Token tokens[4];
+
+    ASSERT_EQ(command_tokenize(input, std::strlen(input), false, tokens, 4), 2u);
+    EXPECT_EQ(tokens[0].start, input);
+    EXPECT_EQ(tokens[1].start, input + 6);
+}
+
+TEST(CommandParser, NameLength)
+{
+    EXPECT_EQ(command_name_length("/nick bob", 9), 5u);
+    EXPECT_EQ(command_name_length("/help", 5), 5u);
+    EXPECT_EQ(command_name_length("", 0), 0u);
+}
+
+TEST(CommandParser, TokenCompare)
+{
+    const Command_Token token = {"/nickname", 5};
+
+    EXPECT_EQ(command_token_compare(&token, "/nick"), 0);
+    EXPECT_LT(command_token_compare(&token, "/nickname"), 0);
+    EXPECT_GT(command_token_compare(&token, "/nic"), 0);
+    EXPECT_LT(command_token_compare(&token, "/note"), 0);
+    EXPECT_GT(command_token_compare(&token, "/add"), 0);
+}
+
+struct Entry {
+    const char *name;
+    int value;
+};
+
+TEST(CommandParser, SortedTableLookup)
+{
+    Entry table[] = {
+        {"/status", 1}, {"/add", 2}, {"/quit", 3}, {"/q", 4}, {"/nick", 5}, {"/note", 6}, {"/nospam", 7},
+    };
+    constexpr size_t kCount = sizeof(table) / sizeof(table[0]);
+
+    command_table_sort(table, kCount, sizeof(Entry));
+
+    for (size_t i = 1; i < kCount; ++i) {
+        EXPECT_LT(std::strcmp(table[i - 1].name, table[i].name), 0);
+    }
+
+    for (const char *name : {"/status", "/add", "/quit", "/q", "/nick", "/note", "/nospam"}) {
+        const Command_Token token = {name, std::strlen(name)};
+        const Entry *entry = static_cast<const Entry *>(command_table_find(table, kCount, sizeof(Entry), &token));
+
+        ASSERT_NE(entry, nullptr) << name;
+        EXPECT_STREQ(entry->name, name);
+    }
+
+    for (const char *name : {"/qu", "/", "", "/zzz", "/nickname", "/a"}) {
+        const Command_Token token = {name, std::strlen(name)};
+        EXPECT_EQ(command_table_find(table, kCount, sizeof(Entry), &token), nullptr) << name;
+    }
+
+    const Command_Token empty = {"/add", 4};
+    EXPECT_EQ(command_table_find(table, 0, sizeof(Entry), &empty), nullptr);
+}
+
+}  // namespace
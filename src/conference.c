@@ -21,7 +21,7 @@
  */
 
 #ifndef _GNU_SOURCE
-#define _GNU_SOURCE    /* needed for strcasestr() and wcswidth() */
+#define _GNU_SOURCE    /* needed for strcasestr() */
 #endif
 
 #include <assert.h>
@@ -111,6 +111,7 @@ static const char *const conference_cmd_list[] = {
     "/ptt",
     "/sense",
 #endif
+    "/source",
     "/status",
     "/title",
 
@@ -122,6 +123,7 @@ static const char *const conference_cmd_list[] = {
 };
 
 static ToxWindow *new_conference_chat(uint32_t conferencenum);
+static void conference_onStubInit(ToxWindow *self, Toxic *toxic);
 
 void conference_set_title(ToxWindow *self, uint32_t conferencesnum, const char *title, size_t length)
 {
@@ -156,6 +158,7 @@ static void kill_conference_window(ToxWindow *self, Windows *windows, const Clie
         delwin(ctx->linewin);
         delwin(ctx->history);
         delwin(ctx->sidebar);
+        free_line_history(ctx);
         free(ctx->log);
         free(ctx);
     }
@@ -204,7 +207,8 @@ static void init_conference_logging(ToxWindow *self, Toxic *toxic, uint32_t conf
     }
 }
 
-int64_t init_conference_win(Toxic *toxic, uint32_t conferencenum, uint8_t type, const char *title, size_t length)
+int64_t init_conference_win(Toxic *toxic, uint32_t conferencenum, uint8_t type, const char *title, size_t length,
+                            bool load)
 {
     if (toxic == NULL) {
         return -1;
@@ -216,6 +220,11 @@ int64_t init_conference_win(Toxic *toxic, uint32_t conferencenum, uint8_t type,
 
     ToxWindow *self = new_conference_chat(conferencenum);
 
+    if (load) {
+        self->is_stub = true;
+        self->onStubInit = &conference_onStubInit;
+    }
+
     for (int i = 0; i <= max_conference_index; ++i) {
         if (!conferences[i].active) {
             // FIXME: it is assumed at various points in the code that
@@ -244,7 +253,9 @@ int64_t init_conference_win(Toxic *toxic, uint32_t conferencenum, uint8_t type,
 
             conference_set_title(self, conferencenum, title, length);
 
-            init_conference_logging(self, toxic, conferencenum);
+            if (!load) {
+                init_conference_logging(self, toxic, conferencenum);
+            }
 
             if (i == max_conference_index) {
                 ++max_conference_index;
@@ -1004,7 +1015,7 @@ static bool conference_onKey(ToxWindow *self, Toxic *toxic, wint_t key, bool ltr
 
             if (diff != -1) {
                 if (x + diff > x2 - 1) {
-                    int wlen = MAX(0, wcswidth(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
+                    int wlen = MAX(0, wcs_width(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
                     ctx->start = wlen < x2 ? 0 : wlen - x2 + 1;
                 }
             } else {
@@ -1239,7 +1250,7 @@ static void conference_onDraw(ToxWindow *self, Toxic *toxic)
 
     UNUSED_VAR(x);
 
-    int new_x = ctx->start ? x2 - 1 : MAX(0, wcswidth(ctx->line, ctx->pos));
+    int new_x = ctx->start ? x2 - 1 : MAX(0, wcs_width(ctx->line, ctx->pos));
     wmove(self->window, y, new_x);
 
     draw_window_bar(self, toxic->windows);
@@ -1271,19 +1282,49 @@ static void conference_onInit(ToxWindow *self, Toxic *toxic)
     ctx->linewin = subwin(self->window, CHATBOX_HEIGHT, x2, y2 - CHATBOX_HEIGHT, 0);
     ctx->sidebar = subwin(self->window, y2 - CHATBOX_HEIGHT - WINDOW_BAR_HEIGHT, SIDEBAR_WIDTH, 0, x2 - SIDEBAR_WIDTH);
 
-    ctx->hst = calloc(1, sizeof(struct history));
     ctx->log = calloc(1, sizeof(struct chatlog));
 
-    if (ctx->log == NULL || ctx->hst == NULL) {
+    if (ctx->log == NULL) {
         exit_toxic_err(FATALERR_MEMORY, "failed in conference_onInit");
     }
 
-    line_info_init(ctx->hst);
+    /* a stub window may already have a history from lines added before it was initialized */
+    if (ctx->hst == NULL) {
+        ctx->hst = calloc(1, sizeof(struct history));
+
+        if (ctx->hst == NULL) {
+            exit_toxic_err(FATALERR_MEMORY, "failed in conference_onInit");
+        }
+
+        line_info_init(ctx->hst);
+    }
 
     scrollok(ctx->history, 0);
     wmove(self->window, y2 - CURS_Y_OFFSET, 0);
 }
 
+/*
+ * Finishes the initialization of a conference window that was restored as a stub.
+ */
+static void conference_onStubInit(ToxWindow *self, Toxic *toxic)
+{
+    if (toxic == NULL || self == NULL) {
+        return;
+    }
+
+    init_conference_logging(self, toxic, self->num);
+
+    if (conferences[self->num].type == TOX_CONFERENCE_TYPE_AV) {
+        line_info_add(self, toxic->c_config, false, NULL, NULL, SYS_MSG, 0, 0,
+#ifdef AUDIO
+                      "Use \"/audio on\" to enable audio in this conference."
+#else
+                      "Audio support disabled by compile-time option."
+#endif
+                     );
+    }
+}
+
 /*
  * Return the conference number associated with `public_key`.
  * Return -1 if public_key does not designate a valid conference.
@@ -90,7 +90,14 @@ typedef struct {
 /* Frees all Toxic associated data structures for a conference (does not call tox_conference_delete() ) */
 void free_conference(ToxWindow *self, Windows *windows, const Client_Config *c_config, uint32_t conferencenum);
 
-int64_t init_conference_win(Toxic *toxic, uint32_t conferencenum, uint8_t type, const char *title, size_t length);
+/* Creates a new conference window and returns its window id, or -1 on failure.
+ *
+ * `load` should be true for conferences that are restored from the profile at startup. Their
+ * windows are added as stubs that are only fully initialized when first focused or when
+ * they receive traffic.
+ */
+int64_t init_conference_win(Toxic *toxic, uint32_t conferencenum, uint8_t type, const char *title, size_t length,
+                            bool load);
 
 /* destroys and re-creates conference window with or without the peerlist */
 void redraw_conference_win(ToxWindow *self);
@@ -20,11 +20,14 @@
  *
  */
 
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "api.h"
 #include "chat_commands.h"
+#include "command_parser.h"
 #include "execute.h"
 #include "global_commands.h"
 #include "conference_commands.h"
@@ -35,8 +38,12 @@
 #include "toxic.h"
 #include "windows.h"
 
+/* Sourced files may source other files, up to this depth */
+#define MAX_SOURCE_DEPTH 8
+
+/* The command tables are sorted by name the first time a command is executed */
 struct cmd_func {
-    const char *const name;
+    const char *name;
     void (*func)(WINDOW *w, ToxWindow *, Toxic *toxic, int argc, char (*argv)[MAX_STR_SIZE]);
 };
 
@@ -67,6 +74,7 @@ static struct cmd_func global_commands[] = {
     { "/q",         cmd_quit          },
     { "/quit",      cmd_quit          },
     { "/requests",  cmd_requests      },
+    { "/sched",     cmd_sched         },
     { "/status",    cmd_status        },
 #ifdef AUDIO
     { "/lsdev",     cmd_list_devices  },
@@ -77,9 +85,9 @@ static struct cmd_func global_commands[] = {
     { "/svdev",     cmd_change_video_device },
 #endif /* VIDEO */
 #ifdef PYTHON
+    { "/plugins",   cmd_plugins       },
     { "/run",       cmd_run           },
 #endif /* PYTHON */
-    { NULL,         NULL              },
 };
 
 static struct cmd_func chat_commands[] = {
@@ -108,7 +116,6 @@ static struct cmd_func chat_commands[] = {
     { "/video",     cmd_video             },
     { "/res",       cmd_res               },
 #endif /* VIDEO */
-    { NULL,         NULL                  },
 };
 
 static struct cmd_func conference_commands[] = {
@@ -121,7 +128,6 @@ static struct cmd_func conference_commands[] = {
     { "/ptt",       cmd_conference_push_to_talk },
     { "/sense",     cmd_conference_sense  },
 #endif /* AUDIO */
-    { NULL,         NULL             },
 };
 
 static struct cmd_func groupchat_commands[] = {
@@ -144,11 +150,10 @@ static struct cmd_func groupchat_commands[] = {
     { "/unsilence", cmd_unsilence      },
     { "/voice",     cmd_set_voice      },
     { "/whois",     cmd_whois          },
-    { NULL,         NULL               },
 };
 
 /* Special commands are commands that only take one argument even if it contains spaces */
-static const char special_commands[][MAX_CMDNAME_SIZE] = {
+static const char *special_commands[] = {
     "/add",
     "/avatar",
     "/gaccept",
@@ -160,6 +165,7 @@ static const char special_commands[][MAX_CMDNAME_SIZE] = {
     "/note",
     "/passwd",
     "/silence",
+    "/source",
     "/topic",
     "/unignore",
     "/unmod",
@@ -171,99 +177,122 @@ static const char special_commands[][MAX_CMDNAME_SIZE] = {
     "/sendfile",
     "/title",
     "/mute",
-    "",
 };
 
-/* Returns true if input command is in the special_commands array. */
-static bool is_special_command(const char *input)
-{
-    const int s = char_find(0, input, ' ');
+#define NUM_GLOBAL_COMMANDS     (sizeof(global_commands) / sizeof(global_commands[0]))
+#define NUM_CHAT_COMMANDS       (sizeof(chat_commands) / sizeof(chat_commands[0]))
+#define NUM_CONFERENCE_COMMANDS (sizeof(conference_commands) / sizeof(conference_commands[0]))
+#define NUM_GROUPCHAT_COMMANDS  (sizeof(groupchat_commands) / sizeof(groupchat_commands[0]))
+#define NUM_SPECIAL_COMMANDS    (sizeof(special_commands) / sizeof(special_commands[0]))
 
-    for (int i = 0; special_commands[i][0] != '\0'; ++i) {
-        if (strncmp(input, special_commands[i], s) == 0) {
-            return true;
-        }
-    }
+static pthread_once_t command_tables_once = PTHREAD_ONCE_INIT;
 
-    return false;
+static void sort_command_tables(void)
+{
+    command_table_sort(global_commands, NUM_GLOBAL_COMMANDS, sizeof(struct cmd_func));
+    command_table_sort(chat_commands, NUM_CHAT_COMMANDS, sizeof(struct cmd_func));
+    command_table_sort(conference_commands, NUM_CONFERENCE_COMMANDS, sizeof(struct cmd_func));
+    command_table_sort(groupchat_commands, NUM_GROUPCHAT_COMMANDS, sizeof(struct cmd_func));
+    command_table_sort(special_commands, NUM_SPECIAL_COMMANDS, sizeof(const char *));
 }
 
-/* Parses commands in the special_commands array. Unlike parse_command, this function
- * does not split the input string at spaces.
- *
- * Returns the number of arguments.
- */
-static int parse_special_command(const char *input, char (*args)[MAX_STR_SIZE])
+/* Returns true if `name` is in the special_commands array. */
+static bool is_special_command(const Command_Token *name)
 {
-    int len = strlen(input);
-    int s = char_find(0, input, ' ');
-
-    memcpy(args[0], input, s);
-    args[0][s++] = '\0';    // increment to remove space after "/command "
+    return command_table_find(special_commands, NUM_SPECIAL_COMMANDS, sizeof(const char *), name) != NULL;
+}
 
-    if (s >= len) {
-        return 1;  // No additional args
-    }
+/* Returns the entry for the command called `name` in `commands`, or NULL if there isn't one. */
+static const struct cmd_func *find_command(const struct cmd_func *commands, size_t num_commands,
+        const Command_Token *name)
+{
+    return command_table_find(commands, num_commands, sizeof(struct cmd_func), name);
+}
 
-    memcpy(args[1], input + s, len - s);
-    args[1][len - s] = '\0';
+/* Copies `num_args` tokens into `args` as null terminated strings. Tokens that don't fit are truncated. */
+static void copy_command_args(const Command_Token *tokens, int num_args, char (*args)[MAX_STR_SIZE])
+{
+    for (int i = 0; i < num_args; ++i) {
+        const size_t length = MIN(tokens[i].length, MAX_STR_SIZE - 1);
 
-    return 2;
+        memcpy(args[i], tokens[i].start, length);
+        args[i][length] = '\0';
+    }
 }
 
-/* Parses input command and puts args into arg array.
- *
- * Returns the number of arguments.
- */
-static int parse_command(const char *input, char (*args)[MAX_STR_SIZE])
+static int execute_source_depth;
+
+int execute_file(WINDOW *w, ToxWindow *self, Toxic *toxic, const char *path, int mode)
 {
-    if (is_special_command(input)) {
-        return parse_special_command(input, args);
+    if (execute_source_depth >= MAX_SOURCE_DEPTH) {
+        return -2;
     }
 
-    char *cmd = strdup(input);
+    FILE *fp = fopen(path, "r");
 
-    if (cmd == NULL) {
-        exit_toxic_err(FATALERR_MEMORY, "failed in parse_command");
+    if (fp == NULL) {
+        return -1;
     }
 
-    int num_args = 0;
+    ++execute_source_depth;
 
-    /* characters wrapped in double quotes count as one arg */
-    while (num_args < MAX_NUM_ARGS) {
-        int i = char_find(0, cmd, ' ');    // index of last char in an argument
-        memcpy(args[num_args], cmd, i);
-        args[num_args++][i] = '\0';
+    char line[MAX_STR_SIZE];
+    int count = 0;
 
-        if (cmd[i] == '\0') {  // no more args
-            break;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        const size_t length = strcspn(line, "\r\n");
+
+        if (line[length] == '\0' && !feof(fp)) {
+            int c;
+
+            while ((c = fgetc(fp)) != EOF && c != '\n') {
+                ;  // discard the rest of an overlong line
+            }
         }
 
-        char tmp[MAX_STR_SIZE];
-        snprintf(tmp, sizeof(tmp), "%s", &cmd[i + 1]);
-        strcpy(cmd, tmp);    // tmp will always fit inside cmd
+        line[length] = '\0';
+
+        if (line[0] == '#' || string_is_empty(line)) {
+            continue;
+        }
+
+        execute(w, self, toxic, line, mode);
+        ++count;
     }
 
-    free(cmd);
-    return num_args;
+    fclose(fp);
+
+    --execute_source_depth;
+
+    return count;
 }
 
-/* Matches command to respective function.
- *
- * Returns 0 on match.
- * Returns 1 on no match
+/* Handles the /source command, which is dispatched here rather than through a command table
+ * so that the file's commands run in the caller's mode.
  */
-static int do_command(WINDOW *w, ToxWindow *self, Toxic *toxic, int num_args, struct cmd_func *commands,
-                      char (*args)[MAX_STR_SIZE])
+static void cmd_source(WINDOW *w, ToxWindow *self, Toxic *toxic, int argc, char (*argv)[MAX_STR_SIZE], int mode)
 {
-    for (size_t i = 0; commands[i].name != NULL; ++i) {
-        if (strcmp(args[0], commands[i].name) == 0) {
-            (commands[i].func)(w, self, toxic, num_args - 1, args);
-            return 0;
-        }
+    const Client_Config *c_config = toxic->c_config;
+
+    if (argc < 1) {
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "Path required.");
+        return;
+    }
+
+    const int ret = execute_file(w, self, toxic, argv[1], mode);
+
+    if (ret == -1) {
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "Failed to open file \"%s\"", argv[1]);
+        return;
     }
 
-    return 1;
+    if (ret == -2) {
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "Too many nested /source commands.");
+        return;
+    }
+
+    line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "Executed %d command%s from \"%s\"", ret,
+                  ret == 1 ? "" : "s", argv[1]);
 }
 
 void execute(WINDOW *w, ToxWindow *self, Toxic *toxic, const char *input, int mode)
@@ -272,8 +301,13 @@ void execute(WINDOW *w, ToxWindow *self, Toxic *toxic, const char *input, int mo
         return;
     }
 
-    char args[MAX_NUM_ARGS][MAX_STR_SIZE];
-    int num_args = parse_command(input, args);
+    pthread_once(&command_tables_once, sort_command_tables);
+
+    const size_t length = strlen(input);
+    const Command_Token name = {input, command_name_length(input, length)};
+
+    Command_Token tokens[MAX_NUM_ARGS];
+    const int num_args = (int) command_tokenize(input, length, is_special_command(&name), tokens, MAX_NUM_ARGS);
 
     if (num_args <= 0) {
         return;
@@ -284,37 +318,46 @@ void execute(WINDOW *w, ToxWindow *self, Toxic *toxic, const char *input, int mo
      *
      * Note: Global commands must come last in case of duplicate command names
      */
+    const struct cmd_func *command = NULL;
+
     switch (mode) {
         case CHAT_COMMAND_MODE: {
-            if (do_command(w, self, toxic, num_args, chat_commands, args) == 0) {
-                return;
-            }
-
+            command = find_command(chat_commands, NUM_CHAT_COMMANDS, &name);
             break;
         }
 
         case CONFERENCE_COMMAND_MODE: {
-            if (do_command(w, self, toxic, num_args, conference_commands, args) == 0) {
-                return;
-            }
-
+            command = find_command(conference_commands, NUM_CONFERENCE_COMMANDS, &name);
             break;
         }
 
         case GROUPCHAT_COMMAND_MODE: {
-            if (do_command(w, self, toxic, num_args, groupchat_commands, args) == 0) {
-                return;
-            }
-
+            command = find_command(groupchat_commands, NUM_GROUPCHAT_COMMANDS, &name);
             break;
         }
     }
 
-    if (do_command(w, self, toxic, num_args, global_commands, args) == 0) {
+    if (command == NULL) {
+        command = find_command(global_commands, NUM_GLOBAL_COMMANDS, &name);
+    }
+
+    /* Arguments are only copied out of the input once we know there's someone to hand them to */
+    char args[MAX_NUM_ARGS][MAX_STR_SIZE];
+
+    if (command != NULL) {
+        copy_command_args(tokens, num_args, args);
+        command->func(w, self, toxic, num_args - 1, args);
+        return;
+    }
+
+    if (command_token_compare(&name, "/source") == 0) {
+        copy_command_args(tokens, num_args, args);
+        cmd_source(w, self, toxic, num_args - 1, args, mode);
         return;
     }
 
 #ifdef PYTHON
+    copy_command_args(tokens, num_args, args);
 
     if (do_plugin_command(num_args, args) == 0) {
         return;
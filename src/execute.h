@@ -37,4 +37,14 @@ enum {
 
 void execute(WINDOW *w, ToxWindow *self, Toxic *toxic, const char *input, int mode);
 
+/*
+ * Executes each line of the file at `path` as a command in `mode`. Blank lines and lines
+ * starting with '#' are skipped.
+ *
+ * Return the number of commands executed.
+ * Return -1 if the file can't be opened.
+ * Return -2 if sourcing the file would nest too deeply.
+ */
+int execute_file(WINDOW *w, ToxWindow *self, Toxic *toxic, const char *path, int mode);
+
 #endif /* EXECUTE_H */
@@ -21,6 +21,8 @@
  */
 
 #include <arpa/inet.h>
+#include <ctype.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -37,6 +39,7 @@
 #include "misc_tools.h"
 #include "notify.h"
 #include "prompt.h"
+#include "scheduler.h"
 #include "settings.h"
 #include "toxic.h"
 #include "windows.h"
@@ -58,6 +61,47 @@ static struct Blocked {
     BlockedFriend *list;
 } Blocked;
 
+/* A copy of everything friendlist_onDraw() needs to draw a single friend */
+typedef struct Friend_Row {
+    uint32_t num;
+    Tox_Connection connection_status;
+    Tox_User_Status status;
+    char name[TOXIC_MAX_NAME_LENGTH + 1];
+    char statusmsg[TOX_MAX_STATUS_MESSAGE_LENGTH + 1];
+    size_t statusmsg_len;
+    char pub_key[TOX_PUBLIC_KEY_SIZE];
+    struct LastOnline last_online;
+} Friend_Row;
+
+typedef struct Friend_Snapshot {
+    Friend_Row *rows;   /* friends in display order */
+    size_t num_rows;
+    size_t num_online;
+    size_t capacity;
+} Friend_Snapshot;
+
+#define NUM_FRIEND_SNAPSHOTS 3
+
+/*
+ * The friend list is drawn from immutable snapshots so that the draw loop never has to
+ * touch Winthread.lock. Snapshots are built by friendlist_update_snapshot() on the Tox
+ * thread with Winthread.lock held, which serializes writers. The UI thread is the only reader.
+ *
+ * A writer always fills a buffer that is neither the current one nor the one the reader has
+ * claimed, then publishes it by swapping `current`. The reader claims a buffer by storing its
+ * index in `reading` and checking that it's still current afterwards; if it isn't, a writer may
+ * have picked it before the claim became visible, so the reader tries again.
+ */
+static struct Friend_Snapshots {
+    Friend_Snapshot buf[NUM_FRIEND_SNAPSHOTS];
+    atomic_int current;
+    atomic_int reading;    /* -1 if the UI thread isn't reading a snapshot */
+    bool dirty;            /* true if the friend list changed since the last snapshot */
+} Snapshots = {
+    .current = 0,
+    .reading = -1,
+};
+
 static struct PendingDel {
     uint32_t num;
     bool active;
@@ -142,6 +186,13 @@ void kill_friendlist(ToxWindow *self, Windows *windows, const Client_Config *c_c
         }
     }
 
+    for (size_t i = 0; i < NUM_FRIEND_SNAPSHOTS; ++i) {
+        free(Snapshots.buf[i].rows);
+        Snapshots.buf[i] = (Friend_Snapshot) {
+            0
+        };
+    }
+
     realloc_blocklist(0);
     realloc_friends(0);
     free(self->help);
@@ -341,33 +392,251 @@ int load_blocklist(char *path)
     return 0;
 }
 
-#define S_WEIGHT 100000
+/*
+ * Bookkeeping for Friends.index. The online partition is Friends.index[0, num_online) and the
+ * offline partition is Friends.index[num_online, count). Both are kept sorted by each friend's
+ * case-folded name, with the friend number breaking ties so that every friend has exactly one
+ * position and can be found with a binary search.
+ */
+static struct Friends_Order {
+    size_t count;
+    size_t num_online;
+} Order;
+
+static bool friend_is_online(uint32_t f)
+{
+    return Friends.list[f].connection_status != TOX_CONNECTION_NONE;
+}
+
+/* Case-folds `friend`'s name into its sort key. Must be called whenever the name changes. */
+static void set_friend_sort_key(ToxicFriend *friend)
+{
+    size_t i = 0;
+
+    for (; i < sizeof(friend->sort_key) - 1 && friend->name[i] != '\0'; ++i) {
+        friend->sort_key[i] = (char) tolower((unsigned char) friend->name[i]);
+    }
+
+    friend->sort_key[i] = '\0';
+}
+
+static int friend_order_cmp(uint32_t f1, uint32_t f2)
+{
+    const int res = strcmp(Friends.list[f1].sort_key, Friends.list[f2].sort_key);
+
+    if (res != 0) {
+        return res;
+    }
+
+    return (f1 > f2) - (f1 < f2);
+}
+
+/* Returns the first position in Friends.index[lo, hi) that doesn't sort before `f`. */
+static size_t friend_order_lower_bound(uint32_t f, size_t lo, size_t hi)
+{
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (friend_order_cmp(Friends.index[mid], f) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/*
+ * Inserts friend `f` into the partition that matches its current connection status.
+ *
+ * Friends.index must have room for one more entry.
+ */
+static void friend_order_insert(uint32_t f)
+{
+    const bool online = friend_is_online(f);
+    const size_t lo = online ? 0 : Order.num_online;
+    const size_t hi = online ? Order.num_online : Order.count;
+    const size_t pos = friend_order_lower_bound(f, lo, hi);
+
+    memmove(&Friends.index[pos + 1], &Friends.index[pos], (Order.count - pos) * sizeof(uint32_t));
+    Friends.index[pos] = f;
+
+    ++Order.count;
+
+    if (online) {
+        ++Order.num_online;
+    }
+
+    Snapshots.dirty = true;
+}
+
+/*
+ * Removes friend `f` from the online or offline partition. The friend's sort key must not
+ * have changed since it was inserted.
+ */
+static void friend_order_remove(uint32_t f, bool online)
+{
+    const size_t lo = online ? 0 : Order.num_online;
+    const size_t hi = online ? Order.num_online : Order.count;
+    const size_t pos = friend_order_lower_bound(f, lo, hi);
+
+    if (pos >= hi || Friends.index[pos] != f) {
+        fprintf(stderr, "friend_order_remove: friend %u is not in the index\n", f);
+        return;
+    }
+
+    memmove(&Friends.index[pos], &Friends.index[pos + 1], (Order.count - pos - 1) * sizeof(uint32_t));
+
+    --Order.count;
+
+    if (online) {
+        --Order.num_online;
+    }
+
+    Snapshots.dirty = true;
+}
+
 static int index_name_cmp(const void *n1, const void *n2)
 {
-    int res = qsort_strcasecmp_hlpr(Friends.list[*(const int *) n1].name, Friends.list[*(const int *) n2].name);
+    const uint32_t f1 = *(const uint32_t *) n1;
+    const uint32_t f2 = *(const uint32_t *) n2;
+    const bool online1 = friend_is_online(f1);
 
-    /* Use weight to make qsort always put online friends before offline */
-    res = Friends.list[*(const int *) n1].connection_status ? (res - S_WEIGHT) : (res + S_WEIGHT);
-    res = Friends.list[*(const int *) n2].connection_status ? (res + S_WEIGHT) : (res - S_WEIGHT);
+    /* online friends always go before offline friends */
+    if (online1 != friend_is_online(f2)) {
+        return online1 ? -1 : 1;
+    }
 
-    return res;
+    return friend_order_cmp(f1, f2);
 }
 
-/* sorts Friends.index first by connection status then alphabetically */
 void sort_friendlist_index(void)
 {
-    size_t i;
     uint32_t n = 0;
+    size_t num_online = 0;
 
-    for (i = 0; i < Friends.max_idx; ++i) {
+    for (size_t i = 0; i < Friends.max_idx; ++i) {
         if (Friends.list[i].active) {
             Friends.index[n++] = Friends.list[i].num;
+
+            if (friend_is_online(i)) {
+                ++num_online;
+            }
         }
     }
 
-    if (Friends.num_friends > 0) {
-        qsort(Friends.index, Friends.num_friends, sizeof(uint32_t), index_name_cmp);
+    if (n > 0) {
+        qsort(Friends.index, n, sizeof(uint32_t), index_name_cmp);
     }
+
+    Order.count = n;
+    Order.num_online = num_online;
+
+    Snapshots.dirty = true;
+}
+
+/*
+ * Flags the friend list as changed so that a new snapshot is published on the next Tox
+ * iteration.
+ *
+ * Must be called with Winthread.lock held.
+ */
+static void friendlist_set_dirty(void)
+{
+    Snapshots.dirty = true;
+}
+
+/*
+ * Same as friendlist_set_dirty() but for changes made from the UI thread. The Tox task is
+ * woken up so that the change is drawn right away.
+ */
+static void friendlist_set_dirty_ui(void)
+{
+    friendlist_set_dirty();
+    scheduler_trigger(SCHED_TASK_TOX);
+}
+
+void friendlist_update_snapshot(void)
+{
+    if (!Snapshots.dirty) {
+        return;
+    }
+
+    const int current = atomic_load(&Snapshots.current);
+    const int reading = atomic_load(&Snapshots.reading);
+
+    int target = 0;
+
+    while (target == current || target == reading) {
+        ++target;
+    }
+
+    Friend_Snapshot *snap = &Snapshots.buf[target];
+
+    if (snap->capacity < Friends.num_friends) {
+        Friend_Row *tmp = realloc(snap->rows, Friends.num_friends * sizeof(Friend_Row));
+
+        if (tmp == NULL) {
+            fprintf(stderr, "friendlist_update_snapshot: realloc failed\n");
+            return;
+        }
+
+        snap->rows = tmp;
+        snap->capacity = Friends.num_friends;
+    }
+
+    size_t n = 0;
+
+    for (size_t i = 0; i < Order.count; ++i) {
+        const uint32_t f = Friends.index[i];
+
+        if (f >= Friends.max_idx || !Friends.list[f].active) {
+            continue;
+        }
+
+        const ToxicFriend *friend = &Friends.list[f];
+        Friend_Row *row = &snap->rows[n++];
+
+        row->num = f;
+        row->connection_status = friend->connection_status;
+        row->status = friend->status;
+        row->statusmsg_len = friend->statusmsg_len;
+        row->last_online = friend->last_online;
+        memcpy(row->name, friend->name, sizeof(row->name));
+        memcpy(row->statusmsg, friend->statusmsg, sizeof(row->statusmsg));
+        memcpy(row->pub_key, friend->pub_key, sizeof(row->pub_key));
+    }
+
+    snap->num_rows = n;
+    snap->num_online = Friends.num_online;
+
+    atomic_store(&Snapshots.current, target);
+
+    Snapshots.dirty = false;
+}
+
+/*
+ * Claims the most recently published snapshot for reading. The snapshot stays valid until
+ * friendlist_release_snapshot() is called.
+ *
+ * Must only be called from the UI thread.
+ */
+static const Friend_Snapshot *friendlist_acquire_snapshot(void)
+{
+    int idx;
+
+    do {
+        idx = atomic_load(&Snapshots.current);
+        atomic_store(&Snapshots.reading, idx);
+    } while (atomic_load(&Snapshots.current) != idx);
+
+    return &Snapshots.buf[idx];
+}
+
+static void friendlist_release_snapshot(void)
+{
+    atomic_store(&Snapshots.reading, -1);
 }
 
 static int index_name_cmp_block(const void *n1, const void *n2)
@@ -435,9 +704,11 @@ static void friendlist_onConnectionChange(ToxWindow *self, Toxic *toxic, uint32_
         return;
     }
 
+    const bool was_online = Friends.list[num].connection_status != TOX_CONNECTION_NONE;
+
     if (connection_status == TOX_CONNECTION_NONE) {
         --Friends.num_online;
-    } else if (Friends.list[num].connection_status == TOX_CONNECTION_NONE) {
+    } else if (!was_online) {
         ++Friends.num_online;
 
         if (avatar_send(toxic->tox, num) == -1) {
@@ -448,7 +719,14 @@ static void friendlist_onConnectionChange(ToxWindow *self, Toxic *toxic, uint32_
     Friends.list[num].connection_status = connection_status;
     update_friend_last_online(num, get_unix_time(), toxic->c_config->timestamp_format);
     store_data(toxic);
-    sort_friendlist_index();
+
+    /* switching between TCP and UDP doesn't change the friend's position in the list */
+    if (was_online != friend_is_online(num)) {
+        friend_order_remove(num, was_online);
+        friend_order_insert(num);
+    }
+
+    friendlist_set_dirty();
 }
 
 static void friendlist_onNickChange(ToxWindow *self, Toxic *toxic, uint32_t num, const char *nick, size_t length)
@@ -464,9 +742,21 @@ static void friendlist_onNickChange(ToxWindow *self, Toxic *toxic, uint32_t num,
     char oldname[TOXIC_MAX_NAME_LENGTH + 1];
     snprintf(oldname, sizeof(oldname), "%s", Friends.list[num].name);
 
+    /* the friend has to be found by its old sort key before it can be moved */
+    const bool reorder = Friends.list[num].active && strcmp(oldname, nick) != 0;
+
+    if (reorder) {
+        friend_order_remove(num, friend_is_online(num));
+    }
+
     /* update name */
     snprintf(Friends.list[num].name, sizeof(Friends.list[num].name), "%s", nick);
     Friends.list[num].namelength = strlen(Friends.list[num].name);
+    set_friend_sort_key(&Friends.list[num]);
+
+    if (reorder) {
+        friend_order_insert(num);
+    }
 
     /* get data for chatlog renaming */
     char newnamecpy[TOXIC_MAX_NAME_LENGTH + 1];
@@ -480,8 +770,6 @@ static void friendlist_onNickChange(ToxWindow *self, Toxic *toxic, uint32_t num,
             fprintf(stderr, "Failed to rename friend chat log from `%s` to `%s`\n", oldname, newnamecpy);
         }
     }
-
-    sort_friendlist_index();
 }
 
 static void friendlist_onNickRefresh(ToxWindow *self, Toxic *toxic)
@@ -489,7 +777,7 @@ static void friendlist_onNickRefresh(ToxWindow *self, Toxic *toxic)
     UNUSED_VAR(self);
     UNUSED_VAR(toxic);
 
-    sort_friendlist_index();
+    friendlist_set_dirty();
 }
 
 static void friendlist_onStatusChange(ToxWindow *self, Toxic *toxic, uint32_t num, Tox_User_Status status)
@@ -502,6 +790,7 @@ static void friendlist_onStatusChange(ToxWindow *self, Toxic *toxic, uint32_t nu
     }
 
     Friends.list[num].status = status;
+    friendlist_set_dirty();
 }
 
 static void friendlist_onStatusMessageChange(ToxWindow *self, uint32_t num, const char *note, size_t length)
@@ -514,6 +803,7 @@ static void friendlist_onStatusMessageChange(ToxWindow *self, uint32_t num, cons
 
     snprintf(Friends.list[num].statusmsg, sizeof(Friends.list[num].statusmsg), "%s", note);
     Friends.list[num].statusmsg_len = strlen(Friends.list[num].statusmsg);
+    friendlist_set_dirty();
 }
 
 void friendlist_onFriendAdded(ToxWindow *self, Toxic *toxic, uint32_t num, bool sort)
@@ -567,13 +857,25 @@ void friendlist_onFriendAdded(ToxWindow *self, Toxic *toxic, uint32_t num, bool
 
         snprintf(Friends.list[i].name, sizeof(Friends.list[i].name), "%s", tempname);
         Friends.list[i].namelength = name_len;
+        set_friend_sort_key(&Friends.list[i]);
+
+        Tox_Err_Friend_Query smerr;
+        const size_t s_len = tox_friend_get_status_message_size(tox, num, &smerr);
+
+        if (smerr == TOX_ERR_FRIEND_QUERY_OK && s_len <= TOX_MAX_STATUS_MESSAGE_LENGTH) {
+            tox_friend_get_status_message(tox, num, (uint8_t *) Friends.list[i].statusmsg, NULL);
+            Friends.list[i].statusmsg[s_len] = '\0';
+            filter_str(Friends.list[i].statusmsg, s_len);
+            Friends.list[i].statusmsg_len = strlen(Friends.list[i].statusmsg);
+        }
 
         if (i == Friends.max_idx) {
             ++Friends.max_idx;
         }
 
         if (sort) {
-            sort_friendlist_index();
+            friend_order_insert(i);
+            friendlist_set_dirty_ui();
         }
 
 #ifdef AUDIO
@@ -605,6 +907,7 @@ static void friendlist_add_blocked(const Client_Config *c_config, uint32_t fnum,
         update_friend_last_online(i, Blocked.list[bnum].last_on, c_config->timestamp_format);
         memcpy(Friends.list[i].name, Blocked.list[bnum].name, Friends.list[i].namelength + 1);
         memcpy(Friends.list[i].pub_key, Blocked.list[bnum].pub_key, TOX_PUBLIC_KEY_SIZE);
+        set_friend_sort_key(&Friends.list[i]);
         set_default_friend_config_settings(&Friends.list[i], c_config);
 
         if (i == Friends.max_idx) {
@@ -612,7 +915,8 @@ static void friendlist_add_blocked(const Client_Config *c_config, uint32_t fnum,
         }
 
         sort_blocklist_index();
-        sort_friendlist_index();
+        friend_order_insert(i);
+        friendlist_set_dirty_ui();
 
 #ifdef AUDIO
         init_friend_AV(i);
@@ -736,7 +1040,7 @@ static void select_friend(wint_t key, int *selected, int num)
     }
 }
 
-static void delete_friend(Toxic *toxic, uint32_t f_num)
+void delete_friend(Toxic *toxic, uint32_t f_num)
 {
     if (toxic == NULL) {
         return;
@@ -774,6 +1078,7 @@ static void delete_friend(Toxic *toxic, uint32_t f_num)
         free(Friends.list[f_num].conference_invite.key);
     }
 
+    friend_order_remove(f_num, friend_is_online(f_num));
     clear_friendlist_index(f_num);
 
     int i;
@@ -815,7 +1120,7 @@ static void del_friend_deactivate(Toxic *toxic, wint_t key)
     if (key == L'y') {
         if (blocklist_view == 0) {
             delete_friend(toxic, PendingDelete.num);
-            sort_friendlist_index();
+            friendlist_set_dirty_ui();
         } else {
             delete_blocked_friend(toxic, PendingDelete.num);
             sort_blocklist_index();
@@ -916,7 +1221,7 @@ static void block_friend(Toxic *toxic, uint32_t fnum)
         delete_friend(toxic, fnum);
         save_blocklist(toxic->client_data.block_path);
         sort_blocklist_index();
-        sort_friendlist_index();
+        friendlist_set_dirty_ui();
 
         return;
     }
@@ -941,7 +1246,7 @@ static void unblock_friend(Toxic *toxic, uint32_t bnum)
     friendlist_add_blocked(toxic->c_config, friendnum, bnum);
     delete_blocked_friend(toxic, bnum);
     sort_blocklist_index();
-    sort_friendlist_index();
+    friendlist_set_dirty_ui();
 }
 
 /*
@@ -973,14 +1278,6 @@ static bool friendlist_onKey(ToxWindow *self, Toxic *toxic, wint_t key, bool ltr
         return true;
     }
 
-    int f = 0;
-
-    if (blocklist_view == 1 && Blocked.num_blocked) {
-        f = Blocked.index[Blocked.num_selected];
-    } else if (Friends.num_friends) {
-        f = Friends.index[Friends.num_selected];
-    }
-
     /* lock screen and force decision on deletion popup */
     if (PendingDelete.active) {
         if (key == L'y' || key == L'n') {
@@ -994,6 +1291,27 @@ static bool friendlist_onKey(ToxWindow *self, Toxic *toxic, wint_t key, bool ltr
         return true;
     }
 
+    int f = 0;
+
+    if (blocklist_view == 1 && Blocked.num_blocked) {
+        f = Blocked.index[Blocked.num_selected];
+    } else if (Friends.num_friends) {
+        /* The selection refers to the list as it's drawn. We hold Winthread.lock so no snapshot
+         * can be published while we're reading it. */
+        const Friend_Snapshot *snap = &Snapshots.buf[atomic_load(&Snapshots.current)];
+        const size_t selected = (size_t) Friends.num_selected;
+
+        /* the friend was removed and the change hasn't been drawn yet */
+        if (selected >= snap->num_rows || snap->rows[selected].num >= Friends.max_idx
+                || !Friends.list[snap->rows[selected].num].active) {
+            if (key == L'\r' || key == KEY_DC || key == L'b') {
+                return true;
+            }
+        } else {
+            f = snap->rows[selected].num;
+        }
+    }
+
     switch (key) {
         case L'\r':
             if (blocklist_view) {
@@ -1127,8 +1445,6 @@ static void friendlist_onDraw(ToxWindow *self, Toxic *toxic)
     int x2, y2;
     getmaxyx(self->window, y2, x2);
 
-    const bool fix_statuses = x2 != self->x;    /* true if window max x value has changed */
-
     wattron(self->window, COLOR_PAIR(CYAN));
     wprintw(self->window, " Press the");
     wattron(self->window, A_BOLD);
@@ -1147,183 +1463,138 @@ static void friendlist_onDraw(ToxWindow *self, Toxic *toxic)
     const time_t cur_time = get_unix_time();
     struct tm cur_loc_tm = *localtime((const time_t *) &cur_time);
 
+    const Friend_Snapshot *snap = friendlist_acquire_snapshot();
+    const size_t num_rows = snap->num_rows;
+
     wattron(self->window, A_BOLD);
     wprintw(self->window, " Online: ");
     wattroff(self->window, A_BOLD);
 
-    wprintw(self->window, "%zu/%zu \n\n", Friends.num_online, Friends.num_friends);
+    wprintw(self->window, "%zu/%zu \n\n", snap->num_online, num_rows);
 
     if ((y2 - FLIST_OFST) <= 0) {
+        friendlist_release_snapshot();
         return;
     }
 
-    uint32_t selected_num = 0;
+    /* The selection is only changed by the UI thread so it's safe to read without the lock. It may
+     * briefly point past the end of the list after a friend is removed. */
+    int num_selected = Friends.num_selected;
 
-    /* Determine which portion of friendlist to draw based on current position */
-    pthread_mutex_lock(&Winthread.lock);
-    const int page = Friends.num_selected / (y2 - FLIST_OFST);
-    pthread_mutex_unlock(&Winthread.lock);
+    if (num_rows > 0 && num_selected >= num_rows) {
+        num_selected = num_rows - 1;
+    }
+
+    const Friend_Row *selected_row = NULL;
 
+    /* Determine which portion of friendlist to draw based on current position */
+    const int page = num_selected / (y2 - FLIST_OFST);
     const int start = (y2 - FLIST_OFST) * page;
     const int end = y2 - FLIST_OFST + start;
 
-    pthread_mutex_lock(&Winthread.lock);
-    const size_t num_friends = Friends.num_friends;
-    pthread_mutex_unlock(&Winthread.lock);
-
-    for (int i = start; i < num_friends && i < end; ++i) {
-        pthread_mutex_lock(&Winthread.lock);
-        uint32_t f = Friends.index[i];
-        bool is_active = Friends.list[f].active;
-        int num_selected = Friends.num_selected;
-        pthread_mutex_unlock(&Winthread.lock);
-
-        if (is_active) {
-            bool f_selected = false;
-
-            if (i == num_selected) {
-                wattron(self->window, A_BOLD);
-                wprintw(self->window, " > ");
-                wattroff(self->window, A_BOLD);
-                selected_num = f;
-                f_selected = true;
-            } else {
-                wprintw(self->window, "   ");
-            }
-
-            pthread_mutex_lock(&Winthread.lock);
-            Tox_Connection connection_status = Friends.list[f].connection_status;
-            Tox_User_Status status = Friends.list[f].status;
-            pthread_mutex_unlock(&Winthread.lock);
-
-            if (connection_status != TOX_CONNECTION_NONE) {
-                int colour = MAGENTA;
-
-                switch (status) {
-                    case TOX_USER_STATUS_NONE:
-                        colour = GREEN;
-                        break;
-
-                    case TOX_USER_STATUS_AWAY:
-                        colour = YELLOW;
-                        break;
-
-                    case TOX_USER_STATUS_BUSY:
-                        colour = RED;
-                        break;
-                }
-
-                wattron(self->window, COLOR_PAIR(colour) | A_BOLD);
-                wprintw(self->window, "%s ", ONLINE_CHAR);
-                wattroff(self->window, COLOR_PAIR(colour) | A_BOLD);
-
-                if (f_selected) {
-                    wattron(self->window, COLOR_PAIR(BLUE));
-                }
-
-                wattron(self->window, A_BOLD);
-                pthread_mutex_lock(&Winthread.lock);
-                wprintw(self->window, "%s", Friends.list[f].name);
-                pthread_mutex_unlock(&Winthread.lock);
-                wattroff(self->window, A_BOLD);
-
-                if (f_selected) {
-                    wattroff(self->window, COLOR_PAIR(BLUE));
-                }
-
-                /* Reset Friends.list[f].statusmsg on window resize */
-                if (fix_statuses) {
-                    char statusmsg[TOX_MAX_STATUS_MESSAGE_LENGTH];
+    for (int i = start; i < num_rows && i < end; ++i) {
+        const Friend_Row *row = &snap->rows[i];
+        bool f_selected = false;
 
-                    pthread_mutex_lock(&Winthread.lock);
-                    tox_friend_get_status_message(toxic->tox, Friends.list[f].num, (uint8_t *) statusmsg, NULL);
-                    const size_t s_len = tox_friend_get_status_message_size(toxic->tox, Friends.list[f].num, NULL);
-                    pthread_mutex_unlock(&Winthread.lock);
+        if (i == num_selected) {
+            wattron(self->window, A_BOLD);
+            wprintw(self->window, " > ");
+            wattroff(self->window, A_BOLD);
+            selected_row = row;
+            f_selected = true;
+        } else {
+            wprintw(self->window, "   ");
+        }
 
-                    statusmsg[s_len] = '\0';
+        if (row->connection_status != TOX_CONNECTION_NONE) {
+            int colour = MAGENTA;
 
-                    filter_str(statusmsg, s_len);
+            switch (row->status) {
+                case TOX_USER_STATUS_NONE:
+                    colour = GREEN;
+                    break;
 
-                    pthread_mutex_lock(&Winthread.lock);
-                    snprintf(Friends.list[f].statusmsg, sizeof(Friends.list[f].statusmsg), "%s", statusmsg);
-                    Friends.list[f].statusmsg_len = strlen(Friends.list[f].statusmsg);
-                    pthread_mutex_unlock(&Winthread.lock);
-                }
+                case TOX_USER_STATUS_AWAY:
+                    colour = YELLOW;
+                    break;
 
-                /* Truncate note if it doesn't fit on one line */
-                size_t maxlen = x2 - getcurx(self->window) - 2;
+                case TOX_USER_STATUS_BUSY:
+                    colour = RED;
+                    break;
+            }
 
-                pthread_mutex_lock(&Winthread.lock);
+            wattron(self->window, COLOR_PAIR(colour) | A_BOLD);
+            wprintw(self->window, "%s ", ONLINE_CHAR);
+            wattroff(self->window, COLOR_PAIR(colour) | A_BOLD);
 
-                if (Friends.list[f].statusmsg_len > maxlen) {
-                    Friends.list[f].statusmsg[maxlen - 3] = '\0';
-                    strcat(Friends.list[f].statusmsg, "...");
-                    Friends.list[f].statusmsg[maxlen] = '\0';
-                    Friends.list[f].statusmsg_len = maxlen;
-                }
+            if (f_selected) {
+                wattron(self->window, COLOR_PAIR(BLUE));
+            }
 
-                if (Friends.list[f].statusmsg_len > 0) {
-                    wprintw(self->window, " %s", Friends.list[f].statusmsg);
-                }
+            wattron(self->window, A_BOLD);
+            wprintw(self->window, "%s", row->name);
+            wattroff(self->window, A_BOLD);
 
-                pthread_mutex_unlock(&Winthread.lock);
+            if (f_selected) {
+                wattroff(self->window, COLOR_PAIR(BLUE));
+            }
 
-                wprintw(self->window, "\n");
-            } else {
-                wprintw(self->window, "%s ", OFFLINE_CHAR);
+            /* Truncate note if it doesn't fit on one line */
+            const int maxlen = x2 - getcurx(self->window) - 2;
 
-                if (f_selected) {
-                    wattron(self->window, COLOR_PAIR(BLUE));
+            if (row->statusmsg_len > 0 && maxlen > 3) {
+                if (row->statusmsg_len > (size_t) maxlen) {
+                    wprintw(self->window, " %.*s...", maxlen - 3, row->statusmsg);
+                } else {
+                    wprintw(self->window, " %s", row->statusmsg);
                 }
+            }
 
-                wattron(self->window, A_BOLD);
-                pthread_mutex_lock(&Winthread.lock);
-                wprintw(self->window, "%s", Friends.list[f].name);
-                pthread_mutex_unlock(&Winthread.lock);
-                wattroff(self->window, A_BOLD);
-
-                if (f_selected) {
-                    wattroff(self->window, COLOR_PAIR(BLUE));
-                }
+            wprintw(self->window, "\n");
+        } else {
+            wprintw(self->window, "%s ", OFFLINE_CHAR);
 
-                pthread_mutex_lock(&Winthread.lock);
-                time_t last_seen = Friends.list[f].last_online.last_on;
-                pthread_mutex_unlock(&Winthread.lock);
+            if (f_selected) {
+                wattron(self->window, COLOR_PAIR(BLUE));
+            }
 
-                if (last_seen != 0) {
-                    pthread_mutex_lock(&Winthread.lock);
+            wattron(self->window, A_BOLD);
+            wprintw(self->window, "%s", row->name);
+            wattroff(self->window, A_BOLD);
 
-                    int day_dist = (
-                                       cur_loc_tm.tm_yday - Friends.list[f].last_online.tm.tm_yday
-                                       + ((cur_loc_tm.tm_year - Friends.list[f].last_online.tm.tm_year) * 365)
-                                   );
-                    const char *hourmin = Friends.list[f].last_online.hour_min_str;
+            if (f_selected) {
+                wattroff(self->window, COLOR_PAIR(BLUE));
+            }
 
-                    pthread_mutex_unlock(&Winthread.lock);
+            if (row->last_online.last_on != 0) {
+                const int day_dist = (
+                                         cur_loc_tm.tm_yday - row->last_online.tm.tm_yday
+                                         + ((cur_loc_tm.tm_year - row->last_online.tm.tm_year) * 365)
+                                     );
+                const char *hourmin = row->last_online.hour_min_str;
 
-                    switch (day_dist) {
-                        case 0:
-                            wprintw(self->window, " Last seen: Today %s\n", hourmin);
-                            break;
+                switch (day_dist) {
+                    case 0:
+                        wprintw(self->window, " Last seen: Today %s\n", hourmin);
+                        break;
 
-                        case 1:
-                            wprintw(self->window, " Last seen: Yesterday %s\n", hourmin);
-                            break;
+                    case 1:
+                        wprintw(self->window, " Last seen: Yesterday %s\n", hourmin);
+                        break;
 
-                        default:
-                            wprintw(self->window, " Last seen: %d days ago\n", day_dist);
-                            break;
-                    }
-                } else {
-                    wprintw(self->window, " Last seen: Never\n");
+                    default:
+                        wprintw(self->window, " Last seen: %d days ago\n", day_dist);
+                        break;
                 }
+            } else {
+                wprintw(self->window, " Last seen: Never\n");
             }
         }
     }
 
     self->x = x2;
 
-    if (num_friends) {
+    if (selected_row != NULL) {
         wmove(self->window, y2 - 1, 1);
 
         wattron(self->window, A_BOLD);
@@ -1331,10 +1602,12 @@ static void friendlist_onDraw(ToxWindow *self, Toxic *toxic)
         wattroff(self->window, A_BOLD);
 
         for (int i = 0; i < TOX_PUBLIC_KEY_SIZE; ++i) {
-            wprintw(self->window, "%02X", Friends.list[selected_num].pub_key[i] & 0xff);
+            wprintw(self->window, "%02X", selected_row->pub_key[i] & 0xff);
         }
     }
 
+    friendlist_release_snapshot();
+
     wnoutrefresh(self->window);
     draw_del_popup();
 
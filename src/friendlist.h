@@ -81,6 +81,7 @@ typedef struct Friend_Settings {
 typedef struct {
     char name[TOXIC_MAX_NAME_LENGTH + 1];
     uint16_t namelength;
+    char sort_key[TOXIC_MAX_NAME_LENGTH + 1];   /* case-folded copy of name used for ordering */
     char statusmsg[TOX_MAX_STATUS_MESSAGE_LENGTH + 1];
     size_t statusmsg_len;
     char pub_key[TOX_PUBLIC_KEY_SIZE];
@@ -123,7 +124,7 @@ typedef struct {
     size_t num_friends;
     size_t num_online;
     size_t max_idx;    /* 1 + the index of the last friend in list */
-    uint32_t *index;
+    uint32_t *index;   /* online friends followed by offline friends, each sorted by name */
     ToxicFriend *list;
 } FriendsList;
 
@@ -135,6 +136,12 @@ void disable_friend_window(uint32_t f_num);
 int get_friendnum(uint8_t *name);
 void kill_friendlist(ToxWindow *self, Windows *windows, const Client_Config *c_config);
 void friendlist_onFriendAdded(ToxWindow *self, Toxic *toxic, uint32_t num, bool sort);
+
+/*
+ * Deletes friend `f_num` from Tox and the friend list, cancelling their file transfers and
+ * closing their chat window if one is open.
+ */
+void delete_friend(Toxic *toxic, uint32_t f_num);
 Tox_User_Status get_friend_status(uint32_t friendnumber);
 Tox_Connection get_friend_connection_status(uint32_t friendnumber);
 
@@ -147,9 +154,22 @@ Tox_Connection get_friend_connection_status(uint32_t friendnumber);
  */
 int load_blocklist(char *path);
 
-/* sorts friendlist_index first by connection status then alphabetically */
+/*
+ * Rebuilds Friends.index from scratch, sorted first by connection status then alphabetically.
+ *
+ * Only needed after adding friends in bulk with `sort` set to false. Other changes keep the
+ * index ordered incrementally.
+ */
 void sort_friendlist_index(void);
 
+/*
+ * Publishes a new snapshot of the friend list for the UI thread to draw from if the list
+ * has changed since the last call.
+ *
+ * Must be called from the Tox thread with Winthread.lock held.
+ */
+void friendlist_update_snapshot(void);
+
 /*
  * Returns true if friend associated with `public_key` is in the block list.
  *
@@ -20,6 +20,8 @@
  *
  */
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -51,6 +53,43 @@ extern struct Winthread Winthread;
 #define GAME_DEFAULT_UPDATE_INTERVAL 10
 #define GAME_MAX_UPDATE_INTERVAL 50
 
+/* How many milliseconds the simulation may fall behind schedule before it drops ticks rather than catch up */
+#define GAME_SIM_MAX_LAG 500
+
+/* How long the simulation thread sleeps between attempts to take the tox lock */
+#define GAME_SIM_LOCK_POLL_USEC 1000L
+
+/* How often in milliseconds the timing stats are updated */
+#define GAME_STATS_INTERVAL 1000
+
+/*
+ * Game state is advanced on its own thread at a fixed rate of one tick per update interval, independently
+ * of how often the window is drawn. The UI thread holds `lock` while it draws, handles input or handles a
+ * packet, so it always sees the state between whole ticks.
+ */
+struct GameSim {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    atomic_bool     running;
+    bool            thread_started;
+
+    bool            show_stats;
+
+    /* Timing stats for the last complete interval */
+    size_t          ticks_per_second;
+    size_t          frames_per_second;
+    int64_t         tick_avg_usec;
+    int64_t         tick_max_usec;
+    size_t          ticks_dropped;
+
+    /* Timing stats accumulated over the current interval */
+    TIME_MS         interval_start;
+    size_t          ticks;
+    size_t          frames;
+    int64_t         tick_total_usec;
+    int64_t         tick_peak_usec;
+};
 
 
 /* Determines if window is large enough for a respective window type */
@@ -67,7 +106,7 @@ extern struct Winthread Winthread;
                                                  && ((max_x) >= (GAME_MAX_RECT_X_LARGE)))
 
 
-static ToxWindow *game_new_window(Tox *tox, GameType type, uint32_t friendnumber);
+static ToxWindow *game_new_window(Tox *tox, GameType type, uint32_t friendnumber, bool is_multiplayer);
 
 struct GameList {
     const char *name;
@@ -127,18 +166,13 @@ bool game_type_has_multiplayer(GameType type)
     return type == GT_Chess || type == GT_Snake;
 }
 
-static bool game_type_is_multi_only(GameType type)
-{
-    return type == GT_Chess;
-}
-
 static bool game_type_is_multi_and_single(const ToxWindow *window, GameType type)
 {
     if (window->type != WINDOW_TYPE_CHAT) {
         return false;
     }
 
-    return type == GT_Snake;
+    return type == GT_Snake || type == GT_Chess;
 }
 
 /*
@@ -176,11 +210,280 @@ TIME_MS get_time_millis(void)
     return ((TIME_MS) t.tv_sec) * 1000 + ((TIME_MS) t.tv_nsec) / 1000000;
 }
 
+static int64_t game_time_usec(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((int64_t) t.tv_sec) * 1000000 + ((int64_t) t.tv_nsec) / 1000;
+}
+
+static GameSim *game_sim_new(void)
+{
+    GameSim *sim = calloc(1, sizeof(GameSim));
+
+    if (sim == NULL) {
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&sim->lock, NULL) != 0) {
+        free(sim);
+        return NULL;
+    }
+
+    pthread_condattr_t attr;
+
+    if (pthread_condattr_init(&attr) != 0) {
+        pthread_mutex_destroy(&sim->lock);
+        free(sim);
+        return NULL;
+    }
+
+#ifndef __APPLE__
+    /* Deadlines are on the same clock as get_time_millis(). macOS has no setclock, see game_sim_wait_until() */
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif /* __APPLE__ */
+
+    const int ret = pthread_cond_init(&sim->cond, &attr);
+
+    pthread_condattr_destroy(&attr);
+
+    if (ret != 0) {
+        pthread_mutex_destroy(&sim->lock);
+        free(sim);
+        return NULL;
+    }
+
+    atomic_init(&sim->running, false);
+
+    return sim;
+}
+
+/* Stops the simulation thread if it's running, and frees `sim`. */
+static void game_sim_free(GameSim *sim)
+{
+    if (sim == NULL) {
+        return;
+    }
+
+    if (sim->thread_started) {
+        pthread_mutex_lock(&sim->lock);
+        atomic_store(&sim->running, false);
+        pthread_cond_signal(&sim->cond);
+        pthread_mutex_unlock(&sim->lock);
+
+        pthread_join(sim->thread, NULL);
+    }
+
+    pthread_cond_destroy(&sim->cond);
+    pthread_mutex_destroy(&sim->lock);
+    free(sim);
+}
+
+/* Locks the game state against the simulation thread. */
+static void game_lock(GameData *game)
+{
+    if (game->sim != NULL) {
+        pthread_mutex_lock(&game->sim->lock);
+    }
+}
+
+static void game_unlock(GameData *game)
+{
+    if (game->sim != NULL) {
+        pthread_mutex_unlock(&game->sim->lock);
+    }
+}
+
+/* Publishes the timing stats once every GAME_STATS_INTERVAL milliseconds. */
+static void game_sim_update_stats(GameSim *sim, TIME_MS cur_time)
+{
+    const TIME_MS elapsed = cur_time - sim->interval_start;
+
+    if (elapsed < GAME_STATS_INTERVAL) {
+        return;
+    }
+
+    sim->ticks_per_second = (size_t)((TIME_MS) sim->ticks * 1000 / elapsed);
+    sim->frames_per_second = (size_t)((TIME_MS) sim->frames * 1000 / elapsed);
+    sim->tick_avg_usec = sim->ticks > 0 ? sim->tick_total_usec / (int64_t) sim->ticks : 0;
+    sim->tick_max_usec = sim->tick_peak_usec;
+
+    sim->interval_start = cur_time;
+    sim->ticks = 0;
+    sim->frames = 0;
+    sim->tick_total_usec = 0;
+    sim->tick_peak_usec = 0;
+}
+
+/*
+ * Returns true if the game state should advance at `cur_time`.
+ *
+ * A single player game is held while its window isn't being drawn, as nobody is watching it. Multiplayer
+ * games always run so that both sides stay in step.
+ */
+static bool game_sim_can_tick(const GameData *game, TIME_MS cur_time)
+{
+    if (game->status != GS_Running || game->cb_game_update_state == NULL) {
+        return false;
+    }
+
+    if (game->is_multiplayer) {
+        return true;
+    }
+
+    return cur_time - game->last_frame_time <= GAME_SIM_MAX_LAG;
+}
+
+/*
+ * Takes the tox lock. We poll for it rather than block because game_kill() stops the simulation thread
+ * while its caller may be holding the lock.
+ *
+ * Return false if the simulation was stopped while waiting.
+ */
+static bool game_sim_lock_tox(GameSim *sim)
+{
+    while (pthread_mutex_trylock(&Winthread.lock) != 0) {
+        if (!atomic_load(&sim->running)) {
+            return false;
+        }
+
+        sleep_thread(GAME_SIM_LOCK_POLL_USEC);
+    }
+
+    return true;
+}
+
+/*
+ * Runs the update callback for the tick scheduled at `tick_time`. Must be called with the game locked.
+ *
+ * Return false if the simulation has been stopped.
+ */
+static bool game_sim_tick(GameData *game, TIME_MS tick_time)
+{
+    GameSim *sim = game->sim;
+    const bool is_multiplayer = game->is_multiplayer;
+
+    // multiplayer games send packets from their update callback, and the tox lock must be taken first
+    if (is_multiplayer) {
+        pthread_mutex_unlock(&sim->lock);
+        const bool locked = game_sim_lock_tox(sim);
+        pthread_mutex_lock(&sim->lock);
+
+        if (!locked) {
+            return false;
+        }
+    }
+
+    if (atomic_load(&sim->running) && game->status == GS_Running && game->cb_game_update_state != NULL) {
+        const int64_t start = game_time_usec();
+
+        game->tick_time = tick_time;
+        game->cb_game_update_state(game, game->cb_game_update_state_data);
+
+        const int64_t duration = game_time_usec() - start;
+
+        ++sim->ticks;
+        sim->tick_total_usec += duration;
+        sim->tick_peak_usec = MAX(sim->tick_peak_usec, duration);
+    }
+
+    if (is_multiplayer) {
+        pthread_mutex_unlock(&Winthread.lock);
+    }
+
+    return atomic_load(&sim->running);
+}
+
+static void game_sim_wait_until(GameSim *sim, TIME_MS deadline)
+{
+#ifdef __APPLE__
+    const TIME_MS now = get_time_millis();
+    const TIME_MS wait = deadline > now ? deadline - now : 0;
+
+    const struct timespec t = {
+        .tv_sec = (time_t)(wait / 1000),
+        .tv_nsec = (long)(wait % 1000) * 1000000L,
+    };
+
+    pthread_cond_timedwait_relative_np(&sim->cond, &sim->lock, &t);
+#else
+    const struct timespec t = {
+        .tv_sec = (time_t)(deadline / 1000),
+        .tv_nsec = (long)(deadline % 1000) * 1000000L,
+    };
+
+    pthread_cond_timedwait(&sim->cond, &sim->lock, &t);
+#endif /* __APPLE__ */
+}
+
+static void *game_sim_thread(void *data)
+{
+    GameData *game = (GameData *)data;
+    GameSim *sim = game->sim;
+
+    pthread_mutex_lock(&sim->lock);
+
+    TIME_MS next_tick = get_time_millis();
+    sim->interval_start = next_tick;
+
+    while (atomic_load(&sim->running)) {
+        const TIME_MS cur_time = get_time_millis();
+
+        game_sim_update_stats(sim, cur_time);
+
+        if (cur_time < next_tick) {
+            game_sim_wait_until(sim, next_tick);
+            continue;
+        }
+
+        const TIME_MS interval = MAX(game->update_interval, 1);
+
+        if (!game_sim_can_tick(game, cur_time)) {
+            next_tick = cur_time + interval;
+            continue;
+        }
+
+        if (cur_time - next_tick > GAME_SIM_MAX_LAG) {
+            sim->ticks_dropped += (size_t)((cur_time - next_tick) / interval);
+            next_tick = cur_time;
+        }
+
+        if (!game_sim_tick(game, next_tick)) {
+            break;
+        }
+
+        next_tick += interval;
+    }
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return NULL;
+}
+
+static int game_sim_start(GameData *game)
+{
+    GameSim *sim = game->sim;
+
+    atomic_store(&sim->running, true);
+
+    if (pthread_create(&sim->thread, NULL, game_sim_thread, game) != 0) {
+        atomic_store(&sim->running, false);
+        return -1;
+    }
+
+    sim->thread_started = true;
+
+    return 0;
+}
+
 void game_kill(ToxWindow *self, Windows *windows, const Client_Config *c_config)
 {
     GameData *game = self->game;
 
     if (game != NULL) {
+        game_sim_free(game->sim);
+        game->sim = NULL;
+
         if (game->cb_game_kill) {
             game->cb_game_kill(game, game->cb_game_kill_data);
         }
@@ -243,7 +546,7 @@ static int game_initialize_type(GameData *game, const uint8_t *data, size_t leng
         }
 
         case GT_Life: {
-            ret = life_initialize(game);
+            ret = life_initialize(game, (const char *)data, length);
             break;
         }
 
@@ -266,7 +569,9 @@ int game_initialize(const ToxWindow *parent, Toxic *toxic, GameType type, uint32
 
     max_y -= (CHATBOX_HEIGHT + WINDOW_BAR_HEIGHT);
 
-    ToxWindow *self = game_new_window(toxic->tox, type, parent->num);
+    const bool is_multiplayer = game_type_is_multi_and_single(parent, type);
+
+    ToxWindow *self = game_new_window(toxic->tox, type, parent->num, is_multiplayer);
 
     if (self == NULL) {
         return -4;
@@ -282,20 +587,13 @@ int game_initialize(const ToxWindow *parent, Toxic *toxic, GameType type, uint32
         return -4;
     }
 
-    game->is_multiplayer = game_type_is_multi_only(type) || game_type_is_multi_and_single(parent, type);
+    game->is_multiplayer = is_multiplayer;
 
     if (game->is_multiplayer) {
-        if (parent->type != WINDOW_TYPE_CHAT) {
-            game_init_abort(parent, self, toxic->windows, c_config);
-            return -3;
-        }
-
         if (get_friend_connection_status(parent->num) == TOX_CONNECTION_NONE) {
             game_init_abort(parent, self, toxic->windows, c_config);
             return -2;
         }
-
-        game->is_multiplayer = true;
     }
 
     game->toxic = toxic;
@@ -308,8 +606,9 @@ int game_initialize(const ToxWindow *parent, Toxic *toxic, GameType type, uint32
     game->window = subwin(self->window, max_y, max_x, 0, 0);
     game->id = id;
     game->friend_number = parent->num;
+    game->sim = game_sim_new();
 
-    if (game->window == NULL) {
+    if (game->window == NULL || game->sim == NULL) {
         game_init_abort(parent, self, toxic->windows, c_config);
         return -4;
     }
@@ -323,6 +622,11 @@ int game_initialize(const ToxWindow *parent, Toxic *toxic, GameType type, uint32
 
     game->status = GS_Running;
 
+    if (game_sim_start(game) == -1) {
+        game_init_abort(parent, self, toxic->windows, c_config);
+        return -4;
+    }
+
     set_active_window_by_id(toxic->windows, game->window_id);
 
     set_window_refresh_rate(NCURSES_GAME_REFRESH_RATE);
@@ -561,8 +865,23 @@ static void game_draw_help_bar(const GameData *game, WINDOW *win)
 
     wprintw(win, "Quit: ");
     wattron(win, A_BOLD);
-    wprintw(win, "F9");
+    wprintw(win, "F9  ");
+    wattroff(win, A_BOLD);
+
+    wprintw(win, "Stats: ");
+    wattron(win, A_BOLD);
+    wprintw(win, "F3");
     wattroff(win, A_BOLD);
+
+    const GameSim *sim = game->sim;
+
+    if (sim == NULL || !sim->show_stats) {
+        return;
+    }
+
+    wprintw(win, "  | %zu ticks/s  %zu fps  tick %.2fms (max %.2fms)  dropped %zu",
+            sim->ticks_per_second, sim->frames_per_second, sim->tick_avg_usec / 1000.0,
+            sim->tick_max_usec / 1000.0, sim->ticks_dropped);
 }
 
 static void game_draw_border(const GameData *game, const int max_x, const int max_y)
@@ -713,26 +1032,6 @@ static void game_draw_messages(GameData *game, bool priority)
     }
 }
 
-static void game_update_state(GameData *game)
-{
-    if (game->cb_game_update_state == NULL) {
-        return;
-    }
-
-    TIME_MS cur_time = get_time_millis();
-
-    if (cur_time - game->last_frame_time > 500) {
-        game->last_frame_time = cur_time;
-    }
-
-    size_t iterations = (cur_time - game->last_frame_time) / game->update_interval;
-
-    for (size_t i = 0; i < iterations; ++i) {
-        game->cb_game_update_state(game, game->cb_game_update_state_data);
-        game->last_frame_time += game->update_interval;
-    }
-}
-
 static void game_onDraw(ToxWindow *self, Toxic *toxic)
 {
     UNUSED_VAR(toxic);   // Note: This function is not thread safe if we ever need to use `toxic`
@@ -744,6 +1043,14 @@ static void game_onDraw(ToxWindow *self, Toxic *toxic)
 
     GameData *game = self->game;
 
+    game_lock(game);
+
+    game->last_frame_time = get_time_millis();
+
+    if (game->sim != NULL) {
+        ++game->sim->frames;
+    }
+
     game_draw_help_bar(game, self->window);
     draw_window_bar(self, toxic->windows);
 
@@ -766,11 +1073,6 @@ static void game_onDraw(ToxWindow *self, Toxic *toxic)
     game_draw_status(game, max_x, max_y);
 
     switch (game->status) {
-        case GS_Running: {
-            game_update_state(game);
-            break;
-        }
-
         case GS_Paused: {
             game_draw_pause_screen(game);
             break;
@@ -787,6 +1089,8 @@ static void game_onDraw(ToxWindow *self, Toxic *toxic)
     }
 
     game_draw_messages(game, true);
+
+    game_unlock(game);
 }
 
 static bool game_onKey(ToxWindow *self, Toxic *toxic, wint_t key, bool is_printable)
@@ -802,17 +1106,38 @@ static bool game_onKey(ToxWindow *self, Toxic *toxic, wint_t key, bool is_printa
         return true;
     }
 
+    if (key == KEY_F(3)) {
+        game_lock(game);
+
+        if (game->sim != NULL) {
+            game->sim->show_stats = !game->sim->show_stats;
+        }
+
+        game_unlock(game);
+        return true;
+    }
+
     if (key == KEY_F(2) && !game->is_multiplayer) {
+        game_lock(game);
         game_toggle_pause(self->game);
+        game_unlock(game);
         return true;
     }
 
-    if (!game->is_multiplayer && game->status == GS_Finished && key == KEY_F(5)) {
-        if (game_restart(self->game) == -1) {
+    if (!game->is_multiplayer && key == KEY_F(5)) {
+        game_lock(game);
+
+        const bool is_finished = game->status == GS_Finished;
+
+        if (is_finished && game_restart(self->game) == -1) {
             fprintf(stderr, "Warning: game_restart() failed\n");
         }
 
-        return true;
+        game_unlock(game);
+
+        if (is_finished) {
+            return true;
+        }
     }
 
     if (game->cb_game_key_press) {
@@ -820,7 +1145,9 @@ static bool game_onKey(ToxWindow *self, Toxic *toxic, wint_t key, bool is_printa
             pthread_mutex_lock(&Winthread.lock);  // we use the tox instance when we send packets
         }
 
+        game_lock(game);
         game->cb_game_key_press(game, key, game->cb_game_key_press_data);
+        game_unlock(game);
 
         if (game->is_multiplayer) {
             pthread_mutex_unlock(&Winthread.lock);
@@ -896,11 +1223,13 @@ static void game_onPacket(ToxWindow *self, Toxic *toxic, uint32_t friendnumber,
     length -= GAME_PACKET_HEADER_SIZE;
 
     if (game->cb_game_on_packet) {
+        game_lock(game);
         game->cb_game_on_packet(game, data, length, game->cb_game_on_packet_data);
+        game_unlock(game);
     }
 }
 
-static ToxWindow *game_new_window(Tox *tox, GameType type, uint32_t friendnumber)
+static ToxWindow *game_new_window(Tox *tox, GameType type, uint32_t friendnumber, bool is_multiplayer)
 {
     const char *window_name = game_get_name_string(type);
 
@@ -931,7 +1260,7 @@ static ToxWindow *game_new_window(Tox *tox, GameType type, uint32_t friendnumber
 
     ret->active_box = -1;
 
-    if (game_type_is_multi_only(type)) {
+    if (is_multiplayer) {
         char name[TOXIC_MAX_NAME_LENGTH + 1];
         get_friend_name(name, sizeof(name), friendnumber);
 
@@ -1112,6 +1441,11 @@ void game_set_update_interval(GameData *game, TIME_MS update_interval)
     game->update_interval = MIN(update_interval, GAME_MAX_UPDATE_INTERVAL);
 }
 
+TIME_MS game_get_tick_time(const GameData *game)
+{
+    return game->tick_time;
+}
+
 bool game_do_object_state_update(const GameData *game, TIME_MS current_time, TIME_MS last_moved_time, TIME_MS speed)
 {
     TIME_MS delta = (current_time - last_moved_time) * speed;
@@ -1202,3 +1536,17 @@ int game_packet_send(const GameData *game, const uint8_t *data, size_t length, G
 
     return 0;
 }
+
+int game_packet_send_net(const GameData *game, const Game_Net *net, uint8_t data_type)
+{
+    uint8_t data[GAME_MAX_DATA_SIZE];
+    data[0] = data_type;
+
+    const size_t length = game_net_write_packet(net, data + 1, sizeof(data) - 1);
+
+    if (length == 0) {
+        return -1;
+    }
+
+    return game_packet_send(game, data, length + 1, GP_Data);
+}
@@ -28,6 +28,7 @@
 
 #include <tox/tox.h>
 
+#include "game_net.h"
 #include "game_util.h"
 #include "windows.h"
 
@@ -81,6 +82,9 @@ typedef void cb_game_pause(GameData *game, bool is_paused, void *cb_data);
 typedef void cb_game_key_press(GameData *game, int key, void *cb_data);
 typedef void cb_game_on_packet(GameData *game, const uint8_t *data, size_t length, void *cb_data);
 
+/* Runs a game's update callback on its own thread; private to game_base.c */
+typedef struct GameSim GameSim;
+
 typedef enum GamePacketType {
     GP_Invite = 0u,
     GP_Data,
@@ -125,8 +129,9 @@ typedef struct GameMessage {
 } GameMessage;
 
 struct GameData {
-    TIME_MS    last_frame_time;
+    TIME_MS    last_frame_time;  // when the game window was last drawn
     TIME_MS    update_interval;  // determines the refresh rate (lower means faster)
+    TIME_MS    tick_time;        // the scheduled time of the current simulation tick
     long int   score;
     size_t     high_score;
     int        lives;
@@ -178,6 +183,8 @@ struct GameData {
 
     cb_game_on_packet *cb_game_on_packet;
     void *cb_game_on_packet_data;
+
+    GameSim    *sim;
 };
 
 /*
@@ -227,7 +234,7 @@ void game_set_cb_on_packet(GameData *game, cb_game_on_packet *func, void *cb_dat
  * Return 0 on success.
  * Return -1 if screen is too small.
  * Return -2 on network related error.
- * Return -3 if multiplayer game is being initialized outside of a contact's window.
+ * Return -3 if the game failed to set up its state.
  * Return -4 on other failure.
  */
 int game_initialize(const ToxWindow *self, Toxic *toxic, GameType type, uint32_t id, const uint8_t *multiplayer_data,
@@ -359,6 +366,14 @@ void game_set_winner(GameData *game, bool winner);
  */
 void game_set_update_interval(GameData *game, TIME_MS update_interval);
 
+/*
+ * Returns the scheduled time of the simulation tick being run.
+ *
+ * Game state updates run on a fixed timestep, so update callbacks should use this in place of the wall
+ * clock: every tick is exactly one update interval after the last, however late it actually ran.
+ */
+TIME_MS game_get_tick_time(const GameData *game);
+
 /*
  * Creates a message `message` of size `length` to be displayed at `coords` for `timeout` seconds.
  *
@@ -406,5 +421,14 @@ void game_kill(ToxWindow *self, Windows *windows, const Client_Config *c_config)
  */
 int game_packet_send(const GameData *game, const uint8_t *data, size_t length, GamePacketType packet_type);
 
+/*
+ * Sends the local states in `net` that the other player hasn't acknowledged yet, batched into as
+ * few bytes as fit in one game packet. The payload is prefixed with the game's own `data_type` byte.
+ *
+ * Return 0 on success.
+ * Return -1 on failure.
+ */
+int game_packet_send_net(const GameData *game, const Game_Net *net, uint8_t data_type);
+
 #endif // GAME_BASE
 
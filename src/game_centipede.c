@@ -167,6 +167,7 @@ struct Segment {
     TIME_MS     last_time_moved;
     Segment     *prev;
     Segment     *next;
+    Segment     *grid_next;  // the next segment occupying the same grid cell
 };
 
 typedef struct Centipedes {
@@ -174,8 +175,24 @@ typedef struct Centipedes {
     size_t      heads_length;
 } Centipedes;
 
+/*
+ * An occupancy grid covering the game window, so that collision checks look up a single cell instead of
+ * scanning every mushroom and segment. Each cell holds the live mushroom at those coordinates, and a list of
+ * the centipede segments at those coordinates linked through their `grid_next` member.
+ *
+ * Objects are added when they appear and removed before their coordinates change or they're destroyed.
+ * Coordinates outside of the window are never tracked.
+ */
+typedef struct CentGrid {
+    int         width;
+    int         height;
+    Mushroom    **mushrooms;
+    Segment     **segments;
+} CentGrid;
+
 typedef struct CentState {
     Centipedes  centipedes;
+    CentGrid    grid;
     Mushroom    *mushrooms;
     size_t      mushrooms_length;
     EnemyAgent  spider;
@@ -352,6 +369,140 @@ static long int cent_spider_points(const Coords *spider_coords, const Coords *bl
     return 900;
 }
 
+static int cent_grid_init(const GameData *game, CentGrid *grid)
+{
+    int max_x;
+    int max_y;
+    game_max_x_y(game, &max_x, &max_y);
+
+    if (max_x <= 0 || max_y <= 0) {
+        return -1;
+    }
+
+    const size_t num_cells = (size_t)max_x * (size_t)max_y;
+
+    Mushroom **mushrooms = calloc(num_cells, sizeof(Mushroom *));
+
+    if (mushrooms == NULL) {
+        return -1;
+    }
+
+    Segment **segments = calloc(num_cells, sizeof(Segment *));
+
+    if (segments == NULL) {
+        free(mushrooms);
+        return -1;
+    }
+
+    grid->width = max_x;
+    grid->height = max_y;
+    grid->mushrooms = mushrooms;
+    grid->segments = segments;
+
+    return 0;
+}
+
+static void cent_grid_free(CentGrid *grid)
+{
+    free(grid->mushrooms);
+    free(grid->segments);
+
+    memset(grid, 0, sizeof(CentGrid));
+}
+
+/*
+ * Return the index of the grid cell at `coords`.
+ * Return -1 if `coords` lies outside of the grid.
+ */
+static int cent_grid_index(const CentGrid *grid, const Coords *coords)
+{
+    if (coords->x < 0 || coords->y < 0 || coords->x >= grid->width || coords->y >= grid->height) {
+        return -1;
+    }
+
+    return coords->y * grid->width + coords->x;
+}
+
+static void cent_grid_add_segment(CentGrid *grid, Segment *seg)
+{
+    const int idx = cent_grid_index(grid, &seg->coords);
+
+    if (idx == -1) {
+        return;
+    }
+
+    seg->grid_next = grid->segments[idx];
+    grid->segments[idx] = seg;
+}
+
+static void cent_grid_remove_segment(CentGrid *grid, Segment *seg)
+{
+    const int idx = cent_grid_index(grid, &seg->coords);
+
+    if (idx == -1) {
+        return;
+    }
+
+    for (Segment **cur = &grid->segments[idx]; *cur != NULL; cur = &(*cur)->grid_next) {
+        if (*cur == seg) {
+            *cur = seg->grid_next;
+            break;
+        }
+    }
+
+    seg->grid_next = NULL;
+}
+
+/* Adds `head` and all of the segments that follow it to the grid. */
+static void cent_grid_add_centipede(CentGrid *grid, Segment *head)
+{
+    for (Segment *seg = head; seg != NULL; seg = seg->next) {
+        cent_grid_add_segment(grid, seg);
+    }
+}
+
+/* Removes `head` and all of the segments that follow it from the grid. */
+static void cent_grid_remove_centipede(CentGrid *grid, Segment *head)
+{
+    for (Segment *seg = head; seg != NULL; seg = seg->next) {
+        cent_grid_remove_segment(grid, seg);
+    }
+}
+
+/*
+ * Return the first centipede segment at `coords`.
+ * Return NULL if there are no segments at `coords`.
+ */
+static Segment *cent_get_segment_at_coords(const CentState *state, const Coords *coords)
+{
+    const int idx = cent_grid_index(&state->grid, coords);
+
+    if (idx == -1) {
+        return NULL;
+    }
+
+    return state->grid.segments[idx];
+}
+
+/*
+ * Return the index of the centipede that `seg` belongs to.
+ * Return -1 if `seg` doesn't belong to a living centipede.
+ */
+static int cent_centipede_index(const Centipedes *centipedes, const Segment *seg)
+{
+    while (seg->prev != NULL) {
+        seg = seg->prev;
+    }
+
+    for (size_t i = 0; i < centipedes->heads_length; ++i) {
+        if (centipedes->heads[i] == seg) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
 static bool cent_centipedes_are_dead(Centipedes *centipedes)
 {
     for (size_t i = 0; i < centipedes->heads_length; ++i) {
@@ -363,12 +514,14 @@ static bool cent_centipedes_are_dead(Centipedes *centipedes)
     return true;
 }
 
-static void cent_kill_centipede(Centipedes *centipedes, size_t index)
+static void cent_kill_centipede(CentState *state, size_t index)
 {
+    Centipedes *centipedes = &state->centipedes;
     Segment *head = centipedes->heads[index];
 
     while (head) {
         Segment *tmp1 = head->next;
+        cent_grid_remove_segment(&state->grid, head);
         free(head);
         head = tmp1;
     }
@@ -396,11 +549,13 @@ static void cent_cure_centipede(Segment *segment)
     }
 }
 
-static void cent_exterminate_centipedes(Centipedes *centipedes)
+static void cent_exterminate_centipedes(CentState *state)
 {
+    Centipedes *centipedes = &state->centipedes;
+
     for (size_t i = 0; i < centipedes->heads_length; ++i) {
         if (centipedes->heads[i] != NULL) {
-            cent_kill_centipede(centipedes, i);
+            cent_kill_centipede(state, i);
         }
     }
 
@@ -491,6 +646,7 @@ static int cent_birth_centipede(const GameData *game, CentState *state, size_t l
     new_head->prev = NULL;
 
     centipedes->heads[head_idx] = new_head;
+    cent_grid_add_segment(&state->grid, new_head);
 
     Segment *prev = new_head;
 
@@ -498,7 +654,7 @@ static int cent_birth_centipede(const GameData *game, CentState *state, size_t l
         Segment *new_seg = calloc(1, sizeof(Segment));
 
         if (new_seg == NULL) {
-            cent_kill_centipede(centipedes, head_idx);
+            cent_kill_centipede(state, head_idx);
             return -1;
         }
 
@@ -585,7 +741,7 @@ static int cent_restart_level(GameData *game, CentState *state)
     cent_enemy_despawn(&state->spider, false);
     cent_enemy_despawn(&state->flea, false);
     cent_enemy_despawn(&state->scorpion, false);
-    cent_exterminate_centipedes(&state->centipedes);
+    cent_exterminate_centipedes(state);
 
     size_t level = game_get_current_level(game);
 
@@ -618,7 +774,7 @@ static int cent_next_level(GameData *game, CentState *state)
         }
     }
 
-    cent_exterminate_centipedes(&state->centipedes);
+    cent_exterminate_centipedes(state);
 
     if (cent_init_level_centipedes(game, state, level) == -1) {
         return -1;
@@ -688,19 +844,34 @@ static void cent_update_mush_appearance(const GameData *game, const CentState *s
 
 static Mushroom *cent_get_mushroom_at_coords(CentState *state, const Coords *coords)
 {
-    for (size_t i = 0; i < state->mushrooms_length; ++i) {
-        Mushroom *mush = &state->mushrooms[i];
+    const int idx = cent_grid_index(&state->grid, coords);
 
-        if (mush->health == 0) {
-            continue;
-        }
+    if (idx == -1) {
+        return NULL;
+    }
 
-        if (COORDINATES_OVERLAP(coords->x, coords->y, mush->coords.x, mush->coords.y)) {
-            return mush;
-        }
+    return state->grid.mushrooms[idx];
+}
+
+/* Places live mushroom `mush` on the grid at its coordinates. */
+static void cent_mushroom_place(CentState *state, Mushroom *mush)
+{
+    const int idx = cent_grid_index(&state->grid, &mush->coords);
+
+    if (idx != -1) {
+        state->grid.mushrooms[idx] = mush;
     }
+}
 
-    return NULL;
+static void cent_mushroom_destroy(CentState *state, Mushroom *mush)
+{
+    const int idx = cent_grid_index(&state->grid, &mush->coords);
+
+    if (idx != -1 && state->grid.mushrooms[idx] == mush) {
+        state->grid.mushrooms[idx] = NULL;
+    }
+
+    memset(mush, 0, sizeof(Mushroom));
 }
 
 static Mushroom *cent_mushroom_new(CentState *state)
@@ -749,6 +920,7 @@ static void cent_mushroom_grow(const GameData *game, CentState *state, const Coo
     mush->coords.x = coords->x;
     mush->coords.y = coords->y;
 
+    cent_mushroom_place(state, mush);
     cent_update_mush_appearance(game, state, mush);
 }
 
@@ -822,7 +994,7 @@ static bool cent_bullet_mushroom_collision(GameData *game, CentState *state, con
     cent_update_mush_appearance(game, state, mush);
 
     if (mush->health == 0) {
-        memset(mush, 0, sizeof(Mushroom));
+        cent_mushroom_destroy(state, mush);
         cent_update_score(game, state, 1, NULL);
     }
 
@@ -872,10 +1044,13 @@ static void cent_bullet_spawn(CentState *state)
  * Returns points value for the segment (100 for head, 10 for non-head).
  * Returns 0 if head limit has been reached.
  */
-static long int cent_kill_centipede_segment(const GameData *game, Centipedes *centipedes, Segment *seg, size_t index)
+static long int cent_kill_centipede_segment(const GameData *game, CentState *state, Segment *seg, size_t index)
 {
+    Centipedes *centipedes = &state->centipedes;
+
     if (seg->prev == NULL) {  // head
         if (seg->next == NULL) {  // lone head
+            cent_grid_remove_segment(&state->grid, seg);
             free(seg);
             centipedes->heads[index] = NULL;
             return 100;
@@ -888,6 +1063,7 @@ static long int cent_kill_centipede_segment(const GameData *game, Centipedes *ce
         seg->next->prev = NULL;
 
         centipedes->heads[index] = seg->next;
+        cent_grid_remove_segment(&state->grid, seg);
         free(seg);
 
         return 100;
@@ -895,6 +1071,7 @@ static long int cent_kill_centipede_segment(const GameData *game, Centipedes *ce
 
     if (seg->next == NULL) {  // tail
         seg->prev->next = NULL;
+        cent_grid_remove_segment(&state->grid, seg);
         free(seg);
         return 10;
     }
@@ -919,6 +1096,7 @@ static long int cent_kill_centipede_segment(const GameData *game, Centipedes *ce
 
     centipedes->heads[idx] = seg->next;
 
+    cent_grid_remove_segment(&state->grid, seg);
     free(seg);
 
     return 10;
@@ -926,34 +1104,27 @@ static long int cent_kill_centipede_segment(const GameData *game, Centipedes *ce
 
 static bool cent_bullet_centipede_collision(GameData *game, CentState *state)
 {
-    Centipedes *centipedes = &state->centipedes;
-    Projectile *bullet = &state->bullet;
-
-    for (size_t i = 0; i < centipedes->heads_length; ++i) {
-        Segment *seg = centipedes->heads[i];
+    Segment *seg = cent_get_segment_at_coords(state, &state->bullet.coords);
 
-        if (seg == NULL) {
-            continue;
-        }
+    if (seg == NULL) {
+        return false;
+    }
 
-        while (seg) {
-            if (COORDINATES_OVERLAP(seg->coords.x, seg->coords.y, bullet->coords.x, bullet->coords.y)) {
-                Coords mush_coords;
-                mush_coords.x = seg->h_direction == WEST ? seg->coords.x - 1 : seg->coords.x + 1;
-                mush_coords.y = seg->coords.y;
-                cent_mushroom_grow(game, state, &mush_coords, false);
+    const int index = cent_centipede_index(&state->centipedes, seg);
 
-                long int points = cent_kill_centipede_segment(game, centipedes, seg, i);
-                cent_update_score(game, state, points, NULL);
+    if (index == -1) {
+        return false;
+    }
 
-                return true;
-            }
+    Coords mush_coords;
+    mush_coords.x = seg->h_direction == WEST ? seg->coords.x - 1 : seg->coords.x + 1;
+    mush_coords.y = seg->coords.y;
+    cent_mushroom_grow(game, state, &mush_coords, false);
 
-            seg = seg->next;
-        }
-    }
+    long int points = cent_kill_centipede_segment(game, state, seg, index);
+    cent_update_score(game, state, points, NULL);
 
-    return false;
+    return true;
 }
 
 /*
@@ -1132,8 +1303,10 @@ static void cent_do_centipede(const GameData *game, CentState *state, TIME_MS cu
 
         head->last_time_moved = cur_time;
 
+        cent_grid_remove_centipede(&state->grid, head);
         cent_move_segments(head);
         cent_set_head_direction(state, head, y_bottom, x_left, x_right);
+        cent_grid_add_centipede(&state->grid, head);
 
         if (head->coords.x == x_left || head->coords.x == x_right) {
             cent_do_reproduce(game, state, head, x_right, x_left, y_bottom);
@@ -1370,32 +1543,13 @@ static void cent_do_spider(GameData *game, CentState *state, TIME_MS cur_time)
     Mushroom *mush = cent_get_mushroom_at_coords(state, &new_coords);
 
     if (mush != NULL) {
-        memset(mush, 0, sizeof(Mushroom));
+        cent_mushroom_destroy(state, mush);
     }
 }
 
-static bool cent_blaster_centipede_collision(CentState *state)
+static bool cent_blaster_centipede_collision(const CentState *state)
 {
-    Centipedes *centipedes = &state->centipedes;
-    Blaster blaster = state->blaster;
-
-    for (size_t i = 0; i < centipedes->heads_length; ++i) {
-        Segment *seg = centipedes->heads[i];
-
-        if (seg == NULL) {
-            continue;
-        }
-
-        while (seg) {
-            if (COORDINATES_OVERLAP(seg->coords.x, seg->coords.y, blaster.coords.x, blaster.coords.y)) {
-                return true;
-            }
-
-            seg = seg->next;
-        }
-    }
-
-    return false;
+    return cent_get_segment_at_coords(state, &state->blaster.coords) != NULL;
 }
 
 static void cent_blaster_collision_check(GameData *game, CentState *state)
@@ -1505,10 +1659,8 @@ static void cent_mushrooms_draw(WINDOW *win, const CentState *state)
     }
 }
 
-static void cent_cb_update_game_state(GameData *game, void *cb_data)
+static void cent_update_game_state(GameData *game, CentState *state, TIME_MS cur_time)
 {
-    CentState *state = (CentState *)cb_data;
-
     if (state == NULL) {
         return;
     }
@@ -1517,8 +1669,6 @@ static void cent_cb_update_game_state(GameData *game, void *cb_data)
         return;
     }
 
-    TIME_MS cur_time = get_time_millis();
-
     cent_blaster_collision_check(game, state);
     cent_bullet_collision_check(game, state);
     cent_blaster_move(game, state, cur_time);
@@ -1529,6 +1679,16 @@ static void cent_cb_update_game_state(GameData *game, void *cb_data)
     cent_do_scorpion(game, state, cur_time);
 }
 
+static void cent_cb_update_game_state(GameData *game, void *cb_data)
+{
+    cent_update_game_state(game, (CentState *)cb_data, game_get_tick_time(game));
+}
+
+void centipede_tick(GameData *game, TIME_MS cur_time)
+{
+    cent_update_game_state(game, (CentState *)game->cb_game_update_state_data, cur_time);
+}
+
 static void cent_cb_render_window(GameData *game, WINDOW *win, void *cb_data)
 {
     CentState *state = (CentState *)cb_data;
@@ -1589,7 +1749,8 @@ static void cent_cb_kill(GameData *game, void *cb_data)
         return;
     }
 
-    cent_exterminate_centipedes(&state->centipedes);
+    cent_exterminate_centipedes(state);
+    cent_grid_free(&state->grid);
 
     free(state->mushrooms);
     free(state);
@@ -1649,6 +1810,7 @@ static void cent_populate_mushrooms(const GameData *game, CentState *state, int
         mush->is_poisonous = false;
         mush->health = CENT_MUSH_DEFAULT_HEALTH;
 
+        cent_mushroom_place(state, mush);
         cent_update_mush_appearance(game, state, mush);
 
         ++state->mushrooms_length;
@@ -1664,9 +1826,14 @@ static int cent_init_state(GameData *game, CentState *state)
     const int x_right = game_x_right_bound(game);
     const int y_top = game_y_top_bound(game);
 
+    if (cent_grid_init(game, &state->grid) == -1) {
+        return -1;
+    }
+
     Mushroom *mushrooms = calloc(1, sizeof(Mushroom) * CENT_MUSHROOMS_LENGTH);
 
     if (mushrooms == NULL) {
+        cent_grid_free(&state->grid);
         return -1;
     }
 
@@ -1675,6 +1842,7 @@ static int cent_init_state(GameData *game, CentState *state)
     Direction dir = rand_range_not_secure(2) == 0 ? WEST : EAST;
 
     if (cent_birth_centipede(game, state, CENT_MAX_NUM_SEGMENTS, dir, NULL) == -1) {
+        cent_grid_free(&state->grid);
         free(mushrooms);
         return -1;
     }
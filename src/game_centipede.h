@@ -25,6 +25,20 @@
 
 #include "game_base.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
 int centipede_initialize(GameData *game);
 
+/*
+ * Advances the centipede game in `game` to `cur_time`. This is run by the game's update callback with
+ * the current time, and may be called directly to drive the game without a UI.
+ */
+void centipede_tick(GameData *game, TIME_MS cur_time);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
 #endif  // GAME_CENTIPEDE
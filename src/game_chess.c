@@ -20,10 +20,12 @@
  *
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "chess_engine.h"
 #include "game_base.h"
 #include "game_util.h"
 #include "game_chess.h"
@@ -39,6 +41,12 @@
 #define CHESS_SQUARES (CHESS_BOARD_ROWS * CHESS_BOARD_COLUMNS)
 #define CHESS_MAX_MESSAGE_SIZE 64
 
+/* How long the computer opponent thinks about each move */
+#define CHESS_AI_TIME_BUDGET_MS 1000
+
+/* The computer opponent's transposition table holds 2^this many entries */
+#define CHESS_AI_TT_SIZE_LOG2 18
+
 /* Packet sizes */
 #define CHESS_PACKET_SEND_MOVE_LENGTH 5
 #define CHESS_PACKET_RESIGN_LENGTH 1
@@ -95,6 +103,7 @@ typedef struct Tile {
 
 typedef struct Board {
     Tile        tiles[CHESS_SQUARES];
+    Tile        *squares[CHESS_SQUARES];  // tiles indexed by engine square (a1 = 0, h8 = 63)
     int         x_right_bound;
     int         x_left_bound;
     int         y_top_bound;
@@ -106,23 +115,38 @@ typedef struct Player {
 
     ChessColour colour;
 
-    bool        can_castle_qs;
-    bool        can_castle_ks;
     bool        in_check;
 
-    Tile        *en_passant;              // the tile holding the pawn that passed us
-    int          en_passant_move_number;  // the move number the last en passant was on
-
     Piece       captured[CHESS_SQUARES];
     size_t      number_captured;
     int         score;  // total points of pieces captured
 } Player;
 
+/*
+ * The computer opponent for single player games. The search runs on its own thread so
+ * the UI stays responsive while it thinks.
+ */
+typedef struct ChessAI {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+
+    Chess_Search    *search;
+
+    Chess_Position  position;         // the position to search; guarded by `lock`
+    bool            request_pending;
+    bool            result_ready;
+    Chess_Move      result;
+    bool            quit;
+} ChessAI;
+
 typedef struct ChessState {
     Player      self;
     Player      other;
 
     Board       board;
+    Chess_Position position;
+    ChessAI     *ai;  // NULL for multiplayer games
     int         curs_x;
     int         curs_y;
 
@@ -138,6 +162,138 @@ typedef struct ChessState {
 static int chess_packet_send_move(const GameData *game, const Tile *from, const Tile *to);
 static int chess_packet_send_resign(const GameData *game);
 
+static void *chess_ai_thread(void *data)
+{
+    ChessAI *ai = (ChessAI *)data;
+
+    pthread_mutex_lock(&ai->lock);
+
+    while (true) {
+        while (!ai->quit && !ai->request_pending) {
+            pthread_cond_wait(&ai->cond, &ai->lock);
+        }
+
+        if (ai->quit) {
+            break;
+        }
+
+        Chess_Position position = ai->position;
+        ai->request_pending = false;
+
+        pthread_mutex_unlock(&ai->lock);
+
+        const Chess_Search_Limits limits = {0, CHESS_AI_TIME_BUDGET_MS};
+        Chess_Search_Result result;
+        const int ret = chess_search_run(ai->search, &position, &limits, &result);
+
+        pthread_mutex_lock(&ai->lock);
+
+        if (ret == 0 && !ai->request_pending) {
+            ai->result = result.best_move;
+            ai->result_ready = true;
+        }
+    }
+
+    pthread_mutex_unlock(&ai->lock);
+
+    return NULL;
+}
+
+static void chess_ai_free(ChessAI *ai)
+{
+    if (ai == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&ai->lock);
+    ai->quit = true;
+    pthread_cond_signal(&ai->cond);
+    pthread_mutex_unlock(&ai->lock);
+
+    chess_search_quit(ai->search);
+    pthread_join(ai->thread, NULL);
+
+    pthread_cond_destroy(&ai->cond);
+    pthread_mutex_destroy(&ai->lock);
+    chess_search_free(ai->search);
+    free(ai);
+}
+
+/*
+ * Return a new computer opponent with its search thread running.
+ * Return NULL on failure.
+ */
+static ChessAI *chess_ai_new(void)
+{
+    ChessAI *ai = calloc(1, sizeof(ChessAI));
+
+    if (ai == NULL) {
+        return NULL;
+    }
+
+    ai->search = chess_search_new(CHESS_AI_TT_SIZE_LOG2);
+
+    if (ai->search == NULL) {
+        free(ai);
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&ai->lock, NULL) != 0) {
+        chess_search_free(ai->search);
+        free(ai);
+        return NULL;
+    }
+
+    if (pthread_cond_init(&ai->cond, NULL) != 0) {
+        pthread_mutex_destroy(&ai->lock);
+        chess_search_free(ai->search);
+        free(ai);
+        return NULL;
+    }
+
+    if (pthread_create(&ai->thread, NULL, chess_ai_thread, ai) != 0) {
+        pthread_cond_destroy(&ai->cond);
+        pthread_mutex_destroy(&ai->lock);
+        chess_search_free(ai->search);
+        free(ai);
+        return NULL;
+    }
+
+    return ai;
+}
+
+/*
+ * Asks the computer opponent to start thinking about a move in `position`.
+ */
+static void chess_ai_request_move(ChessAI *ai, const Chess_Position *position)
+{
+    pthread_mutex_lock(&ai->lock);
+    ai->position = *position;
+    ai->request_pending = true;
+    ai->result_ready = false;
+    pthread_cond_signal(&ai->cond);
+    pthread_mutex_unlock(&ai->lock);
+}
+
+/*
+ * Return true and put the computer opponent's move in `move` if it has finished thinking.
+ */
+static bool chess_ai_poll_move(ChessAI *ai, Chess_Move *move)
+{
+    pthread_mutex_lock(&ai->lock);
+
+    const bool ready = ai->result_ready;
+
+    if (ready) {
+        *move = ai->result;
+        ai->result_ready = false;
+    }
+
+    pthread_mutex_unlock(&ai->lock);
+
+    return ready;
+}
+
 
 static const char Board_Letters[] = {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h'};
 
@@ -331,774 +487,194 @@ static Player *chess_get_player_to_move(ChessState *state)
  */
 static bool chess_player_to_move(const ChessState *state, const Player *player)
 {
-    return (player->colour == White && !state->black_to_move) || (player->colour == Black && state->black_to_move);
-}
-
-/*
- * Removes `piece` from the board and puts it in `player`'s captured list. Also updates their score.
- */
-static void chess_capture_piece(Player *player, Piece *piece)
-{
-    size_t idx = player->number_captured;
-
-    if (idx < CHESS_SQUARES) {
-        chess_copy_piece(&player->captured[idx], piece);
-        ++player->number_captured;
-    }
-
-    player->score += chess_get_piece_value(piece->type);
-
-    piece->type = NoPiece;
-}
-
-/*
- * Puts coordinates associated with tile at x y coordinates in `chess_coords`.
- *
- * Return 0 on success.
- * Return -1 if coordinates are out of bounds.
- */
-static int chess_get_chess_coords(const Board *board, int x, int y, ChessCoords *chess_coords, bool self_is_white)
-{
-    if (x < board->x_left_bound || x > board->x_right_bound || y < board->y_top_bound || y > board->y_bottom_bound) {
-        return -1;
-    }
-
-    size_t idx = (x - board->x_left_bound) / CHESS_TILE_SIZE_X;
-
-    if (idx >= CHESS_NUM_BOARD_LETTERS) {
-        return -1;
-    }
-
-    if (self_is_white) {
-        chess_coords->L = Board_Letters[idx];
-        chess_coords->N = ((board->y_bottom_bound + 1) - y) / CHESS_TILE_SIZE_Y;
-    } else {
-        chess_coords->L = Board_Letters[7 - idx];
-        chess_coords->N = 8 - (((board->y_bottom_bound + 1) - y) / CHESS_TILE_SIZE_Y) + 1;
-    }
-
-    return 0;
-}
-
-/*
- * Returns the tile located at given coordinates.
- */
-static Tile *chess_get_tile(ChessState *state, int x, int y)
-{
-    Board *board = &state->board;
-
-    ChessCoords pair;
-
-    if (chess_get_chess_coords(board, x, y, &pair, state->self.colour == White) == -1) {
-        return NULL;
-    }
-
-    for (size_t i = 0; i < CHESS_SQUARES; ++i) {
-        Tile *tile = &board->tiles[i];
-
-        if (tile->chess_coords.N == pair.N && tile->chess_coords.L == pair.L) {
-            return tile;
-        }
-    }
-
-    return NULL;
-}
-
-/*
- * Returns tile associated with `chess_coords`.
- */
-static Tile *chess_get_tile_at_chess_coords(Board *board, const ChessCoords *chess_coords)
-{
-    for (size_t i = 0; i < CHESS_SQUARES; ++i) {
-        Tile *tile = &board->tiles[i];
-
-        if (tile->chess_coords.N == chess_coords->N && tile->chess_coords.L == chess_coords->L) {
-            return tile;
-        }
-    }
-
-    return NULL;
-}
-
-/*
- * Return true if `piece` can occupy `tile`.
- */
-static bool chess_piece_can_occupy_tile(const Piece *piece, const Tile *tile)
-{
-    return tile->piece.colour != piece->colour || tile->piece.type == NoPiece;
-}
-
-/*
- * Return true if all squares in a horizontal or vertical line between `from` and `to`
- * are vacant, excluding each square respectively.
- */
-static bool chess_path_line_clear(Board *board, const Tile *from, const Tile *to, int l_diff, int n_diff)
-{
-    if (l_diff < 0 || n_diff < 0) {
-        return false;
-    }
-
-    if (l_diff != 0 && n_diff != 0) {
-        return false;
-    }
-
-    ChessCoords chess_coords = (ChessCoords) {
-        0,
-        0
-    };
-
-    size_t start;
-    size_t end;
-
-    if (l_diff == 0) {
-        start = 1 + MIN(from->chess_coords.N, to->chess_coords.N);
-        end = start + n_diff - 1;
-        chess_coords.L = from->chess_coords.L;
-    } else {
-        int from_idx = chess_get_letter_index(from->chess_coords.L);
-        int to_idx = chess_get_letter_index(to->chess_coords.L);
-
-        if (to_idx == -1 || from_idx == -1) {
-            return false;
-        }
-
-        start = 1 + MIN(from_idx, to_idx);
-        end = start + l_diff - 1;
-        chess_coords.N = from->chess_coords.N;
-    }
-
-    for (size_t i = start; i < end; ++i) {
-        if (l_diff == 0) {
-            chess_coords.N = i;
-        } else {
-            if (i >= CHESS_NUM_BOARD_LETTERS) {
-                return false;
-            }
-
-            chess_coords.L = Board_Letters[i];
-        }
-
-        Tile *tile = chess_get_tile_at_chess_coords(board, &chess_coords);
-
-        if (tile == NULL) {
-            return false;
-        }
-
-        if (tile->piece.type != NoPiece) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-/*
- * Return true if all tiles in a diagonal line between `from` and `to` are
- * unoccupied, excluding each respective tile.
- */
-static bool chess_path_diagonal_clear(Board *board, const Tile *from, const Tile *to, int l_diff, int n_diff)
-{
-    if (l_diff < 0 || n_diff < 0) {
-        return false;
-    }
-
-    if (l_diff != n_diff || l_diff == 0) {
-        return false;
-    }
-
-    size_t start = 1 + MIN(from->chess_coords.N, to->chess_coords.N);
-    size_t end = start + n_diff - 1;
-
-
-    // we're caluclating from south-east to north-west, or from south-west to north-east
-    bool left_diag = (from->chess_coords.N > to->chess_coords.N && from->chess_coords.L < to->chess_coords.L)
-                     || (from->chess_coords.N < to->chess_coords.N && from->chess_coords.L > to->chess_coords.L);
-
-    size_t from_l_idx = chess_get_letter_index(from->chess_coords.L);
-    size_t to_l_idx = chess_get_letter_index(to->chess_coords.L);
-    size_t start_l_idx = left_diag ? MAX(from_l_idx, to_l_idx) - 1 : MIN(from_l_idx, to_l_idx) + 1;
-
-    if (start_l_idx == -1) {
-        return -1;
-    }
-
-    ChessCoords chess_coords;
-
-    for (size_t i = start; i < end; ++i) {
-        chess_coords.N = i;
-
-        if (start_l_idx >= CHESS_NUM_BOARD_LETTERS) {
-            return false;
-        }
-
-        chess_coords.L = Board_Letters[start_l_idx];
-
-        Tile *tile = chess_get_tile_at_chess_coords(board, &chess_coords);
-
-        if (tile == NULL) {
-            return false;
-        }
-
-        if (tile->piece.type != NoPiece) {
-            return false;
-        }
-
-        start_l_idx = left_diag ? start_l_idx - 1 : start_l_idx + 1;
-    }
-
-    return true;
-}
-
-/*
- * Removes en passant'd pawn and resets player's en passant flag.
- *
- * Should be called after every successful move.
- */
-static void chess_player_check_en_passant(Player *player)
-{
-    if (player->en_passant_move_number == -1) {
-        chess_capture_piece(player, &player->en_passant->piece);
-        player->en_passant = NULL;
-    }
-
-    player->en_passant_move_number = 0;
-}
-
-/*
- * Flags a pawn at `to` for a possible en passant take for other player.
- */
-static void chess_pawn_en_passant_flag(ChessState *state, Tile *to)
-{
-    Player *other = chess_get_other_player(state);
-    other->en_passant = to;
-    other->en_passant_move_number = state->move_number;
-}
-
-/*
- * Return true and flag opposing pawn to be removed if `to` is a valid en passant move.
- */
-static bool chess_pawn_en_passant_move(ChessState *state, Player *player, const Tile *to)
-{
-    if (player->en_passant == NULL || player->en_passant_move_number <= 0) {
-        return false;
-    }
-
-    int delta = 0;
-
-    if (player->colour == White) {
-        if (player->en_passant_move_number != state->move_number) {
-            return false;
-        }
-
-        delta = 1;
-    } else {
-        if (player->en_passant_move_number != state->move_number - 1) {
-            return false;
-        }
-
-        delta = -1;
-    }
-
-    if (player->en_passant->piece.type == Pawn && to->chess_coords.N == player->en_passant->chess_coords.N + delta
-            && to->chess_coords.L == player->en_passant->chess_coords.L) {
-        player->en_passant_move_number = -1;  // flag opponent's pawn to be removed after move is validated
-        return true;
-    }
-
-    return false;
-}
-
-static bool chess_valid_pawn_move(ChessState *state, Tile *from,  Tile *to)
-{
-    Board *board = &state->board;
-
-    Piece from_piece = from->piece;
-    Piece to_piece = to->piece;
-
-    // Can't go backwards
-    if (from_piece.colour == Black && from->chess_coords.N <= to->chess_coords.N) {
-        return false;
-    }
-
-    if (from_piece.colour == White && from->chess_coords.N >= to->chess_coords.N) {
-        return false;
-    }
-
-    int l_diff;
-    int n_diff;
-
-    if (chess_get_chess_coords_diff(from, to, &l_diff, &n_diff) == -1) {
-        return false;
-    }
-
-    // can't move more than two spaces forward or one space diagonally
-    if (n_diff < 1 || n_diff > 2 || l_diff > 1) {
-        return false;
-    }
-
-    // If moving two spaces vertically it must be from starting position
-    if (n_diff == 2) {
-        if (l_diff != 0) {
-            return false;
-        }
-
-        if (from_piece.colour == Black && from->chess_coords.N != 7) {
-            return false;
-        }
-
-        if (from_piece.colour == White && from->chess_coords.N != 2) {
-            return false;
-        }
-
-        if (to_piece.type != NoPiece) {
-            return false;
-        }
-    }
-
-    // if moving diagonally, to square must contain an enemy piece or have a valid en passant
-    if (l_diff == 1) {
-        Player *self = chess_get_player_to_move(state);
-
-        if (chess_pawn_en_passant_move(state, self, to)) {
-            return true;
-        }
-
-        return to_piece.type != NoPiece && to_piece.colour != from->piece.colour;
-    }
-
-    if (to_piece.type != NoPiece) {
-        return false;
-    }
-
-    bool ret = chess_path_line_clear(board, from, to, l_diff, n_diff);
-
-    if (ret && n_diff == 2) {
-        chess_pawn_en_passant_flag(state, to);
-    }
-
-    return ret;
-}
-
-static bool chess_valid_rook_move(Board *board, const Tile *from, const Tile *to)
-{
-    int l_diff;
-    int n_diff;
-
-    if (chess_get_chess_coords_diff(from, to, &l_diff, &n_diff) == -1) {
-        return false;
-    }
-
-    if (!chess_path_line_clear(board, from, to, l_diff, n_diff)) {
-        return false;
-    }
-
-    if (!chess_piece_can_occupy_tile(&from->piece, to)) {
-        return false;
-    }
-
-    if (from->chess_coords.N != to->chess_coords.N && from->chess_coords.L != to->chess_coords.L) {
-        return false;
-    }
-
-    return true;
-}
-
-static bool chess_valid_knight_move(const Tile *from, const Tile *to)
-{
-    if (!chess_piece_can_occupy_tile(&from->piece, to)) {
-        return false;
-    }
-
-    int l_diff;
-    int n_diff;
-
-    if (chess_get_chess_coords_diff(from, to, &l_diff, &n_diff) == -1) {
-        return false;
-    }
-
-    if (!((l_diff == 2 && n_diff == 1) || (l_diff == 1 && n_diff == 2))) {
-        return false;
-    }
-
-    return true;
-}
-
-static bool chess_valid_bishop_move(Board *board, const Tile *from, const Tile *to)
-{
-    if (!chess_piece_can_occupy_tile(&from->piece, to)) {
-        return false;
-    }
-
-    int l_diff;
-    int n_diff;
-
-    if (chess_get_chess_coords_diff(from, to, &l_diff, &n_diff) == -1) {
-        return false;
-    }
-
-    return chess_path_diagonal_clear(board, from, to, l_diff, n_diff);
-}
-
-static bool chess_valid_queen_move(Board *board, const Tile *from, const Tile *to)
-{
-    if (!chess_piece_can_occupy_tile(&from->piece, to)) {
-        return false;
-    }
-
-    int l_diff;
-    int n_diff;
-
-    if (chess_get_chess_coords_diff(from, to, &l_diff, &n_diff) == -1) {
-        return false;
-    }
-
-    if (l_diff != 0 && n_diff != 0) {
-        return chess_path_diagonal_clear(board, from, to, l_diff, n_diff);
-    }
-
-    return chess_path_line_clear(board, from, to, l_diff, n_diff);
-}
-
-static bool chess_valid_king_move(const Tile *from, const Tile *to)
-{
-    if (!chess_piece_can_occupy_tile(&from->piece, to)) {
-        return false;
-    }
-
-    int l_diff;
-    int n_diff;
-
-    if (chess_get_chess_coords_diff(from, to, &l_diff, &n_diff) == -1) {
-        return false;
-    }
-
-    if (l_diff > 1 || n_diff > 1) {
-        return false;
-    }
-
-    return true;
-}
-
-static bool chess_piece_attacking_square(ChessState *state, ChessColour colour, Tile *to);
-
-/*
- * Return true if `player` is in check.
- */
-static bool chess_player_in_check(ChessState *state, const Player *player)
-{
-    Board *board = &state->board;
-
-    for (size_t i = 0; i < CHESS_SQUARES; ++i) {
-        Tile *tile = &board->tiles[i];
-
-        if (tile->piece.type == King && tile->piece.colour == player->colour) {
-            return chess_piece_attacking_square(state, player->colour == Black ? White : Black, tile);
-        }
-    }
-
-    return false;
+    return (player->colour == White && !state->black_to_move) || (player->colour == Black && state->black_to_move);
 }
 
 /*
- * Makes a mock move on the board and tests if it puts the player in check.
- *
- * Return true if move is valid.
- *
- * This function assumes that the legality of the move has already been checked.
+ * Removes `piece` from the board and puts it in `player`'s captured list. Also updates their score.
  */
-static bool chess_mock_move_valid(ChessState *state, const Player *player, Tile *from, Tile *to)
+static void chess_capture_piece(Player *player, Piece *piece)
 {
-    Board *board = &state->board;
-
-    const bool en_passant = player->en_passant_move_number == -1;
-    bool in_check = false;
-    Tile *ep_tile = NULL;
-    Piece ep_piece;
-    memset(&ep_piece, 0, sizeof(ep_piece));
-
-    if (en_passant) {  // remove piece that was captured via en passant
-        ChessCoords ep_coords;
-        ep_coords.N = player->colour == White ? to->chess_coords.N - 1 : to->chess_coords.N + 1;
-        ep_coords.L = to->chess_coords.L;
-        ep_tile = chess_get_tile_at_chess_coords(board, &ep_coords);
-
-        if (ep_tile == NULL) {
-            return false;
-        }
+    size_t idx = player->number_captured;
 
-        chess_copy_piece(&ep_piece, &ep_tile->piece);
-        ep_tile->piece.type = NoPiece;  // temporarily remove piece
+    if (idx < CHESS_SQUARES) {
+        chess_copy_piece(&player->captured[idx], piece);
+        ++player->number_captured;
     }
 
-    Piece from_piece;
-    Piece to_piece;
-    chess_copy_piece(&from_piece, &from->piece);
-    chess_copy_piece(&to_piece, &to->piece);
-
-    chess_copy_piece(&to->piece, &from->piece);
-    from->piece.type = NoPiece;
-
-    in_check = chess_player_in_check(state, player);
-
-    from->piece.type = from_piece.type;
-    chess_copy_piece(&to->piece, &to_piece);
-
-    if (en_passant) {
-        ep_tile->piece.type = ep_piece.type;  // reset piece to original state
-    }
+    player->score += chess_get_piece_value(piece->type);
 
-    return !in_check;
+    piece->type = NoPiece;
 }
 
 /*
- * Return 1 if we can legally move `from` to `to`.
- * Return 0 if move is legal but we're in check.
- * Return -1 if move is not legal.
- *
- * If `player` is null we don't check if move puts player in check.
+ * Puts coordinates associated with tile at x y coordinates in `chess_coords`.
  *
- * This function should not modify the game state.
+ * Return 0 on success.
+ * Return -1 if coordinates are out of bounds.
  */
-static int chess_valid_move(ChessState *state, const Player *player, Tile *from, Tile *to)
+static int chess_get_chess_coords(const Board *board, int x, int y, ChessCoords *chess_coords, bool self_is_white)
 {
-    if (chess_chess_coords_overlap(&from->chess_coords, &to->chess_coords)) {
-        return false;
+    if (x < board->x_left_bound || x > board->x_right_bound || y < board->y_top_bound || y > board->y_bottom_bound) {
+        return -1;
     }
 
-    bool valid = false;
-
-    Board *board = &state->board;
-
-    switch (from->piece.type) {
-        case Pawn:
-            valid = chess_valid_pawn_move(state, from, to);
-            break;
-
-        case Rook:
-            valid = chess_valid_rook_move(board, from, to);
-            break;
-
-        case Knight:
-            valid = chess_valid_knight_move(from, to);
-            break;
-
-        case Bishop:
-            valid = chess_valid_bishop_move(board, from, to);
-            break;
-
-        case Queen:
-            valid = chess_valid_queen_move(board, from, to);
-            break;
-
-        case King:
-            valid = chess_valid_king_move(from, to);
-            break;
+    size_t idx = (x - board->x_left_bound) / CHESS_TILE_SIZE_X;
 
-        default:
-            valid = false;
-            break;
+    if (idx >= CHESS_NUM_BOARD_LETTERS) {
+        return -1;
     }
 
-    int ret = valid ? 1 : -1;
-
-    if (player != NULL && valid) {
-        if (!chess_mock_move_valid(state, player, from, to)) {
-            ret = 0;
-        }
+    if (self_is_white) {
+        chess_coords->L = Board_Letters[idx];
+        chess_coords->N = ((board->y_bottom_bound + 1) - y) / CHESS_TILE_SIZE_Y;
+    } else {
+        chess_coords->L = Board_Letters[7 - idx];
+        chess_coords->N = 8 - (((board->y_bottom_bound + 1) - y) / CHESS_TILE_SIZE_Y) + 1;
     }
 
-    return ret;
+    return 0;
 }
 
 /*
- * Return true if any piece of `colour` is attacking tile designated by `to`.
+ * Returns the tile located at given coordinates.
  */
-static bool chess_piece_attacking_square(ChessState *state, ChessColour colour, Tile *to)
+static Tile *chess_get_tile(ChessState *state, int x, int y)
 {
     Board *board = &state->board;
 
-    for (size_t i = 0; i < CHESS_SQUARES; ++i) {
-        Tile *from = &board->tiles[i];
+    ChessCoords pair;
 
-        if (from->piece.colour != colour || from->piece.type == NoPiece) {
-            continue;
-        }
+    if (chess_get_chess_coords(board, x, y, &pair, state->self.colour == White) == -1) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < CHESS_SQUARES; ++i) {
+        Tile *tile = &board->tiles[i];
 
-        // We only need to know if a piece has line of sight so we don't
-        // care if the move puts the player in check
-        if (chess_valid_move(state, NULL, from, to) == 1) {
-            return true;
+        if (tile->chess_coords.N == pair.N && tile->chess_coords.L == pair.L) {
+            return tile;
         }
     }
 
-    return false;
+    return NULL;
 }
 
 /*
- * Disables castling if king or rook moves.
+ * Returns tile associated with `chess_coords`.
  */
-static void chess_player_set_can_castle(Player *player, const Tile *tile)
+static Tile *chess_get_tile_at_chess_coords(Board *board, const ChessCoords *chess_coords)
 {
-    if (!player->can_castle_ks && !player->can_castle_qs) {
-        return;
-    }
-
-    if (tile->piece.type == King) {
-        player->can_castle_ks = false;
-        player->can_castle_qs = false;
-        return;
-    }
-
-    if (tile->piece.type != Rook) {
-        return;
-    }
+    for (size_t i = 0; i < CHESS_SQUARES; ++i) {
+        Tile *tile = &board->tiles[i];
 
-    if ((player->colour == White && tile->chess_coords.N != 1) || (player->colour == Black && tile->chess_coords.N != 8)) {
-        return;
+        if (tile->chess_coords.N == chess_coords->N && tile->chess_coords.L == chess_coords->L) {
+            return tile;
+        }
     }
 
-    if (tile->chess_coords.L == 'a') {
-        player->can_castle_qs = false;
-    } else if (tile->chess_coords.L == 'h') {
-        player->can_castle_ks = false;
-    }
+    return NULL;
 }
 
 /*
- * Attempts to castle king for `player`.
- *
- * Return true if successfully castled.
+ * Returns the engine square index of `tile`.
  */
-static bool chess_player_castle(ChessState *state, Player *player, Tile *from, Tile *to)
+static int chess_tile_square(const Tile *tile)
 {
-    if (!player->can_castle_ks && !player->can_castle_qs) {
-        return false;
-    }
-
-    Board *board = &state->board;
-
-    if (!(from->piece.type == King && to->piece.type == NoPiece)) {
-        return false;
-    }
-
-    int l_diff;
-    int n_diff;
-
-    if (chess_get_chess_coords_diff(from, to, &l_diff, &n_diff) == -1) {
-        return false;
-    }
-
-    if (!(l_diff == 2 && n_diff == 0)) {
-        return false;
-    }
+    return chess_get_letter_index(tile->chess_coords.L) + (tile->chess_coords.N - 1) * CHESS_BOARD_COLUMNS;
+}
 
-    ChessCoords coords;
-    coords.N = to->chess_coords.N;
+static PieceType chess_piece_type_from_engine(Chess_Piece piece)
+{
+    switch (piece) {
+        case CHESS_PAWN:
+            return Pawn;
 
-    bool queen_side = false;
-    Tile *rook_to_tile = NULL;
+        case CHESS_KNIGHT:
+            return Knight;
 
-    if (to->chess_coords.L == 'g') {
-        if (!player->can_castle_ks) {
-            return false;
-        }
+        case CHESS_BISHOP:
+            return Bishop;
 
-        coords.L = 'f';
-        rook_to_tile = chess_get_tile_at_chess_coords(board, &coords);
+        case CHESS_ROOK:
+            return Rook;
 
-        if (rook_to_tile == NULL) {
-            return false;
-        }
+        case CHESS_QUEEN:
+            return Queen;
 
-        if (rook_to_tile->piece.type != NoPiece) {
-            return false;
-        }
-    } else if (to->chess_coords.L == 'c') {
-        if (!player->can_castle_qs) {
-            return false;
-        }
+        case CHESS_KING:
+            return King;
 
-        coords.L = 'd';
-        rook_to_tile = chess_get_tile_at_chess_coords(board, &coords);
+        default:
+            return NoPiece;
+    }
+}
 
-        coords.L = 'b';
-        const Tile *tmp_b = chess_get_tile_at_chess_coords(board, &coords);
+static void chess_update_state(ChessState *state, Player *self, Player *other, const Tile *from, const Tile *to)
+{
+    self->in_check = false;
 
-        if (rook_to_tile == NULL || tmp_b == NULL) {
-            return false;
-        }
+    other->in_check = chess_position_in_check(&state->position);
 
-        if (!(rook_to_tile->piece.type == NoPiece && tmp_b->piece.type == NoPiece)) {
-            return false;
-        }
+    state->message_length = 0;
+    state->black_to_move ^= 1;
 
-        queen_side = true;
-    } else {
-        return false;
+    if (state->black_to_move) {
+        ++state->move_number;
     }
 
-    ChessColour other_colour = player->colour == Black ? White : Black;
+    chess_print_move_notation(state, from, to, other->in_check);
+}
 
-    // Make sure a piece isn't attacking either square the king traverses
-    if (chess_piece_attacking_square(state, other_colour, rook_to_tile)) {
-        return false;
-    }
+/*
+ * Plays `move` for `player` on both the engine position and the displayed board.
+ *
+ * `move` must be legal for the side to move.
+ */
+static void chess_apply_move(ChessState *state, Player *player, Chess_Move move)
+{
+    Board *board = &state->board;
 
-    if (chess_piece_attacking_square(state, other_colour, to)) {
-        return false;
-    }
+    Tile *from = board->squares[chess_move_from(move)];
+    Tile *to = board->squares[chess_move_to(move)];
+
+    Tile from_orig;
+    memcpy(&from_orig, from, sizeof(Tile));
 
-    Tile *rook_from_tile = NULL;
+    Tile to_orig;
+    memcpy(&to_orig, to, sizeof(Tile));
 
-    // move rook
-    coords.L = queen_side ? 'a' : 'h';
-    rook_from_tile = chess_get_tile_at_chess_coords(board, &coords);
+    const int flags = chess_move_flags(move);
 
-    if (rook_from_tile == NULL || rook_from_tile->piece.type != Rook) {
-        return false;
+    if (flags == CHESS_FLAG_EN_PASSANT) {
+        // the captured pawn is beside the moving pawn, on the square behind `to`
+        chess_capture_piece(player, &board->squares[chess_move_to(move) ^ CHESS_BOARD_COLUMNS]->piece);
+    } else if (to->piece.type != NoPiece) {
+        chess_capture_piece(player, &to->piece);
     }
 
-    chess_copy_piece(&rook_to_tile->piece, &rook_from_tile->piece);
-    chess_set_piece(&rook_from_tile->piece, NoPiece, White);
-
-    // move king
-    Piece old_king;
-    chess_copy_piece(&old_king, &to->piece);
     chess_copy_piece(&to->piece, &from->piece);
-
     chess_set_piece(&from->piece, NoPiece, White);
-    player->holding_tile = NULL;
-
-    if (chess_player_in_check(state, player)) {
-        chess_copy_piece(&to->piece, &old_king);
-        chess_set_piece(&rook_to_tile->piece, NoPiece, White);
-        chess_set_piece(&rook_from_tile->piece, Rook, player->colour);
-        chess_set_piece(&from->piece, King, player->colour);
-        return false;
-    }
-
-    player->can_castle_qs = false;
-    player->can_castle_ks = false;
-
-    return true;
-}
-
-static void chess_update_state(ChessState *state, Player *self, Player *other, const Tile *from, const Tile *to)
-{
-    chess_player_check_en_passant(self);
 
-    self->in_check = false;
+    if (flags == CHESS_FLAG_KING_CASTLE || flags == CHESS_FLAG_QUEEN_CASTLE) {
+        const int rank_start = chess_move_to(move) - (chess_move_to(move) % CHESS_BOARD_COLUMNS);
+        Tile *rook_from = board->squares[rank_start + (flags == CHESS_FLAG_KING_CASTLE ? 7 : 0)];
+        Tile *rook_to = board->squares[rank_start + (flags == CHESS_FLAG_KING_CASTLE ? 5 : 3)];
 
-    other->in_check = chess_player_in_check(state, other);
+        chess_copy_piece(&rook_to->piece, &rook_from->piece);
+        chess_set_piece(&rook_from->piece, NoPiece, White);
+    }
 
-    state->message_length = 0;
-    state->black_to_move ^= 1;
+    const Chess_Piece promotion = chess_move_promotion(move);
 
-    if (state->black_to_move) {
-        ++state->move_number;
+    if (promotion != CHESS_NO_PIECE) {
+        chess_set_piece(&to->piece, chess_piece_type_from_engine(promotion), player->colour);
     }
 
-    chess_print_move_notation(state, from, to, other->in_check);
+    chess_position_make_move(&state->position, move);
+
+    Player *other = player == &state->self ? &state->other : &state->self;
+    chess_update_state(state, player, other, &from_orig, &to_orig);
 }
 
 /*
@@ -1118,40 +694,16 @@ static int chess_try_move_opponent(ChessState *state, Tile *from, Tile *to)
         return -1;
     }
 
-    Tile from_orig;
-    memcpy(&from_orig, from, sizeof(Tile));
-
-    Tile to_orig;
-    memcpy(&to_orig, to, sizeof(Tile));
-
-    int valid = chess_valid_move(state, opponent, from, to);
-
-    if (valid != 1) {
-        if (!opponent->in_check && chess_player_castle(state, opponent, from, to)) {
-            chess_set_piece(&from->piece, NoPiece, White);
-            goto on_success;
-        }
+    Chess_Move move;
 
+    // the move packet has no room for a promotion choice so pawns always promote to a queen
+    if (chess_position_find_move(&state->position, chess_tile_square(from), chess_tile_square(to), CHESS_QUEEN,
+                                 &move) != 1) {
         return -1;
     }
 
-    if (to->piece.type != NoPiece) {
-        chess_capture_piece(opponent, &to->piece);
-    }
-
-    chess_copy_piece(&to->piece, &from->piece);
-    chess_player_set_can_castle(opponent, &from_orig);
-    chess_set_piece(&from->piece, NoPiece, White);
-
-    // check if we need to promote pawn to queen
-    if (from_orig.piece.type == Pawn) {
-        if (to->chess_coords.N == 1 || to->chess_coords.N == 8) {
-            chess_set_piece(&to->piece, Queen, to->piece.colour);
-        }
-    }
+    chess_apply_move(state, opponent, move);
 
-on_success:
-    chess_update_state(state, opponent, &state->self, &from_orig, &to_orig);
     return 0;
 }
 
@@ -1173,35 +725,17 @@ static void chess_try_move_self(const GameData *game, ChessState *state, Player
         return;
     }
 
-    Tile from_orig;
-    memcpy(&from_orig, holding_tile, sizeof(Tile));
-
-    Tile to_orig;
-    memcpy(&to_orig, to_tile, sizeof(Tile));
-
     if (chess_chess_coords_overlap(&holding_tile->chess_coords, &to_tile->chess_coords)) {
         state->message_length = 0;
         self->holding_tile = NULL;
         return;
     }
 
-    int valid = chess_valid_move(state, self, holding_tile, to_tile);
+    Chess_Move move;
+    const int valid = chess_position_find_move(&state->position, chess_tile_square(holding_tile),
+                      chess_tile_square(to_tile), CHESS_QUEEN, &move);
 
     if (valid != 1) {
-        if (!self->in_check && chess_player_castle(state, self, holding_tile, to_tile)) {
-            if (chess_packet_send_move(game, &from_orig, to_tile) == -1) {
-                const char *message = "Connection error";
-                chess_set_status_message(state, message, strlen(message));
-                return;
-            }
-
-            chess_set_piece(&holding_tile->piece, NoPiece, White);
-
-            self->holding_tile = NULL;
-
-            goto on_success;
-        }
-
         self->holding_tile = NULL;
 
         const char *message = valid == -1 ? "Invalid move" : "Invalid move (check)";
@@ -1209,31 +743,15 @@ static void chess_try_move_self(const GameData *game, ChessState *state, Player
         return;
     }
 
-    if (chess_packet_send_move(game, &from_orig, to_tile) == -1) {
+    if (game->is_multiplayer && chess_packet_send_move(game, holding_tile, to_tile) == -1) {
         const char *message = "Failed to move: Connection error";
         chess_set_status_message(state, message, strlen(message));
         return;
     }
 
-    if (to_tile->piece.type != NoPiece) {
-        chess_capture_piece(self, &to_tile->piece);
-    }
-
-    chess_copy_piece(&to_tile->piece, &self->holding_tile->piece);
-
     self->holding_tile = NULL;
-    chess_set_piece(&holding_tile->piece, NoPiece, White);
-    chess_player_set_can_castle(self, &from_orig);
-
-    // check if we need to promote pawn to queen
-    if (from_orig.piece.type == Pawn) {
-        if (to_tile->chess_coords.N == 1 || to_tile->chess_coords.N == 8) {
-            chess_set_piece(&to_tile->piece, Queen, to_tile->piece.colour);
-        }
-    }
 
-on_success:
-    chess_update_state(state, self, &state->other, &from_orig, &to_orig);
+    chess_apply_move(state, self, move);
 }
 
 static void chess_pick_up_piece(ChessState *state, Player *player)
@@ -1301,43 +819,14 @@ static int chess_player_can_mate(ChessState *state, const Player *player)
 }
 
 /*
- * Return true if piece on `from` tile can move to any other square on the board.
- */
-static bool chess_piece_can_move(ChessState *state, const Player *player, Tile *from)
-{
-    Board *board = &state->board;
-
-    for (size_t i = 0; i < CHESS_SQUARES; ++i) {
-        Tile *to = &board->tiles[i];
-
-        if (chess_valid_move(state, player, from, to) == 1) {
-            return true;
-        }
-    }
-
-    return false;
-}
-
-/*
- * Return true if any piece for `player` can make a legal move.
+ * Return true if the player to move has at least one legal move.
  */
-static bool chess_any_piece_can_move(ChessState *state, const Player *player)
+static bool chess_player_to_move_can_move(const ChessState *state)
 {
-    Board *board = &state->board;
-
-    for (size_t i = 0; i < CHESS_SQUARES; ++i) {
-        Tile *from = &board->tiles[i];
-
-        if (from->piece.colour != player->colour || from->piece.type == NoPiece) {
-            continue;
-        }
-
-        if (chess_piece_can_move(state, player, from)) {
-            return true;
-        }
-    }
+    Chess_Move_List moves;
+    chess_generate_legal_moves(&state->position, &moves);
 
-    return false;
+    return moves.count > 0;
 }
 
 /*
@@ -1362,12 +851,7 @@ static bool chess_game_is_statemate(ChessState *state)
         return true;
     }
 
-    if (self_can_mate == 1) {
-        return false;
-    }
-
-    // player only has pawns and/or king, see if any remaining piece can move
-    return !chess_any_piece_can_move(state, self);
+    return !chess_player_to_move_can_move(state);
 }
 
 /*
@@ -1376,32 +860,40 @@ static bool chess_game_is_statemate(ChessState *state)
 static bool chess_game_checkmate(ChessState *state)
 {
     const Player *player = chess_get_player_to_move(state);
-    return !chess_any_piece_can_move(state, player);
+    return player->in_check && !chess_player_to_move_can_move(state);
 }
 
 /*
  * Checks if we have a checkmate or stalemate and updates game status.
  */
-static void chess_update_status(ChessState *state)
+static void chess_update_status(GameData *game, ChessState *state)
 {
     if (chess_game_is_statemate(state)) {
         state->status = Stalemate;
         const char *message = "Stalemate";
         chess_set_status_message(state, message, strlen(message));
-        return;
-    }
-
-    if (chess_game_checkmate(state)) {
+    } else if (chess_game_checkmate(state)) {
         state->status = Checkmate;
         const char *message = "Checkmate!";
         chess_set_status_message(state, message, strlen(message));
+    }
+
+    if (state->status != Playing) {
+        if (!game->is_multiplayer) {
+            game_set_status(game, GS_Finished);
+        }
+
         return;
     }
+
+    if (state->ai != NULL && chess_player_to_move(state, &state->other)) {
+        chess_ai_request_move(state->ai, &state->position);
+    }
 }
 
-static void chess_do_input(const GameData *game, ChessState *state)
+static void chess_do_input(GameData *game, ChessState *state)
 {
-    if (state->status != Playing) {
+    if (state->status != Playing || game->status == GS_Paused) {
         return;
     }
 
@@ -1411,7 +903,7 @@ static void chess_do_input(const GameData *game, ChessState *state)
         chess_pick_up_piece(state, self);
     } else {
         chess_try_move_self(game, state, self);
-        chess_update_status(state);
+        chess_update_status(game, state);
     }
 }
 
@@ -1793,6 +1285,24 @@ static void chess_cb_on_keypress(GameData *game, int key, void *cb_data)
     }
 }
 
+static void chess_cb_update_state(GameData *game, void *cb_data)
+{
+    ChessState *state = (ChessState *)cb_data;
+
+    if (state == NULL || state->ai == NULL || state->status != Playing) {
+        return;
+    }
+
+    Chess_Move move;
+
+    if (!chess_ai_poll_move(state->ai, &move)) {
+        return;
+    }
+
+    chess_apply_move(state, &state->other, move);
+    chess_update_status(game, state);
+}
+
 static void chess_cb_kill(GameData *game, void *cb_data)
 {
     ChessState *state = (ChessState *)cb_data;
@@ -1801,10 +1311,14 @@ static void chess_cb_kill(GameData *game, void *cb_data)
         return;
     }
 
+    chess_ai_free(state->ai);
     free(state);
 
-    chess_packet_send_resign(game);
+    if (game->is_multiplayer) {
+        chess_packet_send_resign(game);
+    }
 
+    game_set_cb_update_state(game, NULL, NULL);
     game_set_cb_render_window(game, NULL, NULL);
     game_set_cb_kill(game, NULL, NULL);
     game_set_cb_on_keypress(game, NULL, NULL);
@@ -1934,7 +1448,7 @@ static void chess_cb_on_packet(GameData *game, const uint8_t *data, size_t lengt
                     state->status = Resigned;
                 }
 
-                chess_update_status(state);
+                chess_update_status(game, state);
             }
 
             break;
@@ -1994,6 +1508,8 @@ static int chess_init_board(GameData *game, ChessState *state, bool self_is_whit
             tile->chess_coords.L = letter;
             tile->chess_coords.N = number_idx;
 
+            board->squares[chess_tile_square(tile)] = tile;
+
             number_idx = self_is_white ? number_idx - 1 : number_idx + 1;
             ++board_idx;
         }
@@ -2120,7 +1636,7 @@ int chess_initialize(GameData *game, const uint8_t *init_data, size_t length, bo
 
     bool self_is_white = rand_range_not_secure(2) == 0;
 
-    if (!self_host) {
+    if (game->is_multiplayer && !self_host) {
         if (length != CHESS_PACKET_SEND_INVITE_LENGTH) {
             fprintf(stderr, "Tried to join a game with invalid game data of length %zu\n", length);
             free(state);
@@ -2151,12 +1667,22 @@ int chess_initialize(GameData *game, const uint8_t *init_data, size_t length, bo
         return -3;
     }
 
-    state->self.can_castle_ks = true;
-    state->self.can_castle_qs = true;
-    state->other.can_castle_ks = true;
-    state->other.can_castle_qs = true;
+    chess_position_init(&state->position);
+
+    if (!game->is_multiplayer) {
+        state->ai = chess_ai_new();
+
+        if (state->ai == NULL) {
+            free(state);
+            return -3;
+        }
+
+        state->status = Playing;
 
-    if (self_host) {
+        if (!self_is_white) {
+            chess_ai_request_move(state->ai, &state->position);
+        }
+    } else if (self_host) {
         if (chess_packet_send_invite(game, self_is_white) == -1) {
             free(state);
             return -2;
@@ -2170,6 +1696,7 @@ int chess_initialize(GameData *game, const uint8_t *init_data, size_t length, bo
         state->status = Playing;
     }
 
+    game_set_cb_update_state(game, chess_cb_update_state, state);
     game_set_cb_render_window(game, chess_cb_render_window, state);
     game_set_cb_on_keypress(game, chess_cb_on_keypress, state);
     game_set_cb_kill(game, chess_cb_kill, state);
@@ -20,32 +20,33 @@
  *
  */
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "game_life.h"
+#include "life_board.h"
+#include "life_hash.h"
+#include "life_rle.h"
+#include "misc_tools.h"
 
-#define LIFE_DEFAULT_CELL_CHAR     'o'
 #define LIFE_CELL_DEFAULT_COLOUR    CYAN
 #define LIFE_DEFAULT_SPEED          25
 #define LIFE_MAX_SPEED              40
 
-/* Determines the additional size of the grid beyond the visible boundaries.
+/* The dimensions of the grid. The window shows a viewport into the grid which scrolls
+ * when the cursor is moved past its edges.
  *
- * This buffer allows cells to continue growing off-screen giving the illusion of an
- * infinite grid to a certain point.
+ * Cells beyond the edges of the grid are dead unless wraparound is enabled, in which case
+ * the grid is a torus.
  */
-#define LIFE_BOUNDARY_BUFFER        50
+#define LIFE_BOARD_WIDTH            1024
+#define LIFE_BOARD_HEIGHT           512
 
+/* HashLife mode has no grid, but the cursor is kept within this distance of the origin */
+#define LIFE_HASH_CURSOR_LIMIT      (INT64_C(1) << 48)
 
-typedef struct Cell {
-    Coords     coords;
-    bool       alive;
-    bool       marked;  // true if cell should invert alive status at end of current cycle
-    int        display_char;
-    size_t     age;
-} Cell;
 
 typedef struct LifeState {
     TIME_MS    time_last_cycle;
@@ -53,12 +54,19 @@ typedef struct LifeState {
     size_t     generation;
     bool       paused;
 
-    Cell       **cells;
-    int        num_columns;
-    int        num_rows;
+    Life_Board *board;
 
-    int        curs_x;
-    int        curs_y;
+    /* When `hash_mode` is true the pattern lives in `hash` instead of `board`, and each
+     * cycle advances it by 2^`step_log2` generations. `hash` is created on first use. */
+    Life_Hash  *hash;
+    bool       hash_mode;
+    unsigned int step_log2;
+
+    /* The cursor and the top-left corner of the viewport in grid coordinates */
+    int64_t    curs_x;
+    int64_t    curs_y;
+    int64_t    view_x;
+    int64_t    view_y;
 
     int        x_left_bound;
     int        x_right_bound;
@@ -69,6 +77,11 @@ typedef struct LifeState {
     int        colour;
 } LifeState;
 
+typedef struct LifeDrawContext {
+    WINDOW          *win;
+    const LifeState *state;
+} LifeDrawContext;
+
 
 static void life_increase_speed(LifeState *state)
 {
@@ -84,10 +97,10 @@ static void life_decrease_speed(LifeState *state)
     }
 }
 
-static int life_get_display_char(const LifeState *state, const Cell *cell)
+static int life_get_display_char(const LifeState *state, int age)
 {
     if (state->display_candy == 1) {
-        if (cell->age == 1) {
+        if (age == 1) {
             return '.';
         }
 
@@ -95,15 +108,15 @@ static int life_get_display_char(const LifeState *state, const Cell *cell)
     }
 
     if (state->display_candy == 2) {
-        if (cell->age == 1) {
+        if (age == 1) {
             return '.';
         }
 
-        if (cell->age == 2) {
+        if (age == 2) {
             return '-';
         }
 
-        if (cell->age == 3) {
+        if (age == 3) {
             return 'o';
         }
 
@@ -158,113 +171,184 @@ static void life_cycle_colour(LifeState *state)
     }
 }
 
-static Cell *life_get_cell_at_coords(const LifeState *state, const int x, const int y)
+static int life_view_width(const LifeState *state)
 {
-    const int i = y - (state->y_top_bound - (LIFE_BOUNDARY_BUFFER / 2));
-    const int j = x - (state->x_left_bound - (LIFE_BOUNDARY_BUFFER / 2));
+    return state->x_right_bound - state->x_left_bound + 1;
+}
 
-    if (i >= 0 && j >= 0) {
-        return &state->cells[i][j];
-    }
+static int life_view_height(const LifeState *state)
+{
+    return state->y_bottom_bound - state->y_top_bound;
+}
 
-    return NULL;
+static void life_draw_cell(int x, int y, int age, void *user_data)
+{
+    const LifeDrawContext *ctx = (const LifeDrawContext *)user_data;
+    const LifeState *state = ctx->state;
+
+    const int win_x = state->x_left_bound + (int)(x - state->view_x);
+    const int win_y = state->y_top_bound + (int)(y - state->view_y);
+
+    mvwaddch(ctx->win, win_y, win_x, life_get_display_char(state, age));
 }
 
+/* The quadtree doesn't track cell ages so every cell is drawn as fully grown. */
+static void life_draw_hash_cell(int64_t x, int64_t y, void *user_data)
+{
+    const LifeDrawContext *ctx = (const LifeDrawContext *)user_data;
+    const LifeState *state = ctx->state;
+
+    const int win_x = state->x_left_bound + (int)(x - state->view_x);
+    const int win_y = state->y_top_bound + (int)(y - state->view_y);
+
+    mvwaddch(ctx->win, win_y, win_x, life_get_display_char(state, LIFE_BOARD_MAX_AGE));
+}
+
+/*
+ * Draws the live cells inside the viewport. Only the parts of the grid or quadtree that
+ * overlap the viewport are visited.
+ */
 static void life_draw_cells(const GameData *game, WINDOW *win, LifeState *state)
 {
-    wattron(win, A_BOLD | COLOR_PAIR(state->colour));
+    LifeDrawContext ctx = {
+        .win = win,
+        .state = state,
+    };
 
-    for (int i = LIFE_BOUNDARY_BUFFER / 2; i < state->num_rows - (LIFE_BOUNDARY_BUFFER / 2); ++i) {
-        for (int j = LIFE_BOUNDARY_BUFFER / 2; j < state->num_columns + 1 - (LIFE_BOUNDARY_BUFFER / 2); ++j) {
-            Cell *cell = &state->cells[i][j];
+    wattron(win, A_BOLD | COLOR_PAIR(state->colour));
 
-            if (cell->alive) {
-                Coords coords = cell->coords;
-                mvwaddch(win, coords.y, coords.x, cell->display_char);
-            }
-        }
+    if (state->hash_mode) {
+        life_hash_for_each_live(state->hash, state->view_x, state->view_y, life_view_width(state),
+                                life_view_height(state), life_draw_hash_cell, &ctx);
+    } else {
+        life_board_for_each_live(state->board, (int) state->view_x, (int) state->view_y, life_view_width(state),
+                                 life_view_height(state), life_draw_cell, &ctx);
     }
 
     wattroff(win, A_BOLD | COLOR_PAIR(state->colour));
 }
 
-static void life_toggle_cell(LifeState *state)
+static void life_draw_hash_status(WINDOW *win, const LifeState *state)
 {
-    Cell *cell = life_get_cell_at_coords(state, state->curs_x, state->curs_y);
+    wattron(win, A_BOLD);
+    mvwprintw(win, state->y_bottom_bound + 1, state->x_left_bound, "HashLife  Step: 2^%u  Gen: %llu  Pop: %llu  Mem: %zuM",
+              state->step_log2, (unsigned long long) life_hash_generation(state->hash),
+              (unsigned long long) life_hash_population(state->hash), life_hash_memory_usage(state->hash) / (1024 * 1024));
+    wattroff(win, A_BOLD);
+}
 
-    if (cell == NULL) {
+static void life_toggle_cell(LifeState *state)
+{
+    if (state->hash_mode) {
+        const bool alive = life_hash_get(state->hash, state->curs_x, state->curs_y);
+        life_hash_set(state->hash, state->curs_x, state->curs_y, !alive);
         return;
     }
 
-    cell->alive ^= 1;
+    const bool alive = life_board_get(state->board, (int) state->curs_x, (int) state->curs_y);
+
+    life_board_set(state->board, (int) state->curs_x, (int) state->curs_y, !alive);
+}
+
+static int life_hash_init(LifeState *state)
+{
+    if (state->hash != NULL) {
+        return 0;
+    }
+
+    /* the default budget, LIFE_HASH_DEFAULT_MEMORY_BUDGET */
+    state->hash = life_hash_new(0);
+
+    return state->hash != NULL ? 0 : -1;
+}
+
+static void life_copy_cell_to_hash(int x, int y, int age, void *user_data)
+{
+    UNUSED_VAR(age);
+
+    life_hash_set((Life_Hash *)user_data, x, y, true);
+}
+
+static void life_copy_cell_to_board(int64_t x, int64_t y, void *user_data)
+{
+    life_board_set((Life_Board *)user_data, (int) x, (int) y, true);
 }
 
 /*
- * Returns the number of live neighbours of cell at `i` `j` position.
- *
- * Returns NULL if cell is touching a border.
+ * Puts the cursor at `x`, `y` and the viewport around it. In grid mode both are clamped
+ * to the grid.
  */
-static int life_get_live_neighbours(const LifeState *state, const int i, const int j)
+static void life_centre_view(LifeState *state, int64_t x, int64_t y)
 {
-    Cell *n[8] = {0};
+    const int view_width = life_view_width(state);
+    const int view_height = life_view_height(state);
 
-    if (i > 0 && j > 0) {
-        n[0] = &state->cells[i - 1][j - 1];
-    }
+    state->view_x = x - (view_width / 2);
+    state->view_y = y - (view_height / 2);
 
-    if (i > 0) {
-        n[1] = &state->cells[i - 1][j];
+    if (!state->hash_mode) {
+        state->view_x = MAX(0, MIN(state->view_x, LIFE_BOARD_WIDTH - view_width));
+        state->view_y = MAX(0, MIN(state->view_y, LIFE_BOARD_HEIGHT - view_height));
+        x = MAX(0, MIN(x, LIFE_BOARD_WIDTH - 1));
+        y = MAX(0, MIN(y, LIFE_BOARD_HEIGHT - 1));
     }
 
-    if (i > 0 && j < state->num_columns - 1) {
-        n[2] = &state->cells[i - 1][j + 1];
-    }
+    state->curs_x = x;
+    state->curs_y = y;
+}
 
-    if (j > 0) {
-        n[3] = &state->cells[i][j - 1];
-    }
+/*
+ * Switches between the bitboard and the HashLife quadtree, carrying the pattern across.
+ * Cells outside the grid are lost when switching back to the bitboard.
+ */
+static void life_toggle_hash_mode(LifeState *state)
+{
+    if (!state->hash_mode) {
+        if (life_hash_init(state) == -1) {
+            return;
+        }
 
-    if (j < state->num_columns - 1) {
-        n[4] = &state->cells[i][j + 1];
+        life_hash_clear(state->hash);
+        life_board_for_each_live(state->board, 0, 0, LIFE_BOARD_WIDTH, LIFE_BOARD_HEIGHT, life_copy_cell_to_hash,
+                                 state->hash);
+        state->hash_mode = true;
+        return;
     }
 
-    if (i < state->num_rows - 1 && j > 0) {
-        n[5] = &state->cells[i + 1][j - 1];
-    }
+    life_board_clear(state->board);
+    life_hash_for_each_live(state->hash, 0, 0, LIFE_BOARD_WIDTH, LIFE_BOARD_HEIGHT, life_copy_cell_to_board,
+                            state->board);
+    life_hash_clear(state->hash);
+    state->hash_mode = false;
 
-    if (i < state->num_rows - 1) {
-        n[6] = &state->cells[i + 1][j];
-    }
+    life_centre_view(state, state->curs_x, state->curs_y);
+}
 
-    if (i < state->num_rows - 1 && j < state->num_columns - 1) {
-        n[7] = &state->cells[i + 1][j + 1];
+static void life_increase_step(LifeState *state)
+{
+    if (state->step_log2 < LIFE_HASH_MAX_STEP_LOG2) {
+        ++state->step_log2;
     }
+}
 
-    int count = 0;
-
-    for (size_t idx = 0; idx < 8; ++idx) {
-        if (n[idx] == NULL) {
-            return 0; // If we're at a boundary kill cell
-        }
-
-        if (n[idx]->alive) {
-            ++count;
-        }
+static void life_decrease_step(LifeState *state)
+{
+    if (state->step_log2 > 0) {
+        --state->step_log2;
     }
+}
 
-    return count;
+static void life_toggle_wrap(LifeState *state)
+{
+    life_board_set_wrap(state->board, !life_board_wraps(state->board));
 }
 
 static void life_restart(GameData *game, LifeState *state)
 {
-    for (int i = 0; i < state->num_rows; ++i) {
-        for (int j = 0; j < state->num_columns; ++j) {
-            Cell *cell = &state->cells[i][j];
-            cell->alive = false;
-            cell->marked = false;
-            cell->display_char = LIFE_DEFAULT_CELL_CHAR;
-            cell->age = 0;
-        }
+    life_board_clear(state->board);
+
+    if (state->hash != NULL) {
+        life_hash_clear(state->hash);
     }
 
     game_set_score(game, 0);
@@ -272,24 +356,22 @@ static void life_restart(GameData *game, LifeState *state)
     state->generation = 0;
 }
 
-static void life_do_cells(LifeState *state)
+static void life_hash_cycle(GameData *game, LifeState *state)
 {
+    if (life_hash_step(state->hash, state->step_log2) == -1) {
+        game_set_status(game, GS_Paused);  // out of memory or space; let the user shrink the step
+        return;
+    }
 
-    for (int i = 0; i < state->num_rows; ++i) {
-        for (int j = 0; j < state->num_columns; ++j) {
-            Cell *cell = &state->cells[i][j];
-
-            if (cell->marked) {
-                cell->marked = false;
-                cell->alive ^= 1;
-                cell->age = cell->alive;
-                cell->display_char = life_get_display_char(state, cell);
-            } else if (cell->alive) {
-                ++cell->age;
-                cell->display_char = life_get_display_char(state, cell);
-            }
-        }
+    if (life_hash_population(state->hash) == 0) {
+        life_restart(game, state);
+        return;
     }
+
+    const long int points = state->step_log2 < sizeof(long int) * CHAR_BIT - 1 ? 1L << state->step_log2 : LONG_MAX;
+    const long int score = game_get_score(game);
+
+    game_set_score(game, score > LONG_MAX - points ? LONG_MAX : score + points);
 }
 
 static void life_cycle(GameData *game, LifeState *state)
@@ -298,46 +380,28 @@ static void life_cycle(GameData *game, LifeState *state)
         return;
     }
 
-    TIME_MS cur_time = get_time_millis();
+    TIME_MS cur_time = game_get_tick_time(game);
 
     if (!game_do_object_state_update(game, cur_time, state->time_last_cycle, state->speed)) {
         return;
     }
 
-    state->time_last_cycle = get_time_millis();
+    state->time_last_cycle = cur_time;
 
     ++state->generation;
 
-    size_t live_cells = 0;
-
-    for (int i = 0; i < state->num_rows; ++i) {
-        for (int j = 0; j < state->num_columns; ++j) {
-            Cell *cell = &state->cells[i][j];
-
-            int live_neighbours = life_get_live_neighbours(state, i, j);
-
-            if (cell->alive) {
-                if (!(live_neighbours == 2 || live_neighbours == 3)) {
-                    cell->marked = true;
-                } else {
-                    ++live_cells;
-                }
-            } else {
-                if (live_neighbours == 3) {
-                    cell->marked = true;
-                    ++live_cells;
-                }
-            }
-        }
+    if (state->hash_mode) {
+        life_hash_cycle(game, state);
+        return;
     }
 
-    if (live_cells == 0) {
+    life_board_step(state->board);
+
+    if (life_board_population(state->board) == 0) {
         life_restart(game, state);
         return;
     }
 
-    life_do_cells(state);
-
     game_update_score(game, 1);
 }
 
@@ -365,57 +429,68 @@ static void life_cb_render_window(GameData *game, WINDOW *win, void *cb_data)
         return;
     }
 
-    move(state->curs_y, state->curs_x);
+    move(state->y_top_bound + (int)(state->curs_y - state->view_y), state->x_left_bound + (int)(state->curs_x - state->view_x));
 
     if (state->generation == 0 || state->paused) {
         curs_set(1);
     }
 
     life_draw_cells(game, win, state);
+
+    if (state->hash_mode) {
+        life_draw_hash_status(win, state);
+    }
 }
 
-static void life_move_curs_left(LifeState *state)
+/*
+ * Moves the cursor to `x`, `y` if it's on the grid, scrolling the viewport to keep the
+ * cursor inside it.
+ */
+static void life_move_curs(LifeState *state, int64_t x, int64_t y)
 {
-    int new_x = state->curs_x - 1;
-
-    if (new_x < state->x_left_bound) {
+    if (state->hash_mode) {
+        if (x < -LIFE_HASH_CURSOR_LIMIT || y < -LIFE_HASH_CURSOR_LIMIT || x > LIFE_HASH_CURSOR_LIMIT
+                || y > LIFE_HASH_CURSOR_LIMIT) {
+            return;
+        }
+    } else if (x < 0 || y < 0 || x >= LIFE_BOARD_WIDTH || y >= LIFE_BOARD_HEIGHT) {
         return;
     }
 
-    state->curs_x = new_x;
-}
+    state->curs_x = x;
+    state->curs_y = y;
 
-static void life_move_curs_right(LifeState *state)
-{
-    int new_x = state->curs_x + 1;
-
-    if (new_x > state->x_right_bound) {
-        return;
+    if (x < state->view_x) {
+        state->view_x = x;
+    } else if (x >= state->view_x + life_view_width(state)) {
+        state->view_x = x - life_view_width(state) + 1;
     }
 
-    state->curs_x = new_x;
+    if (y < state->view_y) {
+        state->view_y = y;
+    } else if (y >= state->view_y + life_view_height(state)) {
+        state->view_y = y - life_view_height(state) + 1;
+    }
 }
 
-static void life_move_curs_up(LifeState *state)
+static void life_move_curs_left(LifeState *state)
 {
-    int new_y = state->curs_y - 1;
+    life_move_curs(state, state->curs_x - 1, state->curs_y);
+}
 
-    if (new_y < state->y_top_bound) {
-        return;
-    }
+static void life_move_curs_right(LifeState *state)
+{
+    life_move_curs(state, state->curs_x + 1, state->curs_y);
+}
 
-    state->curs_y = new_y;
+static void life_move_curs_up(LifeState *state)
+{
+    life_move_curs(state, state->curs_x, state->curs_y - 1);
 }
 
 static void life_move_curs_down(LifeState *state)
 {
-    int new_y = state->curs_y + 1;
-
-    if (new_y >= state->y_bottom_bound) {
-        return;
-    }
-
-    state->curs_y = new_y;
+    life_move_curs(state, state->curs_x, state->curs_y + 1);
 }
 
 static void life_move_curs_up_left(LifeState *state)
@@ -534,25 +609,30 @@ static void life_cb_on_keypress(GameData *game, int key, void *cb_data)
             break;
         }
 
-        default: {
-            return;
+        case 'w': {
+            life_toggle_wrap(state);
+            break;
         }
-    }
-}
 
-static void life_free_cells(LifeState *state)
-{
-    if (state->cells == NULL) {
-        return;
-    }
+        case 'h': {
+            life_toggle_hash_mode(state);
+            break;
+        }
 
-    for (int i = 0; i < state->num_rows; ++i) {
-        if (state->cells[i]) {
-            free(state->cells[i]);
+        case ']': {
+            life_increase_step(state);
+            break;
         }
-    }
 
-    free(state->cells);
+        case '[': {
+            life_decrease_step(state);
+            break;
+        }
+
+        default: {
+            return;
+        }
+    }
 }
 
 static void life_cb_pause(GameData *game, bool is_paused, void *cb_data)
@@ -574,7 +654,8 @@ static void life_cb_kill(GameData *game, void *cb_data)
         return;
     }
 
-    life_free_cells(state);
+    life_board_free(state->board);
+    life_hash_free(state->hash);
     free(state);
 
     game_set_cb_update_state(game, NULL, NULL);
@@ -595,50 +676,80 @@ static int life_init_state(GameData *game, LifeState *state)
     state->y_top_bound = y_top;
     state->y_bottom_bound = y_bottom;
 
-    const int x_mid = x_left + ((x_right - x_left) / 2);
-    const int y_mid = y_top + ((y_bottom - y_top) / 2);
+    const int view_width = life_view_width(state);
+    const int view_height = life_view_height(state);
 
-    state->curs_x = x_mid;
-    state->curs_y = y_mid;
+    if (view_width <= 0 || view_height <= 0 || view_width > LIFE_BOARD_WIDTH || view_height > LIFE_BOARD_HEIGHT) {
+        return -1;
+    }
 
-    const int num_rows = (y_bottom - y_top) + LIFE_BOUNDARY_BUFFER;
-    const int num_columns = (x_right - x_left) + LIFE_BOUNDARY_BUFFER;
+    state->board = life_board_new(LIFE_BOARD_WIDTH, LIFE_BOARD_HEIGHT, false);
 
-    if (num_rows <= 0 || num_columns <= 0) {
+    if (state->board == NULL) {
         return -1;
     }
 
-    state->num_columns = num_columns;
-    state->num_rows = num_rows;
+    life_centre_view(state, LIFE_BOARD_WIDTH / 2, LIFE_BOARD_HEIGHT / 2);
+
+    state->speed = LIFE_DEFAULT_SPEED;
+    state->colour = LIFE_CELL_DEFAULT_COLOUR;
+
+    life_restart(game, state);
+
+    return 0;
+}
+
+typedef struct LifePatternLoad {
+    Life_Hash *hash;
+    int64_t   x;
+    int64_t   y;
+} LifePatternLoad;
+
+static int life_load_pattern_cell(int64_t x, int64_t y, void *user_data)
+{
+    const LifePatternLoad *load = (const LifePatternLoad *)user_data;
 
-    state->cells = calloc(1, num_rows * sizeof(Cell *));
+    return life_hash_set(load->hash, load->x + x, load->y + y, true);
+}
 
-    if (state->cells == NULL) {
+/*
+ * Loads the RLE pattern file at `path` with its top-left corner at the centre of the grid.
+ * Patterns that don't fit on the grid are left in HashLife mode.
+ *
+ * Return 0 on success.
+ * Return -1 on failure.
+ */
+static int life_load_pattern(LifeState *state, const char *path)
+{
+    if (life_hash_init(state) == -1) {
         return -1;
     }
 
-    for (int i = 0; i < num_rows; ++i) {
-        state->cells[i] = calloc(1, num_columns * sizeof(Cell));
+    LifePatternLoad load = {
+        .hash = state->hash,
+        .x = LIFE_BOARD_WIDTH / 2,
+        .y = LIFE_BOARD_HEIGHT / 2,
+    };
 
-        if (state->cells[i] == NULL) {
-            return -1;
-        }
+    int64_t width = 0;
+    int64_t height = 0;
 
-        for (int j = 0; j < num_columns; ++j) {
-            state->cells[i][j].coords.y = i + (state->y_top_bound - (LIFE_BOUNDARY_BUFFER / 2));
-            state->cells[i][j].coords.x = j + (state->x_left_bound - (LIFE_BOUNDARY_BUFFER / 2));
-        }
+    if (life_rle_load(path, life_load_pattern_cell, &load, &width, &height) != LIFE_RLE_OK) {
+        return -1;
     }
 
-    state->speed = LIFE_DEFAULT_SPEED;
-    state->colour = LIFE_CELL_DEFAULT_COLOUR;
+    state->hash_mode = true;
 
-    life_restart(game, state);
+    if (load.x + width <= LIFE_BOARD_WIDTH && load.y + height <= LIFE_BOARD_HEIGHT) {
+        life_toggle_hash_mode(state);
+    }
+
+    life_centre_view(state, load.x + (width / 2), load.y + (height / 2));
 
     return 0;
 }
 
-int life_initialize(GameData *game)
+int life_initialize(GameData *game, const char *pattern_path, size_t path_length)
 {
     // Try best fit from largest to smallest before giving up
     if (game_set_window_shape(game, GW_ShapeRectangleLarge) == -1) {
@@ -658,11 +769,31 @@ int life_initialize(GameData *game)
     }
 
     if (life_init_state(game, state) == -1) {
-        life_free_cells(state);
+        life_board_free(state->board);
         free(state);
         return -1;
     }
 
+    if (pattern_path != NULL && path_length > 0) {
+        char path[PATH_MAX];
+
+        if (path_length >= sizeof(path)) {
+            life_board_free(state->board);
+            free(state);
+            return -5;
+        }
+
+        memcpy(path, pattern_path, path_length);
+        path[path_length] = '\0';
+
+        if (life_load_pattern(state, path) == -1) {
+            life_board_free(state->board);
+            life_hash_free(state->hash);
+            free(state);
+            return -5;
+        }
+    }
+
     game_set_update_interval(game, 40);
     game_show_score(game, true);
 
@@ -25,7 +25,17 @@
 
 #include "game_base.h"
 
-int life_initialize(GameData *game);
+/*
+ * Starts a game of Life.
+ *
+ * If `pattern_path` is non-NULL it names an RLE pattern file of `path_length` bytes (not
+ * necessarily null terminated) which is loaded at the centre of the grid.
+ *
+ * Return 0 on success.
+ * Return -1 if the window is too small or memory allocation fails.
+ * Return -5 if the pattern file can't be loaded.
+ */
+int life_initialize(GameData *game, const char *pattern_path, size_t path_length);
 
 #endif // GAME_LIFE
 
@@ -0,0 +1,407 @@
+/*  game_net.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "game_net.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ack (4 bytes) + delta base (4 bytes) + first sequence number (4 bytes) + state count (1 byte) + flags (1 byte) */
+#define GAME_NET_HEADER_SIZE 14
+
+/* Set if states are encoded against the base state. Otherwise they're encoded against a state of all zeroes. */
+#define GAME_NET_FLAG_HAS_BASE 0x01
+
+/* Each state is encoded as a bitmask of the bytes that changed, followed by those bytes */
+#define GAME_NET_MASK_SIZE(state_size) (((state_size) + 7) / 8)
+
+typedef struct Game_Net_History {
+    uint8_t  states[GAME_NET_HISTORY][GAME_NET_MAX_STATE_SIZE];
+    uint32_t seqs[GAME_NET_HISTORY];
+    bool     valid[GAME_NET_HISTORY];
+} Game_Net_History;
+
+struct Game_Net {
+    size_t   state_size;
+
+    game_net_predict_cb *predict;
+    void     *user_data;
+
+    uint32_t local_seq;
+    uint32_t local_acked;
+    Game_Net_History local;
+
+    uint32_t remote_seq;
+    Game_Net_History remote;
+    Game_Net_History predicted;  // the last prediction made for each tick
+
+    uint32_t mispredictions;
+};
+
+static const uint8_t *history_get(const Game_Net_History *history, uint32_t seq)
+{
+    const size_t slot = seq % GAME_NET_HISTORY;
+
+    if (!history->valid[slot] || history->seqs[slot] != seq) {
+        return NULL;
+    }
+
+    return history->states[slot];
+}
+
+static void history_put(Game_Net_History *history, uint32_t seq, const uint8_t *state, size_t state_size)
+{
+    const size_t slot = seq % GAME_NET_HISTORY;
+
+    memcpy(history->states[slot], state, state_size);
+    history->seqs[slot] = seq;
+    history->valid[slot] = true;
+}
+
+static void pack_u32(uint8_t *bytes, uint32_t v)
+{
+    bytes[0] = (uint8_t)(v >> 24);
+    bytes[1] = (uint8_t)(v >> 16);
+    bytes[2] = (uint8_t)(v >> 8);
+    bytes[3] = (uint8_t) v;
+}
+
+static uint32_t unpack_u32(const uint8_t *bytes)
+{
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8) | bytes[3];
+}
+
+Game_Net *game_net_new(size_t state_size, const uint8_t *local_initial, const uint8_t *remote_initial,
+                       game_net_predict_cb *predict, void *user_data)
+{
+    if (state_size == 0 || state_size > GAME_NET_MAX_STATE_SIZE) {
+        return NULL;
+    }
+
+    Game_Net *net = calloc(1, sizeof(Game_Net));
+
+    if (net == NULL) {
+        return NULL;
+    }
+
+    net->state_size = state_size;
+    net->predict = predict;
+    net->user_data = user_data;
+
+    history_put(&net->local, 0, local_initial, state_size);
+    history_put(&net->remote, 0, remote_initial, state_size);
+
+    return net;
+}
+
+void game_net_free(Game_Net *net)
+{
+    free(net);
+}
+
+uint32_t game_net_push_local(Game_Net *net, const uint8_t *state)
+{
+    ++net->local_seq;
+    history_put(&net->local, net->local_seq, state, net->state_size);
+
+    return net->local_seq;
+}
+
+uint32_t game_net_local_seq(const Game_Net *net)
+{
+    return net->local_seq;
+}
+
+uint32_t game_net_local_acked(const Game_Net *net)
+{
+    return net->local_acked;
+}
+
+uint32_t game_net_remote_seq(const Game_Net *net)
+{
+    return net->remote_seq;
+}
+
+uint32_t game_net_mispredictions(const Game_Net *net)
+{
+    return net->mispredictions;
+}
+
+/*
+ * Encodes the bytes of `state` that differ from `reference` into `buf`.
+ *
+ * Returns the encoded length, or 0 if it would be longer than `max_length`.
+ */
+static size_t encode_state(const uint8_t *state, const uint8_t *reference, size_t state_size, uint8_t *buf,
+                           size_t max_length)
+{
+    const size_t mask_size = GAME_NET_MASK_SIZE(state_size);
+
+    if (mask_size > max_length) {
+        return 0;
+    }
+
+    memset(buf, 0, mask_size);
+
+    size_t length = mask_size;
+
+    for (size_t i = 0; i < state_size; ++i) {
+        if (state[i] == reference[i]) {
+            continue;
+        }
+
+        if (length == max_length) {
+            return 0;
+        }
+
+        buf[i / 8] |= (uint8_t)(1 << (i % 8));
+        buf[length] = state[i];
+        ++length;
+    }
+
+    return length;
+}
+
+/*
+ * Decodes a state encoded by encode_state() against `reference` from `data` into `state`.
+ *
+ * Returns the number of bytes read, or 0 if `data` is too short or the mask is invalid.
+ */
+static size_t decode_state(const uint8_t *data, size_t length, const uint8_t *reference, size_t state_size,
+                           uint8_t *state)
+{
+    const size_t mask_size = GAME_NET_MASK_SIZE(state_size);
+
+    if (mask_size > length) {
+        return 0;
+    }
+
+    // bits past the end of the state must be clear
+    if (state_size % 8 != 0 && (data[mask_size - 1] >> (state_size % 8)) != 0) {
+        return 0;
+    }
+
+    size_t offset = mask_size;
+
+    for (size_t i = 0; i < state_size; ++i) {
+        if ((data[i / 8] & (1 << (i % 8))) == 0) {
+            state[i] = reference[i];
+            continue;
+        }
+
+        if (offset == length) {
+            return 0;
+        }
+
+        state[i] = data[offset];
+        ++offset;
+    }
+
+    return offset;
+}
+
+size_t game_net_write_packet(const Game_Net *net, uint8_t *buf, size_t max_length)
+{
+    static const uint8_t zeroes[GAME_NET_MAX_STATE_SIZE];
+
+    if (max_length < GAME_NET_HEADER_SIZE) {
+        return 0;
+    }
+
+    const size_t state_size = net->state_size;
+    const uint32_t newest = net->local_seq;
+
+    // The peer still has the acknowledged state as long as it's within its history
+    const uint8_t *base = NULL;
+
+    if (newest - net->local_acked < GAME_NET_HISTORY) {
+        base = history_get(&net->local, net->local_acked);
+    }
+
+    const uint8_t *reference = base != NULL ? base : zeroes;
+
+    uint32_t first = net->local_acked + 1;
+
+    if (newest >= GAME_NET_HISTORY && first <= newest - GAME_NET_HISTORY) {
+        first = newest - GAME_NET_HISTORY + 1;
+    }
+
+    size_t length = GAME_NET_HEADER_SIZE;
+    size_t count = 0;
+
+    for (uint32_t seq = first; seq <= newest && count < UINT8_MAX; ++seq) {
+        const uint8_t *state = history_get(&net->local, seq);
+
+        if (state == NULL) {
+            break;
+        }
+
+        const size_t encoded = encode_state(state, reference, state_size, buf + length, max_length - length);
+
+        if (encoded == 0) {
+            break;
+        }
+
+        length += encoded;
+        ++count;
+    }
+
+    pack_u32(buf, net->remote_seq);
+    pack_u32(buf + 4, net->local_acked);
+    pack_u32(buf + 8, first);
+    buf[12] = (uint8_t) count;
+    buf[13] = base != NULL ? GAME_NET_FLAG_HAS_BASE : 0;
+
+    return length;
+}
+
+int game_net_read_packet(Game_Net *net, const uint8_t *data, size_t length, uint32_t *first_new)
+{
+    if (length < GAME_NET_HEADER_SIZE) {
+        return -1;
+    }
+
+    const uint32_t ack = unpack_u32(data);
+    const uint32_t base_seq = unpack_u32(data + 4);
+    const uint32_t first = unpack_u32(data + 8);
+    const size_t count = data[12];
+    const uint8_t flags = data[13];
+
+    if (ack > net->local_seq || (flags & ~GAME_NET_FLAG_HAS_BASE) != 0 || first == 0) {
+        return -1;
+    }
+
+    if (count > 0 && first > UINT32_MAX - (count - 1)) {
+        return -1;
+    }
+
+    const size_t state_size = net->state_size;
+    uint8_t reference[GAME_NET_MAX_STATE_SIZE] = {0};
+
+    if ((flags & GAME_NET_FLAG_HAS_BASE) != 0) {
+        const uint8_t *base = history_get(&net->remote, base_seq);
+
+        if (base == NULL) {
+            return -1;
+        }
+
+        memcpy(reference, base, state_size);
+    }
+
+    // Make sure the whole packet decodes before storing any of it
+    uint8_t state[GAME_NET_MAX_STATE_SIZE];
+    size_t offset = GAME_NET_HEADER_SIZE;
+
+    for (size_t i = 0; i < count; ++i) {
+        const size_t decoded = decode_state(data + offset, length - offset, reference, state_size, state);
+
+        if (decoded == 0) {
+            return -1;
+        }
+
+        offset += decoded;
+    }
+
+    if (offset != length) {
+        return -1;
+    }
+
+    if (ack > net->local_acked) {
+        net->local_acked = ack;
+    }
+
+    int new_states = 0;
+    offset = GAME_NET_HEADER_SIZE;
+
+    for (size_t i = 0; i < count; ++i) {
+        offset += decode_state(data + offset, length - offset, reference, state_size, state);
+
+        const uint32_t seq = first + (uint32_t) i;
+
+        // skip states we already have, and gaps too old to fill
+        if (history_get(&net->remote, seq) != NULL
+                || (net->remote_seq >= GAME_NET_HISTORY && seq <= net->remote_seq - GAME_NET_HISTORY)) {
+            continue;
+        }
+
+        const uint8_t *prediction = history_get(&net->predicted, seq);
+
+        if (prediction != NULL && memcmp(prediction, state, state_size) != 0) {
+            ++net->mispredictions;
+        }
+
+        history_put(&net->remote, seq, state, state_size);
+
+        if (seq > net->remote_seq) {
+            net->remote_seq = seq;
+        }
+
+        if (new_states == 0 || seq < *first_new) {
+            *first_new = seq;
+        }
+
+        ++new_states;
+    }
+
+    return new_states;
+}
+
+int game_net_remote_state(Game_Net *net, uint32_t seq, uint8_t *state)
+{
+    const size_t state_size = net->state_size;
+    const uint8_t *received = history_get(&net->remote, seq);
+
+    if (received != NULL) {
+        memcpy(state, received, state_size);
+        return 1;
+    }
+
+    const uint8_t *known = NULL;
+    uint32_t known_seq = 0;
+
+    for (uint32_t back = 1; back < GAME_NET_HISTORY && back <= seq; ++back) {
+        known = history_get(&net->remote, seq - back);
+
+        if (known != NULL) {
+            known_seq = seq - back;
+            break;
+        }
+    }
+
+    if (known == NULL) {
+        return -1;
+    }
+
+    memcpy(state, known, state_size);
+
+    for (uint32_t s = known_seq; s < seq && net->predict != NULL; ++s) {
+        uint8_t next[GAME_NET_MAX_STATE_SIZE];
+        net->predict(state, next, state_size, net->user_data);
+        memcpy(state, next, state_size);
+    }
+
+    history_put(&net->predicted, seq, state, state_size);
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*  game_net.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef GAME_NET_H
+#define GAME_NET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Netcode for games that run in lockstep over a fixed tick: each side sends the state of its own
+ * player once per tick, and shows the other player's state for the same tick.
+ *
+ * Every local state gets a sequence number, starting at 1 for the first tick after the initial
+ * state (which both sides know, and is sequence number 0). Every packet acknowledges the newest
+ * state received from the peer, and carries all of the local states the peer hasn't acknowledged
+ * yet, so a late or dropped packet is made up for by the next one. Each of those states is encoded
+ * as the bytes that differ from the newest state the peer has acknowledged.
+ *
+ * The peer's states for ticks that haven't arrived yet are predicted from the last one received.
+ * Predictions are recomputed from received states whenever they're asked for, so a late state
+ * replaces everything predicted from before it.
+ */
+typedef struct Game_Net Game_Net;
+
+/* The maximum size of a player's state for one tick */
+#define GAME_NET_MAX_STATE_SIZE 64
+
+/* The number of ticks of history kept for each side. Ticks older than this can't be resent or predicted from. */
+#define GAME_NET_HISTORY 64
+
+/* Puts the state that follows `state` in `next`. Used to predict ticks that haven't been received yet. */
+typedef void game_net_predict_cb(const uint8_t *state, uint8_t *next, size_t state_size, void *user_data);
+
+/*
+ * Creates netcode for states of `state_size` bytes. `local_initial` and `remote_initial` are the
+ * states of each player before the first tick.
+ *
+ * Returns NULL if `state_size` is 0 or larger than GAME_NET_MAX_STATE_SIZE, or if allocation fails.
+ */
+Game_Net *game_net_new(size_t state_size, const uint8_t *local_initial, const uint8_t *remote_initial,
+                       game_net_predict_cb *predict, void *user_data);
+
+void game_net_free(Game_Net *net);
+
+/* Records the local player's state for the next tick. Returns the tick's sequence number. */
+uint32_t game_net_push_local(Game_Net *net, const uint8_t *state);
+
+/* Returns the sequence number of the newest local state. */
+uint32_t game_net_local_seq(const Game_Net *net);
+
+/* Returns the sequence number of the newest local state the peer has acknowledged. */
+uint32_t game_net_local_acked(const Game_Net *net);
+
+/* Returns the sequence number of the newest state received from the peer. */
+uint32_t game_net_remote_seq(const Game_Net *net);
+
+/* Returns the number of received states that differed from what had been predicted for them. */
+uint32_t game_net_mispredictions(const Game_Net *net);
+
+/*
+ * Writes a packet to `buf` holding as many unacknowledged local states as fit in `max_length` bytes,
+ * oldest first.
+ *
+ * Returns the length of the packet, or 0 if `max_length` is too small for the packet header.
+ */
+size_t game_net_write_packet(const Game_Net *net, uint8_t *buf, size_t max_length);
+
+/*
+ * Reads a packet written by the peer's game_net_write_packet().
+ *
+ * If any states are new, `first_new` is set to the lowest sequence number among them. Everything
+ * shown for the peer from that tick on should be refreshed with game_net_remote_state().
+ *
+ * Returns the number of new states.
+ * Returns -1 if the packet is malformed.
+ */
+int game_net_read_packet(Game_Net *net, const uint8_t *data, size_t length, uint32_t *first_new);
+
+/*
+ * Puts the peer's state for tick `seq` in `state`.
+ *
+ * Returns 1 if the state was received from the peer.
+ * Returns 0 if it's predicted from an earlier state.
+ * Returns -1 if no state within GAME_NET_HISTORY ticks before `seq` has been received.
+ */
+int game_net_remote_state(Game_Net *net, uint32_t seq, uint8_t *state);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* GAME_NET_H */
@@ -0,0 +1,230 @@
+#include "game_net.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr size_t kStateSize = 9;
+
+using State = std::array<uint8_t, kStateSize>;
+using Packet = std::vector<uint8_t>;
+
+/* Predicts that the first byte keeps counting up */
+void count_up(const uint8_t *state, uint8_t *next, size_t state_size, void *user_data)
+{
+    (void)user_data;
+    std::memcpy(next, state, state_size);
+    ++next[0];
+}
+
+State make_state(uint8_t counter, uint8_t tag = 0)
+{
+    State state{};
+    state[0] = counter;
+    state[kStateSize - 1] = tag;
+    return state;
+}
+
+Packet write_packet(const Game_Net *net, size_t max_length = 1024)
+{
+    Packet packet(max_length);
+    packet.resize(game_net_write_packet(net, packet.data(), packet.size()));
+    return packet;
+}
+
+class GameNetTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        const State initial = make_state(0);
+        a_ = game_net_new(kStateSize, initial.data(), initial.data(), count_up, nullptr);
+        b_ = game_net_new(kStateSize, initial.data(), initial.data(), count_up, nullptr);
+        ASSERT_NE(a_, nullptr);
+        ASSERT_NE(b_, nullptr);
+    }
+
+    void TearDown() override
+    {
+        game_net_free(a_);
+        game_net_free(b_);
+    }
+
+    int deliver(Game_Net *from, Game_Net *to, uint32_t *first_new = nullptr)
+    {
+        uint32_t first = 0;
+        const Packet packet = write_packet(from);
+        const int ret = game_net_read_packet(to, packet.data(), packet.size(), &first);
+
+        if (first_new != nullptr) {
+            *first_new = first;
+        }
+
+        return ret;
+    }
+
+    State remote_state(Game_Net *net, uint32_t seq, int expected_ret)
+    {
+        State state{};
+        EXPECT_EQ(game_net_remote_state(net, seq, state.data()), expected_ret) << "seq " << seq;
+        return state;
+    }
+
+    Game_Net *a_ = nullptr;
+    Game_Net *b_ = nullptr;
+};
+
+TEST(GameNet, RejectsBadStateSizes)
+{
+    const uint8_t initial[GAME_NET_MAX_STATE_SIZE + 1] = {0};
+
+    EXPECT_EQ(game_net_new(0, initial, initial, nullptr, nullptr), nullptr);
+    EXPECT_EQ(game_net_new(GAME_NET_MAX_STATE_SIZE + 1, initial, initial, nullptr, nullptr), nullptr);
+}
+
+TEST_F(GameNetTest, DeliversStatesInOrder)
+{
+    for (uint8_t i = 1; i <= 3; ++i) {
+        EXPECT_EQ(game_net_push_local(a_, make_state(i, i * 7).data()), i);
+    }
+
+    uint32_t first_new = 0;
+    EXPECT_EQ(deliver(a_, b_, &first_new), 3);
+    EXPECT_EQ(first_new, 1u);
+    EXPECT_EQ(game_net_remote_seq(b_), 3u);
+
+    for (uint8_t i = 1; i <= 3; ++i) {
+        EXPECT_EQ(remote_state(b_, i, 1), make_state(i, i * 7));
+    }
+
+    // the same states again are nothing new
+    EXPECT_EQ(deliver(a_, b_), 0);
+}
+
+TEST_F(GameNetTest, ResendsUntilAcknowledged)
+{
+    game_net_push_local(a_, make_state(1).data());
+    write_packet(a_);  // lost
+    game_net_push_local(a_, make_state(2).data());
+
+    EXPECT_EQ(deliver(a_, b_), 2);
+
+    EXPECT_EQ(deliver(b_, a_), 0);
+    EXPECT_EQ(game_net_local_acked(a_), 2u);
+
+    game_net_push_local(a_, make_state(3).data());
+
+    uint32_t first_new = 0;
+    EXPECT_EQ(deliver(a_, b_, &first_new), 1);
+    EXPECT_EQ(first_new, 3u);
+    EXPECT_EQ(remote_state(b_, 3, 1), make_state(3));
+}
+
+TEST_F(GameNetTest, EncodesOnlyChangedBytes)
+{
+    for (uint8_t i = 1; i <= 10; ++i) {
+        game_net_push_local(a_, make_state(i).data());
+    }
+
+    // header, then for each state a two byte mask and the one byte that differs from the base
+    const Packet packet = write_packet(a_);
+    EXPECT_EQ(packet.size(), 14u + 10 * 3);
+
+    EXPECT_EQ(deliver(a_, b_), 10);
+    EXPECT_EQ(deliver(b_, a_), 0);
+
+    // unchanged from the acknowledged state
+    game_net_push_local(a_, make_state(10).data());
+    EXPECT_EQ(write_packet(a_).size(), 14u + 2);
+    EXPECT_EQ(deliver(a_, b_), 1);
+    EXPECT_EQ(remote_state(b_, 11, 1), make_state(10));
+}
+
+TEST_F(GameNetTest, BatchesWhatFits)
+{
+    for (uint8_t i = 1; i <= 10; ++i) {
+        game_net_push_local(a_, make_state(i).data());
+    }
+
+    const Packet packet = write_packet(a_, 14 + 4 * 3 + 2);
+    uint32_t first_new = 0;
+    EXPECT_EQ(game_net_read_packet(b_, packet.data(), packet.size(), &first_new), 4);
+    EXPECT_EQ(game_net_remote_seq(b_), 4u);
+
+    EXPECT_EQ(deliver(b_, a_), 0);
+    EXPECT_EQ(deliver(a_, b_, &first_new), 6);
+    EXPECT_EQ(first_new, 5u);
+    EXPECT_EQ(remote_state(b_, 10, 1), make_state(10));
+
+    EXPECT_EQ(write_packet(a_, 13).size(), 0u);
+}
+
+TEST_F(GameNetTest, PredictsAndCountsMispredictions)
+{
+    // nothing received yet, so ticks are predicted from the initial state
+    EXPECT_EQ(remote_state(b_, 3, 0), make_state(3));
+
+    game_net_push_local(a_, make_state(1).data());
+    game_net_push_local(a_, make_state(2).data());
+    game_net_push_local(a_, make_state(2, 1).data());  // not what was predicted
+
+    EXPECT_EQ(deliver(a_, b_), 3);
+    EXPECT_EQ(game_net_mispredictions(b_), 1u);
+
+    EXPECT_EQ(remote_state(b_, 3, 1), make_state(2, 1));
+    EXPECT_EQ(remote_state(b_, 5, 0), make_state(4, 1));
+}
+
+TEST_F(GameNetTest, FallsBackToFullStatesPastHistory)
+{
+    const uint32_t count = GAME_NET_HISTORY + 36;
+
+    for (uint32_t i = 1; i <= count; ++i) {
+        game_net_push_local(a_, make_state((uint8_t) i, 0xff).data());
+    }
+
+    uint32_t first_new = 0;
+    EXPECT_EQ(deliver(a_, b_, &first_new), (int) GAME_NET_HISTORY);
+    EXPECT_EQ(first_new, count - GAME_NET_HISTORY + 1);
+    EXPECT_EQ(remote_state(b_, count, 1), make_state((uint8_t) count, 0xff));
+
+    EXPECT_EQ(remote_state(b_, count + 2, 0), make_state((uint8_t)(count + 2), 0xff));
+
+    // nothing is known from before the history, or too far past the newest state
+    remote_state(b_, count - GAME_NET_HISTORY, -1);
+    remote_state(b_, count + GAME_NET_HISTORY, -1);
+}
+
+TEST_F(GameNetTest, RejectsMalformedPackets)
+{
+    for (uint8_t i = 1; i <= 5; ++i) {
+        game_net_push_local(a_, make_state(i, i).data());
+    }
+
+    const Packet packet = write_packet(a_);
+    uint32_t first_new = 0;
+
+    for (size_t length = 0; length < packet.size(); ++length) {
+        EXPECT_EQ(game_net_read_packet(b_, packet.data(), length, &first_new), -1) << "length " << length;
+    }
+
+    Packet trailing = packet;
+    trailing.push_back(0);
+    EXPECT_EQ(game_net_read_packet(b_, trailing.data(), trailing.size(), &first_new), -1);
+
+    Packet bad_mask = packet;
+    bad_mask[14 + 1] |= 0x80;  // the ninth byte is the last one in the state
+    EXPECT_EQ(game_net_read_packet(b_, bad_mask.data(), bad_mask.size(), &first_new), -1);
+
+    Packet bad_ack = packet;
+    bad_ack[3] = 1;  // b hasn't sent anything
+    EXPECT_EQ(game_net_read_packet(b_, bad_ack.data(), bad_ack.size(), &first_new), -1);
+
+    EXPECT_EQ(game_net_remote_seq(b_), 0u);
+    EXPECT_EQ(game_net_read_packet(b_, packet.data(), packet.size(), &first_new), 5);
+}
+
+}  // namespace
@@ -101,7 +101,7 @@
 /* Set to true to have the host controlled by a naive AI bot */
 #define USE_AI false
 
-#define SNAKE_ONLINE_VERSION 0x01u
+#define SNAKE_ONLINE_VERSION 0x02u
 
 
 typedef enum SnakeOnlienStatus {
@@ -168,10 +168,14 @@ typedef struct SnakeState {
 
     bool        is_online;
     bool        self_host;
-    bool        send_flag;  // true if it's our turn to send a packet
+    bool        net_started;  // true once the first tick has been played by either side
     SnakeOnlineStatus status;
 
+    Game_Net    *net;
+    uint32_t    other_tick;   // the other player's last tick applied to other_snake
+
     Snake       *other_snake;
+    Snake       *other_view;  // other_snake moved along the path predicted for the ticks we've played past it
     size_t      other_snake_length;
     Direction   other_direction;
 } SnakeState;
@@ -181,6 +185,8 @@ static bool snake_packet_send_state(const GameData *game, SnakeState *state);
 static bool snake_packet_invite_request(const GameData *game);
 static bool snake_packet_invite_respond(const GameData *game, const SnakeState *state);
 static bool snake_packet_abort(const GameData *game);
+static bool snake_net_start(SnakeState *state);
+static void snake_net_update_other(GameData *game, SnakeState *state);
 static void snake_cb_on_packet(GameData *game, const uint8_t *data, size_t length, void *cb_data);
 
 
@@ -819,7 +825,7 @@ static void snake_move(GameData *game, SnakeState *state, TIME_MS cur_time)
         return;
     }
 
-    if (state->is_online && !state->send_flag) {
+    if (state->is_online && !state->net_started) {
         return;
     }
 
@@ -850,9 +856,15 @@ static void snake_move(GameData *game, SnakeState *state, TIME_MS cur_time)
         snake_do_points_update(game, state, points);
     }
 
-    if (state->is_online && !snake_packet_send_state(game, state)) {
+    if (!state->is_online) {
+        return;
+    }
+
+    if (!snake_packet_send_state(game, state)) {
         fprintf(stderr, "failed to send state\n");
     }
+
+    snake_net_update_other(game, state);
 }
 
 /*
@@ -996,7 +1008,7 @@ static void snake_cb_update_game_state(GameData *game, void *cb_data)
         return;
     }
 
-    TIME_MS cur_time = get_time_millis();
+    TIME_MS cur_time = game_get_tick_time(game);
 
     if (!state->is_online) {
         snake_decay_points(game, state);
@@ -1026,6 +1038,8 @@ static void snake_cb_render_window(GameData *game, WINDOW *win, void *cb_data)
     if (!state->is_online) {
         snake_draw_powerup(win, state);
         snake_draw_agent(win, state);
+    } else if (state->status == SnakeStatusPlaying) {
+        snake_draw_snake(win, state->other_view, state->other_snake_length);
     } else {
         snake_draw_snake(win, state->other_snake, state->other_snake_length);
     }
@@ -1045,9 +1059,11 @@ static void snake_cb_kill(GameData *game, void *cb_data)
         snake_packet_abort(game);
     }
 
+    game_net_free(state->net);
     free(state->snake);
     free(state->agents);
     free(state->other_snake);
+    free(state->other_view);
     free(state);
 
     game_set_cb_update_state(game, NULL, NULL);
@@ -1194,8 +1210,9 @@ int snake_initialize(GameData *game, bool is_online, bool self_host)
         snake_set_head_char(state->snake, SOUTH);
     } else {
         state->other_snake = calloc(1, SNAKE_MAX_SNAKE_LENGTH * sizeof(Snake));
+        state->other_view = calloc(1, SNAKE_MAX_SNAKE_LENGTH * sizeof(Snake));
 
-        if (state->other_snake == NULL) {
+        if (state->other_snake == NULL || state->other_view == NULL) {
             goto on_error;
         }
     }
@@ -1225,6 +1242,10 @@ int snake_initialize(GameData *game, bool is_online, bool self_host)
     } else {
         state->status = SnakeStatusPlaying;
 
+        if (!snake_net_start(state)) {
+            goto on_error;
+        }
+
         if (!snake_packet_invite_respond(game, state)) {
             err = -2;
             goto on_error;
@@ -1237,8 +1258,10 @@ int snake_initialize(GameData *game, bool is_online, bool self_host)
     return 0;
 
 on_error:
+    game_net_free(state->net);
     free(state->snake);
     free(state->other_snake);
+    free(state->other_view);
     free(state->agents);
     free(state);
     return err;
@@ -1248,6 +1271,144 @@ on_error:
  * START MULTIPLAYER
  */
 
+/*
+ * The state each player records for every tick they play, with coordinates relative to the board:
+ * [
+ *  direction    (1 byte)
+ *  head x coord (4 bytes)
+ *  head y coord (4 bytes)
+ *  food x coord (4 bytes)
+ *  food y coord (4 bytes)
+ * ]
+ */
+#define SNAKE_NET_STATE_SIZE (1 + (sizeof(uint32_t) * 4))
+
+static void snake_net_pack_state(const SnakeState *state, Direction dir, const Coords *head, uint8_t *buf)
+{
+    Coords head_coords;
+    game_util_win_coords_to_board(head->x, head->y, state->x_left_bound, state->y_top_bound, &head_coords);
+
+    Coords food_coords;
+    game_util_win_coords_to_board(state->food.x, state->food.y, state->x_left_bound, state->y_top_bound,
+                                  &food_coords);
+
+    size_t length = 0;
+    buf[length] = (uint8_t)dir;
+    ++length;
+
+    game_util_pack_u32(buf + length, head_coords.x);
+    length += sizeof(uint32_t);
+
+    game_util_pack_u32(buf + length, head_coords.y);
+    length += sizeof(uint32_t);
+
+    game_util_pack_u32(buf + length, food_coords.x);
+    length += sizeof(uint32_t);
+
+    game_util_pack_u32(buf + length, food_coords.y);
+}
+
+static void snake_net_unpack_state(const SnakeState *state, const uint8_t *buf, Direction *dir, Coords *head,
+                                   Coords *food)
+{
+    uint32_t head_x_coord;
+    uint32_t head_y_coord;
+    uint32_t food_x_coord;
+    uint32_t food_y_coord;
+
+    size_t unpacked = 0;
+    *dir = (Direction)buf[unpacked];
+    ++unpacked;
+
+    game_util_unpack_u32(buf + unpacked, &head_x_coord);
+    unpacked += sizeof(uint32_t);
+
+    game_util_unpack_u32(buf + unpacked, &head_y_coord);
+    unpacked += sizeof(uint32_t);
+
+    game_util_unpack_u32(buf + unpacked, &food_x_coord);
+    unpacked += sizeof(uint32_t);
+
+    game_util_unpack_u32(buf + unpacked, &food_y_coord);
+
+    game_util_board_to_win_coords(head_x_coord, head_y_coord, state->x_left_bound, state->y_top_bound, head);
+    game_util_board_to_win_coords(food_x_coord, food_y_coord, state->x_left_bound, state->y_top_bound, food);
+}
+
+/*
+ * Predicts that the other snake keeps going in the same direction.
+ */
+static void snake_net_predict(const uint8_t *state, uint8_t *next, size_t state_size, void *user_data)
+{
+    UNUSED_VAR(user_data);
+
+    memcpy(next, state, state_size);
+
+    uint32_t x;
+    uint32_t y;
+    game_util_unpack_u32(state + 1, &x);
+    game_util_unpack_u32(state + 1 + sizeof(uint32_t), &y);
+
+    Coords head = {(int)x, (int)y};
+    game_util_move_coords((Direction)state[0], &head);
+
+    game_util_pack_u32(next + 1, head.x);
+    game_util_pack_u32(next + 1 + sizeof(uint32_t), head.y);
+}
+
+/*
+ * Rebuilds the view of the other snake: other_snake, moved along the head positions that have been
+ * received or predicted for the ticks we've played since its last applied tick.
+ */
+static void snake_net_build_view(SnakeState *state)
+{
+    Snake *view = state->other_view;
+    memcpy(view, state->other_snake, state->other_snake_length * sizeof(Snake));
+
+    const uint32_t local_seq = game_net_local_seq(state->net);
+
+    for (uint32_t seq = state->other_tick + 1; seq <= local_seq; ++seq) {
+        uint8_t buf[SNAKE_NET_STATE_SIZE];
+
+        if (game_net_remote_state(state->net, seq, buf) == -1) {
+            continue;
+        }
+
+        Direction dir;
+        Coords head;
+        Coords food;
+        snake_net_unpack_state(state, buf, &dir, &head, &food);
+
+        snake_move_body(view, state->other_snake_length);
+        memcpy(snake_get_head_coords(view), &head, sizeof(Coords));
+        snake_set_head_char(view, dir);
+    }
+}
+
+/*
+ * Creates the netcode for a game, starting from both snakes' positions and the agreed on food.
+ *
+ * Return true on success.
+ */
+static bool snake_net_start(SnakeState *state)
+{
+    uint8_t local_initial[SNAKE_NET_STATE_SIZE];
+    uint8_t remote_initial[SNAKE_NET_STATE_SIZE];
+
+    snake_net_pack_state(state, state->direction, snake_get_head_coords(state->snake), local_initial);
+    snake_net_pack_state(state, state->other_direction, snake_get_head_coords(state->other_snake), remote_initial);
+
+    state->net = game_net_new(SNAKE_NET_STATE_SIZE, local_initial, remote_initial, snake_net_predict, NULL);
+
+    if (state->net == NULL) {
+        return false;
+    }
+
+    snake_net_build_view(state);
+
+    return true;
+}
+
 /*
  * Sends an invite response packet to friend. Packet is comprised of:
  * [
@@ -1430,103 +1591,94 @@ static bool snake_apply_state(GameData *game, SnakeState *state, Direction other
 }
 
 /*
- * Send your current game state to the other peer. This packet includes:
- * [
- *  packet_type    (1 byte)
- *  self direction (1 byte)
- *  self x coord   (4 bytes)
- *  self y coord   (4 bytes)
- *  food x coord   (4 bytes)
- *  food y coord   (4 bytes)
- * ]
- *
- * Return true on success.
+ * Ends the game when a tick of the other player's can no longer be applied, e.g. because it has
+ * fallen out of the netcode history. The protocol has no way to resend a full snapshot, and playing
+ * on would silently leave the two games out of sync.
  */
-#define SNAKE_PACKET_STATE_LENGTH (1 + 1 + (sizeof(uint32_t) * 4))
-static bool snake_packet_send_state(const GameData *game, SnakeState *state)
+static void snake_net_lost_sync(GameData *game, SnakeState *state)
 {
-    // Convert our relative coordinates to real coordinates before sending
-    const Snake *snake = state->snake;
+    snake_packet_abort(game);
 
-    Coords snake_coords;
-    game_util_win_coords_to_board(snake->coords.x, snake->coords.y, state->x_left_bound, state->y_top_bound,
-                                  &snake_coords);
-
-    Coords food_coords;
-    game_util_win_coords_to_board(state->food.x, state->food.y, state->x_left_bound, state->y_top_bound,
-                                  &food_coords);
+    state->game_over = true;
+    state->status = SnakeStatusFinished;
 
-    uint8_t data[SNAKE_PACKET_STATE_LENGTH];
+    game_set_status(game, GS_Finished);
 
-    size_t length = 0;
-    data[length] = SNAKE_PACKET_STATE;
-    ++length;
+    snake_create_message(game, state->direction, "Lost sync with the other player", A_BOLD, WHITE,
+                         SNAKE_DEFAULT_MESSAGE_TIMER, snake_get_head_coords(state->snake), true);
+    game_window_notify(game, "Snake game ended: lost sync with the other player");
+}
 
-    data[length] = (uint8_t)state->direction;
-    ++length;
+/*
+ * Applies the other player's states for every tick up to our own that has arrived, in order, then
+ * rebuilds the view of the other snake from there.
+ */
+static void snake_net_update_other(GameData *game, SnakeState *state)
+{
+    const uint32_t local_seq = game_net_local_seq(state->net);
+    const uint32_t remote_seq = game_net_remote_seq(state->net);
+    const uint32_t last_tick = MIN(local_seq, remote_seq);
 
-    game_util_pack_u32(data + length, snake_coords.x);
-    length += sizeof(uint32_t);
+    while (state->other_tick < last_tick && state->status == SnakeStatusPlaying) {
+        uint8_t buf[SNAKE_NET_STATE_SIZE];
 
-    game_util_pack_u32(data + length, snake_coords.y);
-    length += sizeof(uint32_t);
+        if (game_net_remote_state(state->net, state->other_tick + 1, buf) == -1) {
+            snake_net_lost_sync(game, state);
+            return;
+        }
 
-    game_util_pack_u32(data + length, food_coords.x);
-    length += sizeof(uint32_t);
+        ++state->other_tick;
 
-    game_util_pack_u32(data + length, food_coords.y);
-    length += sizeof(uint32_t);
+        Direction other_direction;
+        Coords other_coords;
+        Coords food_coords;
+        snake_net_unpack_state(state, buf, &other_direction, &other_coords, &food_coords);
 
-    if (game_packet_send(game, data, length, GP_Data) == 0) {
-        state->send_flag = false;
-        return length == SNAKE_PACKET_STATE_LENGTH;
+        snake_apply_state(game, state, other_direction, &other_coords, &food_coords);
     }
 
-
-    return false;
+    snake_net_build_view(state);
 }
 
 /*
- * Handles a state packet and updates the game state accordingly.
+ * Records our state for the tick we just played and sends every state the other player hasn't
+ * acknowledged yet. This packet includes:
+ * [
+ *  packet_type      (1 byte)
+ *  game net packet  (see game_net.h; states of SNAKE_NET_STATE_SIZE bytes)
+ * ]
  *
  * Return true on success.
  */
-static bool snake_handle_state_packet(GameData *game, SnakeState *state, const uint8_t *data, size_t length)
+static bool snake_packet_send_state(const GameData *game, SnakeState *state)
 {
-    size_t unpacked = 0;
-
-    const Direction other_direction = (Direction)data[unpacked];
-    ++unpacked;
-
-    uint32_t other_x_coord;
-    uint32_t other_y_coord;
-    uint32_t food_x_coord;
-    uint32_t food_y_coord;
-
-    game_util_unpack_u32(data + unpacked, &other_x_coord);
-    unpacked += sizeof(uint32_t);
-
-    game_util_unpack_u32(data + unpacked, &other_y_coord);
-    unpacked += sizeof(uint32_t);
+    uint8_t buf[SNAKE_NET_STATE_SIZE];
+    snake_net_pack_state(state, state->direction, snake_get_head_coords(state->snake), buf);
 
-    game_util_unpack_u32(data + unpacked, &food_x_coord);
-    unpacked += sizeof(uint32_t);
+    game_net_push_local(state->net, buf);
 
-    game_util_unpack_u32(data + unpacked, &food_y_coord);
-    unpacked += sizeof(uint32_t);
+    return game_packet_send_net(game, state->net, SNAKE_PACKET_STATE) == 0;
+}
 
-    Coords other_coords;
-    game_util_board_to_win_coords(other_x_coord, other_y_coord, state->x_left_bound, state->y_top_bound,
-                                  &other_coords);
-    Coords food_coords;
-    game_util_board_to_win_coords(food_x_coord, food_y_coord, state->x_left_bound, state->y_top_bound,
-                                  &food_coords);
+/*
+ * Handles a state packet and updates the game state accordingly.
+ *
+ * Return true on success.
+ */
+static bool snake_handle_state_packet(GameData *game, SnakeState *state, const uint8_t *data, size_t length)
+{
+    uint32_t first_new;
+    const int new_states = game_net_read_packet(state->net, data, length, &first_new);
 
-    if (!snake_apply_state(game, state, other_direction, &other_coords, &food_coords)) {
+    if (new_states == -1) {
         return false;
     }
 
-    return unpacked == SNAKE_PACKET_STATE_LENGTH - 1;
+    if (new_states > 0) {
+        snake_net_update_other(game, state);
+    }
+
+    return true;
 }
 
 static bool snake_handle_invite_response(const GameData *game, SnakeState *state, const uint8_t *data, size_t length)
@@ -1561,6 +1713,11 @@ static bool snake_handle_invite_response(const GameData *game, SnakeState *state
 
     memcpy(&state->food, &food_coords, sizeof(food_coords));
 
+    if (!snake_net_start(state)) {
+        game_window_notify(game, "Failed to start the snake game");
+        return false;
+    }
+
     state->status = SnakeStatusPlaying;
 
     return unpacked == SNAKE_PACKET_INVITE_RESPONSE_LENGTH - 1;
@@ -1612,7 +1769,8 @@ static void snake_cb_on_packet(GameData *game, const uint8_t *data, size_t lengt
                 break;
             }
 
-            state->send_flag = true;
+            // the host plays the first tick; the other player starts when it arrives
+            state->net_started = true;
             break;
         }
 
@@ -1622,23 +1780,13 @@ static void snake_cb_on_packet(GameData *game, const uint8_t *data, size_t lengt
                 break;
             }
 
-            if (length != SNAKE_PACKET_STATE_LENGTH) {
-                snake_handle_abort_packet(game, state);
-                fprintf(stderr, "Got invalid state packet length (%zu)\n", length);
-                break;
-            }
-
-            if (state->send_flag) {
-                fprintf(stderr, "Got multiple state packets before responding\n");
-                break;
-            }
-
             if (!snake_handle_state_packet(game, state, data + 1, length - 1)) {
-                fprintf(stderr, "Failed to handle snake packet\n");
+                snake_handle_abort_packet(game, state);
+                fprintf(stderr, "Got invalid state packet (length %zu)\n", length);
                 break;
             }
 
-            state->send_flag = true;
+            state->net_started = true;
             break;
         }
 
@@ -36,6 +36,7 @@
 #include "name_lookup.h"
 #include "prompt.h"
 #include "qr_code.h"
+#include "scheduler.h"
 #include "term_mplex.h"
 #include "toxic.h"
 #include "toxic_strings.h"
@@ -188,20 +189,19 @@ void cmd_add(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char (*arg
         snprintf(msg, sizeof(msg), "Hello, my name is %s. Care to Tox?", selfname);
     }
 
-    char id_bin[TOX_ADDRESS_SIZE] = {0};
-
     const bool is_domain = char_find(0, id, '@') != arg_length;
     const bool valid_id_size = arg_length >= TOX_ADDRESS_SIZE * 2;  // arg_length may include invite message
 
     if (is_domain) {
-        if (!name_lookup(self, toxic, id_bin, id, msg)) {
-            return;
-        }
+        /* the friend request is sent when the lookup completes */
+        name_lookup(self, toxic, id, msg);
+        return;
     } else if (!valid_id_size) {
         line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "Invalid Tox ID.");
         return;
     }
 
+    char id_bin[TOX_ADDRESS_SIZE] = {0};
     char xx[3];
     uint32_t x = 0;
 
@@ -433,8 +433,12 @@ void cmd_game(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char (*ar
         return;
     }
 
+    /* An optional second argument is passed to the game, e.g. a pattern file for life */
+    const char *game_arg = argc >= 2 ? argv[2] : NULL;
+    const size_t game_arg_length = game_arg != NULL ? strlen(game_arg) : 0;
+
     const unsigned int id = rand_not_secure();
-    const int ret = game_initialize(self, toxic, type, id, NULL, 0, true);
+    const int ret = game_initialize(self, toxic, type, id, (const uint8_t *)game_arg, game_arg_length, true);
 
     switch (ret) {
         case 0: {
@@ -452,9 +456,9 @@ void cmd_game(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char (*ar
 
         }
 
-        case -3: {
-            line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0,
-                          "Game is multiplayer only. Try the command again in the chat window of the contact you wish to play with.");
+        case -5: {
+            line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "Failed to load pattern file \"%s\"",
+                          game_arg);
             return;
         }
 
@@ -523,7 +527,7 @@ void cmd_conference(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, cha
 #endif
     }
 
-    if (init_conference_win(toxic, conferencenum, type, NULL, 0) == -1) {
+    if (init_conference_win(toxic, conferencenum, type, NULL, 0, false) == -1) {
         line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "Conference window failed to initialize.");
         tox_conference_delete(tox, conferencenum, NULL);
         return;
@@ -1021,6 +1025,51 @@ void cmd_requests(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char
     }
 }
 
+void cmd_sched(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char (*argv)[MAX_STR_SIZE])
+{
+    UNUSED_VAR(window);
+    UNUSED_VAR(argc);
+    UNUSED_VAR(argv);
+
+    if (toxic == NULL || self == NULL) {
+        return;
+    }
+
+    const Client_Config *c_config = toxic->c_config;
+
+    for (int i = 0; i < SCHED_TASK_MAX; ++i) {
+        Sched_Stats stats;
+        scheduler_get_stats((Sched_Task) i, &stats);
+
+        if (!stats.enabled) {
+            continue;
+        }
+
+        const double avg_run_ms = stats.runs > 0 ? (double) stats.total_run_us / stats.runs / 1000.0 : 0.0;
+
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 1, CYAN,
+                      "%s: %llu runs, %llu triggers, max late %.2f ms, avg run %.2f ms, max run %.2f ms",
+                      stats.name, (unsigned long long) stats.runs, (unsigned long long) stats.triggers,
+                      stats.max_late_us / 1000.0, avg_run_ms, stats.max_run_us / 1000.0);
+
+        char hist[MAX_STR_SIZE] = {0};
+        size_t len = 0;
+
+        for (int j = 0; j < SCHED_HIST_BUCKETS && len < sizeof(hist); ++j) {
+            if (stats.hist[j] == 0) {
+                continue;
+            }
+
+            len += snprintf(hist + len, sizeof(hist) - len, " %s:%llu", scheduler_hist_bucket_name(j),
+                            (unsigned long long) stats.hist[j]);
+        }
+
+        if (len > 0) {
+            line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, " %s", hist);
+        }
+    }
+}
+
 void cmd_status(WINDOW *window, ToxWindow *self, Toxic *toxic, int argc, char (*argv)[MAX_STR_SIZE])
 {
     UNUSED_VAR(window);
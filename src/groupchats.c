@@ -21,7 +21,7 @@
  */
 
 #ifndef _GNU_SOURCE
-#define _GNU_SOURCE    /* needed for strcasestr() and wcswidth() */
+#define _GNU_SOURCE    /* needed for strcasestr() */
 #endif
 
 #include <assert.h>
@@ -110,6 +110,7 @@ static const char *const group_cmd_list[] = {
     "/run",
 #endif /* PYTHON */
     "/silence",
+    "/source",
     "/status",
     "/topic",
     "/unignore",
@@ -124,6 +125,7 @@ static GroupChat groupchats[MAX_GROUPCHAT_NUM];
 
 static ToxWindow *new_group_chat(Tox *tox, uint32_t groupnumber, const char *groupname, int length);
 static void groupchat_set_group_name(ToxWindow *self, Toxic *toxic, uint32_t groupnumber);
+static void groupchat_onStubInit(ToxWindow *self, Toxic *toxic);
 static void groupchat_update_name_list(uint32_t groupnumber);
 static void groupchat_onGroupPeerJoin(ToxWindow *self, Toxic *toxic, uint32_t groupnumber, uint32_t peer_id);
 static int realloc_peer_list(uint32_t groupnumber, uint32_t n);
@@ -258,6 +260,7 @@ static void kill_groupchat_window(ToxWindow *self, Windows *windows, const Clien
         delwin(ctx->linewin);
         delwin(ctx->history);
         delwin(ctx->sidebar);
+        free_line_history(ctx);
         free(ctx->log);
         free(ctx);
     }
@@ -385,6 +388,12 @@ int init_groupchat_win(Toxic *toxic, uint32_t groupnumber, const char *groupname
 
     ToxWindow *self = new_group_chat(tox, groupnumber, groupname, length);
 
+    /* Groups restored from the profile stay stubs until they're first focused or receive traffic */
+    if (join_type == Group_Join_Type_Load) {
+        self->is_stub = true;
+        self->onStubInit = &groupchat_onStubInit;
+    }
+
     for (int i = 0; i <= max_groupchat_index; ++i) {
         if (!groupchats[i].active) {
             groupchats[i].window_id = add_window(toxic, self);
@@ -403,7 +412,10 @@ int init_groupchat_win(Toxic *toxic, uint32_t groupnumber, const char *groupname
             }
 
             set_active_window_by_id(toxic->windows, groupchats[i].window_id);
-            store_data(toxic);
+
+            if (join_type != Group_Join_Type_Load) {
+                store_data(toxic);
+            }
 
             Tox_Err_Group_Self_Query err;
             const uint32_t peer_id = tox_group_self_get_peer_id(tox, groupnumber, &err);
@@ -528,6 +540,8 @@ void set_status_all_groups(Toxic *toxic, uint8_t status)
                 continue;
             }
 
+            init_stub_window(self, toxic);
+
             Tox_Err_Group_Self_Query s_err;
             const uint32_t self_peer_id = tox_group_self_get_peer_id(toxic->tox, self->num, &s_err);
 
@@ -1441,7 +1455,10 @@ static void groupchat_set_group_name(ToxWindow *self, Toxic *toxic, uint32_t gro
 
     if (len > 0) {
         set_window_title(self, chat->group_name, len);
-        init_groupchat_log(self, toxic, groupnumber);
+
+        if (!self->is_stub) {  // stubs open their log in groupchat_onStubInit()
+            init_groupchat_log(self, toxic, groupnumber);
+        }
     }
 }
 
@@ -1968,7 +1985,7 @@ static bool groupchat_onKey(ToxWindow *self, Toxic *toxic, wint_t key, bool ltr)
 
             if (diff != -1) {
                 if (x + diff > x2 - 1) {
-                    int wlen = MAX(0, wcswidth(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
+                    int wlen = MAX(0, wcs_width(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
                     ctx->start = wlen < x2 ? 0 : wlen - x2 + 1;
                 }
             } else {
@@ -2235,7 +2252,7 @@ static void groupchat_onDraw(ToxWindow *self, Toxic *toxic)
     getyx(self->window, y, x);
     UNUSED_VAR(x);
 
-    const int new_x = ctx->start ? x2 - 1 : MAX(0, wcswidth(ctx->line, ctx->pos));
+    const int new_x = ctx->start ? x2 - 1 : MAX(0, wcs_width(ctx->line, ctx->pos));
     wmove(self->window, y, new_x);
 
     draw_window_bar(self, toxic->windows);
@@ -2275,19 +2292,50 @@ static void groupchat_onInit(ToxWindow *self, Toxic *toxic)
     ctx->sidebar = subwin(self->window, y2 - CHATBOX_HEIGHT - WINDOW_BAR_HEIGHT, SIDEBAR_WIDTH, 0, x2 - SIDEBAR_WIDTH);
     self->stb->topline = subwin(self->window, TOP_BAR_HEIGHT, x2, 0, 0);
 
-    ctx->hst = calloc(1, sizeof(struct history));
     ctx->log = calloc(1, sizeof(struct chatlog));
 
-    if (ctx->log == NULL || ctx->hst == NULL) {
+    if (ctx->log == NULL) {
         exit_toxic_err(FATALERR_MEMORY, "failed in groupchat_onInit");
     }
 
-    line_info_init(ctx->hst);
+    /* a stub window may already have a history from lines added before it was initialized */
+    if (ctx->hst == NULL) {
+        ctx->hst = calloc(1, sizeof(struct history));
+
+        if (ctx->hst == NULL) {
+            exit_toxic_err(FATALERR_MEMORY, "failed in groupchat_onInit");
+        }
+
+        line_info_init(ctx->hst);
+    }
 
     scrollok(ctx->history, 0);
     wmove(self->window, y2 - CURS_Y_OFFSET, 0);
 }
 
+/*
+ * Finishes the initialization of a group window that was restored as a stub.
+ */
+static void groupchat_onStubInit(ToxWindow *self, Toxic *toxic)
+{
+    if (toxic == NULL || self == NULL) {
+        return;
+    }
+
+    const GroupChat *chat = get_groupchat(self->num);
+
+    if (chat == NULL) {
+        return;
+    }
+
+    if (chat->group_name_length == 0) {
+        groupchat_set_group_name(self, toxic, self->num);
+        return;
+    }
+
+    init_groupchat_log(self, toxic, self->num);
+}
+
 /*
  * Sets the tab name colour of the ToxWindow associated with `public_key` to `colour`.
  *
@@ -0,0 +1,2105 @@
+/*  headless.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "headless.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include "file_transfers.h"
+#include "friendlist.h"
+#include "groupchats.h"
+#include "json_rpc.h"
+#include "misc_tools.h"
+#include "windows.h"
+
+/* A client that sends a longer line than this without a newline is disconnected */
+#define HEADLESS_MAX_LINE_SIZE (64 * 1024)
+
+/* A client that falls this many bytes behind on its output is disconnected */
+#define HEADLESS_MAX_BACKLOG (16 * 1024 * 1024)
+
+/* Events are dropped while this many bytes are waiting for the server thread */
+#define HEADLESS_MAX_EVENT_BACKLOG (4 * 1024 * 1024)
+
+#define HEADLESS_READ_SIZE (64 * 1024)
+#define HEADLESS_LOCK_POLL_USEC 200
+#define HEADLESS_MAX_READY 64
+
+/* Poller slots past the clients' */
+#define SLOT_LISTEN HEADLESS_MAX_CLIENTS
+#define SLOT_WAKE (HEADLESS_MAX_CLIENTS + 1)
+
+typedef struct Headless_Client {
+    int fd;                 /* -1 if the slot is free */
+    bool subscribed;
+    bool want_write;        /* the last write didn't go through completely */
+    Json_Rpc_Buf in;
+    Json_Rpc_Buf out;
+} Headless_Client;
+
+typedef struct Ready {
+    int slot;
+    bool readable;
+    bool writable;
+} Ready;
+
+static struct Headless {
+    Toxic *toxic;
+    pthread_t tid;
+    bool started;
+    atomic_bool stopping;
+
+    int listen_fd;
+    int wake_fds[2];
+#ifdef __linux__
+    int epoll_fd;
+#endif
+    char path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+
+    Headless_Client clients[HEADLESS_MAX_CLIENTS];
+    atomic_uint num_subscribers;
+
+    /* Only used by the server thread */
+    Json_Rpc_Buf batch;         /* the events being sent out */
+    char read_buf[HEADLESS_READ_SIZE];
+
+    /* Guarded by Winthread.lock */
+    Json_Rpc_Buf events;        /* newline-delimited events that haven't been handed to the server thread */
+    size_t event_start;         /* where the event being written began */
+    bool event_failed;
+    uint64_t events_dropped;
+} Headless = {
+    .listen_fd = -1,
+    .wake_fds = {-1, -1},
+#ifdef __linux__
+    .epoll_fd = -1,
+#endif
+};
+
+static int set_nonblocking(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags == -1) {
+        return -1;
+    }
+
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+        return -1;
+    }
+
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/*
+ * Acquires Winthread.lock. It's polled rather than waited on so that the server thread can
+ * still be stopped by a thread that holds it.
+ *
+ * Return false if the server is being stopped.
+ */
+static bool headless_lock_tox(void)
+{
+    while (pthread_mutex_trylock(&Winthread.lock) != 0) {
+        if (atomic_load(&Headless.stopping)) {
+            return false;
+        }
+
+        usleep(HEADLESS_LOCK_POLL_USEC);
+    }
+
+    return true;
+}
+
+static void headless_wake(void)
+{
+    /* If the pipe is full the server thread already has a pending wakeup */
+    if (write(Headless.wake_fds[1], "w", 1) == -1 && errno != EAGAIN) {
+        fprintf(stderr, "headless: failed to wake server thread (errno %d)\n", errno);
+    }
+}
+
+/*
+ * The poller watches the listening socket, the wakeup pipe and every client. It's epoll on
+ * Linux; elsewhere a poll() set is rebuilt from the client slots on every wait.
+ */
+#ifdef __linux__
+
+static int poller_init(void)
+{
+    Headless.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return Headless.epoll_fd == -1 ? -1 : 0;
+}
+
+static void poller_free(void)
+{
+    if (Headless.epoll_fd != -1) {
+        close(Headless.epoll_fd);
+        Headless.epoll_fd = -1;
+    }
+}
+
+static int poller_ctl(int op, int fd, int slot, bool want_write)
+{
+    struct epoll_event event = {0};
+    event.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    event.data.u32 = (uint32_t) slot;
+
+    return epoll_ctl(Headless.epoll_fd, op, fd, &event);
+}
+
+static int poller_add(int fd, int slot)
+{
+    return poller_ctl(EPOLL_CTL_ADD, fd, slot, false);
+}
+
+static void poller_set_write(int fd, int slot, bool want_write)
+{
+    poller_ctl(EPOLL_CTL_MOD, fd, slot, want_write);
+}
+
+static void poller_remove(int fd)
+{
+    epoll_ctl(Headless.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+static int poller_wait(Ready *ready, int max_ready)
+{
+    struct epoll_event events[HEADLESS_MAX_READY];
+    const int n = epoll_wait(Headless.epoll_fd, events, MIN(max_ready, HEADLESS_MAX_READY), -1);
+
+    for (int i = 0; i < n; ++i) {
+        ready[i].slot = (int) events[i].data.u32;
+        ready[i].readable = (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0;
+        ready[i].writable = (events[i].events & EPOLLOUT) != 0;
+    }
+
+    return n;
+}
+
+#else
+
+static int poller_init(void)
+{
+    return 0;
+}
+
+static void poller_free(void)
+{
+}
+
+static int poller_add(int fd, int slot)
+{
+    UNUSED_VAR(fd);
+    UNUSED_VAR(slot);
+
+    return 0;
+}
+
+static void poller_set_write(int fd, int slot, bool want_write)
+{
+    UNUSED_VAR(fd);
+    UNUSED_VAR(slot);
+    UNUSED_VAR(want_write);
+}
+
+static void poller_remove(int fd)
+{
+    UNUSED_VAR(fd);
+}
+
+static int poller_wait(Ready *ready, int max_ready)
+{
+    struct pollfd fds[HEADLESS_MAX_CLIENTS + 2];
+    int slots[HEADLESS_MAX_CLIENTS + 2];
+    nfds_t nfds = 0;
+
+    for (int i = 0; i < HEADLESS_MAX_CLIENTS; ++i) {
+        const Headless_Client *client = &Headless.clients[i];
+
+        if (client->fd != -1) {
+            fds[nfds] = (struct pollfd) {
+                client->fd, POLLIN | (client->want_write ? POLLOUT : 0), 0
+            };
+            slots[nfds++] = i;
+        }
+    }
+
+    fds[nfds] = (struct pollfd) {
+        Headless.listen_fd, POLLIN, 0
+    };
+    slots[nfds++] = SLOT_LISTEN;
+
+    fds[nfds] = (struct pollfd) {
+        Headless.wake_fds[0], POLLIN, 0
+    };
+    slots[nfds++] = SLOT_WAKE;
+
+    if (poll(fds, nfds, -1) == -1) {
+        return -1;
+    }
+
+    int n = 0;
+
+    for (nfds_t i = 0; i < nfds && n < max_ready; ++i) {
+        if (fds[i].revents == 0) {
+            continue;
+        }
+
+        ready[n].slot = slots[i];
+        ready[n].readable = (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+        ready[n].writable = (fds[i].revents & POLLOUT) != 0;
+        ++n;
+    }
+
+    return n;
+}
+
+#endif /* __linux__ */
+
+/*
+ * Events
+ *
+ * Each event is a JSON-RPC notification of the form
+ *   {"jsonrpc":"2.0","method":"event","params":{"type":"friend_message","friend":0,...}}
+ *
+ * All of these must be called with Winthread.lock held.
+ */
+
+static void event_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+static void event_printf(const char *format, ...)
+{
+    char buf[256];
+
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    if (length < 0 || (size_t) length >= sizeof(buf) || !json_rpc_buf_append(&Headless.events, buf, (size_t) length)) {
+        Headless.event_failed = true;
+    }
+}
+
+/* Returns false if the event should be skipped because nobody is listening or the queue is full. */
+static bool event_begin(const char *type)
+{
+    if (atomic_load(&Headless.num_subscribers) == 0) {
+        return false;
+    }
+
+    if (Headless.events.length >= HEADLESS_MAX_EVENT_BACKLOG) {
+        ++Headless.events_dropped;
+        return false;
+    }
+
+    Headless.event_start = Headless.events.length;
+    Headless.event_failed = false;
+
+    event_printf("{\"jsonrpc\":\"2.0\",\"method\":\"event\",\"params\":{\"type\":\"%s\"", type);
+
+    return true;
+}
+
+static void event_int(const char *key, int64_t value)
+{
+    event_printf(",\"%s\":%" PRId64, key, value);
+}
+
+static void event_bool(const char *key, bool value)
+{
+    event_printf(",\"%s\":%s", key, value ? "true" : "false");
+}
+
+static void event_string(const char *key, const char *str, size_t length)
+{
+    event_printf(",\"%s\":", key);
+
+    if (!json_rpc_buf_string(&Headless.events, str, length)) {
+        Headless.event_failed = true;
+    }
+}
+
+static void event_hex(const char *key, const uint8_t *data, size_t length)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    event_printf(",\"%s\":\"", key);
+
+    for (size_t i = 0; i < length && !Headless.event_failed; ++i) {
+        const char byte[2] = {hex[data[i] >> 4], hex[data[i] & 0xf]};
+
+        if (!json_rpc_buf_append(&Headless.events, byte, sizeof(byte))) {
+            Headless.event_failed = true;
+        }
+    }
+
+    event_printf("\"");
+}
+
+static void event_end(void)
+{
+    event_printf("}}\n");
+
+    if (Headless.event_failed) {
+        Headless.events.length = Headless.event_start;
+        ++Headless.events_dropped;
+        return;
+    }
+
+    /* The server thread takes the whole queue at once, so only the first event needs to wake it */
+    if (Headless.event_start == 0) {
+        headless_wake();
+    }
+}
+
+static const char *connection_name(Tox_Connection connection)
+{
+    switch (connection) {
+        case TOX_CONNECTION_TCP:
+            return "tcp";
+
+        case TOX_CONNECTION_UDP:
+            return "udp";
+
+        default:
+            return "none";
+    }
+}
+
+static const char *user_status_name(Tox_User_Status status)
+{
+    switch (status) {
+        case TOX_USER_STATUS_AWAY:
+            return "away";
+
+        case TOX_USER_STATUS_BUSY:
+            return "busy";
+
+        default:
+            return "online";
+    }
+}
+
+static const char *file_control_name(Tox_File_Control control)
+{
+    switch (control) {
+        case TOX_FILE_CONTROL_PAUSE:
+            return "pause";
+
+        case TOX_FILE_CONTROL_CANCEL:
+            return "cancel";
+
+        default:
+            return "resume";
+    }
+}
+
+static void event_type_string(const char *key, const char *value)
+{
+    event_printf(",\"%s\":\"%s\"", key, value);
+}
+
+static void event_file(const char *type, const FileTransfer *ft)
+{
+    if (event_begin(type)) {
+        event_int("friend", ft->friendnumber);
+        event_int("file", ft->filenumber);
+        event_end();
+    }
+}
+
+/*
+ * Tox callbacks
+ */
+
+static void headless_on_self_connection_status(Tox *tox, Tox_Connection connection, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    if (event_begin("self_connection")) {
+        event_type_string("connection", connection_name(connection));
+        event_end();
+    }
+}
+
+static void headless_on_friend_request(Tox *tox, const uint8_t *public_key, const uint8_t *data, size_t length,
+                                       void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    if (friend_is_blocked((const char *) public_key)) {
+        return;
+    }
+
+    if (event_begin("friend_request")) {
+        event_hex("public_key", public_key, TOX_PUBLIC_KEY_SIZE);
+        event_string("message", (const char *) data, length);
+        event_end();
+    }
+}
+
+static void headless_on_friend_connection_status(Tox *tox, uint32_t friendnumber, Tox_Connection connection,
+        void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    if (event_begin("friend_connection")) {
+        event_int("friend", friendnumber);
+        event_type_string("connection", connection_name(connection));
+        event_end();
+    }
+}
+
+static void headless_on_friend_name(Tox *tox, uint32_t friendnumber, const uint8_t *name, size_t length,
+                                    void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    if (event_begin("friend_name")) {
+        event_int("friend", friendnumber);
+        event_string("name", (const char *) name, length);
+        event_end();
+    }
+}
+
+static void headless_on_friend_status(Tox *tox, uint32_t friendnumber, Tox_User_Status status, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    if (event_begin("friend_status")) {
+        event_int("friend", friendnumber);
+        event_type_string("status", user_status_name(status));
+        event_end();
+    }
+}
+
+static void headless_on_friend_message(Tox *tox, uint32_t friendnumber, Tox_Message_Type type,
+                                       const uint8_t *message, size_t length, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    if (event_begin("friend_message")) {
+        event_int("friend", friendnumber);
+        event_bool("action", type == TOX_MESSAGE_TYPE_ACTION);
+        event_string("message", (const char *) message, length);
+        event_end();
+    }
+}
+
+static void headless_on_friend_read_receipt(Tox *tox, uint32_t friendnumber, uint32_t message_id, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    if (event_begin("friend_read_receipt")) {
+        event_int("friend", friendnumber);
+        event_int("message_id", message_id);
+        event_end();
+    }
+}
+
+static void headless_on_file_recv(Tox *tox, uint32_t friendnumber, uint32_t filenumber, uint32_t kind,
+                                  uint64_t file_size, const uint8_t *filename, size_t filename_length, void *userdata)
+{
+    UNUSED_VAR(userdata);
+
+    /* Avatars are only of use to the UI */
+    if (kind != TOX_FILE_KIND_DATA) {
+        tox_file_control(tox, friendnumber, filenumber, TOX_FILE_CONTROL_CANCEL, NULL);
+        return;
+    }
+
+    FileTransfer *ft = new_file_transfer(NULL, friendnumber, filenumber, FILE_TRANSFER_RECV, (uint8_t) kind);
+
+    if (ft == NULL) {
+        tox_file_control(tox, friendnumber, filenumber, TOX_FILE_CONTROL_CANCEL, NULL);
+        return;
+    }
+
+    ft->file_size = file_size;
+    copy_tox_str(ft->file_name, sizeof(ft->file_name), (const char *) filename, filename_length);
+    tox_file_get_file_id(tox, friendnumber, filenumber, ft->file_id, NULL);
+
+    if (event_begin("file_request")) {
+        event_int("friend", friendnumber);
+        event_int("file", filenumber);
+        event_string("name", (const char *) filename, filename_length);
+        event_int("size", (int64_t) file_size);
+        event_end();
+    }
+}
+
+static void headless_on_file_recv_control(Tox *tox, uint32_t friendnumber, uint32_t filenumber,
+        Tox_File_Control control, void *userdata)
+{
+    UNUSED_VAR(tox);
+
+    const Toxic *toxic = (const Toxic *) userdata;
+    FileTransfer *ft = get_file_transfer_struct(friendnumber, filenumber);
+
+    if (ft == NULL) {
+        return;
+    }
+
+    if (event_begin("file_control")) {
+        event_int("friend", friendnumber);
+        event_int("file", filenumber);
+        event_type_string("control", file_control_name(control));
+        event_end();
+    }
+
+    switch (control) {
+        case TOX_FILE_CONTROL_RESUME: {
+            if (ft->state == FILE_TRANSFER_PENDING || ft->state == FILE_TRANSFER_PAUSED) {
+                ft->state = FILE_TRANSFER_STARTED;
+            }
+
+            break;
+        }
+
+        case TOX_FILE_CONTROL_PAUSE: {
+            ft->state = FILE_TRANSFER_PAUSED;
+            break;
+        }
+
+        case TOX_FILE_CONTROL_CANCEL: {
+            close_file_transfer(NULL, toxic, ft, -1, NULL, silent);
+            break;
+        }
+    }
+}
+
+/* Cancels a transfer that failed on our end. */
+static void file_transfer_failed(const Toxic *toxic, FileTransfer *ft, const char *reason)
+{
+    if (event_begin("file_failed")) {
+        event_int("friend", ft->friendnumber);
+        event_int("file", ft->filenumber);
+        event_type_string("reason", reason);
+        event_end();
+    }
+
+    close_file_transfer(NULL, toxic, ft, TOX_FILE_CONTROL_CANCEL, NULL, silent);
+}
+
+static void headless_on_file_chunk_request(Tox *tox, uint32_t friendnumber, uint32_t filenumber, uint64_t position,
+        size_t length, void *userdata)
+{
+    const Toxic *toxic = (const Toxic *) userdata;
+    FileTransfer *ft = get_file_transfer_struct(friendnumber, filenumber);
+
+    if (ft == NULL || ft->state != FILE_TRANSFER_STARTED) {
+        return;
+    }
+
+    if (length == 0) {
+        event_file("file_sent", ft);
+        close_file_transfer(NULL, toxic, ft, -1, NULL, silent);
+        return;
+    }
+
+    if (ft->position != position) {
+        if (fseek(ft->file, (long) position, SEEK_SET) == -1) {
+            file_transfer_failed(toxic, ft, "seek");
+            return;
+        }
+
+        ft->position = position;
+    }
+
+    uint8_t *data = malloc(length);
+
+    if (data == NULL) {
+        file_transfer_failed(toxic, ft, "memory");
+        return;
+    }
+
+    if (fread(data, 1, length, ft->file) != length) {
+        free(data);
+        file_transfer_failed(toxic, ft, "read");
+        return;
+    }
+
+    Tox_Err_File_Send_Chunk err;
+    tox_file_send_chunk(tox, friendnumber, filenumber, position, data, length, &err);
+    free(data);
+
+    if (err != TOX_ERR_FILE_SEND_CHUNK_OK) {
+        fprintf(stderr, "headless: tox_file_send_chunk failed (error %d)\n", err);
+    }
+
+    ft->position += length;
+}
+
+static void headless_on_file_recv_chunk(Tox *tox, uint32_t friendnumber, uint32_t filenumber, uint64_t position,
+                                        const uint8_t *data, size_t length, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(position);
+
+    const Toxic *toxic = (const Toxic *) userdata;
+    FileTransfer *ft = get_file_transfer_struct(friendnumber, filenumber);
+
+    if (ft == NULL || ft->state != FILE_TRANSFER_STARTED) {
+        return;
+    }
+
+    if (length == 0) {
+        if (event_begin("file_received")) {
+            event_int("friend", friendnumber);
+            event_int("file", filenumber);
+            event_string("path", ft->file_path, strlen(ft->file_path));
+            event_end();
+        }
+
+        close_file_transfer(NULL, toxic, ft, -1, NULL, silent);
+        return;
+    }
+
+    if (fwrite(data, length, 1, ft->file) != 1) {
+        file_transfer_failed(toxic, ft, "write");
+        return;
+    }
+
+    ft->position += length;
+}
+
+static void headless_on_group_invite(Tox *tox, uint32_t friendnumber, const uint8_t *invite_data, size_t length,
+                                     const uint8_t *group_name, size_t group_name_length, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    if (event_begin("group_invite")) {
+        event_int("friend", friendnumber);
+        event_hex("invite", invite_data, length);
+        event_string("name", (const char *) group_name, group_name_length);
+        event_end();
+    }
+}
+
+static void headless_on_group_self_join(Tox *tox, uint32_t groupnumber, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    if (event_begin("group_self_join")) {
+        event_int("group", groupnumber);
+        event_end();
+    }
+}
+
+static void headless_on_group_join_fail(Tox *tox, uint32_t groupnumber, Tox_Group_Join_Fail type, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    if (event_begin("group_join_fail")) {
+        event_int("group", groupnumber);
+        event_int("reason", type);
+        event_end();
+    }
+}
+
+static void group_message_event(const char *type, uint32_t groupnumber, uint32_t peer_id,
+                                Tox_Message_Type message_type, const uint8_t *message, size_t length)
+{
+    if (event_begin(type)) {
+        event_int("group", groupnumber);
+        event_int("peer", peer_id);
+        event_bool("action", message_type == TOX_MESSAGE_TYPE_ACTION);
+        event_string("message", (const char *) message, length);
+        event_end();
+    }
+}
+
+static void headless_on_group_message(Tox *tox, uint32_t groupnumber, uint32_t peer_id, Tox_Message_Type type,
+                                      const uint8_t *message, size_t length, uint32_t message_id, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(message_id);
+    UNUSED_VAR(userdata);
+
+    group_message_event("group_message", groupnumber, peer_id, type, message, length);
+}
+
+static void headless_on_group_private_message(Tox *tox, uint32_t groupnumber, uint32_t peer_id,
+        Tox_Message_Type type, const uint8_t *message, size_t length, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(userdata);
+
+    group_message_event("group_private_message", groupnumber, peer_id, type, message, length);
+}
+
+static void headless_on_group_peer_join(Tox *tox, uint32_t groupnumber, uint32_t peer_id, void *userdata)
+{
+    UNUSED_VAR(userdata);
+
+    if (event_begin("group_peer_join")) {
+        char name[TOX_MAX_NAME_LENGTH + 1];
+        const size_t length = get_group_nick_truncate(tox, name, peer_id, groupnumber);
+
+        event_int("group", groupnumber);
+        event_int("peer", peer_id);
+        event_string("name", name, length);
+        event_end();
+    }
+}
+
+static void headless_on_group_peer_exit(Tox *tox, uint32_t groupnumber, uint32_t peer_id,
+                                        Tox_Group_Exit_Type exit_type, const uint8_t *name, size_t name_length,
+                                        const uint8_t *part_message, size_t length, void *userdata)
+{
+    UNUSED_VAR(tox);
+    UNUSED_VAR(exit_type);
+    UNUSED_VAR(part_message);
+    UNUSED_VAR(length);
+    UNUSED_VAR(userdata);
+
+    if (event_begin("group_peer_exit")) {
+        event_int("group", groupnumber);
+        event_int("peer", peer_id);
+        event_string("name", (const char *) name, name_length);
+        event_end();
+    }
+}
+
+void headless_init_callbacks(Tox *tox)
+{
+    tox_callback_self_connection_status(tox, headless_on_self_connection_status);
+    tox_callback_friend_request(tox, headless_on_friend_request);
+    tox_callback_friend_connection_status(tox, headless_on_friend_connection_status);
+    tox_callback_friend_name(tox, headless_on_friend_name);
+    tox_callback_friend_status(tox, headless_on_friend_status);
+    tox_callback_friend_message(tox, headless_on_friend_message);
+    tox_callback_friend_read_receipt(tox, headless_on_friend_read_receipt);
+    tox_callback_file_recv(tox, headless_on_file_recv);
+    tox_callback_file_recv_control(tox, headless_on_file_recv_control);
+    tox_callback_file_chunk_request(tox, headless_on_file_chunk_request);
+    tox_callback_file_recv_chunk(tox, headless_on_file_recv_chunk);
+    tox_callback_group_invite(tox, headless_on_group_invite);
+    tox_callback_group_self_join(tox, headless_on_group_self_join);
+    tox_callback_group_join_fail(tox, headless_on_group_join_fail);
+    tox_callback_group_message(tox, headless_on_group_message);
+    tox_callback_group_private_message(tox, headless_on_group_private_message);
+    tox_callback_group_peer_join(tox, headless_on_group_peer_join);
+    tox_callback_group_peer_exit(tox, headless_on_group_peer_exit);
+}
+
+/*
+ * Methods
+ *
+ * Each method appends its result, a JSON value, to `result`; nothing means an empty object.
+ * On failure it returns -1 and fills in `error`, and whatever it appended is discarded.
+ *
+ * Called on the server thread with Winthread.lock held.
+ */
+
+/* Returned when a Tox call fails. JSON-RPC leaves -32000 to -32099 to the server. */
+#define HEADLESS_ERROR_TOX (-32000)
+
+typedef struct Method_Error {
+    int code;
+    char message[128];
+} Method_Error;
+
+typedef int headless_method_cb(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                               Json_Rpc_Buf *result, Method_Error *error);
+
+static int method_fail(Method_Error *error, int code, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+static int method_fail(Method_Error *error, int code, const char *format, ...)
+{
+    error->code = code;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error->message, sizeof(error->message), format, args);
+    va_end(args);
+
+    return -1;
+}
+
+static int invalid_param(Method_Error *error, const char *name)
+{
+    return method_fail(error, JSON_RPC_ERROR_INVALID_PARAMS, "Missing or invalid param: %s", name);
+}
+
+static int out_of_memory(Method_Error *error)
+{
+    return method_fail(error, JSON_RPC_ERROR_INTERNAL, "Out of memory");
+}
+
+static bool param_u32(const Json_Rpc_Request *request, const char *name, uint32_t *value)
+{
+    int64_t number;
+
+    if (!json_rpc_int(request, name, &number) || number < 0 || number > UINT32_MAX) {
+        return false;
+    }
+
+    *value = (uint32_t) number;
+    return true;
+}
+
+/*
+ * Returns the string param `name` if it's no longer than `max_length` bytes, and puts its
+ * length in `length`. Empty strings are only accepted if `allow_empty` is true.
+ */
+static const char *param_text(const Json_Rpc_Request *request, const char *name, size_t max_length,
+                              bool allow_empty, size_t *length)
+{
+    const Json_Rpc_Param *param = json_rpc_param(request, name, JSON_RPC_TYPE_STRING);
+
+    if (param == NULL || param->length > max_length || (param->length == 0 && !allow_empty)) {
+        return NULL;
+    }
+
+    *length = param->length;
+    return param->string;
+}
+
+/*
+ * Decodes the hex string param `name` into `out`.
+ *
+ * Return the number of bytes decoded.
+ * Return -1 if it's missing, isn't hex or doesn't fit.
+ */
+static int param_hex(const Json_Rpc_Request *request, const char *name, uint8_t *out, size_t out_size)
+{
+    const Json_Rpc_Param *param = json_rpc_param(request, name, JSON_RPC_TYPE_STRING);
+
+    if (param == NULL || param->length % 2 != 0 || param->length / 2 > out_size) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < param->length / 2; ++i) {
+        unsigned int byte;
+
+        if (sscanf(&param->string[i * 2], "%2x", &byte) != 1) {
+            return -1;
+        }
+
+        out[i] = (uint8_t) byte;
+    }
+
+    return (int)(param->length / 2);
+}
+
+static bool param_friend(Tox *tox, const Json_Rpc_Request *request, uint32_t *friendnumber)
+{
+    return param_u32(request, "friend", friendnumber) && tox_friend_exists(tox, *friendnumber);
+}
+
+static bool append_hex(Json_Rpc_Buf *buf, const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        if (!json_rpc_buf_printf(buf, "%02X", data[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static size_t get_self_name(Tox *tox, char *name)
+{
+    const size_t length = tox_self_get_name_size(tox);
+    tox_self_get_name(tox, (uint8_t *) name);
+    name[length] = '\0';
+
+    return length;
+}
+
+static int method_bootstrap(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                            Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+    UNUSED_VAR(result);
+
+    const char *host = json_rpc_string(request, "host");
+    uint32_t port;
+    uint8_t key[TOX_PUBLIC_KEY_SIZE];
+
+    if (host == NULL) {
+        return invalid_param(error, "host");
+    }
+
+    if (!param_u32(request, "port", &port) || port == 0 || port > MAX_PORT_RANGE) {
+        return invalid_param(error, "port");
+    }
+
+    if (param_hex(request, "public_key", key, sizeof(key)) != sizeof(key)) {
+        return invalid_param(error, "public_key");
+    }
+
+    Tox_Err_Bootstrap err;
+
+    if (!tox_bootstrap(toxic->tox, host, (uint16_t) port, key, &err)) {
+        return method_fail(error, HEADLESS_ERROR_TOX, "Bootstrap failed (error %d)", err);
+    }
+
+    tox_add_tcp_relay(toxic->tox, host, (uint16_t) port, key, NULL);
+
+    return 0;
+}
+
+static int method_file_accept(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                              Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+    UNUSED_VAR(result);
+
+    uint32_t friendnumber;
+    uint32_t filenumber;
+    size_t path_length;
+
+    if (!param_friend(toxic->tox, request, &friendnumber)) {
+        return invalid_param(error, "friend");
+    }
+
+    if (!param_u32(request, "file", &filenumber)) {
+        return invalid_param(error, "file");
+    }
+
+    const char *path = param_text(request, "path", PATH_MAX, false, &path_length);
+
+    if (path == NULL) {
+        return invalid_param(error, "path");
+    }
+
+    FileTransfer *ft = get_file_transfer_struct(friendnumber, filenumber);
+
+    /* only receivers are pending without a file */
+    if (ft == NULL || ft->state != FILE_TRANSFER_PENDING || ft->file != NULL) {
+        return method_fail(error, JSON_RPC_ERROR_INVALID_PARAMS, "No pending file request");
+    }
+
+    if (file_transfer_recv_path_exists(path)) {
+        return method_fail(error, JSON_RPC_ERROR_INVALID_PARAMS, "Path is already being received to");
+    }
+
+    FILE *file = fopen(path, "wb");
+
+    if (file == NULL) {
+        return method_fail(error, JSON_RPC_ERROR_INVALID_PARAMS, "Failed to open path (errno %d)", errno);
+    }
+
+    Tox_Err_File_Control err;
+
+    if (!tox_file_control(toxic->tox, friendnumber, filenumber, TOX_FILE_CONTROL_RESUME, &err)) {
+        fclose(file);
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to accept file (error %d)", err);
+    }
+
+    ft->file = file;
+    ft->state = FILE_TRANSFER_STARTED;
+    snprintf(ft->file_path, sizeof(ft->file_path), "%s", path);
+
+    return 0;
+}
+
+static int method_file_cancel(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                              Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+    UNUSED_VAR(result);
+
+    uint32_t friendnumber;
+    uint32_t filenumber;
+
+    if (!param_friend(toxic->tox, request, &friendnumber)) {
+        return invalid_param(error, "friend");
+    }
+
+    if (!param_u32(request, "file", &filenumber)) {
+        return invalid_param(error, "file");
+    }
+
+    FileTransfer *ft = get_file_transfer_struct(friendnumber, filenumber);
+
+    if (ft == NULL) {
+        return method_fail(error, JSON_RPC_ERROR_INVALID_PARAMS, "No such file transfer");
+    }
+
+    close_file_transfer(NULL, toxic, ft, TOX_FILE_CONTROL_CANCEL, NULL, silent);
+
+    return 0;
+}
+
+static int method_file_send(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                            Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+
+    Tox *tox = toxic->tox;
+    uint32_t friendnumber;
+    size_t path_length;
+
+    if (!param_friend(tox, request, &friendnumber)) {
+        return invalid_param(error, "friend");
+    }
+
+    const char *path = param_text(request, "path", PATH_MAX, false, &path_length);
+
+    if (path == NULL) {
+        return invalid_param(error, "path");
+    }
+
+    const off_t size = file_size(path);
+    FILE *file = size > 0 ? fopen(path, "rb") : NULL;
+
+    if (file == NULL) {
+        return method_fail(error, JSON_RPC_ERROR_INVALID_PARAMS, "Can't send file: not found or empty");
+    }
+
+    char file_name[TOX_MAX_FILENAME_LENGTH];
+    const size_t name_length = get_file_name(file_name, sizeof(file_name), path);
+
+    Tox_Err_File_Send err;
+    const uint32_t filenumber = tox_file_send(tox, friendnumber, TOX_FILE_KIND_DATA, (uint64_t) size, NULL,
+                                (const uint8_t *) file_name, name_length, &err);
+
+    if (err != TOX_ERR_FILE_SEND_OK) {
+        fclose(file);
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to send file (error %d)", err);
+    }
+
+    FileTransfer *ft = new_file_transfer(NULL, friendnumber, filenumber, FILE_TRANSFER_SEND, TOX_FILE_KIND_DATA);
+
+    if (ft == NULL) {
+        tox_file_control(tox, friendnumber, filenumber, TOX_FILE_CONTROL_CANCEL, NULL);
+        fclose(file);
+        return method_fail(error, HEADLESS_ERROR_TOX, "Too many file transfers");
+    }
+
+    memcpy(ft->file_name, file_name, name_length + 1);
+    ft->file = file;
+    ft->file_size = (uint64_t) size;
+    tox_file_get_file_id(tox, friendnumber, filenumber, ft->file_id, NULL);
+
+    return json_rpc_buf_printf(result, "{\"file\":%" PRIu32 "}", filenumber) ? 0 : out_of_memory(error);
+}
+
+/* Finishes adding a friend the way the UI does. */
+static int friend_added(Toxic *toxic, uint32_t friendnumber, Json_Rpc_Buf *result, Method_Error *error)
+{
+    friendlist_onFriendAdded(NULL, toxic, friendnumber, true);
+    store_data(toxic);
+
+    return json_rpc_buf_printf(result, "{\"friend\":%" PRIu32 "}", friendnumber) ? 0 : out_of_memory(error);
+}
+
+static int method_friend_accept(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                                Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+
+    uint8_t key[TOX_PUBLIC_KEY_SIZE];
+
+    if (param_hex(request, "public_key", key, sizeof(key)) != sizeof(key)) {
+        return invalid_param(error, "public_key");
+    }
+
+    Tox_Err_Friend_Add err;
+    const uint32_t friendnumber = tox_friend_add_norequest(toxic->tox, key, &err);
+
+    if (err != TOX_ERR_FRIEND_ADD_OK) {
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to add friend (error %d)", err);
+    }
+
+    return friend_added(toxic, friendnumber, result, error);
+}
+
+static int method_friend_add(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                             Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+
+    uint8_t address[TOX_ADDRESS_SIZE];
+    char default_message[TOX_MAX_FRIEND_REQUEST_LENGTH + 1];
+    size_t length;
+
+    if (param_hex(request, "address", address, sizeof(address)) != sizeof(address)) {
+        return invalid_param(error, "address");
+    }
+
+    const char *message = param_text(request, "message", TOX_MAX_FRIEND_REQUEST_LENGTH, false, &length);
+
+    if (message == NULL) {
+        char self_name[TOX_MAX_NAME_LENGTH + 1];
+        get_self_name(toxic->tox, self_name);
+        snprintf(default_message, sizeof(default_message), "Hello, my name is %s. Care to Tox?", self_name);
+
+        message = default_message;
+        length = strlen(default_message);
+    }
+
+    Tox_Err_Friend_Add err;
+    const uint32_t friendnumber = tox_friend_add(toxic->tox, address, (const uint8_t *) message, length, &err);
+
+    if (err != TOX_ERR_FRIEND_ADD_OK) {
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to add friend (error %d)", err);
+    }
+
+    return friend_added(toxic, friendnumber, result, error);
+}
+
+static int method_friend_delete(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                                Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+    UNUSED_VAR(result);
+
+    uint32_t friendnumber;
+
+    if (!param_friend(toxic->tox, request, &friendnumber)) {
+        return invalid_param(error, "friend");
+    }
+
+    delete_friend(toxic, friendnumber);
+    store_data(toxic);
+
+    return 0;
+}
+
+static int method_friend_list(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                              Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+    UNUSED_VAR(request);
+
+    Tox *tox = toxic->tox;
+    const size_t num_friends = tox_self_get_friend_list_size(tox);
+    uint32_t *friends = malloc(MAX(num_friends, 1) * sizeof(uint32_t));
+
+    if (friends == NULL) {
+        return out_of_memory(error);
+    }
+
+    tox_self_get_friend_list(tox, friends);
+
+    bool ok = json_rpc_buf_printf(result, "{\"friends\":[");
+
+    for (size_t i = 0; i < num_friends && ok; ++i) {
+        const uint32_t friendnumber = friends[i];
+        uint8_t key[TOX_PUBLIC_KEY_SIZE] = {0};
+        char name[TOX_MAX_NAME_LENGTH];
+
+        tox_friend_get_public_key(tox, friendnumber, key, NULL);
+
+        const size_t name_length = MIN(tox_friend_get_name_size(tox, friendnumber, NULL), sizeof(name));
+        tox_friend_get_name(tox, friendnumber, (uint8_t *) name, NULL);
+
+        ok = json_rpc_buf_printf(result, "%s{\"friend\":%" PRIu32 ",\"public_key\":\"", i > 0 ? "," : "", friendnumber)
+             && append_hex(result, key, sizeof(key))
+             && json_rpc_buf_printf(result, "\",\"name\":")
+             && json_rpc_buf_string(result, name, name_length)
+             && json_rpc_buf_printf(result, ",\"connection\":\"%s\",\"status\":\"%s\"}",
+                                    connection_name(tox_friend_get_connection_status(tox, friendnumber, NULL)),
+                                    user_status_name(tox_friend_get_status(tox, friendnumber, NULL)));
+    }
+
+    free(friends);
+
+    return ok && json_rpc_buf_printf(result, "]}") ? 0 : out_of_memory(error);
+}
+
+static int method_friend_send(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                              Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+
+    uint32_t friendnumber;
+    size_t length;
+
+    if (!param_friend(toxic->tox, request, &friendnumber)) {
+        return invalid_param(error, "friend");
+    }
+
+    const char *message = param_text(request, "message", TOX_MAX_MESSAGE_LENGTH, false, &length);
+
+    if (message == NULL) {
+        return invalid_param(error, "message");
+    }
+
+    const Tox_Message_Type type = json_rpc_bool(request, "action", false) ? TOX_MESSAGE_TYPE_ACTION
+                                  : TOX_MESSAGE_TYPE_NORMAL;
+
+    Tox_Err_Friend_Send_Message err;
+    const uint32_t message_id = tox_friend_send_message(toxic->tox, friendnumber, type, (const uint8_t *) message,
+                                length, &err);
+
+    if (err != TOX_ERR_FRIEND_SEND_MESSAGE_OK) {
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to send message (error %d)", err);
+    }
+
+    return json_rpc_buf_printf(result, "{\"message_id\":%" PRIu32 "}", message_id) ? 0 : out_of_memory(error);
+}
+
+static int group_joined(uint32_t groupnumber, Json_Rpc_Buf *result, Method_Error *error)
+{
+    return json_rpc_buf_printf(result, "{\"group\":%" PRIu32 "}", groupnumber) ? 0 : out_of_memory(error);
+}
+
+static int method_group_accept(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                               Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+
+    Tox *tox = toxic->tox;
+    uint32_t friendnumber;
+    uint8_t invite[TOX_MAX_CUSTOM_PACKET_SIZE];
+    size_t password_length = 0;
+
+    if (!param_friend(tox, request, &friendnumber)) {
+        return invalid_param(error, "friend");
+    }
+
+    const int invite_length = param_hex(request, "invite", invite, sizeof(invite));
+
+    if (invite_length <= 0) {
+        return invalid_param(error, "invite");
+    }
+
+    const char *password = param_text(request, "password", TOX_GROUP_MAX_PASSWORD_SIZE, true, &password_length);
+
+    char self_name[TOX_MAX_NAME_LENGTH + 1];
+    const size_t name_length = get_self_name(tox, self_name);
+
+    Tox_Err_Group_Invite_Accept err;
+    const uint32_t groupnumber = tox_group_invite_accept(tox, friendnumber, invite, (size_t) invite_length,
+                                 (const uint8_t *) self_name, name_length,
+                                 (const uint8_t *) password, password_length, &err);
+
+    if (err != TOX_ERR_GROUP_INVITE_ACCEPT_OK) {
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to join group (error %d)", err);
+    }
+
+    return group_joined(groupnumber, result, error);
+}
+
+static int method_group_create(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                               Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+
+    Tox *tox = toxic->tox;
+    size_t length;
+    const char *name = param_text(request, "name", TOX_GROUP_MAX_GROUP_NAME_LENGTH, false, &length);
+
+    if (name == NULL) {
+        return invalid_param(error, "name");
+    }
+
+    const Tox_Group_Privacy_State privacy = json_rpc_bool(request, "private", false)
+                                            ? TOX_GROUP_PRIVACY_STATE_PRIVATE : TOX_GROUP_PRIVACY_STATE_PUBLIC;
+
+    char self_name[TOX_MAX_NAME_LENGTH + 1];
+    const size_t name_length = get_self_name(tox, self_name);
+
+    Tox_Err_Group_New err;
+    const uint32_t groupnumber = tox_group_new(tox, privacy, (const uint8_t *) name, length,
+                                 (const uint8_t *) self_name, name_length, &err);
+
+    if (err != TOX_ERR_GROUP_NEW_OK) {
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to create group (error %d)", err);
+    }
+
+    return group_joined(groupnumber, result, error);
+}
+
+static int method_group_join(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                             Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+
+    Tox *tox = toxic->tox;
+    uint8_t chat_id[TOX_GROUP_CHAT_ID_SIZE];
+    size_t password_length = 0;
+
+    if (param_hex(request, "chat_id", chat_id, sizeof(chat_id)) != sizeof(chat_id)) {
+        return invalid_param(error, "chat_id");
+    }
+
+    const char *password = param_text(request, "password", TOX_GROUP_MAX_PASSWORD_SIZE, true, &password_length);
+
+    char self_name[TOX_MAX_NAME_LENGTH + 1];
+    const size_t name_length = get_self_name(tox, self_name);
+
+    Tox_Err_Group_Join err;
+    const uint32_t groupnumber = tox_group_join(tox, chat_id, (const uint8_t *) self_name, name_length,
+                                 (const uint8_t *) password, password_length, &err);
+
+    if (err != TOX_ERR_GROUP_JOIN_OK) {
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to join group (error %d)", err);
+    }
+
+    return group_joined(groupnumber, result, error);
+}
+
+static int method_group_leave(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                              Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+    UNUSED_VAR(result);
+
+    uint32_t groupnumber;
+    size_t length = 0;
+
+    if (!param_u32(request, "group", &groupnumber)) {
+        return invalid_param(error, "group");
+    }
+
+    const char *message = param_text(request, "message", TOX_GROUP_MAX_PART_LENGTH, true, &length);
+
+    Tox_Err_Group_Leave err;
+
+    if (!tox_group_leave(toxic->tox, groupnumber, (const uint8_t *) message, length, &err)) {
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to leave group (error %d)", err);
+    }
+
+    return 0;
+}
+
+static int method_group_list(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                             Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+    UNUSED_VAR(request);
+
+    Tox *tox = toxic->tox;
+    const uint32_t num_groups = tox_group_get_number_groups(tox);
+    uint32_t found = 0;
+
+    bool ok = json_rpc_buf_printf(result, "{\"groups\":[");
+
+    /* Group numbers aren't necessarily contiguous after leaving a group */
+    for (uint32_t i = 0; i < MAX_GROUPCHAT_NUM && found < num_groups && ok; ++i) {
+        uint8_t chat_id[TOX_GROUP_CHAT_ID_SIZE];
+
+        if (!tox_group_get_chat_id(tox, i, chat_id, NULL)) {
+            continue;
+        }
+
+        char name[TOX_GROUP_MAX_GROUP_NAME_LENGTH];
+        const size_t name_length = MIN(tox_group_get_name_size(tox, i, NULL), sizeof(name));
+        tox_group_get_name(tox, i, (uint8_t *) name, NULL);
+
+        ok = json_rpc_buf_printf(result, "%s{\"group\":%" PRIu32 ",\"chat_id\":\"", found > 0 ? "," : "", i)
+             && append_hex(result, chat_id, sizeof(chat_id))
+             && json_rpc_buf_printf(result, "\",\"name\":")
+             && json_rpc_buf_string(result, name, name_length)
+             && json_rpc_buf_printf(result, ",\"connected\":%s}", tox_group_is_connected(tox, i, NULL) ? "true" : "false");
+
+        ++found;
+    }
+
+    return ok && json_rpc_buf_printf(result, "]}") ? 0 : out_of_memory(error);
+}
+
+static int method_group_send(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                             Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+
+    uint32_t groupnumber;
+    size_t length;
+
+    if (!param_u32(request, "group", &groupnumber)) {
+        return invalid_param(error, "group");
+    }
+
+    const char *message = param_text(request, "message", TOX_GROUP_MAX_MESSAGE_LENGTH, false, &length);
+
+    if (message == NULL) {
+        return invalid_param(error, "message");
+    }
+
+    const Tox_Message_Type type = json_rpc_bool(request, "action", false) ? TOX_MESSAGE_TYPE_ACTION
+                                  : TOX_MESSAGE_TYPE_NORMAL;
+
+    Tox_Err_Group_Send_Message err;
+    const uint32_t message_id = tox_group_send_message(toxic->tox, groupnumber, type, (const uint8_t *) message,
+                                length, &err);
+
+    if (err != TOX_ERR_GROUP_SEND_MESSAGE_OK) {
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to send message (error %d)", err);
+    }
+
+    return json_rpc_buf_printf(result, "{\"message_id\":%" PRIu32 "}", message_id) ? 0 : out_of_memory(error);
+}
+
+static int method_save(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                       Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+    UNUSED_VAR(request);
+    UNUSED_VAR(result);
+
+    if (store_data(toxic) != 0) {
+        return method_fail(error, JSON_RPC_ERROR_INTERNAL, "Failed to save to data file");
+    }
+
+    return 0;
+}
+
+static int method_self_info(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                            Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+    UNUSED_VAR(request);
+
+    Tox *tox = toxic->tox;
+
+    uint8_t address[TOX_ADDRESS_SIZE];
+    tox_self_get_address(tox, address);
+
+    uint8_t dht_id[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_dht_id(tox, dht_id);
+
+    char name[TOX_MAX_NAME_LENGTH + 1];
+    const size_t name_length = get_self_name(tox, name);
+
+    const bool ok = json_rpc_buf_printf(result, "{\"address\":\"")
+                    && append_hex(result, address, sizeof(address))
+                    && json_rpc_buf_printf(result, "\",\"dht_id\":\"")
+                    && append_hex(result, dht_id, sizeof(dht_id))
+                    && json_rpc_buf_printf(result, "\",\"udp_port\":%u,\"name\":", tox_self_get_udp_port(tox, NULL))
+                    && json_rpc_buf_string(result, name, name_length)
+                    && json_rpc_buf_printf(result, ",\"connection\":\"%s\"}",
+                                           connection_name(tox_self_get_connection_status(tox)));
+
+    return ok ? 0 : out_of_memory(error);
+}
+
+static int method_self_set_name(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                                Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(client);
+    UNUSED_VAR(result);
+
+    size_t length;
+    const char *name = param_text(request, "name", TOX_MAX_NAME_LENGTH, false, &length);
+
+    if (name == NULL) {
+        return invalid_param(error, "name");
+    }
+
+    Tox_Err_Set_Info err;
+
+    if (!tox_self_set_name(toxic->tox, (const uint8_t *) name, length, &err)) {
+        return method_fail(error, HEADLESS_ERROR_TOX, "Failed to set name (error %d)", err);
+    }
+
+    store_data(toxic);
+
+    return 0;
+}
+
+static int method_subscribe(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                            Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(toxic);
+    UNUSED_VAR(request);
+    UNUSED_VAR(result);
+    UNUSED_VAR(error);
+
+    if (!client->subscribed) {
+        client->subscribed = true;
+        atomic_fetch_add(&Headless.num_subscribers, 1);
+    }
+
+    return 0;
+}
+
+static int method_unsubscribe(Toxic *toxic, Headless_Client *client, const Json_Rpc_Request *request,
+                              Json_Rpc_Buf *result, Method_Error *error)
+{
+    UNUSED_VAR(toxic);
+    UNUSED_VAR(request);
+    UNUSED_VAR(result);
+    UNUSED_VAR(error);
+
+    if (client->subscribed) {
+        client->subscribed = false;
+        atomic_fetch_sub(&Headless.num_subscribers, 1);
+    }
+
+    return 0;
+}
+
+typedef struct Headless_Method {
+    const char *name;
+    headless_method_cb *cb;
+} Headless_Method;
+
+/* Sorted by name for bsearch() */
+static const Headless_Method methods[] = {
+    {"bootstrap",       method_bootstrap},
+    {"file_accept",     method_file_accept},
+    {"file_cancel",     method_file_cancel},
+    {"file_send",       method_file_send},
+    {"friend_accept",   method_friend_accept},
+    {"friend_add",      method_friend_add},
+    {"friend_delete",   method_friend_delete},
+    {"friend_list",     method_friend_list},
+    {"friend_send",     method_friend_send},
+    {"group_accept",    method_group_accept},
+    {"group_create",    method_group_create},
+    {"group_join",      method_group_join},
+    {"group_leave",     method_group_leave},
+    {"group_list",      method_group_list},
+    {"group_send",      method_group_send},
+    {"save",            method_save},
+    {"self_info",       method_self_info},
+    {"self_set_name",   method_self_set_name},
+    {"subscribe",       method_subscribe},
+    {"unsubscribe",     method_unsubscribe},
+};
+
+static int method_cmp(const void *key, const void *method)
+{
+    return strcmp((const char *) key, ((const Headless_Method *) method)->name);
+}
+
+static const Headless_Method *find_method(const char *name)
+{
+    return bsearch(name, methods, sizeof(methods) / sizeof(methods[0]), sizeof(Headless_Method), method_cmp);
+}
+
+/*
+ * Server
+ */
+
+static void client_close(Headless_Client *client)
+{
+    if (client->fd == -1) {
+        return;
+    }
+
+    poller_remove(client->fd);
+    close(client->fd);
+    client->fd = -1;
+
+    if (client->subscribed) {
+        client->subscribed = false;
+        atomic_fetch_sub(&Headless.num_subscribers, 1);
+    }
+
+    json_rpc_buf_free(&client->in);
+    json_rpc_buf_free(&client->out);
+}
+
+static void write_error(Json_Rpc_Buf *out, const Json_Rpc_Request *request, int code, const char *message)
+{
+    const size_t start = out->length;
+    bool ok;
+
+    if (request != NULL && request->has_id) {
+        ok = json_rpc_buf_printf(out, "{\"jsonrpc\":\"2.0\",\"id\":%" PRId64, request->id);
+    } else {
+        ok = json_rpc_buf_printf(out, "{\"jsonrpc\":\"2.0\",\"id\":null");
+    }
+
+    ok = ok && json_rpc_buf_printf(out, ",\"error\":{\"code\":%d,\"message\":", code)
+         && json_rpc_buf_string(out, message, strlen(message))
+         && json_rpc_buf_printf(out, "}}\n");
+
+    if (!ok) {
+        out->length = start;
+    }
+}
+
+/* Handles one request and appends the response to the client's output. */
+static void handle_request(Headless_Client *client, char *line, size_t length)
+{
+    Json_Rpc_Buf *out = &client->out;
+    Json_Rpc_Request request;
+
+    const int parse_ret = json_rpc_parse(line, length, &request);
+
+    if (parse_ret != 0) {
+        write_error(out, NULL, parse_ret, parse_ret == JSON_RPC_ERROR_PARSE ? "Parse error" : "Invalid request");
+        return;
+    }
+
+    const size_t start = out->length;
+
+    /* The result is written straight after the response's head, and removed again if the method fails */
+    if (!json_rpc_buf_printf(out, "{\"jsonrpc\":\"2.0\",\"id\":%" PRId64 ",\"result\":", request.id)) {
+        return;
+    }
+
+    const size_t result_start = out->length;
+    const Headless_Method *method = find_method(request.method);
+    Method_Error error;
+    int ret;
+
+    if (method == NULL) {
+        ret = method_fail(&error, JSON_RPC_ERROR_METHOD_NOT_FOUND, "Method not found");
+    } else {
+        ret = method->cb(Headless.toxic, client, &request, out, &error);
+    }
+
+    /* Notifications get no response */
+    if (!request.has_id) {
+        out->length = start;
+        return;
+    }
+
+    if (ret != 0) {
+        out->length = start;
+        write_error(out, &request, error.code, error.message);
+        return;
+    }
+
+    if (out->length == result_start && !json_rpc_buf_append(out, "{}", 2)) {
+        out->length = start;
+        return;
+    }
+
+    if (!json_rpc_buf_append(out, "}\n", 2)) {
+        out->length = start;
+    }
+}
+
+/*
+ * Writes as much of the client's pending output as the socket takes.
+ *
+ * Return false if the client was disconnected.
+ */
+static bool client_flush(Headless_Client *client)
+{
+    Json_Rpc_Buf *out = &client->out;
+    size_t written = 0;
+
+    while (written < out->length) {
+        const ssize_t ret = write(client->fd, out->data + written, out->length - written);
+
+        if (ret > 0) {
+            written += (size_t) ret;
+            continue;
+        }
+
+        if (ret == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+
+        client_close(client);
+        return false;
+    }
+
+    json_rpc_buf_consume(out, written);
+
+    if (out->length > HEADLESS_MAX_BACKLOG) {
+        fprintf(stderr, "headless: dropping client that isn't reading its output\n");
+        client_close(client);
+        return false;
+    }
+
+    const bool want_write = out->length > 0;
+
+    if (want_write != client->want_write) {
+        client->want_write = want_write;
+        poller_set_write(client->fd, (int)(client - Headless.clients), want_write);
+    }
+
+    return true;
+}
+
+/* Handles every complete line in the client's input, all under a single lock. */
+static void client_handle_lines(Headless_Client *client)
+{
+    Json_Rpc_Buf *in = &client->in;
+    size_t start = 0;
+    bool locked = false;
+
+    while (start < in->length) {
+        char *line = in->data + start;
+        const char *newline = memchr(line, '\n', in->length - start);
+
+        if (newline == NULL) {
+            break;
+        }
+
+        const size_t length = (size_t)(newline - line);
+
+        if (length > 0 && !(length == 1 && line[0] == '\r')) {
+            if (!locked) {
+                if (!headless_lock_tox()) {
+                    return;
+                }
+
+                locked = true;
+            }
+
+            handle_request(client, line, length);
+        }
+
+        start += length + 1;
+    }
+
+    if (locked) {
+        pthread_mutex_unlock(&Winthread.lock);
+    }
+
+    json_rpc_buf_consume(in, start);
+
+    if (in->length > HEADLESS_MAX_LINE_SIZE) {
+        write_error(&client->out, NULL, JSON_RPC_ERROR_INVALID_REQUEST, "Request too long");
+        client_flush(client);
+        client_close(client);
+    }
+}
+
+static void client_read(Headless_Client *client)
+{
+    bool eof = false;
+
+    while (true) {
+        const ssize_t ret = read(client->fd, Headless.read_buf, sizeof(Headless.read_buf));
+
+        if (ret > 0) {
+            if (!json_rpc_buf_append(&client->in, Headless.read_buf, (size_t) ret)) {
+                client_close(client);
+                return;
+            }
+
+            /* leave the rest for the next round so that one client can't starve the others */
+            if ((size_t) ret < sizeof(Headless.read_buf)) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (ret == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+
+        eof = true;
+        break;
+    }
+
+    client_handle_lines(client);
+
+    if (client->fd == -1 || !client_flush(client)) {
+        return;
+    }
+
+    if (eof) {
+        client_close(client);
+    }
+}
+
+static void headless_accept(void)
+{
+    while (true) {
+        const int fd = accept(Headless.listen_fd, NULL, NULL);
+
+        if (fd == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return;
+        }
+
+        int slot = -1;
+
+        for (int i = 0; i < HEADLESS_MAX_CLIENTS; ++i) {
+            if (Headless.clients[i].fd == -1) {
+                slot = i;
+                break;
+            }
+        }
+
+        if (slot == -1 || set_nonblocking(fd) == -1 || poller_add(fd, slot) == -1) {
+            fprintf(stderr, "headless: refusing client connection\n");
+            close(fd);
+            continue;
+        }
+
+        Headless_Client *client = &Headless.clients[slot];
+        *client = (Headless_Client) {
+            .fd = fd
+        };
+    }
+}
+
+/* Hands all queued events to the subscribed clients. */
+static void headless_send_events(void)
+{
+    char drain[64];
+
+    while (read(Headless.wake_fds[0], drain, sizeof(drain)) > 0) {
+        continue;
+    }
+
+    if (!headless_lock_tox()) {
+        return;
+    }
+
+    if (Headless.events_dropped > 0
+            && json_rpc_buf_printf(&Headless.events, "{\"jsonrpc\":\"2.0\",\"method\":\"event\",\"params\":"
+                                   "{\"type\":\"events_dropped\",\"count\":%" PRIu64 "}}\n", Headless.events_dropped)) {
+        Headless.events_dropped = 0;
+    }
+
+    /* Swap buffers so the Tox thread can carry on queueing while we write */
+    const Json_Rpc_Buf batch = Headless.events;
+    Headless.events = Headless.batch;
+    Headless.events.length = 0;
+    Headless.batch = batch;
+
+    pthread_mutex_unlock(&Winthread.lock);
+
+    if (Headless.batch.length == 0) {
+        return;
+    }
+
+    for (int i = 0; i < HEADLESS_MAX_CLIENTS; ++i) {
+        Headless_Client *client = &Headless.clients[i];
+
+        if (client->fd == -1 || !client->subscribed) {
+            continue;
+        }
+
+        if (!json_rpc_buf_append(&client->out, Headless.batch.data, Headless.batch.length)) {
+            client_close(client);
+            continue;
+        }
+
+        client_flush(client);
+    }
+
+    Headless.batch.length = 0;
+}
+
+static void *headless_thread(void *data)
+{
+    UNUSED_VAR(data);
+
+    Ready ready[HEADLESS_MAX_READY];
+
+    while (!atomic_load(&Headless.stopping)) {
+        const int num_ready = poller_wait(ready, HEADLESS_MAX_READY);
+
+        if (num_ready == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            fprintf(stderr, "headless: poll failed (errno %d)\n", errno);
+            break;
+        }
+
+        for (int i = 0; i < num_ready && !atomic_load(&Headless.stopping); ++i) {
+            const int slot = ready[i].slot;
+
+            if (slot == SLOT_LISTEN) {
+                headless_accept();
+                continue;
+            }
+
+            if (slot == SLOT_WAKE) {
+                headless_send_events();
+                continue;
+            }
+
+            Headless_Client *client = &Headless.clients[slot];
+
+            if (client->fd != -1 && ready[i].writable && !client_flush(client)) {
+                continue;
+            }
+
+            if (client->fd != -1 && ready[i].readable) {
+                client_read(client);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* Returns a listening socket bound to `path`, or -1 on failure. */
+static int headless_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    const size_t length = strlen(path);
+
+    if (length == 0 || length >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "headless: invalid socket path\n");
+        return -1;
+    }
+
+    memcpy(addr.sun_path, path, length + 1);
+
+    /* A socket nobody is listening on was left behind by an instance that didn't exit cleanly */
+    const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (probe == -1) {
+        return -1;
+    }
+
+    if (connect(probe, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+        fprintf(stderr, "headless: another instance is listening on %s\n", path);
+        close(probe);
+        return -1;
+    }
+
+    if (errno == ECONNREFUSED) {
+        unlink(path);
+    }
+
+    close(probe);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    /* The umask set in main() already keeps other users from connecting */
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 || listen(fd, SOMAXCONN) == -1
+            || set_nonblocking(fd) == -1) {
+        fprintf(stderr, "headless: failed to listen on %s (errno %d)\n", path, errno);
+        close(fd);
+        return -1;
+    }
+
+    snprintf(Headless.path, sizeof(Headless.path), "%s", path);
+
+    return fd;
+}
+
+static void headless_close_fds(void)
+{
+    poller_free();
+
+    for (int i = 0; i < 2; ++i) {
+        if (Headless.wake_fds[i] != -1) {
+            close(Headless.wake_fds[i]);
+            Headless.wake_fds[i] = -1;
+        }
+    }
+
+    if (Headless.listen_fd != -1) {
+        close(Headless.listen_fd);
+        Headless.listen_fd = -1;
+        unlink(Headless.path);
+    }
+}
+
+int headless_init(Toxic *toxic, const char *path)
+{
+    Headless.toxic = toxic;
+
+    for (int i = 0; i < HEADLESS_MAX_CLIENTS; ++i) {
+        Headless.clients[i].fd = -1;
+    }
+
+    Headless.listen_fd = headless_listen(path);
+
+    if (Headless.listen_fd == -1) {
+        return -1;
+    }
+
+    if (pipe(Headless.wake_fds) != 0) {
+        Headless.wake_fds[0] = -1;
+        Headless.wake_fds[1] = -1;
+        headless_close_fds();
+        return -1;
+    }
+
+    if (set_nonblocking(Headless.wake_fds[0]) == -1 || set_nonblocking(Headless.wake_fds[1]) == -1
+            || poller_init() == -1 || poller_add(Headless.listen_fd, SLOT_LISTEN) == -1
+            || poller_add(Headless.wake_fds[0], SLOT_WAKE) == -1) {
+        headless_close_fds();
+        return -1;
+    }
+
+    if (pthread_create(&Headless.tid, NULL, headless_thread, NULL) != 0) {
+        headless_close_fds();
+        return -2;
+    }
+
+    Headless.started = true;
+
+    return 0;
+}
+
+void headless_terminate(void)
+{
+    if (!Headless.started) {
+        return;
+    }
+
+    atomic_store(&Headless.stopping, true);
+    headless_wake();
+    pthread_join(Headless.tid, NULL);
+    Headless.started = false;
+
+    for (int i = 0; i < HEADLESS_MAX_CLIENTS; ++i) {
+        client_close(&Headless.clients[i]);
+    }
+
+    json_rpc_buf_free(&Headless.events);
+    json_rpc_buf_free(&Headless.batch);
+
+    headless_close_fds();
+}
@@ -0,0 +1,57 @@
+/*  headless.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "toxic.h"
+
+/*
+ * Headless mode runs toxic without a user interface, for bots and scripts. A JSON-RPC 2.0
+ * server on a Unix domain socket takes newline-delimited requests for friend, group and file
+ * operations, and streams Tox events to every client that subscribes to them.
+ *
+ * Requests are handled on the server's own thread, which takes Winthread.lock once for all the
+ * complete requests it has read from a client. Events are queued by the Tox callbacks and handed
+ * to the server thread in batches: the first event of a batch wakes it up, and everything queued
+ * by the time it gets the lock goes out to each subscriber in a single write.
+ */
+
+#define HEADLESS_MAX_CLIENTS 32
+
+/* Registers the Tox callbacks that produce headless events in place of the UI's callbacks. */
+void headless_init_callbacks(Tox *tox);
+
+/*
+ * Starts the server on the Unix socket at `path`. A stale socket left behind by an earlier run
+ * is replaced.
+ *
+ * Return 0 on success.
+ * Return -1 if the socket can't be created, or another instance is listening on it.
+ * Return -2 if the server thread can't be started.
+ */
+int headless_init(Toxic *toxic, const char *path);
+
+/* Stops the server, disconnects all clients and removes the socket. */
+void headless_terminate(void);
+
+#endif /* HEADLESS_H */
@@ -0,0 +1,416 @@
+/*
+ * Measures the message throughput of two headless toxic instances talking to each other over
+ * loopback. Both are started with fresh profiles, bootstrapped off each other and befriended,
+ * then the first is sent pipelined friend_send requests while the second's event stream is
+ * read. "in" is how many sends per second the first instance acknowledges, "out" how many
+ * friend_message events per second the second instance delivers.
+ *
+ * Usage: headless_bench <toxic binary> [messages]
+ */
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/* How many friend_send requests may be waiting on a response */
+constexpr long kWindow = 256;
+
+constexpr std::chrono::seconds kConnectTimeout(120);
+
+/* Returns the raw text of the string or number `key` in a flat JSON line, without the quotes. */
+std::string field(const std::string &line, const std::string &key)
+{
+    const std::string needle = "\"" + key + "\":";
+    const size_t pos = line.find(needle);
+
+    if (pos == std::string::npos) {
+        return "";
+    }
+
+    size_t start = pos + needle.size();
+
+    if (line[start] == '"') {
+        ++start;
+        return line.substr(start, line.find('"', start) - start);
+    }
+
+    return line.substr(start, line.find_first_of(",}", start) - start);
+}
+
+class Instance {
+public:
+    ~Instance()
+    {
+        if (fd_ != -1) {
+            close(fd_);
+        }
+
+        if (pid_ > 0) {
+            kill(pid_, SIGTERM);
+            waitpid(pid_, nullptr, 0);
+        }
+    }
+
+    bool start(const char *binary, const std::string &dir, const std::string &name)
+    {
+        const std::string socket_path = dir + "/" + name + ".sock";
+        const std::string profile = dir + "/" + name + ".tox";
+        const std::string config = dir + "/" + name + ".conf";
+
+        pid_ = fork();
+
+        if (pid_ == -1) {
+            return false;
+        }
+
+        if (pid_ == 0) {
+            execl(binary, binary, "--headless", socket_path.c_str(), "-f", profile.c_str(), "-c", config.c_str(),
+                  static_cast<char *>(nullptr));
+            _exit(127);
+        }
+
+        struct sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path.c_str());
+
+        /* Wait for the instance to start listening */
+        for (int i = 0; i < 200; ++i) {
+            fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+
+            if (fd_ == -1) {
+                return false;
+            }
+
+            if (connect(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0) {
+                return true;
+            }
+
+            close(fd_);
+            fd_ = -1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+
+        return false;
+    }
+
+    int fd() const
+    {
+        return fd_;
+    }
+
+    /* Queues a request and returns its id. */
+    int64_t send(const char *method, const std::string &params)
+    {
+        const int64_t id = next_id_++;
+        char head[128];
+        std::snprintf(head, sizeof(head), "{\"jsonrpc\":\"2.0\",\"id\":%" PRId64 ",\"method\":\"%s\",\"params\":", id,
+                      method);
+
+        out_ += head;
+        out_ += params.empty() ? "{}" : params;
+        out_ += "}\n";
+
+        return id;
+    }
+
+    bool flush()
+    {
+        size_t written = 0;
+
+        while (written < out_.size()) {
+            const ssize_t ret = write(fd_, out_.data() + written, out_.size() - written);
+
+            if (ret <= 0) {
+                if (ret == -1 && errno == EINTR) {
+                    continue;
+                }
+
+                return false;
+            }
+
+            written += static_cast<size_t>(ret);
+        }
+
+        out_.clear();
+        return true;
+    }
+
+    /* Reads whatever is available and splits it into lines. Return false on EOF or error. */
+    bool read_lines()
+    {
+        char buf[65536];
+        const ssize_t ret = read(fd_, buf, sizeof(buf));
+
+        if (ret <= 0) {
+            return ret == -1 && errno == EINTR;
+        }
+
+        in_.append(buf, static_cast<size_t>(ret));
+
+        size_t start = 0;
+        size_t newline;
+
+        while ((newline = in_.find('\n', start)) != std::string::npos) {
+            lines_.emplace_back(in_, start, newline - start);
+            start = newline + 1;
+        }
+
+        in_.erase(0, start);
+        return true;
+    }
+
+    bool next_line(std::string *line)
+    {
+        if (lines_.empty()) {
+            return false;
+        }
+
+        *line = std::move(lines_.front());
+        lines_.pop_front();
+        return true;
+    }
+
+    /* Sends a request and waits for its response. Events that arrive meanwhile are kept. */
+    std::string call(const char *method, const std::string &params = "")
+    {
+        const std::string id = std::to_string(send(method, params));
+
+        if (!flush()) {
+            return "";
+        }
+
+        std::deque<std::string> events;
+        std::string response;
+
+        while (response.empty()) {
+            std::string line;
+
+            while (response.empty() && next_line(&line)) {
+                if (field(line, "id") == id) {
+                    response = line;
+                } else {
+                    events.push_back(line);
+                }
+            }
+
+            if (response.empty() && !read_lines()) {
+                break;
+            }
+        }
+
+        lines_.insert(lines_.begin(), events.begin(), events.end());
+        return response;
+    }
+
+    /* Waits for an event of `type`, dropping any others. Return an empty string on timeout. */
+    std::string wait_event(const std::string &type, Clock::time_point deadline)
+    {
+        while (Clock::now() < deadline) {
+            std::string line;
+
+            while (next_line(&line)) {
+                if (field(line, "method") == "event" && field(line, "type") == type) {
+                    return line;
+                }
+            }
+
+            struct pollfd pfd = {fd_, POLLIN, 0};
+
+            if (poll(&pfd, 1, 100) > 0 && !read_lines()) {
+                break;
+            }
+        }
+
+        return "";
+    }
+
+private:
+    pid_t pid_ = -1;
+    int fd_ = -1;
+    int64_t next_id_ = 1;
+    std::string in_;
+    std::string out_;
+    std::deque<std::string> lines_;
+};
+
+bool befriend(Instance *a, Instance *b)
+{
+    const std::string a_info = a->call("self_info");
+    const std::string b_info = b->call("self_info");
+
+    if (field(a_info, "address").empty() || field(b_info, "address").empty()) {
+        std::fprintf(stderr, "self_info failed\n");
+        return false;
+    }
+
+    a->call("bootstrap", "{\"host\":\"127.0.0.1\",\"port\":" + field(b_info, "udp_port") + ",\"public_key\":\""
+            + field(b_info, "dht_id") + "\"}");
+    b->call("bootstrap", "{\"host\":\"127.0.0.1\",\"port\":" + field(a_info, "udp_port") + ",\"public_key\":\""
+            + field(a_info, "dht_id") + "\"}");
+
+    a->call("subscribe");
+    b->call("subscribe");
+
+    const std::string added = a->call("friend_add", "{\"address\":\"" + field(b_info, "address") + "\"}");
+
+    if (added.find("\"result\"") == std::string::npos) {
+        std::fprintf(stderr, "friend_add failed: %s\n", added.c_str());
+        return false;
+    }
+
+    const Clock::time_point deadline = Clock::now() + kConnectTimeout;
+    const std::string request = b->wait_event("friend_request", deadline);
+
+    if (request.empty()) {
+        std::fprintf(stderr, "no friend request arrived\n");
+        return false;
+    }
+
+    b->call("friend_accept", "{\"public_key\":\"" + field(request, "public_key") + "\"}");
+
+    while (true) {
+        const std::string connected = a->wait_event("friend_connection", deadline);
+
+        if (connected.empty()) {
+            std::fprintf(stderr, "friends didn't connect\n");
+            return false;
+        }
+
+        if (field(connected, "connection") != "none") {
+            return true;
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <toxic binary> [messages]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const long messages = argc > 2 ? std::atol(argv[2]) : 100000;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    char dir[] = "/tmp/headless_bench.XXXXXX";
+
+    if (mkdtemp(dir) == nullptr) {
+        std::perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+
+    int ret = EXIT_FAILURE;
+
+    {
+        Instance a;
+        Instance b;
+
+        if (!a.start(argv[1], dir, "a") || !b.start(argv[1], dir, "b")) {
+            std::fprintf(stderr, "failed to start toxic\n");
+        } else if (befriend(&a, &b)) {
+            const std::string send_params = "{\"friend\":0,\"message\":\"benchmark message\"}";
+
+            long acked = 0;
+            long rejected = 0;
+            long outstanding = 0;
+            long received = 0;
+            double in_seconds = 0;
+            bool failed = false;
+
+            const Clock::time_point start = Clock::now();
+            const Clock::time_point deadline = start + std::chrono::seconds(600);
+
+            while (received < messages && !failed && Clock::now() < deadline) {
+                while (outstanding < kWindow && acked + outstanding < messages) {
+                    a.send("friend_send", send_params);
+                    ++outstanding;
+                }
+
+                if (!a.flush()) {
+                    failed = true;
+                    break;
+                }
+
+                struct pollfd pfds[2] = {{a.fd(), POLLIN, 0}, {b.fd(), POLLIN, 0}};
+
+                if (poll(pfds, 2, 100) <= 0) {
+                    continue;
+                }
+
+                if ((pfds[0].revents & POLLIN) && !a.read_lines()) {
+                    failed = true;
+                }
+
+                if ((pfds[1].revents & POLLIN) && !b.read_lines()) {
+                    failed = true;
+                }
+
+                std::string line;
+
+                while (a.next_line(&line)) {
+                    if (field(line, "id").empty() || field(line, "id") == "null") {
+                        continue;
+                    }
+
+                    --outstanding;
+
+                    /* Sends that fail while Tox's send queue is full are simply sent again */
+                    if (line.find("\"result\"") != std::string::npos) {
+                        if (++acked == messages) {
+                            in_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                        }
+                    } else {
+                        ++rejected;
+                    }
+                }
+
+                while (b.next_line(&line)) {
+                    if (field(line, "type") == "friend_message") {
+                        ++received;
+                    }
+                }
+            }
+
+            const double out_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            if (in_seconds == 0) {
+                in_seconds = out_seconds;
+            }
+
+            std::printf("%ld messages: in %.0f msg/s (%ld %s retried), out %.0f msg/s (%ld received in %.3f s)\n",
+                        acked, acked / in_seconds, rejected, rejected == 1 ? "send" : "sends",
+                        received / out_seconds, received, out_seconds);
+
+            ret = received == messages ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    for (const char *name : {"a.sock", "a.tox", "a.conf", "b.sock", "b.tox", "b.conf"}) {
+        unlink((std::string(dir) + "/" + name).c_str());
+    }
+
+    rmdir(dir);
+
+    return ret;
+}
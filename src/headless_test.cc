@@ -0,0 +1,116 @@
+/*
+ * Starts toxic in headless mode, waits for it to listen and checks that SIGTERM makes it exit
+ * cleanly.
+ *
+ * Usage: headless_test <toxic binary>
+ */
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace {
+
+const char *toxic_binary = nullptr;
+
+/* Returns true once something accepts connections on the Unix socket at `path`. */
+bool wait_for_socket(const std::string &path, pid_t pid)
+{
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+
+    for (int i = 0; i < 200; ++i) {
+        if (waitpid(pid, nullptr, WNOHANG) == pid) {
+            return false;
+        }
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (fd == -1) {
+            return false;
+        }
+
+        const bool connected = connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0;
+        close(fd);
+
+        if (connected) {
+            return true;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    return false;
+}
+
+class Headless : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        char dir[] = "/tmp/headless_test.XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        dir_ = dir;
+    }
+
+    void TearDown() override
+    {
+        std::string cmd = "rm -rf '" + dir_ + "'";
+        ASSERT_EQ(std::system(cmd.c_str()), 0);
+    }
+
+    std::string dir_;
+};
+
+TEST_F(Headless, ExitsCleanlyOnSigterm)
+{
+    const std::string socket_path = dir_ + "/toxic.sock";
+    const std::string profile = dir_ + "/toxic.tox";
+    const std::string config = dir_ + "/toxic.conf";
+    const std::string nodes = dir_ + "/DHTnodes.json";
+
+    const pid_t pid = fork();
+    ASSERT_NE(pid, -1);
+
+    if (pid == 0) {
+        execl(toxic_binary, toxic_binary, "--headless", socket_path.c_str(), "-f", profile.c_str(), "-c",
+              config.c_str(), "-n", nodes.c_str(), "-o", static_cast<char *>(nullptr));
+        _exit(127);
+    }
+
+    ASSERT_TRUE(wait_for_socket(socket_path, pid));
+    ASSERT_EQ(kill(pid, SIGTERM), 0);
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status)) << "toxic was killed by signal " << WTERMSIG(status);
+    EXPECT_EQ(WEXITSTATUS(status), EXIT_SUCCESS);
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <toxic binary>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    toxic_binary = argv[1];
+
+    return RUN_ALL_TESTS();
+}
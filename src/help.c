@@ -182,6 +182,8 @@ static void help_draw_global(ToxWindow *self)
     wprintw(win, "  /connect <ip> <port> <key> : Manually connect to a DHT node\n");
     wprintw(win, "  /decline <id>              : Decline friend request\n");
     wprintw(win, "  /requests                  : List pending friend requests\n");
+    wprintw(win, "  /sched                     : Show main loop task timing statistics\n");
+    wprintw(win, "  /source <path>             : Execute each line of a file as a command\n");
     wprintw(win, "  /status <type>             : Set status (Online, Busy, Away)\n");
     wprintw(win, "  /note <msg>                : Set a personal note\n");
     wprintw(win, "  /nick <name>               : Set your global name (doesn't affect groups)\n");
@@ -191,7 +193,7 @@ static void help_draw_global(ToxWindow *self)
     wprintw(win, "  /group <name>              : Create a new group chat\n");
     wprintw(win, "  /join <chatid>             : Join a public groupchat using a Chat ID\n");
 #ifdef GAMES
-    wprintw(win, "  /game <name>               : Play a game\n");
+    wprintw(win, "  /game <name> [file]        : Play a game (life loads an RLE pattern file)\n");
 #endif /* GAMES */
 
 #ifdef QRCODE
@@ -229,6 +231,7 @@ static void help_draw_global(ToxWindow *self)
     wattroff(win, A_BOLD);
 
     wprintw(win, "  /run <path>                : Load and run the script at path\n");
+    wprintw(win, "  /plugins                   : Show plugin timing and queue statistics\n");
 #endif /* PYTHON */
 
     help_draw_bottom_menu(win);
@@ -452,14 +455,14 @@ void help_onKey(ToxWindow *self, wint_t key)
             break;
 
         case L'g':
-            height = 25;
+            height = 27;
 #ifdef VIDEO
             height += 8;
 #elif AUDIO
             height += 4;
 #endif
 #ifdef PYTHON
-            height += 2;
+            height += 3;
 #endif
 #ifdef GAMES
             height += 1;
@@ -20,10 +20,6 @@
  *
  */
 
-#ifndef _GNU_SOURCE
-#define _GNU_SOURCE    /* needed for wcwidth() */
-#endif
-
 #include "input.h"
 
 #include <wchar.h>
@@ -48,7 +44,7 @@ void input_new_char(ToxWindow *self, const Toxic *toxic, wint_t key, int x, int
         key = L'¶';
     }
 
-    int cur_len = wcwidth(key);
+    int cur_len = wchar_width(key);
 
     if (cur_len == -1) {
         sound_notify(self, toxic, notif_error, 0, NULL);
@@ -61,7 +57,7 @@ void input_new_char(ToxWindow *self, const Toxic *toxic, wint_t key, int x, int
     }
 
     if (x + cur_len >= mx_x) {
-        int s_len = wcwidth(ctx->line[ctx->start]);
+        int s_len = wchar_width(ctx->line[ctx->start]);
         ctx->start += 1 + MAX(0, cur_len - s_len);
     }
 }
@@ -76,8 +72,8 @@ static void input_backspace(ToxWindow *self, const Toxic *toxic, int x, int mx_x
         return;
     }
 
-    int cur_len = ctx->pos > 0 ? wcwidth(ctx->line[ctx->pos - 1]) : 0;
-    int s_len = ctx->start > 0 ? wcwidth(ctx->line[ctx->start - 1]) : 0;
+    int cur_len = ctx->pos > 0 ? wchar_width(ctx->line[ctx->pos - 1]) : 0;
+    int s_len = ctx->start > 0 ? wchar_width(ctx->line[ctx->start - 1]) : 0;
 
     if (ctx->start && (x >= mx_x - cur_len)) {
         ctx->start = MAX(0, ctx->start - 1 + (s_len - cur_len));
@@ -129,11 +125,11 @@ static void input_yank(ToxWindow *self, const Toxic *toxic, int x, int mx_x)
         return;
     }
 
-    int yank_cols = MAX(0, wcswidth(ctx->yank, ctx->yank_len));
+    int yank_cols = MAX(0, wcs_width(ctx->yank, ctx->yank_len));
 
     if (x + yank_cols >= mx_x) {
         int rmdr = MAX(0, (x + yank_cols) - mx_x);
-        int s_len = MAX(0, wcswidth(&ctx->line[ctx->start], rmdr));
+        int s_len = MAX(0, wcs_width(&ctx->line[ctx->start], rmdr));
         ctx->start += s_len + 1;
     }
 }
@@ -145,7 +141,7 @@ static void input_mv_end(ToxWindow *self, int mx_x)
 
     ctx->pos = ctx->len;
 
-    int wlen = MAX(0, wcswidth(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
+    int wlen = MAX(0, wcs_width(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
     ctx->start = MAX(0, 1 + (mx_x * (wlen / mx_x) - mx_x) + (wlen % mx_x));
 }
 
@@ -171,12 +167,12 @@ static void input_mv_left(ToxWindow *self, int x, int mx_x)
         return;
     }
 
-    int cur_len = ctx->pos > 0 ? wcwidth(ctx->line[ctx->pos - 1]) : 0;
+    int cur_len = ctx->pos > 0 ? wchar_width(ctx->line[ctx->pos - 1]) : 0;
 
     --ctx->pos;
 
     if (ctx->start > 0 && (x >= mx_x - cur_len)) {
-        int s_len = wcwidth(ctx->line[ctx->start - 1]);
+        int s_len = wchar_width(ctx->line[ctx->start - 1]);
         ctx->start = MAX(0, ctx->start - 1 + (s_len - cur_len));
     } else if (ctx->start > 0) {
         ctx->start = MAX(0, ctx->start - cur_len);
@@ -196,11 +192,11 @@ static void input_skip_left(ToxWindow *self, int x, int mx_x)
 
     do {
         --ctx->pos;
-        count += wcwidth(ctx->line[ctx->pos]);
+        count += wchar_width(ctx->line[ctx->pos]);
     } while (ctx->pos > 0 && (ctx->line[ctx->pos - 1] != L' ' || ctx->line[ctx->pos] == L' '));
 
     if (ctx->start > 0 && (x >= mx_x - count)) {
-        int s_len = wcwidth(ctx->line[ctx->start - 1]);
+        int s_len = wchar_width(ctx->line[ctx->start - 1]);
         ctx->start = MAX(0, ctx->start - 1 + (s_len - count));
     } else if (ctx->start > 0) {
         ctx->start = MAX(0, ctx->start - count);
@@ -218,10 +214,10 @@ static void input_mv_right(ToxWindow *self, int x, int mx_x)
 
     ++ctx->pos;
 
-    int cur_len = wcwidth(ctx->line[ctx->pos - 1]);
+    int cur_len = wchar_width(ctx->line[ctx->pos - 1]);
 
     if (x + cur_len >= mx_x) {
-        int s_len = wcwidth(ctx->line[ctx->start]);
+        int s_len = wchar_width(ctx->line[ctx->start]);
         ctx->start += 1 + MAX(0, cur_len - s_len);
     }
 }
@@ -238,7 +234,7 @@ static void input_skip_right(ToxWindow *self, int x, int mx_x)
     int count = 0;
 
     do {
-        count += wcwidth(ctx->line[ctx->pos]);
+        count += wchar_width(ctx->line[ctx->pos]);
         ++ctx->pos;
     } while (ctx->pos < ctx->len && !(ctx->line[ctx->pos] == L' ' && ctx->line[ctx->pos - 1] != L' '));
 
@@ -255,7 +251,7 @@ static void input_history(ToxWindow *self, const Client_Config *c_config, wint_t
     ChatContext *ctx = self->chatwin;
 
     fetch_hist_item(c_config, ctx, key);
-    int wlen = MAX(0, wcswidth(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
+    int wlen = MAX(0, wcs_width(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
     ctx->start = wlen < mx_x ? 0 : wlen - mx_x + 1;
 }
 
@@ -0,0 +1,799 @@
+/*  json_rpc.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "json_rpc.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* How deeply nested the values of members we don't know about may be */
+#define MAX_SKIP_DEPTH 32
+
+typedef struct Parser {
+    char *pos;
+    char *end;
+} Parser;
+
+static void skip_whitespace(Parser *p)
+{
+    while (p->pos < p->end && (*p->pos == ' ' || *p->pos == '\t' || *p->pos == '\r' || *p->pos == '\n')) {
+        ++p->pos;
+    }
+}
+
+/* Skips whitespace, then `c` if it's next. Returns true if `c` was skipped. */
+static bool consume(Parser *p, char c)
+{
+    skip_whitespace(p);
+
+    if (p->pos < p->end && *p->pos == c) {
+        ++p->pos;
+        return true;
+    }
+
+    return false;
+}
+
+static bool peek(Parser *p, char *c)
+{
+    skip_whitespace(p);
+
+    if (p->pos >= p->end) {
+        return false;
+    }
+
+    *c = *p->pos;
+    return true;
+}
+
+static bool consume_literal(Parser *p, const char *literal)
+{
+    const size_t length = strlen(literal);
+
+    if ((size_t)(p->end - p->pos) < length || memcmp(p->pos, literal, length) != 0) {
+        return false;
+    }
+
+    p->pos += length;
+    return true;
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static bool read_hex4(const char *s, const char *end, uint32_t *value)
+{
+    if (end - s < 4) {
+        return false;
+    }
+
+    *value = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        const int digit = hex_digit(s[i]);
+
+        if (digit < 0) {
+            return false;
+        }
+
+        *value = (*value << 4) | (uint32_t) digit;
+    }
+
+    return true;
+}
+
+static char *put_utf8(char *out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        *out++ = (char) cp;
+    } else if (cp < 0x800) {
+        *out++ = (char)(0xc0 | (cp >> 6));
+        *out++ = (char)(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        *out++ = (char)(0xe0 | (cp >> 12));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+        *out++ = (char)(0x80 | (cp & 0x3f));
+    } else {
+        *out++ = (char)(0xf0 | (cp >> 18));
+        *out++ = (char)(0x80 | ((cp >> 12) & 0x3f));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+        *out++ = (char)(0x80 | (cp & 0x3f));
+    }
+
+    return out;
+}
+
+/* Returns the length of the well-formed UTF-8 sequence at the start of the `length` byte
+ * string `s`, or 0 if it doesn't start with one. Overlong forms and surrogates are rejected. */
+static size_t utf8_sequence_length(const unsigned char *s, size_t length)
+{
+    size_t seq_length;
+    unsigned char min = 0x80;
+    unsigned char max = 0xbf;
+
+    if (s[0] >= 0xc2 && s[0] <= 0xdf) {
+        seq_length = 2;
+    } else if (s[0] >= 0xe0 && s[0] <= 0xef) {
+        seq_length = 3;
+        min = s[0] == 0xe0 ? 0xa0 : 0x80;
+        max = s[0] == 0xed ? 0x9f : 0xbf;
+    } else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+        seq_length = 4;
+        min = s[0] == 0xf0 ? 0x90 : 0x80;
+        max = s[0] == 0xf4 ? 0x8f : 0xbf;
+    } else {
+        return 0;
+    }
+
+    if (length < seq_length || s[1] < min || s[1] > max) {
+        return 0;
+    }
+
+    for (size_t i = 2; i < seq_length; ++i) {
+        if ((s[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+
+    return seq_length;
+}
+
+/*
+ * Unescapes the string at the current position in place and null terminates it. An escape
+ * sequence is never shorter than what it decodes to, so the output never overtakes the input.
+ */
+static int parse_string(Parser *p, const char **string, size_t *length)
+{
+    if (!consume(p, '"')) {
+        return JSON_RPC_ERROR_PARSE;
+    }
+
+    char *in = p->pos;
+    char *out = p->pos;
+    char *const start = out;
+
+    while (true) {
+        if (in >= p->end) {
+            return JSON_RPC_ERROR_PARSE;
+        }
+
+        const unsigned char c = (unsigned char) *in;
+
+        if (c == '"') {
+            break;
+        }
+
+        if (c < 0x20) {
+            return JSON_RPC_ERROR_PARSE;
+        }
+
+        if (c != '\\') {
+            *out++ = *in++;
+            continue;
+        }
+
+        if (++in >= p->end) {
+            return JSON_RPC_ERROR_PARSE;
+        }
+
+        switch (*in++) {
+            case '"':
+                *out++ = '"';
+                break;
+
+            case '\\':
+                *out++ = '\\';
+                break;
+
+            case '/':
+                *out++ = '/';
+                break;
+
+            case 'b':
+                *out++ = '\b';
+                break;
+
+            case 'f':
+                *out++ = '\f';
+                break;
+
+            case 'n':
+                *out++ = '\n';
+                break;
+
+            case 'r':
+                *out++ = '\r';
+                break;
+
+            case 't':
+                *out++ = '\t';
+                break;
+
+            case 'u': {
+                uint32_t cp;
+
+                if (!read_hex4(in, p->end, &cp)) {
+                    return JSON_RPC_ERROR_PARSE;
+                }
+
+                in += 4;
+
+                if (cp >= 0xd800 && cp <= 0xdbff) {
+                    uint32_t low;
+
+                    if (p->end - in < 6 || in[0] != '\\' || in[1] != 'u' || !read_hex4(in + 2, p->end, &low)
+                            || low < 0xdc00 || low > 0xdfff) {
+                        return JSON_RPC_ERROR_PARSE;
+                    }
+
+                    in += 6;
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                } else if (cp >= 0xdc00 && cp <= 0xdfff) {
+                    return JSON_RPC_ERROR_PARSE;
+                }
+
+                /* valid JSON, but it can't be passed on as a C string */
+                if (cp == 0) {
+                    return JSON_RPC_ERROR_INVALID_REQUEST;
+                }
+
+                out = put_utf8(out, cp);
+                break;
+            }
+
+            default:
+                return JSON_RPC_ERROR_PARSE;
+        }
+    }
+
+    p->pos = in + 1;
+    *out = '\0';
+
+    *string = start;
+    *length = (size_t)(out - start);
+
+    return 0;
+}
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static int parse_int(Parser *p, int64_t *value)
+{
+    skip_whitespace(p);
+
+    char *s = p->pos;
+    const bool negative = s < p->end && *s == '-';
+
+    if (negative) {
+        ++s;
+    }
+
+    if (s >= p->end || !is_digit(*s)) {
+        return JSON_RPC_ERROR_PARSE;
+    }
+
+    uint64_t magnitude = 0;
+    const uint64_t limit = negative ? (uint64_t) INT64_MAX + 1 : (uint64_t) INT64_MAX;
+
+    while (s < p->end && is_digit(*s)) {
+        const uint64_t digit = (uint64_t)(*s - '0');
+
+        if (magnitude > (limit - digit) / 10) {
+            return JSON_RPC_ERROR_INVALID_REQUEST;
+        }
+
+        magnitude = magnitude * 10 + digit;
+        ++s;
+    }
+
+    if (s < p->end && (*s == '.' || *s == 'e' || *s == 'E')) {
+        return JSON_RPC_ERROR_INVALID_REQUEST;
+    }
+
+    p->pos = s;
+
+    if (negative) {
+        *value = magnitude == (uint64_t) INT64_MAX + 1 ? INT64_MIN : -(int64_t) magnitude;
+    } else {
+        *value = (int64_t) magnitude;
+    }
+
+    return 0;
+}
+
+static int skip_value(Parser *p, int depth);
+
+static int skip_members(Parser *p, int depth, char close, bool keys)
+{
+    if (consume(p, close)) {
+        return 0;
+    }
+
+    while (true) {
+        if (keys) {
+            const char *key;
+            size_t length;
+            const int ret = parse_string(p, &key, &length);
+
+            if (ret != 0) {
+                return ret;
+            }
+
+            if (!consume(p, ':')) {
+                return JSON_RPC_ERROR_PARSE;
+            }
+        }
+
+        const int ret = skip_value(p, depth + 1);
+
+        if (ret != 0) {
+            return ret;
+        }
+
+        if (consume(p, close)) {
+            return 0;
+        }
+
+        if (!consume(p, ',')) {
+            return JSON_RPC_ERROR_PARSE;
+        }
+    }
+}
+
+static int skip_value(Parser *p, int depth)
+{
+    if (depth > MAX_SKIP_DEPTH) {
+        return JSON_RPC_ERROR_INVALID_REQUEST;
+    }
+
+    char c;
+
+    if (!peek(p, &c)) {
+        return JSON_RPC_ERROR_PARSE;
+    }
+
+    switch (c) {
+        case '"': {
+            const char *string;
+            size_t length;
+            return parse_string(p, &string, &length);
+        }
+
+        case '{':
+            ++p->pos;
+            return skip_members(p, depth, '}', true);
+
+        case '[':
+            ++p->pos;
+            return skip_members(p, depth, ']', false);
+
+        case 't':
+            return consume_literal(p, "true") ? 0 : JSON_RPC_ERROR_PARSE;
+
+        case 'f':
+            return consume_literal(p, "false") ? 0 : JSON_RPC_ERROR_PARSE;
+
+        case 'n':
+            return consume_literal(p, "null") ? 0 : JSON_RPC_ERROR_PARSE;
+
+        default:
+            break;
+    }
+
+    const char *start = p->pos;
+
+    while (p->pos < p->end && (is_digit(*p->pos) || strchr("+-.eE", *p->pos) != NULL)) {
+        ++p->pos;
+    }
+
+    return p->pos > start ? 0 : JSON_RPC_ERROR_PARSE;
+}
+
+static int parse_param(Parser *p, Json_Rpc_Param *param)
+{
+    char c;
+
+    if (!peek(p, &c)) {
+        return JSON_RPC_ERROR_PARSE;
+    }
+
+    switch (c) {
+        case '"':
+            param->type = JSON_RPC_TYPE_STRING;
+            return parse_string(p, &param->string, &param->length);
+
+        case 't':
+        case 'f':
+            param->type = JSON_RPC_TYPE_BOOL;
+            param->number = c == 't';
+            return consume_literal(p, c == 't' ? "true" : "false") ? 0 : JSON_RPC_ERROR_PARSE;
+
+        case 'n':
+            param->type = JSON_RPC_TYPE_NULL;
+            return consume_literal(p, "null") ? 0 : JSON_RPC_ERROR_PARSE;
+
+        case '{':
+        case '[':
+            return JSON_RPC_ERROR_INVALID_REQUEST;
+
+        default:
+            param->type = JSON_RPC_TYPE_INT;
+            return parse_int(p, &param->number);
+    }
+}
+
+static int parse_params(Parser *p, Json_Rpc_Request *request)
+{
+    if (consume_literal(p, "null")) {
+        return 0;
+    }
+
+    if (!consume(p, '{')) {
+        return JSON_RPC_ERROR_INVALID_REQUEST;
+    }
+
+    if (consume(p, '}')) {
+        return 0;
+    }
+
+    while (true) {
+        if (request->num_params >= JSON_RPC_MAX_PARAMS) {
+            return JSON_RPC_ERROR_INVALID_REQUEST;
+        }
+
+        Json_Rpc_Param *param = &request->params[request->num_params];
+        size_t key_length;
+        int ret = parse_string(p, &param->key, &key_length);
+
+        if (ret != 0) {
+            return ret;
+        }
+
+        if (!consume(p, ':')) {
+            return JSON_RPC_ERROR_PARSE;
+        }
+
+        ret = parse_param(p, param);
+
+        if (ret != 0) {
+            return ret;
+        }
+
+        ++request->num_params;
+
+        if (consume(p, '}')) {
+            return 0;
+        }
+
+        if (!consume(p, ',')) {
+            return JSON_RPC_ERROR_PARSE;
+        }
+    }
+}
+
+/* Skips a value that has the wrong type. Returns the error to report for it. */
+static int reject_value(Parser *p)
+{
+    const int ret = skip_value(p, 0);
+    return ret != 0 ? ret : JSON_RPC_ERROR_INVALID_REQUEST;
+}
+
+static int parse_member(Parser *p, const char *key, Json_Rpc_Request *request)
+{
+    char c;
+
+    if (!peek(p, &c)) {
+        return JSON_RPC_ERROR_PARSE;
+    }
+
+    if (strcmp(key, "id") == 0) {
+        if (consume_literal(p, "null")) {
+            request->has_id = false;
+            return 0;
+        }
+
+        /* string ids are valid JSON-RPC, but we only hand out numbers */
+        if (c != '-' && !is_digit(c)) {
+            return reject_value(p);
+        }
+
+        request->has_id = true;
+        return parse_int(p, &request->id);
+    }
+
+    if (strcmp(key, "method") == 0) {
+        if (c != '"') {
+            return reject_value(p);
+        }
+
+        size_t length;
+        return parse_string(p, &request->method, &length);
+    }
+
+    if (strcmp(key, "params") == 0) {
+        return parse_params(p, request);
+    }
+
+    return skip_value(p, 0);
+}
+
+int json_rpc_parse(char *buf, size_t length, Json_Rpc_Request *request)
+{
+    memset(request, 0, sizeof(Json_Rpc_Request));
+
+    Parser p = {buf, buf + length};
+
+    if (!consume(&p, '{')) {
+        return JSON_RPC_ERROR_PARSE;
+    }
+
+    if (!consume(&p, '}')) {
+        while (true) {
+            const char *key;
+            size_t key_length;
+            int ret = parse_string(&p, &key, &key_length);
+
+            if (ret != 0) {
+                return ret;
+            }
+
+            if (!consume(&p, ':')) {
+                return JSON_RPC_ERROR_PARSE;
+            }
+
+            ret = parse_member(&p, key, request);
+
+            if (ret != 0) {
+                return ret;
+            }
+
+            if (consume(&p, '}')) {
+                break;
+            }
+
+            if (!consume(&p, ',')) {
+                return JSON_RPC_ERROR_PARSE;
+            }
+        }
+    }
+
+    skip_whitespace(&p);
+
+    if (p.pos != p.end) {
+        return JSON_RPC_ERROR_PARSE;
+    }
+
+    if (request->method == NULL) {
+        return JSON_RPC_ERROR_INVALID_REQUEST;
+    }
+
+    return 0;
+}
+
+const Json_Rpc_Param *json_rpc_param(const Json_Rpc_Request *request, const char *key, Json_Rpc_Type type)
+{
+    for (size_t i = 0; i < request->num_params; ++i) {
+        const Json_Rpc_Param *param = &request->params[i];
+
+        if (strcmp(param->key, key) == 0) {
+            return param->type == type ? param : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+const char *json_rpc_string(const Json_Rpc_Request *request, const char *key)
+{
+    const Json_Rpc_Param *param = json_rpc_param(request, key, JSON_RPC_TYPE_STRING);
+    return param != NULL ? param->string : NULL;
+}
+
+bool json_rpc_int(const Json_Rpc_Request *request, const char *key, int64_t *value)
+{
+    const Json_Rpc_Param *param = json_rpc_param(request, key, JSON_RPC_TYPE_INT);
+
+    if (param == NULL) {
+        return false;
+    }
+
+    *value = param->number;
+    return true;
+}
+
+bool json_rpc_bool(const Json_Rpc_Request *request, const char *key, bool fallback)
+{
+    const Json_Rpc_Param *param = json_rpc_param(request, key, JSON_RPC_TYPE_BOOL);
+    return param != NULL ? param->number != 0 : fallback;
+}
+
+void json_rpc_buf_free(Json_Rpc_Buf *buf)
+{
+    free(buf->data);
+    buf->data = NULL;
+    buf->length = 0;
+    buf->capacity = 0;
+}
+
+/* Makes room for `extra` more bytes. */
+static bool buf_reserve(Json_Rpc_Buf *buf, size_t extra)
+{
+    if (buf->capacity - buf->length >= extra) {
+        return true;
+    }
+
+    size_t capacity = buf->capacity > 0 ? buf->capacity : 256;
+
+    while (capacity - buf->length < extra) {
+        if (capacity > SIZE_MAX / 2) {
+            return false;
+        }
+
+        capacity *= 2;
+    }
+
+    char *data = realloc(buf->data, capacity);
+
+    if (data == NULL) {
+        return false;
+    }
+
+    buf->data = data;
+    buf->capacity = capacity;
+
+    return true;
+}
+
+bool json_rpc_buf_append(Json_Rpc_Buf *buf, const void *data, size_t length)
+{
+    if (!buf_reserve(buf, length)) {
+        return false;
+    }
+
+    if (length > 0) {
+        memcpy(buf->data + buf->length, data, length);
+        buf->length += length;
+    }
+
+    return true;
+}
+
+bool json_rpc_buf_printf(Json_Rpc_Buf *buf, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    if (needed < 0 || !buf_reserve(buf, (size_t) needed + 1)) {
+        return false;
+    }
+
+    va_start(args, format);
+    vsnprintf(buf->data + buf->length, (size_t) needed + 1, format, args);
+    va_end(args);
+
+    buf->length += (size_t) needed;
+
+    return true;
+}
+
+bool json_rpc_buf_string(Json_Rpc_Buf *buf, const char *str, size_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    /* every byte takes at most six, as \u00XX */
+    if (length > (SIZE_MAX - 2) / 6 || !buf_reserve(buf, length * 6 + 2)) {
+        return false;
+    }
+
+    char *out = buf->data + buf->length;
+    *out++ = '"';
+
+    for (size_t i = 0; i < length; ++i) {
+        const unsigned char c = (unsigned char) str[i];
+
+        switch (c) {
+            case '"':
+            case '\\':
+                *out++ = '\\';
+                *out++ = (char) c;
+                break;
+
+            case '\n':
+                *out++ = '\\';
+                *out++ = 'n';
+                break;
+
+            case '\r':
+                *out++ = '\\';
+                *out++ = 'r';
+                break;
+
+            case '\t':
+                *out++ = '\\';
+                *out++ = 't';
+                break;
+
+            default:
+                if (c < 0x20 || c == 0x7f) {
+                    *out++ = '\\';
+                    *out++ = 'u';
+                    *out++ = '0';
+                    *out++ = '0';
+                    *out++ = hex[c >> 4];
+                    *out++ = hex[c & 0xf];
+                } else if (c < 0x80) {
+                    *out++ = (char) c;
+                } else {
+                    const size_t seq_length = utf8_sequence_length((const unsigned char *) str + i, length - i);
+
+                    if (seq_length == 0) {
+                        memcpy(out, "\\ufffd", 6);
+                        out += 6;
+                        break;
+                    }
+
+                    memcpy(out, str + i, seq_length);
+                    out += seq_length;
+                    i += seq_length - 1;
+                }
+
+                break;
+        }
+    }
+
+    *out++ = '"';
+    buf->length = (size_t)(out - buf->data);
+
+    return true;
+}
+
+void json_rpc_buf_consume(Json_Rpc_Buf *buf, size_t length)
+{
+    if (length >= buf->length) {
+        buf->length = 0;
+        return;
+    }
+
+    memmove(buf->data, buf->data + length, buf->length - length);
+    buf->length -= length;
+}
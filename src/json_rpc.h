@@ -0,0 +1,129 @@
+/*  json_rpc.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef JSON_RPC_H
+#define JSON_RPC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A minimal JSON-RPC 2.0 codec for newline-delimited requests of the form
+ *
+ *   {"jsonrpc": "2.0", "id": 1, "method": "friend_send", "params": {"friend": 0, "message": "hi"}}
+ *
+ * Params must be an object of strings, integers, booleans and nulls. Requests are parsed in
+ * place: strings are unescaped into the request buffer and point into it, so nothing is copied
+ * or allocated.
+ */
+
+#define JSON_RPC_MAX_PARAMS 8
+
+/* Error codes defined by the JSON-RPC 2.0 specification */
+typedef enum Json_Rpc_Error {
+    JSON_RPC_ERROR_PARSE            = -32700,
+    JSON_RPC_ERROR_INVALID_REQUEST  = -32600,
+    JSON_RPC_ERROR_METHOD_NOT_FOUND = -32601,
+    JSON_RPC_ERROR_INVALID_PARAMS   = -32602,
+    JSON_RPC_ERROR_INTERNAL         = -32603,
+} Json_Rpc_Error;
+
+typedef enum Json_Rpc_Type {
+    JSON_RPC_TYPE_STRING,
+    JSON_RPC_TYPE_INT,
+    JSON_RPC_TYPE_BOOL,
+    JSON_RPC_TYPE_NULL,
+} Json_Rpc_Type;
+
+typedef struct Json_Rpc_Param {
+    const char *key;
+    Json_Rpc_Type type;
+    const char *string;     /* null terminated; may contain no null bytes */
+    size_t length;
+    int64_t number;         /* 1 or 0 for booleans */
+} Json_Rpc_Param;
+
+typedef struct Json_Rpc_Request {
+    bool has_id;            /* requests without an id are notifications and get no response */
+    int64_t id;
+    const char *method;
+    Json_Rpc_Param params[JSON_RPC_MAX_PARAMS];
+    size_t num_params;
+} Json_Rpc_Request;
+
+/*
+ * Parses the request in the first `length` bytes of `buf`, which needn't be null terminated.
+ * The contents of `buf` are overwritten and `request` points into it on success.
+ *
+ * Return 0 on success.
+ * Return JSON_RPC_ERROR_PARSE if `buf` isn't valid JSON.
+ * Return JSON_RPC_ERROR_INVALID_REQUEST if it's not a request we understand.
+ */
+int json_rpc_parse(char *buf, size_t length, Json_Rpc_Request *request);
+
+/* Returns the param named `key` if it has type `type`, or NULL. */
+const Json_Rpc_Param *json_rpc_param(const Json_Rpc_Request *request, const char *key, Json_Rpc_Type type);
+
+/* Returns the string param named `key`, or NULL. */
+const char *json_rpc_string(const Json_Rpc_Request *request, const char *key);
+
+/* Puts the integer param named `key` in `value`. Returns false if there is none. */
+bool json_rpc_int(const Json_Rpc_Request *request, const char *key, int64_t *value);
+
+/* Returns the boolean param named `key`, or `fallback` if there is none. */
+bool json_rpc_bool(const Json_Rpc_Request *request, const char *key, bool fallback);
+
+/* A growable output buffer. Zero-initialize before use. */
+typedef struct Json_Rpc_Buf {
+    char *data;
+    size_t length;
+    size_t capacity;
+} Json_Rpc_Buf;
+
+void json_rpc_buf_free(Json_Rpc_Buf *buf);
+
+/* Each of these returns false and leaves `buf` unchanged if memory allocation fails. */
+bool json_rpc_buf_append(Json_Rpc_Buf *buf, const void *data, size_t length);
+
+__attribute__((format(printf, 2, 3)))
+bool json_rpc_buf_printf(Json_Rpc_Buf *buf, const char *format, ...);
+
+/*
+ * Appends `str` as a quoted JSON string. Control characters, quotes and backslashes are
+ * escaped, and bytes that aren't part of valid UTF-8 are replaced with \ufffd; everything
+ * else is copied as is.
+ */
+bool json_rpc_buf_string(Json_Rpc_Buf *buf, const char *str, size_t length);
+
+/* Removes the first `length` bytes, e.g. after they've been written to a socket. */
+void json_rpc_buf_consume(Json_Rpc_Buf *buf, size_t length);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* JSON_RPC_H */
@@ -0,0 +1,158 @@
+#include "json_rpc.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace {
+
+class JsonRpcParse : public ::testing::Test {
+protected:
+    int parse(const std::string &line)
+    {
+        buf_ = line;
+        return json_rpc_parse(&buf_[0], buf_.size(), &request_);
+    }
+
+    std::string buf_;
+    Json_Rpc_Request request_;
+};
+
+TEST_F(JsonRpcParse, ParsesRequest)
+{
+    ASSERT_EQ(parse(R"({"jsonrpc": "2.0", "id": 42, "method": "friend_send",)"
+                    R"( "params": {"friend": 3, "message": "hello", "action": true, "x": null}})"), 0);
+
+    EXPECT_TRUE(request_.has_id);
+    EXPECT_EQ(request_.id, 42);
+    EXPECT_STREQ(request_.method, "friend_send");
+    EXPECT_EQ(request_.num_params, 4u);
+
+    int64_t friend_number = -1;
+    EXPECT_TRUE(json_rpc_int(&request_, "friend", &friend_number));
+    EXPECT_EQ(friend_number, 3);
+    EXPECT_STREQ(json_rpc_string(&request_, "message"), "hello");
+    EXPECT_TRUE(json_rpc_bool(&request_, "action", false));
+    EXPECT_NE(json_rpc_param(&request_, "x", JSON_RPC_TYPE_NULL), nullptr);
+
+    // the wrong type is as good as missing
+    EXPECT_EQ(json_rpc_string(&request_, "friend"), nullptr);
+    EXPECT_FALSE(json_rpc_int(&request_, "message", &friend_number));
+    EXPECT_FALSE(json_rpc_bool(&request_, "missing", false));
+    EXPECT_TRUE(json_rpc_bool(&request_, "missing", true));
+}
+
+TEST_F(JsonRpcParse, NotificationsHaveNoId)
+{
+    ASSERT_EQ(parse(R"({"method":"subscribe"})"), 0);
+    EXPECT_FALSE(request_.has_id);
+    EXPECT_EQ(request_.num_params, 0u);
+
+    ASSERT_EQ(parse(R"({"method":"subscribe","id":null,"params":null})"), 0);
+    EXPECT_FALSE(request_.has_id);
+}
+
+TEST_F(JsonRpcParse, UnescapesStrings)
+{
+    ASSERT_EQ(parse(R"({"method":"m","params":{"s":"a\"b\\c\/d\n\t\u00e9\u20AC\ud83d\ude00"}})"), 0);
+
+    const Json_Rpc_Param *param = json_rpc_param(&request_, "s", JSON_RPC_TYPE_STRING);
+    ASSERT_NE(param, nullptr);
+    EXPECT_EQ(std::string(param->string, param->length), "a\"b\\c/d\n\t\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+    EXPECT_EQ(param->string[param->length], '\0');
+}
+
+TEST_F(JsonRpcParse, SkipsUnknownMembers)
+{
+    ASSERT_EQ(parse(R"({"extra": {"a": [1, 2.5e3, {"b": false}], "c": "}"}, "method": "m", "id": -7})"), 0);
+    EXPECT_STREQ(request_.method, "m");
+    EXPECT_EQ(request_.id, -7);
+}
+
+TEST_F(JsonRpcParse, RejectsMalformedJson)
+{
+    EXPECT_EQ(parse(""), JSON_RPC_ERROR_PARSE);
+    EXPECT_EQ(parse("[]"), JSON_RPC_ERROR_PARSE);
+    EXPECT_EQ(parse(R"({"method": "m")"), JSON_RPC_ERROR_PARSE);
+    EXPECT_EQ(parse(R"({"method": "m"} x)"), JSON_RPC_ERROR_PARSE);
+    EXPECT_EQ(parse(R"({"method" "m"})"), JSON_RPC_ERROR_PARSE);
+    EXPECT_EQ(parse(R"({"method": "m",})"), JSON_RPC_ERROR_PARSE);
+    EXPECT_EQ(parse(R"({"method": "a\qb"})"), JSON_RPC_ERROR_PARSE);
+    EXPECT_EQ(parse(R"({"method": "\ud83d"})"), JSON_RPC_ERROR_PARSE);
+    EXPECT_EQ(parse("{\"method\": \"a\nb\"}"), JSON_RPC_ERROR_PARSE);
+    EXPECT_EQ(parse(R"({"x": tru, "method": "m"})"), JSON_RPC_ERROR_PARSE);
+}
+
+TEST_F(JsonRpcParse, RejectsUnsupportedRequests)
+{
+    EXPECT_EQ(parse("{}"), JSON_RPC_ERROR_INVALID_REQUEST);
+    EXPECT_EQ(parse(R"({"method": 5})"), JSON_RPC_ERROR_INVALID_REQUEST);
+    EXPECT_EQ(parse(R"({"method": "m", "id": "abc"})"), JSON_RPC_ERROR_INVALID_REQUEST);
+    EXPECT_EQ(parse(R"({"method": "m", "id": 1.5})"), JSON_RPC_ERROR_INVALID_REQUEST);
+    EXPECT_EQ(parse(R"({"method": "m", "id": 9223372036854775808})"), JSON_RPC_ERROR_INVALID_REQUEST);
+    EXPECT_EQ(parse(R"({"method": "m", "params": [1]})"), JSON_RPC_ERROR_INVALID_REQUEST);
+    EXPECT_EQ(parse(R"({"method": "m", "params": {"a": {}}})"), JSON_RPC_ERROR_INVALID_REQUEST);
+    EXPECT_EQ(parse(R"({"method": "a\u0000b"})"), JSON_RPC_ERROR_INVALID_REQUEST);
+    EXPECT_EQ(parse(R"({"method": "m", "params": {"1":1,"2":2,"3":3,"4":4,"5":5,"6":6,"7":7,"8":8,"9":9}})"),
+              JSON_RPC_ERROR_INVALID_REQUEST);
+
+    EXPECT_EQ(parse(R"({"method": "m", "id": -9223372036854775808})"), 0);
+    EXPECT_EQ(request_.id, INT64_MIN);
+}
+
+TEST(JsonRpcBuf, EscapesStrings)
+{
+    Json_Rpc_Buf buf = {};
+    const std::string input("say \"hi\"\\\n\x01\x7f\xc3\xa9", 14);
+
+    ASSERT_TRUE(json_rpc_buf_string(&buf, input.data(), input.size()));
+    EXPECT_EQ(std::string(buf.data, buf.length), "\"say \\\"hi\\\"\\\\\\n\\u0001\\u007f\xc3\xa9\"");
+
+    // what we write, we can read back
+    std::string line = "{\"method\":" + std::string(buf.data, buf.length) + "}";
+    Json_Rpc_Request request;
+    ASSERT_EQ(json_rpc_parse(&line[0], line.size(), &request), 0);
+    EXPECT_EQ(std::string(request.method), input);
+
+    json_rpc_buf_free(&buf);
+}
+
+TEST(JsonRpcBuf, ReplacesInvalidUtf8)
+{
+    Json_Rpc_Buf buf = {};
+    // a stray continuation byte, a truncated sequence, an overlong '/', a surrogate, then valid text
+    const std::string input("a\x80" "b\xe2\x82" "c\xc0\xaf\xed\xa0\x80\xe2\x82\xac\xf0\x9f\x98\x80");
+
+    ASSERT_TRUE(json_rpc_buf_string(&buf, input.data(), input.size()));
+    EXPECT_EQ(std::string(buf.data, buf.length),
+              "\"a\\ufffdb\\ufffd\\ufffdc\\ufffd\\ufffd\\ufffd\\ufffd\\ufffd\xe2\x82\xac\xf0\x9f\x98\x80\"");
+
+    json_rpc_buf_free(&buf);
+}
+
+TEST(JsonRpcBuf, GrowsAndConsumes)
+{
+    Json_Rpc_Buf buf = {};
+
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(json_rpc_buf_printf(&buf, "%d,", i));
+    }
+
+    const std::string all(buf.data, buf.length);
+    EXPECT_EQ(all.substr(0, 6), "0,1,2,");
+    EXPECT_EQ(all.substr(all.size() - 4), "999,");
+
+    json_rpc_buf_consume(&buf, 4);
+    EXPECT_EQ(std::string(buf.data, buf.length), all.substr(4));
+
+    ASSERT_TRUE(json_rpc_buf_append(&buf, "x", 1));
+    EXPECT_EQ(buf.data[buf.length - 1], 'x');
+
+    json_rpc_buf_consume(&buf, buf.length + 1);
+    EXPECT_EQ(buf.length, 0u);
+
+    json_rpc_buf_free(&buf);
+    EXPECT_EQ(buf.data, nullptr);
+}
+
+}  // namespace
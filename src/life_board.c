@@ -0,0 +1,336 @@
+/*  life_board.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "life_board.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WORD_BITS 64
+
+/* The number of word-sized planes in a board's allocation; see life_board_new() */
+#define NUM_PLANES 6
+
+struct Life_Board {
+    int width;
+    int height;
+    int words_per_row;
+    int last_bit;           /* position of the last column's bit in the last word of a row */
+    uint64_t last_mask;     /* the bits of the last word of a row that hold cells */
+    bool wrap;
+
+    /* Each plane holds `height` rows of `words_per_row` words. Bits past the last column are always 0. */
+    uint64_t *cells;
+    uint64_t *age_lo;       /* the age of each live cell minus one, as a saturating two bit counter */
+    uint64_t *age_hi;
+    uint64_t *next_cells;
+    uint64_t *next_age_lo;
+    uint64_t *next_age_hi;
+
+    uint64_t *zero_row;     /* stands in for the rows beyond the top and bottom edges */
+};
+
+Life_Board *life_board_new(int width, int height, bool wrap)
+{
+    if (width <= 0 || height <= 0) {
+        return NULL;
+    }
+
+    Life_Board *board = calloc(1, sizeof(Life_Board));
+
+    if (board == NULL) {
+        return NULL;
+    }
+
+    board->width = width;
+    board->height = height;
+    board->words_per_row = (width + WORD_BITS - 1) / WORD_BITS;
+    board->last_bit = (width - 1) % WORD_BITS;
+    board->last_mask = board->last_bit == WORD_BITS - 1 ? UINT64_MAX : (UINT64_C(1) << (board->last_bit + 1)) - 1;
+    board->wrap = wrap;
+
+    const size_t plane_words = (size_t) board->words_per_row * (size_t) height;
+    uint64_t *words = calloc(plane_words * NUM_PLANES + (size_t) board->words_per_row, sizeof(uint64_t));
+
+    if (words == NULL) {
+        free(board);
+        return NULL;
+    }
+
+    board->cells = words;
+    board->age_lo = words + plane_words;
+    board->age_hi = words + plane_words * 2;
+    board->next_cells = words + plane_words * 3;
+    board->next_age_lo = words + plane_words * 4;
+    board->next_age_hi = words + plane_words * 5;
+    board->zero_row = words + plane_words * NUM_PLANES;
+
+    return board;
+}
+
+void life_board_free(Life_Board *board)
+{
+    if (board == NULL) {
+        return;
+    }
+
+    /* The planes are swapped every generation, so find the start of the allocation */
+    uint64_t *words = board->cells < board->next_cells ? board->cells : board->next_cells;
+
+    free(words);
+    free(board);
+}
+
+int life_board_width(const Life_Board *board)
+{
+    return board->width;
+}
+
+int life_board_height(const Life_Board *board)
+{
+    return board->height;
+}
+
+bool life_board_wraps(const Life_Board *board)
+{
+    return board->wrap;
+}
+
+void life_board_set_wrap(Life_Board *board, bool wrap)
+{
+    board->wrap = wrap;
+}
+
+void life_board_clear(Life_Board *board)
+{
+    const size_t plane_size = (size_t) board->words_per_row * (size_t) board->height * sizeof(uint64_t);
+
+    memset(board->cells, 0, plane_size);
+    memset(board->age_lo, 0, plane_size);
+    memset(board->age_hi, 0, plane_size);
+}
+
+bool life_board_get(const Life_Board *board, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= board->width || y >= board->height) {
+        return false;
+    }
+
+    const size_t idx = (size_t) y * board->words_per_row + x / WORD_BITS;
+
+    return (board->cells[idx] >> (x % WORD_BITS)) & 1;
+}
+
+void life_board_set(Life_Board *board, int x, int y, bool alive)
+{
+    if (x < 0 || y < 0 || x >= board->width || y >= board->height) {
+        return;
+    }
+
+    const size_t idx = (size_t) y * board->words_per_row + x / WORD_BITS;
+    const uint64_t bit = UINT64_C(1) << (x % WORD_BITS);
+
+    if (alive) {
+        board->cells[idx] |= bit;
+    } else {
+        board->cells[idx] &= ~bit;
+    }
+
+    board->age_lo[idx] &= ~bit;
+    board->age_hi[idx] &= ~bit;
+}
+
+/* Returns word `k` of `row` with every cell's west neighbour moved into that cell's bit. */
+static inline uint64_t west_neighbours(const Life_Board *board, const uint64_t *row, int k)
+{
+    uint64_t carry;
+
+    if (k > 0) {
+        carry = row[k - 1] >> (WORD_BITS - 1);
+    } else if (board->wrap) {
+        carry = (row[board->words_per_row - 1] >> board->last_bit) & 1;
+    } else {
+        carry = 0;
+    }
+
+    return (row[k] << 1) | carry;
+}
+
+/* Returns word `k` of `row` with every cell's east neighbour moved into that cell's bit. */
+static inline uint64_t east_neighbours(const Life_Board *board, const uint64_t *row, int k)
+{
+    uint64_t word = row[k] >> 1;
+
+    if (k < board->words_per_row - 1) {
+        word |= row[k + 1] << (WORD_BITS - 1);
+    } else if (board->wrap) {
+        word |= (row[0] & 1) << board->last_bit;
+    }
+
+    return word;
+}
+
+/* Adds three one-bit numbers in each bit position. */
+static inline void full_add(uint64_t a, uint64_t b, uint64_t c, uint64_t *sum, uint64_t *carry)
+{
+    const uint64_t t = a ^ b;
+
+    *sum = t ^ c;
+    *carry = (a & b) | (t & c);
+}
+
+static inline void half_add(uint64_t a, uint64_t b, uint64_t *sum, uint64_t *carry)
+{
+    *sum = a ^ b;
+    *carry = a & b;
+}
+
+static const uint64_t *row_at(const Life_Board *board, const uint64_t *plane, int y)
+{
+    if (y < 0 || y >= board->height) {
+        if (!board->wrap) {
+            return board->zero_row;
+        }
+
+        y = (y + board->height) % board->height;
+    }
+
+    return &plane[(size_t) y * board->words_per_row];
+}
+
+void life_board_step(Life_Board *board)
+{
+    const int words_per_row = board->words_per_row;
+
+    for (int y = 0; y < board->height; ++y) {
+        const size_t offset = (size_t) y * words_per_row;
+        const uint64_t *up = row_at(board, board->cells, y - 1);
+        const uint64_t *mid = &board->cells[offset];
+        const uint64_t *down = row_at(board, board->cells, y + 1);
+        const uint64_t *age_lo = &board->age_lo[offset];
+        const uint64_t *age_hi = &board->age_hi[offset];
+
+        uint64_t *out = &board->next_cells[offset];
+        uint64_t *out_lo = &board->next_age_lo[offset];
+        uint64_t *out_hi = &board->next_age_hi[offset];
+
+        for (int k = 0; k < words_per_row; ++k) {
+            /* Count the eight neighbours of all 64 cells at once, one bit plane per binary digit */
+            uint64_t up_sum, up_carry;
+            uint64_t down_sum, down_carry;
+            uint64_t mid_sum, mid_carry;
+
+            full_add(west_neighbours(board, up, k), up[k], east_neighbours(board, up, k), &up_sum, &up_carry);
+            full_add(west_neighbours(board, down, k), down[k], east_neighbours(board, down, k), &down_sum, &down_carry);
+            half_add(west_neighbours(board, mid, k), east_neighbours(board, mid, k), &mid_sum, &mid_carry);
+
+            uint64_t ones, twos_carry;
+            full_add(up_sum, down_sum, mid_sum, &ones, &twos_carry);
+
+            uint64_t twos_partial, fours_a;
+            full_add(up_carry, down_carry, mid_carry, &twos_partial, &fours_a);
+
+            uint64_t twos, fours_b;
+            half_add(twos_partial, twos_carry, &twos, &fours_b);
+
+            /* A cell lives with three neighbours, or with two if it's already alive */
+            const uint64_t alive = mid[k];
+            uint64_t next = twos & ~(fours_a | fours_b) & (ones | alive);
+
+            if (k == words_per_row - 1) {
+                next &= board->last_mask;
+            }
+
+            const uint64_t survivors = next & alive;
+
+            out[k] = next;
+            out_lo[k] = survivors & (~age_lo[k] | age_hi[k]);
+            out_hi[k] = survivors & (age_hi[k] | age_lo[k]);
+        }
+    }
+
+    uint64_t *tmp = board->cells;
+    board->cells = board->next_cells;
+    board->next_cells = tmp;
+
+    tmp = board->age_lo;
+    board->age_lo = board->next_age_lo;
+    board->next_age_lo = tmp;
+
+    tmp = board->age_hi;
+    board->age_hi = board->next_age_hi;
+    board->next_age_hi = tmp;
+}
+
+uint64_t life_board_population(const Life_Board *board)
+{
+    const size_t num_words = (size_t) board->words_per_row * (size_t) board->height;
+    uint64_t count = 0;
+
+    for (size_t i = 0; i < num_words; ++i) {
+        count += (uint64_t) __builtin_popcountll(board->cells[i]);
+    }
+
+    return count;
+}
+
+void life_board_for_each_live(const Life_Board *board, int x, int y, int width, int height,
+                              life_board_cell_cb *cb, void *user_data)
+{
+    const int x_start = x < 0 ? 0 : x;
+    const int y_start = y < 0 ? 0 : y;
+    const int x_end = x + width > board->width ? board->width : x + width;
+    const int y_end = y + height > board->height ? board->height : y + height;
+
+    if (x_start >= x_end || y_start >= y_end) {
+        return;
+    }
+
+    const int first_word = x_start / WORD_BITS;
+    const int last_word = (x_end - 1) / WORD_BITS;
+
+    for (int row = y_start; row < y_end; ++row) {
+        const size_t offset = (size_t) row * board->words_per_row;
+
+        for (int k = first_word; k <= last_word; ++k) {
+            uint64_t word = board->cells[offset + k];
+
+            if (k == first_word) {
+                word &= UINT64_MAX << (x_start % WORD_BITS);
+            }
+
+            if (k == last_word && (x_end % WORD_BITS) != 0) {
+                word &= (UINT64_C(1) << (x_end % WORD_BITS)) - 1;
+            }
+
+            while (word != 0) {
+                const int bit = __builtin_ctzll(word);
+                const uint64_t mask = UINT64_C(1) << bit;
+                const int age = 1 + ((board->age_lo[offset + k] & mask) != 0) + 2 * ((board->age_hi[offset + k] & mask) != 0);
+
+                cb(k * WORD_BITS + bit, row, age, user_data);
+
+                word &= word - 1;
+            }
+        }
+    }
+}
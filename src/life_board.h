@@ -0,0 +1,98 @@
+/*  life_board.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIFE_BOARD_H
+#define LIFE_BOARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A Game of Life board stored as bitboards: each row is an array of 64-bit words holding
+ * one cell per bit. A generation is computed a word at a time with bitwise adders, so 64
+ * cells are updated with a handful of instructions, into a second buffer which is then
+ * swapped with the first.
+ *
+ * The board also tracks how many generations each live cell has survived, up to
+ * LIFE_BOARD_MAX_AGE.
+ */
+typedef struct Life_Board Life_Board;
+
+/* Cells that have been alive for at least this many generations all report this age */
+#define LIFE_BOARD_MAX_AGE 4
+
+/*
+ * Called by `life_board_for_each_live()` for every live cell. `age` is 1 for a cell that
+ * was born in the last generation, up to LIFE_BOARD_MAX_AGE.
+ */
+typedef void life_board_cell_cb(int x, int y, int age, void *user_data);
+
+/*
+ * Creates an empty board of `width` by `height` cells.
+ *
+ * If `wrap` is true the board is a torus: cells on an edge are neighbours of the cells on
+ * the opposite edge. Otherwise everything beyond the edges is dead.
+ *
+ * Returns NULL on failure.
+ */
+Life_Board *life_board_new(int width, int height, bool wrap);
+
+void life_board_free(Life_Board *board);
+
+int life_board_width(const Life_Board *board);
+int life_board_height(const Life_Board *board);
+
+bool life_board_wraps(const Life_Board *board);
+void life_board_set_wrap(Life_Board *board, bool wrap);
+
+/* Kills every cell. */
+void life_board_clear(Life_Board *board);
+
+/* Returns true if the cell at `x`, `y` is alive. Coordinates outside the board are dead. */
+bool life_board_get(const Life_Board *board, int x, int y);
+
+/* Sets the state of the cell at `x`, `y`. Coordinates outside the board are ignored. */
+void life_board_set(Life_Board *board, int x, int y, bool alive);
+
+/* Advances the board by one generation. */
+void life_board_step(Life_Board *board);
+
+/* Returns the number of live cells. */
+uint64_t life_board_population(const Life_Board *board);
+
+/*
+ * Calls `cb` for every live cell in the rectangle at `x`, `y` of `width` by `height`
+ * cells, row by row. Parts of the rectangle that lie outside the board are skipped, and
+ * runs of 64 dead cells are skipped a word at a time.
+ */
+void life_board_for_each_live(const Life_Board *board, int x, int y, int width, int height,
+                              life_board_cell_cb *cb, void *user_data);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* LIFE_BOARD_H */
@@ -0,0 +1,51 @@
+/*
+ * Measures how many generations per second life_board_step() computes on a large,
+ * randomly seeded board.
+ *
+ * Usage: life_board_bench [size] [generations]
+ */
+
+#include "life_board.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+int main(int argc, char **argv)
+{
+    const int size = argc > 1 ? std::atoi(argv[1]) : 4096;
+    const int generations = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    Life_Board *board = life_board_new(size, size, true);
+
+    if (board == nullptr) {
+        std::fprintf(stderr, "failed to allocate a %dx%d board\n", size, size);
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 rng(1);
+
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            life_board_set(board, x, y, rng() % 4 == 0);
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < generations; ++i) {
+        life_board_step(board);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::printf("%dx%d board, %d generations in %.3f s: %.1f generations/s, %.2f Gcells/s (population %llu)\n",
+                size, size, generations, elapsed.count(), generations / elapsed.count(),
+                (double) size * size * generations / elapsed.count() / 1e9,
+                (unsigned long long) life_board_population(board));
+
+    life_board_free(board);
+
+    return EXIT_SUCCESS;
+}
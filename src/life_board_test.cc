@@ -0,0 +1,244 @@
+#include "life_board.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/* A straightforward cell-by-cell implementation to check the bitboard against. */
+class ReferenceBoard {
+public:
+    ReferenceBoard(int width, int height, bool wrap)
+        : width_(width)
+        , height_(height)
+        , wrap_(wrap)
+        , cells_(width * height, false)
+    {
+    }
+
+    bool get(int x, int y) const
+    {
+        if (wrap_) {
+            x = (x + width_) % width_;
+            y = (y + height_) % height_;
+        } else if (x < 0 || y < 0 || x >= width_ || y >= height_) {
+            return false;
+        }
+
+        return cells_[y * width_ + x];
+    }
+
+    void set(int x, int y, bool alive)
+    {
+        cells_[y * width_ + x] = alive;
+    }
+
+    void step()
+    {
+        std::vector<bool> next(cells_.size());
+
+        for (int y = 0; y < height_; ++y) {
+            for (int x = 0; x < width_; ++x) {
+                int count = 0;
+
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        if ((dx != 0 || dy != 0) && get(x + dx, y + dy)) {
+                            ++count;
+                        }
+                    }
+                }
+
+                next[y * width_ + x] = count == 3 || (count == 2 && get(x, y));
+            }
+        }
+
+        cells_ = std::move(next);
+    }
+
+private:
+    int width_;
+    int height_;
+    bool wrap_;
+    std::vector<bool> cells_;
+};
+
+using Cells = std::vector<std::pair<int, int>>;
+
+void set_cells(Life_Board *board, const Cells &cells)
+{
+    for (const auto &cell : cells) {
+        life_board_set(board, cell.first, cell.second, true);
+    }
+}
+
+Cells live_cells(const Life_Board *board)
+{
+    Cells cells;
+    life_board_for_each_live(board, 0, 0, life_board_width(board), life_board_height(board),
+    [](int x, int y, int age, void *user_data) {
+        (void)age;
+        static_cast<Cells *>(user_data)->emplace_back(x, y);
+    }, &cells);
+    return cells;
+}
+
+TEST(LifeBoard, BlinkerOscillates)
+{
+    Life_Board *board = life_board_new(10, 10, false);
+    ASSERT_NE(board, nullptr);
+
+    set_cells(board, {{4, 5}, {5, 5}, {6, 5}});
+
+    life_board_step(board);
+    EXPECT_EQ(live_cells(board), (Cells{{5, 4}, {5, 5}, {5, 6}}));
+
+    life_board_step(board);
+    EXPECT_EQ(live_cells(board), (Cells{{4, 5}, {5, 5}, {6, 5}}));
+
+    life_board_free(board);
+}
+
+TEST(LifeBoard, GliderCrossesWordBoundary)
+{
+    Life_Board *board = life_board_new(200, 20, false);
+    ASSERT_NE(board, nullptr);
+
+    /* a glider heading south-east, starting just left of the first word boundary */
+    set_cells(board, {{61, 1}, {62, 2}, {60, 3}, {61, 3}, {62, 3}});
+
+    for (int i = 0; i < 16; ++i) {
+        life_board_step(board);
+    }
+
+    EXPECT_EQ(life_board_population(board), 5u);
+    EXPECT_EQ(live_cells(board), (Cells{{65, 5}, {66, 6}, {64, 7}, {65, 7}, {66, 7}}));
+
+    life_board_free(board);
+}
+
+TEST(LifeBoard, GliderWrapsAroundTorus)
+{
+    constexpr int kSize = 70;
+
+    Life_Board *board = life_board_new(kSize, kSize, true);
+    ASSERT_NE(board, nullptr);
+
+    const Cells glider = {{1, 0}, {2, 1}, {0, 2}, {1, 2}, {2, 2}};
+    set_cells(board, glider);
+
+    /* a glider moves one cell diagonally every four generations */
+    for (int i = 0; i < kSize * 4; ++i) {
+        life_board_step(board);
+    }
+
+    EXPECT_EQ(live_cells(board), glider);
+
+    life_board_free(board);
+}
+
+TEST(LifeBoard, EdgesKillWithoutWrap)
+{
+    Life_Board *board = life_board_new(64, 8, false);
+    ASSERT_NE(board, nullptr);
+
+    set_cells(board, {{63, 3}, {63, 4}, {63, 5}});
+    life_board_step(board);
+
+    EXPECT_EQ(live_cells(board), (Cells{{62, 4}, {63, 4}}));
+
+    life_board_free(board);
+}
+
+TEST(LifeBoard, TracksAge)
+{
+    Life_Board *board = life_board_new(8, 8, false);
+    ASSERT_NE(board, nullptr);
+
+    set_cells(board, {{2, 2}, {3, 2}, {2, 3}, {3, 3}});  // a block never changes
+
+    for (int expected_age = 1; expected_age <= LIFE_BOARD_MAX_AGE + 2; ++expected_age) {
+        std::vector<int> ages;
+        life_board_for_each_live(board, 0, 0, 8, 8, [](int x, int y, int age, void *user_data) {
+            (void)x;
+            (void)y;
+            static_cast<std::vector<int> *>(user_data)->push_back(age);
+        }, &ages);
+
+        const int capped = expected_age < LIFE_BOARD_MAX_AGE ? expected_age : LIFE_BOARD_MAX_AGE;
+        EXPECT_EQ(ages, std::vector<int>(4, capped));
+
+        life_board_step(board);
+    }
+
+    life_board_free(board);
+}
+
+TEST(LifeBoard, ForEachLiveClipsToRectangle)
+{
+    Life_Board *board = life_board_new(300, 4, false);
+    ASSERT_NE(board, nullptr);
+
+    for (int x = 0; x < 300; ++x) {
+        life_board_set(board, x, 1, true);
+    }
+
+    Cells cells;
+    life_board_for_each_live(board, 60, -5, 80, 100, [](int x, int y, int age, void *user_data) {
+        (void)age;
+        static_cast<Cells *>(user_data)->emplace_back(x, y);
+    }, &cells);
+
+    ASSERT_EQ(cells.size(), 80u);
+    EXPECT_EQ(cells.front(), std::make_pair(60, 1));
+    EXPECT_EQ(cells.back(), std::make_pair(139, 1));
+
+    life_board_free(board);
+}
+
+class LifeBoardRandom : public ::testing::TestWithParam<std::tuple<int, int, bool>> {
+};
+
+TEST_P(LifeBoardRandom, MatchesReference)
+{
+    const int width = std::get<0>(GetParam());
+    const int height = std::get<1>(GetParam());
+    const bool wrap = std::get<2>(GetParam());
+
+    Life_Board *board = life_board_new(width, height, wrap);
+    ASSERT_NE(board, nullptr);
+
+    ReferenceBoard reference(width, height, wrap);
+    std::mt19937 rng(width * 31 + height);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const bool alive = rng() % 3 == 0;
+            life_board_set(board, x, y, alive);
+            reference.set(x, y, alive);
+        }
+    }
+
+    for (int gen = 0; gen < 30; ++gen) {
+        life_board_step(board);
+        reference.step();
+
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                ASSERT_EQ(life_board_get(board, x, y), reference.get(x, y))
+                        << "generation " << gen << " cell " << x << "," << y;
+            }
+        }
+    }
+
+    life_board_free(board);
+}
+
+INSTANTIATE_TEST_SUITE_P(Sizes, LifeBoardRandom,
+                         ::testing::Combine(::testing::Values(1, 37, 64, 130), ::testing::Values(1, 3, 40),
+                                            ::testing::Bool()));
+
+}  // namespace
@@ -0,0 +1,730 @@
+/*  life_hash.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "life_hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The root never grows beyond this level, which keeps every coordinate within an int64_t */
+#define LIFE_HASH_MAX_LEVEL 62
+
+/* The level of the root of an empty universe */
+#define LIFE_HASH_MIN_ROOT_LEVEL 3
+
+#define LIFE_HASH_INITIAL_BUCKETS 4096
+
+/* Nodes are allocated in chunks of this many */
+#define LIFE_NODE_CHUNK_SIZE 4096
+
+/* The level of a node that is on the free list */
+#define LIFE_NODE_FREE UINT8_MAX
+
+/*
+ * A square of 2^level by 2^level cells. Level 0 nodes are single cells; every other node
+ * is made of four nodes of the level below it.
+ *
+ * Nodes are immutable once created, and no two nodes have the same four children, so
+ * identical squares are always the same node.
+ */
+typedef struct Life_Node {
+    struct Life_Node *nw;
+    struct Life_Node *ne;
+    struct Life_Node *sw;
+    struct Life_Node *se;
+
+    /* The centre square of this node, half its size, advanced by the current step size.
+     * NULL if it hasn't been computed yet. */
+    struct Life_Node *result;
+
+    struct Life_Node *next;     /* the next node in this node's hash bucket, or in the free list */
+
+    uint64_t population;
+    uint8_t  level;
+    bool     marked;
+} Life_Node;
+
+typedef struct Life_Node_Chunk {
+    struct Life_Node_Chunk *next;
+    Life_Node nodes[LIFE_NODE_CHUNK_SIZE];
+} Life_Node_Chunk;
+
+struct Life_Hash {
+    Life_Node leaves[2];        /* the dead and the live cell */
+    Life_Node *empty[LIFE_HASH_MAX_LEVEL + 1];
+    Life_Node *root;
+
+    Life_Node **buckets;
+    size_t     num_buckets;     /* always a power of two */
+    size_t     num_nodes;
+
+    Life_Node_Chunk *chunks;
+    size_t     num_chunks;
+    Life_Node  *free_list;
+
+    size_t     memory_budget;
+    unsigned int step_log2;
+    uint64_t   generation;
+};
+
+static size_t node_hash(const Life_Node *nw, const Life_Node *ne, const Life_Node *sw, const Life_Node *se)
+{
+    uint64_t h = (uint64_t)(uintptr_t) nw;
+    h = h * UINT64_C(0x9E3779B97F4A7C15) + (uint64_t)(uintptr_t) ne;
+    h = h * UINT64_C(0x9E3779B97F4A7C15) + (uint64_t)(uintptr_t) sw;
+    h = h * UINT64_C(0x9E3779B97F4A7C15) + (uint64_t)(uintptr_t) se;
+
+    return (size_t)(h ^ (h >> 29));
+}
+
+static void buckets_grow(Life_Hash *hash)
+{
+    const size_t new_size = hash->num_buckets * 2;
+    Life_Node **new_buckets = calloc(new_size, sizeof(Life_Node *));
+
+    if (new_buckets == NULL) {
+        return;  // lookups still work with longer chains
+    }
+
+    for (size_t i = 0; i < hash->num_buckets; ++i) {
+        Life_Node *node = hash->buckets[i];
+
+        while (node != NULL) {
+            Life_Node *next = node->next;
+            const size_t idx = node_hash(node->nw, node->ne, node->sw, node->se) & (new_size - 1);
+
+            node->next = new_buckets[idx];
+            new_buckets[idx] = node;
+            node = next;
+        }
+    }
+
+    free(hash->buckets);
+    hash->buckets = new_buckets;
+    hash->num_buckets = new_size;
+}
+
+static Life_Node *node_alloc(Life_Hash *hash)
+{
+    if (hash->free_list == NULL) {
+        Life_Node_Chunk *chunk = malloc(sizeof(Life_Node_Chunk));
+
+        if (chunk == NULL) {
+            return NULL;
+        }
+
+        for (size_t i = 0; i < LIFE_NODE_CHUNK_SIZE; ++i) {
+            chunk->nodes[i].level = LIFE_NODE_FREE;
+            chunk->nodes[i].next = hash->free_list;
+            hash->free_list = &chunk->nodes[i];
+        }
+
+        chunk->next = hash->chunks;
+        hash->chunks = chunk;
+        ++hash->num_chunks;
+    }
+
+    Life_Node *node = hash->free_list;
+    hash->free_list = node->next;
+
+    return node;
+}
+
+/*
+ * Returns the unique node with the given children, creating it if necessary.
+ *
+ * Returns NULL if memory allocation fails.
+ */
+static Life_Node *find_node(Life_Hash *hash, Life_Node *nw, Life_Node *ne, Life_Node *sw, Life_Node *se)
+{
+    const size_t idx = node_hash(nw, ne, sw, se) & (hash->num_buckets - 1);
+
+    for (Life_Node *node = hash->buckets[idx]; node != NULL; node = node->next) {
+        if (node->nw == nw && node->ne == ne && node->sw == sw && node->se == se) {
+            return node;
+        }
+    }
+
+    Life_Node *node = node_alloc(hash);
+
+    if (node == NULL) {
+        return NULL;
+    }
+
+    *node = (Life_Node) {
+        .nw = nw,
+        .ne = ne,
+        .sw = sw,
+        .se = se,
+        .next = hash->buckets[idx],
+        .population = nw->population + ne->population + sw->population + se->population,
+        .level = (uint8_t)(nw->level + 1),
+    };
+
+    hash->buckets[idx] = node;
+    ++hash->num_nodes;
+
+    if (hash->num_nodes > hash->num_buckets) {
+        buckets_grow(hash);
+    }
+
+    return node;
+}
+
+static Life_Node *empty_node(Life_Hash *hash, int level)
+{
+    if (level == 0) {
+        return &hash->leaves[0];
+    }
+
+    if (hash->empty[level] != NULL) {
+        return hash->empty[level];
+    }
+
+    Life_Node *e = empty_node(hash, level - 1);
+
+    if (e == NULL) {
+        return NULL;
+    }
+
+    hash->empty[level] = find_node(hash, e, e, e, e);
+
+    return hash->empty[level];
+}
+
+/* Returns a node twice the size of `node` with `node` at its centre. */
+static Life_Node *expand(Life_Hash *hash, Life_Node *node)
+{
+    Life_Node *e = empty_node(hash, node->level - 1);
+
+    if (e == NULL) {
+        return NULL;
+    }
+
+    Life_Node *nw = find_node(hash, e, e, e, node->nw);
+    Life_Node *ne = find_node(hash, e, e, node->ne, e);
+    Life_Node *sw = find_node(hash, e, node->sw, e, e);
+    Life_Node *se = find_node(hash, node->se, e, e, e);
+
+    if (nw == NULL || ne == NULL || sw == NULL || se == NULL) {
+        return NULL;
+    }
+
+    return find_node(hash, nw, ne, sw, se);
+}
+
+/* Returns the square at the centre of `node`, half its size. */
+static Life_Node *centre(Life_Hash *hash, const Life_Node *node)
+{
+    return find_node(hash, node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+}
+
+/* Returns the square straddling the border between horizontally adjacent `w` and `e`. */
+static Life_Node *centre_horizontal(Life_Hash *hash, const Life_Node *w, const Life_Node *e)
+{
+    return find_node(hash, w->ne, e->nw, w->se, e->sw);
+}
+
+/* Returns the square straddling the border between vertically adjacent `n` and `s`. */
+static Life_Node *centre_vertical(Life_Hash *hash, const Life_Node *n, const Life_Node *s)
+{
+    return find_node(hash, n->sw, n->se, s->nw, s->ne);
+}
+
+/* Returns the centre 2x2 cells of a 4x4 node after one generation. */
+static Life_Node *successor_base(Life_Hash *hash, const Life_Node *node)
+{
+    const Life_Node *quads[4] = {node->nw, node->ne, node->sw, node->se};
+    uint8_t grid[4][4];
+
+    for (int q = 0; q < 4; ++q) {
+        const int x = (q % 2) * 2;
+        const int y = (q / 2) * 2;
+
+        grid[y][x] = (uint8_t) quads[q]->nw->population;
+        grid[y][x + 1] = (uint8_t) quads[q]->ne->population;
+        grid[y + 1][x] = (uint8_t) quads[q]->sw->population;
+        grid[y + 1][x + 1] = (uint8_t) quads[q]->se->population;
+    }
+
+    Life_Node *out[4];
+
+    for (int i = 0; i < 4; ++i) {
+        const int x = 1 + (i % 2);
+        const int y = 1 + (i / 2);
+        int count = 0;
+
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                if (dx != 0 || dy != 0) {
+                    count += grid[y + dy][x + dx];
+                }
+            }
+        }
+
+        const bool alive = count == 3 || (count == 2 && grid[y][x]);
+        out[i] = &hash->leaves[alive];
+    }
+
+    return find_node(hash, out[0], out[1], out[2], out[3]);
+}
+
+/*
+ * Returns the centre of `node`, half its size, advanced by 2^j generations where j is the
+ * smaller of the current step size and `node->level - 2`.
+ *
+ * Returns NULL if memory allocation fails.
+ */
+static Life_Node *successor(Life_Hash *hash, Life_Node *node)
+{
+    if (node->result != NULL) {
+        return node->result;
+    }
+
+    const int level = node->level;
+    Life_Node *result;
+
+    if (node->population == 0) {
+        result = empty_node(hash, level - 1);
+    } else if (level == 2) {
+        result = successor_base(hash, node);
+    } else {
+        const bool full_step = hash->step_log2 >= (unsigned int)(level - 2);
+
+        /* The nine overlapping squares half the size of `node` */
+        Life_Node *sub[3][3] = {
+            { node->nw, centre_horizontal(hash, node->nw, node->ne), node->ne },
+            { centre_vertical(hash, node->nw, node->sw), centre(hash, node), centre_vertical(hash, node->ne, node->se) },
+            { node->sw, centre_horizontal(hash, node->sw, node->se), node->se },
+        };
+
+        Life_Node *mid[3][3];
+
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                if (sub[i][j] == NULL) {
+                    return NULL;
+                }
+
+                /* For a full step, advance each square by half the step here and the rest below */
+                mid[i][j] = full_step ? successor(hash, sub[i][j]) : centre(hash, sub[i][j]);
+
+                if (mid[i][j] == NULL) {
+                    return NULL;
+                }
+            }
+        }
+
+        Life_Node *quads[4];
+
+        for (int i = 0; i < 4; ++i) {
+            const int r = i / 2;
+            const int c = i % 2;
+            Life_Node *square = find_node(hash, mid[r][c], mid[r][c + 1], mid[r + 1][c], mid[r + 1][c + 1]);
+
+            if (square == NULL) {
+                return NULL;
+            }
+
+            quads[i] = successor(hash, square);
+
+            if (quads[i] == NULL) {
+                return NULL;
+            }
+        }
+
+        result = find_node(hash, quads[0], quads[1], quads[2], quads[3]);
+    }
+
+    node->result = result;
+
+    return result;
+}
+
+static void clear_results(Life_Hash *hash)
+{
+    for (size_t i = 0; i < hash->num_buckets; ++i) {
+        for (Life_Node *node = hash->buckets[i]; node != NULL; node = node->next) {
+            node->result = NULL;
+        }
+    }
+}
+
+static void mark(Life_Node *node)
+{
+    if (node == NULL || node->level == 0 || node->marked) {
+        return;
+    }
+
+    node->marked = true;
+
+    mark(node->nw);
+    mark(node->ne);
+    mark(node->sw);
+    mark(node->se);
+}
+
+void life_hash_collect_garbage(Life_Hash *hash)
+{
+    mark(hash->root);
+
+    for (int i = 0; i <= LIFE_HASH_MAX_LEVEL; ++i) {
+        mark(hash->empty[i]);
+    }
+
+    /* Surviving nodes forget results that are about to be freed */
+    for (size_t i = 0; i < hash->num_buckets; ++i) {
+        for (Life_Node *node = hash->buckets[i]; node != NULL; node = node->next) {
+            if (node->marked && node->result != NULL && !node->result->marked) {
+                node->result = NULL;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < hash->num_buckets; ++i) {
+        Life_Node **link = &hash->buckets[i];
+
+        while (*link != NULL) {
+            Life_Node *node = *link;
+
+            if (node->marked) {
+                node->marked = false;
+                link = &node->next;
+                continue;
+            }
+
+            *link = node->next;
+            node->level = LIFE_NODE_FREE;
+            --hash->num_nodes;
+        }
+    }
+
+    /* Rebuild the free list, releasing chunks that are now entirely unused */
+    hash->free_list = NULL;
+
+    Life_Node_Chunk **link = &hash->chunks;
+
+    while (*link != NULL) {
+        Life_Node_Chunk *chunk = *link;
+        size_t num_free = 0;
+
+        for (size_t i = 0; i < LIFE_NODE_CHUNK_SIZE; ++i) {
+            num_free += chunk->nodes[i].level == LIFE_NODE_FREE;
+        }
+
+        if (num_free == LIFE_NODE_CHUNK_SIZE) {
+            *link = chunk->next;
+            free(chunk);
+            --hash->num_chunks;
+            continue;
+        }
+
+        for (size_t i = 0; i < LIFE_NODE_CHUNK_SIZE; ++i) {
+            if (chunk->nodes[i].level == LIFE_NODE_FREE) {
+                chunk->nodes[i].next = hash->free_list;
+                hash->free_list = &chunk->nodes[i];
+            }
+        }
+
+        link = &chunk->next;
+    }
+}
+
+Life_Hash *life_hash_new(size_t memory_budget)
+{
+    Life_Hash *hash = calloc(1, sizeof(Life_Hash));
+
+    if (hash == NULL) {
+        return NULL;
+    }
+
+    hash->buckets = calloc(LIFE_HASH_INITIAL_BUCKETS, sizeof(Life_Node *));
+
+    if (hash->buckets == NULL) {
+        free(hash);
+        return NULL;
+    }
+
+    hash->num_buckets = LIFE_HASH_INITIAL_BUCKETS;
+    hash->memory_budget = memory_budget > 0 ? memory_budget : LIFE_HASH_DEFAULT_MEMORY_BUDGET;
+    hash->leaves[1].population = 1;
+    hash->root = empty_node(hash, LIFE_HASH_MIN_ROOT_LEVEL);
+
+    if (hash->root == NULL) {
+        life_hash_free(hash);
+        return NULL;
+    }
+
+    return hash;
+}
+
+void life_hash_free(Life_Hash *hash)
+{
+    if (hash == NULL) {
+        return;
+    }
+
+    Life_Node_Chunk *chunk = hash->chunks;
+
+    while (chunk != NULL) {
+        Life_Node_Chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(hash->buckets);
+    free(hash);
+}
+
+void life_hash_clear(Life_Hash *hash)
+{
+    /* the empty nodes are never collected so this can't fail */
+    hash->root = hash->empty[LIFE_HASH_MIN_ROOT_LEVEL];
+    hash->generation = 0;
+
+    life_hash_collect_garbage(hash);
+}
+
+/* Returns true if `x`, `y` lie within the root node. */
+static bool in_root(const Life_Hash *hash, int64_t x, int64_t y)
+{
+    const int64_t half = (int64_t) 1 << (hash->root->level - 1);
+
+    return x >= -half && x < half && y >= -half && y < half;
+}
+
+bool life_hash_get(const Life_Hash *hash, int64_t x, int64_t y)
+{
+    if (!in_root(hash, x, y)) {
+        return false;
+    }
+
+    const Life_Node *node = hash->root;
+    uint64_t ux = (uint64_t)(x + ((int64_t) 1 << (node->level - 1)));
+    uint64_t uy = (uint64_t)(y + ((int64_t) 1 << (node->level - 1)));
+
+    while (node->level > 0 && node->population > 0) {
+        const uint64_t half = UINT64_C(1) << (node->level - 1);
+        const bool east = ux >= half;
+        const bool south = uy >= half;
+
+        if (south) {
+            node = east ? node->se : node->sw;
+        } else {
+            node = east ? node->ne : node->nw;
+        }
+
+        ux &= half - 1;
+        uy &= half - 1;
+    }
+
+    return node->population > 0;
+}
+
+/* Returns `node` with the cell at `x`, `y` (relative to its top-left corner) set to `alive`. */
+static Life_Node *set_cell(Life_Hash *hash, Life_Node *node, uint64_t x, uint64_t y, bool alive)
+{
+    if (node->level == 0) {
+        return &hash->leaves[alive];
+    }
+
+    const uint64_t half = UINT64_C(1) << (node->level - 1);
+    Life_Node *nw = node->nw;
+    Life_Node *ne = node->ne;
+    Life_Node *sw = node->sw;
+    Life_Node *se = node->se;
+    Life_Node **child;
+
+    if (y < half) {
+        child = x < half ? &nw : &ne;
+    } else {
+        child = x < half ? &sw : &se;
+    }
+
+    *child = set_cell(hash, *child, x & (half - 1), y & (half - 1), alive);
+
+    if (*child == NULL) {
+        return NULL;
+    }
+
+    return find_node(hash, nw, ne, sw, se);
+}
+
+int life_hash_set(Life_Hash *hash, int64_t x, int64_t y, bool alive)
+{
+    Life_Node *root = hash->root;
+
+    while (!in_root(hash, x, y)) {
+        if (!alive) {
+            return 0;
+        }
+
+        if (hash->root->level >= LIFE_HASH_MAX_LEVEL) {
+            hash->root = root;
+            return -1;
+        }
+
+        Life_Node *bigger = expand(hash, hash->root);
+
+        if (bigger == NULL) {
+            hash->root = root;
+            return -1;
+        }
+
+        hash->root = bigger;
+    }
+
+    const int64_t half = (int64_t) 1 << (hash->root->level - 1);
+    Life_Node *new_root = set_cell(hash, hash->root, (uint64_t)(x + half), (uint64_t)(y + half), alive);
+
+    if (new_root == NULL) {
+        hash->root = root;
+        return -1;
+    }
+
+    hash->root = new_root;
+
+    return 0;
+}
+
+/* Returns true if every live cell of `node` lies in the square at its centre a quarter its size. */
+static bool pattern_is_centred(const Life_Node *node)
+{
+    const uint64_t inner = node->nw->se->se->population + node->ne->sw->sw->population
+                           + node->sw->ne->ne->population + node->se->nw->nw->population;
+
+    return inner == node->population;
+}
+
+int life_hash_step(Life_Hash *hash, unsigned int step_log2)
+{
+    if (step_log2 > LIFE_HASH_MAX_STEP_LOG2) {
+        return -1;
+    }
+
+    if (life_hash_memory_usage(hash) > hash->memory_budget) {
+        life_hash_collect_garbage(hash);
+    }
+
+    if (step_log2 != hash->step_log2) {
+        clear_results(hash);
+        hash->step_log2 = step_log2;
+    }
+
+    /* The result of a step is the centre half of the root, so the pattern needs a margin of
+     * at least 2^step_log2 cells on every side to be sure it can't grow beyond it. */
+    Life_Node *root = hash->root;
+
+    while (root->level < step_log2 + 3 || !pattern_is_centred(root)) {
+        if (root->level >= LIFE_HASH_MAX_LEVEL) {
+            return -1;
+        }
+
+        root = expand(hash, root);
+
+        if (root == NULL) {
+            return -1;
+        }
+    }
+
+    Life_Node *result = successor(hash, root);
+
+    if (result == NULL) {
+        return -1;
+    }
+
+    hash->root = result;
+    hash->generation += UINT64_C(1) << step_log2;
+
+    return 0;
+}
+
+uint64_t life_hash_generation(const Life_Hash *hash)
+{
+    return hash->generation;
+}
+
+uint64_t life_hash_population(const Life_Hash *hash)
+{
+    return hash->root->population;
+}
+
+size_t life_hash_memory_usage(const Life_Hash *hash)
+{
+    return hash->num_chunks * sizeof(Life_Node_Chunk) + hash->num_buckets * sizeof(Life_Node *);
+}
+
+typedef struct Life_Query {
+    int64_t x0;
+    int64_t y0;
+    int64_t x1;
+    int64_t y1;
+    life_hash_cell_cb *cb;
+    void *user_data;
+} Life_Query;
+
+static void query(const Life_Node *node, int64_t left, int64_t top, const Life_Query *q)
+{
+    if (node->population == 0) {
+        return;
+    }
+
+    const int64_t size = (int64_t) 1 << node->level;
+
+    if (left >= q->x1 || top >= q->y1 || left + size <= q->x0 || top + size <= q->y0) {
+        return;
+    }
+
+    if (node->level == 0) {
+        q->cb(left, top, q->user_data);
+        return;
+    }
+
+    const int64_t half = size / 2;
+
+    query(node->nw, left, top, q);
+    query(node->ne, left + half, top, q);
+    query(node->sw, left, top + half, q);
+    query(node->se, left + half, top + half, q);
+}
+
+void life_hash_for_each_live(const Life_Hash *hash, int64_t x, int64_t y, int64_t width, int64_t height,
+                             life_hash_cell_cb *cb, void *user_data)
+{
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    const Life_Query q = {
+        .x0 = x,
+        .y0 = y,
+        .x1 = x + width,
+        .y1 = y + height,
+        .cb = cb,
+        .user_data = user_data,
+    };
+
+    const int64_t half = (int64_t) 1 << (hash->root->level - 1);
+
+    query(hash->root, -half, -half, &q);
+}
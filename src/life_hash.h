@@ -0,0 +1,118 @@
+/*  life_hash.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIFE_HASH_H
+#define LIFE_HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * An unbounded Game of Life universe stored as a hash-consed quadtree (HashLife).
+ *
+ * Every distinct square of cells is stored once, and each square memoizes the result of
+ * running its centre forward in time, so repetitive patterns can be advanced by huge
+ * numbers of generations at once.
+ *
+ * The universe spans coordinates of roughly +/- 2^60 on each axis.
+ */
+typedef struct Life_Hash Life_Hash;
+
+/* The memory budget used when 0 is passed to `life_hash_new()` */
+#define LIFE_HASH_DEFAULT_MEMORY_BUDGET (256 * 1024 * 1024)
+
+/* The largest supported value for the `step_log2` argument of `life_hash_step()` */
+#define LIFE_HASH_MAX_STEP_LOG2 56
+
+typedef void life_hash_cell_cb(int64_t x, int64_t y, void *user_data);
+
+/*
+ * Creates an empty universe.
+ *
+ * `memory_budget` is the number of bytes of node storage the universe tries to stay
+ * under. When a step begins with more than this in use, nodes that are no longer part of
+ * the pattern are garbage collected along with their memoized results. A single step may
+ * temporarily exceed the budget.
+ *
+ * Returns NULL on failure.
+ */
+Life_Hash *life_hash_new(size_t memory_budget);
+
+void life_hash_free(Life_Hash *hash);
+
+/* Kills every cell and resets the generation count. */
+void life_hash_clear(Life_Hash *hash);
+
+/* Returns true if the cell at `x`, `y` is alive. */
+bool life_hash_get(const Life_Hash *hash, int64_t x, int64_t y);
+
+/*
+ * Sets the state of the cell at `x`, `y`.
+ *
+ * Returns 0 on success.
+ * Returns -1 if the coordinates are out of range or memory allocation fails.
+ */
+int life_hash_set(Life_Hash *hash, int64_t x, int64_t y, bool alive);
+
+/*
+ * Advances the universe by 2^`step_log2` generations.
+ *
+ * Memoized results are kept between calls with the same `step_log2`, and discarded when
+ * it changes.
+ *
+ * Returns 0 on success.
+ * Returns -1 if `step_log2` is too large, the pattern has grown past the edge of the
+ * universe, or memory allocation fails. The universe is unchanged on failure.
+ */
+int life_hash_step(Life_Hash *hash, unsigned int step_log2);
+
+/* Returns the number of generations the universe has been advanced by. */
+uint64_t life_hash_generation(const Life_Hash *hash);
+
+/* Returns the number of live cells. */
+uint64_t life_hash_population(const Life_Hash *hash);
+
+/* Returns the number of bytes used for node storage. */
+size_t life_hash_memory_usage(const Life_Hash *hash);
+
+/* Frees every node that isn't part of the current pattern. */
+void life_hash_collect_garbage(Life_Hash *hash);
+
+/*
+ * Calls `cb` for every live cell in the rectangle at `x`, `y` of `width` by `height`
+ * cells. Empty squares and squares outside the rectangle are skipped without visiting
+ * their cells.
+ */
+void life_hash_for_each_live(const Life_Hash *hash, int64_t x, int64_t y, int64_t width, int64_t height,
+                             life_hash_cell_cb *cb, void *user_data);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* LIFE_HASH_H */
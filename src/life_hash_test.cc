@@ -0,0 +1,191 @@
+#include "life_hash.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "life_board.h"
+#include "life_rle.h"
+
+namespace {
+
+using Cells = std::vector<std::pair<int64_t, int64_t>>;
+
+constexpr char kGosperGun[] =
+    "#N Gosper glider gun\n"
+    "x = 36, y = 9, rule = B3/S23\n"
+    "24bo$22bobo$12b2o6b2o12b2o$11bo3bo4b2o12b2o$2o8bo5bo3b2o$2o8bo3bob2o4b\n"
+    "obo$10bo5bo7bo$11bo3bo$12b2o!\n";
+
+constexpr char kGlider[] = "x = 3, y = 3\nbo$2bo$3o!";
+
+int set_cell_cb(int64_t x, int64_t y, void *user_data)
+{
+    return life_hash_set(static_cast<Life_Hash *>(user_data), x, y, true);
+}
+
+Cells live_cells(const Life_Hash *hash, int64_t x, int64_t y, int64_t width, int64_t height)
+{
+    Cells cells;
+    life_hash_for_each_live(hash, x, y, width, height, [](int64_t cx, int64_t cy, void *user_data) {
+        static_cast<Cells *>(user_data)->emplace_back(cx, cy);
+    }, &cells);
+    return cells;
+}
+
+TEST(LifeHash, SetAndGet)
+{
+    Life_Hash *hash = life_hash_new(0);
+    ASSERT_NE(hash, nullptr);
+
+    EXPECT_EQ(life_hash_set(hash, 3, -4, true), 0);
+    EXPECT_EQ(life_hash_set(hash, -1000000000000, 7, true), 0);
+
+    EXPECT_TRUE(life_hash_get(hash, 3, -4));
+    EXPECT_TRUE(life_hash_get(hash, -1000000000000, 7));
+    EXPECT_FALSE(life_hash_get(hash, 4, -4));
+    EXPECT_EQ(life_hash_population(hash), 2u);
+
+    EXPECT_EQ(life_hash_set(hash, 3, -4, false), 0);
+    EXPECT_FALSE(life_hash_get(hash, 3, -4));
+    EXPECT_EQ(life_hash_population(hash), 1u);
+
+    life_hash_clear(hash);
+    EXPECT_EQ(life_hash_population(hash), 0u);
+
+    life_hash_free(hash);
+}
+
+class LifeHashStep : public ::testing::TestWithParam<unsigned int> {
+};
+
+/* Running a random soup with steps of 2^k must agree with the bitboard one generation at a time */
+TEST_P(LifeHashStep, MatchesBoard)
+{
+    constexpr int kBoardSize = 512;
+    constexpr int kSoupSize = 40;
+    constexpr int kGenerations = 128;
+    const unsigned int step_log2 = GetParam();
+
+    Life_Hash *hash = life_hash_new(0);
+    Life_Board *board = life_board_new(kBoardSize, kBoardSize, false);
+    ASSERT_NE(hash, nullptr);
+    ASSERT_NE(board, nullptr);
+
+    std::mt19937 rng(7);
+
+    for (int y = 0; y < kSoupSize; ++y) {
+        for (int x = 0; x < kSoupSize; ++x) {
+            if (rng() % 2 == 0) {
+                ASSERT_EQ(life_hash_set(hash, x, y, true), 0);
+                life_board_set(board, x + kBoardSize / 2, y + kBoardSize / 2, true);
+            }
+        }
+    }
+
+    for (int gen = 0; gen < kGenerations; gen += 1 << step_log2) {
+        ASSERT_EQ(life_hash_step(hash, step_log2), 0);
+
+        for (int i = 0; i < (1 << step_log2); ++i) {
+            life_board_step(board);
+        }
+
+        ASSERT_EQ(life_hash_population(hash), life_board_population(board)) << "generation " << gen;
+    }
+
+    EXPECT_EQ(life_hash_generation(hash), static_cast<uint64_t>(kGenerations));
+
+    Cells expected;
+    life_board_for_each_live(board, 0, 0, kBoardSize, kBoardSize, [](int x, int y, int age, void *user_data) {
+        (void)age;
+        static_cast<Cells *>(user_data)->emplace_back(x - kBoardSize / 2, y - kBoardSize / 2);
+    }, &expected);
+
+    Cells actual = live_cells(hash, -kBoardSize / 2, -kBoardSize / 2, kBoardSize, kBoardSize);
+    std::sort(actual.begin(), actual.end(), [](const auto &a, const auto &b) {
+        return a.second != b.second ? a.second < b.second : a.first < b.first;
+    });
+
+    EXPECT_EQ(actual, expected);
+
+    life_board_free(board);
+    life_hash_free(hash);
+}
+
+INSTANTIATE_TEST_SUITE_P(StepSizes, LifeHashStep, ::testing::Values(0u, 1u, 3u, 7u));
+
+TEST(LifeHash, GliderTravelsAstronomicalDistance)
+{
+    Life_Hash *hash = life_hash_new(0);
+    ASSERT_NE(hash, nullptr);
+
+    ASSERT_EQ(life_rle_parse(kGlider, sizeof(kGlider) - 1, set_cell_cb, hash, nullptr, nullptr), LIFE_RLE_OK);
+
+    ASSERT_EQ(life_hash_step(hash, 40), 0);
+
+    /* a glider moves one cell diagonally every four generations */
+    const int64_t offset = INT64_C(1) << 38;
+
+    EXPECT_EQ(life_hash_generation(hash), UINT64_C(1) << 40);
+    EXPECT_EQ(life_hash_population(hash), 5u);
+    EXPECT_EQ(live_cells(hash, offset, offset, 3, 3),
+              (Cells{{offset + 1, offset}, {offset + 2, offset + 1}, {offset, offset + 2}, {offset + 1, offset + 2},
+                     {offset + 2, offset + 2}}));
+
+    life_hash_free(hash);
+}
+
+TEST(LifeHash, GunEmitsGlidersWithinMemoryBudget)
+{
+    /* smaller than a single chunk of nodes, so garbage is collected before every step */
+    constexpr size_t kBudget = 64 * 1024;
+
+    Life_Hash *hash = life_hash_new(kBudget);
+    ASSERT_NE(hash, nullptr);
+
+    int64_t width = 0;
+    int64_t height = 0;
+    ASSERT_EQ(life_rle_parse(kGosperGun, sizeof(kGosperGun) - 1, set_cell_cb, hash, &width, &height), LIFE_RLE_OK);
+    EXPECT_EQ(width, 36);
+    EXPECT_EQ(height, 9);
+    EXPECT_EQ(life_hash_population(hash), 36u);
+
+    /* The gun has period 30 and each period adds a five cell glider. 2^20 generations is 34952
+     * periods and 16 generations, by which point the first glider is far away. */
+    for (int i = 0; i < 64; ++i) {
+        ASSERT_EQ(life_hash_step(hash, 14), 0);
+        EXPECT_LT(life_hash_memory_usage(hash), 1024u * 1024u);
+    }
+
+    const uint64_t generation = life_hash_generation(hash);
+    EXPECT_EQ(generation, UINT64_C(1) << 20);
+
+    Life_Hash *reference = life_hash_new(0);
+    ASSERT_NE(reference, nullptr);
+    ASSERT_EQ(life_rle_parse(kGosperGun, sizeof(kGosperGun) - 1, set_cell_cb, reference, nullptr, nullptr),
+              LIFE_RLE_OK);
+    ASSERT_EQ(life_hash_step(reference, 20), 0);
+
+    EXPECT_EQ(life_hash_population(hash), life_hash_population(reference));
+    EXPECT_EQ(live_cells(hash, -50, -50, 200, 200), live_cells(reference, -50, -50, 200, 200));
+
+    life_hash_free(reference);
+    life_hash_free(hash);
+}
+
+TEST(LifeHash, RefusesStepsThatAreTooLarge)
+{
+    Life_Hash *hash = life_hash_new(0);
+    ASSERT_NE(hash, nullptr);
+
+    ASSERT_EQ(life_hash_set(hash, 0, 0, true), 0);
+    EXPECT_EQ(life_hash_step(hash, LIFE_HASH_MAX_STEP_LOG2 + 1), -1);
+    EXPECT_TRUE(life_hash_get(hash, 0, 0));
+    EXPECT_EQ(life_hash_generation(hash), 0u);
+
+    life_hash_free(hash);
+}
+
+}  // namespace
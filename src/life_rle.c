@@ -0,0 +1,325 @@
+/*  life_rle.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "life_rle.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Run counts and header dimensions above this are treated as malformed */
+#define LIFE_RLE_MAX_COUNT ((int64_t)1 << 40)
+
+/* Returns true if `rule` (which is not null terminated) names Conway's Life. */
+static bool rle_rule_is_life(const char *rule, size_t length)
+{
+    char normalised[32];
+    size_t n = 0;
+
+    for (size_t i = 0; i < length; ++i) {
+        if (isspace((unsigned char) rule[i])) {
+            continue;
+        }
+
+        if (n + 1 >= sizeof(normalised)) {
+            return false;
+        }
+
+        normalised[n] = (char) tolower((unsigned char) rule[i]);
+        ++n;
+    }
+
+    normalised[n] = '\0';
+
+    return strcmp(normalised, "b3/s23") == 0 || strcmp(normalised, "s23/b3") == 0 || strcmp(normalised, "23/3") == 0;
+}
+
+/* Parses a non-negative decimal number of at most LIFE_RLE_MAX_COUNT. Returns -1 on failure. */
+static int64_t rle_parse_number(const char *s, size_t length)
+{
+    int64_t value = 0;
+    size_t i = 0;
+
+    while (i < length && isspace((unsigned char) s[i])) {
+        ++i;
+    }
+
+    if (i == length || !isdigit((unsigned char) s[i])) {
+        return -1;
+    }
+
+    while (i < length && isdigit((unsigned char) s[i])) {
+        value = value * 10 + (s[i] - '0');
+
+        if (value > LIFE_RLE_MAX_COUNT) {
+            return -1;
+        }
+
+        ++i;
+    }
+
+    while (i < length && isspace((unsigned char) s[i])) {
+        ++i;
+    }
+
+    return i == length ? value : -1;
+}
+
+/*
+ * Parses a header line of comma separated `key = value` pairs.
+ *
+ * Returns LIFE_RLE_OK on success.
+ */
+static int rle_parse_header(const char *line, size_t length, int64_t *width, int64_t *height)
+{
+    size_t pos = 0;
+
+    while (pos < length) {
+        const char *field = &line[pos];
+        const char *comma = memchr(field, ',', length - pos);
+        const size_t field_len = comma != NULL ? (size_t)(comma - field) : length - pos;
+        const char *equals = memchr(field, '=', field_len);
+
+        if (equals == NULL) {
+            return LIFE_RLE_ERROR_PARSE;
+        }
+
+        size_t key_start = 0;
+        size_t key_end = (size_t)(equals - field);
+
+        while (key_start < key_end && isspace((unsigned char) field[key_start])) {
+            ++key_start;
+        }
+
+        while (key_end > key_start && isspace((unsigned char) field[key_end - 1])) {
+            --key_end;
+        }
+
+        const char *value = equals + 1;
+        const size_t value_len = field_len - (size_t)(value - field);
+        const size_t key_len = key_end - key_start;
+        const char *key = &field[key_start];
+
+        if (key_len == 1 && (key[0] == 'x' || key[0] == 'y')) {
+            const int64_t n = rle_parse_number(value, value_len);
+
+            if (n < 0) {
+                return LIFE_RLE_ERROR_PARSE;
+            }
+
+            if (key[0] == 'x') {
+                *width = n;
+            } else {
+                *height = n;
+            }
+        } else if (key_len == 4 && memcmp(key, "rule", 4) == 0) {
+            if (!rle_rule_is_life(value, value_len)) {
+                return LIFE_RLE_ERROR_RULE;
+            }
+        }
+
+        pos += field_len + 1;
+    }
+
+    return LIFE_RLE_OK;
+}
+
+int life_rle_parse(const char *text, size_t length, life_rle_cell_cb *cb, void *user_data, int64_t *width,
+                   int64_t *height)
+{
+    int64_t header_width = 0;
+    int64_t header_height = 0;
+    size_t pos = 0;
+
+    /* Skip comments and blank lines, then read the header line if there is one */
+    while (pos < length) {
+        const char *line = &text[pos];
+        const char *newline = memchr(line, '\n', length - pos);
+        const size_t full_len = newline != NULL ? (size_t)(newline - line) : length - pos;
+        size_t line_len = full_len;
+        size_t start = 0;
+
+        while (start < line_len && isspace((unsigned char) line[start])) {
+            ++start;
+        }
+
+        if (start == line_len || line[start] == '#') {
+            pos += full_len + 1;
+            continue;
+        }
+
+        if (line[start] == 'x') {
+            if (line_len > start && line[line_len - 1] == '\r') {
+                --line_len;
+            }
+
+            const int ret = rle_parse_header(&line[start], line_len - start, &header_width, &header_height);
+
+            if (ret != LIFE_RLE_OK) {
+                return ret;
+            }
+
+            pos += full_len + 1;
+        }
+
+        break;
+    }
+
+    int64_t x = 0;
+    int64_t y = 0;
+    int64_t count = 0;
+    bool have_count = false;
+
+    for (; pos < length; ++pos) {
+        const char c = text[pos];
+
+        if (isdigit((unsigned char) c)) {
+            count = count * 10 + (c - '0');
+            have_count = true;
+
+            if (count > LIFE_RLE_MAX_COUNT) {
+                return LIFE_RLE_ERROR_PARSE;
+            }
+
+            continue;
+        }
+
+        if (isspace((unsigned char) c)) {
+            continue;
+        }
+
+        const int64_t run = have_count ? count : 1;
+        count = 0;
+        have_count = false;
+
+        if (c == '!') {
+            break;
+        }
+
+        switch (c) {
+            case 'b':
+
+            /* intentional fallthrough */
+
+            case '.': {
+                x += run;
+                break;
+            }
+
+            case 'o': {
+                for (int64_t i = 0; i < run; ++i) {
+                    if (cb(x + i, y, user_data) != 0) {
+                        return LIFE_RLE_ERROR_CALLBACK;
+                    }
+                }
+
+                x += run;
+                break;
+            }
+
+            case '$': {
+                y += run;
+                x = 0;
+                break;
+            }
+
+            default: {
+                return LIFE_RLE_ERROR_PARSE;
+            }
+        }
+
+        if (x > LIFE_RLE_MAX_COUNT || y > LIFE_RLE_MAX_COUNT) {
+            return LIFE_RLE_ERROR_PARSE;
+        }
+    }
+
+    if (width != NULL) {
+        *width = header_width;
+    }
+
+    if (height != NULL) {
+        *height = header_height;
+    }
+
+    return LIFE_RLE_OK;
+}
+
+int life_rle_load(const char *path, life_rle_cell_cb *cb, void *user_data, int64_t *width, int64_t *height)
+{
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == NULL) {
+        return LIFE_RLE_ERROR_OPEN;
+    }
+
+    char *text = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+
+    while (true) {
+        if (length == capacity) {
+            if (capacity >= LIFE_RLE_MAX_FILE_SIZE) {
+                free(text);
+                fclose(fp);
+                return LIFE_RLE_ERROR_OPEN;
+            }
+
+            const size_t new_capacity = capacity == 0 ? 4096 : capacity * 2;
+            char *tmp = realloc(text, new_capacity);
+
+            if (tmp == NULL) {
+                free(text);
+                fclose(fp);
+                return LIFE_RLE_ERROR_OPEN;
+            }
+
+            text = tmp;
+            capacity = new_capacity;
+        }
+
+        const size_t n = fread(text + length, 1, capacity - length, fp);
+
+        if (n == 0) {
+            break;
+        }
+
+        length += n;
+    }
+
+    const bool read_error = ferror(fp) != 0;
+
+    fclose(fp);
+
+    if (read_error) {
+        free(text);
+        return LIFE_RLE_ERROR_OPEN;
+    }
+
+    const int ret = life_rle_parse(text, length, cb, user_data, width, height);
+
+    free(text);
+
+    return ret;
+}
@@ -0,0 +1,76 @@
+/*  life_rle.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIFE_RLE_H
+#define LIFE_RLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Patterns files larger than this are refused */
+#define LIFE_RLE_MAX_FILE_SIZE (16 * 1024 * 1024)
+
+typedef enum Life_Rle_Error {
+    LIFE_RLE_OK = 0,
+    LIFE_RLE_ERROR_OPEN = -1,     /* the file couldn't be opened or read */
+    LIFE_RLE_ERROR_PARSE = -2,    /* the pattern is malformed */
+    LIFE_RLE_ERROR_RULE = -3,     /* the pattern is for a rule other than B3/S23 */
+    LIFE_RLE_ERROR_CALLBACK = -4, /* the cell callback returned an error */
+} Life_Rle_Error;
+
+/*
+ * Called for every live cell of a pattern. `x` and `y` are relative to the top-left
+ * corner of the pattern.
+ *
+ * Return 0 to continue, or -1 to stop parsing.
+ */
+typedef int life_rle_cell_cb(int64_t x, int64_t y, void *user_data);
+
+/*
+ * Parses a pattern in the run length encoded format used by most Life software:
+ *
+ *   #C optional comment lines
+ *   x = 3, y = 3, rule = B3/S23
+ *   bo$2bo$3o!
+ *
+ * `width` and `height` are set from the header line, and may be NULL.
+ *
+ * Returns LIFE_RLE_OK on success, or one of the errors above.
+ */
+int life_rle_parse(const char *text, size_t length, life_rle_cell_cb *cb, void *user_data, int64_t *width,
+                   int64_t *height);
+
+/*
+ * Reads the file at `path` and parses it with `life_rle_parse()`.
+ */
+int life_rle_load(const char *path, life_rle_cell_cb *cb, void *user_data, int64_t *width, int64_t *height);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* LIFE_RLE_H */
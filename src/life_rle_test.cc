@@ -0,0 +1,106 @@
+#include "life_rle.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Cells = std::vector<std::pair<int64_t, int64_t>>;
+
+int collect(int64_t x, int64_t y, void *user_data)
+{
+    static_cast<Cells *>(user_data)->emplace_back(x, y);
+    return 0;
+}
+
+int parse(const std::string &text, Cells *cells, int64_t *width = nullptr, int64_t *height = nullptr)
+{
+    return life_rle_parse(text.data(), text.size(), collect, cells, width, height);
+}
+
+TEST(LifeRle, ParsesGlider)
+{
+    Cells cells;
+    int64_t width = 0;
+    int64_t height = 0;
+
+    ASSERT_EQ(parse("#C a glider\r\nx = 3, y = 3, rule = B3/S23\r\nbo$2bo$3o!\r\n", &cells, &width, &height),
+              LIFE_RLE_OK);
+
+    EXPECT_EQ(width, 3);
+    EXPECT_EQ(height, 3);
+    EXPECT_EQ(cells, (Cells{{1, 0}, {2, 1}, {0, 2}, {1, 2}, {2, 2}}));
+}
+
+TEST(LifeRle, HandlesRunsAcrossLinesAndBlankRows)
+{
+    Cells cells;
+
+    ASSERT_EQ(parse("x = 4, y = 4\n2o\n2b$\n3$o!", &cells), LIFE_RLE_OK);
+    EXPECT_EQ(cells, (Cells{{0, 0}, {1, 0}, {0, 4}}));
+}
+
+TEST(LifeRle, StopsAtTerminator)
+{
+    Cells cells;
+
+    ASSERT_EQ(parse("o!\nthis is ignored", &cells), LIFE_RLE_OK);
+    EXPECT_EQ(cells, (Cells{{0, 0}}));
+}
+
+TEST(LifeRle, RejectsOtherRules)
+{
+    Cells cells;
+
+    EXPECT_EQ(parse("x = 1, y = 1, rule = B36/S23\no!", &cells), LIFE_RLE_ERROR_RULE);
+    EXPECT_EQ(parse("x = 1, y = 1, rule = 23/3\no!", &cells), LIFE_RLE_OK);
+}
+
+TEST(LifeRle, RejectsMalformedPatterns)
+{
+    Cells cells;
+
+    EXPECT_EQ(parse("x = 1, y\no!", &cells), LIFE_RLE_ERROR_PARSE);
+    EXPECT_EQ(parse("x = 1, y = 1\n3q!", &cells), LIFE_RLE_ERROR_PARSE);
+    EXPECT_EQ(parse("99999999999999999999o!", &cells), LIFE_RLE_ERROR_PARSE);
+}
+
+TEST(LifeRle, StopsWhenCallbackFails)
+{
+    int calls = 0;
+    const std::string text = "5o!";
+
+    EXPECT_EQ(life_rle_parse(text.data(), text.size(), [](int64_t x, int64_t y, void *user_data) {
+        (void)y;
+        ++*static_cast<int *>(user_data);
+        return x == 2 ? -1 : 0;
+    }, &calls, nullptr, nullptr), LIFE_RLE_ERROR_CALLBACK);
+
+    EXPECT_EQ(calls, 3);
+}
+
+TEST(LifeRle, LoadsFile)
+{
+    char path[] = "/tmp/life_rle_test_XXXXXX";
+    const int fd = mkstemp(path);
+    ASSERT_NE(fd, -1);
+
+    FILE *fp = fdopen(fd, "w");
+    ASSERT_NE(fp, nullptr);
+    std::fputs("x = 2, y = 1\n2o!\n", fp);
+    std::fclose(fp);
+
+    Cells cells;
+    EXPECT_EQ(life_rle_load(path, collect, &cells, nullptr, nullptr), LIFE_RLE_OK);
+    EXPECT_EQ(cells, (Cells{{0, 0}, {1, 0}}));
+
+    std::remove(path);
+
+    EXPECT_EQ(life_rle_load(path, collect, &cells, nullptr, nullptr), LIFE_RLE_ERROR_OPEN);
+}
+
+}  // namespace
@@ -20,12 +20,9 @@
  *
  */
 
-#ifndef _GNU_SOURCE
-#define _GNU_SOURCE    /* needed for wcswidth() */
-#endif
-
 #include <errno.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -40,6 +37,9 @@
 #include "toxic.h"
 #include "windows.h"
 
+/* Total number of lines waiting in the queues of all windows. Read without Winthread.lock. */
+static atomic_size_t queued_lines;
+
 void line_info_init(struct history *hst)
 {
     hst->line_root = calloc(1, sizeof(struct line_info));
@@ -53,6 +53,21 @@ void line_info_init(struct history *hst)
     hst->queue_size = 0;
 }
 
+/* Puts the dimensions of `self`'s curses window in `y2` and `x2`.
+ *
+ * Stub windows don't have one yet, and get it at the current terminal size when initialized.
+ */
+static void line_info_get_dimensions(const ToxWindow *self, int *y2, int *x2)
+{
+    if (self->window == NULL) {
+        *y2 = LINES;
+        *x2 = COLS;
+        return;
+    }
+
+    getmaxyx(self->window, *y2, *x2);
+}
+
 /* resets line_start (moves to end of chat history) */
 void line_info_reset_start(ToxWindow *self, struct history *hst)
 {
@@ -64,7 +79,7 @@ void line_info_reset_start(ToxWindow *self, struct history *hst)
 
     int y2;
     int x2;
-    getmaxyx(self->window, y2, x2);
+    line_info_get_dimensions(self, &y2, &x2);
     UNUSED_VAR(x2);
 
     int top_offst = self->type != WINDOW_TYPE_CONFERENCE ? TOP_BAR_HEIGHT : 0;
@@ -102,6 +117,8 @@ void line_info_cleanup(struct history *hst)
         }
     }
 
+    atomic_fetch_sub(&queued_lines, hst->queue_size);
+
     free(hst);
 }
 
@@ -121,22 +138,26 @@ static void line_info_root_fwd(struct history *hst)
     hst->line_root = tmp;
 }
 
-/* returns ptr to queue item 0 and removes it from queue. Returns NULL if queue is empty. */
-static struct line_info *line_info_ret_queue(struct history *hst)
+/* Prints the printable ASCII characters at the start of the first `n` characters of `s` with a
+ * single call to ncurses.
+ *
+ * Returns the number of characters printed.
+ */
+static size_t print_ascii_run(WINDOW *win, const wchar_t *s, size_t n)
 {
-    if (hst->queue_size == 0) {
-        return NULL;
-    }
+    char run[64];
+    size_t len = 0;
 
-    struct line_info *line = hst->queue[0];
-
-    for (size_t i = 0; i < hst->queue_size; ++i) {
-        hst->queue[i] = hst->queue[i + 1];
+    while (len < n && len < sizeof(run) && s[len] >= 0x20 && s[len] < 0x7f) {
+        run[len] = (char) s[len];
+        ++len;
     }
 
-    --hst->queue_size;
+    if (win && len > 0) {
+        waddnstr(win, run, len);
+    }
 
-    return line;
+    return len;
 }
 
 /* Prints a maximum of `n` chars from `s` to `win`.
@@ -154,6 +175,13 @@ static int print_n_chars(WINDOW *win, const wchar_t *s, size_t n, int max_y)
     bool newline = false;
 
     for (size_t i = 0; i < n && (ch[0] = s[i]); ++i) {
+        const size_t run = print_ascii_run(win, &s[i], n - i);
+
+        if (run > 0) {
+            i += run - 1;
+            continue;
+        }
+
         if (ch[0] == L'\n') {
             newline = true;
 
@@ -355,11 +383,31 @@ uint16_t line_info_add_msg(wchar_t *buf, size_t buf_size, const char *msg)
         return 0;
     }
 
-    const int wc_msg_len = mbs_to_wcs_buf(buf, msg, buf_size);
+    const size_t msg_len = strlen(msg);
+    const size_t ascii_len = ascii_prefix_len(msg, msg_len);
+
+    /* Every ASCII character is one column wide, and control characters fall back to strlen below anyway */
+    if (ascii_len == msg_len && msg_len < buf_size) {
+        ascii_to_wcs(buf, msg, msg_len);
+        buf[msg_len] = L'\0';
+        return (uint16_t)msg_len;
+    }
+
+    /* Only the rest of the message after its ASCII prefix needs converting by libc */
+    int wc_msg_len = -1;
+
+    if (ascii_len < buf_size) {
+        ascii_to_wcs(buf, msg, ascii_len);
+        const size_t tail_len = mbstowcs(buf + ascii_len, msg + ascii_len, buf_size - ascii_len);
+
+        if (tail_len != (size_t) -1 && ascii_len + tail_len <= INT_MAX) {
+            wc_msg_len = (int)(ascii_len + tail_len);
+        }
+    }
 
     if (wc_msg_len > 0 && wc_msg_len < buf_size) {
         buf[wc_msg_len] = L'\0';
-        int width = wcswidth(buf, wc_msg_len);
+        int width = wcs_width(buf, wc_msg_len);
 
         if (width < 0 || width > UINT16_MAX) {  // the best we can do on failure is to fall back to strlen
             width = strlen(msg);
@@ -381,7 +429,7 @@ static void line_info_init_line(ToxWindow *self, struct line_info *line)
 {
     int y2;
     int x2;
-    getmaxyx(self->window, y2, x2);
+    line_info_get_dimensions(self, &y2, &x2);
 
     UNUSED_VAR(y2);
 
@@ -399,10 +447,21 @@ static void line_info_init_line(ToxWindow *self, struct line_info *line)
 int line_info_add(ToxWindow *self, const Client_Config *c_config, bool show_timestamp, const char *name1,
                   const char *name2, LINE_TYPE type, uint8_t bold, uint8_t colour, const char *msg, ...)
 {
-    if (self == NULL) {
+    if (self == NULL || self->chatwin == NULL) {
         return -1;
     }
 
+    /* Stub windows get their history on the first line so nothing is lost before they're initialized */
+    if (self->chatwin->hst == NULL) {
+        self->chatwin->hst = calloc(1, sizeof(struct history));
+
+        if (self->chatwin->hst == NULL) {
+            exit_toxic_err(FATALERR_MEMORY, "failed in line_info_add");
+        }
+
+        line_info_init(self->chatwin->hst);
+    }
+
     struct history *hst = self->chatwin->hst;
 
     if (hst->queue_size >= MAX_LINE_INFO_QUEUE) {
@@ -514,6 +573,7 @@ int line_info_add(ToxWindow *self, const Client_Config *c_config, bool show_time
 
     hst->queue[hst->queue_size] = new_line;
     ++hst->queue_size;
+    atomic_fetch_add(&queued_lines, 1);
 
     return new_line->id;
 }
@@ -564,28 +624,46 @@ int line_info_load_history(ToxWindow *self, const Client_Config *c_config, const
 
     hst->queue[hst->queue_size] = new_line;
     ++hst->queue_size;
+    atomic_fetch_add(&queued_lines, 1);
 
     return new_line->id;
 }
 
-/* adds a single queue item to hst if possible. only called once per call to line_info_print() */
-static void line_info_check_queue(ToxWindow *self, const Client_Config *c_config)
+size_t line_info_queued_lines(void)
 {
-    struct history *hst = self->chatwin->hst;
-    struct line_info *line = line_info_ret_queue(hst);
+    return atomic_load(&queued_lines);
+}
 
-    if (line == NULL) {
+void line_info_check_queue(ToxWindow *self, const Client_Config *c_config)
+{
+    ChatContext *ctx = self->chatwin;
+
+    if (ctx == NULL || ctx->hst == NULL) {
+        return;
+    }
+
+    struct history *hst = ctx->hst;
+
+    if (hst->queue_size == 0) {
         return;
     }
 
-    if (hst->start_id > c_config->history_size) {
-        line_info_root_fwd(hst);
+    for (size_t i = 0; i < hst->queue_size; ++i) {
+        struct line_info *line = hst->queue[i];
+        hst->queue[i] = NULL;
+
+        if (hst->start_id > c_config->history_size) {
+            line_info_root_fwd(hst);
+        }
+
+        line->prev = hst->line_end;
+        hst->line_end->next = line;
+        hst->line_end = line;
+        hst->line_end->id = line->id;
     }
 
-    line->prev = hst->line_end;
-    hst->line_end->next = line;
-    hst->line_end = line;
-    hst->line_end->id = line->id;
+    atomic_fetch_sub(&queued_lines, hst->queue_size);
+    hst->queue_size = 0;
 
     if (!self->scroll_pause) {
         line_info_reset_start(self, hst);
@@ -602,7 +680,6 @@ void line_info_print(ToxWindow *self, const Client_Config *c_config)
 
     struct history *hst = ctx->hst;
 
-    /* Only allow one new item to be added to chat window per call to this function */
     line_info_check_queue(self, c_config);
 
     WINDOW *win = ctx->history;
@@ -856,11 +933,6 @@ void line_info_print(ToxWindow *self, const Client_Config *c_config)
     }
 
     flag_interface_refresh();
-
-    /* keep calling until queue is empty */
-    if (hst->queue_size > 0) {
-        line_info_print(self, c_config);
-    }
 }
 
 /*
@@ -106,6 +106,19 @@ int line_info_load_history(ToxWindow *self, const Client_Config *c_config, const
 /* Prints a section of history starting at line_start */
 void line_info_print(ToxWindow *self, const Client_Config *c_config);
 
+/*
+ * Moves all queued lines into the window's history without drawing anything. Used to keep
+ * the queues of windows that aren't being looked at from filling up.
+ */
+void line_info_check_queue(ToxWindow *self, const Client_Config *c_config);
+
+/*
+ * Returns the number of lines waiting in the queues of all windows.
+ *
+ * This function is thread safe.
+ */
+size_t line_info_queued_lines(void);
+
 /* frees all history lines */
 void line_info_cleanup(struct history *hst);
 
@@ -1,13 +1,63 @@
 #include "line_info.h"
+#include "settings.h"
+#include "windows.h"
 
 #include <gtest/gtest.h>
 
+#include <clocale>
+#include <cwchar>
+
 namespace {
 
 TEST(LineInfo, TextWidth)
 {
     wchar_t buf[100];
     EXPECT_EQ(line_info_add_msg(buf, 100, "Hello, world!"), 13);
+    EXPECT_EQ(std::wcscmp(buf, L"Hello, world!"), 0);
+}
+
+TEST(LineInfo, TextWidthEmpty)
+{
+    wchar_t buf[100];
+    EXPECT_EQ(line_info_add_msg(buf, 100, ""), 0);
+}
+
+TEST(LineInfo, TextWidthControlCharacters)
+{
+    wchar_t buf[100];
+    EXPECT_EQ(line_info_add_msg(buf, 100, "two\nlines"), 9);
+}
+
+TEST(LineInfo, TextWidthNonAscii)
+{
+    if (std::setlocale(LC_ALL, "C.UTF-8") == nullptr) {
+        GTEST_SKIP() << "C.UTF-8 locale not available";
+    }
+
+    wchar_t buf[100];
+    EXPECT_EQ(line_info_add_msg(buf, 100, "h\xc3\xa9llo"), 5);
+    EXPECT_EQ(line_info_add_msg(buf, 100, "\xe6\x97\xa5\xe6\x9c\xac"), 4);  // two double-width glyphs
+
+    std::setlocale(LC_ALL, "C");
+}
+
+/* Lines added to a stub window are queued until it's initialized rather than dropped. */
+TEST(LineInfo, StubWindowKeepsLines)
+{
+    ChatContext ctx{};
+    ToxWindow win{};
+    win.is_stub = true;
+    win.chatwin = &ctx;
+
+    Client_Config c_config{};
+
+    EXPECT_GE(line_info_add(&win, &c_config, false, nullptr, nullptr, SYS_MSG, 0, 0, "foo is now known as bar"), 0);
+    EXPECT_GE(line_info_add(&win, &c_config, false, nullptr, nullptr, SYS_MSG, 0, 0, "baz has left"), 0);
+
+    ASSERT_NE(ctx.hst, nullptr);
+    EXPECT_EQ(ctx.hst->queue_size, 2);
+
+    line_info_cleanup(ctx.hst);
 }
 
 }  // namespace
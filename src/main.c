@@ -48,6 +48,7 @@
 #include <tox/tox.h>
 
 #include "audio_device.h"
+#include "autosave.h"
 #include "bootstrap.h"
 #include "conference.h"
 #include "configdir.h"
@@ -55,6 +56,7 @@
 #include "file_transfers.h"
 #include "friendlist.h"
 #include "groupchats.h"
+#include "headless.h"
 #include "line_info.h"
 #include "log.h"
 #include "message_queue.h"
@@ -63,6 +65,7 @@
 #include "notify.h"
 #include "prompt.h"
 #include "run_options.h"
+#include "scheduler.h"
 #include "settings.h"
 #include "term_mplex.h"
 #include "toxic.h"
@@ -87,12 +90,6 @@
 #define DATANAME  "toxic_profile.tox"
 #define BLOCKNAME "toxic_blocklist"
 
-static struct cqueue_thread cqueue_thread;
-
-#ifdef AUDIO
-static struct av_thread av_thread;
-#endif
-
 static void queue_init_message(const char *msg, ...);
 
 static time_t last_signal_time;
@@ -113,7 +110,7 @@ static void catch_SIGSEGV(int sig)
 {
     UNUSED_VAR(sig);
 
-    if (freopen("/dev/tty", "w", stderr)) {    // make sure stderr is enabled since we may have disabled it
+    if (reenable_stderr()) {
         fprintf(stderr, "Caught SIGSEGV: Aborting toxic session.\n");
     }
 
@@ -136,6 +133,14 @@ static void init_signal_catchers(void)
     signal(SIGSEGV, catch_SIGSEGV);
 }
 
+/* Without a UI there's nobody to press ^C twice, so a single SIGINT or SIGTERM exits */
+static void catch_headless_exit(int sig)
+{
+    UNUSED_VAR(sig);
+
+    Winthread.sig_exit_toxic = 1;
+}
+
 static const char *tox_log_level_show(Tox_Log_Level level)
 {
     switch (level) {
@@ -187,6 +192,64 @@ static void cb_toxcore_logger(Tox *tox, TOX_LOG_LEVEL level, const char *file, u
     fflush(fp);
 }
 
+#define MAX_STARTUP_PHASES 24
+
+/* Time spent in each phase of startup. Printed to the home window with --startup-profile. */
+static struct Startup_Profile {
+    uint64_t start_us;
+    uint64_t last_us;
+    const char *phases[MAX_STARTUP_PHASES];
+    uint64_t elapsed_us[MAX_STARTUP_PHASES];
+    int num_phases;
+} Startup_Profile;
+
+static uint64_t startup_time_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t) t.tv_sec) * 1000000 + ((uint64_t) t.tv_nsec) / 1000;
+}
+
+static void startup_profile_begin(void)
+{
+    Startup_Profile.start_us = startup_time_us();
+    Startup_Profile.last_us = Startup_Profile.start_us;
+}
+
+/* Attributes the time elapsed since the previous call to `phase`. */
+static void startup_profile_mark(const char *phase)
+{
+    const uint64_t now = startup_time_us();
+    const int i = Startup_Profile.num_phases;
+
+    if (i < MAX_STARTUP_PHASES) {
+        Startup_Profile.phases[i] = phase;
+        Startup_Profile.elapsed_us[i] = now - Startup_Profile.last_us;
+        ++Startup_Profile.num_phases;
+    }
+
+    Startup_Profile.last_us = now;
+}
+
+static void print_startup_profile(const Toxic *toxic)
+{
+    ToxWindow *home_window = toxic->home_window;
+    const Client_Config *c_config = toxic->c_config;
+
+    line_info_add(home_window, c_config, false, NULL, NULL, SYS_MSG, 0, 0,
+                  "Startup profile (%zu friends, %u groups, %zu conferences):",
+                  tox_self_get_friend_list_size(toxic->tox), tox_group_get_number_groups(toxic->tox),
+                  tox_conference_get_chatlist_size(toxic->tox));
+
+    for (int i = 0; i < Startup_Profile.num_phases; ++i) {
+        line_info_add(home_window, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "  %-16s %9.2f ms",
+                      Startup_Profile.phases[i], Startup_Profile.elapsed_us[i] / 1000.0);
+    }
+
+    line_info_add(home_window, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "  %-16s %9.2f ms", "total",
+                  (Startup_Profile.last_us - Startup_Profile.start_us) / 1000.0);
+}
+
 static struct _init_messages {
     char **msgs;
     int num;
@@ -307,22 +370,8 @@ static void load_conferences(Toxic *toxic)
 
         title[length] = 0;
 
-        const int64_t win_id = init_conference_win(toxic, conferencenum, type, (const char *) title, length);
-
-        if (win_id == -1) {
+        if (init_conference_win(toxic, conferencenum, type, (const char *) title, length, true) == -1) {
             tox_conference_delete(tox, conferencenum, NULL);
-            continue;
-        }
-
-        if (type == TOX_CONFERENCE_TYPE_AV) {
-            ToxWindow *win = get_window_pointer_by_id(toxic->windows, win_id);
-            line_info_add(win, toxic->c_config, NULL, NULL, NULL, SYS_MSG, 0, 0,
-#ifdef AUDIO
-                          "Use \"/audio on\" to enable audio in this conference."
-#else
-                          "Audio support disabled by compile-time option."
-#endif
-                         );
         }
     }
 
@@ -629,7 +678,7 @@ static bool load_tox(Toxic *toxic, struct Tox_Options *tox_opts, Tox_Err_New *ne
             size_t pwlen = 0;
             int pweval = toxic->c_config->password_eval[0];
 
-            if (!pweval) {
+            if (!pweval && !run_opts->headless) {
                 clear_screen();
                 printf("Enter password (q to quit) ");
             }
@@ -644,6 +693,14 @@ static bool load_tox(Toxic *toxic, struct Tox_Options *tox_opts, Tox_Err_New *ne
             }
 
             while (true) {
+                /* Nobody would see the prompt, and a wrong password from password_eval won't fix itself */
+                if (!pweval && run_opts->headless) {
+                    fclose(fp);
+                    free(plain);
+                    free(data);
+                    exit_toxic_err(FATALERR_ENCRYPT, "Encrypted data file needs a valid password_eval in headless mode");
+                }
+
                 fflush(stdout); // Flush before prompts so the user sees the question/message
 
                 if (pweval) {
@@ -771,8 +828,16 @@ static bool load_toxic(Toxic *toxic)
         queue_init_message("tox_new returned non-fatal error %d", new_err);
     }
 
-    init_tox_callbacks(toxic->tox);
+    if (toxic->run_opts->headless) {
+        headless_init_callbacks(toxic->tox);
+    } else {
+        init_tox_callbacks(toxic->tox);
+    }
+
+    startup_profile_mark("tox");
+
     load_friendlist(toxic);
+    startup_profile_mark("friends");
 
     if (load_blocklist(toxic->client_data.block_path) == -1) {
         queue_init_message("Failed to load block list");
@@ -791,13 +856,12 @@ static void do_toxic(Toxic *toxic)
 {
     pthread_mutex_lock(&Winthread.lock);
 
-    if (toxic->run_opts->no_connect) {
-        pthread_mutex_unlock(&Winthread.lock);
-        return;
+    if (!toxic->run_opts->no_connect) {
+        tox_iterate(toxic->tox, (void *) toxic);
+        do_tox_connection(toxic);
     }
 
-    tox_iterate(toxic->tox, (void *) toxic);
-    do_tox_connection(toxic);
+    friendlist_update_snapshot();
 
     pthread_mutex_unlock(&Winthread.lock);
 }
@@ -854,48 +918,165 @@ static void *thread_winref(void *data)
     }
 }
 
-_Noreturn static void *thread_cqueue(void *data)
+static void cqueue_task_run(void *data)
 {
     Toxic *toxic = (Toxic *) data;
     Windows *windows = toxic->windows;
 
-    while (true) {
-        pthread_mutex_lock(&Winthread.lock);
+    pthread_mutex_lock(&Winthread.lock);
 
-        for (uint16_t i = 2; i < windows->count; ++i) {
-            ToxWindow *w = windows->list[i];
+    for (uint16_t i = 2; i < windows->count; ++i) {
+        ToxWindow *w = windows->list[i];
 
-            if (w->type == WINDOW_TYPE_CHAT) {
-                cqueue_check_unread(w);
+        if (w->type == WINDOW_TYPE_CHAT) {
+            cqueue_check_unread(w);
 
-                if (get_friend_connection_status(w->num) != TOX_CONNECTION_NONE) {
-                    cqueue_try_send(w, toxic->tox);
-                }
+            if (get_friend_connection_status(w->num) != TOX_CONNECTION_NONE) {
+                cqueue_try_send(w, toxic->tox);
             }
         }
+    }
 
-        pthread_mutex_unlock(&Winthread.lock);
+    pthread_mutex_unlock(&Winthread.lock);
+}
+
+/* How often we retry sending queued messages and check for unread receipts */
+#define CQUEUE_RETRY_INTERVAL 750
+
+static int64_t cqueue_task_interval(void *data)
+{
+    UNUSED_VAR(data);
+
+    return CQUEUE_RETRY_INTERVAL;
+}
+
+static void tox_task_run(void *data)
+{
+    do_toxic((Toxic *) data);
+}
+
+static int64_t tox_task_interval(void *data)
+{
+    const Toxic *toxic = (const Toxic *) data;
+
+    return tox_iteration_interval(toxic->tox);
+}
 
-        sleep_thread(750000L); // 0.75 seconds
+static void autosave_task_run(void *data)
+{
+    Toxic *toxic = (Toxic *) data;
+
+    pthread_mutex_lock(&Winthread.lock);
+
+    /* a failed background write is reported on the next autosave */
+    if (store_data(toxic) != 0 || autosave_write_failed()) {
+        line_info_add(toxic->home_window, toxic->c_config, false, NULL, NULL, SYS_MSG, 0, RED,
+                      "WARNING: Failed to save to data file");
+    }
+
+    pthread_mutex_unlock(&Winthread.lock);
+}
+
+static int64_t autosave_task_interval(void *data)
+{
+    const Toxic *toxic = (const Toxic *) data;
+    const int autosave_freq = toxic->c_config->autosave_freq;
+
+    return autosave_freq > 0 ? (int64_t) autosave_freq * 1000 : -1;
+}
+
+static void nodeslist_task_run(void *data)
+{
+    Toxic *toxic = (Toxic *) data;
+
+    const int ret = load_DHT_nodeslist(toxic);
+
+    if (ret != 0) {
+        fprintf(stderr, "DHT nodeslist failed to reload (error %d)\n", ret);
     }
 }
 
+static int64_t nodeslist_task_interval(void *data)
+{
+    const Toxic *toxic = (const Toxic *) data;
+    const int update_freq = toxic->c_config->nodeslist_update_freq;
+
+    return update_freq > 0 ? (int64_t) update_freq * 24 * 60 * 60 * 1000 : -1;
+}
+
 #ifdef AUDIO
-_Noreturn static void *thread_av(void *data)
+static void toxav_task_run(void *data)
 {
     ToxAV *av = (ToxAV *) data;
 
-    while (true) {
-        pthread_mutex_lock(&Winthread.lock);
-        toxav_iterate(av);
-        pthread_mutex_unlock(&Winthread.lock);
+    pthread_mutex_lock(&Winthread.lock);
+    toxav_iterate(av);
+    pthread_mutex_unlock(&Winthread.lock);
+}
 
-        const long int sleep_duration = toxav_iteration_interval(av) * 1000;
-        sleep_thread(sleep_duration);
-    }
+static int64_t toxav_task_interval(void *data)
+{
+    ToxAV *av = (ToxAV *) data;
+
+    return toxav_iteration_interval(av);
 }
 #endif /* AUDIO */
 
+static void init_scheduler_tasks(Toxic *toxic)
+{
+    scheduler_set_task(SCHED_TASK_TOX, "tox", tox_task_run, tox_task_interval, toxic);
+    scheduler_set_task(SCHED_TASK_AUTOSAVE, "autosave", autosave_task_run, autosave_task_interval, toxic);
+    scheduler_set_task(SCHED_TASK_NODESLIST, "nodeslist", nodeslist_task_run, nodeslist_task_interval, toxic);
+    scheduler_set_task(SCHED_TASK_CQUEUE, "cqueue", cqueue_task_run, cqueue_task_interval, toxic);
+
+#ifdef AUDIO
+
+    if (toxic->av != NULL) {
+        scheduler_set_task(SCHED_TASK_TOXAV, "toxav", toxav_task_run, toxav_task_interval, toxic->av);
+    }
+
+#endif /* AUDIO */
+}
+
+/*
+ * Runs toxic without ncurses or the UI thread: Tox events are streamed to and commands are
+ * taken from the clients of the headless server instead. Never returns.
+ */
+static void run_headless(Toxic *toxic)
+{
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, catch_headless_exit);
+    signal(SIGTERM, catch_headless_exit);
+
+    if (pthread_mutex_init(&Winthread.lock, NULL) != 0) {
+        exit_toxic_err(FATALERR_MUTEX_INIT, "failed in run_headless");
+    }
+
+    if (scheduler_init() != 0) {
+        exit_toxic_err(FATALERR_MUTEX_INIT, "failed in run_headless");
+    }
+
+    if (headless_init(toxic, toxic->run_opts->headless_socket) != 0) {
+        exit_toxic_err(FATALERR_THREAD_CREATE, "failed to start the headless server on %s",
+                       toxic->run_opts->headless_socket);
+    }
+
+    const int nodeslist_ret = load_DHT_nodeslist(toxic);
+
+    if (nodeslist_ret != 0) {
+        fprintf(stderr, "DHT nodeslist failed to load (error %d)\n", nodeslist_ret);
+    }
+
+    init_scheduler_tasks(toxic);
+
+    while (!Winthread.sig_exit_toxic) {
+        scheduler_iterate();
+    }
+
+    pthread_mutex_lock(&Winthread.lock);
+    exit_toxic_success(toxic);
+}
+
 static void print_usage(void)
 {
     fprintf(stderr, "usage: toxic [OPTION] [FILE ...]\n");
@@ -906,6 +1087,7 @@ static void print_usage(void)
     fprintf(stderr, "  -e, --encrypt-data       Encrypt an unencrypted data file\n");
     fprintf(stderr, "  -f, --file               Use specified data file\n");
     fprintf(stderr, "  -h, --help               Show this message and exit\n");
+    fprintf(stderr, "  -H, --headless           Run without a UI, serving JSON-RPC on a Unix socket: Requires [path]\n");
     fprintf(stderr, "  -l, --logging            Enable toxcore logging: Requires [log_path | stderr]\n");
     fprintf(stderr, "  -L, --no-lan             Disable local discovery\n");
     fprintf(stderr, "  -n, --nodes              Use specified DHTnodes file\n");
@@ -913,6 +1095,7 @@ static void print_usage(void)
     fprintf(stderr, "  -p, --SOCKS5-proxy       Use SOCKS5 proxy: Requires [IP] [port]\n");
     fprintf(stderr, "  -P, --HTTP-proxy         Use HTTP proxy: Requires [IP] [port]\n");
     fprintf(stderr, "  -r, --namelist           Use specified name lookup server list\n");
+    fprintf(stderr, "  -S, --startup-profile    Print a breakdown of the time spent on startup\n");
     fprintf(stderr, "  -t, --force-tcp          Force toxic to use a TCP connection (use with proxies)\n");
     fprintf(stderr, "  -T, --tcp-server         Act as a TCP relay server: Requires [port]\n");
     fprintf(stderr, "  -u, --unencrypt-data     Unencrypt an encrypted data file\n");
@@ -945,8 +1128,10 @@ static void parse_args(Toxic *toxic, int argc, char *argv[])
         {"no-lan", no_argument, 0, 'L'},
         {"nodes", required_argument, 0, 'n'},
         {"help", no_argument, 0, 'h'},
+        {"headless", required_argument, 0, 'H'},
         {"noconnect", no_argument, 0, 'o'},
         {"namelist", required_argument, 0, 'r'},
+        {"startup-profile", no_argument, 0, 'S'},
         {"force-tcp", no_argument, 0, 't'},
         {"tcp-server", required_argument, 0, 'T'},
         {"SOCKS5-proxy", required_argument, 0, 'p'},
@@ -956,7 +1141,7 @@ static void parse_args(Toxic *toxic, int argc, char *argv[])
         {NULL, no_argument, NULL, 0},
     };
 
-    const char *opts_str = "4bdehLotuxvc:f:l:n:r:p:P:T:";
+    const char *opts_str = "4bdehLoStuxvc:f:H:l:n:r:p:P:T:";
     int opt = 0;
     int indexptr = 0;
 
@@ -1131,6 +1316,22 @@ static void parse_args(Toxic *toxic, int argc, char *argv[])
                 break;
             }
 
+            case 'H': {
+                if (optarg == NULL) {
+                    queue_init_message("Invalid argument for option: %d", opt);
+                    break;
+                }
+
+                run_opts->headless = true;
+                snprintf(run_opts->headless_socket, sizeof(run_opts->headless_socket), "%s", optarg);
+                break;
+            }
+
+            case 'S': {
+                run_opts->startup_profile = true;
+                break;
+            }
+
             case 't': {
                 run_opts->force_tcp = true;
                 break;
@@ -1262,6 +1463,8 @@ int main(int argc, char **argv)
     /* Make sure all written files are read/writeable only by the current user. */
     umask(S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
 
+    startup_profile_begin();
+
     srand(time(NULL)); // We use rand() for trivial/non-security related things
 
     Toxic *toxic = toxic_init();
@@ -1276,11 +1479,10 @@ int main(int argc, char **argv)
     Run_Options *run_opts = toxic->run_opts;
     Windows *windows = toxic->windows;
 
-    /* Use the -b flag to enable stderr */
-    if (!run_opts->debug) {
-        if (!freopen("/dev/null", "w", stderr)) {
-            fprintf(stderr, "Warning: failed to enable stderr\n");
-        }
+    /* Use the -b flag to enable stderr. A headless daemon has no terminal to report fatal errors on,
+     * so it keeps stderr for them. */
+    if (!run_opts->debug && !run_opts->headless) {
+        disable_stderr();
     }
 
     if (run_opts->encrypt_data && run_opts->unencrypt_data) {
@@ -1295,7 +1497,10 @@ int main(int argc, char **argv)
 
     const bool datafile_exists = file_exists(toxic->client_data.data_path);
 
-    if (!datafile_exists && !run_opts->unencrypt_data) {
+    if (run_opts->headless) {
+        /* There's no terminal to prompt on. Encrypted profiles need password_eval, see load_tox() */
+        run_opts->encrypt_data = 0;
+    } else if (!datafile_exists && !run_opts->unencrypt_data) {
         first_time_encrypt(&toxic->client_data, "Creating new data file. Would you like to encrypt it? Y/n (q to quit)");
     } else if (run_opts->encrypt_data) {
         first_time_encrypt(&toxic->client_data, "Encrypt existing data file? Y/n (q to quit)");
@@ -1315,6 +1520,8 @@ int main(int argc, char **argv)
         queue_init_message("Using '%s' config file", run_opts->config_path);
     }
 
+    startup_profile_mark("settings");
+
     const int curl_init = curl_global_init(CURL_GLOBAL_ALL);
     const int nameserver_ret = name_lookup_init(run_opts->nameserver_path, curl_init);
 
@@ -1326,22 +1533,34 @@ int main(int argc, char **argv)
         fprintf(stderr, "Name lookup server list does not contain any valid entries\n");
     }
 
+    startup_profile_mark("name lookup");
+
 #ifdef X11
 
     if (init_x11focus(&toxic->x11_focus) == -1) {
         queue_init_message("X failed to initialize");
     }
 
+    startup_profile_mark("x11");
+
 #endif /* X11 */
 
     if (!load_toxic(toxic)) {
         exit_toxic_err(FATALERR_TOX_INIT, "Failed in main");
     }
 
+    if (autosave_init(toxic) != 0) {
+        exit_toxic_err(FATALERR_THREAD_CREATE, "failed in main");
+    }
+
     if (run_opts->encrypt_data && !datafile_exists) {
         run_opts->encrypt_data = 0;
     }
 
+    if (run_opts->headless) {
+        run_headless(toxic);
+    }
+
     init_term(c_config, run_opts->default_locale);
 
     init_windows(toxic);
@@ -1349,8 +1568,13 @@ int main(int argc, char **argv)
 
     prompt_init_statusbar(toxic, !datafile_exists);
 
+    startup_profile_mark("terminal");
+
     load_groups(toxic);
+    startup_profile_mark("groups");
+
     load_conferences(toxic);
+    startup_profile_mark("conferences");
 
     const int fs_ret = settings_load_friends(run_opts);
 
@@ -1370,12 +1594,18 @@ int main(int argc, char **argv)
         queue_init_message("Failed to load conference config settings: error %d", cs_ret);
     }
 
+    startup_profile_mark("chat settings");
+
     set_active_window_by_type(windows, WINDOW_TYPE_PROMPT);
 
     if (pthread_mutex_init(&Winthread.lock, NULL) != 0) {
         exit_toxic_err(FATALERR_MUTEX_INIT, "failed in main");
     }
 
+    if (scheduler_init() != 0) {
+        exit_toxic_err(FATALERR_MUTEX_INIT, "failed in main");
+    }
+
 #ifdef AUDIO
 
     toxic->av = init_audio(toxic);
@@ -1393,11 +1623,6 @@ int main(int argc, char **argv)
 
 #endif /* VIDEO */
 
-    /* AV thread */
-    if (pthread_create(&av_thread.tid, NULL, thread_av, (void *) toxic->av) != 0) {
-        exit_toxic_err(FATALERR_THREAD_CREATE, "failed in main");
-    }
-
     set_al_device(input, c_config->audio_in_dev);
     set_al_device(output, c_config->audio_out_dev);
 
@@ -1409,21 +1634,22 @@ int main(int argc, char **argv)
 
 #endif /* AUDIO */
 
+    startup_profile_mark("audio");
+
     /* thread for ncurses UI */
     if (pthread_create(&Winthread.tid, NULL, thread_winref, (void *) toxic) != 0) {
         exit_toxic_err(FATALERR_THREAD_CREATE, "failed in main");
     }
 
-    /* thread for message queue */
-    if (pthread_create(&cqueue_thread.tid, NULL, thread_cqueue, (void *) toxic) != 0) {
-        exit_toxic_err(FATALERR_THREAD_CREATE, "failed in main");
-    }
+    startup_profile_mark("ui thread");
 
 #ifdef PYTHON
 
-    init_python(toxic->tox);
+    init_python(toxic);
     invoke_autoruns(toxic->home_window, c_config->autorun_path);
 
+    startup_profile_mark("python");
+
 #endif /* PYTHON */
 
     init_notify(60, c_config->notification_timeout);
@@ -1433,14 +1659,23 @@ int main(int argc, char **argv)
         queue_init_message("Failed to init mplex auto-away.");
     }
 
+    startup_profile_mark("notifications");
+
     const int nodeslist_ret = load_DHT_nodeslist(toxic);
 
     if (nodeslist_ret != 0) {
         queue_init_message("DHT nodeslist failed to load (error %d)", nodeslist_ret);
     }
 
+    startup_profile_mark("nodes list");
+
     pthread_mutex_lock(&Winthread.lock);
     print_init_messages(toxic->home_window, c_config);
+
+    if (run_opts->startup_profile) {
+        print_startup_profile(toxic);
+    }
+
     flag_interface_refresh();
     pthread_mutex_unlock(&Winthread.lock);
 
@@ -1449,27 +1684,9 @@ int main(int argc, char **argv)
     snprintf(avatarstr, sizeof(avatarstr), "/avatar %s", c_config->avatar_path);
     execute(home_window->chatwin->history, home_window, toxic, avatarstr, GLOBAL_COMMAND_MODE);
 
-    time_t last_save = get_unix_time();
+    init_scheduler_tasks(toxic);
 
     while (true) {
-        do_toxic(toxic);
-
-        const time_t cur_time = get_unix_time();
-
-        if (c_config->autosave_freq > 0 && timed_out(last_save, c_config->autosave_freq)) {
-            pthread_mutex_lock(&Winthread.lock);
-
-            if (store_data(toxic) != 0) {
-                line_info_add(home_window, c_config, false, NULL, NULL, SYS_MSG, 0, RED,
-                              "WARNING: Failed to save to data file");
-            }
-
-            pthread_mutex_unlock(&Winthread.lock);
-
-            last_save = cur_time;
-        }
-
-        const long int sleep_duration = tox_iteration_interval(toxic->tox) * 1000;
-        sleep_thread(sleep_duration);
+        scheduler_iterate();
     }
 }
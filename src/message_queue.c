@@ -26,6 +26,7 @@
 #include "log.h"
 #include "message_queue.h"
 #include "misc_tools.h"
+#include "scheduler.h"
 #include "toxic.h"
 #include "windows.h"
 
@@ -73,6 +74,9 @@ void cqueue_add(struct chat_queue *q, const char *msg, size_t len, uint8_t type,
     }
 
     q->end = new_m;
+
+    /* Send right away instead of waiting for the next retry interval */
+    scheduler_trigger(SCHED_TASK_CQUEUE);
 }
 
 /* update line to show receipt was received after queue removal */
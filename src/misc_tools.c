@@ -20,14 +20,24 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE    /* needed for wcwidth() */
+#endif
+
 #include <assert.h>
 #include <arpa/inet.h>
 #include <ctype.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <wchar.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "file_transfers.h"
 #include "friendlist.h"
@@ -263,8 +273,125 @@ int wstring_is_empty(const wchar_t *string)
     return string[0] == L'\0';
 }
 
+size_t ascii_prefix_len(const char *s, size_t length)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+
+    for (; i + 32 <= length; i += 32) {
+        const __m128i a = _mm_loadu_si128((const __m128i *)(const void *) &s[i]);
+        const __m128i b = _mm_loadu_si128((const __m128i *)(const void *) &s[i + 16]);
+
+        /* the high bit of every byte of a multibyte UTF-8 sequence is set */
+        if (_mm_movemask_epi8(_mm_or_si128(a, b)) != 0) {
+            break;
+        }
+    }
+
+#else
+
+    for (; i + 16 <= length; i += 16) {
+        uint64_t a;
+        uint64_t b;
+        memcpy(&a, &s[i], sizeof(a));
+        memcpy(&b, &s[i + 8], sizeof(b));
+
+        if (((a | b) & UINT64_C(0x8080808080808080)) != 0) {
+            break;
+        }
+    }
+
+#endif /* __SSE2__ */
+
+    while (i < length && (unsigned char) s[i] < 0x80) {
+        ++i;
+    }
+
+    return i;
+}
+
+void ascii_to_wcs(wchar_t *buf, const char *s, size_t length)
+{
+    size_t i = 0;
+
+    /* unrolled so the compiler can vectorize the byte to wchar_t widening */
+    for (; i + 16 <= length; i += 16) {
+        for (size_t j = 0; j < 16; ++j) {
+            buf[i + j] = (wchar_t)(unsigned char) s[i + j];
+        }
+    }
+
+    for (; i < length; ++i) {
+        buf[i] = (wchar_t)(unsigned char) s[i];
+    }
+}
+
+/* Code points below this value have their display width cached */
+#define WIDTH_CACHE_SIZE 0x3400
+
+/* Cached wcwidth() values for the Latin, Greek, Cyrillic, Hebrew, Arabic, Indic and CJK
+ * punctuation/kana blocks, stored as width + 2 so that 0 means the character hasn't been
+ * looked up yet. Entries are filled on first use from any thread; a race only means that
+ * wcwidth() gets called twice for the same character. */
+static atomic_schar width_cache[WIDTH_CACHE_SIZE];
+
+int wchar_width(wchar_t wc)
+{
+    /* printable ASCII */
+    if (wc >= 0x20 && wc < 0x7f) {
+        return 1;
+    }
+
+    if (wc < 0 || wc >= WIDTH_CACHE_SIZE) {
+        return wcwidth(wc);
+    }
+
+    const int cached = atomic_load_explicit(&width_cache[wc], memory_order_relaxed);
+
+    if (cached != 0) {
+        return cached - 2;
+    }
+
+    const int width = wcwidth(wc);
+    atomic_store_explicit(&width_cache[wc], (signed char)(width + 2), memory_order_relaxed);
+
+    return width;
+}
+
+int wcs_width(const wchar_t *s, size_t n)
+{
+    int width = 0;
+
+    for (size_t i = 0; i < n && s[i] != L'\0'; ++i) {
+        const int w = wchar_width(s[i]);
+
+        if (w < 0) {
+            return -1;
+        }
+
+        width += w;
+    }
+
+    return width;
+}
+
 int mbs_to_wcs_buf(wchar_t *buf, const char *string, size_t n)
 {
+    const size_t length = strlen(string);
+
+    /* ASCII maps one to one onto wide characters in every locale we support */
+    if (ascii_prefix_len(string, length) == length) {
+        if (n < length + 1) {
+            return -1;
+        }
+
+        ascii_to_wcs(buf, string, length);
+        buf[length] = L'\0';
+
+        return length;
+    }
+
     size_t len = mbstowcs(NULL, string, 0) + 1;
 
     if (n < len) {
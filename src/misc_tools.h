@@ -124,6 +124,30 @@ int wstring_is_empty(const wchar_t *string);
 /* converts a multibyte string to a wide character string (must provide buffer) */
 int char_to_wcs_buf(wchar_t *buf, const char *string, size_t n);
 
+/*
+ * Returns the number of bytes at the start of `s` that are 7-bit ASCII, looking at no more
+ * than `length` bytes. Checks 16 or 32 bytes per step.
+ */
+size_t ascii_prefix_len(const char *s, size_t length);
+
+/* Widens the first `length` bytes of `s`, which must all be ASCII, into `buf`. */
+void ascii_to_wcs(wchar_t *buf, const char *s, size_t length);
+
+/*
+ * Same as wcwidth() but answers printable ASCII without a libc call and caches the result
+ * for common non-ASCII characters. The locale must be set before the first call.
+ */
+int wchar_width(wchar_t wc);
+
+/*
+ * Same as wcswidth() but uses wchar_width() for each character.
+ *
+ * Returns the number of columns needed to display the first `n` characters of `s`, or up
+ * to the first null character.
+ * Returns -1 if a non-printable character is encountered.
+ */
+int wcs_width(const wchar_t *s, size_t n);
+
 /* Converts a multibyte string to a wide character string and puts in `buf`.
  *
  * `buf` must have room for at least `n` wide characters (wchar_t's).
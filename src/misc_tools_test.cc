@@ -2,6 +2,11 @@
 
 #include <gtest/gtest.h>
 
+#include <clocale>
+#include <cstring>
+#include <cwchar>
+#include <string>
+
 namespace {
 
 TEST(MultiByteStrings, TextLength)
@@ -10,4 +15,46 @@ TEST(MultiByteStrings, TextLength)
     EXPECT_EQ(mbs_to_wcs_buf(buf, "Hello, world!", 100), 13);
 }
 
+TEST(MultiByteStrings, AsciiBufferTooSmall)
+{
+    wchar_t buf[13];
+    EXPECT_EQ(mbs_to_wcs_buf(buf, "Hello, world!", 13), -1);
+}
+
+TEST(MultiByteStrings, AsciiPrefixLength)
+{
+    const std::string ascii(100, 'a');
+    EXPECT_EQ(ascii_prefix_len(ascii.c_str(), ascii.size()), ascii.size());
+
+    // the non-ASCII byte can be found in every position of the vectorized and scalar loops
+    for (size_t i = 0; i < ascii.size(); ++i) {
+        std::string s = ascii;
+        s[i] = '\xc3';
+        EXPECT_EQ(ascii_prefix_len(s.c_str(), s.size()), i);
+    }
+
+    EXPECT_EQ(ascii_prefix_len(ascii.c_str(), 7), 7u);
+}
+
+TEST(MultiByteStrings, WidthMatchesLibc)
+{
+    if (std::setlocale(LC_ALL, "C.UTF-8") == nullptr) {
+        GTEST_SKIP() << "C.UTF-8 locale not available";
+    }
+
+    const wchar_t chars[] = {L'a', L'~', L'\t', 0xe9, 0x3b1, 0x416, 0x5d0, 0x301, 0x3042, 0x4e00, 0x1f600};
+
+    for (wchar_t wc : chars) {
+        EXPECT_EQ(wchar_width(wc), wcwidth(wc)) << "U+" << std::hex << static_cast<unsigned>(wc);
+        // the second lookup is served from the cache
+        EXPECT_EQ(wchar_width(wc), wcwidth(wc)) << "U+" << std::hex << static_cast<unsigned>(wc);
+    }
+
+    const wchar_t *str = L"h\u00e9llo \u65e5\u672c";
+    EXPECT_EQ(wcs_width(str, std::wcslen(str)), wcswidth(str, std::wcslen(str)));
+    EXPECT_EQ(wcs_width(L"tab\there", 8), -1);
+
+    std::setlocale(LC_ALL, "C");
+}
+
 }  // namespace
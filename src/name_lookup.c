@@ -28,11 +28,12 @@
 #include <string.h>
 
 #include "configdir.h"
-#include "curl_util.h"
 #include "global_commands.h"
 #include "line_info.h"
 #include "misc_tools.h"
+#include "name_resolver.h"
 #include "run_options.h"
+#include "scheduler.h"
 #include "toxic.h"
 #include "windows.h"
 
@@ -42,33 +43,40 @@
 #define MAX_DOMAIN_SIZE 32
 #define MAX_SERVER_LINE MAX_DOMAIN_SIZE + (SERVER_KEY_SIZE * 2) + 3
 
+/* File in the config directory that successful lookups are cached in */
+#define NAME_CACHE_FILENAME "name_lookup_cache"
+
+/* Number of seconds a successful lookup is cached for */
+#define NAME_CACHE_TTL (60 * 60 * 24)
+
 static struct Nameservers {
     int     lines;
     char    names[MAX_SERVERS][MAX_DOMAIN_SIZE];
     char    keys[MAX_SERVERS][SERVER_KEY_SIZE];
 } Nameservers;
 
-static struct thread_data {
-    ToxWindow *self;
-    char    id_bin[TOX_ADDRESS_SIZE];
-    char    addr[MAX_STR_SIZE];
-    char    msg[MAX_STR_SIZE];
-    bool    disabled;
-    volatile bool busy;
-} t_data;
-
-static struct lookup_thread {
-    pthread_t tid;
-    pthread_attr_t attr;
-} lookup_thread;
-
-static void clear_thread_data(void)
-{
-    t_data = (struct thread_data) {
-        0
-    };
-}
+/* A lookup waiting for the resolver, or a completed one waiting to be reported */
+struct Lookup_Request {
+    Toxic *toxic;
+    uint32_t window_id;
+    char msg[MAX_STR_SIZE];
+
+    Name_Resolver_Result result;
+    struct Lookup_Request *next;
+};
+
+static struct Name_Lookup {
+    Name_Resolver *resolver;
+    bool disabled;
 
+    /* Lookups completed by the resolver's worker thread, oldest first. Guarded by `lock`. */
+    pthread_mutex_t lock;
+    struct Lookup_Request *done;
+} Name_Lookup = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Requires Winthread.lock */
 __attribute__((format(printf, 3, 4)))
 static int lookup_error(ToxWindow *self, const Client_Config *c_config, const char *errmsg, ...)
 {
@@ -79,9 +87,7 @@ static int lookup_error(ToxWindow *self, const Client_Config *c_config, const ch
     vsnprintf(frmt_msg, sizeof(frmt_msg), errmsg, args);
     va_end(args);
 
-    pthread_mutex_lock(&Winthread.lock);
     line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "name lookup failed: %s", frmt_msg);
-    pthread_mutex_unlock(&Winthread.lock);
 
     return -1;
 }
@@ -199,248 +205,217 @@ static bool get_domain_match(char *pubkey, char *out_domain, size_t out_domain_s
     return false;
 }
 
-/* Converts Tox ID string contained in recv_data to binary format and puts it in thread's ID buffer.
- *
- * Returns 0 on success.
- * Returns -1 on failure.
- */
-#define ID_PREFIX "\"tox_id\": \""
-static int process_response(struct Recv_Curl_Data *recv_data)
+/* Returns the window that started the lookup, or the home window if it has since been closed. */
+static ToxWindow *request_window(const struct Lookup_Request *req)
 {
-    size_t prefix_size = strlen(ID_PREFIX);
-
-    if (recv_data->length < TOX_ADDRESS_SIZE * 2 + prefix_size) {
-        return -1;
-    }
-
-    const char *IDstart = strstr(recv_data->data, ID_PREFIX);
-
-    if (IDstart == NULL) {
-        return -1;
-    }
-
-    if (strlen(IDstart) < TOX_ADDRESS_SIZE * 2 + prefix_size) {
-        return -1;
-    }
-
-    char ID_string[TOX_ADDRESS_SIZE * 2 + 1];
-    memcpy(ID_string, IDstart + prefix_size, TOX_ADDRESS_SIZE * 2);
-    ID_string[TOX_ADDRESS_SIZE * 2] = 0;
-
-    if (tox_pk_string_to_bytes(ID_string, strlen(ID_string), t_data.id_bin, sizeof(t_data.id_bin)) == -1) {
-        return -1;
-    }
-
-    return 0;
+    ToxWindow *self = get_window_pointer_by_id(req->toxic->windows, req->window_id);
+    return self != NULL ? self : req->toxic->home_window;
 }
 
-static void *lookup_thread_func(void *data)
+/* Reports the outcome of a completed lookup. Requires Winthread.lock. */
+static void report_lookup(const struct Lookup_Request *req)
 {
-    struct curl_slist *headers = NULL;
-    CURL *c_handle = NULL;
-    struct Recv_Curl_Data *recv_data = NULL;
-
-    Toxic *toxic = (Toxic *) data;
-
-    if (toxic == NULL) {
-        goto on_exit;
-    }
-
+    Toxic *toxic = req->toxic;
     const Client_Config *c_config = toxic->c_config;
-    const Run_Options *run_opts = toxic->run_opts;
-
-    ToxWindow *self = t_data.self;
+    ToxWindow *self = request_window(req);
 
-    char input_domain[MAX_STR_SIZE];
-    char name[MAX_STR_SIZE];
-
-    if (parse_addr(t_data.addr, name, sizeof(name), input_domain, sizeof(input_domain)) == -1) {
-        lookup_error(self, c_config, "Input must be a 76 character Tox ID or an address in the form: username@domain");
-        goto on_exit;
-    }
+    switch (req->result.error) {
+        case NAME_RESOLVER_ERR_NONE: {
+            cmd_add_helper(self, toxic, req->result.tox_id, req->msg);
+            break;
+        }
 
-    char nameserver_key[SERVER_KEY_SIZE];
-    char real_domain[MAX_DOMAIN_SIZE];
+        case NAME_RESOLVER_ERR_HTTP: {
+            if (req->result.curl_code != CURLE_OK) {
+                lookup_error(self, c_config, "HTTPS lookup error (libcurl error %d)", req->result.curl_code);
+            } else {
+                lookup_error(self, c_config, "HTTPS lookup error (HTTP status %ld)", req->result.http_code);
+            }
 
-    if (!get_domain_match(nameserver_key, real_domain, sizeof(real_domain), input_domain)) {
-        lookup_error(self, c_config, "Name server domain not found.");
-        goto on_exit;
-    }
+            break;
+        }
 
-    c_handle = curl_easy_init();
+        case NAME_RESOLVER_ERR_RESPONSE: {
+            lookup_error(self, c_config, "Bad response.");
+            break;
+        }
 
-    if (c_handle == NULL) {
-        lookup_error(self, c_config, "curl handler error");
-        goto on_exit;
+        default: {
+            break;
+        }
     }
+}
 
-    recv_data = calloc(1, sizeof(struct Recv_Curl_Data));
+/* Called by the resolver, either from name_lookup() with Winthread.lock held or from
+ * its worker thread. Results from the worker are handed to the name lookup task so that
+ * the worker never waits for Winthread.lock. */
+static void lookup_done(const Name_Resolver_Result *result, void *user_data)
+{
+    struct Lookup_Request *req = (struct Lookup_Request *) user_data;
 
-    if (recv_data == NULL) {
-        lookup_error(self, c_config, "memory allocation error");
-        goto on_exit;
+    if (result->from_cache) {
+        cmd_add_helper(request_window(req), req->toxic, result->tox_id, req->msg);
+        free(req);
+        return;
     }
 
-    char post_data[MAX_STR_SIZE + 30];
-
-    snprintf(post_data, sizeof(post_data), "{\"action\": 3, \"name\": \"%s\"}", name);
-
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-
-    headers = curl_slist_append(headers, "charsets: utf-8");
-
-    int ret = curl_easy_setopt(c_handle, CURLOPT_HTTPHEADER, headers);
-
-    if (ret != CURLE_OK) {
-        lookup_error(self, c_config, "Failed to set http headers (libcurl error %d)", ret);
-        goto on_exit;
+    if (result->error == NAME_RESOLVER_ERR_SHUTDOWN) {
+        free(req);
+        return;
     }
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_URL, real_domain);
+    req->result = *result;
+    req->next = NULL;
 
-    if (ret != CURLE_OK) {
-        lookup_error(self, c_config, "Failed to set url (libcurl error %d)", ret);
-        goto on_exit;
-    }
+    pthread_mutex_lock(&Name_Lookup.lock);
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_WRITEFUNCTION, curl_cb_write_data);
+    struct Lookup_Request **tail = &Name_Lookup.done;
 
-    if (ret != CURLE_OK) {
-        lookup_error(self, c_config, "Failed to set write function callback (libcurl error %d)", ret);
-        goto on_exit;
+    while (*tail != NULL) {
+        tail = &(*tail)->next;
     }
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_WRITEDATA, recv_data);
+    *tail = req;
 
-    if (ret != CURLE_OK) {
-        lookup_error(self, c_config, "Failed to set write data (libcurl error %d)", ret);
-        goto on_exit;
-    }
+    pthread_mutex_unlock(&Name_Lookup.lock);
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+    scheduler_trigger(SCHED_TASK_NAME_LOOKUP);
+}
 
-    if (ret != CURLE_OK) {
-        lookup_error(self, c_config, "Failed to set useragent (libcurl error %d)", ret);
-        goto on_exit;
-    }
+static void name_lookup_task_run(void *data)
+{
+    UNUSED_VAR(data);
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_POSTFIELDS, post_data);
+    pthread_mutex_lock(&Name_Lookup.lock);
+    struct Lookup_Request *req = Name_Lookup.done;
+    Name_Lookup.done = NULL;
+    pthread_mutex_unlock(&Name_Lookup.lock);
 
-    if (ret != CURLE_OK) {
-        lookup_error(self, c_config, "Failed to set post data (libcurl error %d)", ret);
-        goto on_exit;
+    if (req == NULL) {
+        return;
     }
 
-    int proxy_ret = set_curl_proxy(c_handle, run_opts->proxy_address, run_opts->proxy_port, run_opts->proxy_type);
+    pthread_mutex_lock(&Winthread.lock);
 
-    if (proxy_ret != 0) {
-        lookup_error(self, c_config, "Failed to set proxy (error %d)\n", proxy_ret);
-        goto on_exit;
+    while (req != NULL) {
+        struct Lookup_Request *next = req->next;
+        report_lookup(req);
+        free(req);
+        req = next;
     }
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_USE_SSL, CURLUSESSL_ALL);
+    pthread_mutex_unlock(&Winthread.lock);
+}
 
-    if (ret != CURLE_OK) {
-        lookup_error(self, c_config, "TLS could not be enabled (libcurl error %d)", ret);
-        goto on_exit;
-    }
+static int64_t name_lookup_task_interval(void *data)
+{
+    UNUSED_VAR(data);
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
+    return -1;
+}
 
-    if (ret != CURLE_OK) {
-        lookup_error(self, c_config, "TLSv1.2 could not be set (libcurl error %d)", ret);
-        goto on_exit;
+/* Creates the resolver the first time a lookup is made.
+ *
+ * Returns 0 on success.
+ * Returns -1 on failure.
+ */
+static int init_resolver(const Run_Options *run_opts)
+{
+    if (Name_Lookup.resolver != NULL) {
+        return 0;
     }
 
-    ret = curl_easy_setopt(c_handle, CURLOPT_SSL_CIPHER_LIST, TLS_CIPHER_SUITE_LIST);
+    char cache_path[PATH_MAX];
+    char *config_dir = get_user_config_dir();
 
-    if (ret != CURLE_OK) {
-        lookup_error(self, c_config, "Failed to set TLS cipher list (libcurl error %d)", ret);
-        goto on_exit;
+    if (config_dir != NULL) {
+        snprintf(cache_path, sizeof(cache_path), "%s%s%s", config_dir, CONFIGDIR, NAME_CACHE_FILENAME);
+        free(config_dir);
     }
 
-    ret = curl_easy_perform(c_handle);
-
-    if (ret != CURLE_OK) {
-        /* If system doesn't support any of the specified ciphers suites, fall back to default */
-        if (ret == CURLE_SSL_CIPHER) {
-            ret = curl_easy_setopt(c_handle, CURLOPT_SSL_CIPHER_LIST, NULL);
-
-            if (ret != CURLE_OK) {
-                lookup_error(self, c_config, "Failed to set TLS cipher list (libcurl error %d)", ret);
-                goto on_exit;
-            }
-
-            ret = curl_easy_perform(c_handle);
-        }
+    const Name_Resolver_Options opts = {
+        .proxy_address = run_opts->proxy_address,
+        .proxy_port = run_opts->proxy_port,
+        .proxy_type = run_opts->proxy_type,
+        .cache_path = config_dir != NULL ? cache_path : NULL,
+        .cache_ttl = NAME_CACHE_TTL,
+    };
 
-        if (ret != CURLE_OK) {
-            lookup_error(self, c_config, "HTTPS lookup error (libcurl error %d)", ret);
-            goto on_exit;
-        }
-    }
+    Name_Lookup.resolver = name_resolver_new(&opts);
 
-    if (process_response(recv_data) == -1) {
-        lookup_error(self, c_config, "Bad response.");
-        goto on_exit;
+    if (Name_Lookup.resolver == NULL) {
+        return -1;
     }
 
-    pthread_mutex_lock(&Winthread.lock);
-    cmd_add_helper(self, toxic, t_data.id_bin, t_data.msg);
-    pthread_mutex_unlock(&Winthread.lock);
-
-on_exit:
+    scheduler_set_task(SCHED_TASK_NAME_LOOKUP, "namelookup", name_lookup_task_run, name_lookup_task_interval, NULL);
 
-    free(recv_data);
-    curl_slist_free_all(headers);  // passing null has no effect
-    curl_easy_cleanup(c_handle);  // passing null has no effect
-    clear_thread_data();
-    pthread_attr_destroy(&lookup_thread.attr);
-    pthread_exit(NULL);
+    return 0;
 }
 
-/* Attempts to do a tox name lookup.
+/* Attempts to do a tox name lookup. The friend request is sent once the lookup completes,
+ * which may be before this function returns if the name is cached.
  *
  * Returns true on success.
  */
-bool name_lookup(ToxWindow *self, Toxic *toxic, const char *id_bin, const char *addr, const char *message)
+bool name_lookup(ToxWindow *self, Toxic *toxic, const char *addr, const char *message)
 {
     const Client_Config *c_config = toxic->c_config;
 
-    if (t_data.disabled) {
+    if (Name_Lookup.disabled) {
         line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "nameservers list is empty or does not exist.");
         return false;
     }
 
-    if (t_data.busy) {
+    char input_domain[MAX_STR_SIZE];
+    char name[MAX_STR_SIZE];
+
+    if (parse_addr(addr, name, sizeof(name), input_domain, sizeof(input_domain)) == -1) {
         line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0,
-                      "Please wait for previous name lookup to finish.");
+                      "name lookup failed: Input must be a 76 character Tox ID or an address in the form: username@domain");
         return false;
     }
 
-    snprintf(t_data.id_bin, sizeof(t_data.id_bin), "%s", id_bin);
-    snprintf(t_data.addr, sizeof(t_data.addr), "%s", addr);
-    snprintf(t_data.msg, sizeof(t_data.msg), "%s", message);
-    t_data.self = self;
-    t_data.busy = true;
+    char nameserver_key[SERVER_KEY_SIZE];
+    char real_domain[MAX_STR_SIZE];
 
-    if (pthread_attr_init(&lookup_thread.attr) != 0) {
-        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, RED, "Error: lookup thread attr failed to init");
-        clear_thread_data();
+    if (!get_domain_match(nameserver_key, real_domain, sizeof(real_domain), input_domain)) {
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "name lookup failed: Name server domain not found.");
         return false;
     }
 
-    if (pthread_attr_setdetachstate(&lookup_thread.attr, PTHREAD_CREATE_DETACHED) != 0) {
-        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, RED, "Error: lookup thread attr failed to set");
-        pthread_attr_destroy(&lookup_thread.attr);
-        clear_thread_data();
+    if (init_resolver(toxic->run_opts) != 0) {
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, RED, "Error: name lookup failed to init");
         return false;
     }
 
-    if (pthread_create(&lookup_thread.tid, &lookup_thread.attr, lookup_thread_func, (void *) toxic) != 0) {
-        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, RED, "Error: lookup thread failed to init");
-        pthread_attr_destroy(&lookup_thread.attr);
-        clear_thread_data();
+    struct Lookup_Request *req = calloc(1, sizeof(struct Lookup_Request));
+
+    if (req == NULL) {
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "name lookup failed: memory allocation error");
+        return false;
+    }
+
+    req->toxic = toxic;
+    req->window_id = self->id;
+    snprintf(req->msg, sizeof(req->msg), "%s", message);
+
+    char key[MAX_STR_SIZE * 2 + 1];
+    snprintf(key, sizeof(key), "%s@%s", name, input_domain);
+
+    const int ret = name_resolver_lookup(Name_Lookup.resolver, real_domain, name, key, lookup_done, req);
+
+    if (ret < 0) {
+        free(req);
+    }
+
+    if (ret == -1) {
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0,
+                      "Please wait for previous name lookups to finish.");
+        return false;
+    }
+
+    if (ret < 0) {
+        line_info_add(self, c_config, false, NULL, NULL, SYS_MSG, 0, 0, "name lookup failed: invalid name.");
         return false;
     }
 
@@ -450,7 +425,7 @@ bool name_lookup(ToxWindow *self, Toxic *toxic, const char *id_bin, const char *
 int name_lookup_init(const char *nameserver_path, int curl_init_status)
 {
     if (curl_init_status != 0) {
-        t_data.disabled = true;
+        Name_Lookup.disabled = true;
         return -1;
     }
 
@@ -458,9 +433,31 @@ int name_lookup_init(const char *nameserver_path, int curl_init_status)
     const int ret = load_nameserver_list(path);
 
     if (ret != 0) {
-        t_data.disabled = true;
+        Name_Lookup.disabled = true;
         return ret;
     }
 
     return 0;
 }
+
+void name_lookup_terminate(void)
+{
+    if (Name_Lookup.resolver == NULL) {
+        return;
+    }
+
+    scheduler_set_task(SCHED_TASK_NAME_LOOKUP, "namelookup", NULL, NULL, NULL);
+
+    name_resolver_kill(Name_Lookup.resolver);
+    Name_Lookup.resolver = NULL;
+
+    /* Results that were never reported */
+    struct Lookup_Request *req = Name_Lookup.done;
+    Name_Lookup.done = NULL;
+
+    while (req != NULL) {
+        struct Lookup_Request *next = req->next;
+        free(req);
+        req = next;
+    }
+}
@@ -38,10 +38,18 @@
  */
 int name_lookup_init(const char *nameserver_path, int curl_init_status);
 
-/* Attempts to do a tox name lookup.
+/* Attempts to do a tox name lookup. Lookups run in the background, and a friend request is sent
+ * to the resulting Tox ID once the lookup completes. Results are cached on disk for a day.
  *
- * Returns true on success.
+ * Must be called with Winthread.lock held.
+ *
+ * Returns true if the lookup was started or answered from the cache.
+ */
+bool name_lookup(ToxWindow *self, Toxic *toxic, const char *addr, const char *message);
+
+/* Stops the lookup worker thread. Lookups that haven't completed are dropped without being
+ * reported. Must be called before curl_global_cleanup().
  */
-bool name_lookup(ToxWindow *self, Toxic *toxic, const char *id_bin, const char *addr, const char *message);
+void name_lookup_terminate(void);
 
 #endif /* NAME_LOOKUP */
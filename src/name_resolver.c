@@ -0,0 +1,697 @@
+/*  name_resolver.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "name_resolver.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <curl/curl.h>
+
+#include "curl_util.h"
+#include "misc_tools.h"
+
+/* Maximum number of requests the worker runs at the same time */
+#define MAX_ACTIVE_REQUESTS 4
+
+/* Maximum number of idle connections kept alive by the multi handle */
+#define MAX_CACHED_CONNECTIONS 8
+
+/* Maximum number of names in the cache */
+#define MAX_CACHE_ENTRIES 128
+
+/* How long the worker sleeps in curl_multi_poll() if nothing wakes it up */
+#define WORKER_POLL_TIMEOUT 1000
+
+/* Appended to the cache path while the cache is being saved */
+#define TEMP_CACHE_FILE_EXT ".tmp"
+
+#define MAX_URL_SIZE 256
+#define MAX_POST_DATA_SIZE (NAME_RESOLVER_MAX_KEY + 32)
+
+#define ID_PREFIX "\"tox_id\": \""
+
+struct Cache_Entry {
+    char key[NAME_RESOLVER_MAX_KEY + 1];
+    char tox_id[TOX_ADDRESS_SIZE];
+    long long int expires;  /* unix time; 0 if the entry is unused */
+};
+
+struct Request {
+    char url[MAX_URL_SIZE];
+    char post_data[MAX_POST_DATA_SIZE];
+    char key[NAME_RESOLVER_MAX_KEY + 1];
+    name_resolver_cb *cb;
+    void *user_data;
+
+    CURL *handle;
+    struct curl_slist *headers;
+    struct Recv_Curl_Data recv_data;
+    bool cipher_fallback;   /* true if the request is being retried with the default cipher list */
+};
+
+struct Name_Resolver {
+    CURLM *multi;
+    pthread_t thread;
+
+    /* Requests attached to the multi handle. Only touched by the worker thread. */
+    struct Request *active[MAX_ACTIVE_REQUESTS];
+    int num_active;
+
+    char *proxy_address;
+    uint16_t proxy_port;
+    uint8_t proxy_type;
+    char *cache_path;
+    uint32_t cache_ttl;
+
+    /* Everything below is guarded by `lock` */
+    pthread_mutex_t lock;
+    bool stop;
+
+    /* Requests that haven't been handed to the worker yet, in FIFO order */
+    struct Request *queue[NAME_RESOLVER_MAX_PENDING];
+    int queue_head;
+    int queue_count;
+    int num_pending;    /* queued requests plus those the worker is running */
+
+    struct Cache_Entry cache[MAX_CACHE_ENTRIES];
+    Name_Resolver_Stats stats;
+};
+
+/* Returns the unexpired cache entry for `key`, or NULL. Requires the lock. */
+static struct Cache_Entry *cache_find(Name_Resolver *resolver, const char *key, long long int now)
+{
+    for (size_t i = 0; i < MAX_CACHE_ENTRIES; ++i) {
+        struct Cache_Entry *entry = &resolver->cache[i];
+
+        if (entry->expires > now && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/* Writes the cache to disk. The new file replaces the old one once it's complete. Only called
+ * from the worker thread, and the lock is only held while the entries are copied. */
+static void cache_save(Name_Resolver *resolver)
+{
+    if (resolver->cache_path == NULL) {
+        return;
+    }
+
+    struct Cache_Entry *entries = malloc(sizeof(resolver->cache));
+
+    if (entries == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&resolver->lock);
+    memcpy(entries, resolver->cache, sizeof(resolver->cache));
+    pthread_mutex_unlock(&resolver->lock);
+
+    char temp_path[PATH_MAX];
+    snprintf(temp_path, sizeof(temp_path), "%s%s", resolver->cache_path, TEMP_CACHE_FILE_EXT);
+
+    FILE *fp = fopen(temp_path, "w");
+
+    if (fp == NULL) {
+        free(entries);
+        return;
+    }
+
+    const long long int now = (long long int) time(NULL);
+
+    for (size_t i = 0; i < MAX_CACHE_ENTRIES; ++i) {
+        const struct Cache_Entry *entry = &entries[i];
+
+        if (entry->expires <= now) {
+            continue;
+        }
+
+        char id_string[TOX_ADDRESS_SIZE * 2 + 1];
+
+        for (size_t j = 0; j < TOX_ADDRESS_SIZE; ++j) {
+            snprintf(&id_string[j * 2], 3, "%02X", (unsigned char) entry->tox_id[j]);
+        }
+
+        fprintf(fp, "%lld %s %s\n", entry->expires, id_string, entry->key);
+    }
+
+    free(entries);
+
+    const bool write_failed = ferror(fp) != 0;
+
+    if (fclose(fp) != 0 || write_failed || rename(temp_path, resolver->cache_path) != 0) {
+        remove(temp_path);
+    }
+}
+
+/* Loads the cache from disk, skipping malformed and expired entries. */
+static void cache_load(Name_Resolver *resolver, long long int now)
+{
+    if (resolver->cache_path == NULL) {
+        return;
+    }
+
+    FILE *fp = fopen(resolver->cache_path, "r");
+
+    if (fp == NULL) {
+        return;
+    }
+
+    char line[NAME_RESOLVER_MAX_KEY + TOX_ADDRESS_SIZE * 2 + 32];
+    size_t count = 0;
+
+    while (count < MAX_CACHE_ENTRIES && fgets(line, sizeof(line), fp) != NULL) {
+        char *end;
+        const long long int expires = strtoll(line, &end, 10);
+
+        if (end == line || *end != ' ' || expires <= now) {
+            continue;
+        }
+
+        const char *id_string = end + 1;
+        char *key = strchr(id_string, ' ');
+
+        if (key == NULL || key - id_string != TOX_ADDRESS_SIZE * 2) {
+            continue;
+        }
+
+        ++key;
+        key[strcspn(key, "\n")] = '\0';
+
+        if (string_is_empty(key)) {
+            continue;
+        }
+
+        struct Cache_Entry *entry = &resolver->cache[count];
+
+        if (hex_string_to_bytes(entry->tox_id, TOX_ADDRESS_SIZE, id_string) != 0) {
+            continue;
+        }
+
+        snprintf(entry->key, sizeof(entry->key), "%s", key);
+        entry->expires = expires;
+        ++count;
+    }
+
+    fclose(fp);
+}
+
+/* Adds or refreshes the entry for `key`, evicting the entry closest to expiry if the
+ * cache is full. Requires the lock. */
+static void cache_insert(Name_Resolver *resolver, const char *key, const char *tox_id)
+{
+    const long long int now = (long long int) time(NULL);
+    struct Cache_Entry *entry = cache_find(resolver, key, now);
+
+    if (entry == NULL) {
+        entry = &resolver->cache[0];
+
+        for (size_t i = 1; i < MAX_CACHE_ENTRIES && entry->expires > now; ++i) {
+            if (resolver->cache[i].expires < entry->expires) {
+                entry = &resolver->cache[i];
+            }
+        }
+    }
+
+    snprintf(entry->key, sizeof(entry->key), "%s", key);
+    memcpy(entry->tox_id, tox_id, TOX_ADDRESS_SIZE);
+    entry->expires = now + resolver->cache_ttl;
+}
+
+/* Converts the Tox ID string contained in `recv_data` to binary format and puts it in `tox_id`.
+ *
+ * Returns 0 on success.
+ * Returns -1 on failure.
+ */
+static int process_response(const struct Recv_Curl_Data *recv_data, char *tox_id)
+{
+    const size_t prefix_size = strlen(ID_PREFIX);
+
+    if (recv_data->length < TOX_ADDRESS_SIZE * 2 + prefix_size) {
+        return -1;
+    }
+
+    const char *id_start = strstr(recv_data->data, ID_PREFIX);
+
+    if (id_start == NULL) {
+        return -1;
+    }
+
+    id_start += prefix_size;
+
+    if (strlen(id_start) < TOX_ADDRESS_SIZE * 2 || id_start[TOX_ADDRESS_SIZE * 2] != '"') {
+        return -1;
+    }
+
+    char id_string[TOX_ADDRESS_SIZE * 2 + 1];
+    memcpy(id_string, id_start, TOX_ADDRESS_SIZE * 2);
+    id_string[TOX_ADDRESS_SIZE * 2] = '\0';
+
+    return hex_string_to_bytes(tox_id, TOX_ADDRESS_SIZE, id_string);
+}
+
+static void free_request(struct Request *req)
+{
+    curl_slist_free_all(req->headers);  // passing null has no effect
+    curl_easy_cleanup(req->handle);  // passing null has no effect
+    free(req);
+}
+
+/* Calls the request's callback and frees it. The request must not be attached to the multi handle. */
+static void complete_request(Name_Resolver *resolver, struct Request *req, const Name_Resolver_Result *result)
+{
+    req->cb(result, req->user_data);
+    free_request(req);
+
+    pthread_mutex_lock(&resolver->lock);
+    --resolver->num_pending;
+    pthread_mutex_unlock(&resolver->lock);
+}
+
+static void fail_request(Name_Resolver *resolver, struct Request *req, Name_Resolver_Error error, int curl_code)
+{
+    const Name_Resolver_Result result = {
+        .error = error,
+        .curl_code = curl_code,
+    };
+
+    complete_request(resolver, req, &result);
+}
+
+/* Sets up the easy handle for `req`.
+ *
+ * Return CURLE_OK on success.
+ * Return a curl error code on failure.
+ */
+static int setup_request(const Name_Resolver *resolver, struct Request *req)
+{
+    req->handle = curl_easy_init();
+
+    if (req->handle == NULL) {
+        return CURLE_FAILED_INIT;
+    }
+
+    req->headers = curl_slist_append(req->headers, "Content-Type: application/json");
+    req->headers = curl_slist_append(req->headers, "charsets: utf-8");
+
+    CURL *c_handle = req->handle;
+    int ret = curl_easy_setopt(c_handle, CURLOPT_HTTPHEADER, req->headers);
+
+    if (ret == CURLE_OK) {
+        ret = curl_easy_setopt(c_handle, CURLOPT_URL, req->url);
+    }
+
+    if (ret == CURLE_OK) {
+        ret = curl_easy_setopt(c_handle, CURLOPT_WRITEFUNCTION, curl_cb_write_data);
+    }
+
+    if (ret == CURLE_OK) {
+        ret = curl_easy_setopt(c_handle, CURLOPT_WRITEDATA, &req->recv_data);
+    }
+
+    if (ret == CURLE_OK) {
+        ret = curl_easy_setopt(c_handle, CURLOPT_PRIVATE, req);
+    }
+
+    if (ret == CURLE_OK) {
+        ret = curl_easy_setopt(c_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+    }
+
+    if (ret == CURLE_OK) {
+        ret = curl_easy_setopt(c_handle, CURLOPT_POSTFIELDS, req->post_data);
+    }
+
+    if (ret == CURLE_OK) {
+        ret = curl_easy_setopt(c_handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    }
+
+    if (ret == CURLE_OK) {
+        ret = curl_easy_setopt(c_handle, CURLOPT_USE_SSL, CURLUSESSL_ALL);
+    }
+
+    if (ret == CURLE_OK) {
+        ret = curl_easy_setopt(c_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
+    }
+
+    if (ret == CURLE_OK) {
+        ret = curl_easy_setopt(c_handle, CURLOPT_SSL_CIPHER_LIST, TLS_CIPHER_SUITE_LIST);
+    }
+
+    if (ret != CURLE_OK) {
+        return ret;
+    }
+
+    const int proxy_ret = set_curl_proxy(c_handle, resolver->proxy_address, resolver->proxy_port,
+                                         resolver->proxy_type);
+
+    if (proxy_ret != 0) {
+        return proxy_ret > 0 ? proxy_ret : CURLE_BAD_FUNCTION_ARGUMENT;
+    }
+
+    return CURLE_OK;
+}
+
+static void start_request(Name_Resolver *resolver, struct Request *req)
+{
+    const int ret = setup_request(resolver, req);
+
+    if (ret != CURLE_OK) {
+        fail_request(resolver, req, NAME_RESOLVER_ERR_HTTP, ret);
+        return;
+    }
+
+    if (curl_multi_add_handle(resolver->multi, req->handle) != CURLM_OK) {
+        fail_request(resolver, req, NAME_RESOLVER_ERR_HTTP, CURLE_FAILED_INIT);
+        return;
+    }
+
+    resolver->active[resolver->num_active] = req;
+    ++resolver->num_active;
+}
+
+static void remove_active_request(Name_Resolver *resolver, const struct Request *req)
+{
+    for (int i = 0; i < resolver->num_active; ++i) {
+        if (resolver->active[i] == req) {
+            resolver->active[i] = resolver->active[resolver->num_active - 1];
+            --resolver->num_active;
+            return;
+        }
+    }
+}
+
+/* Handles a request that the multi handle reports as done. */
+static void finish_request(Name_Resolver *resolver, struct Request *req, CURLcode code)
+{
+    curl_multi_remove_handle(resolver->multi, req->handle);
+
+    /* If the system doesn't support any of the specified cipher suites, fall back to the default */
+    if (code == CURLE_SSL_CIPHER && !req->cipher_fallback) {
+        req->cipher_fallback = true;
+        req->recv_data.length = 0;
+
+        if (curl_easy_setopt(req->handle, CURLOPT_SSL_CIPHER_LIST, NULL) == CURLE_OK
+                && curl_multi_add_handle(resolver->multi, req->handle) == CURLM_OK) {
+            return;
+        }
+    }
+
+    remove_active_request(resolver, req);
+
+    Name_Resolver_Result result = {
+        .error = NAME_RESOLVER_ERR_NONE,
+        .curl_code = code,
+    };
+
+    long connections = 0;
+    curl_easy_getinfo(req->handle, CURLINFO_RESPONSE_CODE, &result.http_code);
+    curl_easy_getinfo(req->handle, CURLINFO_NUM_CONNECTS, &connections);
+
+    if (code != CURLE_OK || result.http_code != 200) {
+        result.error = NAME_RESOLVER_ERR_HTTP;
+    } else if (process_response(&req->recv_data, result.tox_id) != 0) {
+        result.error = NAME_RESOLVER_ERR_RESPONSE;
+    }
+
+    pthread_mutex_lock(&resolver->lock);
+
+    ++resolver->stats.requests;
+    resolver->stats.connections += connections;
+
+    if (result.error == NAME_RESOLVER_ERR_NONE) {
+        cache_insert(resolver, req->key, result.tox_id);
+    }
+
+    pthread_mutex_unlock(&resolver->lock);
+
+    if (result.error == NAME_RESOLVER_ERR_NONE) {
+        cache_save(resolver);
+    }
+
+    complete_request(resolver, req, &result);
+}
+
+static void *worker_thread(void *data)
+{
+    Name_Resolver *resolver = (Name_Resolver *) data;
+
+    while (true) {
+        struct Request *ready[MAX_ACTIVE_REQUESTS];
+        int num_ready = 0;
+
+        pthread_mutex_lock(&resolver->lock);
+
+        const bool stop = resolver->stop;
+
+        while (!stop && resolver->num_active + num_ready < MAX_ACTIVE_REQUESTS && resolver->queue_count > 0) {
+            ready[num_ready] = resolver->queue[resolver->queue_head];
+            ++num_ready;
+            resolver->queue_head = (resolver->queue_head + 1) % NAME_RESOLVER_MAX_PENDING;
+            --resolver->queue_count;
+        }
+
+        pthread_mutex_unlock(&resolver->lock);
+
+        if (stop) {
+            break;
+        }
+
+        for (int i = 0; i < num_ready; ++i) {
+            start_request(resolver, ready[i]);
+        }
+
+        int running = 0;
+        curl_multi_perform(resolver->multi, &running);
+
+        CURLMsg *msg;
+        int msgs_left;
+
+        while ((msg = curl_multi_info_read(resolver->multi, &msgs_left)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            char *req = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &req);
+
+            finish_request(resolver, (struct Request *) req, msg->data.result);
+        }
+
+        curl_multi_poll(resolver->multi, NULL, 0, WORKER_POLL_TIMEOUT, NULL);
+    }
+
+    /* Anything still attached to the multi handle or waiting in the queue is abandoned */
+    while (resolver->num_active > 0) {
+        struct Request *req = resolver->active[--resolver->num_active];
+        curl_multi_remove_handle(resolver->multi, req->handle);
+        fail_request(resolver, req, NAME_RESOLVER_ERR_SHUTDOWN, CURLE_OK);
+    }
+
+    while (true) {
+        pthread_mutex_lock(&resolver->lock);
+
+        if (resolver->queue_count == 0) {
+            pthread_mutex_unlock(&resolver->lock);
+            break;
+        }
+
+        struct Request *req = resolver->queue[resolver->queue_head];
+        resolver->queue_head = (resolver->queue_head + 1) % NAME_RESOLVER_MAX_PENDING;
+        --resolver->queue_count;
+
+        pthread_mutex_unlock(&resolver->lock);
+
+        fail_request(resolver, req, NAME_RESOLVER_ERR_SHUTDOWN, CURLE_OK);
+    }
+
+    pthread_exit(NULL);
+}
+
+static void free_resolver(Name_Resolver *resolver)
+{
+    if (resolver->multi != NULL) {
+        curl_multi_cleanup(resolver->multi);
+    }
+
+    free(resolver->proxy_address);
+    free(resolver->cache_path);
+    free(resolver);
+}
+
+Name_Resolver *name_resolver_new(const Name_Resolver_Options *opts)
+{
+    Name_Resolver *resolver = calloc(1, sizeof(Name_Resolver));
+
+    if (resolver == NULL) {
+        return NULL;
+    }
+
+    resolver->proxy_port = opts->proxy_port;
+    resolver->proxy_type = opts->proxy_type;
+    resolver->cache_ttl = opts->cache_ttl;
+
+    if (opts->proxy_address != NULL) {
+        resolver->proxy_address = strdup(opts->proxy_address);
+
+        if (resolver->proxy_address == NULL) {
+            free_resolver(resolver);
+            return NULL;
+        }
+    }
+
+    if (opts->cache_path != NULL) {
+        resolver->cache_path = strdup(opts->cache_path);
+
+        if (resolver->cache_path == NULL) {
+            free_resolver(resolver);
+            return NULL;
+        }
+    }
+
+    resolver->multi = curl_multi_init();
+
+    if (resolver->multi == NULL) {
+        free_resolver(resolver);
+        return NULL;
+    }
+
+    curl_multi_setopt(resolver->multi, CURLMOPT_MAXCONNECTS, (long) MAX_CACHED_CONNECTIONS);
+
+    cache_load(resolver, (long long int) time(NULL));
+
+    if (pthread_mutex_init(&resolver->lock, NULL) != 0) {
+        free_resolver(resolver);
+        return NULL;
+    }
+
+    if (pthread_create(&resolver->thread, NULL, worker_thread, resolver) != 0) {
+        pthread_mutex_destroy(&resolver->lock);
+        free_resolver(resolver);
+        return NULL;
+    }
+
+    return resolver;
+}
+
+void name_resolver_kill(Name_Resolver *resolver)
+{
+    if (resolver == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&resolver->lock);
+    resolver->stop = true;
+    pthread_mutex_unlock(&resolver->lock);
+
+    curl_multi_wakeup(resolver->multi);
+    pthread_join(resolver->thread, NULL);
+
+    pthread_mutex_destroy(&resolver->lock);
+    free_resolver(resolver);
+}
+
+int name_resolver_lookup(Name_Resolver *resolver, const char *url, const char *name, const char *key,
+                         name_resolver_cb *cb, void *user_data)
+{
+    if (resolver == NULL || cb == NULL || string_is_empty(key) || strlen(key) > NAME_RESOLVER_MAX_KEY) {
+        return -2;
+    }
+
+    /* The name is sent as a JSON string without escaping, and keys are stored one per line */
+    if (string_is_empty(name) || strpbrk(name, "\"\\\n") != NULL || strchr(key, '\n') != NULL) {
+        return -2;
+    }
+
+    if (strlen(url) >= MAX_URL_SIZE) {
+        return -2;
+    }
+
+    Name_Resolver_Result result = {
+        .error = NAME_RESOLVER_ERR_NONE,
+        .from_cache = true,
+    };
+
+    pthread_mutex_lock(&resolver->lock);
+
+    const struct Cache_Entry *entry = cache_find(resolver, key, (long long int) time(NULL));
+
+    if (entry != NULL) {
+        memcpy(result.tox_id, entry->tox_id, TOX_ADDRESS_SIZE);
+        ++resolver->stats.cache_hits;
+        pthread_mutex_unlock(&resolver->lock);
+
+        cb(&result, user_data);
+        return 1;
+    }
+
+    if (resolver->stop || resolver->num_pending >= NAME_RESOLVER_MAX_PENDING) {
+        pthread_mutex_unlock(&resolver->lock);
+        return -1;
+    }
+
+    pthread_mutex_unlock(&resolver->lock);
+
+    struct Request *req = calloc(1, sizeof(struct Request));
+
+    if (req == NULL) {
+        return -3;
+    }
+
+    snprintf(req->url, sizeof(req->url), "%s", url);
+    snprintf(req->key, sizeof(req->key), "%s", key);
+    snprintf(req->post_data, sizeof(req->post_data), "{\"action\": 3, \"name\": \"%s\"}", name);
+    req->cb = cb;
+    req->user_data = user_data;
+
+    pthread_mutex_lock(&resolver->lock);
+
+    if (resolver->stop || resolver->num_pending >= NAME_RESOLVER_MAX_PENDING) {
+        pthread_mutex_unlock(&resolver->lock);
+        free(req);
+        return -1;
+    }
+
+    const int idx = (resolver->queue_head + resolver->queue_count) % NAME_RESOLVER_MAX_PENDING;
+    resolver->queue[idx] = req;
+    ++resolver->queue_count;
+    ++resolver->num_pending;
+
+    pthread_mutex_unlock(&resolver->lock);
+
+    curl_multi_wakeup(resolver->multi);
+
+    return 0;
+}
+
+void name_resolver_get_stats(Name_Resolver *resolver, Name_Resolver_Stats *stats)
+{
+    pthread_mutex_lock(&resolver->lock);
+    *stats = resolver->stats;
+    pthread_mutex_unlock(&resolver->lock);
+}
@@ -0,0 +1,120 @@
+/*  name_resolver.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAME_RESOLVER_H
+#define NAME_RESOLVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <tox/tox.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Maximum length of a cache key, not including the null terminator */
+#define NAME_RESOLVER_MAX_KEY 255
+
+/* Maximum number of lookups that may be queued or in progress at once */
+#define NAME_RESOLVER_MAX_PENDING 32
+
+typedef enum Name_Resolver_Error {
+    NAME_RESOLVER_ERR_NONE,
+    NAME_RESOLVER_ERR_HTTP,         /* the request failed; see `curl_code` and `http_code` */
+    NAME_RESOLVER_ERR_RESPONSE,     /* the response didn't contain a Tox ID */
+    NAME_RESOLVER_ERR_SHUTDOWN,     /* the resolver was killed before the request completed */
+} Name_Resolver_Error;
+
+typedef struct Name_Resolver_Result {
+    Name_Resolver_Error error;
+    int curl_code;
+    long http_code;
+    bool from_cache;
+    char tox_id[TOX_ADDRESS_SIZE];  /* valid if `error` is NAME_RESOLVER_ERR_NONE */
+} Name_Resolver_Result;
+
+/*
+ * Called once for every lookup that was accepted by `name_resolver_lookup()`, either
+ * before that function returns or later from the resolver's worker thread.
+ */
+typedef void name_resolver_cb(const Name_Resolver_Result *result, void *user_data);
+
+typedef struct Name_Resolver_Options {
+    const char *proxy_address;      /* may be NULL if proxy_type is TOX_PROXY_TYPE_NONE */
+    uint16_t proxy_port;
+    uint8_t proxy_type;
+    const char *cache_path;         /* file the cache is kept in, or NULL to keep it in memory only */
+    uint32_t cache_ttl;             /* number of seconds a result is cached for */
+} Name_Resolver_Options;
+
+typedef struct Name_Resolver_Stats {
+    uint64_t requests;          /* http requests that completed, successfully or not */
+    uint64_t cache_hits;
+    uint64_t connections;       /* new connections made; lower than `requests` if connections are reused */
+} Name_Resolver_Stats;
+
+typedef struct Name_Resolver Name_Resolver;
+
+/*
+ * Creates a resolver with its own worker thread. The worker keeps a single curl multi
+ * handle, so several lookups can run at once and connections to a nameserver are kept
+ * alive between lookups. If `opts->cache_path` exists, previously cached results are
+ * loaded from it.
+ *
+ * curl must be globally initialized.
+ *
+ * Returns NULL on failure.
+ */
+Name_Resolver *name_resolver_new(const Name_Resolver_Options *opts);
+
+/*
+ * Stops the worker thread and frees the resolver. Lookups that haven't completed get
+ * their callback with NAME_RESOLVER_ERR_SHUTDOWN before this function returns.
+ */
+void name_resolver_kill(Name_Resolver *resolver);
+
+/*
+ * Looks up `name` with a POST request to the nameserver API at `url`. `key` identifies
+ * the result in the cache and should include the nameserver, e.g. "name@domain".
+ *
+ * Return 1 if the result was found in the cache. The callback has been called.
+ * Return 0 if the lookup was queued. The callback will be called from the worker thread.
+ * Return -1 if too many lookups are pending.
+ * Return -2 if an argument is invalid.
+ * Return -3 if memory allocation fails.
+ */
+int name_resolver_lookup(Name_Resolver *resolver, const char *url, const char *name, const char *key,
+                         name_resolver_cb *cb, void *user_data);
+
+/*
+ * Copies the resolver's statistics to `stats`.
+ *
+ * This function is thread safe.
+ */
+void name_resolver_get_stats(Name_Resolver *resolver, Name_Resolver_Stats *stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* NAME_RESOLVER_H */
@@ -0,0 +1,467 @@
+#include "name_resolver.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <curl/curl.h>
+#include <gtest/gtest.h>
+#include <tox/tox.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+std::string make_id(char digit)
+{
+    return std::string(TOX_ADDRESS_SIZE * 2, digit);
+}
+
+std::string response_body(const std::string &id)
+{
+    return "{\"version\": 1, \"tox_id\": \"" + id + "\", \"c\": 0}";
+}
+
+/* A stand-in for a nameserver on the loopback interface. Every connection is served by its
+ * own thread and kept open after each response, so clients may reuse it. The handler gets
+ * the request body and returns the response body. */
+class LoopbackNameserver {
+public:
+    using Handler = std::function<std::string(const std::string &body)>;
+
+    explicit LoopbackNameserver(Handler handler)
+        : handler_(std::move(handler))
+    {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        EXPECT_NE(fd_, -1);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+
+        EXPECT_EQ(bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+        EXPECT_EQ(listen(fd_, 8), 0);
+
+        socklen_t len = sizeof(addr);
+        EXPECT_EQ(getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &len), 0);
+        port_ = ntohs(addr.sin_port);
+
+        accept_thread_ = std::thread([this] {
+            accept_loop();
+        });
+    }
+
+    ~LoopbackNameserver()
+    {
+        shutdown(fd_, SHUT_RDWR);
+        close(fd_);
+        accept_thread_.join();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            for (int client : clients_) {
+                shutdown(client, SHUT_RDWR);
+            }
+        }
+
+        for (std::thread &thread : connection_threads_) {
+            thread.join();
+        }
+    }
+
+    std::string url() const
+    {
+        return "http://127.0.0.1:" + std::to_string(port_) + "/api";
+    }
+
+    std::vector<std::string> requests()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return requests_;
+    }
+
+    int connections() const
+    {
+        return connections_;
+    }
+
+private:
+    void accept_loop()
+    {
+        while (true) {
+            const int client = accept(fd_, nullptr, nullptr);
+
+            if (client == -1) {
+                return;
+            }
+
+            ++connections_;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            clients_.push_back(client);
+            connection_threads_.emplace_back([this, client] {
+                serve(client);
+                close(client);
+            });
+        }
+    }
+
+    void serve(int client)
+    {
+        std::string pending;
+        char buf[4096];
+
+        while (true) {
+            size_t header_end;
+
+            while ((header_end = pending.find("\r\n\r\n")) == std::string::npos) {
+                const ssize_t n = recv(client, buf, sizeof(buf), 0);
+
+                if (n <= 0) {
+                    return;
+                }
+
+                pending.append(buf, n);
+            }
+
+            const std::string headers = pending.substr(0, header_end);
+            const size_t length_pos = headers.find("Content-Length: ");
+            const size_t body_size = length_pos == std::string::npos ? 0
+                                     : std::strtoul(headers.c_str() + length_pos + 16, nullptr, 10);
+
+            while (pending.size() < header_end + 4 + body_size) {
+                const ssize_t n = recv(client, buf, sizeof(buf), 0);
+
+                if (n <= 0) {
+                    return;
+                }
+
+                pending.append(buf, n);
+            }
+
+            const std::string body = pending.substr(header_end + 4, body_size);
+            pending.erase(0, header_end + 4 + body_size);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                requests_.push_back(body);
+            }
+
+            const std::string reply = handler_(body);
+            const std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+                                         + std::to_string(reply.size()) + "\r\n\r\n" + reply;
+
+            if (send(client, response.data(), response.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(response.size())) {
+                return;
+            }
+        }
+    }
+
+    Handler handler_;
+    int fd_ = -1;
+    uint16_t port_ = 0;
+    std::thread accept_thread_;
+    std::atomic<int> connections_{0};
+    std::mutex mutex_;
+    std::vector<int> clients_;
+    std::vector<std::thread> connection_threads_;
+    std::vector<std::string> requests_;
+};
+
+/* Collects results delivered to name_resolver_cb. */
+class Results {
+public:
+    static void callback(const Name_Resolver_Result *result, void *user_data)
+    {
+        Results *results = static_cast<Results *>(user_data);
+        std::lock_guard<std::mutex> lock(results->mutex_);
+        results->results_.push_back(*result);
+        results->cond_.notify_all();
+    }
+
+    std::vector<Name_Resolver_Result> wait_for(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait_for(lock, 10s, [&] {
+            return results_.size() >= count;
+        });
+        return results_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<Name_Resolver_Result> results_;
+};
+
+class NameResolver : public ::testing::Test {
+protected:
+    static void SetUpTestSuite()
+    {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+    }
+
+    void SetUp() override
+    {
+        char dir[] = "/tmp/name_resolver_test.XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        dir_ = dir;
+        cache_path_ = dir_ + "/name_lookup_cache";
+    }
+
+    void TearDown() override
+    {
+        name_resolver_kill(resolver_);
+        std::remove(cache_path_.c_str());
+        rmdir(dir_.c_str());
+    }
+
+    Name_Resolver *new_resolver(uint32_t ttl = 3600)
+    {
+        Name_Resolver_Options opts{};
+        opts.proxy_type = TOX_PROXY_TYPE_NONE;
+        opts.cache_path = cache_path_.c_str();
+        opts.cache_ttl = ttl;
+        return name_resolver_new(&opts);
+    }
+
+    int lookup(const LoopbackNameserver &server, const std::string &name, Results *results)
+    {
+        const std::string key = name + "@example.org";
+        return name_resolver_lookup(resolver_, server.url().c_str(), name.c_str(), key.c_str(), Results::callback,
+                                    results);
+    }
+
+    std::string dir_;
+    std::string cache_path_;
+    Name_Resolver *resolver_ = nullptr;
+};
+
+TEST_F(NameResolver, ResolvesName)
+{
+    const std::string id = make_id('A');
+    LoopbackNameserver server([&](const std::string &) {
+        return response_body(id);
+    });
+
+    resolver_ = new_resolver();
+    ASSERT_NE(resolver_, nullptr);
+
+    Results results;
+    ASSERT_EQ(lookup(server, "alice", &results), 0);
+
+    const std::vector<Name_Resolver_Result> done = results.wait_for(1);
+    ASSERT_EQ(done.size(), 1u);
+    EXPECT_EQ(done[0].error, NAME_RESOLVER_ERR_NONE);
+    EXPECT_FALSE(done[0].from_cache);
+    EXPECT_EQ(done[0].http_code, 200);
+    EXPECT_EQ(std::string(done[0].tox_id, TOX_ADDRESS_SIZE), std::string(TOX_ADDRESS_SIZE, '\xAA'));
+
+    ASSERT_EQ(server.requests().size(), 1u);
+    EXPECT_EQ(server.requests()[0], "{\"action\": 3, \"name\": \"alice\"}");
+}
+
+TEST_F(NameResolver, CachesResultsAcrossRestarts)
+{
+    LoopbackNameserver server([&](const std::string &) {
+        return response_body(make_id('1'));
+    });
+
+    resolver_ = new_resolver();
+    ASSERT_NE(resolver_, nullptr);
+
+    Results first;
+    ASSERT_EQ(lookup(server, "bob", &first), 0);
+    ASSERT_EQ(first.wait_for(1).size(), 1u);
+
+    Results second;
+    ASSERT_EQ(lookup(server, "bob", &second), 1);
+    ASSERT_EQ(second.wait_for(1).size(), 1u);
+    EXPECT_TRUE(second.wait_for(1)[0].from_cache);
+
+    name_resolver_kill(resolver_);
+    resolver_ = new_resolver();
+    ASSERT_NE(resolver_, nullptr);
+
+    Results third;
+    ASSERT_EQ(lookup(server, "bob", &third), 1);
+    EXPECT_EQ(std::string(third.wait_for(1)[0].tox_id, TOX_ADDRESS_SIZE), std::string(TOX_ADDRESS_SIZE, '\x11'));
+
+    EXPECT_EQ(server.requests().size(), 1u);
+
+    Name_Resolver_Stats stats;
+    name_resolver_get_stats(resolver_, &stats);
+    EXPECT_EQ(stats.cache_hits, 1u);
+}
+
+TEST_F(NameResolver, ExpiredEntriesAreFetchedAgain)
+{
+    LoopbackNameserver server([&](const std::string &) {
+        return response_body(make_id('2'));
+    });
+
+    resolver_ = new_resolver(0);
+    ASSERT_NE(resolver_, nullptr);
+
+    Results results;
+    ASSERT_EQ(lookup(server, "carol", &results), 0);
+    ASSERT_EQ(results.wait_for(1).size(), 1u);
+
+    ASSERT_EQ(lookup(server, "carol", &results), 0);
+    ASSERT_EQ(results.wait_for(2).size(), 2u);
+
+    EXPECT_EQ(server.requests().size(), 2u);
+}
+
+TEST_F(NameResolver, ReusesConnection)
+{
+    LoopbackNameserver server([&](const std::string &) {
+        return response_body(make_id('3'));
+    });
+
+    resolver_ = new_resolver();
+    ASSERT_NE(resolver_, nullptr);
+
+    Results results;
+
+    for (size_t i = 0; i < 5; ++i) {
+        ASSERT_EQ(lookup(server, "user" + std::to_string(i), &results), 0);
+        ASSERT_EQ(results.wait_for(i + 1).size(), i + 1);
+    }
+
+    EXPECT_EQ(server.connections(), 1);
+
+    Name_Resolver_Stats stats;
+    name_resolver_get_stats(resolver_, &stats);
+    EXPECT_EQ(stats.requests, 5u);
+    EXPECT_EQ(stats.connections, 1u);
+}
+
+TEST_F(NameResolver, RunsLookupsConcurrently)
+{
+    constexpr int kLookups = 3;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    int in_flight = 0;
+    bool all_arrived = false;
+
+    /* no response is sent until every lookup has reached the server */
+    LoopbackNameserver server([&](const std::string &) {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (++in_flight == kLookups) {
+            all_arrived = true;
+            cond.notify_all();
+        }
+
+        cond.wait_for(lock, 5s, [&] {
+            return all_arrived;
+        });
+
+        return response_body(make_id('4'));
+    });
+
+    resolver_ = new_resolver();
+    ASSERT_NE(resolver_, nullptr);
+
+    Results results;
+
+    for (int i = 0; i < kLookups; ++i) {
+        ASSERT_EQ(lookup(server, "dave" + std::to_string(i), &results), 0);
+    }
+
+    const std::vector<Name_Resolver_Result> done = results.wait_for(kLookups);
+    ASSERT_EQ(done.size(), static_cast<size_t>(kLookups));
+
+    for (const Name_Resolver_Result &result : done) {
+        EXPECT_EQ(result.error, NAME_RESOLVER_ERR_NONE);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_TRUE(all_arrived);
+}
+
+TEST_F(NameResolver, BadResponseIsNotCached)
+{
+    LoopbackNameserver server([&](const std::string &) {
+        return std::string("{\"c\": -42}");
+    });
+
+    resolver_ = new_resolver();
+    ASSERT_NE(resolver_, nullptr);
+
+    Results results;
+    ASSERT_EQ(lookup(server, "eve", &results), 0);
+    ASSERT_EQ(results.wait_for(1).size(), 1u);
+    EXPECT_EQ(results.wait_for(1)[0].error, NAME_RESOLVER_ERR_RESPONSE);
+
+    ASSERT_EQ(lookup(server, "eve", &results), 0);
+    ASSERT_EQ(results.wait_for(2).size(), 2u);
+}
+
+TEST_F(NameResolver, KillCancelsPendingLookups)
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool release = false;
+
+    LoopbackNameserver server([&](const std::string &) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait_for(lock, 5s, [&] {
+            return release;
+        });
+        return response_body(make_id('5'));
+    });
+
+    resolver_ = new_resolver();
+    ASSERT_NE(resolver_, nullptr);
+
+    Results results;
+
+    for (int i = 0; i < 6; ++i) {
+        ASSERT_EQ(lookup(server, "frank" + std::to_string(i), &results), 0);
+    }
+
+    name_resolver_kill(resolver_);
+    resolver_ = nullptr;
+
+    const std::vector<Name_Resolver_Result> done = results.wait_for(6);
+    ASSERT_EQ(done.size(), 6u);
+
+    for (const Name_Resolver_Result &result : done) {
+        EXPECT_EQ(result.error, NAME_RESOLVER_ERR_SHUTDOWN);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    release = true;
+    cond.notify_all();
+}
+
+TEST_F(NameResolver, RejectsNamesThatNeedEscaping)
+{
+    resolver_ = new_resolver();
+    ASSERT_NE(resolver_, nullptr);
+
+    Results results;
+    EXPECT_EQ(name_resolver_lookup(resolver_, "http://127.0.0.1/api", "a\"b", "a\"b@example.org",
+                                   Results::callback, &results), -2);
+    EXPECT_EQ(name_resolver_lookup(resolver_, "http://127.0.0.1/api", "", "@example.org",
+                                   Results::callback, &results), -2);
+}
+
+}  // namespace
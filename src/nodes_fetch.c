@@ -0,0 +1,504 @@
+/*  nodes_fetch.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nodes_fetch.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <curl/curl.h>
+
+#include "curl_util.h"
+
+/* Appended to the nodes list path while a new list is being downloaded */
+#define TEMP_NODES_FILE_EXT ".tmp"
+
+/* Appended to the nodes list path to get the path of the file that holds the cache validators */
+#define NODES_CACHE_FILE_EXT ".cache"
+
+#define MAX_ETAG_SIZE 256
+#define MAX_LAST_MODIFIED_SIZE 64
+
+/* HTTP cache validators of the list on disk */
+struct Nodes_Cache {
+    char etag[MAX_ETAG_SIZE];
+    char last_modified[MAX_LAST_MODIFIED_SIZE];
+    long long int checked;
+};
+
+/* A nodes list download in progress. */
+struct Nodes_Download {
+    FILE *fp;
+    Nodes_JSON_Parser parser;
+    nodes_fetch_node_valid_cb *node_valid_cb;
+    size_t num_valid;       /* number of valid entries received so far */
+    uint64_t decoded_bytes;
+    long status;            /* status code of the current response */
+    bool write_failed;
+    bool parse_failed;
+
+    struct Nodes_Cache response;    /* validators sent with the response */
+};
+
+static void nodes_cache_path(const char *nodes_path, char *buf, size_t buf_size)
+{
+    snprintf(buf, buf_size, "%s%s", nodes_path, NODES_CACHE_FILE_EXT);
+}
+
+/* Removes leading and trailing whitespace from the `length` byte string `s` and copies
+ * the result to `buf`. The value is dropped if it doesn't fit. */
+static void copy_header_value(const char *s, size_t length, char *buf, size_t buf_size)
+{
+    while (length > 0 && (*s == ' ' || *s == '\t')) {
+        ++s;
+        --length;
+    }
+
+    while (length > 0 && (s[length - 1] == '\r' || s[length - 1] == '\n' || s[length - 1] == ' ')) {
+        --length;
+    }
+
+    if (length >= buf_size) {
+        buf[0] = '\0';
+        return;
+    }
+
+    memcpy(buf, s, length);
+    buf[length] = '\0';
+}
+
+/* Loads the cache validators for the list at `nodes_path`. Missing values are left empty. */
+static void nodes_cache_load(const char *nodes_path, struct Nodes_Cache *cache)
+{
+    memset(cache, 0, sizeof(struct Nodes_Cache));
+
+    char path[PATH_MAX];
+    nodes_cache_path(nodes_path, path, sizeof(path));
+
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) {
+        return;
+    }
+
+    char line[MAX_ETAG_SIZE + 32];
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        const char *value = strchr(line, ' ');
+
+        if (value == NULL) {
+            continue;
+        }
+
+        const size_t name_len = value - line;
+        ++value;
+
+        if (name_len == 4 && strncmp(line, "etag", name_len) == 0) {
+            copy_header_value(value, strlen(value), cache->etag, sizeof(cache->etag));
+        } else if (name_len == 13 && strncmp(line, "last-modified", name_len) == 0) {
+            copy_header_value(value, strlen(value), cache->last_modified, sizeof(cache->last_modified));
+        } else if (name_len == 7 && strncmp(line, "checked", name_len) == 0) {
+            cache->checked = strtoll(value, NULL, 10);
+        }
+    }
+
+    fclose(fp);
+}
+
+static void nodes_cache_save(const char *nodes_path, const struct Nodes_Cache *cache)
+{
+    char path[PATH_MAX];
+    nodes_cache_path(nodes_path, path, sizeof(path));
+
+    FILE *fp = fopen(path, "w");
+
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open nodes list cache file '%s'\n", path);
+        return;
+    }
+
+    if (cache->etag[0] != '\0') {
+        fprintf(fp, "etag %s\n", cache->etag);
+    }
+
+    if (cache->last_modified[0] != '\0') {
+        fprintf(fp, "last-modified %s\n", cache->last_modified);
+    }
+
+    fprintf(fp, "checked %lld\n", cache->checked);
+
+    fclose(fp);
+}
+
+time_t nodes_fetch_last_checked(const char *nodes_path)
+{
+    struct Nodes_Cache cache;
+    nodes_cache_load(nodes_path, &cache);
+
+    return (time_t) cache.checked;
+}
+
+void nodes_fetch_clear_cache(const char *nodes_path)
+{
+    char path[PATH_MAX];
+    nodes_cache_path(nodes_path, path, sizeof(path));
+
+    remove(path);
+}
+
+static void count_node(const Nodes_JSON_Node *node, void *user_data)
+{
+    struct Nodes_Download *download = (struct Nodes_Download *) user_data;
+
+    if (download->node_valid_cb == NULL || download->node_valid_cb(node)) {
+        ++download->num_valid;
+    }
+}
+
+/* Callback function for CURL to write received data. The data is written straight to the
+ * download's file and parsed as it arrives so that malformed lists are rejected without
+ * waiting for the rest of the transfer.
+ *
+ * The body of an error response isn't a nodes list, so the transfer is aborted before any of it is parsed.
+ *
+ * Returns the number of bytes handled. Anything less than the number of bytes received aborts the transfer.
+ */
+static size_t curl_cb_write_nodes(void *data, size_t size, size_t nmemb, void *user_pointer)
+{
+    struct Nodes_Download *download = (struct Nodes_Download *) user_pointer;
+    const size_t length = size * nmemb;
+
+    if (download->status != 200) {
+        return 0;
+    }
+
+    download->decoded_bytes += length;
+
+    if (fwrite(data, 1, length, download->fp) != length) {
+        download->write_failed = true;
+        return 0;
+    }
+
+    if (nodes_json_feed(&download->parser, (const char *) data, length) != 0) {
+        download->parse_failed = true;
+        return 0;
+    }
+
+    return length;
+}
+
+/* Returns the status code from the `length` byte HTTP status line `s`, or 0 if it has none. */
+static long parse_status_code(const char *s, size_t length)
+{
+    const char *space = memchr(s, ' ', length);
+
+    if (space == NULL) {
+        return 0;
+    }
+
+    long code = 0;
+
+    for (size_t i = space - s + 1; i < length && s[i] >= '0' && s[i] <= '9' && code < 1000; ++i) {
+        code = code * 10 + (s[i] - '0');
+    }
+
+    return code;
+}
+
+/* Callback function for CURL to handle response headers. Picks out the cache validators. */
+static size_t curl_cb_header_nodes(char *data, size_t size, size_t nmemb, void *user_pointer)
+{
+    struct Nodes_Download *download = (struct Nodes_Download *) user_pointer;
+    const size_t length = size * nmemb;
+
+    /* each status line starts a new response, e.g. after a redirect */
+    if (length >= 5 && strncmp(data, "HTTP/", 5) == 0) {
+        download->response.etag[0] = '\0';
+        download->response.last_modified[0] = '\0';
+        download->status = parse_status_code(data, length);
+        return length;
+    }
+
+    const char *colon = memchr(data, ':', length);
+
+    if (colon == NULL) {
+        return length;
+    }
+
+    const size_t name_len = colon - data;
+    const char *value = colon + 1;
+    const size_t value_len = length - name_len - 1;
+
+    if (name_len == 4 && strncasecmp(data, "ETag", name_len) == 0) {
+        copy_header_value(value, value_len, download->response.etag, sizeof(download->response.etag));
+    } else if (name_len == 13 && strncasecmp(data, "Last-Modified", name_len) == 0) {
+        copy_header_value(value, value_len, download->response.last_modified, sizeof(download->response.last_modified));
+    }
+
+    return length;
+}
+
+/* Performs the request described by `opts`, sending the validators in `cache`.
+ *
+ * Return 0 on success.
+ * Return -1 on failure.
+ */
+static int curl_fetch_nodes_JSON(const Nodes_Fetch_Options *opts, const struct Nodes_Cache *cache,
+                                 struct Nodes_Download *download, Nodes_Fetch_Result *result)
+{
+    CURL *c_handle = curl_easy_init();
+
+    if (c_handle == NULL) {
+        return -1;
+    }
+
+    int err = -1;
+
+    struct curl_slist *headers = NULL;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "charsets: utf-8");
+
+    char header[MAX_ETAG_SIZE + 32];
+
+    if (cache->etag[0] != '\0') {
+        snprintf(header, sizeof(header), "If-None-Match: %s", cache->etag);
+        headers = curl_slist_append(headers, header);
+    }
+
+    if (cache->last_modified[0] != '\0') {
+        snprintf(header, sizeof(header), "If-Modified-Since: %s", cache->last_modified);
+        headers = curl_slist_append(headers, header);
+    }
+
+    int ret = curl_easy_setopt(c_handle, CURLOPT_HTTPHEADER, headers);
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "Failed to set http headers (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    ret = curl_easy_setopt(c_handle, CURLOPT_URL, opts->url);
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "Failed to set url (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    ret = curl_easy_setopt(c_handle, CURLOPT_WRITEFUNCTION, curl_cb_write_nodes);
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "Failed to set write function callback (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    ret = curl_easy_setopt(c_handle, CURLOPT_WRITEDATA, download);
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "Failed to set write data (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    ret = curl_easy_setopt(c_handle, CURLOPT_HEADERFUNCTION, curl_cb_header_nodes);
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "Failed to set header function callback (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    ret = curl_easy_setopt(c_handle, CURLOPT_HEADERDATA, download);
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "Failed to set header data (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    /* an empty string enables every encoding libcurl was built with */
+    ret = curl_easy_setopt(c_handle, CURLOPT_ACCEPT_ENCODING, "");
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "Failed to set accepted encodings (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    ret = curl_easy_setopt(c_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "Failed to set useragent (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    ret = curl_easy_setopt(c_handle, CURLOPT_HTTPGET, 1L);
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "Failed to set get request (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    int proxy_ret = set_curl_proxy(c_handle, opts->proxy_address, opts->proxy_port, opts->proxy_type);
+
+    if (proxy_ret != 0) {
+        fprintf(stderr, "set_curl_proxy() failed with error %d\n", proxy_ret);
+        goto on_exit;
+    }
+
+    ret = curl_easy_setopt(c_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "TLSv1.2 could not be set (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    ret = curl_easy_setopt(c_handle, CURLOPT_SSL_CIPHER_LIST, TLS_CIPHER_SUITE_LIST);
+
+    if (ret != CURLE_OK) {
+        fprintf(stderr, "Failed to set TLS cipher list (libcurl error %d)", ret);
+        goto on_exit;
+    }
+
+    ret = curl_easy_perform(c_handle);
+
+    if (ret != CURLE_OK) {
+        /* If system doesn't support any of the specified ciphers suites, fall back to default */
+        if (ret == CURLE_SSL_CIPHER) {
+            ret = curl_easy_setopt(c_handle, CURLOPT_SSL_CIPHER_LIST, NULL);
+
+            if (ret != CURLE_OK) {
+                fprintf(stderr, "Failed to set SSL cipher list (libcurl error %d)\n", ret);
+                goto on_exit;
+            }
+
+            ret = curl_easy_perform(c_handle);
+        }
+
+        if (ret != CURLE_OK) {
+            fprintf(stderr, "HTTPS lookup error (libcurl error %d)\n", ret);
+            goto on_exit;
+        }
+    }
+
+    err = 0;
+
+on_exit:
+    curl_easy_getinfo(c_handle, CURLINFO_RESPONSE_CODE, &result->http_code);
+
+    long header_size = 0;
+    curl_off_t body_size = 0;
+
+    curl_easy_getinfo(c_handle, CURLINFO_HEADER_SIZE, &header_size);
+    curl_easy_getinfo(c_handle, CURLINFO_SIZE_DOWNLOAD_T, &body_size);
+
+    result->header_bytes = header_size > 0 ? (uint64_t) header_size : 0;
+    result->body_bytes = body_size > 0 ? (uint64_t) body_size : 0;
+
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(c_handle);
+    return err;
+}
+
+int nodes_fetch(const Nodes_Fetch_Options *opts, const char *nodes_path, Nodes_Fetch_Result *result)
+{
+    Nodes_Fetch_Result tmp_result;
+
+    if (result == NULL) {
+        result = &tmp_result;
+    }
+
+    memset(result, 0, sizeof(Nodes_Fetch_Result));
+
+    char temp_path[PATH_MAX];
+    snprintf(temp_path, sizeof(temp_path), "%s%s", nodes_path, TEMP_NODES_FILE_EXT);
+
+    struct Nodes_Cache cache;
+    nodes_cache_load(nodes_path, &cache);
+
+    /* validators are meaningless without the list they belong to */
+    FILE *nodes_fp = fopen(nodes_path, "r");
+
+    if (nodes_fp == NULL) {
+        cache.etag[0] = '\0';
+        cache.last_modified[0] = '\0';
+    } else {
+        fclose(nodes_fp);
+    }
+
+    struct Nodes_Download *download = calloc(1, sizeof(struct Nodes_Download));
+
+    if (download == NULL) {
+        return -5;
+    }
+
+    download->fp = fopen(temp_path, "wb");
+
+    if (download->fp == NULL) {
+        free(download);
+        return -1;
+    }
+
+    download->node_valid_cb = opts->node_valid_cb;
+    nodes_json_init(&download->parser, count_node, download);
+
+    int err = 1;
+
+    const int fetch_err = curl_fetch_nodes_JSON(opts, &cache, download, result);
+
+    if (download->parse_failed) {
+        err = -3;
+    } else if (fetch_err == -1) {
+        err = download->write_failed ? -4 : -2;
+    } else if (result->http_code == 304) {
+        err = 0;
+    } else if (result->http_code != 200) {
+        err = -2;
+    } else if (nodes_json_finish(&download->parser) != 0 || download->num_valid == 0) {
+        err = -3;
+    }
+
+    if (fclose(download->fp) != 0 && err == 1) {
+        err = -4;
+    }
+
+    result->decoded_bytes = download->decoded_bytes;
+    result->num_valid = download->num_valid;
+
+    if (err == 1 && rename(temp_path, nodes_path) != 0) {
+        err = -4;
+    }
+
+    if (err != 1) {
+        remove(temp_path);
+    }
+
+    if (err == 1) {
+        download->response.checked = (long long int) time(NULL);
+        nodes_cache_save(nodes_path, &download->response);
+    } else if (err == 0) {
+        cache.checked = (long long int) time(NULL);
+        nodes_cache_save(nodes_path, &cache);
+    }
+
+    free(download);
+
+    return err;
+}
@@ -0,0 +1,92 @@
+/*  nodes_fetch.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NODES_FETCH_H
+#define NODES_FETCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "nodes_json.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Returns true if `node` is usable. Used to reject downloaded lists without any usable entries. */
+typedef bool nodes_fetch_node_valid_cb(const Nodes_JSON_Node *node);
+
+typedef struct Nodes_Fetch_Options {
+    const char *url;
+    const char *proxy_address;      /* may be NULL if proxy_type is TOX_PROXY_TYPE_NONE */
+    uint16_t proxy_port;
+    uint8_t proxy_type;
+    nodes_fetch_node_valid_cb *node_valid_cb;   /* NULL to accept every entry */
+} Nodes_Fetch_Options;
+
+typedef struct Nodes_Fetch_Result {
+    long http_code;
+    uint64_t header_bytes;      /* size of the response headers */
+    uint64_t body_bytes;        /* size of the response body as it was transferred */
+    uint64_t decoded_bytes;     /* size of the response body after decompression */
+    size_t num_valid;           /* number of valid entries in the downloaded list */
+} Nodes_Fetch_Result;
+
+/*
+ * Downloads the nodes list at `opts->url` to `nodes_path`.
+ *
+ * The request is conditional on the validators (ETag and Last-Modified) from the last
+ * successful download, and any compression supported by libcurl is accepted. The new list
+ * is written to a temporary file and only replaces the file at `nodes_path` once it has
+ * been received completely and contains at least one valid entry, so a failed refresh
+ * leaves the current list untouched.
+ *
+ * `result` may be NULL.
+ *
+ * Return 1 if a new list was written to `nodes_path`.
+ * Return 0 if the server reported that our list is still current.
+ * Return -1 if the temporary file cannot be opened.
+ * Return -2 if the http request failed.
+ * Return -3 if the response was not a well-formed list with at least one valid entry.
+ * Return -4 if data could not be written to disk.
+ * Return -5 if memory allocation fails.
+ */
+int nodes_fetch(const Nodes_Fetch_Options *opts, const char *nodes_path, Nodes_Fetch_Result *result);
+
+/*
+ * Returns the time at which the list at `nodes_path` was last downloaded or confirmed to be
+ * current by the server, or 0 if unknown.
+ */
+time_t nodes_fetch_last_checked(const char *nodes_path);
+
+/*
+ * Forgets the validators for the list at `nodes_path` so that the next fetch downloads
+ * the full list. Should be called if the list on disk turns out to be unusable.
+ */
+void nodes_fetch_clear_cache(const char *nodes_path);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* NODES_FETCH_H */
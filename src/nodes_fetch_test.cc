@@ -0,0 +1,413 @@
+#include "nodes_fetch.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include <tox/tox.h>
+#include <zlib.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr char kKey[] = "8E7D0B859922EF569298B4D261A8CCB5FEA14FB91ED412A7603A585A25698832";
+
+std::string make_list(int num_nodes)
+{
+    std::string list = "{\"last_scan\":1700000000,\"nodes\":[";
+
+    for (int i = 0; i < num_nodes; ++i) {
+        char buf[256];
+        std::snprintf(buf, sizeof(buf),
+                      "%s{\"ipv4\":\"10.0.%d.%d\",\"ipv6\":\"-\",\"port\":33445,\"public_key\":\"%s\","
+                      "\"maintainer\":\"someone\",\"location\":\"DE\",\"last_ping\":1700000000}",
+                      i > 0 ? "," : "", i / 256, i % 256, kKey);
+        list += buf;
+    }
+
+    list += "]}";
+    return list;
+}
+
+std::string gzip(const std::string &data)
+{
+    z_stream stream{};
+    EXPECT_EQ(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY), Z_OK);
+
+    std::string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    stream.avail_out = out.size();
+
+    EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    return out;
+}
+
+std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+bool file_exists(const std::string &path)
+{
+    return access(path.c_str(), F_OK) == 0;
+}
+
+/* A single-threaded HTTP/1.1 server on the loopback interface. Each request is answered by
+ * the handler, which returns the raw bytes to send, after which the connection is closed. */
+class LoopbackHttpServer {
+public:
+    using Handler = std::function<std::string(const std::string &request)>;
+
+    explicit LoopbackHttpServer(Handler handler)
+        : handler_(std::move(handler))
+    {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        EXPECT_NE(fd_, -1);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+
+        EXPECT_EQ(bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+        EXPECT_EQ(listen(fd_, 4), 0);
+
+        socklen_t len = sizeof(addr);
+        EXPECT_EQ(getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &len), 0);
+        port_ = ntohs(addr.sin_port);
+
+        thread_ = std::thread([this] {
+            serve();
+        });
+    }
+
+    ~LoopbackHttpServer()
+    {
+        stop_ = true;
+        shutdown(fd_, SHUT_RDWR);
+        close(fd_);
+        thread_.join();
+    }
+
+    std::string url() const
+    {
+        return "http://127.0.0.1:" + std::to_string(port_) + "/json";
+    }
+
+    std::vector<std::string> requests()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return requests_;
+    }
+
+    size_t bytes_sent() const
+    {
+        return bytes_sent_;
+    }
+
+private:
+    void serve()
+    {
+        while (!stop_) {
+            const int client = accept(fd_, nullptr, nullptr);
+
+            if (client == -1) {
+                return;
+            }
+
+            std::string request;
+            char buf[4096];
+
+            while (request.find("\r\n\r\n") == std::string::npos) {
+                const ssize_t n = recv(client, buf, sizeof(buf), 0);
+
+                if (n <= 0) {
+                    break;
+                }
+
+                request.append(buf, n);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                requests_.push_back(request);
+            }
+
+            const std::string response = handler_(request);
+            size_t sent = 0;
+
+            while (sent < response.size()) {
+                const ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+
+                if (n <= 0) {
+                    break;
+                }
+
+                sent += n;
+            }
+
+            bytes_sent_ += sent;
+            close(client);
+        }
+    }
+
+    Handler handler_;
+    int fd_ = -1;
+    uint16_t port_ = 0;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::atomic<size_t> bytes_sent_{0};
+    std::mutex mutex_;
+    std::vector<std::string> requests_;
+};
+
+std::string response(const std::string &status, const std::string &headers, const std::string &body)
+{
+    return "HTTP/1.1 " + status + "\r\n" + headers + "Content-Length: " + std::to_string(body.size())
+           + "\r\nConnection: close\r\n\r\n" + body;
+}
+
+bool has_header(const std::string &request, const std::string &header)
+{
+    return request.find("\r\n" + header + "\r\n") != std::string::npos;
+}
+
+class NodesFetch : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        char dir[] = "/tmp/nodes_fetch_test.XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        dir_ = dir;
+        path_ = dir_ + "/DHTnodes.json";
+    }
+
+    void TearDown() override
+    {
+        std::remove(path_.c_str());
+        std::remove((path_ + ".cache").c_str());
+        std::remove((path_ + ".tmp").c_str());
+        rmdir(dir_.c_str());
+    }
+
+    int fetch(const LoopbackHttpServer &server, Nodes_Fetch_Result *result = nullptr)
+    {
+        const std::string url = server.url();
+        Nodes_Fetch_Options opts{};
+        opts.url = url.c_str();
+        opts.proxy_type = TOX_PROXY_TYPE_NONE;
+        return nodes_fetch(&opts, path_.c_str(), result);
+    }
+
+    std::string dir_;
+    std::string path_;
+};
+
+TEST_F(NodesFetch, StoresListAndValidators)
+{
+    const std::string list = make_list(3);
+    LoopbackHttpServer server([&](const std::string &) {
+        return response("200 OK", "ETag: \"v1\"\r\nLast-Modified: Tue, 14 Nov 2023 22:13:20 GMT\r\n", list);
+    });
+
+    Nodes_Fetch_Result result;
+    ASSERT_EQ(fetch(server, &result), 1);
+    EXPECT_EQ(result.http_code, 200);
+    EXPECT_EQ(result.num_valid, 3u);
+    EXPECT_EQ(read_file(path_), list);
+    EXPECT_NE(read_file(path_ + ".cache").find("etag \"v1\""), std::string::npos);
+    EXPECT_GT(nodes_fetch_last_checked(path_.c_str()), 0);
+    EXPECT_FALSE(file_exists(path_ + ".tmp"));
+}
+
+TEST_F(NodesFetch, NotModifiedKeepsList)
+{
+    const std::string list = make_list(3);
+    LoopbackHttpServer server([&](const std::string &request) {
+        if (has_header(request, "If-None-Match: \"v1\"")) {
+            return response("304 Not Modified", "ETag: \"v1\"\r\n", "");
+        }
+
+        return response("200 OK", "ETag: \"v1\"\r\nLast-Modified: Tue, 14 Nov 2023 22:13:20 GMT\r\n", list);
+    });
+
+    ASSERT_EQ(fetch(server), 1);
+
+    Nodes_Fetch_Result result;
+    ASSERT_EQ(fetch(server, &result), 0);
+    EXPECT_EQ(result.http_code, 304);
+    EXPECT_EQ(result.body_bytes, 0u);
+    EXPECT_EQ(read_file(path_), list);
+
+    const std::vector<std::string> requests = server.requests();
+    ASSERT_EQ(requests.size(), 2u);
+    EXPECT_FALSE(has_header(requests[0], "If-None-Match: \"v1\""));
+    EXPECT_TRUE(has_header(requests[1], "If-Modified-Since: Tue, 14 Nov 2023 22:13:20 GMT"));
+
+    /* validators survive the 304 so the next refresh is conditional too */
+    ASSERT_EQ(fetch(server), 0);
+}
+
+TEST_F(NodesFetch, NoValidatorsWithoutList)
+{
+    const std::string list = make_list(1);
+    LoopbackHttpServer server([&](const std::string &) {
+        return response("200 OK", "ETag: \"v1\"\r\n", list);
+    });
+
+    ASSERT_EQ(fetch(server), 1);
+    std::remove(path_.c_str());
+
+    ASSERT_EQ(fetch(server), 1);
+    EXPECT_FALSE(has_header(server.requests()[1], "If-None-Match: \"v1\""));
+}
+
+TEST_F(NodesFetch, CorruptedBodyKeepsOldList)
+{
+    const std::string list = make_list(2);
+    std::atomic<int> num_requests{0};
+    LoopbackHttpServer server([&](const std::string &) {
+        if (num_requests++ == 0) {
+            return response("200 OK", "", list);
+        }
+
+        std::string corrupted = list;
+        corrupted.replace(corrupted.find("},{"), 3, "}}{");
+        return response("200 OK", "", corrupted);
+    });
+
+    ASSERT_EQ(fetch(server), 1);
+    EXPECT_EQ(fetch(server), -3);
+    EXPECT_EQ(read_file(path_), list);
+    EXPECT_FALSE(file_exists(path_ + ".tmp"));
+}
+
+TEST_F(NodesFetch, ListWithoutValidNodesKeepsOldList)
+{
+    const std::string list = make_list(2);
+    std::atomic<int> num_requests{0};
+    LoopbackHttpServer server([&](const std::string &) {
+        return response("200 OK", "", num_requests++ == 0 ? list : "{\"last_scan\":1,\"nodes\":[]}");
+    });
+
+    ASSERT_EQ(fetch(server), 1);
+    EXPECT_EQ(fetch(server), -3);
+    EXPECT_EQ(read_file(path_), list);
+}
+
+TEST_F(NodesFetch, PartialBodyKeepsOldList)
+{
+    const std::string list = make_list(20);
+    std::atomic<int> num_requests{0};
+    LoopbackHttpServer server([&](const std::string &) {
+        if (num_requests++ == 0) {
+            return response("200 OK", "", list);
+        }
+
+        /* promise the whole list, then hang up halfway through */
+        std::string truncated = response("200 OK", "", list);
+        truncated.resize(truncated.size() - list.size() / 2);
+        return truncated;
+    });
+
+    ASSERT_EQ(fetch(server), 1);
+    EXPECT_EQ(fetch(server), -2);
+    EXPECT_EQ(read_file(path_), list);
+    EXPECT_FALSE(file_exists(path_ + ".tmp"));
+}
+
+TEST_F(NodesFetch, ServerErrorKeepsOldList)
+{
+    const std::string list = make_list(2);
+    std::atomic<int> num_requests{0};
+    LoopbackHttpServer server([&](const std::string &) {
+        return num_requests++ == 0 ? response("200 OK", "", list) : response("503 Service Unavailable", "", "");
+    });
+
+    ASSERT_EQ(fetch(server), 1);
+    EXPECT_EQ(fetch(server), -2);
+    EXPECT_EQ(read_file(path_), list);
+}
+
+TEST_F(NodesFetch, ErrorPageIsNotParsed)
+{
+    const std::string list = make_list(2);
+    std::atomic<int> num_requests{0};
+    LoopbackHttpServer server([&](const std::string &) {
+        return num_requests++ == 0 ? response("200 OK", "", list)
+               : response("404 Not Found", "Content-Type: text/html\r\n", "<html><body>Not Found</body></html>");
+    });
+
+    Nodes_Fetch_Result result;
+    ASSERT_EQ(fetch(server), 1);
+    EXPECT_EQ(fetch(server, &result), -2);
+    EXPECT_EQ(result.http_code, 404);
+    EXPECT_EQ(read_file(path_), list);
+    EXPECT_FALSE(file_exists(path_ + ".tmp"));
+}
+
+TEST_F(NodesFetch, CompressedTransfer)
+{
+    const std::string list = make_list(200);
+    const std::string compressed = gzip(list);
+
+    LoopbackHttpServer server([&](const std::string &request) {
+        if (request.find("Accept-Encoding:") != std::string::npos && request.find("gzip") != std::string::npos) {
+            return response("200 OK", "Content-Encoding: gzip\r\n", compressed);
+        }
+
+        return response("200 OK", "", list);
+    });
+
+    Nodes_Fetch_Result result;
+    ASSERT_EQ(fetch(server, &result), 1);
+    EXPECT_EQ(read_file(path_), list);
+    EXPECT_EQ(result.decoded_bytes, list.size());
+    EXPECT_LT(result.body_bytes, list.size());
+    EXPECT_EQ(result.num_valid, 200u);
+
+    std::printf("200 nodes: %zu bytes decoded, %llu bytes on the wire (%llu headers), server sent %zu bytes\n",
+                list.size(), static_cast<unsigned long long>(result.body_bytes + result.header_bytes),
+                static_cast<unsigned long long>(result.header_bytes), server.bytes_sent());
+}
+
+TEST_F(NodesFetch, CorruptedCompressionKeepsOldList)
+{
+    const std::string list = make_list(2);
+    std::atomic<int> num_requests{0};
+    LoopbackHttpServer server([&](const std::string &) {
+        if (num_requests++ == 0) {
+            return response("200 OK", "", list);
+        }
+
+        std::string compressed = gzip(list);
+        compressed[compressed.size() / 2] ^= 0x55;
+        return response("200 OK", "Content-Encoding: gzip\r\n", compressed);
+    });
+
+    ASSERT_EQ(fetch(server), 1);
+    EXPECT_LT(fetch(server), 0);
+    EXPECT_EQ(read_file(path_), list);
+}
+
+}  // namespace
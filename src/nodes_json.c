@@ -0,0 +1,701 @@
+/*  nodes_json.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nodes_json.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The token currently being read */
+typedef enum Token_State {
+    TOKEN_NONE,
+    TOKEN_STRING,
+    TOKEN_STRING_ESCAPE,
+    TOKEN_STRING_UNICODE,
+    TOKEN_NUMBER,
+    TOKEN_LITERAL,
+} Token_State;
+
+/* What the grammar allows next, ignoring whitespace */
+typedef enum Expect {
+    EXPECT_VALUE,
+    EXPECT_VALUE_OR_END,    /* after '[' */
+    EXPECT_KEY,             /* after ',' in an object */
+    EXPECT_KEY_OR_END,      /* after '{' */
+    EXPECT_COLON,
+    EXPECT_COMMA_OR_END,
+    EXPECT_DONE,
+} Expect;
+
+/* Keys we're interested in */
+typedef enum Key {
+    KEY_OTHER,
+    KEY_NODES,
+    KEY_LAST_SCAN,
+    KEY_IPV4,
+    KEY_IPV6,
+    KEY_PORT,
+    KEY_PUBLIC_KEY,
+    KEY_LAST_PING,
+} Key;
+
+typedef enum Scalar_Type {
+    SCALAR_STRING,
+    SCALAR_NUMBER,
+    SCALAR_LITERAL,
+} Scalar_Type;
+
+/* Depth of the objects that make up the entries of the "nodes" array: root object, array, entry */
+#define NODE_DEPTH 3
+
+void nodes_json_init(Nodes_JSON_Parser *parser, nodes_json_node_cb *node_cb, void *user_data)
+{
+    memset(parser, 0, sizeof(Nodes_JSON_Parser));
+
+    parser->node_cb = node_cb;
+    parser->user_data = user_data;
+    parser->token_state = TOKEN_NONE;
+    parser->expect = EXPECT_VALUE;
+    parser->last_scan = -1;
+}
+
+static Key classify_key(const Nodes_JSON_Parser *parser)
+{
+    if (parser->token_overflow) {
+        return KEY_OTHER;
+    }
+
+    static const struct {
+        const char *name;
+        Key key;
+    } keys[] = {
+        {"nodes",      KEY_NODES},
+        {"last_scan",  KEY_LAST_SCAN},
+        {"ipv4",       KEY_IPV4},
+        {"ipv6",       KEY_IPV6},
+        {"port",       KEY_PORT},
+        {"public_key", KEY_PUBLIC_KEY},
+        {"last_ping",  KEY_LAST_PING},
+    };
+
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        if (strcmp(parser->token, keys[i].name) == 0) {
+            return keys[i].key;
+        }
+    }
+
+    return KEY_OTHER;
+}
+
+static bool is_digit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+static bool is_hex_digit(char ch)
+{
+    return is_digit(ch) || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+}
+
+static bool is_number_char(char ch)
+{
+    return is_digit(ch) || ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E';
+}
+
+static bool is_whitespace(char ch)
+{
+    return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+}
+
+/* Returns true if the `length` byte string `s` is a number according to the JSON grammar. */
+static bool number_is_valid(const char *s, size_t length)
+{
+    size_t i = 0;
+
+    if (i < length && s[i] == '-') {
+        ++i;
+    }
+
+    if (i >= length) {
+        return false;
+    }
+
+    if (s[i] == '0') {
+        ++i;
+    } else if (is_digit(s[i])) {
+        while (i < length && is_digit(s[i])) {
+            ++i;
+        }
+    } else {
+        return false;
+    }
+
+    if (i < length && s[i] == '.') {
+        ++i;
+
+        if (i >= length || !is_digit(s[i])) {
+            return false;
+        }
+
+        while (i < length && is_digit(s[i])) {
+            ++i;
+        }
+    }
+
+    if (i < length && (s[i] == 'e' || s[i] == 'E')) {
+        ++i;
+
+        if (i < length && (s[i] == '+' || s[i] == '-')) {
+            ++i;
+        }
+
+        if (i >= length || !is_digit(s[i])) {
+            return false;
+        }
+
+        while (i < length && is_digit(s[i])) {
+            ++i;
+        }
+    }
+
+    return i == length;
+}
+
+/* Returns the value of the current number token, or -1 if it isn't a non-negative integer
+ * that fits in a long long int. */
+static long long int token_integer(const Nodes_JSON_Parser *parser)
+{
+    if (parser->token_overflow || parser->token_len == 0 || parser->token[0] == '-') {
+        return -1;
+    }
+
+    long long int value = 0;
+
+    for (size_t i = 0; i < parser->token_len; ++i) {
+        const char ch = parser->token[i];
+
+        if (!is_digit(ch)) {
+            return -1;
+        }
+
+        if (value > (INT64_MAX - (ch - '0')) / 10) {
+            return -1;
+        }
+
+        value = value * 10 + (ch - '0');
+    }
+
+    return value;
+}
+
+static void token_append(Nodes_JSON_Parser *parser, const char *s, size_t length)
+{
+    if (parser->token_overflow) {
+        return;
+    }
+
+    if (parser->token_len + length > NODES_JSON_MAX_STRING) {
+        parser->token_overflow = true;
+        return;
+    }
+
+    memcpy(parser->token + parser->token_len, s, length);
+    parser->token_len += length;
+}
+
+static void token_start(Nodes_JSON_Parser *parser, Token_State state)
+{
+    parser->token_state = state;
+    parser->token_len = 0;
+    parser->token_overflow = false;
+}
+
+static void copy_string_field(const Nodes_JSON_Parser *parser, char *field)
+{
+    if (parser->token_overflow) {
+        field[0] = '\0';
+        return;
+    }
+
+    memcpy(field, parser->token, parser->token_len + 1);
+}
+
+/* Sets the grammar expectation after a complete value at the current depth. */
+static void after_value(Nodes_JSON_Parser *parser)
+{
+    parser->expect = parser->depth == 0 ? EXPECT_DONE : EXPECT_COMMA_OR_END;
+}
+
+static void on_scalar(Nodes_JSON_Parser *parser, Scalar_Type type)
+{
+    if (parser->depth == 1 && parser->root_key == KEY_LAST_SCAN) {
+        parser->last_scan = type == SCALAR_NUMBER ? token_integer(parser) : -1;
+        return;
+    }
+
+    if (!parser->in_node || parser->depth != NODE_DEPTH) {
+        return;
+    }
+
+    Nodes_JSON_Node *node = &parser->node;
+
+    switch (parser->node_key) {
+        case KEY_IPV4: {
+            if (type == SCALAR_STRING) {
+                copy_string_field(parser, node->ipv4);
+            }
+
+            break;
+        }
+
+        case KEY_IPV6: {
+            if (type == SCALAR_STRING) {
+                copy_string_field(parser, node->ipv6);
+            }
+
+            break;
+        }
+
+        case KEY_PUBLIC_KEY: {
+            if (type == SCALAR_STRING) {
+                copy_string_field(parser, node->public_key);
+            }
+
+            break;
+        }
+
+        case KEY_PORT: {
+            node->port = type == SCALAR_NUMBER ? token_integer(parser) : -1;
+            break;
+        }
+
+        case KEY_LAST_PING: {
+            node->last_ping = type == SCALAR_NUMBER ? token_integer(parser) : -1;
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+}
+
+/* Return 0 on success.
+ * Return -1 on a syntax error.
+ */
+static int finish_string(Nodes_JSON_Parser *parser)
+{
+    parser->token[parser->token_len] = '\0';
+    parser->token_state = TOKEN_NONE;
+
+    if (!parser->token_is_key) {
+        on_scalar(parser, SCALAR_STRING);
+        after_value(parser);
+        return 0;
+    }
+
+    const Key key = classify_key(parser);
+
+    if (parser->depth == 1) {
+        parser->root_key = key;
+    } else if (parser->in_node && parser->depth == NODE_DEPTH) {
+        parser->node_key = key;
+    }
+
+    parser->expect = EXPECT_COLON;
+
+    return 0;
+}
+
+static int finish_number(Nodes_JSON_Parser *parser)
+{
+    parser->token_state = TOKEN_NONE;
+
+    if (parser->token_overflow || !number_is_valid(parser->token, parser->token_len)) {
+        return -1;
+    }
+
+    parser->token[parser->token_len] = '\0';
+
+    on_scalar(parser, SCALAR_NUMBER);
+    after_value(parser);
+
+    return 0;
+}
+
+static int finish_literal(Nodes_JSON_Parser *parser)
+{
+    parser->token_state = TOKEN_NONE;
+    parser->token[parser->token_len] = '\0';
+
+    if (parser->token_overflow || (strcmp(parser->token, "true") != 0 && strcmp(parser->token, "false") != 0
+                                   && strcmp(parser->token, "null") != 0)) {
+        return -1;
+    }
+
+    on_scalar(parser, SCALAR_LITERAL);
+    after_value(parser);
+
+    return 0;
+}
+
+static bool expecting_value(const Nodes_JSON_Parser *parser)
+{
+    return parser->expect == EXPECT_VALUE || parser->expect == EXPECT_VALUE_OR_END;
+}
+
+static int open_container(Nodes_JSON_Parser *parser, char type)
+{
+    if (!expecting_value(parser) || parser->depth >= NODES_JSON_MAX_DEPTH) {
+        return -1;
+    }
+
+    parser->stack[parser->depth++] = type;
+
+    if (type == '[') {
+        parser->expect = EXPECT_VALUE_OR_END;
+        return 0;
+    }
+
+    parser->expect = EXPECT_KEY_OR_END;
+
+    if (parser->depth == NODE_DEPTH && parser->stack[0] == '{' && parser->stack[1] == '['
+            && parser->root_key == KEY_NODES) {
+        parser->in_node = true;
+        parser->node_key = KEY_OTHER;
+
+        Nodes_JSON_Node *node = &parser->node;
+        node->ipv4[0] = '\0';
+        node->ipv6[0] = '\0';
+        node->public_key[0] = '\0';
+        node->port = -1;
+        node->last_ping = -1;
+    }
+
+    return 0;
+}
+
+static int close_container(Nodes_JSON_Parser *parser, char type)
+{
+    if (parser->depth == 0 || parser->stack[parser->depth - 1] != type) {
+        return -1;
+    }
+
+    const int end_after_open = type == '{' ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+
+    if (parser->expect != end_after_open && parser->expect != EXPECT_COMMA_OR_END) {
+        return -1;
+    }
+
+    if (type == '{' && parser->in_node && parser->depth == NODE_DEPTH) {
+        parser->in_node = false;
+        ++parser->num_nodes;
+
+        if (parser->node_cb != NULL) {
+            parser->node_cb(&parser->node, parser->user_data);
+        }
+    }
+
+    --parser->depth;
+
+    if (parser->depth == 0) {
+        parser->root_key = KEY_OTHER;
+    }
+
+    after_value(parser);
+
+    return 0;
+}
+
+/* Handles a byte outside of any token.
+ *
+ * Return 0 on success.
+ * Return -1 on a syntax error.
+ */
+static int parse_structural(Nodes_JSON_Parser *parser, char ch)
+{
+    if (is_whitespace(ch)) {
+        return 0;
+    }
+
+    switch (ch) {
+        case '{':
+        case '[': {
+            return open_container(parser, ch);
+        }
+
+        case '}': {
+            return close_container(parser, '{');
+        }
+
+        case ']': {
+            return close_container(parser, '[');
+        }
+
+        case ':': {
+            if (parser->expect != EXPECT_COLON) {
+                return -1;
+            }
+
+            parser->expect = EXPECT_VALUE;
+            return 0;
+        }
+
+        case ',': {
+            if (parser->expect != EXPECT_COMMA_OR_END) {
+                return -1;
+            }
+
+            parser->expect = parser->stack[parser->depth - 1] == '{' ? EXPECT_KEY : EXPECT_VALUE;
+            return 0;
+        }
+
+        case '"': {
+            if (parser->expect == EXPECT_KEY || parser->expect == EXPECT_KEY_OR_END) {
+                parser->token_is_key = true;
+            } else if (expecting_value(parser)) {
+                parser->token_is_key = false;
+            } else {
+                return -1;
+            }
+
+            token_start(parser, TOKEN_STRING);
+            return 0;
+        }
+
+        default: {
+            break;
+        }
+    }
+
+    if (!expecting_value(parser)) {
+        return -1;
+    }
+
+    if (ch == '-' || is_digit(ch)) {
+        token_start(parser, TOKEN_NUMBER);
+        token_append(parser, &ch, 1);
+        return 0;
+    }
+
+    if (ch == 't' || ch == 'f' || ch == 'n') {
+        token_start(parser, TOKEN_LITERAL);
+        token_append(parser, &ch, 1);
+        return 0;
+    }
+
+    return -1;
+}
+
+/* Returns the number of bytes from the start of `data` that are ordinary string characters. */
+static size_t string_run_length(const char *data, size_t length)
+{
+    size_t i = 0;
+
+    while (i < length) {
+        const unsigned char ch = (unsigned char) data[i];
+
+        if (ch == '"' || ch == '\\' || ch < 0x20) {
+            break;
+        }
+
+        ++i;
+    }
+
+    return i;
+}
+
+static char unescape(char ch)
+{
+    switch (ch) {
+        case '"':
+        case '\\':
+        case '/':
+            return ch;
+
+        case 'b':
+            return '\b';
+
+        case 'f':
+            return '\f';
+
+        case 'n':
+            return '\n';
+
+        case 'r':
+            return '\r';
+
+        case 't':
+            return '\t';
+
+        default:
+            return 0;
+    }
+}
+
+int nodes_json_feed(Nodes_JSON_Parser *parser, const char *data, size_t length)
+{
+    if (parser->error) {
+        return -1;
+    }
+
+    size_t i = 0;
+
+    while (i < length) {
+        const char ch = data[i];
+        int ret = 0;
+
+        switch (parser->token_state) {
+            case TOKEN_STRING: {
+                const size_t run = string_run_length(data + i, length - i);
+
+                if (run > 0) {
+                    token_append(parser, data + i, run);
+                    i += run;
+                    continue;
+                }
+
+                if (ch == '"') {
+                    ret = finish_string(parser);
+                } else if (ch == '\\') {
+                    parser->token_state = TOKEN_STRING_ESCAPE;
+                } else {
+                    ret = -1;  /* unescaped control character */
+                }
+
+                break;
+            }
+
+            case TOKEN_STRING_ESCAPE: {
+                if (ch == 'u') {
+                    parser->unicode_digits = 0;
+                    parser->token_state = TOKEN_STRING_UNICODE;
+                    break;
+                }
+
+                const char unescaped = unescape(ch);
+
+                if (unescaped == 0) {
+                    ret = -1;
+                    break;
+                }
+
+                token_append(parser, &unescaped, 1);
+                parser->token_state = TOKEN_STRING;
+                break;
+            }
+
+            case TOKEN_STRING_UNICODE: {
+                if (!is_hex_digit(ch)) {
+                    ret = -1;
+                    break;
+                }
+
+                /* None of the values we use contain non-ASCII characters, so we don't decode them */
+                if (++parser->unicode_digits == 4) {
+                    token_append(parser, "?", 1);
+                    parser->token_state = TOKEN_STRING;
+                }
+
+                break;
+            }
+
+            case TOKEN_NUMBER: {
+                if (is_number_char(ch)) {
+                    token_append(parser, &ch, 1);
+                    break;
+                }
+
+                /* the byte that ends a number belongs to the next token */
+                ret = finish_number(parser);
+
+                if (ret == 0) {
+                    ret = parse_structural(parser, ch);
+                }
+
+                break;
+            }
+
+            case TOKEN_LITERAL: {
+                if (ch >= 'a' && ch <= 'z') {
+                    token_append(parser, &ch, 1);
+                    break;
+                }
+
+                ret = finish_literal(parser);
+
+                if (ret == 0) {
+                    ret = parse_structural(parser, ch);
+                }
+
+                break;
+            }
+
+            default: {
+                ret = parse_structural(parser, ch);
+                break;
+            }
+        }
+
+        if (ret != 0) {
+            parser->error = true;
+            return -1;
+        }
+
+        ++i;
+    }
+
+    return 0;
+}
+
+int nodes_json_finish(Nodes_JSON_Parser *parser)
+{
+    if (parser->error) {
+        return -1;
+    }
+
+    int ret = 0;
+
+    if (parser->token_state == TOKEN_NUMBER) {
+        ret = finish_number(parser);
+    } else if (parser->token_state == TOKEN_LITERAL) {
+        ret = finish_literal(parser);
+    }
+
+    if (ret != 0 || parser->token_state != TOKEN_NONE || parser->expect != EXPECT_DONE) {
+        parser->error = true;
+        return -1;
+    }
+
+    return 0;
+}
+
+long long int nodes_json_last_scan(const Nodes_JSON_Parser *parser)
+{
+    return parser->last_scan;
+}
+
+size_t nodes_json_num_nodes(const Nodes_JSON_Parser *parser)
+{
+    return parser->num_nodes;
+}
@@ -0,0 +1,123 @@
+/*  nodes_json.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NODES_JSON_H
+#define NODES_JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Longest string value or key the parser keeps. Longer strings are still parsed but their
+ * contents are discarded. */
+#define NODES_JSON_MAX_STRING 64
+
+/* Maximum nesting depth of arrays and objects */
+#define NODES_JSON_MAX_DEPTH 32
+
+/*
+ * The fields of an entry in the "nodes" array that we care about. String fields are empty
+ * and number fields are -1 if the entry doesn't contain them or their value has the wrong type.
+ */
+typedef struct Nodes_JSON_Node {
+    char ipv4[NODES_JSON_MAX_STRING + 1];
+    char ipv6[NODES_JSON_MAX_STRING + 1];
+    char public_key[NODES_JSON_MAX_STRING + 1];
+    long long int port;
+    long long int last_ping;
+} Nodes_JSON_Node;
+
+/* Called for every entry of the "nodes" array as soon as the entry has been parsed. */
+typedef void nodes_json_node_cb(const Nodes_JSON_Node *node, void *user_data);
+
+/*
+ * Incremental parser for the JSON encoded DHT nodes list. The document may be fed to the
+ * parser in chunks of any size, split at any byte, and the parser never buffers more than
+ * a single token, so memory use doesn't depend on the size of the list.
+ *
+ * All fields are private.
+ */
+typedef struct Nodes_JSON_Parser {
+    nodes_json_node_cb *node_cb;
+    void *user_data;
+
+    int token_state;
+    int expect;
+    bool error;
+
+    char stack[NODES_JSON_MAX_DEPTH];   /* '{' or '[' for each open container */
+    size_t depth;
+
+    char token[NODES_JSON_MAX_STRING + 1];
+    size_t token_len;
+    bool token_overflow;
+    bool token_is_key;
+    unsigned int unicode_digits;
+
+    int root_key;       /* the key of the current member of the root object */
+    int node_key;       /* the key of the current member of the current node entry */
+    bool in_node;
+
+    Nodes_JSON_Node node;
+    long long int last_scan;
+    size_t num_nodes;
+} Nodes_JSON_Parser;
+
+/*
+ * Resets `parser` so that it's ready to parse a new document. `node_cb` may be NULL.
+ */
+void nodes_json_init(Nodes_JSON_Parser *parser, nodes_json_node_cb *node_cb, void *user_data);
+
+/*
+ * Parses the next `length` bytes of the document.
+ *
+ * Return 0 on success.
+ * Return -1 if the document is malformed. Once this happens all further input is rejected.
+ */
+int nodes_json_feed(Nodes_JSON_Parser *parser, const char *data, size_t length);
+
+/*
+ * Signals the end of the document.
+ *
+ * Return 0 if a complete, well-formed document was parsed.
+ * Return -1 otherwise.
+ */
+int nodes_json_finish(Nodes_JSON_Parser *parser);
+
+/*
+ * Returns the value of the root object's "last_scan" member, or -1 if it hasn't been seen.
+ */
+long long int nodes_json_last_scan(const Nodes_JSON_Parser *parser);
+
+/*
+ * Returns the number of entries of the "nodes" array that have been parsed so far.
+ */
+size_t nodes_json_num_nodes(const Nodes_JSON_Parser *parser);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* NODES_JSON_H */
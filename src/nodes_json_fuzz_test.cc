@@ -0,0 +1,47 @@
+#include "nodes_json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+void check_node(const Nodes_JSON_Node *node, void *user_data)
+{
+    (void)user_data;
+
+    // Every string field must be terminated within its buffer.
+    if (std::strlen(node->ipv4) > NODES_JSON_MAX_STRING || std::strlen(node->ipv6) > NODES_JSON_MAX_STRING
+            || std::strlen(node->public_key) > NODES_JSON_MAX_STRING) {
+        __builtin_trap();
+    }
+}
+
+}  // namespace
+
+// The first byte selects the chunk size so that the fuzzer also explores token boundaries.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size == 0) {
+        return 0;
+    }
+
+    const size_t chunk_size = 1 + data[0] % 64;
+    ++data;
+    --size;
+
+    Nodes_JSON_Parser parser;
+    nodes_json_init(&parser, check_node, nullptr);
+
+    for (size_t i = 0; i < size; i += chunk_size) {
+        const size_t length = size - i < chunk_size ? size - i : chunk_size;
+
+        if (nodes_json_feed(&parser, reinterpret_cast<const char *>(data + i), length) != 0) {
+            return 0;
+        }
+    }
+
+    nodes_json_finish(&parser);
+
+    return 0;
+}
@@ -0,0 +1,260 @@
+#include "nodes_json.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr char kKey[] = "8E7D0B859922EF569298B4D261A8CCB5FEA14FB91ED412A7603A585A25698832";
+
+std::string make_node(int i)
+{
+    char buf[512];
+    std::snprintf(buf, sizeof(buf),
+                  "{\"ipv4\":\"10.%d.%d.%d\",\"ipv6\":\"-\",\"port\":%d,\"tcp_ports\":[443,%d],"
+                  "\"public_key\":\"%s\",\"maintainer\":\"node \\\"%d\\\"\",\"location\":\"DE\","
+                  "\"status_udp\":true,\"status_tcp\":false,\"version\":\"1000002018\",\"motd\":null,"
+                  "\"last_ping\":%d}",
+                  (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff, 33445 + (i % 1000), 3389 + i, kKey, i,
+                  1700000000 + i);
+    return buf;
+}
+
+std::string make_list(int num_nodes)
+{
+    std::string list = "{\"last_scan\":1700000000,\"last_refresh\":1700000001,\"nodes\":[";
+
+    for (int i = 0; i < num_nodes; ++i) {
+        if (i > 0) {
+            list += ',';
+        }
+
+        list += make_node(i);
+    }
+
+    list += "]}";
+    return list;
+}
+
+void collect_node(const Nodes_JSON_Node *node, void *user_data)
+{
+    static_cast<std::vector<Nodes_JSON_Node> *>(user_data)->push_back(*node);
+}
+
+int parse(const std::string &json, std::vector<Nodes_JSON_Node> *nodes, size_t chunk_size = 0)
+{
+    Nodes_JSON_Parser parser;
+    nodes_json_init(&parser, collect_node, nodes);
+
+    if (chunk_size == 0) {
+        chunk_size = json.size();
+    }
+
+    for (size_t i = 0; i < json.size(); i += chunk_size) {
+        if (nodes_json_feed(&parser, json.data() + i, std::min(chunk_size, json.size() - i)) != 0) {
+            return -1;
+        }
+    }
+
+    return nodes_json_finish(&parser);
+}
+
+TEST(NodesJson, ParsesNodes)
+{
+    std::vector<Nodes_JSON_Node> nodes;
+    ASSERT_EQ(parse(make_list(3), &nodes), 0);
+    ASSERT_EQ(nodes.size(), 3u);
+
+    EXPECT_STREQ(nodes[2].ipv4, "10.0.0.2");
+    EXPECT_STREQ(nodes[2].ipv6, "-");
+    EXPECT_STREQ(nodes[2].public_key, kKey);
+    EXPECT_EQ(nodes[2].port, 33447);
+    EXPECT_EQ(nodes[2].last_ping, 1700000002);
+}
+
+TEST(NodesJson, LastScan)
+{
+    std::vector<Nodes_JSON_Node> nodes;
+    Nodes_JSON_Parser parser;
+    nodes_json_init(&parser, collect_node, &nodes);
+
+    const std::string list = make_list(1);
+    ASSERT_EQ(nodes_json_feed(&parser, list.data(), list.size()), 0);
+    ASSERT_EQ(nodes_json_finish(&parser), 0);
+    EXPECT_EQ(nodes_json_last_scan(&parser), 1700000000);
+    EXPECT_EQ(nodes_json_num_nodes(&parser), 1u);
+}
+
+TEST(NodesJson, MissingAndMistypedFields)
+{
+    std::vector<Nodes_JSON_Node> nodes;
+    ASSERT_EQ(parse("{\"nodes\":[{\"ipv4\":5,\"port\":\"33445\",\"extra\":{\"port\":1}}]}", &nodes), 0);
+    ASSERT_EQ(nodes.size(), 1u);
+
+    EXPECT_STREQ(nodes[0].ipv4, "");
+    EXPECT_STREQ(nodes[0].public_key, "");
+    EXPECT_EQ(nodes[0].port, -1);
+    EXPECT_EQ(nodes[0].last_ping, -1);
+}
+
+TEST(NodesJson, OversizedStringsAreDropped)
+{
+    const std::string long_ip(NODES_JSON_MAX_STRING + 1, '1');
+    std::vector<Nodes_JSON_Node> nodes;
+    ASSERT_EQ(parse("{\"nodes\":[{\"ipv4\":\"" + long_ip + "\"}]}", &nodes), 0);
+    ASSERT_EQ(nodes.size(), 1u);
+    EXPECT_STREQ(nodes[0].ipv4, "");
+}
+
+TEST(NodesJson, IgnoresNodesOutsideTheNodesArray)
+{
+    std::vector<Nodes_JSON_Node> nodes;
+    ASSERT_EQ(parse("{\"other\":[{\"ipv4\":\"1.2.3.4\"}],\"nodes\":[[{\"ipv4\":\"1.2.3.4\"}]]}", &nodes), 0);
+    EXPECT_TRUE(nodes.empty());
+}
+
+TEST(NodesJson, RejectsMalformedDocuments)
+{
+    const char *const documents[] = {
+        "",
+        "{",
+        "{\"nodes\":[}",
+        "{\"nodes\" [] }",
+        "{\"nodes\":[],}",
+        "{\"last_scan\":01}",
+        "{\"last_scan\":1.}",
+        "{\"last_scan\":tru}",
+        "{\"a\":\"\\x\"}",
+        "{\"a\":\"\\u12G4\"}",
+        "{\"a\":\"line\nbreak\"}",
+        "{} {}",
+        "[1 2]",
+    };
+
+    for (const char *document : documents) {
+        std::vector<Nodes_JSON_Node> nodes;
+        EXPECT_NE(parse(document, &nodes), 0) << document;
+    }
+}
+
+TEST(NodesJson, AcceptsWellFormedDocuments)
+{
+    const char *const documents[] = {
+        "{}",
+        "[]",
+        " 0 ",
+        "-1.5e+3",
+        "null",
+        "{\"a\":[true,false,null,{}],\"b\":\"\\u00e9\\n\"}",
+    };
+
+    for (const char *document : documents) {
+        std::vector<Nodes_JSON_Node> nodes;
+        EXPECT_EQ(parse(document, &nodes), 0) << document;
+    }
+}
+
+TEST(NodesJson, RejectsDeepNesting)
+{
+    const std::string deep = std::string(NODES_JSON_MAX_DEPTH + 1, '[') + std::string(NODES_JSON_MAX_DEPTH + 1, ']');
+    std::vector<Nodes_JSON_Node> nodes;
+    EXPECT_NE(parse(deep, &nodes), 0);
+}
+
+TEST(NodesJson, ChunkBoundariesDontMatter)
+{
+    const std::string list = make_list(4);
+
+    std::vector<Nodes_JSON_Node> whole;
+    ASSERT_EQ(parse(list, &whole), 0);
+
+    for (size_t chunk_size = 1; chunk_size < 40; ++chunk_size) {
+        std::vector<Nodes_JSON_Node> nodes;
+        ASSERT_EQ(parse(list, &nodes, chunk_size), 0) << chunk_size;
+        ASSERT_EQ(nodes.size(), whole.size());
+
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            EXPECT_STREQ(nodes[i].ipv4, whole[i].ipv4);
+            EXPECT_STREQ(nodes[i].public_key, whole[i].public_key);
+            EXPECT_EQ(nodes[i].port, whole[i].port);
+            EXPECT_EQ(nodes[i].last_ping, whole[i].last_ping);
+        }
+    }
+}
+
+TEST(NodesJson, SurvivesRandomMutations)
+{
+    const std::string list = make_list(8);
+    std::mt19937 rng(1234);
+
+    for (int i = 0; i < 20000; ++i) {
+        std::string mutated = list;
+        const int num_mutations = 1 + rng() % 4;
+
+        for (int j = 0; j < num_mutations; ++j) {
+            const size_t pos = rng() % mutated.size();
+
+            switch (rng() % 3) {
+                case 0:
+                    mutated[pos] = static_cast<char>(rng());
+                    break;
+
+                case 1:
+                    mutated.erase(pos, 1 + rng() % 16);
+                    break;
+
+                default:
+                    mutated.insert(pos, 1, "{}[]\",:\\0e-"[rng() % 11]);
+                    break;
+            }
+
+            if (mutated.empty()) {
+                mutated = "{";
+            }
+        }
+
+        std::vector<Nodes_JSON_Node> nodes;
+        parse(mutated, &nodes, 1 + rng() % 64);
+
+        for (const Nodes_JSON_Node &node : nodes) {
+            ASSERT_LE(std::string(node.ipv4).size(), static_cast<size_t>(NODES_JSON_MAX_STRING));
+            ASSERT_LE(std::string(node.public_key).size(), static_cast<size_t>(NODES_JSON_MAX_STRING));
+        }
+    }
+}
+
+TEST(NodesJson, Throughput)
+{
+    const std::string list = make_list(10000);
+    constexpr int kRounds = 10;
+
+    size_t num_nodes = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < kRounds; ++i) {
+        Nodes_JSON_Parser parser;
+        nodes_json_init(&parser, nullptr, nullptr);
+
+        for (size_t j = 0; j < list.size(); j += 4096) {
+            ASSERT_EQ(nodes_json_feed(&parser, list.data() + j, std::min<size_t>(4096, list.size() - j)), 0);
+        }
+
+        ASSERT_EQ(nodes_json_finish(&parser), 0);
+        num_nodes += nodes_json_num_nodes(&parser);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(num_nodes, 10000u * kRounds);
+
+    const double mb_per_sec = static_cast<double>(list.size()) * kRounds / elapsed.count() / (1024 * 1024);
+    std::printf("10000 nodes (%zu bytes): %.2f ms per parse, %.1f MiB/s\n", list.size(),
+                elapsed.count() * 1000 / kRounds, mb_per_sec);
+}
+
+}  // namespace
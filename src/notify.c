@@ -22,6 +22,7 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -34,6 +35,7 @@
 #include "line_info.h"
 #include "misc_tools.h"
 #include "notify.h"
+#include "scheduler.h"
 #include "settings.h"
 
 #ifdef X11
@@ -66,8 +68,26 @@
 
 #ifdef SOUND_NOTIFY
 #define SOUNDS_SIZE 10
+
+/* A notification sound, decoded once when it's set */
+struct Notify_Sound {
+    char *path;
+    void *data;         /* decoded PCM samples, or NULL if the file couldn't be decoded */
+    int format;
+    int size;
+    float frequency;
+    uint32_t duration;  /* playing time in milliseconds */
+    uint32_t buffer;    /* OpenAL buffer holding `data` while the output device is open, or 0 */
+};
 #endif  /* SOUND_NOTIFY */
 
+/* A sound for a window is skipped if the window's previous notification came less than
+ * this many milliseconds ago, so that a burst of messages plays a single sound. */
+#define SOUND_COALESCE_MS 1500
+
+/* ...unless no sound has been played for the window in this many milliseconds. */
+#define SOUND_MAX_SILENCE_MS 15000
+
 #define CONTENT_HIDDEN_MESSAGE "[Content hidden]"
 
 static_assert(sizeof(CONTENT_HIDDEN_MESSAGE) < MAX_BOX_MSG_LEN,
@@ -84,14 +104,15 @@ static struct Control {
 
 #ifdef SOUND_NOTIFY
     uint32_t device_idx; /* index of output device */
-    char *sounds[SOUNDS_SIZE];
+    struct Notify_Sound sounds[SOUNDS_SIZE];
+    uint32_t sources[ACTIVE_NOTIFS_MAX];  /* source for each actives slot while the device is open */
+    bool alut_ready;
 #endif /* SOUND_NOTIFY */
 } Control = {0};
 
 static struct _ActiveNotifications {
 #ifdef SOUND_NOTIFY
     uint32_t source;
-    uint32_t buffer;
     bool looping;
 #endif /* SOUND_NOTIFY */
     bool active;
@@ -101,7 +122,7 @@ static struct _ActiveNotifications {
     char messages[MAX_BOX_MSG_LEN + 1][MAX_BOX_MSG_LEN + 1];
     char title[64];
     size_t size;
-    time_t n_timeout;
+    uint64_t n_deadline;    /* monotonic time in ms at which the box expires */
 #endif /* BOX_NOTIFY */
 } actives[ACTIVE_NOTIFS_MAX];
 /**********************************************************************************/
@@ -139,6 +160,37 @@ static void tab_notify(ToxWindow *self, uint64_t flags)
     ++self->pending_messages;
 }
 
+static uint64_t notify_time_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t) t.tv_sec) * 1000 + ((uint64_t) t.tv_nsec) / 1000000;
+}
+
+/*
+ * Returns true if the sound for a notification in `self` should be skipped because it's
+ * part of a burst of notifications for that window. Looping sounds are never skipped.
+ */
+static bool sound_is_coalesced(ToxWindow *self, Notification notif, uint64_t flags)
+{
+    if (self == NULL || notif == silent || (flags & NT_LOOP)) {
+        return false;
+    }
+
+    const uint64_t now = notify_time_ms();
+    const bool in_burst = self->last_sound_request > 0 && now - self->last_sound_request < SOUND_COALESCE_MS;
+
+    self->last_sound_request = now;
+
+    if (in_burst && now - self->last_sound_played < SOUND_MAX_SILENCE_MS) {
+        return true;
+    }
+
+    self->last_sound_played = now;
+
+    return false;
+}
+
 static bool notifications_are_disabled(const Toxic *toxic, uint64_t flags)
 {
     const Client_Config *c_config = toxic->c_config;
@@ -169,7 +221,157 @@ static void control_unlock(void)
 #endif
 }
 
+#if defined(SOUND_NOTIFY) || defined(BOX_NOTIFY)
+typedef enum Notify_Deadline_Type {
+    NOTIFY_DEADLINE_SOUND,      /* the sound in an actives slot should have finished playing */
+    NOTIFY_DEADLINE_BOX,        /* the box in an actives slot has timed out */
+    NOTIFY_DEADLINE_DEVICE,     /* the output device may have been idle for DEVICE_COOLDOWN */
+    NOTIFY_DEADLINE_TYPES,
+} Notify_Deadline_Type;
+
+struct Notify_Deadline {
+    uint64_t time;      /* monotonic time in ms */
+    Notify_Deadline_Type type;
+    int slot;           /* actives slot; always 0 for the device */
+};
+
+#define NOTIFY_DEADLINES_MAX (NOTIFY_DEADLINE_TYPES * ACTIVE_NOTIFS_MAX)
+
+/*
+ * Min-heap of pending deadlines ordered by time. Guarded by the control lock.
+ *
+ * There's at most one deadline for each type and slot. Deadlines aren't removed when a
+ * notification goes away early; the slot is looked at again when its deadline expires,
+ * and the deadline is either dropped or pushed back.
+ */
+static struct Notify_Deadlines {
+    struct Notify_Deadline heap[NOTIFY_DEADLINES_MAX];
+    int count;
+    bool queued[NOTIFY_DEADLINE_TYPES][ACTIVE_NOTIFS_MAX];
+} Deadlines;
+
+/* Time of the earliest deadline, or 0 if there are none. Read by the scheduler without the control lock. */
+static _Atomic uint64_t next_deadline;
+
+static void deadline_swap(int a, int b)
+{
+    const struct Notify_Deadline tmp = Deadlines.heap[a];
+    Deadlines.heap[a] = Deadlines.heap[b];
+    Deadlines.heap[b] = tmp;
+}
+
+static void deadline_sift_up(int idx)
+{
+    while (idx > 0) {
+        const int parent = (idx - 1) / 2;
+
+        if (Deadlines.heap[parent].time <= Deadlines.heap[idx].time) {
+            break;
+        }
+
+        deadline_swap(parent, idx);
+        idx = parent;
+    }
+}
+
+static void deadline_sift_down(int idx)
+{
+    while (true) {
+        const int left = 2 * idx + 1;
+        const int right = left + 1;
+        int smallest = idx;
+
+        if (left < Deadlines.count && Deadlines.heap[left].time < Deadlines.heap[smallest].time) {
+            smallest = left;
+        }
+
+        if (right < Deadlines.count && Deadlines.heap[right].time < Deadlines.heap[smallest].time) {
+            smallest = right;
+        }
+
+        if (smallest == idx) {
+            return;
+        }
+
+        deadline_swap(smallest, idx);
+        idx = smallest;
+    }
+}
+
+/* Publishes the earliest deadline to the scheduler. Requires the control lock. */
+static void deadlines_changed(void)
+{
+    const uint64_t next = Deadlines.count > 0 ? Deadlines.heap[0].time : 0;
+    const uint64_t prev = atomic_exchange(&next_deadline, next);
+
+    if (next != 0 && (prev == 0 || next < prev)) {
+        scheduler_reschedule(SCHED_TASK_NOTIFY);
+    }
+}
+
+/*
+ * Schedules a deadline of `type` for `slot` at `time`. If one is already queued it's
+ * moved to `time` if that's earlier, and left alone otherwise.
+ *
+ * Requires the control lock.
+ */
+static void schedule_deadline(Notify_Deadline_Type type, int slot, uint64_t time)
+{
+    if (Deadlines.queued[type][slot]) {
+        for (int i = 0; i < Deadlines.count; ++i) {
+            struct Notify_Deadline *deadline = &Deadlines.heap[i];
+
+            if (deadline->type == type && deadline->slot == slot) {
+                if (time < deadline->time) {
+                    deadline->time = time;
+                    deadline_sift_up(i);
+                    deadlines_changed();
+                }
+
+                return;
+            }
+        }
+
+        return;
+    }
+
+    const int idx = Deadlines.count++;
+
+    Deadlines.heap[idx] = (struct Notify_Deadline) {
+        .time = time,
+        .type = type,
+        .slot = slot,
+    };
+
+    Deadlines.queued[type][slot] = true;
+    deadline_sift_up(idx);
+    deadlines_changed();
+}
+
+/*
+ * Removes the earliest deadline and copies it to `deadline` if it's due at or before `now`.
+ *
+ * Return true if a deadline was removed.
+ * Requires the control lock.
+ */
+static bool pop_expired_deadline(uint64_t now, struct Notify_Deadline *deadline)
+{
+    if (Deadlines.count == 0 || Deadlines.heap[0].time > now) {
+        return false;
+    }
+
+    *deadline = Deadlines.heap[0];
+    Deadlines.heap[0] = Deadlines.heap[--Deadlines.count];
+    Deadlines.queued[deadline->type][deadline->slot] = false;
+    deadline_sift_down(0);
+
+    return true;
+}
+#endif /* defined(SOUND_NOTIFY) || defined(BOX_NOTIFY) */
+
 #ifdef SOUND_NOTIFY
+static void stop_sound_locked(int id);
+
 static bool is_playing(int source)
 {
     int ready;
@@ -177,21 +379,25 @@ static bool is_playing(int source)
     return ready == AL_PLAYING;
 }
 
-/* TODO maybe find better way to do this */
+/* If a sound is still playing when it should have finished we look again this many milliseconds later */
+#define SOUND_RECHECK_INTERVAL 50
+
 /* cooldown is in seconds */
 #define DEVICE_COOLDOWN 5 /* TODO perhaps load this from config? */
 static bool device_opened = false;
-static time_t last_opened_update = 0;
+static uint64_t last_opened_update = 0;  /* monotonic time in ms */
 
 /* Opens primary device. Returns true on succe*/
 static void m_open_device(const Client_Config *c_config)
 {
-    last_opened_update = get_unix_time();
+    last_opened_update = notify_time_ms();
 
     if (device_opened) {
         return;
     }
 
+    schedule_deadline(NOTIFY_DEADLINE_DEVICE, 0, last_opened_update + DEVICE_COOLDOWN * 1000);
+
 #ifdef AUDIO
     const double VAD_threshold = c_config->VAD_threshold;
 #else
@@ -201,6 +407,8 @@ static void m_open_device(const Client_Config *c_config)
     /* TODO: error check */
     open_output_device(&Control.device_idx, 48000, 20, 1, VAD_threshold);
 
+    alGenSources(ACTIVE_NOTIFS_MAX, Control.sources);
+
     device_opened = true;
 }
 
@@ -210,11 +418,108 @@ static void m_close_device(void)
         return;
     }
 
+    for (size_t i = 0; i < ACTIVE_NOTIFS_MAX; ++i) {
+        alSourceStop(Control.sources[i]);
+    }
+
+    alDeleteSources(ACTIVE_NOTIFS_MAX, Control.sources);
+    memset(Control.sources, 0, sizeof(Control.sources));
+
+    for (size_t i = 0; i < SOUNDS_SIZE; ++i) {
+        if (Control.sounds[i].buffer != 0) {
+            alDeleteBuffers(1, &Control.sounds[i].buffer);
+            Control.sounds[i].buffer = 0;
+        }
+    }
+
     close_device(output, Control.device_idx);
 
     device_opened = false;
 }
 
+/* Stops the sound playing in actives slot `idx` and detaches it from its source. */
+static void release_source(size_t idx)
+{
+    alSourceStop(actives[idx].source);
+    alSourcei(actives[idx].source, AL_BUFFER, 0);
+}
+
+/*
+ * Returns the OpenAL buffer for `what`, uploading the decoded samples if this is the first
+ * time the sound is played since the device was opened.
+ *
+ * Returns 0 if the sound can't be played.
+ */
+static uint32_t sound_buffer(Notification what)
+{
+    struct Notify_Sound *sound = &Control.sounds[what];
+
+    if (sound->data == NULL || !device_opened) {
+        return 0;
+    }
+
+    if (sound->buffer == 0) {
+        alGenBuffers(1, &sound->buffer);
+        alBufferData(sound->buffer, sound->format, sound->data, sound->size, (int) sound->frequency);
+
+        if (alGetError() != AL_NO_ERROR) {
+            alDeleteBuffers(1, &sound->buffer);
+            sound->buffer = 0;
+        }
+    }
+
+    return sound->buffer;
+}
+
+/* Decodes the file for `sound` into memory. Requires alut to be initialized. */
+static void decode_sound(struct Notify_Sound *sound)
+{
+    free(sound->data);
+    sound->data = NULL;
+
+    if (sound->buffer != 0) {
+        alDeleteBuffers(1, &sound->buffer);
+        sound->buffer = 0;
+    }
+
+    if (sound->path == NULL) {
+        return;
+    }
+
+    ALenum format;
+    ALsizei size;
+    ALfloat frequency;
+    void *data = alutLoadMemoryFromFile(sound->path, &format, &size, &frequency);
+
+    if (data == NULL) {
+        fprintf(stderr, "Failed to decode notification sound `%s`\n", sound->path);
+        return;
+    }
+
+    int frame_size;
+
+    switch (format) {
+        case AL_FORMAT_MONO8:
+            frame_size = 1;
+            break;
+
+        case AL_FORMAT_MONO16:
+        case AL_FORMAT_STEREO8:
+            frame_size = 2;
+            break;
+
+        default:
+            frame_size = 4;
+            break;
+    }
+
+    sound->data = data;
+    sound->format = format;
+    sound->size = size;
+    sound->frequency = frequency;
+    sound->duration = frequency > 0 ? (uint32_t)(1000.0 * size / frame_size / frequency) : 0;
+}
+
 /* Terminate all sounds but wait for them to finish first */
 static void graceful_clear(void)
 {
@@ -240,7 +545,7 @@ static void graceful_clear(void)
                 }
 
                 if (actives[i].looping) {
-                    stop_sound(i);
+                    stop_sound_locked(i);
                 } else {
                     if (!is_playing(actives[i].source)) {
                         clear_actives_index(i);
@@ -263,132 +568,85 @@ static void graceful_clear(void)
     control_unlock();
 }
 
-static void *do_playing(void *_p)
+/* Plays `buffer`, which lasts `duration` milliseconds, in a free actives slot.
+ *
+ * Return the slot on success.
+ * Return -1 if all slots are in use.
+ */
+static int play_source(uint32_t buffer, uint32_t duration, bool looping)
 {
-    UNUSED_VAR(_p);
-
-    while (true) {
-        control_lock();
-
-        if (!Control.poll_active) {
-            control_unlock();
-            break;
-        }
-
-        bool has_looping = false;
-        bool test_active_notify = false;
-        int i;
-
-        for (i = 0; i < ACTIVE_NOTIFS_MAX; ++i) {
-
-            if (actives[i].looping) {
-                has_looping = true;
-            }
-
-            test_active_notify = actives[i].active && !actives[i].looping;
-#ifdef BOX_NOTIFY
-            test_active_notify = test_active_notify && !actives[i].box;
-#endif
-
-            if (test_active_notify) {
-                if (actives[i].id_indicator) {
-                    *actives[i].id_indicator = -1;    /* reset indicator value */
-                }
-
-                if (!is_playing(actives[i].source)) {
-                    /* Close */
-                    alSourceStop(actives[i].source);
-                    alDeleteSources(1, &actives[i].source);
-                    alDeleteBuffers(1, &actives[i].buffer);
-                    clear_actives_index(i);
-                }
-            }
-
-#ifdef BOX_NOTIFY
-            else if (actives[i].box && time(NULL) >= actives[i].n_timeout) {
-                GError *ignore;
-                notify_notification_close(actives[i].box, &ignore);
-                actives[i].box = NULL;
+    int i = 0;
 
-                if (actives[i].id_indicator) {
-                    *actives[i].id_indicator = -1;    /* reset indicator value */
-                }
+    for (; i < ACTIVE_NOTIFS_MAX && actives[i].active; ++i);
 
-                if (!actives[i].looping && !is_playing(actives[i].source)) {
-                    /* stop source if not looping or playing, just terminate box */
-                    alSourceStop(actives[i].source);
-                    alDeleteSources(1, &actives[i].source);
-                    alDeleteBuffers(1, &actives[i].buffer);
-                    clear_actives_index(i);
-                }
-            }
+    if (i == ACTIVE_NOTIFS_MAX) {
+        return -1; /* Full */
+    }
 
-#endif /* BOX_NOTIFY */
-        }
+    const uint32_t source = Control.sources[i];
 
-        /* device is opened and no activity in under DEVICE_COOLDOWN time, close device*/
-        if (device_opened && !has_looping &&
-                (time(NULL) - last_opened_update) > DEVICE_COOLDOWN) {
-            m_close_device();
-        }
+    alSourcei(source, AL_BUFFER, buffer);
+    alSourcei(source, AL_LOOPING, looping);
+    alSourcePlay(source);
 
-        has_looping = false;
+    actives[i].active = 1;
+    actives[i].source = source;
+    actives[i].looping = looping;
 
-        control_unlock();
-        sleep_thread(100000L);
+    if (!looping) {
+        schedule_deadline(NOTIFY_DEADLINE_SOUND, i, notify_time_ms() + duration);
     }
 
-    pthread_exit(NULL);
+    return i;
 }
 
-static int play_source(uint32_t source, uint32_t buffer, bool looping)
+/* Stops looking after the output device if nothing needs it any more */
+static void device_deadline_expired(uint64_t now)
 {
-    int i = 0;
-
-    for (; i < ACTIVE_NOTIFS_MAX && actives[i].active; ++i);
+    if (!device_opened) {
+        return;
+    }
 
-    if (i == ACTIVE_NOTIFS_MAX) {
-        return -1; /* Full */
+    for (size_t i = 0; i < ACTIVE_NOTIFS_MAX; ++i) {
+        if (actives[i].looping) {
+            return;  /* rescheduled by stop_sound() */
+        }
     }
 
-    alSourcePlay(source);
+    const uint64_t idle_until = last_opened_update + DEVICE_COOLDOWN * 1000;
 
-    actives[i].active = 1;
-    actives[i].source = source;
-    actives[i].buffer = buffer;
-    actives[i].looping = looping;
+    if (now < idle_until) {
+        schedule_deadline(NOTIFY_DEADLINE_DEVICE, 0, idle_until);
+        return;
+    }
 
-    return i;
+    m_close_device();
 }
 
-#elif BOX_NOTIFY
-static void *do_playing(void *_p)
+static void sound_deadline_expired(int i, uint64_t now)
 {
-    UNUSED_VAR(_p);
+    if (!actives[i].active || actives[i].looping) {
+        return;
+    }
 
-    while (true) {
-        control_lock();
+#ifdef BOX_NOTIFY
 
-        if (!Control.poll_active) {
-            control_unlock();
-            break;
-        }
+    if (actives[i].box) {
+        return;  /* the slot is cleared when the box expires */
+    }
 
-        for (size_t i = 0; i < ACTIVE_NOTIFS_MAX; ++i) {
-            if (actives[i].box && time(NULL) >= actives[i].n_timeout) {
-                GError *ignore;
-                notify_notification_close(actives[i].box, &ignore);
-                clear_actives_index(i);
-            }
-        }
+#endif /* BOX_NOTIFY */
 
-        control_unlock();
-        sleep_thread(10000L);
+    if (is_playing(actives[i].source)) {
+        schedule_deadline(NOTIFY_DEADLINE_SOUND, i, now + SOUND_RECHECK_INTERVAL);
+        return;
     }
 
-    pthread_exit(NULL);
+    release_source(i);
+    clear_actives_index(i);
 }
 
+#elif BOX_NOTIFY
 static void graceful_clear(void)
 {
     control_lock();
@@ -407,6 +665,114 @@ static void graceful_clear(void)
 
 #endif /* SOUND_NOTIFY */
 
+#if defined(SOUND_NOTIFY) || defined(BOX_NOTIFY)
+#ifdef BOX_NOTIFY
+static void box_deadline_expired(int i, uint64_t now)
+{
+    if (!actives[i].box) {
+        return;
+    }
+
+    /* The box was updated after this deadline was set */
+    if (now < actives[i].n_deadline) {
+        schedule_deadline(NOTIFY_DEADLINE_BOX, i, actives[i].n_deadline);
+        return;
+    }
+
+    GError *ignore;
+    notify_notification_close(actives[i].box, &ignore);
+    actives[i].box = NULL;
+
+#ifdef SOUND_NOTIFY
+
+    if (actives[i].id_indicator) {
+        *actives[i].id_indicator = -1;    /* reset indicator value */
+    }
+
+    if (actives[i].looping) {
+        return;
+    }
+
+    if (is_playing(actives[i].source)) {
+        schedule_deadline(NOTIFY_DEADLINE_SOUND, i, now + SOUND_RECHECK_INTERVAL);
+        return;
+    }
+
+    release_source(i);
+#endif /* SOUND_NOTIFY */
+
+    clear_actives_index(i);
+}
+
+/* Sets the time at which the box in slot `i` expires. Requires the control lock. */
+static void set_box_deadline(int i)
+{
+    actives[i].n_deadline = notify_time_ms() + Control.notif_timeout;
+    schedule_deadline(NOTIFY_DEADLINE_BOX, i, actives[i].n_deadline);
+}
+#endif /* BOX_NOTIFY */
+
+/* Handles every deadline that has expired. Runs in the main loop. */
+static void notify_task_run(void *data)
+{
+    UNUSED_VAR(data);
+
+    control_lock();
+
+    if (!Control.poll_active) {
+        control_unlock();
+        return;
+    }
+
+    const uint64_t now = notify_time_ms();
+    struct Notify_Deadline deadline;
+
+    while (pop_expired_deadline(now, &deadline)) {
+        switch (deadline.type) {
+#ifdef SOUND_NOTIFY
+
+            case NOTIFY_DEADLINE_SOUND:
+                sound_deadline_expired(deadline.slot, now);
+                break;
+
+            case NOTIFY_DEADLINE_DEVICE:
+                device_deadline_expired(now);
+                break;
+#endif /* SOUND_NOTIFY */
+#ifdef BOX_NOTIFY
+
+            case NOTIFY_DEADLINE_BOX:
+                box_deadline_expired(deadline.slot, now);
+                break;
+#endif /* BOX_NOTIFY */
+
+            default:
+                break;
+        }
+    }
+
+    deadlines_changed();
+
+    control_unlock();
+}
+
+/* Sleeps until the earliest deadline, or indefinitely if nothing is waiting on one. */
+static int64_t notify_task_interval(void *data)
+{
+    UNUSED_VAR(data);
+
+    const uint64_t next = atomic_load(&next_deadline);
+
+    if (next == 0) {
+        return -1;
+    }
+
+    const uint64_t now = notify_time_ms();
+
+    return next > now ? (int64_t)(next - now) : 0;
+}
+#endif /* defined(SOUND_NOTIFY) || defined(BOX_NOTIFY) */
+
 /* Kills all notifications for `id`. This must be called before freeing a ToxWindow. */
 void kill_notifs(int id)
 {
@@ -426,10 +792,24 @@ void kill_notifs(int id)
             }
 
 #endif // BOX_NOTIFY
+
+#ifdef SOUND_NOTIFY
+            release_source(i);
+#endif /* SOUND_NOTIFY */
+
             clear_actives_index(i);
         }
     }
 
+#ifdef SOUND_NOTIFY
+
+    /* A looping sound may have been cleared */
+    if (device_opened) {
+        schedule_deadline(NOTIFY_DEADLINE_DEVICE, 0, last_opened_update + DEVICE_COOLDOWN * 1000);
+    }
+
+#endif /* SOUND_NOTIFY */
+
     control_unlock();
 }
 
@@ -445,7 +825,15 @@ void kill_notifs(int id)
 int init_notify(int login_cooldown, int notification_timeout)
 {
 #ifdef SOUND_NOTIFY
-    alutInitWithoutContext(NULL, NULL);
+
+    if (alutInitWithoutContext(NULL, NULL)) {
+        Control.alut_ready = true;
+
+        for (size_t i = 0; i < SOUNDS_SIZE; ++i) {
+            decode_sound(&Control.sounds[i]);
+        }
+    }
+
 #endif /* SOUND_NOTIFY */
 
 #if defined(SOUND_NOTIFY) || defined(BOX_NOTIFY)
@@ -455,13 +843,7 @@ int init_notify(int login_cooldown, int notification_timeout)
     }
 
     Control.poll_active = 1;
-    pthread_t thread;
-
-    if (pthread_create(&thread, NULL, do_playing, NULL) != 0 || pthread_detach(thread) != 0) {
-        pthread_mutex_destroy(Control.poll_mutex);
-        Control.poll_active = 0;
-        return -1;
-    }
+    scheduler_set_task(SCHED_TASK_NOTIFY, "notify", notify_task_run, notify_task_interval, NULL);
 
 #endif /* defined(SOUND_NOTIFY) || defined(BOX_NOTIFY) */
     Control.cooldown = time(NULL) + login_cooldown;
@@ -487,16 +869,19 @@ void terminate_notify(void)
     Control.poll_active = 0;
     control_unlock();
 
+    scheduler_set_task(SCHED_TASK_NOTIFY, "notify", NULL, NULL, NULL);
+
     graceful_clear();
 #endif /* defined(SOUND_NOTIFY) || defined(BOX_NOTIFY) */
 
 #ifdef SOUND_NOTIFY
-    int i = 0;
 
-    for (; i < SOUNDS_SIZE; ++i) {
-        free(Control.sounds[i]);
+    for (size_t i = 0; i < SOUNDS_SIZE; ++i) {
+        free(Control.sounds[i].path);
+        free(Control.sounds[i].data);
     }
 
+    Control.alut_ready = false;
     alutExit();
 #endif /* SOUND_NOTIFY */
 
@@ -518,44 +903,46 @@ bool set_sound(Notification sound, const char *value)
         return false;
     }
 
-    free(Control.sounds[sound]);
+    struct Notify_Sound *notify_sound = &Control.sounds[sound];
+
+    free(notify_sound->path);
 
     size_t len = strlen(value) + 1;
-    Control.sounds[sound] = calloc(len, 1);
+    notify_sound->path = calloc(len, 1);
 
-    if (Control.sounds[sound] == NULL) {
+    if (notify_sound->path == NULL) {
         return false;
     }
 
-    memcpy(Control.sounds[sound], value, len);
+    memcpy(notify_sound->path, value, len);
 
     struct stat buf;
-    return stat(value, &buf) == 0;
+
+    if (stat(value, &buf) != 0) {
+        return false;
+    }
+
+    /* Sounds set before init_notify() are decoded there */
+    if (Control.alut_ready) {
+        control_lock();
+        decode_sound(notify_sound);
+        control_unlock();
+    }
+
+    return true;
 }
 
 static int play_sound_internal(const Client_Config *c_config, Notification what, bool loop)
 {
-    uint32_t source;
-    uint32_t buffer;
-
     m_open_device(c_config);
 
-    alGenSources(1, &source);
-    alGenBuffers(1, &buffer);
-    buffer = alutCreateBufferFromFile(Control.sounds[what]);
-    alSourcei(source, AL_BUFFER, buffer);
-    alSourcei(source, AL_LOOPING, loop);
-
-    int rc = play_source(source, buffer, loop);
+    const uint32_t buffer = sound_buffer(what);
 
-    if (rc < 0) {
-        alSourceStop(source);
-        alDeleteSources(1, &source);
-        alDeleteBuffers(1, &buffer);
+    if (buffer == 0) {
         return -1;
     }
 
-    return rc;
+    return play_source(buffer, Control.sounds[what].duration, loop);
 }
 
 static int play_notify_sound(const Client_Config *c_config, Notification notif, uint64_t flags)
@@ -567,7 +954,7 @@ static int play_notify_sound(const Client_Config *c_config, Notification notif,
     }
 
     if (notif != silent) {
-        if (!Control.poll_active || !Control.sounds[notif]) {
+        if (!Control.poll_active || Control.sounds[notif].data == NULL) {
             return -1;
         }
 
@@ -577,7 +964,8 @@ static int play_notify_sound(const Client_Config *c_config, Notification notif,
     return rc;
 }
 
-void stop_sound(int id)
+/* Requires the control lock. */
+static void stop_sound_locked(int id)
 {
     if (id >= 0 && id < ACTIVE_NOTIFS_MAX && actives[id].looping && actives[id].active) {
 #ifdef BOX_NOTIFY
@@ -589,13 +977,21 @@ void stop_sound(int id)
 
 #endif /* BOX_NOTIFY */
 
-        // alSourcei(actives[id].source, AL_LOOPING, false);
-        alSourceStop(actives[id].source);
-        alDeleteSources(1, &actives[id].source);
-        alDeleteBuffers(1, &actives[id].buffer);
+        release_source(id);
         clear_actives_index(id);
+
+        if (device_opened) {
+            schedule_deadline(NOTIFY_DEADLINE_DEVICE, 0, last_opened_update + DEVICE_COOLDOWN * 1000);
+        }
     }
 }
+
+void stop_sound(int id)
+{
+    control_lock();
+    stop_sound_locked(id);
+    control_unlock();
+}
 #endif /* SOUND_NOTIFY */
 
 static int m_play_sound(const Client_Config *c_config, Notification notif, uint64_t flags)
@@ -623,12 +1019,14 @@ int sound_notify(ToxWindow *self, const Toxic *toxic, Notification notif, uint64
         return -1;
     }
 
+    const bool can_play = !sound_is_coalesced(self, notif, flags);
+
     int id = -1;
     control_lock();
 
-    if (self && (!self->stb || self->stb->status != TOX_USER_STATUS_BUSY)) {
+    if (can_play && self && (!self->stb || self->stb->status != TOX_USER_STATUS_BUSY)) {
         id = m_play_sound(c_config, notif, flags);
-    } else if (flags & NT_ALWAYS) {
+    } else if (can_play && (flags & NT_ALWAYS)) {
         id = m_play_sound(c_config, notif, flags);
     }
 
@@ -670,25 +1068,32 @@ int sound_notify2(ToxWindow *self, const Toxic *toxic, Notification notif, uint6
 #ifdef SOUND_NOTIFY
     control_lock();
 
-    if (!actives[id].active || !Control.sounds[notif]) {
+    if (!actives[id].active || notif == silent || Control.sounds[notif].data == NULL) {
         control_unlock();
         return -1;
     }
 
     m_open_device(toxic->c_config);
 
-    alSourceStop(actives[id].source);
-    alDeleteSources(1, &actives[id].source);
-    alDeleteBuffers(1, &actives[id].buffer);
+    const uint32_t buffer = sound_buffer(notif);
+
+    if (buffer == 0) {
+        control_unlock();
+        return -1;
+    }
+
+    release_source(id);
 
-    alGenSources(1, &actives[id].source);
-    alGenBuffers(1, &actives[id].buffer);
-    actives[id].buffer = alutCreateBufferFromFile(Control.sounds[notif]);
-    alSourcei(actives[id].source, AL_BUFFER, actives[id].buffer);
-    alSourcei(actives[id].source, AL_LOOPING, flags & NT_LOOP);
+    actives[id].source = Control.sources[id];
+    alSourcei(actives[id].source, AL_BUFFER, buffer);
+    alSourcei(actives[id].source, AL_LOOPING, (flags & NT_LOOP) != 0);
 
     alSourcePlay(actives[id].source);
 
+    if ((flags & NT_LOOP) == 0) {
+        schedule_deadline(NOTIFY_DEADLINE_SOUND, id, notify_time_ms() + Control.sounds[notif].duration);
+    }
+
     control_unlock();
 
     return id;
@@ -767,7 +1172,7 @@ int box_notify(ToxWindow *self, const Toxic *toxic, Notification notif, uint64_t
 
     actives[id].box = notify_notification_new(actives[id].title, actives[id].messages[0], NULL);
     actives[id].size++;
-    actives[id].n_timeout = get_unix_time() + Control.notif_timeout / 1000;
+    set_box_deadline(id);
 
     notify_notification_set_timeout(actives[id].box, Control.notif_timeout);
     notify_notification_set_app_name(actives[id].box, "toxic");
@@ -817,7 +1222,7 @@ int box_notify2(ToxWindow *self, const Toxic *toxic, Notification notif, uint64_
     }
 
     actives[id].size++;
-    actives[id].n_timeout = get_unix_time() + Control.notif_timeout / 1000;
+    set_box_deadline(id);
 
     char *formatted = calloc(1, sizeof(char) * ((MAX_BOX_MSG_LEN + 1) * (MAX_BOX_MSG_LEN + 2)));
 
@@ -890,7 +1295,7 @@ int box_silent_notify(ToxWindow *self, const Toxic *toxic, uint64_t flags, int *
     actives[id].active = 1;
     actives[id].box = notify_notification_new(actives[id].title, actives[id].messages[0], NULL);
     actives[id].size ++;
-    actives[id].n_timeout = get_unix_time() + Control.notif_timeout / 1000;
+    set_box_deadline(id);
 
     notify_notification_set_timeout(actives[id].box, Control.notif_timeout);
     notify_notification_set_app_name(actives[id].box, "toxic");
@@ -937,7 +1342,7 @@ int box_silent_notify2(ToxWindow *self, const Toxic *toxic, uint64_t flags, int
     }
 
     actives[id].size ++;
-    actives[id].n_timeout = get_unix_time() + Control.notif_timeout / 1000;
+    set_box_deadline(id);
 
     char *formatted = calloc(1, sizeof(char) * ((MAX_BOX_MSG_LEN + 1) * (MAX_BOX_MSG_LEN + 2)));
 
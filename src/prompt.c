@@ -20,10 +20,6 @@
  *
  */
 
-#ifndef _GNU_SOURCE
-#define _GNU_SOURCE    /* needed for wcswidth() */
-#endif
-
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
@@ -75,6 +71,8 @@ static const char *const glob_cmd_list[] = {
     "/nospam",
     "/quit",
     "/requests",
+    "/sched",
+    "/source",
     "/status",
 
 #ifdef AUDIO
@@ -93,6 +91,7 @@ static const char *const glob_cmd_list[] = {
 
 #ifdef PYTHON
 
+    "/plugins",
     "/run",
 
 #endif /* PYTHON */
@@ -110,6 +109,7 @@ void kill_prompt_window(ToxWindow *self, Windows *windows, const Client_Config *
 
         delwin(ctx->linewin);
         delwin(ctx->history);
+        free_line_history(ctx);
         free(ctx->log);
         free(ctx);
     }
@@ -175,6 +175,11 @@ void prompt_update_status(ToxWindow *self, Tox_User_Status status)
 /* Returns our own connection status */
 Tox_Connection prompt_selfConnectionStatus(Toxic *toxic)
 {
+    /* There's no home window in headless mode */
+    if (toxic->home_window == NULL) {
+        return tox_self_get_connection_status(toxic->tox);
+    }
+
     StatusBar *statusbar = toxic->home_window->stb;
     return statusbar->connection;
 }
@@ -276,7 +281,7 @@ static bool prompt_onKey(ToxWindow *self, Toxic *toxic, wint_t key, bool ltr)
 
             if (diff != -1) {
                 if (x + diff > x2 - 1) {
-                    int wlen = MAX(0, wcswidth(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
+                    int wlen = MAX(0, wcs_width(ctx->line, sizeof(ctx->line) / sizeof(wchar_t)));
                     ctx->start = wlen < x2 ? 0 : wlen - x2 + 1;
                 }
             } else {
@@ -483,7 +488,7 @@ static void prompt_onDraw(ToxWindow *self, Toxic *toxic)
 
     UNUSED_VAR(x);
 
-    const int new_x = ctx->start ? x2 - 1 : MAX(0, wcswidth(ctx->line, ctx->pos));
+    const int new_x = ctx->start ? x2 - 1 : MAX(0, wcs_width(ctx->line, ctx->pos));
     wmove(self->window, y, new_x);
 
     draw_window_bar(self, toxic->windows);
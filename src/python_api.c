@@ -25,17 +25,339 @@
 #ifdef PYTHON
 #include <Python.h>
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
 #include "execute.h"
+#include "misc_tools.h"
+#include "python_api.h"
+#include "scheduler.h"
 
 extern Toxic       *user_toxic;
 
+/* The most jobs that can wait for the worker thread, shared by all plugins */
+#define PYTHON_JOB_QUEUE_SIZE 256
+
+/* The most jobs that can wait for a single plugin. Events for it are dropped until it catches up */
+#define PYTHON_PLUGIN_MAX_PENDING 32
+
+/* The most replies that can wait for the main thread. Plugins block while it's full */
+#define PYTHON_REPLY_QUEUE_SIZE 128
+
+/* How long the worker sleeps between attempts to take the UI lock, in microseconds */
+#define PYTHON_LOCK_POLL_USEC 1000L
+
+/* Plugin code that runs for longer than this many milliseconds in one go is interrupted with a TimeoutError */
+#define PYTHON_CALL_TIMEOUT 5000
+
+/*
+ * A script run with `/run` or from the autorun directory. Commands and subscriptions belong to
+ * the plugin whose code registered them.
+ */
+typedef struct Python_Plugin {
+    char     *path;
+    uint64_t  calls;
+    uint64_t  errors;
+    uint64_t  dropped;
+    uint64_t  total_us;
+    uint64_t  max_us;
+    uint32_t  pending;
+    struct Python_Plugin *next;
+} Python_Plugin;
+
 static struct python_registered_func {
     char     *name;
     char     *help;
     PyObject *callback;
+    Python_Plugin *plugin;
     struct python_registered_func *next;
 } python_commands = {0};
 
+typedef struct Python_Subscriber {
+    Python_Event_Type type;
+    PyObject         *callback;
+    Python_Plugin    *plugin;
+    struct Python_Subscriber *next;
+} Python_Subscriber;
+
+typedef enum Python_Job_Type {
+    PYTHON_JOB_RUN,
+    PYTHON_JOB_COMMAND,
+    PYTHON_JOB_EVENT,
+} Python_Job_Type;
+
+/*
+ * Work for the worker thread. Registered commands and subscribers are only freed once the worker
+ * has stopped, so a job may point to them without holding a reference to their callback.
+ */
+typedef struct Python_Job {
+    Python_Job_Type     type;
+    Python_Plugin      *plugin;
+    struct python_registered_func *command;    // PYTHON_JOB_COMMAND
+    char              (*args)[MAX_STR_SIZE];   // PYTHON_JOB_COMMAND
+    int                 num_args;
+    Python_Subscriber  *subscriber;            // PYTHON_JOB_EVENT
+    Python_Event_Source source;
+    uint32_t            number;
+    uint32_t            peer;
+    char               *text;                  // the event's text, or the script path for PYTHON_JOB_RUN
+} Python_Job;
+
+typedef enum Python_Reply_Type {
+    PYTHON_REPLY_DISPLAY,
+    PYTHON_REPLY_SEND,
+    PYTHON_REPLY_SEND_FRIEND,
+    PYTHON_REPLY_EXECUTE,
+} Python_Reply_Type;
+
+/* A call from a plugin into the client, carried out by the main thread */
+typedef struct Python_Reply {
+    Python_Reply_Type type;
+    int               mode;
+    uint32_t          friend_number;
+    char             *text;
+} Python_Reply;
+
+static struct Python_Worker {
+    pthread_t       thread;
+    pthread_mutex_t lock;        // guards everything below, and the command list
+    pthread_cond_t  job_cond;    // signalled when a job is queued or the worker should stop
+    pthread_cond_t  reply_cond;  // signalled when the main thread has taken the queued replies
+    bool            running;
+    bool            busy;        // true while the worker is running Python code
+    unsigned long   thread_ident;
+
+    /* When the running call times out, in monotonic microseconds. 0 when no call is running. Only
+     * set by the worker while it holds the GIL. */
+    _Atomic uint64_t call_deadline;
+
+    Python_Job      jobs[PYTHON_JOB_QUEUE_SIZE];
+    size_t          jobs_head;
+    size_t          num_jobs;
+
+    Python_Reply    replies[PYTHON_REPLY_QUEUE_SIZE];
+    size_t          num_replies;
+
+    Python_Plugin     *plugins;
+    Python_Subscriber *subscribers;
+
+    PyThreadState  *main_thread_state;
+} python_worker;
+
+/* The plugin whose code the worker thread is running. Only used by the worker thread. */
+static Python_Plugin *python_current_plugin;
+
+static const char *const python_event_names[PYTHON_EVENT_MAX] = {
+    "message",
+    "peer_join",
+    "file_received",
+    "status",
+};
+
+static const char *python_event_source_name(Python_Event_Source source)
+{
+    switch (source) {
+        case PYTHON_SOURCE_FRIEND:
+            return "friend";
+
+        case PYTHON_SOURCE_CONFERENCE:
+            return "conference";
+
+        case PYTHON_SOURCE_GROUP:
+            return "group";
+    }
+
+    return "unknown";
+}
+
+const char *python_user_status_name(Tox_User_Status status)
+{
+    switch (status) {
+        case TOX_USER_STATUS_NONE:
+            return "online";
+
+        case TOX_USER_STATUS_AWAY:
+            return "away";
+
+        case TOX_USER_STATUS_BUSY:
+            return "busy";
+    }
+
+    return "unknown";
+}
+
+static uint64_t python_time_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t) t.tv_sec) * 1000000 + ((uint64_t) t.tv_nsec) / 1000;
+}
+
+static bool python_worker_running(void)
+{
+    pthread_mutex_lock(&python_worker.lock);
+    const bool running = python_worker.running;
+    pthread_mutex_unlock(&python_worker.lock);
+
+    return running;
+}
+
+/*
+ * Returns the plugin for the script at `path`, creating it if it doesn't exist.
+ * Returns NULL on failure.
+ *
+ * Must be called with the worker lock held.
+ */
+static Python_Plugin *python_get_plugin(const char *path)
+{
+    for (Python_Plugin *plugin = python_worker.plugins; plugin != NULL; plugin = plugin->next) {
+        if (strcmp(plugin->path, path) == 0) {
+            return plugin;
+        }
+    }
+
+    Python_Plugin *plugin = calloc(1, sizeof(Python_Plugin));
+
+    if (plugin == NULL) {
+        return NULL;
+    }
+
+    plugin->path = strdup(path);
+
+    if (plugin->path == NULL) {
+        free(plugin);
+        return NULL;
+    }
+
+    plugin->next = python_worker.plugins;
+    python_worker.plugins = plugin;
+
+    return plugin;
+}
+
+static void python_job_free(Python_Job *job)
+{
+    free(job->args);
+    free(job->text);
+}
+
+/*
+ * Adds `job` to the worker's queue. The queue takes ownership of the job's allocations.
+ *
+ * Return true on success.
+ * Return false if the queue is full or the job's plugin already has too many jobs waiting. The
+ * caller still owns the job in that case.
+ *
+ * Must be called with the worker lock held.
+ */
+static bool python_job_push(const Python_Job *job)
+{
+    if (!python_worker.running || python_worker.num_jobs >= PYTHON_JOB_QUEUE_SIZE
+            || job->plugin->pending >= PYTHON_PLUGIN_MAX_PENDING) {
+        return false;
+    }
+
+    const size_t idx = (python_worker.jobs_head + python_worker.num_jobs) % PYTHON_JOB_QUEUE_SIZE;
+    python_worker.jobs[idx] = *job;
+    ++python_worker.num_jobs;
+    ++job->plugin->pending;
+
+    pthread_cond_signal(&python_worker.job_cond);
+
+    return true;
+}
+
+/*
+ * Queues a call into the client for the main thread. Blocks while the reply queue is full, with the
+ * GIL released so other Python threads can run.
+ *
+ * Return true on success.
+ * Return false on allocation failure or if the worker is being stopped.
+ *
+ * Must be called from Python code.
+ */
+static bool python_reply_push(Python_Reply_Type type, int mode, uint32_t friend_number, const char *text)
+{
+    char *text_copy = strdup(text);
+
+    if (text_copy == NULL) {
+        return false;
+    }
+
+    bool ret = false;
+
+    Py_BEGIN_ALLOW_THREADS
+
+    pthread_mutex_lock(&python_worker.lock);
+
+    while (python_worker.running && python_worker.num_replies >= PYTHON_REPLY_QUEUE_SIZE) {
+        pthread_cond_wait(&python_worker.reply_cond, &python_worker.lock);
+    }
+
+    if (python_worker.running) {
+        Python_Reply *reply = &python_worker.replies[python_worker.num_replies];
+        reply->type = type;
+        reply->mode = mode;
+        reply->friend_number = friend_number;
+        reply->text = text_copy;
+        ++python_worker.num_replies;
+        ret = true;
+    }
+
+    pthread_mutex_unlock(&python_worker.lock);
+
+    Py_END_ALLOW_THREADS
+
+    if (!ret) {
+        free(text_copy);
+        return false;
+    }
+
+    scheduler_trigger(SCHED_TASK_PYTHON);
+
+    return true;
+}
+
+/*
+ * Queues a reply and sets a Python exception if that fails.
+ */
+static PyObject *python_reply(Python_Reply_Type type, int mode, uint32_t friend_number, const char *text)
+{
+    if (!python_reply_push(type, mode, friend_number, text)) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to pass the request to Toxic");
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+/*
+ * Takes the UI lock from the worker thread, releasing the GIL while waiting for it. The lock is
+ * polled rather than waited on so that the worker can still be stopped while another thread holds it.
+ *
+ * Return true if the lock was acquired.
+ * Return false (and sets a Python exception) if the worker is being stopped.
+ */
+static bool python_lock_tox(void)
+{
+    while (pthread_mutex_trylock(&Winthread.lock) != 0) {
+        if (!python_worker_running()) {
+            PyErr_SetString(PyExc_RuntimeError, "Toxic is shutting down");
+            return false;
+        }
+
+        Py_BEGIN_ALLOW_THREADS
+        usleep(PYTHON_LOCK_POLL_USEC);
+        Py_END_ALLOW_THREADS
+    }
+
+    return true;
+}
+
 static PyObject *python_api_display(PyObject *self, PyObject *args)
 {
     const char *msg;
@@ -44,8 +366,7 @@ static PyObject *python_api_display(PyObject *self, PyObject *args)
         return NULL;
     }
 
-    api_display(msg);
-    return Py_None;
+    return python_reply(PYTHON_REPLY_DISPLAY, 0, 0, msg);
 }
 
 static PyObject *python_api_get_nick(PyObject *self, PyObject *args)
@@ -57,10 +378,16 @@ static PyObject *python_api_get_nick(PyObject *self, PyObject *args)
         return NULL;
     }
 
+    if (!python_lock_tox()) {
+        return NULL;
+    }
+
     name = api_get_nick();
 
+    pthread_mutex_unlock(&Winthread.lock);
+
     if (name == NULL) {
-        return NULL;
+        return PyErr_NoMemory();
     }
 
     ret  = Py_BuildValue("s", name);
@@ -70,27 +397,19 @@ static PyObject *python_api_get_nick(PyObject *self, PyObject *args)
 
 static PyObject *python_api_get_status(PyObject *self, PyObject *args)
 {
-    PyObject        *ret = NULL;
-
     if (!PyArg_ParseTuple(args, "")) {
         return NULL;
     }
 
-    switch (api_get_status()) {
-        case TOX_USER_STATUS_NONE:
-            ret = Py_BuildValue("s", "online");
-            break;
+    if (!python_lock_tox()) {
+        return NULL;
+    }
 
-        case TOX_USER_STATUS_AWAY:
-            ret = Py_BuildValue("s", "away");
-            break;
+    const Tox_User_Status status = api_get_status();
 
-        case TOX_USER_STATUS_BUSY:
-            ret = Py_BuildValue("s", "busy");
-            break;
-    }
+    pthread_mutex_unlock(&Winthread.lock);
 
-    return ret;
+    return Py_BuildValue("s", python_user_status_name(status));
 }
 
 static PyObject *python_api_get_status_message(PyObject *self, PyObject *args)
@@ -102,10 +421,16 @@ static PyObject *python_api_get_status_message(PyObject *self, PyObject *args)
         return NULL;
     }
 
+    if (!python_lock_tox()) {
+        return NULL;
+    }
+
     status = api_get_status_message();
 
+    pthread_mutex_unlock(&Winthread.lock);
+
     if (status == NULL) {
-        return NULL;
+        return PyErr_NoMemory();
     }
 
     ret    = Py_BuildValue("s", status);
@@ -122,9 +447,19 @@ static PyObject *python_api_get_all_friends(PyObject *self, PyObject *args)
         return NULL;
     }
 
-    friends = api_get_friendslist();
     PyObject *ret = PyList_New(0);
 
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    if (!python_lock_tox()) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+
+    friends = api_get_friendslist();
+
     for (size_t i = 0; i < friends.num_friends; i++) {
         for (size_t ii = 0; ii < TOX_PUBLIC_KEY_SIZE; ii++) {
             snprintf(pubkey_buf + ii * 2, 3, "%02X", friends.list[i].pub_key[ii] & 0xff);
@@ -132,9 +467,15 @@ static PyObject *python_api_get_all_friends(PyObject *self, PyObject *args)
 
         pubkey_buf[TOX_PUBLIC_KEY_SIZE * 2] = '\0';
         PyObject *cur = Py_BuildValue("(s,s)", friends.list[i].name, pubkey_buf);
-        PyList_Append(ret, cur);
+
+        if (cur != NULL) {
+            PyList_Append(ret, cur);
+            Py_DECREF(cur);
+        }
     }
 
+    pthread_mutex_unlock(&Winthread.lock);
+
     return ret;
 }
 
@@ -146,8 +487,19 @@ static PyObject *python_api_send(PyObject *self, PyObject *args)
         return NULL;
     }
 
-    api_send(msg);
-    return Py_None;
+    return python_reply(PYTHON_REPLY_SEND, 0, 0, msg);
+}
+
+static PyObject *python_api_send_friend(PyObject *self, PyObject *args)
+{
+    unsigned int friend_number;
+    const char  *msg;
+
+    if (!PyArg_ParseTuple(args, "Is", &friend_number, &msg)) {
+        return NULL;
+    }
+
+    return python_reply(PYTHON_REPLY_SEND_FRIEND, 0, friend_number, msg);
 }
 
 static PyObject *python_api_execute(PyObject *self, PyObject *args)
@@ -159,8 +511,7 @@ static PyObject *python_api_execute(PyObject *self, PyObject *args)
         return NULL;
     }
 
-    api_execute(command, mode);
-    return Py_None;
+    return python_reply(PYTHON_REPLY_EXECUTE, mode, 0, command);
 }
 
 static PyObject *python_api_register(PyObject *self, PyObject *args)
@@ -184,46 +535,108 @@ static PyObject *python_api_register(PyObject *self, PyObject *args)
         return NULL;
     }
 
+    if (python_current_plugin == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Commands must be registered by a plugin script or callback");
+        return NULL;
+    }
+
+    pthread_mutex_lock(&python_worker.lock);
+
     for (cur = &python_commands; ; cur = cur->next) {
         if (cur->name != NULL && !strcmp(command, cur->name)) {
             Py_XDECREF(cur->callback);
             Py_XINCREF(callback);
             cur->callback = callback;
+            cur->plugin = python_current_plugin;
             break;
         }
 
         if (cur->next == NULL) {
-            Py_XINCREF(callback);
-            cur->next = malloc(sizeof(struct python_registered_func));
-
-            if (cur->next == NULL) {
-                return PyErr_NoMemory();
-            }
+            struct python_registered_func *new_func = calloc(1, sizeof(struct python_registered_func));
 
-            command_len     = strlen(command);
-            cur->next->name = malloc(command_len + 1);
-
-            if (cur->next->name == NULL) {
+            if (new_func == NULL) {
+                pthread_mutex_unlock(&python_worker.lock);
                 return PyErr_NoMemory();
             }
 
-            strncpy(cur->next->name, command, command_len + 1);
-            help_len        = strlen(help);
-            cur->next->help = malloc(help_len + 1);
+            command_len    = strlen(command);
+            new_func->name = malloc(command_len + 1);
+            help_len       = strlen(help);
+            new_func->help = malloc(help_len + 1);
 
-            if (cur->next->help == NULL) {
+            if (new_func->name == NULL || new_func->help == NULL) {
+                free(new_func->name);
+                free(new_func->help);
+                free(new_func);
+                pthread_mutex_unlock(&python_worker.lock);
                 return PyErr_NoMemory();
             }
 
-            strncpy(cur->next->help, help, help_len + 1);
-            cur->next->callback = callback;
-            cur->next->next     = NULL;
+            strncpy(new_func->name, command, command_len + 1);
+            strncpy(new_func->help, help, help_len + 1);
+            Py_XINCREF(callback);
+            new_func->callback = callback;
+            new_func->plugin   = python_current_plugin;
+            new_func->next     = NULL;
+            cur->next          = new_func;
             break;
         }
     }
 
-    Py_INCREF(Py_None);
-    return Py_None;
+    pthread_mutex_unlock(&python_worker.lock);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *python_api_subscribe(PyObject *self, PyObject *args)
+{
+    const char *event;
+    PyObject   *callback;
+
+    if (!PyArg_ParseTuple(args, "sO:subscribe", &event, &callback)) {
+        return NULL;
+    }
+
+    if (!PyCallable_Check(callback)) {
+        PyErr_SetString(PyExc_TypeError, "Callback parameter must be callable");
+        return NULL;
+    }
+
+    if (python_current_plugin == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Events must be subscribed to by a plugin script or callback");
+        return NULL;
+    }
+
+    int type = 0;
+
+    while (type < PYTHON_EVENT_MAX && strcmp(event, python_event_names[type]) != 0) {
+        ++type;
+    }
+
+    if (type == PYTHON_EVENT_MAX) {
+        PyErr_SetString(PyExc_ValueError, "Unknown event");
+        return NULL;
+    }
+
+    Python_Subscriber *subscriber = calloc(1, sizeof(Python_Subscriber));
+
+    if (subscriber == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    Py_INCREF(callback);
+    subscriber->type = (Python_Event_Type) type;
+    subscriber->callback = callback;
+    subscriber->plugin = python_current_plugin;
+
+    pthread_mutex_lock(&python_worker.lock);
+
+    subscriber->next = python_worker.subscribers;
+    python_worker.subscribers = subscriber;
+
+    pthread_mutex_unlock(&python_worker.lock);
+
+    Py_RETURN_NONE;
 }
 
 static PyMethodDef ToxicApiMethods[] = {
@@ -233,8 +646,10 @@ static PyMethodDef ToxicApiMethods[] = {
     {"get_status_message", python_api_get_status_message, METH_VARARGS, "Return the user's current status message"},
     {"get_all_friends",    python_api_get_all_friends,    METH_VARARGS, "Return all of the user's friends"},
     {"send",               python_api_send,               METH_VARARGS, "Send the message to the current user"},
+    {"send_friend",        python_api_send_friend,        METH_VARARGS, "Send the message to a friend by friend number"},
     {"execute",            python_api_execute,            METH_VARARGS, "Execute a command like `/nick`"},
     {"register",           python_api_register,           METH_VARARGS, "Register a command like `/nick` to a Python function"},
+    {"subscribe",          python_api_subscribe,          METH_VARARGS, "Call a Python function(source, number, peer, text) on an event"},
     {NULL,                 NULL,                          0,            NULL},
 };
 
@@ -261,8 +676,319 @@ PyMODINIT_FUNC PyInit_toxic_api(void)
     return m;
 }
 
+/*
+ * Calls `callback` with `args`, which may be NULL if building them failed.
+ *
+ * Return true if the callback returned normally.
+ */
+static bool python_call(PyObject *callback, PyObject *args)
+{
+    if (args == NULL) {
+        PyErr_Clear();
+        return false;
+    }
+
+    PyObject *ret = PyObject_CallObject(callback, args);
+    Py_DECREF(args);
+
+    if (ret == NULL) {
+        PyErr_Clear();
+        python_reply_push(PYTHON_REPLY_DISPLAY, 0, 0, "Exception raised in callback function");
+        return false;
+    }
+
+    Py_DECREF(ret);
+    return true;
+}
+
+/*
+ * Runs `job` on the worker thread with the GIL held.
+ *
+ * Return true if the job's Python code completed without raising an exception.
+ */
+static bool python_run_job(const Python_Job *job)
+{
+    switch (job->type) {
+        case PYTHON_JOB_RUN: {
+            FILE *fp = fopen(job->text, "r");
+
+            if (fp == NULL) {
+                python_reply_push(PYTHON_REPLY_DISPLAY, 0, 0, "Path does not exist.");
+                return false;
+            }
+
+            return PyRun_SimpleFileEx(fp, job->text, 1) == 0;
+        }
+
+        case PYTHON_JOB_COMMAND: {
+            PyObject *args_strings = PyList_New(0);
+
+            if (args_strings == NULL) {
+                PyErr_Clear();
+                return false;
+            }
+
+            for (int i = 1; i < job->num_args; i++) {
+                PyObject *arg = Py_BuildValue("s", job->args[i]);
+
+                if (arg != NULL) {
+                    PyList_Append(args_strings, arg);
+                    Py_DECREF(arg);
+                }
+            }
+
+            return python_call(job->command->callback, Py_BuildValue("(N)", args_strings));
+        }
+
+        case PYTHON_JOB_EVENT: {
+            PyObject *args = Py_BuildValue("(sIIs)", python_event_source_name(job->source), job->number, job->peer,
+                                           job->text);
+            return python_call(job->subscriber->callback, args);
+        }
+    }
+
+    return false;
+}
+
+static void *python_worker_thread(void *data)
+{
+    UNUSED_VAR(data);
+
+    pthread_mutex_lock(&python_worker.lock);
+
+    python_worker.thread_ident = PyThread_get_thread_ident();
+
+    while (true) {
+        while (python_worker.running && python_worker.num_jobs == 0) {
+            pthread_cond_wait(&python_worker.job_cond, &python_worker.lock);
+        }
+
+        if (!python_worker.running) {
+            break;
+        }
+
+        Python_Job job = python_worker.jobs[python_worker.jobs_head];
+        python_worker.jobs_head = (python_worker.jobs_head + 1) % PYTHON_JOB_QUEUE_SIZE;
+        --python_worker.num_jobs;
+        python_worker.busy = true;
+
+        pthread_mutex_unlock(&python_worker.lock);
+
+        const uint64_t start = python_time_us();
+
+        PyGILState_STATE gil = PyGILState_Ensure();
+        python_current_plugin = job.plugin;
+        atomic_store(&python_worker.call_deadline, python_time_us() + PYTHON_CALL_TIMEOUT * 1000);
+        scheduler_reschedule(SCHED_TASK_PYTHON);
+
+        const bool ok = python_run_job(&job);
+
+        atomic_store(&python_worker.call_deadline, 0);
+        python_current_plugin = NULL;
+        PyGILState_Release(gil);
+
+        const uint64_t elapsed = python_time_us() - start;
+
+        python_job_free(&job);
+
+        pthread_mutex_lock(&python_worker.lock);
+
+        python_worker.busy = false;
+
+        Python_Plugin *plugin = job.plugin;
+        --plugin->pending;
+        ++plugin->calls;
+        plugin->total_us += elapsed;
+
+        if (!ok) {
+            ++plugin->errors;
+        }
+
+        if (elapsed > plugin->max_us) {
+            plugin->max_us = elapsed;
+        }
+    }
+
+    pthread_mutex_unlock(&python_worker.lock);
+
+    return NULL;
+}
+
+/*
+ * Raises a TimeoutError in the worker thread if the running call has gone past its deadline, so that
+ * one stuck plugin can't hold up the others.
+ */
+static void python_interrupt_overdue_call(void)
+{
+    const uint64_t deadline = atomic_load(&python_worker.call_deadline);
+
+    if (deadline == 0 || python_time_us() < deadline) {
+        return;
+    }
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+
+    /* While we hold the GIL the worker can't finish the call, so if the deadline is still the same
+     * the call is still running. A plugin that catches the exception is interrupted again later. */
+    uint64_t expected = deadline;
+
+    if (atomic_compare_exchange_strong(&python_worker.call_deadline, &expected,
+                                       deadline + PYTHON_CALL_TIMEOUT * 1000)) {
+        PyThreadState_SetAsyncExc(python_worker.thread_ident, PyExc_TimeoutError);
+    }
+
+    PyGILState_Release(gil);
+}
+
+/*
+ * Carries out the calls plugins have made into the client, and interrupts a plugin that has been
+ * running for too long.
+ */
+static void python_task_run(void *data)
+{
+    UNUSED_VAR(data);
+
+    python_interrupt_overdue_call();
+
+    Python_Reply replies[PYTHON_REPLY_QUEUE_SIZE];
+
+    pthread_mutex_lock(&python_worker.lock);
+
+    const size_t num_replies = python_worker.num_replies;
+    memcpy(replies, python_worker.replies, num_replies * sizeof(Python_Reply));
+    python_worker.num_replies = 0;
+    pthread_cond_broadcast(&python_worker.reply_cond);
+
+    pthread_mutex_unlock(&python_worker.lock);
+
+    pthread_mutex_lock(&Winthread.lock);
+
+    for (size_t i = 0; i < num_replies; ++i) {
+        const Python_Reply *reply = &replies[i];
+
+        switch (reply->type) {
+            case PYTHON_REPLY_DISPLAY:
+                api_display(reply->text);
+                break;
+
+            case PYTHON_REPLY_SEND:
+                api_send(reply->text);
+                break;
+
+            case PYTHON_REPLY_SEND_FRIEND:
+                api_send_friend(reply->friend_number, reply->text);
+                break;
+
+            case PYTHON_REPLY_EXECUTE:
+                api_execute(reply->text, reply->mode);
+                break;
+        }
+
+        free(reply->text);
+    }
+
+    pthread_mutex_unlock(&Winthread.lock);
+}
+
+static int64_t python_task_interval(void *data)
+{
+    UNUSED_VAR(data);
+
+    const uint64_t deadline = atomic_load(&python_worker.call_deadline);
+
+    if (deadline == 0) {
+        return -1;
+    }
+
+    const uint64_t now = python_time_us();
+
+    return deadline > now ? (int64_t)((deadline - now) / 1000) + 1 : 0;
+}
+
+void python_post_event(Python_Event_Type type, Python_Event_Source source, uint32_t number, uint32_t peer,
+                       const char *text)
+{
+    pthread_mutex_lock(&python_worker.lock);
+
+    for (Python_Subscriber *subscriber = python_worker.subscribers; subscriber != NULL; subscriber = subscriber->next) {
+        if (subscriber->type != type) {
+            continue;
+        }
+
+        Python_Job job = {0};
+        job.type = PYTHON_JOB_EVENT;
+        job.plugin = subscriber->plugin;
+        job.subscriber = subscriber;
+        job.source = source;
+        job.number = number;
+        job.peer = peer;
+        job.text = strdup(text != NULL ? text : "");
+
+        if (job.text == NULL || !python_job_push(&job)) {
+            python_job_free(&job);
+            ++subscriber->plugin->dropped;
+        }
+    }
+
+    pthread_mutex_unlock(&python_worker.lock);
+}
+
+size_t python_get_plugin_stats(Python_Plugin_Stats *stats, size_t max_stats)
+{
+    size_t count = 0;
+
+    pthread_mutex_lock(&python_worker.lock);
+
+    for (const Python_Plugin *plugin = python_worker.plugins; plugin != NULL && count < max_stats;
+            plugin = plugin->next) {
+        Python_Plugin_Stats *s = &stats[count];
+        s->path = plugin->path;
+        s->calls = plugin->calls;
+        s->errors = plugin->errors;
+        s->dropped = plugin->dropped;
+        s->total_us = plugin->total_us;
+        s->max_us = plugin->max_us;
+        s->pending = plugin->pending;
+        ++count;
+    }
+
+    pthread_mutex_unlock(&python_worker.lock);
+
+    return count;
+}
+
+/*
+ * Stops the worker thread. A plugin that's still running is interrupted with a KeyboardInterrupt.
+ */
+static void python_worker_stop(void)
+{
+    pthread_mutex_lock(&python_worker.lock);
+
+    python_worker.running = false;
+    pthread_cond_broadcast(&python_worker.job_cond);
+    pthread_cond_broadcast(&python_worker.reply_cond);
+
+    const bool busy = python_worker.busy;
+
+    pthread_mutex_unlock(&python_worker.lock);
+
+    if (busy) {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        PyThreadState_SetAsyncExc(python_worker.thread_ident, PyExc_KeyboardInterrupt);
+        PyGILState_Release(gil);
+    }
+
+    pthread_join(python_worker.thread, NULL);
+}
+
 void terminate_python(void)
 {
+    scheduler_set_task(SCHED_TASK_PYTHON, "python", NULL, NULL, NULL);
+
+    python_worker_stop();
+
+    PyEval_RestoreThread(python_worker.main_thread_state);
+
     if (python_commands.name != NULL) {
         free(python_commands.name);
     }
@@ -272,11 +998,39 @@ void terminate_python(void)
     for (cur = python_commands.next; cur != NULL;) {
         struct python_registered_func *old = cur;
         cur = cur->next;
+        Py_XDECREF(old->callback);
         free(old->name);
+        free(old->help);
+        free(old);
+    }
+
+    for (Python_Subscriber *subscriber = python_worker.subscribers; subscriber != NULL;) {
+        Python_Subscriber *old = subscriber;
+        subscriber = subscriber->next;
+        Py_XDECREF(old->callback);
+        free(old);
+    }
+
+    for (size_t i = 0; i < python_worker.num_jobs; ++i) {
+        python_job_free(&python_worker.jobs[(python_worker.jobs_head + i) % PYTHON_JOB_QUEUE_SIZE]);
+    }
+
+    for (size_t i = 0; i < python_worker.num_replies; ++i) {
+        free(python_worker.replies[i].text);
+    }
+
+    for (Python_Plugin *plugin = python_worker.plugins; plugin != NULL;) {
+        Python_Plugin *old = plugin;
+        plugin = plugin->next;
+        free(old->path);
         free(old);
     }
 
     Py_Finalize();
+
+    pthread_cond_destroy(&python_worker.reply_cond);
+    pthread_cond_destroy(&python_worker.job_cond);
+    pthread_mutex_destroy(&python_worker.lock);
 }
 
 void init_python(Toxic *toxic)
@@ -284,41 +1038,90 @@ void init_python(Toxic *toxic)
     user_toxic = toxic;
     PyImport_AppendInittab("toxic_api", PyInit_toxic_api);
     Py_Initialize();
+
+    if (pthread_mutex_init(&python_worker.lock, NULL) != 0
+            || pthread_cond_init(&python_worker.job_cond, NULL) != 0
+            || pthread_cond_init(&python_worker.reply_cond, NULL) != 0) {
+        exit_toxic_err(FATALERR_MUTEX_INIT, "failed in init_python");
+    }
+
+    /* All Python code runs on the worker thread from here on */
+    python_worker.main_thread_state = PyEval_SaveThread();
+    python_worker.running = true;
+
+    if (pthread_create(&python_worker.thread, NULL, python_worker_thread, NULL) != 0) {
+        exit_toxic_err(FATALERR_THREAD_CREATE, "failed in init_python");
+    }
+
+    scheduler_set_task(SCHED_TASK_PYTHON, "python", python_task_run, python_task_interval, NULL);
 }
 
-void run_python(FILE *fp, char *path)
+int run_python(const char *path)
 {
-    PyRun_SimpleFile(fp, path);
+    pthread_mutex_lock(&python_worker.lock);
+
+    Python_Job job = {0};
+    job.type = PYTHON_JOB_RUN;
+    job.plugin = python_get_plugin(path);
+    job.text = strdup(path);
+
+    const bool queued = job.plugin != NULL && job.text != NULL && python_job_push(&job);
+
+    if (!queued) {
+        python_job_free(&job);
+
+        if (job.plugin != NULL) {
+            ++job.plugin->dropped;
+        }
+    }
+
+    pthread_mutex_unlock(&python_worker.lock);
+
+    return queued ? 0 : -1;
 }
 
 int do_python_command(int num_args, char (*args)[MAX_STR_SIZE])
 {
-    int i;
-    PyObject *callback_args, *args_strings;
     struct python_registered_func *cur;
 
+    pthread_mutex_lock(&python_worker.lock);
+
     for (cur = &python_commands; cur != NULL; cur = cur->next) {
         if (cur->name == NULL) {
             continue;
         }
 
         if (!strcmp(args[0], cur->name)) {
-            args_strings = PyList_New(0);
+            Python_Job job = {0};
+            job.type = PYTHON_JOB_COMMAND;
+            job.plugin = cur->plugin;
+            job.command = cur;
+            job.num_args = num_args;
+            job.args = malloc(num_args * sizeof(*args));
+
+            if (job.args != NULL) {
+                memcpy(job.args, args, num_args * sizeof(*args));
+            }
+
+            const bool queued = job.args != NULL && python_job_push(&job);
 
-            for (i = 1; i < num_args; i++) {
-                PyList_Append(args_strings, Py_BuildValue("s", args[i]));
+            if (!queued) {
+                python_job_free(&job);
+                ++cur->plugin->dropped;
             }
 
-            callback_args = PyTuple_Pack(1, args_strings);
+            pthread_mutex_unlock(&python_worker.lock);
 
-            if (PyObject_CallObject(cur->callback, callback_args) == NULL) {
-                api_display("Exception raised in callback function");
+            if (!queued) {
+                api_display("Plugin is busy; command dropped.");
             }
 
             return 0;
         }
     }
 
+    pthread_mutex_unlock(&python_worker.lock);
+
     return 1;
 }
 
@@ -327,12 +1130,16 @@ int python_num_registered_handlers(void)
     int n = 0;
     struct python_registered_func *cur;
 
+    pthread_mutex_lock(&python_worker.lock);
+
     for (cur = &python_commands; cur != NULL; cur = cur->next) {
         if (cur->name != NULL) {
             n++;
         }
     }
 
+    pthread_mutex_unlock(&python_worker.lock);
+
     return n;
 }
 
@@ -342,6 +1149,8 @@ int python_help_max_width(void)
     int    max = 0;
     struct python_registered_func *cur;
 
+    pthread_mutex_lock(&python_worker.lock);
+
     for (cur = &python_commands; cur != NULL; cur = cur->next) {
         if (cur->name != NULL) {
             tmp = strlen(cur->help);
@@ -349,6 +1158,8 @@ int python_help_max_width(void)
         }
     }
 
+    pthread_mutex_unlock(&python_worker.lock);
+
     max = max > 50 ? 50 : max;
     return 37 + max;
 }
@@ -357,10 +1168,14 @@ void python_draw_handler_help(WINDOW *win)
 {
     struct python_registered_func *cur;
 
+    pthread_mutex_lock(&python_worker.lock);
+
     for (cur = &python_commands; cur != NULL; cur = cur->next) {
         if (cur->name != NULL) {
             wprintw(win, "  %-29s: %.50s\n", cur->name, cur->help);
         }
     }
+
+    pthread_mutex_unlock(&python_worker.lock);
 }
 #endif /* PYTHON */
@@ -27,13 +27,75 @@
 #include <Python.h>
 #endif /* PYTHON */
 
+#include <stdint.h>
+
+#include "windows.h"
+
+/* Events that plugins can subscribe to with `toxic_api.subscribe()` */
+typedef enum Python_Event_Type {
+    PYTHON_EVENT_MESSAGE,        // a message from a friend, conference peer or group peer
+    PYTHON_EVENT_PEER_JOIN,      // a peer joined a group
+    PYTHON_EVENT_FILE_RECEIVED,  // a file transfer from a friend completed; the text is the file's path
+    PYTHON_EVENT_STATUS_CHANGE,  // a friend's status changed; the text is "online", "away" or "busy"
+    PYTHON_EVENT_MAX,
+} Python_Event_Type;
+
+typedef enum Python_Event_Source {
+    PYTHON_SOURCE_FRIEND,
+    PYTHON_SOURCE_CONFERENCE,
+    PYTHON_SOURCE_GROUP,
+} Python_Event_Source;
+
+typedef struct Python_Plugin_Stats {
+    const char *path;
+    uint64_t    calls;      // scripts, commands and event callbacks run
+    uint64_t    errors;     // calls that raised an exception
+    uint64_t    dropped;    // commands and events that didn't fit in the queue
+    uint64_t    total_us;   // time spent running the plugin's code
+    uint64_t    max_us;
+    uint32_t    pending;    // calls waiting in the queue
+} Python_Plugin_Stats;
+
 PyMODINIT_FUNC PyInit_toxic_api(void);
 void terminate_python(void);
-void init_python(Tox *tox);
-void run_python(FILE *fp, char *path);
+
+/*
+ * Starts the interpreter and the worker thread that runs all Python code from then on. Scripts,
+ * commands and events are queued for the worker, and the calls plugins make into the client are
+ * queued back and carried out by the main loop, so a slow plugin never blocks the UI or tox.
+ */
+void init_python(Toxic *toxic);
+
+/*
+ * Queues the script at `path` to be run by the worker thread.
+ *
+ * Return 0 on success.
+ * Return -1 if the queue is full.
+ */
+int run_python(const char *path);
+
 int do_python_command(int num_args, char (*args)[MAX_STR_SIZE]);
 int python_num_registered_handlers(void);
 int python_help_max_width(void);
 void python_draw_handler_help(WINDOW *win);
 
+/*
+ * Queues an event for every plugin subscribed to `type`. `number` is the friend, conference or group
+ * number, and `peer` is the peer number or file number where that applies.
+ *
+ * Never blocks: the event is dropped for a plugin that already has too many calls waiting.
+ */
+void python_post_event(Python_Event_Type type, Python_Event_Source source, uint32_t number, uint32_t peer,
+                       const char *text);
+
+/* Returns the name Python uses for `status`. */
+const char *python_user_status_name(Tox_User_Status status);
+
+/*
+ * Copies the statistics for up to `max_stats` plugins to `stats`.
+ *
+ * Returns the number of plugins copied.
+ */
+size_t python_get_plugin_stats(Python_Plugin_Stats *stats, size_t max_stats);
+
 #endif /* PYTHON_API_H */
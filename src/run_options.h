@@ -40,6 +40,10 @@ typedef struct Run_Options {
     bool no_connect;
     bool encrypt_data;
     bool unencrypt_data;
+    bool startup_profile;
+
+    bool headless;
+    char headless_socket[MAX_STR_SIZE];
 
     char nameserver_path[MAX_STR_SIZE];
     char config_path[MAX_STR_SIZE];
@@ -0,0 +1,384 @@
+/*  scheduler.c
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "scheduler.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
+/* Deadline value for tasks that only run when triggered */
+#define SCHED_NO_DEADLINE UINT64_MAX
+
+/* Upper bound in microseconds of each latency histogram bucket. The last bucket catches everything else. */
+static const uint64_t hist_bounds_us[SCHED_HIST_BUCKETS - 1] = {
+    100, 500, 1000, 2000, 5000, 10000, 50000, 100000, 1000000,
+};
+
+static const char *const hist_bucket_names[SCHED_HIST_BUCKETS] = {
+    "<0.1ms", "<0.5ms", "<1ms", "<2ms", "<5ms", "<10ms", "<50ms", "<100ms", "<1s", ">=1s",
+};
+
+struct Sched_Task_Entry {
+    sched_run_cb      *run_cb;
+    sched_interval_cb *interval_cb;
+    void              *data;
+    uint64_t           deadline;   /* monotonic time in microseconds */
+    Sched_Stats        stats;
+};
+
+static struct Scheduler {
+    struct Sched_Task_Entry tasks[SCHED_TASK_MAX];
+    pthread_mutex_t lock;   /* guards deadlines and stats */
+    int wake_fds[2];        /* self-pipe used to interrupt the main loop's sleep */
+    int timer_fd;           /* -1 if timerfd is unavailable */
+    bool initialized;
+} Sched;
+
+static uint64_t sched_time_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t) t.tv_sec) * 1000000 + ((uint64_t) t.tv_nsec) / 1000;
+}
+
+static int hist_bucket_index(uint64_t late_us)
+{
+    for (int i = 0; i < SCHED_HIST_BUCKETS - 1; ++i) {
+        if (late_us < hist_bounds_us[i]) {
+            return i;
+        }
+    }
+
+    return SCHED_HIST_BUCKETS - 1;
+}
+
+static int set_nonblocking(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags == -1) {
+        return -1;
+    }
+
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+int scheduler_init(void)
+{
+    if (Sched.initialized) {
+        return 0;
+    }
+
+    if (pthread_mutex_init(&Sched.lock, NULL) != 0) {
+        return -1;
+    }
+
+    if (pipe(Sched.wake_fds) != 0) {
+        pthread_mutex_destroy(&Sched.lock);
+        return -1;
+    }
+
+    if (set_nonblocking(Sched.wake_fds[0]) == -1 || set_nonblocking(Sched.wake_fds[1]) == -1) {
+        close(Sched.wake_fds[0]);
+        close(Sched.wake_fds[1]);
+        pthread_mutex_destroy(&Sched.lock);
+        return -1;
+    }
+
+    Sched.timer_fd = -1;
+
+#ifdef __linux__
+    Sched.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (Sched.timer_fd == -1) {
+        fprintf(stderr, "timerfd_create() failed (errno %d). Falling back to poll timeouts\n", errno);
+    }
+
+#endif /* __linux__ */
+
+    for (size_t i = 0; i < SCHED_TASK_MAX; ++i) {
+        Sched.tasks[i].deadline = SCHED_NO_DEADLINE;
+    }
+
+    Sched.initialized = true;
+
+    return 0;
+}
+
+/* Returns the next deadline for `entry` relative to `now`.
+ *
+ * Must be called with the scheduler lock held.
+ */
+static uint64_t sched_next_deadline(const struct Sched_Task_Entry *entry, uint64_t now)
+{
+    if (entry->interval_cb == NULL) {
+        return SCHED_NO_DEADLINE;
+    }
+
+    const int64_t interval_ms = entry->interval_cb(entry->data);
+
+    if (interval_ms < 0) {
+        return SCHED_NO_DEADLINE;
+    }
+
+    return now + ((uint64_t) interval_ms) * 1000;
+}
+
+void scheduler_set_task(Sched_Task task, const char *name, sched_run_cb *run_cb, sched_interval_cb *interval_cb,
+                        void *data)
+{
+    if (task >= SCHED_TASK_MAX) {
+        return;
+    }
+
+    pthread_mutex_lock(&Sched.lock);
+
+    struct Sched_Task_Entry *entry = &Sched.tasks[task];
+
+    memset(entry, 0, sizeof(struct Sched_Task_Entry));
+
+    entry->run_cb = run_cb;
+    entry->interval_cb = interval_cb;
+    entry->data = data;
+    entry->stats.name = name;
+    entry->stats.enabled = run_cb != NULL;
+    entry->deadline = run_cb != NULL ? sched_next_deadline(entry, sched_time_us()) : SCHED_NO_DEADLINE;
+
+    pthread_mutex_unlock(&Sched.lock);
+}
+
+static void sched_wake(void)
+{
+    const char c = 0;
+
+    /* If the pipe is full the main loop already has a pending wakeup */
+    if (write(Sched.wake_fds[1], &c, 1) == -1 && errno != EAGAIN) {
+        fprintf(stderr, "scheduler wakeup failed (errno %d)\n", errno);
+    }
+}
+
+void scheduler_trigger(Sched_Task task)
+{
+    if (task >= SCHED_TASK_MAX || !Sched.initialized) {
+        return;
+    }
+
+    pthread_mutex_lock(&Sched.lock);
+
+    struct Sched_Task_Entry *entry = &Sched.tasks[task];
+
+    if (entry->run_cb == NULL) {
+        pthread_mutex_unlock(&Sched.lock);
+        return;
+    }
+
+    entry->deadline = sched_time_us();
+    ++entry->stats.triggers;
+
+    pthread_mutex_unlock(&Sched.lock);
+
+    sched_wake();
+}
+
+void scheduler_reschedule(Sched_Task task)
+{
+    if (task >= SCHED_TASK_MAX || !Sched.initialized) {
+        return;
+    }
+
+    pthread_mutex_lock(&Sched.lock);
+
+    struct Sched_Task_Entry *entry = &Sched.tasks[task];
+
+    if (entry->run_cb == NULL) {
+        pthread_mutex_unlock(&Sched.lock);
+        return;
+    }
+
+    const uint64_t next = sched_next_deadline(entry, sched_time_us());
+    const bool earlier = next < entry->deadline;
+
+    if (earlier) {
+        entry->deadline = next;
+    }
+
+    pthread_mutex_unlock(&Sched.lock);
+
+    if (earlier) {
+        sched_wake();
+    }
+}
+
+static void sched_drain_fd(int fd)
+{
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+/* Sleeps until monotonic time `deadline` or until the wakeup pipe becomes readable. */
+static void sched_sleep_until(uint64_t deadline)
+{
+    struct pollfd fds[2];
+    nfds_t num_fds = 1;
+    int timeout_ms = -1;
+
+    fds[0].fd = Sched.wake_fds[0];
+    fds[0].events = POLLIN;
+
+    const uint64_t now = sched_time_us();
+
+    if (deadline != SCHED_NO_DEADLINE && deadline <= now) {
+        return;
+    }
+
+#ifdef __linux__
+
+    if (Sched.timer_fd != -1 && deadline != SCHED_NO_DEADLINE) {
+        struct itimerspec its = {{0}};
+        its.it_value.tv_sec = deadline / 1000000;
+        its.it_value.tv_nsec = (deadline % 1000000) * 1000;
+
+        if (timerfd_settime(Sched.timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == 0) {
+            fds[1].fd = Sched.timer_fd;
+            fds[1].events = POLLIN;
+            num_fds = 2;
+        }
+    }
+
+#endif /* __linux__ */
+
+    if (num_fds == 1 && deadline != SCHED_NO_DEADLINE) {
+        /* round up so we never wake before the deadline */
+        const uint64_t wait_ms = (deadline - now + 999) / 1000;
+        timeout_ms = wait_ms > INT_MAX ? INT_MAX : (int) wait_ms;
+    }
+
+    if (poll(fds, num_fds, timeout_ms) > 0) {
+        if (fds[0].revents & POLLIN) {
+            sched_drain_fd(Sched.wake_fds[0]);
+        }
+
+        if (num_fds == 2 && (fds[1].revents & POLLIN)) {
+            sched_drain_fd(Sched.timer_fd);
+        }
+    }
+}
+
+void scheduler_iterate(void)
+{
+    for (size_t i = 0; i < SCHED_TASK_MAX; ++i) {
+        struct Sched_Task_Entry *entry = &Sched.tasks[i];
+
+        pthread_mutex_lock(&Sched.lock);
+
+        const uint64_t deadline = entry->deadline;
+        const uint64_t start = sched_time_us();
+
+        if (entry->run_cb == NULL || deadline == SCHED_NO_DEADLINE || deadline > start) {
+            pthread_mutex_unlock(&Sched.lock);
+            continue;
+        }
+
+        /* Clear the deadline before running so that triggers that arrive while the task
+         * is running aren't lost. */
+        entry->deadline = SCHED_NO_DEADLINE;
+
+        pthread_mutex_unlock(&Sched.lock);
+
+        entry->run_cb(entry->data);
+
+        const uint64_t end = sched_time_us();
+        const uint64_t late = start - deadline;
+        const uint64_t run_time = end - start;
+
+        pthread_mutex_lock(&Sched.lock);
+
+        Sched_Stats *stats = &entry->stats;
+        ++stats->runs;
+        ++stats->hist[hist_bucket_index(late)];
+        stats->total_run_us += run_time;
+
+        if (late > stats->max_late_us) {
+            stats->max_late_us = late;
+        }
+
+        if (run_time > stats->max_run_us) {
+            stats->max_run_us = run_time;
+        }
+
+        const uint64_t next = sched_next_deadline(entry, end);
+
+        if (next < entry->deadline) {
+            entry->deadline = next;
+        }
+
+        pthread_mutex_unlock(&Sched.lock);
+    }
+
+    uint64_t earliest = SCHED_NO_DEADLINE;
+
+    pthread_mutex_lock(&Sched.lock);
+
+    for (size_t i = 0; i < SCHED_TASK_MAX; ++i) {
+        if (Sched.tasks[i].deadline < earliest) {
+            earliest = Sched.tasks[i].deadline;
+        }
+    }
+
+    pthread_mutex_unlock(&Sched.lock);
+
+    sched_sleep_until(earliest);
+}
+
+void scheduler_get_stats(Sched_Task task, Sched_Stats *stats)
+{
+    if (task >= SCHED_TASK_MAX) {
+        memset(stats, 0, sizeof(Sched_Stats));
+        return;
+    }
+
+    pthread_mutex_lock(&Sched.lock);
+    *stats = Sched.tasks[task].stats;
+    pthread_mutex_unlock(&Sched.lock);
+}
+
+const char *scheduler_hist_bucket_name(int index)
+{
+    if (index < 0 || index >= SCHED_HIST_BUCKETS) {
+        return "";
+    }
+
+    return hist_bucket_names[index];
+}
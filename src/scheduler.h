@@ -0,0 +1,121 @@
+/*  scheduler.h
+ *
+ *
+ *  Copyright (C) 2024 Toxic All Rights Reserved.
+ *
+ *  This file is part of Toxic.
+ *
+ *  Toxic is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Toxic is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Toxic.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of buckets in each task's wakeup latency histogram. */
+#define SCHED_HIST_BUCKETS 10
+
+/*
+ * Periodic jobs that are driven by the main loop. Each task has a deadline, and the main
+ * loop sleeps until the earliest deadline of all tasks or until it's woken up early by
+ * `scheduler_trigger()`.
+ */
+typedef enum Sched_Task {
+    SCHED_TASK_TOX,
+    SCHED_TASK_TOXAV,
+    SCHED_TASK_AUTOSAVE,
+    SCHED_TASK_NODESLIST,
+    SCHED_TASK_CQUEUE,
+    SCHED_TASK_MPLEX,
+    SCHED_TASK_NOTIFY,
+    SCHED_TASK_PYTHON,
+    SCHED_TASK_NAME_LOOKUP,
+    SCHED_TASK_MAX,
+} Sched_Task;
+
+/* Runs the task. Called from the main loop without any locks held. */
+typedef void sched_run_cb(void *data);
+
+/*
+ * Returns the number of milliseconds until the task should run again.
+ * Returns a negative value if the task should only run when triggered.
+ *
+ * Called with the scheduler lock held, so it must not block or acquire other locks.
+ */
+typedef int64_t sched_interval_cb(void *data);
+
+typedef struct Sched_Stats {
+    const char *name;
+    bool     enabled;
+    uint64_t runs;
+    uint64_t triggers;
+    uint64_t max_late_us;       /* longest time between a deadline and the task actually running */
+    uint64_t total_run_us;      /* total time spent inside the task's run callback */
+    uint64_t max_run_us;
+    uint64_t hist[SCHED_HIST_BUCKETS];
+} Sched_Stats;
+
+/*
+ * Initializes the scheduler. Must be called before any other scheduler function.
+ *
+ * Return 0 on success.
+ * Return -1 on failure.
+ */
+int scheduler_init(void);
+
+/*
+ * Registers a task. The task's first deadline is set `interval_cb()` milliseconds
+ * from now. `name` must point to a string with static storage duration.
+ */
+void scheduler_set_task(Sched_Task task, const char *name, sched_run_cb *run_cb, sched_interval_cb *interval_cb,
+                        void *data);
+
+/*
+ * Moves the deadline of `task` to now and wakes the main loop.
+ *
+ * This function is thread safe.
+ */
+void scheduler_trigger(Sched_Task task);
+
+/*
+ * Asks `task` for its interval again and moves its deadline earlier if the new one is
+ * sooner, waking the main loop. Used when the task learns about new work that's due at
+ * a later time rather than right away.
+ *
+ * This function is thread safe.
+ */
+void scheduler_reschedule(Sched_Task task);
+
+/*
+ * Runs every task whose deadline has passed, then sleeps until the next deadline or until
+ * another thread calls `scheduler_trigger()`.
+ */
+void scheduler_iterate(void);
+
+/*
+ * Copies the statistics for `task` to `stats`.
+ *
+ * This function is thread safe.
+ */
+void scheduler_get_stats(Sched_Task task, Sched_Stats *stats);
+
+/*
+ * Returns a string describing the upper bound of histogram bucket `index`.
+ */
+const char *scheduler_hist_bucket_name(int index);
+
+#endif /* SCHEDULER_H */
@@ -25,15 +25,24 @@
 #include <stdlib.h> /* malloc, realloc, free, getenv */
 #include <string.h> /* strlen, strcpy, strstr, strchr, strrchr, strcat, strncmp */
 
+#include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif /* __linux__ */
+
 #include <tox/tox.h>
 
 #include "execute.h"
+#include "misc_tools.h"
+#include "scheduler.h"
 #include "settings.h"
 #include "term_mplex.h"
 #include "toxic.h"
@@ -61,6 +70,22 @@ typedef enum {
    - storing tmux session number in string form */
 static char mplex_data [BUFFER_SIZE];
 
+/* path of the tmux server socket */
+static char tmux_socket [BUFFER_SIZE];
+
+/* True while changes to the mplex socket are being watched for by mplex_watch_thread() */
+static atomic_bool mplex_watching = false;
+
+#ifdef __linux__
+static int mplex_inotify_fd = -1;
+
+/* Written to by terminate_mplex_away_timer() to make mplex_watch_thread() return */
+static int mplex_wake_fds[2] = {-1, -1};
+
+static pthread_t mplex_watch_tid;
+static bool mplex_watch_started = false;
+#endif /* __linux__ */
+
 static char buffer [BUFFER_SIZE];
 
 /* Differentiates between mplex auto-away and manual-away */
@@ -76,7 +101,6 @@ static char prev_note [TOX_MAX_STATUS_MESSAGE_LENGTH] = "";
    after init, should be accessed only by cmd_status()
  */
 static pthread_mutex_t status_lock;
-static pthread_t mplex_tid;
 
 void lock_status(void)
 {
@@ -242,6 +266,17 @@ static int detect_tmux(void)
         return 0;
     }
 
+    /* the socket path comes before the first separator */
+    const char *sep = strchr(tmux_env, ',');
+    const size_t socket_len = sep - tmux_env;
+
+    if (socket_len >= sizeof(tmux_socket)) {
+        return 0;
+    }
+
+    memcpy(tmux_socket, tmux_env, socket_len);
+    tmux_socket[socket_len] = '\0';
+
     /* store the session id for later use */
     snprintf(mplex_data, sizeof(mplex_data), "$%s", pos + 1);
     mplex = MPLEX_TMUX;
@@ -283,6 +318,11 @@ static int gnu_screen_is_detached(void)
 
 /* Detects tmux attached/detached by getting session data and finding the
    current session's entry.
+
+   The tmux server sets the execute bits of its socket while any of its sessions
+   has a client attached, so tmux only needs to be asked when the socket says
+   that some session is attached. While the socket is watched this is only
+   called when its permissions change.
  */
 static int tmux_is_detached(void)
 {
@@ -290,6 +330,12 @@ static int tmux_is_detached(void)
         return 0;
     }
 
+    struct stat sb;
+
+    if (stat(tmux_socket, &sb) == 0 && !(sb.st_mode & S_IXUSR)) {
+        return 1;
+    }
+
     FILE *session_info_stream = NULL;
     char *dyn_buffer = NULL, *search_str = NULL;
     char *entry_pos;
@@ -427,17 +473,141 @@ static void mplex_timer_handler(Toxic *toxic)
     pthread_mutex_unlock(&Winthread.lock);
 }
 
-/* Time in seconds between calls to mplex_timer_handler */
+/* Time in seconds between calls to mplex_timer_handler when the mplex socket can't be watched,
+   e.g. without inotify */
 #define MPLEX_TIMER_INTERVAL 5
 
-_Noreturn static void *mplex_timer_thread(void *data)
+static void mplex_task_run(void *data)
+{
+    mplex_timer_handler((Toxic *) data);
+}
+
+static int64_t mplex_task_interval(void *data)
+{
+    UNUSED_VAR(data);
+
+    if (mplex_watching) {
+        return -1;
+    }
+
+    return MPLEX_TIMER_INTERVAL * 1000;
+}
+
+#ifdef __linux__
+/* Blocks on inotify events for the mplex socket and runs the mplex task whenever its
+ * permissions change, which both screen and tmux do on attach and detach. Returns when
+ * terminate_mplex_away_timer() writes to the wake pipe.
+ */
+static void *mplex_watch_thread(void *data)
 {
-    Toxic *toxic = (Toxic *) data;
+    UNUSED_VAR(data);
+
+    union {
+        struct inotify_event event;
+        char bytes[4096];
+    } events;
+
+    struct pollfd fds[2] = {
+        {.fd = mplex_inotify_fd, .events = POLLIN},
+        {.fd = mplex_wake_fds[0], .events = POLLIN},
+    };
+
+    while (mplex_watching) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            break;
+        }
+
+        if (fds[1].revents != 0) {
+            return NULL;
+        }
+
+        const ssize_t len = read(mplex_inotify_fd, &events, sizeof(events));
 
-    while (true) {
-        sleep(MPLEX_TIMER_INTERVAL);
-        mplex_timer_handler(toxic);
+        if (len <= 0) {
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+
+            break;
+        }
+
+        for (ssize_t i = 0; i < len;) {
+            const struct inotify_event *event = (const struct inotify_event *)(events.bytes + i);
+
+            /* The socket was removed, e.g. because the server was restarted */
+            if (event->mask & IN_IGNORED) {
+                mplex_watching = false;
+            }
+
+            i += sizeof(struct inotify_event) + event->len;
+        }
+
+        scheduler_trigger(SCHED_TASK_MPLEX);
     }
+
+    /* fall back to polling */
+    mplex_watching = false;
+    scheduler_trigger(SCHED_TASK_MPLEX);
+
+    return NULL;
+}
+
+static void mplex_close_watch_fds(void)
+{
+    if (mplex_inotify_fd != -1) {
+        close(mplex_inotify_fd);
+        mplex_inotify_fd = -1;
+    }
+
+    for (size_t i = 0; i < 2; ++i) {
+        if (mplex_wake_fds[i] != -1) {
+            close(mplex_wake_fds[i]);
+            mplex_wake_fds[i] = -1;
+        }
+    }
+}
+#endif /* __linux__ */
+
+/* Starts watching the mplex socket for attach and detach events.
+ *
+ * Return 0 on success.
+ * Return -1 if the socket can't be watched, in which case the mplex task polls instead.
+ */
+static int mplex_watch_socket(void)
+{
+#ifdef __linux__
+    const char *path = mplex == MPLEX_TMUX ? tmux_socket : mplex_data;
+
+    mplex_inotify_fd = inotify_init1(IN_CLOEXEC);
+
+    if (mplex_inotify_fd == -1) {
+        return -1;
+    }
+
+    if (inotify_add_watch(mplex_inotify_fd, path, IN_ATTRIB | IN_DELETE_SELF) == -1
+            || pipe(mplex_wake_fds) != 0) {
+        mplex_close_watch_fds();
+        return -1;
+    }
+
+    mplex_watching = true;
+
+    if (pthread_create(&mplex_watch_tid, NULL, mplex_watch_thread, NULL) != 0) {
+        mplex_watching = false;
+        mplex_close_watch_fds();
+        return -1;
+    }
+
+    mplex_watch_started = true;
+
+    return 0;
+#else
+    return -1;
+#endif /* __linux__ */
 }
 
 int init_mplex_away_timer(Toxic *toxic)
@@ -455,9 +625,37 @@ int init_mplex_away_timer(Toxic *toxic)
         return -1;
     }
 
-    if (pthread_create(&mplex_tid, NULL, mplex_timer_thread, (void *)toxic) != 0) {
-        return -1;
-    }
+    /* falls back to polling, e.g. on systems without inotify */
+    mplex_watch_socket();
+
+    scheduler_set_task(SCHED_TASK_MPLEX, "mplex", mplex_task_run, mplex_task_interval, toxic);
+
+    /* find out the current state right away */
+    scheduler_trigger(SCHED_TASK_MPLEX);
 
     return 0;
 }
+
+void terminate_mplex_away_timer(void)
+{
+#ifdef __linux__
+
+    if (!mplex_watch_started) {
+        return;
+    }
+
+    scheduler_set_task(SCHED_TASK_MPLEX, "mplex", NULL, NULL, NULL);
+
+    const char byte = 0;
+
+    if (write(mplex_wake_fds[1], &byte, 1) != 1) {
+        fprintf(stderr, "Failed to wake the mplex watch thread\n");
+    }
+
+    pthread_join(mplex_watch_tid, NULL);
+    mplex_watch_started = false;
+    mplex_watching = false;
+
+    mplex_close_watch_fds();
+#endif /* __linux__ */
+}
@@ -24,11 +24,15 @@
 #define TERM_MPLEX_H
 
 /* Checks if Toxic runs inside a terminal multiplexer (GNU screen or tmux). If
- * yes, it initializes a timer which periodically checks the attached/detached
- * state of the terminal and updates away status accordingly.
+ * yes, it registers a scheduler task which checks the attached/detached state of
+ * the terminal whenever the multiplexer's socket changes and updates away status
+ * accordingly.
  */
 int init_mplex_away_timer(Toxic *toxic);
 
+/* Stops watching the multiplexer's socket. */
+void terminate_mplex_away_timer(void);
+
 void lock_status(void);
 void unlock_status(void);
 
@@ -48,6 +48,7 @@
 #include <tox/tox.h>
 
 #include "audio_device.h"
+#include "autosave.h"
 #include "bootstrap.h"
 #include "conference.h"
 #include "configdir.h"
@@ -55,6 +56,7 @@
 #include "file_transfers.h"
 #include "friendlist.h"
 #include "groupchats.h"
+#include "headless.h"
 #include "line_info.h"
 #include "log.h"
 #include "message_queue.h"
@@ -86,6 +88,9 @@
 
 struct Winthread Winthread;
 
+/* True if stderr was sent to /dev/null by disable_stderr() */
+static bool stderr_disabled;
+
 static void queue_init_message(const char *msg, ...);
 
 static void kill_toxic(Toxic *toxic)
@@ -114,34 +119,49 @@ void exit_toxic_success(Toxic *toxic)
 
     cleanup_init_messages();
 
-    store_data(toxic);
+    Run_Options *run_opts = toxic->run_opts;
 
-    terminate_notify();
+    /* Headless mode never sets up the UI, notifications, A/V or Python, so there's nothing to tear down */
+    const bool headless = run_opts->headless;
+
+    store_data(toxic);
+    save_DHT_node_health();
+    autosave_shutdown();
+    headless_terminate();
+    name_lookup_terminate();
+    terminate_mplex_away_timer();
+
+    if (!headless) {
+        terminate_notify();
+    }
 
     kill_all_file_transfers(toxic);
-    kill_all_windows(toxic);
+
+    if (!headless) {
+        kill_all_windows(toxic);
 
 #ifdef AUDIO
 #ifdef VIDEO
-    terminate_video();
+        terminate_video();
 #endif /* VIDEO */
-    terminate_audio(toxic->av);
+        terminate_audio(toxic->av);
 #endif /* AUDIO */
 
 #ifdef PYTHON
-    terminate_python();
+        terminate_python();
 #endif /* PYTHON */
+    }
 
     tox_kill(toxic->tox);
 
-    Run_Options *run_opts = toxic->run_opts;
-
     if (run_opts->log_fp != NULL) {
         fclose(run_opts->log_fp);
         run_opts->log_fp = NULL;
     }
 
-    endwin();
+    if (!headless) {
+        endwin();
+    }
     curl_global_cleanup();
 
 #ifdef X11
@@ -153,11 +173,30 @@ void exit_toxic_success(Toxic *toxic)
     exit(EXIT_SUCCESS);
 }
 
+void disable_stderr(void)
+{
+    if (!freopen("/dev/null", "w", stderr)) {
+        fprintf(stderr, "Warning: failed to disable stderr\n");
+        return;
+    }
+
+    stderr_disabled = true;
+}
+
+bool reenable_stderr(void)
+{
+    if (!stderr_disabled) {
+        return true;
+    }
+
+    return freopen("/dev/tty", "w", stderr) != NULL;
+}
+
 void exit_toxic_err(int errcode, const char *errmsg, ...)
 {
     endwin();
 
-    if (freopen("/dev/tty", "w", stderr)) {
+    if (reenable_stderr()) {
         va_list args;
         va_start(args, errmsg);
         vfprintf(stderr, errmsg, args);
@@ -441,101 +480,23 @@ static void cleanup_init_messages(void)
  * Return 0 if stored successfully.
  * Return -1 on error.
  */
-#define TEMP_PROFILE_EXT ".tmp"
 int store_data(const Toxic *toxic)
 {
-    const Run_Options *run_opts = toxic->run_opts;
-
-    const char *path = toxic->client_data.data_path;
-
-    if (path == NULL) {
-        return -1;
-    }
-
-    const size_t temp_buf_size = strlen(path) + strlen(TEMP_PROFILE_EXT) + 1;
-    char *temp_path = malloc(temp_buf_size);
-
-    if (temp_path == NULL) {
-        return -1;
-    }
-
-    snprintf(temp_path, temp_buf_size, "%s%s", path, TEMP_PROFILE_EXT);
-
-    FILE *fp = fopen(temp_path, "wb");
-
-    if (fp == NULL) {
-        free(temp_path);
+    if (toxic->client_data.data_path == NULL) {
         return -1;
     }
 
+    /* Only the snapshot is taken here; encryption and disk I/O happen on the autosave thread */
     const size_t data_len = tox_get_savedata_size(toxic->tox);
-    char *data = malloc(data_len * sizeof(char));
+    uint8_t *data = malloc(data_len);
 
     if (data == NULL) {
-        free(temp_path);
-        fclose(fp);
-        return -1;
-    }
-
-    tox_get_savedata(toxic->tox, (uint8_t *) data);
-
-    const Client_Data *client_data = &toxic->client_data;
-
-    if (client_data->is_encrypted && !run_opts->unencrypt_data) {
-        size_t enc_len = data_len + TOX_PASS_ENCRYPTION_EXTRA_LENGTH;
-        char *enc_data = malloc(enc_len * sizeof(char));
-
-        if (enc_data == NULL) {
-            fclose(fp);
-            free(temp_path);
-            free(data);
-            return -1;
-        }
-
-        Tox_Err_Encryption err;
-        tox_pass_encrypt((uint8_t *) data, data_len, (const uint8_t *) toxic->client_data.pass,
-                         toxic->client_data.pass_len, (uint8_t *) enc_data, &err);
-
-        if (err != TOX_ERR_ENCRYPTION_OK) {
-            fprintf(stderr, "tox_pass_encrypt() failed with error %d\n", err);
-            fclose(fp);
-            free(temp_path);
-            free(data);
-            free(enc_data);
-            return -1;
-        }
-
-        if (fwrite(enc_data, enc_len, 1, fp) != 1) {
-            fprintf(stderr, "Failed to write profile data.\n");
-            fclose(fp);
-            free(temp_path);
-            free(data);
-            free(enc_data);
-            return -1;
-        }
-
-        free(enc_data);
-    } else {  /* data will not be encrypted */
-        if (fwrite(data, data_len, 1, fp) != 1) {
-            fprintf(stderr, "Failed to write profile data.\n");
-            fclose(fp);
-            free(temp_path);
-            free(data);
-            return -1;
-        }
-    }
-
-    fclose(fp);
-    free(data);
-
-    if (rename(temp_path, path) != 0) {
-        free(temp_path);
         return -1;
     }
 
-    free(temp_path);
+    tox_get_savedata(toxic->tox, data);
 
-    return 0;
+    return autosave_submit(toxic, data, data_len);
 }
 
 /* Set interface refresh flag. This should be called whenever the interface changes.
@@ -100,6 +100,15 @@ void flag_interface_refresh(void);
 /* Sets ncurses refresh rate. Lower values make it refresh more often. */
 void set_window_refresh_rate(size_t refresh_rate);
 
+/* Sends stderr to /dev/null. Fatal errors are then printed to the terminal instead. */
+void disable_stderr(void);
+
+/* Points stderr back at the terminal if it was disabled.
+ *
+ * Return true if stderr can be written to.
+ */
+bool reenable_stderr(void);
+
 void exit_toxic_success(Toxic *toxic) __attribute__((__noreturn__));
 void exit_toxic_err(int errcode, const char *errmsg, ...) __attribute__((__noreturn__, format(printf, 2, 3)));
 
@@ -0,0 +1,739 @@
+/*
+ * Micro-benchmarks for the data paths that run on every message, peer change and frame. Windows
+ * are drawn into an ncurses screen attached to /dev/null, and the group and conference
+ * benchmarks use an offline Tox instance, so no network is needed.
+ *
+ * Results are printed as JSON by default so that they can be compared between runs, e.g. with
+ * Google Benchmark's compare.py.
+ *
+ * Usage: toxic_bench [--benchmark_filter=<regex>] [--benchmark_format=json|console]
+ */
+
+extern "C" {
+#include "conference.h"
+#include "friendlist.h"
+#include "groupchats.h"
+#include "log.h"
+#include "run_options.h"
+#include "settings.h"
+#include "toxic.h"
+#include "windows.h"
+
+#ifdef AUDIO
+#include "audio_device.h"
+#endif
+
+#ifdef VIDEO
+#include "video_device.h"
+#endif
+}
+#include "command_parser.h"
+#include "line_info.h"
+
+#include <benchmark/benchmark.h>
+
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kRows = 60;
+constexpr int kCols = 160;
+
+/* The screen, default settings and offline Tox instance shared by all benchmarks */
+struct Env {
+    bool ok = false;
+    Client_Config config{};
+    Run_Options run_opts{};
+    Windows windows{};
+    Toxic toxic{};
+};
+
+Env *env()
+{
+    static Env *e = nullptr;
+
+    if (e != nullptr) {
+        return e;
+    }
+
+    e = new Env();
+
+    if (std::getenv("TERM") == nullptr) {
+        setenv("TERM", "xterm", 0);
+    }
+
+    FILE *null_out = std::fopen("/dev/null", "w");
+    FILE *null_in = std::fopen("/dev/null", "r");
+
+    if (null_out == nullptr || null_in == nullptr || newterm(nullptr, null_out, null_in) == nullptr) {
+        return e;
+    }
+
+    resize_term(kRows, kCols);
+
+    /* There is no config file, so this only loads the defaults */
+    settings_load_main(&e->config, &e->run_opts);
+
+    e->toxic.c_config = &e->config;
+    e->toxic.run_opts = &e->run_opts;
+    e->toxic.windows = &e->windows;
+    e->ok = true;
+
+    return e;
+}
+
+Tox *offline_tox()
+{
+    static Tox *tox = nullptr;
+
+    if (tox != nullptr) {
+        return tox;
+    }
+
+    Tox_Options *options = tox_options_new(nullptr);
+
+    if (options == nullptr) {
+        return nullptr;
+    }
+
+    tox_options_set_udp_enabled(options, false);
+    tox_options_set_local_discovery_enabled(options, false);
+    tox_options_set_ipv6_enabled(options, false);
+
+    tox = tox_new(options, nullptr);
+    tox_options_free(options);
+
+    env()->toxic.tox = tox;
+
+    return tox;
+}
+
+/* A chat window that isn't registered anywhere, with just what line_info needs */
+class HistoryWindow {
+public:
+    HistoryWindow(int cols = kCols)
+    {
+        self_.type = WINDOW_TYPE_CHAT;
+        self_.window = newwin(kRows, cols, 0, 0);
+        self_.chatwin = &ctx_;
+        self_.stb = &stb_;
+
+        stb_.connection = TOX_CONNECTION_UDP;
+
+        /* Freed by line_info_cleanup() */
+        ctx_.hst = static_cast<struct history *>(std::calloc(1, sizeof(struct history)));
+        ctx_.history = subwin(self_.window, kRows - CHATBOX_HEIGHT - WINDOW_BAR_HEIGHT, cols, 0, 0);
+        line_info_init(ctx_.hst);
+    }
+
+    ~HistoryWindow()
+    {
+        line_info_cleanup(ctx_.hst);
+        delwin(ctx_.history);
+        delwin(self_.window);
+    }
+
+    ToxWindow *self()
+    {
+        return &self_;
+    }
+
+    /* Clears the history the way the /clear command does */
+    void clear()
+    {
+        line_info_clear(ctx_.hst);
+    }
+
+    void fill(const Client_Config *c_config, int lines, const std::string &msg = "a line of scrollback")
+    {
+        for (int i = 0; i < lines; ++i) {
+            line_info_add(&self_, c_config, true, "Alice", nullptr, IN_MSG, 0, 0, "%s %d", msg.c_str(), i);
+
+            if ((i + 1) % (MAX_LINE_INFO_QUEUE / 2) == 0) {
+                line_info_check_queue(&self_, c_config);
+            }
+        }
+
+        line_info_check_queue(&self_, c_config);
+    }
+
+private:
+    ToxWindow self_{};
+    ChatContext ctx_{};
+    StatusBar stb_{};
+};
+
+/* Words with a typical length, so that wrapping has something to do */
+std::string make_message(size_t length, std::mt19937 *rng)
+{
+    static const char *const words[] = {
+        "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "toxic", "message", "history", "benchmark",
+    };
+
+    std::string msg;
+
+    while (msg.size() < length) {
+        if (!msg.empty()) {
+            msg += ' ';
+        }
+
+        msg += words[(*rng)() % (sizeof(words) / sizeof(words[0]))];
+    }
+
+    msg.resize(length);
+    return msg;
+}
+
+void BM_LineInfoAdd(benchmark::State &state)
+{
+    Env *e = env();
+
+    if (!e->ok) {
+        state.SkipWithError("failed to create a screen");
+        return;
+    }
+
+    Client_Config config = e->config;
+    config.history_size = static_cast<int>(state.range(0));
+
+    HistoryWindow win;
+    win.fill(&config, config.history_size);
+
+    ToxWindow *self = win.self();
+    int i = 0;
+
+    /* The UI thread drains the queue on every redraw; a few lines per redraw is typical */
+    for (auto _ : state) {
+        line_info_add(self, &config, true, "Alice", nullptr, IN_MSG, 0, 0, "message number %d", i);
+
+        if (++i % 8 == 0) {
+            line_info_check_queue(self, &config);
+        }
+    }
+
+    line_info_check_queue(self, &config);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LineInfoAdd)->Arg(100)->Arg(1000)->Arg(10000)->Arg(100000);
+
+void BM_LineInfoPrint(benchmark::State &state)
+{
+    Env *e = env();
+
+    if (!e->ok) {
+        state.SkipWithError("failed to create a screen");
+        return;
+    }
+
+    Client_Config config = e->config;
+    config.history_size = static_cast<int>(state.range(0));
+
+    HistoryWindow win;
+    win.fill(&config, config.history_size);
+
+    for (auto _ : state) {
+        line_info_print(win.self(), &config);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LineInfoPrint)->Arg(100)->Arg(1000)->Arg(10000)->Arg(100000);
+
+/*
+ * print_wrap() is internal to line_info.c, so it's measured through line_info_print() with a
+ * screen full of long messages at different window widths.
+ */
+void BM_PrintWrap(benchmark::State &state)
+{
+    Env *e = env();
+
+    if (!e->ok) {
+        state.SkipWithError("failed to create a screen");
+        return;
+    }
+
+    std::mt19937 rng(42);
+    HistoryWindow win(static_cast<int>(state.range(0)));
+    win.fill(&e->config, kRows, make_message(static_cast<size_t>(state.range(1)), &rng));
+
+    for (auto _ : state) {
+        line_info_print(win.self(), &e->config);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PrintWrap)->ArgNames({"cols", "length"})->Args({60, 400})->Args({160, 400})->Args({160, 1200});
+
+/* Converts an ASCII message to wide characters and measures its width, as every new line does */
+void BM_LineInfoAddMsg(benchmark::State &state)
+{
+    const std::string msg(static_cast<size_t>(state.range(0)), 'x');
+    std::vector<wchar_t> buf(msg.size() + 1);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(line_info_add_msg(buf.data(), buf.size(), msg.c_str()));
+    }
+
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(msg.size()));
+}
+BENCHMARK(BM_LineInfoAddMsg)->Arg(16)->Arg(400);
+
+/* The plain mbstowcs()/wcswidth() path that line_info_add_msg() replaces, for comparison */
+void BM_MbstowcsWcswidth(benchmark::State &state)
+{
+    const std::string msg(static_cast<size_t>(state.range(0)), 'x');
+    std::vector<wchar_t> buf(msg.size() + 1);
+
+    for (auto _ : state) {
+        const size_t len = std::mbstowcs(buf.data(), msg.c_str(), buf.size());
+        benchmark::DoNotOptimize(wcswidth(buf.data(), len));
+    }
+
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(msg.size()));
+}
+BENCHMARK(BM_MbstowcsWcswidth)->Arg(16)->Arg(400);
+
+/* Synthetic chat logs by size in MB, removed on exit */
+class LogFiles {
+public:
+    ~LogFiles()
+    {
+        for (const auto &it : paths_) {
+            unlink(it.second.c_str());
+        }
+    }
+
+    /* Returns the path of a log of at least `megabytes` MB in the format write_to_log() uses. */
+    std::string get(int megabytes)
+    {
+        auto it = paths_.find(megabytes);
+
+        if (it != paths_.end()) {
+            return it->second;
+        }
+
+        char path[] = "/tmp/toxic_bench_log.XXXXXX";
+        const int fd = mkstemp(path);
+
+        if (fd == -1) {
+            return "";
+        }
+
+        paths_[megabytes] = path;
+
+        FILE *fp = fdopen(fd, "w");
+
+        if (fp == nullptr) {
+            close(fd);
+            return "";
+        }
+
+        std::mt19937 rng(megabytes);
+        const long size = static_cast<long>(megabytes) * 1024 * 1024;
+
+        for (long written = 0; written < size;) {
+            const int n = std::fprintf(fp, "{%d} 2024/01/%02d [%02d:%02d:%02d] %s: %s\n", LOG_HINT_NORMAL_I,
+                                       1 + static_cast<int>(rng() % 28), static_cast<int>(rng() % 24),
+                                       static_cast<int>(rng() % 60), static_cast<int>(rng() % 60),
+                                       rng() % 2 ? "Alice" : "Bob", make_message(20 + rng() % 200, &rng).c_str());
+
+            if (n < 0) {
+                std::fclose(fp);
+                return "";
+            }
+
+            written += n;
+        }
+
+        return std::fclose(fp) == 0 ? path : "";
+    }
+
+private:
+    std::map<int, std::string> paths_;
+};
+
+LogFiles log_files;
+
+void BM_LoadChatHistory(benchmark::State &state)
+{
+    Env *e = env();
+
+    if (!e->ok) {
+        state.SkipWithError("failed to create a screen");
+        return;
+    }
+
+    const std::string path = log_files.get(static_cast<int>(state.range(0)));
+
+    if (path.empty()) {
+        state.SkipWithError("failed to write the log");
+        return;
+    }
+
+    struct chatlog log = {};
+    std::snprintf(log.path, sizeof(log.path), "%s", path.c_str());
+
+    HistoryWindow win;
+
+    for (auto _ : state) {
+        if (load_chat_history(&log, win.self(), &e->config, "Bob") != 0) {
+            state.SkipWithError("load_chat_history() failed");
+            break;
+        }
+
+        line_info_check_queue(win.self(), &e->config);
+
+        state.PauseTiming();
+        win.clear();
+        state.ResumeTiming();
+    }
+
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(state.range(0)) * 1024 * 1024);
+}
+BENCHMARK(BM_LoadChatHistory)->Arg(1)->Arg(8)->Arg(32)->Unit(benchmark::kMillisecond);
+
+void BM_WriteToLog(benchmark::State &state)
+{
+    Env *e = env();
+
+    struct chatlog log = {};
+    log.file = std::fopen("/dev/null", "w");
+    log.log_on = true;
+
+    if (log.file == nullptr) {
+        state.SkipWithError("failed to open /dev/null");
+        return;
+    }
+
+    std::mt19937 rng(42);
+    const std::string msg = make_message(static_cast<size_t>(state.range(0)), &rng);
+
+    for (auto _ : state) {
+        write_to_log(&log, &e->config, msg.c_str(), "Alice", false, LOG_HINT_NORMAL_I);
+    }
+
+    std::fclose(log.file);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WriteToLog)->Arg(32)->Arg(1000);
+
+/* A group we founded ourselves, and its window */
+ToxWindow *bench_group(uint32_t *groupnumber)
+{
+    static ToxWindow *self = nullptr;
+    static uint32_t number = 0;
+
+    if (self != nullptr) {
+        *groupnumber = number;
+        return self;
+    }
+
+    Env *e = env();
+    Tox *tox = offline_tox();
+
+    if (!e->ok || tox == nullptr) {
+        return nullptr;
+    }
+
+    Tox_Err_Group_New err;
+    number = tox_group_new(tox, TOX_GROUP_PRIVACY_STATE_PRIVATE, reinterpret_cast<const uint8_t *>("bench"), 5,
+                           reinterpret_cast<const uint8_t *>("self"), 4, &err);
+
+    if (err != TOX_ERR_GROUP_NEW_OK || init_groupchat_win(&e->toxic, number, "bench", 5, Group_Join_Type_Create) != 0) {
+        return nullptr;
+    }
+
+    const GroupChat *chat = get_groupchat(number);
+
+    if (chat == nullptr) {
+        return nullptr;
+    }
+
+    self = get_window_pointer_by_id(&e->windows, chat->window_id);
+    *groupnumber = number;
+
+    return self;
+}
+
+/*
+ * Every peer in a group of the given size joins and then leaves again. The peers aren't known to
+ * Tox so their names and keys come back empty, which leaves just toxic's own peer list upkeep.
+ * Join and exit messages are turned off so that it isn't drowned out by line_info.
+ */
+void BM_GroupPeerJoinExit(benchmark::State &state)
+{
+    uint32_t groupnumber;
+    ToxWindow *self = bench_group(&groupnumber);
+
+    if (self == nullptr) {
+        state.SkipWithError("failed to create a group");
+        return;
+    }
+
+    Env *e = env();
+    const int show_connection_msg = e->config.show_group_connection_msg;
+    e->config.show_group_connection_msg = SHOW_GROUP_CONNECTION_MSG_OFF;
+
+    const uint32_t num_peers = static_cast<uint32_t>(state.range(0));
+
+    for (auto _ : state) {
+        for (uint32_t i = 1; i <= num_peers; ++i) {
+            self->onGroupPeerJoin(self, &e->toxic, groupnumber, 1000 + i);
+        }
+
+        for (uint32_t i = 1; i <= num_peers; ++i) {
+            groupchat_onGroupPeerExit(self, &e->toxic, groupnumber, 1000 + i, TOX_GROUP_EXIT_TYPE_QUIT, "", 0, "", 0);
+        }
+    }
+
+    e->config.show_group_connection_msg = show_connection_msg;
+    state.SetItemsProcessed(state.iterations() * num_peers * 2);
+}
+BENCHMARK(BM_GroupPeerJoinExit)->Arg(10)->Arg(100)->Arg(1000);
+
+/*
+ * Without a network the only peer in a conference is ourselves, so this measures the fixed cost
+ * of rebuilding the peer list and name list on every name list change.
+ */
+void BM_ConferenceUpdatePeerList(benchmark::State &state)
+{
+    Env *e = env();
+    Tox *tox = offline_tox();
+
+    if (!e->ok || tox == nullptr) {
+        state.SkipWithError("failed to create a Tox instance");
+        return;
+    }
+
+    static int64_t window_id = -1;
+    static uint32_t conferencenum = 0;
+
+    if (window_id == -1) {
+        Tox_Err_Conference_New err;
+        conferencenum = tox_conference_new(tox, &err);
+
+        if (err != TOX_ERR_CONFERENCE_NEW_OK) {
+            state.SkipWithError("failed to create a conference");
+            return;
+        }
+
+        window_id = init_conference_win(&e->toxic, conferencenum, TOX_CONFERENCE_TYPE_TEXT, "bench", 5, false);
+    }
+
+    ToxWindow *self = window_id >= 0 ? get_window_pointer_by_id(&e->windows, static_cast<uint32_t>(window_id)) : nullptr;
+
+    if (self == nullptr) {
+        state.SkipWithError("failed to create a conference window");
+        return;
+    }
+
+    for (auto _ : state) {
+        self->onConferenceNameListChange(self, &e->toxic, conferencenum);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ConferenceUpdatePeerList);
+
+void BM_SortFriendlistIndex(benchmark::State &state)
+{
+    const size_t num_friends = static_cast<size_t>(state.range(0));
+
+    std::vector<ToxicFriend> list(num_friends);
+    std::vector<uint32_t> index(num_friends);
+    std::mt19937 rng(42);
+
+    for (size_t i = 0; i < num_friends; ++i) {
+        ToxicFriend *f = &list[i];
+        const std::string name = make_message(4 + rng() % 12, &rng);
+
+        std::snprintf(f->name, sizeof(f->name), "%s", name.c_str());
+        f->namelength = static_cast<uint16_t>(std::strlen(f->name));
+
+        for (size_t j = 0; j <= f->namelength; ++j) {
+            f->sort_key[j] = static_cast<char>(std::tolower(static_cast<unsigned char>(f->name[j])));
+        }
+
+        f->num = static_cast<uint32_t>(i);
+        f->active = true;
+        f->connection_status = rng() % 3 == 0 ? TOX_CONNECTION_UDP : TOX_CONNECTION_NONE;
+    }
+
+    const FriendsList saved = Friends;
+    Friends.list = list.data();
+    Friends.index = index.data();
+    Friends.max_idx = num_friends;
+    Friends.num_friends = num_friends;
+
+    for (auto _ : state) {
+        sort_friendlist_index();
+    }
+
+    Friends = saved;
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(num_friends));
+}
+BENCHMARK(BM_SortFriendlistIndex)->Arg(10)->Arg(100)->Arg(1000);
+
+/* A table the size of the global command table, with the entries execute() dispatches on */
+struct Command {
+    const char *name;
+    int id;
+};
+
+Command commands[] = {
+    {"/accept", 0}, {"/add", 1}, {"/avatar", 2}, {"/clear", 3}, {"/color", 4}, {"/connect", 5},
+    {"/decline", 6}, {"/exit", 7}, {"/conference", 8}, {"/group", 9}, {"/game", 10}, {"/help", 11},
+    {"/join", 12}, {"/log", 13}, {"/myid", 14}, {"/myqr", 15}, {"/nick", 16}, {"/note", 17},
+    {"/nospam", 18}, {"/q", 19}, {"/quit", 20}, {"/requests", 21}, {"/sched", 22}, {"/status", 23},
+    {"/lsdev", 24}, {"/sdev", 25}, {"/lsvdev", 26}, {"/svdev", 27}, {"/run", 28},
+};
+
+constexpr size_t kNumCommands = sizeof(commands) / sizeof(commands[0]);
+
+/* The tokenizing and lookup done by execute() for every command line */
+void BM_ParseCommand(benchmark::State &state)
+{
+    static const char *const lines[] = {
+        "/status online",
+        "/note back in five minutes",
+        "/connect 144.217.167.73 33445 7E5668E0EE09E19F320AD47902419331FFEE147BB3606769CFBE921A2A2FD34C",
+        "/log on",
+        "/sched",
+        "/help",
+    };
+
+    constexpr size_t kNumLines = sizeof(lines) / sizeof(lines[0]);
+
+    command_table_sort(commands, kNumCommands, sizeof(Command));
+
+    size_t i = 0;
+
+    for (auto _ : state) {
+        const char *line = lines[i++ % kNumLines];
+
+        Command_Token tokens[4];
+        const size_t num_tokens = command_tokenize(line, std::strlen(line), false, tokens, 4);
+        benchmark::DoNotOptimize(num_tokens);
+        benchmark::DoNotOptimize(command_table_find(commands, kNumCommands, sizeof(Command), &tokens[0]));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseCommand);
+
+#ifdef VIDEO
+
+void BM_Yuv420ToBgr(benchmark::State &state)
+{
+    const uint16_t width = static_cast<uint16_t>(state.range(0));
+    const uint16_t height = static_cast<uint16_t>(state.range(1));
+
+    std::mt19937 rng(42);
+    std::vector<uint8_t> y(width * height);
+    std::vector<uint8_t> u(width * height / 4);
+    std::vector<uint8_t> v(width * height / 4);
+    std::vector<uint8_t> out(width * height * 4);
+
+    for (auto *plane : {&y, &u, &v}) {
+        for (uint8_t &p : *plane) {
+            p = static_cast<uint8_t>(rng());
+        }
+    }
+
+    for (auto _ : state) {
+        yuv420tobgr(width, height, y.data(), u.data(), v.data(), width, width / 2, width / 2, out.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(out.size()));
+}
+BENCHMARK(BM_Yuv420ToBgr)->ArgNames({"width", "height"})->Args({640, 480})->Args({1280, 720})->Args({1920, 1080});
+
+#if !(defined(__OSX__) || defined(__APPLE__))
+void BM_Yuv422To420(benchmark::State &state)
+{
+    const uint16_t width = static_cast<uint16_t>(state.range(0));
+    const uint16_t height = static_cast<uint16_t>(state.range(1));
+
+    std::mt19937 rng(42);
+    std::vector<uint8_t> input(width * height * 2);
+    std::vector<uint8_t> y(width * height);
+    std::vector<uint8_t> u(width * height / 4);
+    std::vector<uint8_t> v(width * height / 4);
+
+    for (uint8_t &p : input) {
+        p = static_cast<uint8_t>(rng());
+    }
+
+    for (auto _ : state) {
+        yuv422to420(y.data(), u.data(), v.data(), input.data(), width, height);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(input.size()));
+}
+BENCHMARK(BM_Yuv422To420)->ArgNames({"width", "height"})->Args({640, 480})->Args({1280, 720})->Args({1920, 1080});
+#endif /* !(__OSX__ || __APPLE__) */
+
+#endif /* VIDEO */
+
+#ifdef AUDIO
+
+/* The voice activity level computed for every captured frame */
+void BM_FrameVolume(benchmark::State &state)
+{
+    const uint32_t samples = static_cast<uint32_t>(state.range(0));
+
+    std::mt19937 rng(42);
+    std::vector<int16_t> frame(samples);
+
+    for (int16_t &s : frame) {
+        s = static_cast<int16_t>(rng());
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(get_frame_volume(frame.data(), samples));
+    }
+
+    state.SetItemsProcessed(state.iterations() * samples);
+}
+BENCHMARK(BM_FrameVolume)->Arg(480)->Arg(960)->Arg(2880);
+
+#endif /* AUDIO */
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    /* JSON unless asked otherwise; later flags override earlier ones */
+    std::vector<char *> args = {argv[0], const_cast<char *>("--benchmark_format=json")};
+    args.insert(args.end(), argv + 1, argv + argc);
+
+    int num_args = static_cast<int>(args.size());
+    benchmark::Initialize(&num_args, args.data());
+
+    if (benchmark::ReportUnrecognizedArguments(num_args, args.data())) {
+        return EXIT_FAILURE;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    if (env()->ok) {
+        endwin();
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -197,18 +197,49 @@ void rm_trailing_spaces_buf(ChatContext *ctx)
     ctx->line[ctx->len] = L'\0';
 }
 
-#define HIST_PURGE ((MAX_LINE_HIST) / 4)
+#define MIN_LINE_HIST_SIZE 8
 
-/* shifts hist items back and makes room for HIST_PURGE new entries */
-static void shift_hist_back(ChatContext *ctx)
+/* Returns the history line at index `i`, where 0 is the oldest line. */
+static const wchar_t *hist_line(const ChatContext *ctx, int i)
 {
-    int n = MAX_LINE_HIST - HIST_PURGE;
+    return ctx->ln_history[(ctx->hst_head + i) % ctx->hst_size];
+}
+
+/*
+ * Makes room for a new line at the end of the history, dropping the oldest line if the
+ * history is full.
+ *
+ * Return the slot for the new line.
+ * Return -1 on allocation failure.
+ */
+static int hist_reserve_slot(ChatContext *ctx)
+{
+    if (ctx->hst_tot >= MAX_LINE_HIST) {
+        const int slot = ctx->hst_head;
+
+        free(ctx->ln_history[slot]);
+        ctx->ln_history[slot] = NULL;
+
+        ctx->hst_head = (ctx->hst_head + 1) % ctx->hst_size;
+        --ctx->hst_tot;
 
-    for (int i = 0; i < n; ++i) {
-        wmemcpy(ctx->ln_history[i], ctx->ln_history[i + HIST_PURGE], MAX_STR_SIZE);
+        return slot;
     }
 
-    ctx->hst_tot = n;
+    /* The ring only wraps once it's full, so the lines are in order when it grows */
+    if (ctx->hst_tot == ctx->hst_size) {
+        const int new_size = ctx->hst_size == 0 ? MIN_LINE_HIST_SIZE : MIN(ctx->hst_size * 2, MAX_LINE_HIST);
+        wchar_t **tmp = realloc(ctx->ln_history, new_size * sizeof(wchar_t *));
+
+        if (tmp == NULL) {
+            return -1;
+        }
+
+        ctx->ln_history = tmp;
+        ctx->hst_size = new_size;
+    }
+
+    return (ctx->hst_head + ctx->hst_tot) % ctx->hst_size;
 }
 
 /* adds a line to the ln_history buffer at hst_pos and sets hst_pos to end of history. */
@@ -218,14 +249,25 @@ void add_line_to_hist(ChatContext *ctx)
         return;
     }
 
-    if (ctx->hst_tot >= MAX_LINE_HIST) {
-        shift_hist_back(ctx);
+    wchar_t *line = malloc((ctx->len + 1) * sizeof(wchar_t));
+
+    if (line == NULL) {
+        return;
     }
 
+    const int slot = hist_reserve_slot(ctx);
+
+    if (slot < 0) {
+        free(line);
+        return;
+    }
+
+    wmemcpy(line, ctx->line, ctx->len);
+    line[ctx->len] = L'\0';
+
+    ctx->ln_history[slot] = line;
     ++ctx->hst_tot;
     ctx->hst_pos = ctx->hst_tot;
-
-    wmemcpy(ctx->ln_history[ctx->hst_tot - 1], ctx->line, ctx->len + 1);
 }
 
 /* copies history item at hst_pos to line. Sets pos and len to the len of the history item.
@@ -241,6 +283,10 @@ void fetch_hist_item(const Client_Config *c_config, ChatContext *ctx, int key_di
     }
 
     if (key_dir == KEY_UP) {
+        if (ctx->hst_tot == 0) {
+            return;
+        }
+
         if (--ctx->hst_pos < 0) {
             ctx->hst_pos = 0;
         }
@@ -252,7 +298,7 @@ void fetch_hist_item(const Client_Config *c_config, ChatContext *ctx, int key_di
         }
     }
 
-    const wchar_t *hst_line = ctx->ln_history[ctx->hst_pos];
+    const wchar_t *hst_line = hist_line(ctx, ctx->hst_pos);
     size_t h_len = wcslen(hst_line);
 
     wmemcpy(ctx->line, hst_line, h_len + 1);
@@ -260,20 +306,35 @@ void fetch_hist_item(const Client_Config *c_config, ChatContext *ctx, int key_di
     ctx->len = h_len;
 }
 
-void strsubst(char *str, char old, char new)
+void free_line_history(ChatContext *ctx)
+{
+    for (int i = 0; i < ctx->hst_tot; ++i) {
+        free(ctx->ln_history[(ctx->hst_head + i) % ctx->hst_size]);
+    }
+
+    free(ctx->ln_history);
+
+    ctx->ln_history = NULL;
+    ctx->hst_size = 0;
+    ctx->hst_head = 0;
+    ctx->hst_pos = 0;
+    ctx->hst_tot = 0;
+}
+
+void strsubst(char *str, char old_c, char new_c)
 {
     for (int i = 0; str[i] != '\0'; ++i) {
-        if (str[i] == old) {
-            str[i] = new;
+        if (str[i] == old_c) {
+            str[i] = new_c;
         }
     }
 }
 
-void wstrsubst(wchar_t *str, wchar_t old, wchar_t new)
+void wstrsubst(wchar_t *str, wchar_t old_c, wchar_t new_c)
 {
     for (int i = 0; str[i] != L'\0'; ++i) {
-        if (str[i] == old) {
-            str[i] = new;
+        if (str[i] == old_c) {
+            str[i] = new_c;
         }
     }
 }
@@ -25,6 +25,10 @@
 
 #include "windows.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
 /* Adds char to line at pos. Return 0 on success, -1 if line buffer is full */
 int add_char_to_buf(ChatContext *ctx, wint_t ch);
 
@@ -66,8 +70,15 @@ void add_line_to_hist(ChatContext *ctx);
    resets line if at end of history */
 void fetch_hist_item(const Client_Config *c_config, ChatContext *ctx, int key_dir);
 
-/* Substitutes all occurrences of old with new. */
-void strsubst(char *str, char old, char new);
-void wstrsubst(wchar_t *str, wchar_t old, wchar_t new);
+/* Frees the input line history of ctx. */
+void free_line_history(ChatContext *ctx);
+
+/* Substitutes all occurrences of old_c with new_c. */
+void strsubst(char *str, char old_c, char new_c);
+void wstrsubst(wchar_t *str, wchar_t old_c, wchar_t new_c);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
 
 #endif /* TOXIC_STRINGS_H */
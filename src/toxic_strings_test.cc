@@ -0,0 +1,99 @@
+#include "toxic_strings.h"
+
+#include <gtest/gtest.h>
+
+#include <cwchar>
+#include <string>
+
+namespace {
+
+class LineHistory : public ::testing::Test {
+protected:
+    void TearDown() override
+    {
+        free_line_history(&ctx_);
+    }
+
+    void enter(const std::wstring &line)
+    {
+        set_line(line);
+        add_line_to_hist(&ctx_);
+        reset_buf(&ctx_);
+    }
+
+    void set_line(const std::wstring &line)
+    {
+        std::wmemcpy(ctx_.line, line.c_str(), line.size() + 1);
+        ctx_.len = static_cast<int>(line.size());
+        ctx_.pos = ctx_.len;
+    }
+
+    std::wstring fetch(int key)
+    {
+        fetch_hist_item(nullptr, &ctx_, key);
+        return std::wstring(ctx_.line, ctx_.len);
+    }
+
+    ChatContext ctx_{};
+};
+
+TEST_F(LineHistory, NotAllocatedUntilUsed)
+{
+    EXPECT_EQ(fetch(KEY_UP), L"");
+    EXPECT_EQ(fetch(KEY_DOWN), L"");
+    EXPECT_EQ(ctx_.ln_history, nullptr);
+    EXPECT_EQ(ctx_.hst_size, 0);
+}
+
+TEST_F(LineHistory, RecallsLinesInOrder)
+{
+    enter(L"first");
+    enter(L"second");
+    enter(L"third");
+
+    EXPECT_EQ(fetch(KEY_UP), L"third");
+    EXPECT_EQ(fetch(KEY_UP), L"second");
+    EXPECT_EQ(fetch(KEY_UP), L"first");
+    EXPECT_EQ(fetch(KEY_UP), L"first");
+    EXPECT_EQ(fetch(KEY_DOWN), L"second");
+    EXPECT_EQ(fetch(KEY_DOWN), L"third");
+    EXPECT_EQ(fetch(KEY_DOWN), L"");
+}
+
+TEST_F(LineHistory, KeepsUnsentLine)
+{
+    enter(L"sent");
+    set_line(L"draft");
+
+    EXPECT_EQ(fetch(KEY_UP), L"sent");
+    EXPECT_EQ(fetch(KEY_DOWN), L"draft");
+}
+
+TEST_F(LineHistory, GrowsWithUse)
+{
+    enter(L"one");
+    EXPECT_GT(ctx_.hst_size, 0);
+    EXPECT_LT(ctx_.hst_size, MAX_LINE_HIST);
+}
+
+TEST_F(LineHistory, DropsOldestLinesWhenFull)
+{
+    constexpr int kExtra = 10;
+
+    for (int i = 0; i < MAX_LINE_HIST + kExtra; ++i) {
+        enter(L"line " + std::to_wstring(i));
+    }
+
+    EXPECT_EQ(ctx_.hst_tot, MAX_LINE_HIST);
+    EXPECT_EQ(ctx_.hst_size, MAX_LINE_HIST);
+
+    EXPECT_EQ(fetch(KEY_UP), L"line " + std::to_wstring(MAX_LINE_HIST + kExtra - 1));
+
+    for (int i = 0; i < MAX_LINE_HIST; ++i) {
+        fetch(KEY_UP);
+    }
+
+    EXPECT_EQ(std::wstring(ctx_.line, ctx_.len), L"line " + std::to_wstring(kExtra));
+}
+
+}  // namespace
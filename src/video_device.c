@@ -106,9 +106,9 @@ static bool video_thread_paused = true;                /* Thread control */
 
 void *video_thread_poll(void *userdata);
 
-static void yuv420tobgr(uint16_t width, uint16_t height, const uint8_t *y,
-                        const uint8_t *u, const uint8_t *v, unsigned int ystride,
-                        unsigned int ustride, unsigned int vstride, uint8_t *out)
+void yuv420tobgr(uint16_t width, uint16_t height, const uint8_t *y,
+                 const uint8_t *u, const uint8_t *v, unsigned int ystride,
+                 unsigned int ustride, unsigned int vstride, uint8_t *out)
 {
     unsigned long int i, j;
 
@@ -133,8 +133,8 @@ static void yuv420tobgr(uint16_t width, uint16_t height, const uint8_t *y,
 }
 
 #if !(defined(__OSX__) || defined(__APPLE__))
-static void yuv422to420(uint8_t *plane_y, uint8_t *plane_u, uint8_t *plane_v,
-                        uint8_t *f_input, uint16_t width, uint16_t height)
+void yuv422to420(uint8_t *plane_y, uint8_t *plane_u, uint8_t *plane_v,
+                 uint8_t *f_input, uint16_t width, uint16_t height)
 {
     uint8_t *end = f_input + width * height * 2;
 
@@ -77,4 +77,14 @@ void print_video_devices(ToxWindow *self, const Client_Config *c_config, VideoDe
 void get_primary_video_device_name(VideoDeviceType type, char *buf, int size);
 
 VideoDeviceError video_selection_valid(VideoDeviceType type, int32_t selection);
+
+/* Converts a YUV420 image to 32 bit BGRA. `out` must hold width * height * 4 bytes. */
+void yuv420tobgr(uint16_t width, uint16_t height, const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                 unsigned int ystride, unsigned int ustride, unsigned int vstride, uint8_t *out);
+
+#if !(defined(__OSX__) || defined(__APPLE__))
+/* Converts a packed YUYV 4:2:2 frame from a capture device to planar YUV420. */
+void yuv422to420(uint8_t *plane_y, uint8_t *plane_u, uint8_t *plane_v, uint8_t *f_input, uint16_t width,
+                 uint16_t height);
+#endif /* !(__OSX__ || __APPLE__) */
 #endif /* VIDEO_DEVICE_H */
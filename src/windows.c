@@ -43,6 +43,31 @@
 #include "game_base.h"
 #endif
 
+#ifdef PYTHON
+#include "python_api.h"
+#endif /* PYTHON */
+
+/*
+ * Returns true if the callbacks of `w` should be invoked for an event associated with
+ * `number` and `type`.
+ *
+ * Stub windows only receive events that concern them, and are fully initialized first.
+ */
+static bool window_accepts_event(ToxWindow *w, Toxic *toxic, uint32_t number, Window_Type type)
+{
+    if (!w->is_stub) {
+        return true;
+    }
+
+    if (w->type != type || w->num != number) {
+        return false;
+    }
+
+    init_stub_window(w, toxic);
+
+    return true;
+}
+
 /* CALLBACKS START */
 void on_friend_request(Tox *tox, const uint8_t *public_key, const uint8_t *data, size_t length, void *userdata)
 {
@@ -121,6 +146,10 @@ void on_friend_message(Tox *tox, uint32_t friendnumber, Tox_Message_Type type, c
             w->onMessage(w, toxic, friendnumber, type, msg, length);
         }
     }
+
+#ifdef PYTHON
+    python_post_event(PYTHON_EVENT_MESSAGE, PYTHON_SOURCE_FRIEND, friendnumber, 0, msg);
+#endif /* PYTHON */
 }
 
 void on_friend_name(Tox *tox, uint32_t friendnumber, const uint8_t *string, size_t length, void *userdata)
@@ -185,6 +214,11 @@ void on_friend_status(Tox *tox, uint32_t friendnumber, Tox_User_Status status, v
         }
     }
 
+#ifdef PYTHON
+    python_post_event(PYTHON_EVENT_STATUS_CHANGE, PYTHON_SOURCE_FRIEND, friendnumber, 0,
+                      python_user_status_name(status));
+#endif /* PYTHON */
+
     flag_interface_refresh();
 }
 
@@ -217,10 +251,15 @@ void on_conference_message(Tox *tox, uint32_t conferencenumber, uint32_t peernum
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onConferenceMessage != NULL) {
+        if (w->onConferenceMessage != NULL
+                && window_accepts_event(w, toxic, conferencenumber, WINDOW_TYPE_CONFERENCE)) {
             w->onConferenceMessage(w, toxic, conferencenumber, peernumber, type, msg, length);
         }
     }
+
+#ifdef PYTHON
+    python_post_event(PYTHON_EVENT_MESSAGE, PYTHON_SOURCE_CONFERENCE, conferencenumber, peernumber, msg);
+#endif /* PYTHON */
 }
 
 void on_conference_invite(Tox *tox, uint32_t friendnumber, Tox_Conference_Type type, const uint8_t *conference_pub_key,
@@ -233,7 +272,7 @@ void on_conference_invite(Tox *tox, uint32_t friendnumber, Tox_Conference_Type t
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onConferenceInvite != NULL) {
+        if (w->onConferenceInvite != NULL && !w->is_stub) {
             w->onConferenceInvite(w, toxic, friendnumber, type, (const char *) conference_pub_key, length);
         }
     }
@@ -248,7 +287,8 @@ void on_conference_peer_list_changed(Tox *tox, uint32_t conferencenumber, void *
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onConferenceNameListChange != NULL) {
+        if (w->onConferenceNameListChange != NULL
+                && window_accepts_event(w, toxic, conferencenumber, WINDOW_TYPE_CONFERENCE)) {
             w->onConferenceNameListChange(w, toxic, conferencenumber);
         }
     }
@@ -270,7 +310,8 @@ void on_conference_peer_name(Tox *tox, uint32_t conferencenumber, uint32_t peern
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onConferencePeerNameChange != NULL) {
+        if (w->onConferencePeerNameChange != NULL
+                && window_accepts_event(w, toxic, conferencenumber, WINDOW_TYPE_CONFERENCE)) {
             w->onConferencePeerNameChange(w, toxic, conferencenumber, peernumber, nick, length);
         }
     }
@@ -289,7 +330,8 @@ void on_conference_title(Tox *tox, uint32_t conferencenumber, uint32_t peernumbe
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onConferenceTitleChange != NULL) {
+        if (w->onConferenceTitleChange != NULL
+                && window_accepts_event(w, toxic, conferencenumber, WINDOW_TYPE_CONFERENCE)) {
             w->onConferenceTitleChange(w, toxic, conferencenumber, peernumber, data, length);
         }
     }
@@ -335,6 +377,15 @@ void on_file_recv_chunk(Tox *tox, uint32_t friendnumber, uint32_t filenumber, ui
         return;
     }
 
+#ifdef PYTHON
+
+    /* An empty chunk ends the transfer, and the chat window closes it below */
+    if (length == 0 && ft->state == FILE_TRANSFER_STARTED) {
+        python_post_event(PYTHON_EVENT_FILE_RECEIVED, PYTHON_SOURCE_FRIEND, friendnumber, filenumber, ft->file_path);
+    }
+
+#endif /* PYTHON */
+
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
@@ -473,7 +524,7 @@ void on_group_invite(Tox *tox, uint32_t friendnumber, const uint8_t *invite_data
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupInvite != NULL) {
+        if (w->onGroupInvite != NULL && !w->is_stub) {
             w->onGroupInvite(w, toxic, friendnumber, (const char *) invite_data, length, gname,
                              group_name_length);
         }
@@ -495,10 +546,14 @@ void on_group_message(Tox *tox, uint32_t groupnumber, uint32_t peer_id, TOX_MESS
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupMessage != NULL) {
+        if (w->onGroupMessage != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupMessage(w, toxic, groupnumber, peer_id, type, msg, length);
         }
     }
+
+#ifdef PYTHON
+    python_post_event(PYTHON_EVENT_MESSAGE, PYTHON_SOURCE_GROUP, groupnumber, peer_id, msg);
+#endif /* PYTHON */
 }
 
 void on_group_private_message(Tox *tox, uint32_t groupnumber, uint32_t peer_id, TOX_MESSAGE_TYPE type,
@@ -516,7 +571,7 @@ void on_group_private_message(Tox *tox, uint32_t groupnumber, uint32_t peer_id,
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupPrivateMessage != NULL) {
+        if (w->onGroupPrivateMessage != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupPrivateMessage(w, toxic, groupnumber, peer_id, msg, length);
         }
     }
@@ -532,7 +587,7 @@ void on_group_status_change(Tox *tox, uint32_t groupnumber, uint32_t peer_id, TO
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupStatusChange != NULL) {
+        if (w->onGroupStatusChange != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupStatusChange(w, toxic, groupnumber, peer_id, status);
         }
     }
@@ -550,11 +605,15 @@ void on_group_peer_join(Tox *tox, uint32_t groupnumber, uint32_t peer_id, void *
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupPeerJoin != NULL) {
+        if (w->onGroupPeerJoin != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupPeerJoin(w, toxic, groupnumber, peer_id);
         }
     }
 
+#ifdef PYTHON
+    python_post_event(PYTHON_EVENT_PEER_JOIN, PYTHON_SOURCE_GROUP, groupnumber, peer_id, NULL);
+#endif /* PYTHON */
+
     flag_interface_refresh();
 }
 
@@ -580,7 +639,7 @@ void on_group_peer_exit(Tox *tox, uint32_t groupnumber, uint32_t peer_id, Tox_Gr
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupPeerExit != NULL) {
+        if (w->onGroupPeerExit != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupPeerExit(w, toxic, groupnumber, peer_id, exit_type, toxic_nick, nick_len, buf, buf_len);
         }
     }
@@ -600,7 +659,7 @@ void on_group_topic_change(Tox *tox, uint32_t groupnumber, uint32_t peer_id, con
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupTopicChange != NULL) {
+        if (w->onGroupTopicChange != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupTopicChange(w, toxic, groupnumber, peer_id, data, length);
         }
     }
@@ -616,7 +675,7 @@ void on_group_peer_limit(Tox *tox, uint32_t groupnumber, uint32_t peer_limit, vo
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupPeerLimit != NULL) {
+        if (w->onGroupPeerLimit != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupPeerLimit(w, toxic, groupnumber, peer_limit);
         }
     }
@@ -632,7 +691,7 @@ void on_group_privacy_state(Tox *tox, uint32_t groupnumber, Tox_Group_Privacy_St
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupPrivacyState != NULL) {
+        if (w->onGroupPrivacyState != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupPrivacyState(w, toxic, groupnumber, privacy_state);
         }
     }
@@ -648,7 +707,7 @@ void on_group_topic_lock(Tox *tox, uint32_t groupnumber, Tox_Group_Topic_Lock to
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupTopicLock != NULL) {
+        if (w->onGroupTopicLock != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupTopicLock(w, toxic, groupnumber, topic_lock);
         }
     }
@@ -664,7 +723,7 @@ void on_group_password(Tox *tox, uint32_t groupnumber, const uint8_t *password,
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupPassword != NULL) {
+        if (w->onGroupPassword != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupPassword(w, toxic, groupnumber, (const char *) password, length);
         }
     }
@@ -685,7 +744,7 @@ void on_group_nick_change(Tox *tox, uint32_t groupnumber, uint32_t peer_id, cons
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupNickChange != NULL) {
+        if (w->onGroupNickChange != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupNickChange(w, toxic, groupnumber, peer_id, name, length);
         }
     }
@@ -701,7 +760,7 @@ void on_group_self_join(Tox *tox, uint32_t groupnumber, void *userdata)
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupSelfJoin != NULL) {
+        if (w->onGroupSelfJoin != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupSelfJoin(w, toxic, groupnumber);
         }
     }
@@ -717,7 +776,7 @@ void on_group_rejected(Tox *tox, uint32_t groupnumber, Tox_Group_Join_Fail type,
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupRejected != NULL) {
+        if (w->onGroupRejected != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupRejected(w, toxic, groupnumber, type);
         }
     }
@@ -734,7 +793,7 @@ void on_group_moderation(Tox *tox, uint32_t groupnumber, uint32_t source_peer_id
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupModeration != NULL) {
+        if (w->onGroupModeration != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupModeration(w, toxic, groupnumber, source_peer_id, target_peer_id, type);
         }
     }
@@ -750,7 +809,7 @@ void on_group_voice_state(Tox *tox, uint32_t groupnumber, Tox_Group_Voice_State
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w->onGroupVoiceState != NULL) {
+        if (w->onGroupVoiceState != NULL && window_accepts_event(w, toxic, groupnumber, WINDOW_TYPE_GROUPCHAT)) {
             w->onGroupVoiceState(w, toxic, groupnumber, voice_state);
         }
     }
@@ -791,22 +850,24 @@ int64_t add_window(Toxic *toxic, ToxWindow *w)
     const uint16_t new_index = windows->count;
 
     w->id = get_new_window_id(windows);
-    w->window = newwin(LINES, COLS, 0, 0);
+    w->colour = BAR_TEXT;
 
-    if (w->window == NULL) {
-        fprintf(stderr, "newwin() failed in add_window()\n");
-        return -1;
-    }
+    if (!w->is_stub) {
+        w->window = newwin(LINES, COLS, 0, 0);
 
-    w->colour = BAR_TEXT;
+        if (w->window == NULL) {
+            fprintf(stderr, "newwin() failed in add_window()\n");
+            return -1;
+        }
 
 #ifdef URXVT_FIX
-    /* Fixes text color problem on some terminals. */
-    wbkgd(w->window, COLOR_PAIR(6));
+        /* Fixes text color problem on some terminals. */
+        wbkgd(w->window, COLOR_PAIR(6));
 #endif
 
-    if (w->onInit) {
-        w->onInit(w, toxic);
+        if (w->onInit) {
+            w->onInit(w, toxic);
+        }
     }
 
     ToxWindow **tmp_list = (ToxWindow **)realloc(windows->list, (windows->count + 1) * sizeof(ToxWindow *));
@@ -822,6 +883,44 @@ int64_t add_window(Toxic *toxic, ToxWindow *w)
     return w->id;
 }
 
+void init_stub_window(ToxWindow *w, Toxic *toxic)
+{
+    if (w == NULL || !w->is_stub) {
+        return;
+    }
+
+    w->window = newwin(LINES, COLS, 0, 0);
+
+    if (w->window == NULL) {
+        exit_toxic_err(FATALERR_CURSES, "newwin() failed in init_stub_window()");
+    }
+
+#ifdef URXVT_FIX
+    /* Fixes text color problem on some terminals. */
+    wbkgd(w->window, COLOR_PAIR(6));
+#endif
+
+    w->is_stub = false;
+
+    if (w->onInit) {
+        w->onInit(w, toxic);
+    }
+
+    if (w->onStubInit) {
+        w->onStubInit(w, toxic);
+    }
+
+    if (w->stub_autolog != 0 && w->chatwin != NULL) {
+        if (w->stub_autolog > 0) {
+            log_enable(w->chatwin->log);
+        } else {
+            log_disable(w->chatwin->log);
+        }
+
+        w->stub_autolog = 0;
+    }
+}
+
 void set_active_window_by_type(Windows *windows, Window_Type type)
 {
     for (uint16_t i = 0; i < windows->count; ++i) {
@@ -937,7 +1036,7 @@ void on_window_resize(Windows *windows)
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *w = windows->list[i];
 
-        if (w == NULL) {
+        if (w == NULL || w->is_stub) {  // stubs are created with the current dimensions when initialized
             continue;
         }
 
@@ -1235,6 +1334,12 @@ void draw_active_window(Toxic *toxic)
     }
 
     pthread_mutex_lock(&Winthread.lock);
+
+    if (a->is_stub) {
+        init_stub_window(a, toxic);
+        flag_interface_refresh();
+    }
+
     a->alert = WINDOW_ALERT_NONE;
     a->pending_messages = 0;
     const bool flag_refresh = Winthread.flag_refresh;
@@ -1326,19 +1431,31 @@ void draw_active_window(Toxic *toxic)
  */
 void refresh_inactive_windows(Windows *windows, const Client_Config *c_config)
 {
+    /* Nothing has been added to any window since the last pass */
+    if (line_info_queued_lines() == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&Winthread.lock);
+
     for (uint16_t i = 0; i < windows->count; ++i) {
         ToxWindow *toxwin = windows->list[i];
 
-        if (toxwin == NULL) {
+        if (toxwin == NULL || toxwin->chatwin == NULL || toxwin->chatwin->hst == NULL) {
             continue;
         }
 
-        if ((i != windows->active_index) && (toxwin->type != WINDOW_TYPE_FRIEND_LIST)) {
-            pthread_mutex_lock(&Winthread.lock);
-            line_info_print(toxwin, c_config);
-            pthread_mutex_unlock(&Winthread.lock);
+        if (i == windows->active_index || toxwin->type == WINDOW_TYPE_FRIEND_LIST) {
+            continue;
+        }
+
+        /* The window is painted by its onDraw callback once it's focused */
+        if (toxwin->chatwin->hst->queue_size > 0) {
+            line_info_check_queue(toxwin, c_config);
         }
     }
+
+    pthread_mutex_unlock(&Winthread.lock);
 }
 
 /* Returns a pointer to the ToxWindow associated with `id`.
@@ -1410,6 +1527,11 @@ bool disable_window_log_by_number_type(Windows *windows, uint32_t number, Window
         return false;
     }
 
+    if (win->is_stub) {
+        win->stub_autolog = -1;
+        return true;
+    }
+
     ChatContext *ctx = win->chatwin;
 
     if (ctx == NULL) {
@@ -1429,6 +1551,11 @@ bool enable_window_log_by_number_type(Windows *windows, uint32_t number, Window_
         return false;
     }
 
+    if (win->is_stub) {
+        win->stub_autolog = 1;
+        return true;
+    }
+
     ChatContext *ctx = win->chatwin;
 
     if (ctx == NULL) {
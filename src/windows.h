@@ -137,14 +137,6 @@ struct Winthread {
 
 extern struct Winthread Winthread;
 
-struct cqueue_thread {
-    pthread_t tid;
-};
-
-struct av_thread {
-    pthread_t tid;
-};
-
 typedef struct ToxWindow ToxWindow;
 typedef struct StatusBar StatusBar;
 typedef struct PromptBuf PromptBuf;
@@ -159,6 +151,7 @@ struct ToxWindow {
     bool(*onKey)(ToxWindow *, Toxic *, wint_t, bool);
     void(*onDraw)(ToxWindow *, Toxic *);
     void(*onInit)(ToxWindow *, Toxic *);
+    void(*onStubInit)(ToxWindow *, Toxic *);
     void(*onNickRefresh)(ToxWindow *, Toxic *);
 
     void(*onFriendRequest)(ToxWindow *, Toxic *, const char *, const char *, size_t);
@@ -222,6 +215,8 @@ struct ToxWindow {
 #endif /* AUDIO */
 
     int active_box; /* For box notify */
+    uint64_t last_sound_request;  /* monotonic time in ms of the last sound notification for this window */
+    uint64_t last_sound_played;   /* monotonic time in ms of the last one that wasn't coalesced */
 
     char name[TOXIC_MAX_NAME_LENGTH + 1];
     int colour;  /* The ncurses colour pair of the window name */
@@ -235,6 +230,9 @@ struct ToxWindow {
 
     int show_peerlist;    /* used to toggle conference peerlist */
 
+    bool is_stub;     /* true until the window is first focused or receives traffic (see init_stub_window()) */
+    int stub_autolog;  /* set while a stub: 1 to enable or -1 to disable the log once it's opened, 0 to leave it */
+
     WINDOW_ALERTS alert;
 
     ChatContext *chatwin;
@@ -292,7 +290,9 @@ struct ChatContext {
     int len;
     int start;    /* the position to start printing line at */
 
-    wchar_t ln_history[MAX_LINE_HIST][MAX_STR_SIZE];  /* history for input lines/commands */
+    wchar_t **ln_history;  /* ring of input lines/commands, allocated on first use */
+    int hst_size;   /* number of slots in ln_history; grows up to MAX_LINE_HIST */
+    int hst_head;   /* slot of the oldest line */
     int hst_pos;
     int hst_tot;
 
@@ -324,6 +324,15 @@ struct Help {
 void init_windows(Toxic *toxic);
 void draw_active_window(Toxic *toxic);
 int64_t add_window(Toxic *toxic, ToxWindow *w);
+
+/*
+ * Creates the ncurses windows for `w` and runs the deferred parts of its initialization
+ * if it was added as a stub. Does nothing otherwise.
+ *
+ * Windows that are restored at startup (groups and conferences) are added as stubs so that
+ * their windows, logs and chat history aren't set up until they're needed.
+ */
+void init_stub_window(ToxWindow *w, Toxic *toxic);
 void del_window(ToxWindow *w, Windows *windows, const Client_Config *c_config);
 void kill_all_windows(Toxic *toxic);    /* should only be called on shutdown */
 void on_window_resize(Windows *windows);
@@ -360,8 +369,8 @@ ToxWindow *get_window_by_number_type(Windows *windows, uint32_t number, Window_T
 /* Returns the number of active windows of given type. */
 uint16_t get_num_active_windows_type(const Windows *windows, Window_Type type);
 
-/* refresh inactive windows to prevent scrolling bugs.
-   call at least once per second */
+/* moves queued lines into the history of inactive windows without drawing them, to prevent
+   scrolling bugs and keep their queues from filling up. call at least once per second */
 void refresh_inactive_windows(Windows *windows, const Client_Config *c_config);
 
 /*